@@ -0,0 +1,314 @@
+/*---------------------------------------------------------------------------
+Account lookup cache - see acctcache.h.
+---------------------------------------------------------------------------*/
+
+#include "acctcache.h"
+#include "strmap.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <errno.h>
+#endif
+
+const DWORD CCHAccount = 2 * 256 + 2;      // domain\name
+const DWORD CBMaxId = 68;                   // SECURITY_MAX_SID_SIZE
+
+struct ACCOUNTENTRY {
+    DWORD   dwError;
+    TCHAR   szAccount[CCHAccount];
+    TCHAR   szKey[2 * CBMaxId + 1];         // the id in hex; the map's key
+};
+
+struct ACCOUNTCACHE {
+    CRITICAL_SECTION    csMap;
+    CRITICAL_SECTION    csLookup;   // held across a lookup that missed
+    STRINGMAP           Map;        // id -> rgpEntry index
+    ACCOUNTENTRY**      rgpEntry;
+    DWORD               cEntries;
+    DWORD               cEntriesAllocated;
+    DWORD               dwTimeout;
+    DWORD               cLookups;
+    DWORD               cHits;
+};
+
+static ACCOUNTCACHE* s_pCache = NULL;
+
+bool InitAccountCache(DWORD dwTimeout)
+{
+    FreeAccountCache();
+    ACCOUNTCACHE* pCache = (ACCOUNTCACHE*) calloc(1, sizeof(ACCOUNTCACHE));
+    if (!pCache)
+        return false;
+    if (!InitStringMap(&pCache->Map, 16, true))
+    {
+        free(pCache);
+        return false;
+    }
+    InitializeCriticalSection(&pCache->csMap);
+    InitializeCriticalSection(&pCache->csLookup);
+    pCache->dwTimeout = dwTimeout;
+    s_pCache = pCache;
+    return true;
+}
+
+void FreeAccountCache()
+{
+    ACCOUNTCACHE* pCache = s_pCache;
+    if (!pCache)
+        return;
+    s_pCache = NULL;
+
+    for (DWORD iEntry = 0; iEntry < pCache->cEntries; iEntry++)
+        free(pCache->rgpEntry[iEntry]);
+    free(pCache->rgpEntry);
+    FreeStringMap(&pCache->Map);
+    DeleteCriticalSection(&pCache->csLookup);
+    DeleteCriticalSection(&pCache->csMap);
+    free(pCache);
+}
+
+void GetAccountCacheCounts(DWORD* pcLookups, DWORD* pcHits)
+{
+    *pcLookups = (s_pCache) ? s_pCache->cLookups : 0;
+    *pcHits = (s_pCache) ? s_pCache->cHits : 0;
+}
+
+//____________________________________________________________________________
+//
+// Lookups with a timeout
+//
+//    The request is shared by the waiting prober and the lookup thread;
+//    whichever lets go of it last frees it, so an abandoned lookup can
+//    finish whenever it likes.
+//____________________________________________________________________________
+
+struct LOOKUPREQUEST {
+    PFNLOOKUPACCOUNT    pfnLookup;
+    BYTE                rgbId[CBMaxId];
+    DWORD               cbId;
+    DWORD               dwError;
+    TCHAR               szAccount[CCHAccount];
+    bool                fDone;
+    int                 cRefs;
+#ifndef _WIN32
+    pthread_mutex_t     mutex;
+    pthread_cond_t      condDone;
+#endif
+};
+
+#ifdef _WIN32
+
+static void ReleaseRequest(LOOKUPREQUEST* pRequest)
+{
+    if (0 == InterlockedDecrement((LONG*) &pRequest->cRefs))
+        free(pRequest);
+}
+
+static unsigned __stdcall LookupThread(void* pv)
+{
+    LOOKUPREQUEST* pRequest = (LOOKUPREQUEST*) pv;
+    pRequest->dwError = pRequest->pfnLookup(pRequest->rgbId, pRequest->cbId, pRequest->szAccount, CCHAccount);
+    ReleaseRequest(pRequest);
+    return 0;
+}
+
+static DWORD LookupWithTimeout(LOOKUPREQUEST* pRequest, DWORD dwTimeout, TCHAR* szAccount)
+{
+    HANDLE hThread = (HANDLE) _beginthreadex(NULL, 0, LookupThread, pRequest, 0, NULL);
+    if (!hThread)
+    {
+        ReleaseRequest(pRequest);   // the thread's reference
+        DWORD dwError = pRequest->pfnLookup(pRequest->rgbId, pRequest->cbId, szAccount, CCHAccount);
+        ReleaseRequest(pRequest);
+        return dwError;
+    }
+
+    DWORD dwError = ERROR_TIMEOUT;
+    if (WAIT_OBJECT_0 == WaitForSingleObject(hThread, dwTimeout))
+    {
+        dwError = pRequest->dwError;
+        lstrcpy(szAccount, pRequest->szAccount);
+    }
+    CloseHandle(hThread);
+    ReleaseRequest(pRequest);
+    return dwError;
+}
+
+#else
+
+static void ReleaseRequest(LOOKUPREQUEST* pRequest)
+{
+    pthread_mutex_lock(&pRequest->mutex);
+    int cRefs = --pRequest->cRefs;
+    pthread_mutex_unlock(&pRequest->mutex);
+    if (0 == cRefs)
+    {
+        pthread_cond_destroy(&pRequest->condDone);
+        pthread_mutex_destroy(&pRequest->mutex);
+        free(pRequest);
+    }
+}
+
+static void* LookupThread(void* pv)
+{
+    LOOKUPREQUEST* pRequest = (LOOKUPREQUEST*) pv;
+    TCHAR szAccount[CCHAccount] = TEXT("");
+    DWORD dwError = pRequest->pfnLookup(pRequest->rgbId, pRequest->cbId, szAccount, CCHAccount);
+
+    pthread_mutex_lock(&pRequest->mutex);
+    pRequest->dwError = dwError;
+    lstrcpy(pRequest->szAccount, szAccount);
+    pRequest->fDone = true;
+    pthread_cond_signal(&pRequest->condDone);
+    pthread_mutex_unlock(&pRequest->mutex);
+
+    ReleaseRequest(pRequest);
+    return NULL;
+}
+
+static DWORD LookupWithTimeout(LOOKUPREQUEST* pRequest, DWORD dwTimeout, TCHAR* szAccount)
+{
+    pthread_mutex_init(&pRequest->mutex, NULL);
+    pthread_cond_init(&pRequest->condDone, NULL);
+
+    pthread_t thread;
+    if (0 != pthread_create(&thread, NULL, LookupThread, pRequest))
+    {
+        ReleaseRequest(pRequest);   // the thread's reference
+        DWORD dwError = pRequest->pfnLookup(pRequest->rgbId, pRequest->cbId, szAccount, CCHAccount);
+        ReleaseRequest(pRequest);
+        return dwError;
+    }
+    pthread_detach(thread);
+
+    struct timespec tsDeadline;
+    clock_gettime(CLOCK_REALTIME, &tsDeadline);
+    tsDeadline.tv_sec += dwTimeout / 1000;
+    tsDeadline.tv_nsec += (long) (dwTimeout % 1000) * 1000000;
+    if (tsDeadline.tv_nsec >= 1000000000)
+    {
+        tsDeadline.tv_sec++;
+        tsDeadline.tv_nsec -= 1000000000;
+    }
+
+    DWORD dwError = ERROR_TIMEOUT;
+    pthread_mutex_lock(&pRequest->mutex);
+    while (!pRequest->fDone)
+    {
+        if (ETIMEDOUT == pthread_cond_timedwait(&pRequest->condDone, &pRequest->mutex, &tsDeadline))
+            break;
+    }
+    if (pRequest->fDone)
+    {
+        dwError = pRequest->dwError;
+        lstrcpy(szAccount, pRequest->szAccount);
+    }
+    pthread_mutex_unlock(&pRequest->mutex);
+
+    ReleaseRequest(pRequest);
+    return dwError;
+}
+
+#endif // _WIN32
+
+static DWORD LookupAccountNow(const BYTE* pbId, DWORD cbId, PFNLOOKUPACCOUNT pfnLookup, DWORD dwTimeout, TCHAR* szAccount)
+{
+    *szAccount = 0;
+    if (!dwTimeout)
+        return pfnLookup(pbId, cbId, szAccount, CCHAccount);
+
+    LOOKUPREQUEST* pRequest = (LOOKUPREQUEST*) calloc(1, sizeof(LOOKUPREQUEST));
+    if (!pRequest)
+        return pfnLookup(pbId, cbId, szAccount, CCHAccount);
+    pRequest->pfnLookup = pfnLookup;
+    memcpy(pRequest->rgbId, pbId, cbId);
+    pRequest->cbId = cbId;
+    pRequest->cRefs = 2;
+    return LookupWithTimeout(pRequest, dwTimeout, szAccount);
+}
+
+//____________________________________________________________________________
+
+static DWORD CopyAccount(const ACCOUNTENTRY* pEntry, TCHAR* szAccount, DWORD cchAccount)
+{
+    if (ERROR_SUCCESS == pEntry->dwError)
+        lstrcpyn(szAccount, pEntry->szAccount, cchAccount);
+    return pEntry->dwError;
+}
+
+static bool FindCachedAccount(ACCOUNTCACHE* pCache, const TCHAR* szKey, TCHAR* szAccount, DWORD cchAccount, DWORD* pdwError)
+{
+    DWORD iEntry = 0;
+    EnterCriticalSection(&pCache->csMap);
+    bool fFound = FindStringMapValue(&pCache->Map, szKey, &iEntry);
+    if (fFound)
+    {
+        pCache->cHits++;
+        *pdwError = CopyAccount(pCache->rgpEntry[iEntry], szAccount, cchAccount);
+    }
+    LeaveCriticalSection(&pCache->csMap);
+    return fFound;
+}
+
+DWORD LookupAccountCached(const BYTE* pbId, DWORD cbId, PFNLOOKUPACCOUNT pfnLookup, TCHAR* szAccount, DWORD cchAccount)
+{
+    ACCOUNTCACHE* pCache = s_pCache;
+    if (!pCache || cbId > CBMaxId)
+        return pfnLookup(pbId, cbId, szAccount, cchAccount);
+
+    TCHAR szKey[2 * CBMaxId + 1];
+    for (DWORD ib = 0; ib < cbId; ib++)
+        sprintf(szKey + 2 * ib, TEXT("%02X"), pbId[ib]);
+    szKey[2 * cbId] = 0;
+
+    DWORD dwError = ERROR_SUCCESS;
+    if (FindCachedAccount(pCache, szKey, szAccount, cchAccount, &dwError))
+        return dwError;
+
+    // one lookup at a time; whoever waited may find it done.
+    EnterCriticalSection(&pCache->csLookup);
+    if (FindCachedAccount(pCache, szKey, szAccount, cchAccount, &dwError))
+    {
+        LeaveCriticalSection(&pCache->csLookup);
+        return dwError;
+    }
+
+    ACCOUNTENTRY* pEntry = (ACCOUNTENTRY*) malloc(sizeof(ACCOUNTENTRY));
+    if (!pEntry)
+    {
+        LeaveCriticalSection(&pCache->csLookup);
+        return pfnLookup(pbId, cbId, szAccount, cchAccount);
+    }
+    lstrcpy(pEntry->szKey, szKey);
+    pEntry->dwError = LookupAccountNow(pbId, cbId, pfnLookup, pCache->dwTimeout, pEntry->szAccount);
+
+    EnterCriticalSection(&pCache->csMap);
+    pCache->cLookups++;
+    bool fAdded = false;
+    if (pCache->cEntries == pCache->cEntriesAllocated)
+    {
+        DWORD cAllocate = (pCache->cEntriesAllocated) ? 2 * pCache->cEntriesAllocated : 16;
+        ACCOUNTENTRY** rgpEntry = (ACCOUNTENTRY**) realloc(pCache->rgpEntry, cAllocate * sizeof(ACCOUNTENTRY*));
+        if (rgpEntry)
+        {
+            pCache->rgpEntry = rgpEntry;
+            pCache->cEntriesAllocated = cAllocate;
+        }
+    }
+    if ((pCache->cEntries < pCache->cEntriesAllocated) && SetStringMapValue(&pCache->Map, pEntry->szKey, pCache->cEntries))
+    {
+        pCache->rgpEntry[pCache->cEntries++] = pEntry;
+        fAdded = true;
+    }
+    LeaveCriticalSection(&pCache->csMap);
+    LeaveCriticalSection(&pCache->csLookup);
+
+    dwError = CopyAccount(pEntry, szAccount, cchAccount);
+    if (!fAdded)
+        free(pEntry);
+    return dwError;
+}
@@ -0,0 +1,38 @@
+/*---------------------------------------------------------------------------
+Account lookup cache.
+
+    Every keypath probe that reads an owner turns a SID into "domain\name"
+    with LookupAccountSid, which can take milliseconds or block on a domain
+    controller - and nearly every keypath on a machine is owned by the same
+    three or four accounts.  The cache keeps each SID's answer for the run,
+    failures included, so a -v run makes a handful of lookups rather than
+    one per keypath.  Off Windows the stand-in file system (standinfs.h)
+    caches uid lookups the same way.
+
+    Lookups that miss are made one at a time, so threads probing at once
+    (-j, -probe) wait for the first lookup of a SID instead of repeating
+    it.  With a timeout a lookup runs on its own thread and is abandoned -
+    reported, and remembered, as ERROR_TIMEOUT - when it takes longer.
+
+    Until InitAccountCache every lookup goes straight to the callback.
+---------------------------------------------------------------------------*/
+
+#ifndef ACCTCACHE_H
+#define ACCTCACHE_H
+
+#include "msiport.h"
+
+// ERROR_SUCCESS with szAccount filled in, or the error the lookup failed with.
+typedef DWORD (*PFNLOOKUPACCOUNT)(const BYTE* pbId, DWORD cbId, TCHAR* szAccount, DWORD cchAccount);
+
+// dwTimeout 0 waits as long as a lookup takes.
+bool  InitAccountCache(DWORD dwTimeout);
+void  FreeAccountCache();
+
+// pbId is the SID (or uid) as bytes; equal bytes are the same account.
+DWORD LookupAccountCached(const BYTE* pbId, DWORD cbId, PFNLOOKUPACCOUNT pfnLookup, TCHAR* szAccount, DWORD cchAccount);
+
+// lookups made, and requests answered from the cache.
+void  GetAccountCacheCounts(DWORD* pcLookups, DWORD* pcHits);
+
+#endif // ACCTCACHE_H
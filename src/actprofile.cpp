@@ -0,0 +1,575 @@
+/*---------------------------------------------------------------------------
+Action profile - see actprofile.h.
+---------------------------------------------------------------------------*/
+
+#include "actprofile.h"
+#include "outsink.h"
+#include <stdlib.h>
+#include <string.h>
+
+const TCHAR* const ActionPhaseNames[cActionPhases] = { TEXT("UI"), TEXT("Execute"), TEXT("Rollback") };
+
+const DWORD MSPerDay = 24 * 60 * 60 * 1000;
+
+struct ACTIONFRAME {
+    TCHAR               szName[CCHActionName];
+    ACTIONPHASE         apPhase;
+    unsigned __int64    msStart;
+    unsigned __int64    msNested;           // wall time of the actions ended inside it
+};
+
+//____________________________________________________________________________
+//
+// The lines
+//____________________________________________________________________________
+
+static bool StartsWith(const TCHAR* sz, const TCHAR* szPrefix)
+{
+    while (*szPrefix)
+    {
+        if (*sz++ != *szPrefix++)
+            return false;
+    }
+    return true;
+}
+
+// "hh:mm:ss" and, with fMilliseconds, ":mmm" after it; *ppch is moved past
+// it.  The time of day in milliseconds, or false.
+static bool ParseClock(const TCHAR** ppch, bool fMilliseconds, DWORD* pmsOfDay)
+{
+    const TCHAR* pch = *ppch;
+    DWORD rgdwPart[4] = { 0, 0, 0, 0 };
+    const DWORD cParts = (fMilliseconds) ? 4 : 3;
+    for (DWORD iPart = 0; iPart < cParts; iPart++)
+    {
+        if (iPart && (':' != *pch++))
+            return false;
+        DWORD cDigits = 0;
+        while ((*pch >= '0') && (*pch <= '9') && (cDigits < 3))
+        {
+            rgdwPart[iPart] = rgdwPart[iPart] * 10 + (*pch++ - '0');
+            cDigits++;
+        }
+        if (!cDigits)
+            return false;
+    }
+    if ((rgdwPart[0] > 23) || (rgdwPart[1] > 59) || (rgdwPart[2] > 59) || (rgdwPart[3] > 999))
+        return false;
+
+    *pmsOfDay = ((rgdwPart[0] * 60 + rgdwPart[1]) * 60 + rgdwPart[2]) * 1000 + rgdwPart[3];
+    *ppch = pch;
+    return true;
+}
+
+unsigned __int64 CActionProfiler::FromTimeOfDay(DWORD msOfDay)
+{
+    unsigned __int64 msTime = m_msDayBase + msOfDay;
+    if (msTime + MSPerDay / 2 < m_msLatest)
+    {
+        // past midnight.
+        m_msDayBase += MSPerDay;
+        msTime += MSPerDay;
+    }
+    if (msTime > m_msLatest)
+        m_msLatest = msTime;
+    return msTime;
+}
+
+unsigned __int64 CActionProfiler::ActionLineTime(DWORD dwSecondOfDay)
+{
+    if (m_fStamp && ((DWORD) ((m_msStamp % MSPerDay) / 1000) == dwSecondOfDay))
+        return m_msStamp;
+    return FromTimeOfDay(dwSecondOfDay * 1000);
+}
+
+void CActionProfiler::Line(const BYTE* pb, size_t cb)
+{
+    // only lines starting "Action", "MSI (" or "Rollback:" say anything; the
+    // rest are passed over on their first character.
+    const DWORD cbChar = (m_fUnicode) ? 2 : 1;
+    if ((cb < cbChar) || (m_fUnicode && pb[1]))
+        return;
+    if (('A' != pb[0]) && ('M' != pb[0]) && ('R' != pb[0]))
+        return;
+
+    TCHAR szLine[CCHProfileLine];
+    DWORD cch = 0;
+    if (m_fUnicode)
+    {
+        for (size_t ib = 0; (ib + 1 < cb) && (cch < CCHProfileLine - 1); ib += 2)
+        {
+            unsigned int ch = pb[ib] | (pb[ib + 1] << 8);
+            szLine[cch++] = (ch < 0x80) ? (TCHAR) ch : '?';
+        }
+    }
+    else
+    {
+        for (size_t ib = 0; (ib < cb) && (cch < CCHProfileLine - 1); ib++)
+            szLine[cch++] = (TCHAR) pb[ib];
+    }
+    while (cch && (('\r' == szLine[cch - 1]) || (' ' == szLine[cch - 1])))
+        cch--;
+    szLine[cch] = 0;
+
+    if (StartsWith(szLine, TEXT("MSI (")))
+    {
+        // MSI (s) (A8:5C) [12:00:01:123]: ...
+        if ('c' == szLine[5])
+            m_apContext = apUI;
+        else if ('s' == szLine[5])
+            m_apContext = apExecute;
+
+        const TCHAR* pch = szLine + 5;
+        while (*pch && ('[' != *pch) && (pch < szLine + 40))
+            pch++;
+        DWORD msOfDay;
+        if ('[' != *pch++ || !ParseClock(&pch, true, &msOfDay) || (']' != *pch))
+            return;
+        m_msStamp = FromTimeOfDay(msOfDay);
+        m_fStamp = true;
+
+        pch++;
+        if (':' == *pch)
+            pch++;
+        if (' ' == *pch)
+            pch++;
+        if (StartsWith(pch, TEXT("Executing op: ActionStart(Name=")))
+        {
+            const TCHAR* pchName = pch + 31;
+            const TCHAR* pchEnd = pchName;
+            while (*pchEnd && (',' != *pchEnd) && (')' != *pchEnd))
+                pchEnd++;
+            ScriptActionStart(m_msStamp, pchName, (DWORD) (pchEnd - pchName));
+        }
+        else if (StartsWith(pch, TEXT("Executing op: End(")))
+        {
+            if (m_fScript)
+                ScriptActionEnded(m_msStamp);
+        }
+    }
+    else if (StartsWith(szLine, TEXT("Action start ")) || StartsWith(szLine, TEXT("Action ended ")))
+    {
+        // Action start 12:00:01: InstallFiles.
+        // Action ended 12:00:09: InstallFiles. Return value 1.
+        bool fStart = ('s' == szLine[7]);
+        const TCHAR* pch = szLine + 13;
+        DWORD msOfDay;
+        if (!ParseClock(&pch, false, &msOfDay) || (':' != pch[0]) || (' ' != pch[1]))
+            return;
+        pch += 2;
+
+        // names may have periods in them; the name is all of what is left but the last.
+        const TCHAR* pchEnd = szLine + cch;
+        if (!fStart)
+        {
+            const TCHAR* pchReturn = strstr(pch, TEXT(". Return value"));
+            if (pchReturn)
+                pchEnd = pchReturn + 1;
+        }
+        if ((pchEnd > pch) && ('.' == pchEnd[-1]))
+            pchEnd--;
+        if (pchEnd == pch)
+            return;
+
+        unsigned __int64 msTime = ActionLineTime(msOfDay / 1000);
+        if (fStart)
+            ActionStart(msTime, pch, (DWORD) (pchEnd - pch));
+        else
+            ActionEnded(msTime, pch, (DWORD) (pchEnd - pch));
+    }
+    else if (StartsWith(szLine, TEXT("Rollback: ")))
+    {
+        if (m_fScript)
+            m_rgFrame[CActionDepth].apPhase = apRollback;
+    }
+}
+
+//____________________________________________________________________________
+//
+// The stack
+//____________________________________________________________________________
+
+static void CopyActionName(TCHAR* szName, const TCHAR* pchName, DWORD cchName)
+{
+    if (cchName > CCHActionName - 1)
+        cchName = CCHActionName - 1;
+    memcpy(szName, pchName, cchName * sizeof(TCHAR));
+    szName[cchName] = 0;
+}
+
+void CActionProfiler::ActionStart(unsigned __int64 msTime, const TCHAR* pchName, DWORD cchName)
+{
+    if (m_cFrames == CActionDepth)
+    {
+        m_cUnended++;
+        return;
+    }
+
+    ACTIONFRAME& Frame = m_rgFrame[m_cFrames++];
+    CopyActionName(Frame.szName, pchName, cchName);
+    Frame.apPhase = m_apContext;
+    Frame.msStart = msTime;
+    Frame.msNested = 0;
+    if (m_cFrames > m_cDeepest)
+        m_cDeepest = m_cFrames;
+}
+
+void CActionProfiler::ActionEnded(unsigned __int64 msTime, const TCHAR* pchName, DWORD cchName)
+{
+    // whatever script the action ran is over.
+    if (m_fScript)
+        ScriptActionEnded(msTime);
+
+    TCHAR szName[CCHActionName];
+    CopyActionName(szName, pchName, cchName);
+
+    DWORD iFrame = m_cFrames;
+    while (iFrame && (0 != lstrcmp(m_rgFrame[iFrame - 1].szName, szName)))
+        iFrame--;
+    if (!iFrame)
+    {
+        m_cUnstarted++;
+        return;
+    }
+    iFrame--;
+
+    // anything started inside it and not ended never will be; what ended
+    // inside those was timed, and is not its self time either.
+    m_cUnended += m_cFrames - 1 - iFrame;
+    for (DWORD iInside = iFrame + 1; iInside < m_cFrames; iInside++)
+        m_rgFrame[iFrame].msNested += m_rgFrame[iInside].msNested;
+    m_cFrames = iFrame;
+
+    const ACTIONFRAME& Frame = m_rgFrame[iFrame];
+    unsigned __int64 msWall = (msTime > Frame.msStart) ? msTime - Frame.msStart : 0;
+    unsigned __int64 msSelf = (msWall > Frame.msNested) ? msWall - Frame.msNested : 0;
+    Record(Frame.apPhase, Frame.szName, msWall, msSelf);
+    if (iFrame)
+        m_rgFrame[iFrame - 1].msNested += msWall;
+}
+
+void CActionProfiler::ScriptActionStart(unsigned __int64 msTime, const TCHAR* pchName, DWORD cchName)
+{
+    if (m_fScript)
+        ScriptActionEnded(msTime);
+
+    ACTIONFRAME& Frame = m_rgFrame[CActionDepth];
+    CopyActionName(Frame.szName, pchName, cchName);
+    Frame.apPhase = apExecute;
+    Frame.msStart = msTime;
+    Frame.msNested = 0;
+    m_fScript = true;
+}
+
+void CActionProfiler::ScriptActionEnded(unsigned __int64 msTime)
+{
+    const ACTIONFRAME& Frame = m_rgFrame[CActionDepth];
+    unsigned __int64 msWall = (msTime > Frame.msStart) ? msTime - Frame.msStart : 0;
+    Record(Frame.apPhase, Frame.szName, msWall, msWall);
+    if (m_cFrames)
+        m_rgFrame[m_cFrames - 1].msNested += msWall;
+    m_fScript = false;
+}
+
+void CActionProfiler::Record(ACTIONPHASE ap, const TCHAR* szName, unsigned __int64 msWall, unsigned __int64 msSelf)
+{
+    m_cRuns++;
+    m_rgcPhaseRuns[ap]++;
+    m_rgmsPhase[ap] += msSelf;
+
+    // the same name in two phases is two rows.
+    TCHAR szKey[CCHActionName + 1];
+    szKey[0] = (TCHAR) ('0' + ap);
+    lstrcpy(szKey + 1, szName);
+
+    DWORD iAction;
+    if (!m_fMap || !FindStringMapValue(&m_ActionMap, szKey, &iAction))
+    {
+        if (!m_fMap)
+        {
+            if (!InitStringMap(&m_ActionMap, 256, true))
+            {
+                m_fOutOfMemory = true;
+                return;
+            }
+            m_fMap = true;
+        }
+        if (m_cActions == m_cActionsAllocated)
+        {
+            DWORD cAllocate = (m_cActionsAllocated) ? m_cActionsAllocated * 2 : 256;
+            ACTIONPROFILE* rgAction = (ACTIONPROFILE*) realloc(m_rgAction, cAllocate * sizeof(ACTIONPROFILE));
+            if (!rgAction)
+            {
+                m_fOutOfMemory = true;
+                return;
+            }
+            m_rgAction = rgAction;
+            m_cActionsAllocated = cAllocate;
+        }
+        DWORD cchKey = lstrlen(szKey);
+        TCHAR* szCopy = m_Arena.Alloc(cchKey + 1);
+        if (szCopy)
+            memcpy(szCopy, szKey, (cchKey + 1) * sizeof(TCHAR));
+        if (!szCopy || !SetStringMapValue(&m_ActionMap, szCopy, m_cActions))
+        {
+            m_fOutOfMemory = true;
+            return;
+        }
+
+        iAction = m_cActions++;
+        ACTIONPROFILE& Action = m_rgAction[iAction];
+        memset(&Action, 0, sizeof(Action));
+        Action.szName = szCopy + 1;
+        Action.apPhase = ap;
+    }
+
+    ACTIONPROFILE& Action = m_rgAction[iAction];
+    Action.cRuns++;
+    Action.msTotal += msWall;
+    Action.msSelf += msSelf;
+    if (msWall > Action.msLongest)
+        Action.msLongest = (msWall > 0xffffffff) ? 0xffffffff : (DWORD) msWall;
+}
+
+//____________________________________________________________________________
+//
+// The profiler
+//____________________________________________________________________________
+
+CActionProfiler::CActionProfiler()
+    : m_pbBuffer(NULL), m_rgFrame(NULL), m_cFrames(0), m_fScript(false),
+      m_apContext(apExecute), m_fStamp(false), m_msStamp(0), m_msDayBase(0), m_msLatest(0),
+      m_rgAction(NULL), m_cActions(0), m_cActionsAllocated(0), m_fMap(false),
+      m_cLines(0), m_cbRead(0), m_fUnicode(false), m_cRuns(0), m_cUnended(0), m_cUnstarted(0),
+      m_cDeepest(0), m_fOutOfMemory(false)
+{
+    memset(&m_ActionMap, 0, sizeof(m_ActionMap));
+    memset(m_rgcPhaseRuns, 0, sizeof(m_rgcPhaseRuns));
+    memset(m_rgmsPhase, 0, sizeof(m_rgmsPhase));
+}
+
+CActionProfiler::~CActionProfiler()
+{
+    free(m_pbBuffer);
+    free(m_rgFrame);
+    free(m_rgAction);
+    if (m_fMap)
+        FreeStringMap(&m_ActionMap);
+}
+
+UINT CActionProfiler::ProfileFile(const TCHAR* szFile)
+{
+    FILE* pFile = fopen(szFile, TEXT("rb"));
+    if (!pFile)
+        return ERROR_FILE_NOT_FOUND;
+    UINT uiResult = ProfileStream(pFile);
+    fclose(pFile);
+    return uiResult;
+}
+
+UINT CActionProfiler::ProfileStream(FILE* pFile)
+{
+    m_pbBuffer = (BYTE*) malloc(CBProfileBuffer);
+    m_rgFrame = (ACTIONFRAME*) malloc((CActionDepth + 1) * sizeof(ACTIONFRAME));
+    if (!m_pbBuffer || !m_rgFrame)
+        return ERROR_NOT_ENOUGH_MEMORY;
+
+    // lines are cut out of the buffer where they end; the piece of a line
+    // left at the end of the buffer moves to the front before the next read.
+    // A line the whole buffer cannot hold is parsed by its start, and the
+    // rest of it skipped.
+    size_t cbHeld = 0;
+    bool fFirst = true;
+    bool fSkipping = false;
+    DWORD cbChar = 1;
+    for (;;)
+    {
+        size_t cbGot = fread(m_pbBuffer + cbHeld, 1, CBProfileBuffer - cbHeld, pFile);
+        m_cbRead += cbGot;
+        size_t cbData = cbHeld + cbGot;
+        size_t ibLine = 0;
+
+        if (fFirst && (cbData >= 2))
+        {
+            fFirst = false;
+            if ((0xff == m_pbBuffer[0]) && (0xfe == m_pbBuffer[1]))
+            {
+                m_fUnicode = true;
+                cbChar = 2;
+                ibLine = 2;
+            }
+            else if ((cbData >= 3) && (0xef == m_pbBuffer[0]) && (0xbb == m_pbBuffer[1]) && (0xbf == m_pbBuffer[2]))
+            {
+                ibLine = 3;
+            }
+        }
+
+        for (;;)
+        {
+            size_t ibNewline;
+            if (m_fUnicode)
+            {
+                ibNewline = ibLine;
+                while ((ibNewline + 1 < cbData) && !(('\n' == m_pbBuffer[ibNewline]) && (0 == m_pbBuffer[ibNewline + 1])))
+                    ibNewline += 2;
+                if (ibNewline + 1 >= cbData)
+                    break;
+            }
+            else
+            {
+                const BYTE* pbNewline = (const BYTE*) memchr(m_pbBuffer + ibLine, '\n', cbData - ibLine);
+                if (!pbNewline)
+                    break;
+                ibNewline = pbNewline - m_pbBuffer;
+            }
+
+            if (fSkipping)
+                fSkipping = false;
+            else
+                Line(m_pbBuffer + ibLine, ibNewline - ibLine);
+            m_cLines++;
+            ibLine = ibNewline + cbChar;
+        }
+
+        size_t cbRest = cbData - ibLine;
+        if (0 == cbGot)
+        {
+            // the last line, with no newline after it.
+            if (cbRest && !fSkipping)
+            {
+                Line(m_pbBuffer + ibLine, cbRest);
+                m_cLines++;
+            }
+            break;
+        }
+        if (cbRest == CBProfileBuffer)
+        {
+            if (!fSkipping)
+                Line(m_pbBuffer, cbRest);
+            fSkipping = true;
+            cbRest = 0;
+        }
+        else if (cbRest)
+        {
+            memmove(m_pbBuffer, m_pbBuffer + ibLine, cbRest);
+        }
+        cbHeld = cbRest;
+    }
+
+    if (ferror(pFile))
+        return ERROR_READ_FAULT;
+
+    // what is still running at the end never ended.
+    m_cUnended += OpenCount();
+    return (m_fOutOfMemory) ? ERROR_NOT_ENOUGH_MEMORY : ERROR_SUCCESS;
+}
+
+const TCHAR* CActionProfiler::OpenActionName(DWORD iOpen) const
+{
+    return m_rgFrame[(iOpen < m_cFrames) ? iOpen : CActionDepth].szName;
+}
+
+ACTIONPHASE CActionProfiler::OpenActionPhase(DWORD iOpen) const
+{
+    return m_rgFrame[(iOpen < m_cFrames) ? iOpen : CActionDepth].apPhase;
+}
+
+struct ACTIONSORT {
+    unsigned __int64    msTotal;
+    DWORD               iAction;
+};
+
+static int __cdecl CompareWallTime(const void* pv1, const void* pv2)
+{
+    const ACTIONSORT* p1 = (const ACTIONSORT*) pv1;
+    const ACTIONSORT* p2 = (const ACTIONSORT*) pv2;
+    if (p1->msTotal != p2->msTotal)
+        return (p1->msTotal > p2->msTotal) ? -1 : 1;
+    return (p1->iAction < p2->iAction) ? -1 : (p1->iAction > p2->iAction) ? 1 : 0;
+}
+
+DWORD* CActionProfiler::SortByWallTime() const
+{
+    DWORD* rgiAction = (DWORD*) malloc((m_cActions + 1) * sizeof(DWORD));
+    ACTIONSORT* rgSort = (ACTIONSORT*) malloc((m_cActions + 1) * sizeof(ACTIONSORT));
+    if (!rgiAction || !rgSort)
+    {
+        free(rgiAction);
+        free(rgSort);
+        return NULL;
+    }
+    for (DWORD iAction = 0; iAction < m_cActions; iAction++)
+    {
+        rgSort[iAction].msTotal = m_rgAction[iAction].msTotal;
+        rgSort[iAction].iAction = iAction;
+    }
+    qsort(rgSort, m_cActions, sizeof(ACTIONSORT), CompareWallTime);
+    for (DWORD iAction = 0; iAction < m_cActions; iAction++)
+        rgiAction[iAction] = rgSort[iAction].iAction;
+    free(rgSort);
+    return rgiAction;
+}
+
+size_t CActionProfiler::BytesHeld() const
+{
+    return ((m_pbBuffer) ? CBProfileBuffer : 0) + ((m_rgFrame) ? (CActionDepth + 1) * sizeof(ACTIONFRAME) : 0) +
+           m_cActionsAllocated * sizeof(ACTIONPROFILE) + m_ActionMap.cSlots * (sizeof(TCHAR*) + sizeof(DWORD)) +
+           m_Arena.BlockCount() * CCHArenaBlock * sizeof(TCHAR);
+}
+
+//____________________________________________________________________________
+//
+// -profile
+//____________________________________________________________________________
+
+static double Seconds(unsigned __int64 ms)
+{
+    return (double) ms / 1000.0;
+}
+
+int ProfileInstallLog(const TCHAR* szFile, DWORD cTop)
+{
+    CActionProfiler Profiler;
+    UINT uiResult = Profiler.ProfileFile(szFile);
+    if (ERROR_SUCCESS != uiResult)
+    {
+        fprintf(stderr, TEXT("Cannot read log %s: %d\n"), szFile, uiResult);
+        return 1;
+    }
+
+    g_Out.Printf(TEXT("Action profile of %s\n"), szFile);
+    g_Out.Printf(TEXT("\t%llu lines, %llu bytes%s; %u action run%s timed, nested %u deep.\n"),
+        Profiler.LineCount(), Profiler.BytesRead(), (Profiler.IsUnicode()) ? TEXT(" (UTF-16)") : TEXT(""),
+        Profiler.RunCount(), (1 == Profiler.RunCount()) ? TEXT("") : TEXT("s"), Profiler.DeepestNesting());
+    if (Profiler.UnendedCount() || Profiler.UnstartedCount())
+        g_Out.Printf(TEXT("\t%u action%s started and never ended; %u ended and never started.\n"),
+            Profiler.UnendedCount(), (1 == Profiler.UnendedCount()) ? TEXT("") : TEXT("s"), Profiler.UnstartedCount());
+    for (DWORD iOpen = 0; iOpen < Profiler.OpenCount(); iOpen++)
+        g_Out.Printf(TEXT("\tStill running at the end of the log: %s (%s)\n"), Profiler.OpenActionName(iOpen),
+            ActionPhaseNames[Profiler.OpenActionPhase(iOpen)]);
+
+    g_Out.Printf(TEXT("\n\t%-10s %8s %12s\n"), TEXT("Phase"), TEXT("Runs"), TEXT("Seconds"));
+    for (int ap = 0; ap < cActionPhases; ap++)
+        g_Out.Printf(TEXT("\t%-10s %8u %12.3f\n"), ActionPhaseNames[ap], Profiler.PhaseRuns((ACTIONPHASE) ap),
+            Seconds(Profiler.PhaseTime((ACTIONPHASE) ap)));
+
+    DWORD* rgiAction = Profiler.SortByWallTime();
+    if (!rgiAction)
+    {
+        g_Out.Flush();
+        fprintf(stderr, TEXT("Out of memory sorting the actions of %s.\n"), szFile);
+        return 1;
+    }
+    DWORD cListed = (cTop < Profiler.ActionCount()) ? cTop : Profiler.ActionCount();
+    g_Out.Printf(TEXT("\nThe %u longest action%s, by wall time:\n"), cListed, (1 == cListed) ? TEXT("") : TEXT("s"));
+    g_Out.Printf(TEXT("\t%12s %12s %12s %6s  %-10s %s\n"), TEXT("Seconds"), TEXT("Self"), TEXT("Longest"), TEXT("Runs"),
+        TEXT("Phase"), TEXT("Action"));
+    for (DWORD iListed = 0; iListed < cListed; iListed++)
+    {
+        const ACTIONPROFILE& Action = Profiler.Action(rgiAction[iListed]);
+        g_Out.Printf(TEXT("\t%12.3f %12.3f %12.3f %6u  %-10s %s\n"), Seconds(Action.msTotal), Seconds(Action.msSelf),
+            Seconds(Action.msLongest), Action.cRuns, ActionPhaseNames[Action.apPhase], Action.szName);
+    }
+    free(rgiAction);
+    return 0;
+}
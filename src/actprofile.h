@@ -0,0 +1,154 @@
+/*---------------------------------------------------------------------------
+Action profile (-profile).
+
+    When an install is slow the question is which action took the time.
+    A verbose log (msiexec /l*v) says when each action started and ended:
+
+        Action start 12:00:01: InstallFiles.
+        Action ended 12:00:09: InstallFiles. Return value 1.
+
+    and -profile reads one and reports the actions that took longest, and
+    how the time divides between the phases:
+
+        UI          actions the client ran, under MSI (c)
+        Execute     actions the server ran, under MSI (s), and the
+                    deferred actions of the install script
+        Rollback    script actions run again to undo a failed install
+
+    The log is read once, front to back, through one buffer, so a log of
+    many gigabytes takes no more memory than a small one: the buffer, the
+    stack of actions started and not yet ended, and a row per distinct
+    action.  Starts and ends are matched on the stack by name, and an
+    action's self time is its wall time less the actions nested in it, so
+    the phase totals count every moment once.
+
+    The times on Action lines are to the second.  Each is taken to the
+    millisecond from the [hh:mm:ss:mmm] of the MSI (c)/(s) line before it
+    when the two agree on the second, which they do in logs of Windows
+    Installer 3 on; a time earlier than the one before by more than twelve
+    hours has crossed midnight.
+
+    Script actions have no Action start line of their own.  Each begins at
+    its "Executing op: ActionStart(Name=..." and ends at the next, at the
+    script's End op, or at the Action ended of the action running the
+    script; a "Rollback:" line under it makes it a rollback action.
+
+    Logs written as UTF-16 (a byte order mark at the start) are read as
+    UTF-16.
+---------------------------------------------------------------------------*/
+
+#ifndef ACTPROFILE_H
+#define ACTPROFILE_H
+
+#include "msiport.h"
+#include "strarena.h"
+#include "strmap.h"
+#include <stdio.h>
+
+const DWORD CBProfileBuffer = 1024 * 1024;
+const DWORD CCHProfileLine = 1024;          // of a line, what is parsed; the rest is skipped
+const DWORD CCHActionName = 128;
+const DWORD CActionDepth = 64;              // nesting past this is not believed
+const DWORD CProfileTopDefault = 20;
+
+enum ACTIONPHASE {
+    apUI,
+    apExecute,
+    apRollback,
+    cActionPhases
+};
+
+extern const TCHAR* const ActionPhaseNames[cActionPhases];     // "UI", "Execute", "Rollback"
+
+// one action name in one phase, over every run of it in the log.
+struct ACTIONPROFILE {
+    const TCHAR*        szName;
+    ACTIONPHASE         apPhase;
+    DWORD               cRuns;
+    unsigned __int64    msTotal;            // wall time
+    unsigned __int64    msSelf;             // less the actions nested in it
+    DWORD               msLongest;          // of one run
+};
+
+struct ACTIONFRAME;
+
+class CActionProfiler
+{
+public:
+    CActionProfiler();
+    ~CActionProfiler();
+
+    // reads szFile through, once.  ERROR_SUCCESS, or why it could not be read.
+    UINT  ProfileFile(const TCHAR* szFile);
+    // the same over an open stream, for -bench profile.
+    UINT  ProfileStream(FILE* pFile);
+
+    DWORD ActionCount() const           { return m_cActions; }
+    const ACTIONPROFILE& Action(DWORD iAction) const   { return m_rgAction[iAction]; }
+    // indexes of the actions, longest wall time first; NULL when out of memory.
+    // malloc'd; free() it.
+    DWORD* SortByWallTime() const;
+
+    DWORD PhaseRuns(ACTIONPHASE ap) const               { return m_rgcPhaseRuns[ap]; }
+    unsigned __int64 PhaseTime(ACTIONPHASE ap) const    { return m_rgmsPhase[ap]; }
+
+    unsigned __int64 LineCount() const  { return m_cLines; }
+    unsigned __int64 BytesRead() const  { return m_cbRead; }
+    bool  IsUnicode() const             { return m_fUnicode; }
+    DWORD RunCount() const              { return m_cRuns; }
+    DWORD UnendedCount() const          { return m_cUnended; }      // started, never ended
+    DWORD UnstartedCount() const        { return m_cUnstarted; }    // ended, never started
+    DWORD DeepestNesting() const        { return m_cDeepest; }
+    // the actions still running at the end of the log, outermost first, and
+    // the script action last.  A profiler reads one log.
+    DWORD OpenCount() const             { return m_cFrames + ((m_fScript) ? 1 : 0); }
+    const TCHAR* OpenActionName(DWORD iOpen) const;
+    ACTIONPHASE OpenActionPhase(DWORD iOpen) const;
+    // memory held for the profile: the buffer, the stack and the table.
+    size_t BytesHeld() const;
+
+private:
+    void  Line(const BYTE* pb, size_t cb);
+    void  ActionStart(unsigned __int64 msTime, const TCHAR* pchName, DWORD cchName);
+    void  ActionEnded(unsigned __int64 msTime, const TCHAR* pchName, DWORD cchName);
+    void  ScriptActionStart(unsigned __int64 msTime, const TCHAR* pchName, DWORD cchName);
+    void  ScriptActionEnded(unsigned __int64 msTime);
+    void  Record(ACTIONPHASE ap, const TCHAR* szName, unsigned __int64 msWall, unsigned __int64 msSelf);
+    unsigned __int64 FromTimeOfDay(DWORD msOfDay);
+    unsigned __int64 ActionLineTime(DWORD dwSecondOfDay);
+
+    BYTE*           m_pbBuffer;
+    ACTIONFRAME*    m_rgFrame;              // CActionDepth, and the script action after them
+    DWORD           m_cFrames;
+    bool            m_fScript;              // a script action is running
+
+    ACTIONPHASE     m_apContext;            // MSI (c) or MSI (s), whichever came last
+    bool            m_fStamp;
+    unsigned __int64 m_msStamp;             // the last [hh:mm:ss:mmm]
+    unsigned __int64 m_msDayBase;
+    unsigned __int64 m_msLatest;
+
+    ACTIONPROFILE*  m_rgAction;
+    DWORD           m_cActions;
+    DWORD           m_cActionsAllocated;
+    STRINGMAP       m_ActionMap;            // "<phase><name>" to its row
+    bool            m_fMap;
+    CStringArena    m_Arena;
+
+    DWORD           m_rgcPhaseRuns[cActionPhases];
+    unsigned __int64 m_rgmsPhase[cActionPhases];
+    unsigned __int64 m_cLines;
+    unsigned __int64 m_cbRead;
+    bool            m_fUnicode;
+    DWORD           m_cRuns;
+    DWORD           m_cUnended;
+    DWORD           m_cUnstarted;
+    DWORD           m_cDeepest;
+    bool            m_fOutOfMemory;
+};
+
+// -profile: the report on szFile's actions, the cTop longest of them listed.
+// The exit code; messages go to stderr.
+int   ProfileInstallLog(const TCHAR* szFile, DWORD cTop);
+
+#endif // ACTPROFILE_H
@@ -0,0 +1,2374 @@
+/*---------------------------------------------------------------------------
+Benchmarks - see bench.h.
+---------------------------------------------------------------------------*/
+
+#include "bench.h"
+#include "compindex.h"
+#include "guidset.h"
+#include "replay.h"
+#include "binsnap.h"
+#include "enrich.h"
+#include "probepool.h"
+#include "standinfs.h"
+#include "outsink.h"
+#include "prodfilter.h"
+#include "eventlog.h"
+#include "eventjoin.h"
+#include "logscan.h"
+#include "actprofile.h"
+#include "callcount.h"
+#include "keypath.h"
+#include "peimage.h"
+#include "standinreg.h"
+#include "dircache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static double SecondsNow()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void PrintInventory(const TCHAR* szCase, const TCHAR* szDescription, const SYNTHETICCONFIG& config)
+{
+    printf(TEXT("%s: %s\n"), szCase, szDescription);
+    printf(TEXT("\t%u products, %u components, %u clients per shared component, %u features per product\n"),
+        config.cProducts, config.cComponents, config.cClientsPerComponent, config.cFeaturesPerProduct);
+    if (config.cPatchesPerProduct || config.cQualifiersPerComponent || config.dwKeyPathLatency)
+        printf(TEXT("\t%u patches per product, %u qualifiers per qualified component, %ums per keypath probe\n"),
+            config.cPatchesPerProduct, config.cQualifiersPerComponent, config.dwKeyPathLatency);
+}
+
+//____________________________________________________________________________
+//
+// parent - the orphaned/shared evaluation's "is this client installed" check.
+//     before: MsiEnumProducts from the top for every client of every component.
+//     after:  products loaded once into a GUIDSET.
+//____________________________________________________________________________
+
+static void BenchParentLookup(const SYNTHETICCONFIG& config)
+{
+    CSyntheticInstallerData InstallerData(config);
+    COMPONENTINDEX Index;
+    TCHAR szProduct[CCHGuid] = TEXT("");
+
+    PrintInventory(TEXT("parent"), TEXT("parent product check in component evaluation (-x -m -c)"), config);
+
+    if (ERROR_SUCCESS != BuildComponentIndex(&InstallerData, &Index))
+    {
+        printf(TEXT("\tout of memory building the component index\n"));
+        return;
+    }
+
+    // the rescan is O(components x clients x products); only time a prefix of it.
+    const DWORD cSampleComponents = (Index.cComponents < 1000) ? Index.cComponents : 1000;
+    const DWORD cSampleClients = Index.rgiFirstClient[cSampleComponents];
+
+    double dStart = SecondsNow();
+    unsigned __int64 cRescanCalls = 0;
+    DWORD cRescanParented = 0;
+    for (DWORD iComponent = 0; iComponent < cSampleComponents; iComponent++)
+    {
+        bool fParentFound = false;
+        for (DWORD iClient = Index.rgiFirstClient[iComponent]; iClient < Index.rgiFirstClient[iComponent + 1]; iClient++)
+        {
+            DWORD iProductIndex = 0;
+            while (cRescanCalls++, ERROR_SUCCESS == InstallerData.EnumProducts(iProductIndex++, szProduct))
+            {
+                if (0 == _stricmp(szProduct, Index.rgClients[iClient].szClient))
+                    fParentFound = true;
+            }
+        }
+        if (fParentFound)
+            cRescanParented++;
+    }
+    double dRescanSample = SecondsNow() - dStart;
+
+    double dScale = (cSampleClients) ? double(Index.cClients) / double(cSampleClients) : 1.0;
+    double dRescan = dRescanSample * dScale;
+    double dRescanCalls = double(cRescanCalls) * dScale;
+
+    dStart = SecondsNow();
+    GUIDSET ProductSet;
+    DWORD cSetParented = 0;
+    DWORD cSetParentedInSample = 0;
+    unsigned __int64 cSetCalls = (unsigned __int64) config.cProducts + 1;
+    if (ERROR_SUCCESS != LoadProductSet(&InstallerData, &ProductSet))
+    {
+        printf(TEXT("\tout of memory loading the product set\n"));
+        FreeComponentIndex(&Index);
+        return;
+    }
+    for (DWORD iComponent = 0; iComponent < Index.cComponents; iComponent++)
+    {
+        bool fParentFound = false;
+        for (DWORD iClient = Index.rgiFirstClient[iComponent]; iClient < Index.rgiFirstClient[iComponent + 1]; iClient++)
+        {
+            if (IsGuidKeyInSet(&ProductSet, Index.rgClients[iClient].ClientKey))
+                fParentFound = true;
+        }
+        if (fParentFound)
+        {
+            cSetParented++;
+            if (iComponent < cSampleComponents)
+                cSetParentedInSample++;
+        }
+    }
+    double dSet = SecondsNow() - dStart;
+
+    printf(TEXT("\t%-24s %16s %12s\n"), TEXT(""), TEXT("installer calls"), TEXT("seconds"));
+    printf(TEXT("\t%-24s %16.0f %12.3f"), TEXT("rescan products"), dRescanCalls, dRescan);
+    if (cSampleComponents < Index.cComponents)
+        printf(TEXT("   (timed over %u of %u components, scaled)"), cSampleComponents, Index.cComponents);
+    printf(TEXT("\n"));
+    printf(TEXT("\t%-24s %16llu %12.3f\n"), TEXT("product hash set"), (unsigned long long) cSetCalls, dSet);
+    printf(TEXT("\t%-24s %15.0fx\n"), TEXT("speedup"), (dSet > 0) ? dRescan / dSet : 0.0);
+    printf(TEXT("\t%u of %u components have an installed parent; rescan and hash set %s on the timed prefix.\n\n"),
+        cSetParented, Index.cComponents, (cRescanParented == cSetParentedInSample) ? TEXT("agree") : TEXT("DISAGREE"));
+
+    FreeGuidSet(&ProductSet);
+    FreeComponentIndex(&Index);
+}
+
+//____________________________________________________________________________
+//
+// replay - how many recorded machines a box can report on.
+//     One snapshot is recorded from the synthetic inventory, then loaded and
+//     walked the way the verbose product report walks it: every product's
+//     properties and features, every component's clients, paths and keypaths.
+//____________________________________________________________________________
+
+static DWORD WalkInventory(CInstallerData* pInstallerData)
+{
+    DWORD cCalls = 0;
+    TCHAR szProduct[CCHGuid];
+    TCHAR szValue[MAX_PATH];
+    TCHAR szParent[MAX_PATH];
+    DWORD cchValue;
+
+    DWORD iProductIndex = 0;
+    while (cCalls++, ERROR_SUCCESS == pInstallerData->EnumProducts(iProductIndex++, szProduct))
+    {
+        cCalls++;
+        pInstallerData->QueryProductState(szProduct);
+
+        cchValue = MAX_PATH;
+        cCalls++;
+        pInstallerData->GetProductInfo(szProduct, INSTALLPROPERTY_PRODUCTNAME, szValue, &cchValue);
+
+        DWORD iFeatureIndex = 0;
+        while (cCalls++, ERROR_SUCCESS == pInstallerData->EnumFeatures(szProduct, iFeatureIndex++, szValue, szParent))
+        {
+            DWORD dwUseCount;
+            WORD wDateUsed;
+            cCalls += 2;
+            pInstallerData->QueryFeatureState(szProduct, szValue);
+            pInstallerData->GetFeatureUsage(szProduct, szValue, &dwUseCount, &wDateUsed);
+        }
+    }
+
+    TCHAR szComponent[CCHGuid];
+    KEYPATHPROBE Probe;
+    DWORD iComponentIndex = 0;
+    while (cCalls++, ERROR_SUCCESS == pInstallerData->EnumComponents(iComponentIndex++, szComponent))
+    {
+        DWORD iClientIndex = 0;
+        while (cCalls++, ERROR_SUCCESS == pInstallerData->EnumClients(szComponent, iClientIndex++, szProduct))
+        {
+            cchValue = MAX_PATH;
+            cCalls++;
+            if (INSTALLSTATE_LOCAL == pInstallerData->GetComponentPath(szProduct, szComponent, szValue, &cchValue))
+            {
+                cCalls++;
+                pInstallerData->ProbeKeyPath(szValue, &Probe);
+            }
+        }
+    }
+    return cCalls;
+}
+
+static void BenchReplay(const SYNTHETICCONFIG& config)
+{
+    static const TCHAR szSnapshot[] = TEXT("msiinv-bench.snapshot");
+    CSyntheticInstallerData InstallerData(config);
+
+    PrintInventory(TEXT("replay"), TEXT("load and walk a recorded snapshot (-replay)"), config);
+
+    double dStart = SecondsNow();
+    UINT uiResult = CaptureInventory(&InstallerData, szSnapshot);
+    double dRecord = SecondsNow() - dStart;
+    if (ERROR_SUCCESS != uiResult)
+    {
+        printf(TEXT("\tcannot write %s: %d\n\n"), szSnapshot, uiResult);
+        return;
+    }
+
+    const int cRuns = 20;
+    double dLoad = 0;
+    double dWalk = 0;
+    DWORD cCalls = 0;
+    for (int iRun = 0; iRun < cRuns && ERROR_SUCCESS == uiResult; iRun++)
+    {
+        CReplayInstallerData Replay;
+        dStart = SecondsNow();
+        uiResult = Replay.Load(szSnapshot);
+        double dLoaded = SecondsNow();
+        if (ERROR_SUCCESS == uiResult)
+            cCalls = WalkInventory(&Replay);
+        dLoad += dLoaded - dStart;
+        dWalk += SecondsNow() - dLoaded;
+    }
+    remove(szSnapshot);
+
+    if (ERROR_SUCCESS != uiResult)
+    {
+        printf(TEXT("\tcannot read %s back: %d\n\n"), szSnapshot, uiResult);
+        return;
+    }
+
+    double dPerSnapshot = (dLoad + dWalk) / cRuns;
+    printf(TEXT("\t%-24s %12.3f seconds\n"), TEXT("record"), dRecord);
+    printf(TEXT("\t%-24s %12.3f seconds per snapshot\n"), TEXT("load"), dLoad / cRuns);
+    printf(TEXT("\t%-24s %12.3f seconds per snapshot, %u installer calls\n"), TEXT("walk"), dWalk / cRuns, cCalls);
+    printf(TEXT("\t%-24s %12.0f snapshots per minute\n\n"), TEXT("throughput"), (dPerSnapshot > 0) ? 60.0 / dPerSnapshot : 0.0);
+}
+
+//____________________________________________________________________________
+//
+// snapshot - opening a binary snapshot against loading the text one.
+//     Both are written from the same inventory.  The text snapshot has to
+//     be parsed into tables before a question can be asked of it; the
+//     binary one is mapped and queried in place: every client edge is
+//     checked for an installed product and every product code is looked
+//     up through the sorted column.
+//____________________________________________________________________________
+
+static long FileBytes(const TCHAR* szFile)
+{
+    FILE* pFile = fopen(szFile, TEXT("rb"));
+    if (!pFile)
+        return 0;
+    fseek(pFile, 0, SEEK_END);
+    long cbFile = ftell(pFile);
+    fclose(pFile);
+    return cbFile;
+}
+
+static void BenchBinarySnapshot(const SYNTHETICCONFIG& config)
+{
+    static const TCHAR szText[] = TEXT("msiinv-bench.snapshot");
+    static const TCHAR szBinary[] = TEXT("msiinv-bench.bin");
+    CSyntheticInstallerData InstallerData(config);
+
+    PrintInventory(TEXT("snapshot"), TEXT("open a binary snapshot (-o) against loading the text one"), config);
+
+    double dStart = SecondsNow();
+    UINT uiResult = CaptureInventory(&InstallerData, szText);
+    double dRecordText = SecondsNow() - dStart;
+    dStart = SecondsNow();
+    if (ERROR_SUCCESS == uiResult)
+        uiResult = WriteBinarySnapshot(&InstallerData, szBinary);
+    double dRecordBinary = SecondsNow() - dStart;
+    if (ERROR_SUCCESS != uiResult)
+    {
+        printf(TEXT("\tcannot write snapshots: %d\n\n"), uiResult);
+        remove(szText);
+        remove(szBinary);
+        return;
+    }
+
+    const int cRuns = 5;
+    double dLoadText = 0;
+    for (int iRun = 0; iRun < cRuns && ERROR_SUCCESS == uiResult; iRun++)
+    {
+        CReplayInstallerData Replay;
+        dStart = SecondsNow();
+        uiResult = Replay.Load(szText);
+        dLoadText += SecondsNow() - dStart;
+    }
+
+    double dOpen = 0;
+    double dQuery = 0;
+    DWORD cOrphanEdges = 0;
+    DWORD cFound = 0;
+    for (int iRun = 0; iRun < cRuns && ERROR_SUCCESS == uiResult; iRun++)
+    {
+        CBinarySnapshot Snapshot;
+        dStart = SecondsNow();
+        uiResult = Snapshot.Open(szBinary);
+        double dOpened = SecondsNow();
+        if (ERROR_SUCCESS != uiResult)
+            break;
+
+        cOrphanEdges = 0;
+        const DWORD* rgiProduct = Snapshot.Column(bcClientProduct);
+        for (DWORD iClient = 0; iClient < Snapshot.Rows(bcClientProduct); iClient++)
+        {
+            if (BINSNAPNone == rgiProduct[iClient])
+                cOrphanEdges++;
+        }
+
+        cFound = 0;
+        const DWORD* rgibCode = Snapshot.Column(bcProductCode);
+        for (DWORD iProduct = 0; iProduct < Snapshot.ProductCount(); iProduct++)
+        {
+            if (iProduct == Snapshot.FindProduct(Snapshot.String(rgibCode[iProduct])))
+                cFound++;
+        }
+        dOpen += dOpened - dStart;
+        dQuery += SecondsNow() - dOpened;
+    }
+
+    long cbText = FileBytes(szText);
+    long cbBinary = FileBytes(szBinary);
+    remove(szText);
+    remove(szBinary);
+
+    if (ERROR_SUCCESS != uiResult)
+    {
+        printf(TEXT("\tcannot read snapshots back: %d\n\n"), uiResult);
+        return;
+    }
+
+    printf(TEXT("\t%-24s %12s %12s\n"), TEXT(""), TEXT("text"), TEXT("binary"));
+    printf(TEXT("\t%-24s %12ld %12ld\n"), TEXT("bytes"), cbText, cbBinary);
+    printf(TEXT("\t%-24s %12.3f %12.3f\n"), TEXT("write, seconds"), dRecordText, dRecordBinary);
+    printf(TEXT("\t%-24s %12.4f %12.6f\n"), TEXT("load/open, seconds"), dLoadText / cRuns, dOpen / cRuns);
+    printf(TEXT("\t%-24s %12s %12.6f\n"), TEXT("query, seconds"), TEXT("-"), dQuery / cRuns);
+    printf(TEXT("\t%u client edges without an installed product; %u of %u product codes found by lookup.\n\n"),
+        cOrphanEdges, cFound, config.cProducts);
+}
+
+//____________________________________________________________________________
+//
+// enrich - the product report's installer calls on -j N workers.
+//     msi.dll answers in a fraction of a millisecond to several; a
+//     generated inventory answers in nanoseconds, so every call here is
+//     slowed down to CLatencyInstallerData's latency first.  The serial
+//     run fills the same records one after another on this thread.
+//____________________________________________________________________________
+
+class CLatencyInstallerData : public CForwardingInstallerData
+{
+public:
+    CLatencyInstallerData(CInstallerData* pSource, DWORD dwLatency) : CForwardingInstallerData(pSource), m_dwLatency(dwLatency), m_fMicroseconds(false) {}
+    // dwLatency in microseconds, spent spinning: shorter than Sleep can wait, and
+    // taken on this thread the way a call into msi.dll is.
+    CLatencyInstallerData(CInstallerData* pSource, DWORD dwLatency, bool fMicroseconds)
+        : CForwardingInstallerData(pSource), m_dwLatency(dwLatency), m_fMicroseconds(fMicroseconds) {}
+
+    UINT          EnumProducts(DWORD iProductIndex, TCHAR* lpProductBuf)
+                      { Wait(); return m_pSource->EnumProducts(iProductIndex, lpProductBuf); }
+    INSTALLSTATE  QueryProductState(const TCHAR* szProduct)
+                      { Wait(); return m_pSource->QueryProductState(szProduct); }
+    UINT          GetProductInfo(const TCHAR* szProduct, const TCHAR* szAttribute, TCHAR* lpValueBuf, DWORD* pcchValueBuf)
+                      { Wait(); return m_pSource->GetProductInfo(szProduct, szAttribute, lpValueBuf, pcchValueBuf); }
+    USERINFOSTATE GetUserInfo(const TCHAR* szProduct, TCHAR* lpUserNameBuf, DWORD* pcchUserNameBuf,
+                              TCHAR* lpOrgNameBuf, DWORD* pcchOrgNameBuf, TCHAR* lpSerialBuf, DWORD* pcchSerialBuf)
+                      { Wait(); return m_pSource->GetUserInfo(szProduct, lpUserNameBuf, pcchUserNameBuf, lpOrgNameBuf, pcchOrgNameBuf, lpSerialBuf, pcchSerialBuf); }
+
+    UINT          EnumFeatures(const TCHAR* szProduct, DWORD iFeatureIndex, TCHAR* lpFeatureBuf, TCHAR* lpParentBuf)
+                      { Wait(); return m_pSource->EnumFeatures(szProduct, iFeatureIndex, lpFeatureBuf, lpParentBuf); }
+    INSTALLSTATE  QueryFeatureState(const TCHAR* szProduct, const TCHAR* szFeature)
+                      { Wait(); return m_pSource->QueryFeatureState(szProduct, szFeature); }
+    UINT          GetFeatureUsage(const TCHAR* szProduct, const TCHAR* szFeature, DWORD* pdwUseCount, WORD* pwDateUsed)
+                      { Wait(); return m_pSource->GetFeatureUsage(szProduct, szFeature, pdwUseCount, pwDateUsed); }
+
+    UINT          EnumComponents(DWORD iComponentIndex, TCHAR* lpComponentBuf)
+                      { Wait(); return m_pSource->EnumComponents(iComponentIndex, lpComponentBuf); }
+    UINT          EnumClients(const TCHAR* szComponent, DWORD iProductIndex, TCHAR* lpProductBuf)
+                      { Wait(); return m_pSource->EnumClients(szComponent, iProductIndex, lpProductBuf); }
+    INSTALLSTATE  GetComponentPath(const TCHAR* szProduct, const TCHAR* szComponent, TCHAR* lpPathBuf, DWORD* pcchBuf)
+                      { Wait(); return m_pSource->GetComponentPath(szProduct, szComponent, lpPathBuf, pcchBuf); }
+    UINT          EnumComponentQualifiers(const TCHAR* szComponent, DWORD iIndex, TCHAR* lpQualifierBuf, DWORD* pcchQualifierBuf,
+                                          TCHAR* lpApplicationDataBuf, DWORD* pcchApplicationDataBuf)
+                      { Wait(); return m_pSource->EnumComponentQualifiers(szComponent, iIndex, lpQualifierBuf, pcchQualifierBuf, lpApplicationDataBuf, pcchApplicationDataBuf); }
+
+    UINT          EnumPatches(const TCHAR* szProduct, DWORD iPatchIndex, TCHAR* lpPatchBuf, TCHAR* lpTransformsBuf, DWORD* pcchTransformsBuf)
+                      { Wait(); return m_pSource->EnumPatches(szProduct, iPatchIndex, lpPatchBuf, lpTransformsBuf, pcchTransformsBuf); }
+
+    void          ProbeKeyPath(const TCHAR* szKeyPath, KEYPATHPROBE* pProbe)
+                      { Wait(); m_pSource->ProbeKeyPath(szKeyPath, pProbe); }
+
+private:
+    void          Wait()
+                      {
+                          if (!m_fMicroseconds)
+                          {
+                              Sleep(m_dwLatency);
+                              return;
+                          }
+                          double dEnd = SecondsNow() + m_dwLatency / 1000000.0;
+                          while (SecondsNow() < dEnd)
+                              ;
+                      }
+
+    DWORD           m_dwLatency;        // milliseconds per call, or microseconds
+    bool            m_fMicroseconds;
+};
+
+static void BenchEnrich(const SYNTHETICCONFIG& config)
+{
+    CSyntheticInstallerData Synthetic(config);
+    CLatencyInstallerData InstallerData(&Synthetic, 1);
+
+    PrintInventory(TEXT("enrich"), TEXT("product report queries on -j N workers, 1ms per installer call"), config);
+
+    COMPONENTINDEX Index;
+    if (ERROR_SUCCESS != BuildComponentIndex(&Synthetic, &Index))
+    {
+        printf(TEXT("	cannot build the component index\n\n"));
+        return;
+    }
+
+    // what -v asks about every product.
+    PRODUCTQUERYPROPERTY rgProperty[CInventoryProperties];
+    for (int iProperty = 0; iProperty < CInventoryProperties; iProperty++)
+    {
+        rgProperty[iProperty].szProperty = SZInventoryProperty[iProperty];
+        rgProperty[iProperty].fInstalledOnly = false;
+    }
+    PRODUCTQUERY Query;
+    memset(&Query, 0, sizeof(Query));
+    Query.rgProperty = rgProperty;
+    Query.cProperties = CInventoryProperties;
+    Query.fFeatures = true;
+    Query.fFeatureUsage = true;
+    Query.pComponentIndex = &Index;
+
+    double dStart = SecondsNow();
+    TCHAR szProduct[CCHGuid];
+    DWORD cProducts = 0;
+    {
+        CProductRecord Record;
+        while (ERROR_SUCCESS == InstallerData.EnumProducts(cProducts, szProduct))
+        {
+            Record.Enrich(&InstallerData, szProduct, Query);
+            cProducts++;
+        }
+    }
+    double dSerial = SecondsNow() - dStart;
+
+    printf(TEXT("	%-24s %12s %12s\n"), TEXT("threads"), TEXT("seconds"), TEXT("speedup"));
+    printf(TEXT("	%-24s %12.3f %11.1fx\n"), TEXT("serial"), dSerial, 1.0);
+
+    static const DWORD rgcThreads[] = { 2, 4, 8, 16 };
+    for (int iRun = 0; iRun < (int) (sizeof(rgcThreads) / sizeof(rgcThreads[0])); iRun++)
+    {
+        CProductEnricher Enricher;
+        CInstallerData* pProductData = NULL;
+        dStart = SecondsNow();
+        UINT uiResult = Enricher.Start(&InstallerData, Query, rgcThreads[iRun]);
+        DWORD iProductIndex = 0;
+        while (ERROR_SUCCESS == uiResult && ERROR_SUCCESS == Enricher.NextProduct(iProductIndex, szProduct, &pProductData))
+            iProductIndex++;
+        Enricher.Finish();
+        double dRun = SecondsNow() - dStart;
+
+        if (ERROR_SUCCESS != uiResult || iProductIndex != cProducts)
+        {
+            printf(TEXT("	-j %u failed: %d\n"), rgcThreads[iRun], uiResult);
+            continue;
+        }
+
+        TCHAR szThreads[16];
+        sprintf(szThreads, TEXT("%u"), rgcThreads[iRun]);
+        printf(TEXT("	%-24s %12.3f %11.1fx\n"), szThreads, dRun, (dRun > 0) ? dSerial / dRun : 0.0);
+    }
+    printf(TEXT("\n"));
+    FreeComponentIndex(&Index);
+}
+
+//____________________________________________________________________________
+//
+// probe - every component's keypath through the -probe pool, collected in
+//     order the way the component list does.  Each probe is slowed to 1ms by
+//     the stand-in file system, about what a redirected profile costs; the
+//     serial run probes them one after another on this thread.
+//____________________________________________________________________________
+
+static DWORD ProbeThroughPool(CInstallerData* pInstallerData, const COMPONENTINDEX& Index, DWORD cThreads, DWORD cQueueDepth)
+{
+    CProbePool Pool;
+    if (!Pool.Start(pInstallerData, cThreads, cQueueDepth))
+        return 0;
+
+    TCHAR szPath[CCHProbeKeyPath];
+    DWORD cCollected = 0;      // in the order submitted
+    DWORD iAhead = 0;
+    for (DWORD iComponent = 0; iComponent < Index.cComponents; iComponent++)
+    {
+        while (iAhead < Index.cComponents && Pool.CanSubmit())
+        {
+            DWORD cchPath = CCHProbeKeyPath;
+            const TCHAR* szClient = Index.rgClients[Index.rgiFirstClient[iAhead]].szClient;
+            INSTALLSTATE isState = pInstallerData->GetComponentPath(szClient, Index.rgszComponent[iAhead], szPath, &cchPath);
+            Pool.Submit(iAhead++, isState, szPath, true);
+        }
+
+        const PROBEITEM* pItem = Pool.Peek();
+        if (pItem && pItem->dwTag == iComponent)
+            cCollected++;
+        Pool.Pop();
+    }
+    return cCollected;
+}
+
+static void BenchProbe(const SYNTHETICCONFIG& config)
+{
+    CStandInFileSystem InstallerData(new CSyntheticInstallerData(config), NULL, 1, NULL);
+
+    PrintInventory(TEXT("probe"), TEXT("keypath probes on the -probe pool, 1ms per probe"), config);
+
+    COMPONENTINDEX Index;
+    if (ERROR_SUCCESS != BuildComponentIndex(&InstallerData, &Index))
+    {
+        printf(TEXT("\tcannot build the component index\n\n"));
+        return;
+    }
+
+    TCHAR szPath[CCHProbeKeyPath];
+    KEYPATHPROBE Probe;
+    double dStart = SecondsNow();
+    for (DWORD iComponent = 0; iComponent < Index.cComponents; iComponent++)
+    {
+        DWORD cchPath = CCHProbeKeyPath;
+        const TCHAR* szClient = Index.rgClients[Index.rgiFirstClient[iComponent]].szClient;
+        InstallerData.GetComponentPath(szClient, Index.rgszComponent[iComponent], szPath, &cchPath);
+        InstallerData.ProbeKeyPath(szPath, &Probe);
+    }
+    double dSerial = SecondsNow() - dStart;
+
+    printf(TEXT("\t%-24s %12s %12s\n"), TEXT("threads/queue"), TEXT("seconds"), TEXT("speedup"));
+    printf(TEXT("\t%-24s %12.3f %11.1fx\n"), TEXT("serial"), dSerial, 1.0);
+
+    // threads at the default depth, then a starved and an oversized queue.
+    static const DWORD rgRun[][2] = { { 2, 8 }, { 4, 16 }, { 8, 32 }, { 16, 64 }, { 16, 4 }, { 16, 1024 } };
+    for (int iRun = 0; iRun < (int) (sizeof(rgRun) / sizeof(rgRun[0])); iRun++)
+    {
+        dStart = SecondsNow();
+        DWORD cCollected = ProbeThroughPool(&InstallerData, Index, rgRun[iRun][0], rgRun[iRun][1]);
+        double dRun = SecondsNow() - dStart;
+
+        if (cCollected != Index.cComponents)
+        {
+            printf(TEXT("\t-probe threads=%u,queue=%u failed\n"), rgRun[iRun][0], rgRun[iRun][1]);
+            continue;
+        }
+
+        TCHAR szRun[32];
+        sprintf(szRun, TEXT("%u/%u"), rgRun[iRun][0], rgRun[iRun][1]);
+        printf(TEXT("\t%-24s %12.3f %11.1fx\n"), szRun, dRun, (dRun > 0) ? dSerial / dRun : 0.0);
+    }
+    printf(TEXT("\n"));
+    FreeComponentIndex(&Index);
+}
+
+//____________________________________________________________________________
+//
+// output - rendering the -v component list to a file.
+//     The same lines - every client of every component, with a state and a
+//     date - are written with fprintf per line, through a COutputSink's
+//     Printf, and through the sink with the dates formatted by hand the way
+//     the report formats them.  The files are compared byte for byte.
+//____________________________________________________________________________
+
+enum ERenderer { erFprintf, erSinkPrintf, erSinkDates };
+
+static void RenderComponentList(FILE* pFile, const COMPONENTINDEX& Index, ERenderer eRenderer)
+{
+    COutputSink Out(pFile);
+    for (DWORD iComponent = 0; iComponent < Index.cComponents; iComponent++)
+    {
+        for (DWORD iClient = Index.rgiFirstClient[iComponent]; iClient < Index.rgiFirstClient[iComponent + 1]; iClient++)
+        {
+            const TCHAR* szComponent = Index.rgszComponent[iComponent];
+            const TCHAR* szClient = Index.rgClients[iClient].szClient;
+            int iState = (int) (iClient % 5) - 1;
+            const TCHAR* szState = (iState > 0) ? TEXT("Local") : TEXT("Absent");
+            unsigned int uYear = 1998 + iComponent % 28, uMonth = 1 + iClient % 12, uDay = 1 + iComponent % 28;
+            unsigned int uHour = iClient % 24, uMinute = iComponent % 60, uSecond = iClient % 60;
+
+            if (erFprintf == eRenderer)
+            {
+                fprintf(pFile, TEXT("\t\t%s  %s  (%d) %-8s %02d\\%02d\\%02d  %02d:%02d:%02d\n"),
+                    szComponent, szClient, iState, szState, uYear, uMonth, uDay, uHour, uMinute, uSecond);
+            }
+            else if (erSinkPrintf == eRenderer)
+            {
+                Out.Printf(TEXT("\t\t%s  %s  (%d) %-8s %02d\\%02d\\%02d  %02d:%02d:%02d\n"),
+                    szComponent, szClient, iState, szState, uYear, uMonth, uDay, uHour, uMinute, uSecond);
+            }
+            else
+            {
+                Out.Printf(TEXT("\t\t%s  %s  (%d) %-8s "), szComponent, szClient, iState, szState);
+                Out.UInt(uYear, 2, '0');
+                Out.Char('\\');
+                Out.UInt(uMonth, 2, '0');
+                Out.Char('\\');
+                Out.UInt(uDay, 2, '0');
+                Out.Str(TEXT("  "));
+                Out.UInt(uHour, 2, '0');
+                Out.Char(':');
+                Out.UInt(uMinute, 2, '0');
+                Out.Char(':');
+                Out.UInt(uSecond, 2, '0');
+                Out.Char('\n');
+            }
+        }
+    }
+    Out.Flush();
+}
+
+static bool SameFiles(const TCHAR* szFile1, const TCHAR* szFile2)
+{
+    FILE* pFile1 = fopen(szFile1, TEXT("rb"));
+    FILE* pFile2 = fopen(szFile2, TEXT("rb"));
+    bool fSame = (pFile1 && pFile2);
+    while (fSame)
+    {
+        int ch = getc(pFile1);
+        fSame = (ch == getc(pFile2));
+        if (EOF == ch)
+            break;
+    }
+    if (pFile1)
+        fclose(pFile1);
+    if (pFile2)
+        fclose(pFile2);
+    return fSame;
+}
+
+static void BenchOutput(const SYNTHETICCONFIG& config)
+{
+    static const TCHAR* rgszFile[] = { TEXT("msiinv-bench.out1"), TEXT("msiinv-bench.out2"), TEXT("msiinv-bench.out3") };
+    static const TCHAR* rgszRenderer[] = { TEXT("fprintf per line"), TEXT("sink Printf"), TEXT("sink, dates by hand") };
+    CSyntheticInstallerData InstallerData(config);
+
+    PrintInventory(TEXT("output"), TEXT("render the -v component list to a file"), config);
+
+    COMPONENTINDEX Index;
+    if (ERROR_SUCCESS != BuildComponentIndex(&InstallerData, &Index))
+    {
+        printf(TEXT("\tcannot build the component index\n\n"));
+        return;
+    }
+
+    printf(TEXT("\t%-24s %12s %12s\n"), TEXT("renderer"), TEXT("seconds"), TEXT("MB/s"));
+    const int cRuns = 5;
+    for (int iRenderer = erFprintf; iRenderer <= erSinkDates; iRenderer++)
+    {
+        double dRender = 0;
+        for (int iRun = 0; iRun < cRuns; iRun++)
+        {
+            FILE* pFile = fopen(rgszFile[iRenderer], TEXT("wb"));
+            if (!pFile)
+                break;
+            double dStart = SecondsNow();
+            RenderComponentList(pFile, Index, (ERenderer) iRenderer);
+            fclose(pFile);
+            dRender += SecondsNow() - dStart;
+        }
+
+        double dMB = (double) FileBytes(rgszFile[iRenderer]) * cRuns / (1024.0 * 1024.0);
+        printf(TEXT("\t%-24s %12.3f %12.1f\n"), rgszRenderer[iRenderer], dRender / cRuns, (dRender > 0) ? dMB / dRender : 0.0);
+    }
+
+    bool fSame = SameFiles(rgszFile[erFprintf], rgszFile[erSinkPrintf]) && SameFiles(rgszFile[erFprintf], rgszFile[erSinkDates]);
+    printf(TEXT("\t%ld bytes per render; the three files are %s.\n\n"), FileBytes(rgszFile[erFprintf]), (fSame) ? TEXT("identical") : TEXT("DIFFERENT"));
+    for (int iFile = 0; iFile < 3; iFile++)
+        remove(rgszFile[iFile]);
+    FreeComponentIndex(&Index);
+}
+
+//____________________________________________________________________________
+//
+// guid - matching client codes, as the component evaluation does for every
+//     client of every component.
+//     before: _stricmp against the permanent placeholder and a product code.
+//     after:  the same matches on GUIDKEYs made when the index was built.
+//     Making the keys is timed with the SSE2 decoder and a digit at a time.
+//____________________________________________________________________________
+
+static void BenchGuidKeys(const SYNTHETICCONFIG& config)
+{
+    CSyntheticInstallerData InstallerData(config);
+
+    PrintInventory(TEXT("guid"), TEXT("client code matching in the component evaluation (-c)"), config);
+
+    COMPONENTINDEX Index;
+    if (ERROR_SUCCESS != BuildComponentIndex(&InstallerData, &Index))
+    {
+        printf(TEXT("\tcannot build the component index\n\n"));
+        return;
+    }
+
+    // a product in the middle, in lower case so the text compare has to fold it.
+    TCHAR szProduct[CCHGuid] = TEXT("");
+    InstallerData.EnumProducts(config.cProducts / 2, szProduct);
+    for (TCHAR* pch = szProduct; *pch; pch++)
+        if (*pch >= 'A' && *pch <= 'F')
+            *pch = (TCHAR) (*pch - 'A' + 'a');
+    GUIDKEY ProductKey;
+    MakeGuidKey(szProduct, &ProductKey);
+
+    const int cRounds = 20;
+    double dCompares = 2.0 * cRounds * Index.cClients;
+
+    double dStart = SecondsNow();
+    DWORD cTextMatches = 0;
+    for (int iRound = 0; iRound < cRounds; iRound++)
+    {
+        for (DWORD iClient = 0; iClient < Index.cClients; iClient++)
+        {
+            const TCHAR* szClient = Index.rgClients[iClient].szClient;
+            if (0 == _stricmp(szClient, SZPermanentProduct))
+                cTextMatches++;
+            if (0 == _stricmp(szClient, szProduct))
+                cTextMatches++;
+        }
+    }
+    double dText = SecondsNow() - dStart;
+
+    dStart = SecondsNow();
+    DWORD cKeyMatches = 0;
+    for (int iRound = 0; iRound < cRounds; iRound++)
+    {
+        for (DWORD iClient = 0; iClient < Index.cClients; iClient++)
+        {
+            const GUIDKEY& ClientKey = Index.rgClients[iClient].ClientKey;
+            if (IsEqualGuidKey(ClientKey, KEYPermanentProduct))
+                cKeyMatches++;
+            if (IsEqualGuidKey(ClientKey, ProductKey))
+                cKeyMatches++;
+        }
+    }
+    double dKey = SecondsNow() - dStart;
+
+    // making the keys, both ways; they must come out the same.
+    double dMakes = (double) cRounds * Index.cClients;
+    bool fSameKeys = true;
+    GUIDKEY Key;
+    dStart = SecondsNow();
+    for (int iRound = 0; iRound < cRounds; iRound++)
+        for (DWORD iClient = 0; iClient < Index.cClients; iClient++)
+        {
+            MakeGuidKey(Index.rgClients[iClient].szClient, &Key);
+            fSameKeys = fSameKeys && IsEqualGuidKey(Key, Index.rgClients[iClient].ClientKey);
+        }
+    double dMakeSimd = SecondsNow() - dStart;
+
+    dStart = SecondsNow();
+    for (int iRound = 0; iRound < cRounds; iRound++)
+        for (DWORD iClient = 0; iClient < Index.cClients; iClient++)
+        {
+            MakeGuidKeyScalar(Index.rgClients[iClient].szClient, &Key);
+            fSameKeys = fSameKeys && IsEqualGuidKey(Key, Index.rgClients[iClient].ClientKey);
+        }
+    double dMakeScalar = SecondsNow() - dStart;
+
+    printf(TEXT("\t%-24s %12s %12s\n"), TEXT(""), TEXT("seconds"), TEXT("ns each"));
+    printf(TEXT("\t%-24s %12.3f %12.2f\n"), TEXT("_stricmp"), dText, (dCompares > 0) ? dText * 1e9 / dCompares : 0.0);
+    printf(TEXT("\t%-24s %12.3f %12.2f\n"), TEXT("GUIDKEY compare"), dKey, (dCompares > 0) ? dKey * 1e9 / dCompares : 0.0);
+    printf(TEXT("\t%-24s %11.1fx\n"), TEXT("speedup"), (dKey > 0) ? dText / dKey : 0.0);
+    printf(TEXT("\t%-24s %12.3f %12.2f\n"), TEXT("make key, SSE2"), dMakeSimd, (dMakes > 0) ? dMakeSimd * 1e9 / dMakes : 0.0);
+    printf(TEXT("\t%-24s %12.3f %12.2f\n"), TEXT("make key, scalar"), dMakeScalar, (dMakes > 0) ? dMakeScalar * 1e9 / dMakes : 0.0);
+    printf(TEXT("\t%.0f compares of %u clients; %u matches by text, %u by key - they %s; the two decoders %s.\n\n"),
+        dCompares, Index.cClients, cTextMatches, cKeyMatches, (cTextMatches == cKeyMatches) ? TEXT("agree") : TEXT("DISAGREE"),
+        (fSameKeys) ? TEXT("agree") : TEXT("DISAGREE"));
+
+    FreeComponentIndex(&Index);
+}
+
+//____________________________________________________________________________
+//
+// filter - a fleet watch-list on -p.
+//     before: every pattern compared with _strnicmp against each product's
+//             code and name.
+//     after:  the patterns built once into a CProductFilter, one walk each.
+//     The list names every tenth product and as many codes that are not
+//     installed, some as prefixes.
+//____________________________________________________________________________
+
+static void BenchFilter(const SYNTHETICCONFIG& config)
+{
+    CSyntheticInstallerData InstallerData(config);
+
+    PrintInventory(TEXT("filter"), TEXT("-p watch-list against every product's code and name"), config);
+
+    // the products, as the report sees them.
+    DWORD cProducts = 0;
+    TCHAR (*rgszCode)[CCHGuid] = (TCHAR (*)[CCHGuid]) malloc(config.cProducts * sizeof(rgszCode[0]));
+    TCHAR (*rgszName)[64] = (TCHAR (*)[64]) malloc(config.cProducts * sizeof(rgszName[0]));
+    TCHAR (*rgszPattern)[CCHGuid + 64] = (TCHAR (*)[CCHGuid + 64]) malloc(2 * config.cProducts * sizeof(rgszPattern[0]));
+    DWORD cPatterns = 0;
+    CProductFilter Filter;
+    bool fBuilt = (rgszCode && rgszName && rgszPattern);
+    while (fBuilt && (cProducts < config.cProducts) && (ERROR_SUCCESS == InstallerData.EnumProducts(cProducts, rgszCode[cProducts])))
+    {
+        DWORD cchName = 64;
+        if (ERROR_SUCCESS != InstallerData.GetProductInfo(rgszCode[cProducts], INSTALLPROPERTY_PRODUCTNAME, rgszName[cProducts], &cchName))
+            rgszName[cProducts][0] = 0;
+
+        if (0 == cProducts % 10)
+            lstrcpy(rgszPattern[cPatterns++], rgszName[cProducts]);
+        sprintf(rgszPattern[cPatterns++], (cProducts % 2) ? TEXT("{%08X-0000-4000-8000-%012X}") : TEXT("{%08X-0000"), 0x80000000 | cProducts, cProducts);
+        cProducts++;
+    }
+    for (DWORD iPattern = 0; fBuilt && (iPattern < cPatterns); iPattern++)
+        fBuilt = Filter.AddPattern(rgszPattern[iPattern]);
+    if (!fBuilt)
+    {
+        printf(TEXT("\tout of memory building the watch-list\n\n"));
+        free(rgszCode);
+        free(rgszName);
+        free(rgszPattern);
+        return;
+    }
+
+    const int cRounds = 5;
+    double dStart = SecondsNow();
+    DWORD cScanMatches = 0;
+    for (int iRound = 0; iRound < cRounds; iRound++)
+    {
+        for (DWORD iProduct = 0; iProduct < cProducts; iProduct++)
+        {
+            for (DWORD iPattern = 0; iPattern < cPatterns; iPattern++)
+            {
+                int cchPattern = lstrlen(rgszPattern[iPattern]);
+                if ((0 == _strnicmp(rgszCode[iProduct], rgszPattern[iPattern], cchPattern)) ||
+                    (0 == _strnicmp(rgszName[iProduct], rgszPattern[iPattern], cchPattern)))
+                {
+                    cScanMatches++;
+                    break;
+                }
+            }
+        }
+    }
+    double dScan = SecondsNow() - dStart;
+
+    dStart = SecondsNow();
+    DWORD cFilterMatches = 0;
+    for (int iRound = 0; iRound < cRounds; iRound++)
+    {
+        for (DWORD iProduct = 0; iProduct < cProducts; iProduct++)
+        {
+            if (Filter.MatchesPrefix(rgszCode[iProduct]) || Filter.MatchesPrefix(rgszName[iProduct]))
+                cFilterMatches++;
+        }
+    }
+    double dFilter = SecondsNow() - dStart;
+
+    printf(TEXT("\t%-24s %12s\n"), TEXT(""), TEXT("seconds"));
+    printf(TEXT("\t%-24s %12.4f\n"), TEXT("_strnicmp per pattern"), dScan / cRounds);
+    printf(TEXT("\t%-24s %12.4f\n"), TEXT("pattern trie"), dFilter / cRounds);
+    printf(TEXT("\t%-24s %11.0fx\n"), TEXT("speedup"), (dFilter > 0) ? dScan / dFilter : 0.0);
+    printf(TEXT("\t%u patterns; %u of %u products listed by the scan, %u by the trie - they %s.\n\n"),
+        cPatterns, cScanMatches / cRounds, cProducts, cFilterMatches / cRounds, (cScanMatches == cFilterMatches) ? TEXT("agree") : TEXT("DISAGREE"));
+
+    free(rgszCode);
+    free(rgszName);
+    free(rgszPattern);
+}
+
+//____________________________________________________________________________
+//
+// events - the -l event section, against a generated dump of the Application
+//     log: one record per component, 1 in 20 from MsiInstaller, and 1 in 8 of
+//     those carrying more than 4K of data.
+//     before: a seek and an unbuffered 4K read per record, newest first,
+//             skipping any record that did not fit.
+//     after:  CEventLogReader's 64K sequential reads.
+//     The reader is timed again with -since at the middle of the log, and
+//     with an -eventstate checkpoint 1000 records back from the newest.
+//____________________________________________________________________________
+
+const DWORD CBOldEventBuffer = 4096;
+
+// record iRecord of cRecords (0 newest) into pb; its length.
+static DWORD MakeBenchEventRecord(BYTE* pb, DWORD iRecord, DWORD cRecords)
+{
+    bool fMsi = (0 == iRecord % 20);
+    DWORD cbData = (fMsi && (0 == (iRecord / 20) % 8)) ? 6000 : 16 * (iRecord % 7);
+
+    EVENTLOGRECORD* pevlr = (EVENTLOGRECORD*) pb;
+    memset(pevlr, 0, sizeof(EVENTLOGRECORD));
+    pevlr->Reserved = 0x654c664c;
+    pevlr->RecordNumber = cRecords - iRecord;
+    pevlr->TimeGenerated = pevlr->TimeWritten = 1700000000 - 30 * iRecord;
+    pevlr->EventID = (fMsi) ? 11707 : 1000 + iRecord % 50;
+    pevlr->EventType = (fMsi && (iRecord % 3)) ? EVENTLOG_INFORMATION_TYPE : EVENTLOG_ERROR_TYPE;
+
+    DWORD ib = sizeof(EVENTLOGRECORD);
+    ib += sprintf((TCHAR*) (pb + ib), TEXT("%s"), (fMsi) ? TEXT("MsiInstaller") : TEXT("Application Error")) + 1;
+    ib += sprintf((TCHAR*) (pb + ib), TEXT("BENCH")) + 1;
+    ib = (ib + 3) & ~3;
+    pevlr->UserSidOffset = ib;
+    pevlr->StringOffset = ib;
+    pevlr->NumStrings = 1;
+    ib += sprintf((TCHAR*) (pb + ib), TEXT("Product: Bench Product %u -- Installation completed successfully."), iRecord % 1000) + 1;
+    pevlr->DataOffset = ib;
+    pevlr->DataLength = cbData;
+    memset(pb + ib, 0xA5, cbData);
+    ib = (ib + cbData + 3) & ~3;
+    pevlr->Length = ib + sizeof(DWORD);
+    memcpy(pb + ib, &pevlr->Length, sizeof(DWORD));
+    return pevlr->Length;
+}
+
+static bool IsMsiInstallerRecord(const EVENTLOGRECORD* pevlr)
+{
+    return 0 == _stricmp((const TCHAR*) ((const BYTE*) pevlr + sizeof(EVENTLOGRECORD)), TEXT("MsiInstaller"));
+}
+
+static void BenchEventLog(const SYNTHETICCONFIG& config)
+{
+    static const TCHAR szDumpFile[] = TEXT("msiinv-bench.evt");
+    const DWORD cRecords = config.cComponents;
+
+    printf(TEXT("events: the MsiInstaller records in the Application log (-l)\n"));
+    printf(TEXT("\t%u event records, 1 in 20 from MsiInstaller\n"), cRecords);
+
+    // the dump, and where each record starts for the seeking reads.
+    BYTE* pbRecord = (BYTE*) malloc(16 * 1024);
+    long* rglOffset = (long*) malloc(cRecords * sizeof(long));
+    FILE* pFile = CreateEventDump(szDumpFile);
+    bool fWritten = (pbRecord && rglOffset && pFile);
+    DWORD cMsiRecords = 0;
+    for (DWORD iRecord = 0; fWritten && (iRecord < cRecords); iRecord++)
+    {
+        rglOffset[iRecord] = ftell(pFile);
+        MakeBenchEventRecord(pbRecord, iRecord, cRecords);
+        fWritten = WriteEventRecord(pFile, (EVENTLOGRECORD*) pbRecord);
+        if (IsMsiInstallerRecord((EVENTLOGRECORD*) pbRecord))
+            cMsiRecords++;
+    }
+    if (pFile && (0 != fclose(pFile)))
+        fWritten = false;
+    if (!fWritten)
+    {
+        printf(TEXT("\tcannot write %s\n\n"), szDumpFile);
+        free(pbRecord);
+        free(rglOffset);
+        remove(szDumpFile);
+        return;
+    }
+
+    // before: one seek and read per record.
+    double dStart = SecondsNow();
+    DWORD cOldMsi = 0;
+    DWORD cOldReads = 0;
+    pFile = fopen(szDumpFile, TEXT("rb"));
+    if (pFile)
+    {
+        setvbuf(pFile, NULL, _IONBF, 0);
+        BYTE rgbEvents[CBOldEventBuffer];
+        for (DWORD iRecord = 0; iRecord < cRecords; iRecord++)
+        {
+            cOldReads++;
+            if (0 != fseek(pFile, rglOffset[iRecord], SEEK_SET))
+                break;
+            size_t cbRead = fread(rgbEvents, 1, sizeof(rgbEvents), pFile);
+            const EVENTLOGRECORD* pevlr = (const EVENTLOGRECORD*) rgbEvents;
+            if ((cbRead < sizeof(EVENTLOGRECORD)) || (pevlr->Length > cbRead))
+                continue;       // item too big - not MSI.
+            if (IsMsiInstallerRecord(pevlr))
+                cOldMsi++;
+        }
+        fclose(pFile);
+    }
+    double dOld = SecondsNow() - dStart;
+
+    // after: the reader, through the whole log and then back to the middle.
+    DWORD rgcMsi[3] = { 0, 0, 0 };
+    DWORD rgcReads[3] = { 0, 0, 0 };
+    DWORD rgcRecords[3] = { 0, 0, 0 };
+    double rgdReader[3] = { 0, 0, 0 };
+    EVENTCHECKPOINT Checkpoint;
+    Checkpoint.dwRecordNumber = (cRecords > 1000) ? cRecords - 1000 : 1;
+    Checkpoint.dwTimeGenerated = Checkpoint.dwTimeWritten = 1700000000 - 30 * (cRecords - Checkpoint.dwRecordNumber);
+    for (int iPass = 0; iPass < 3; iPass++)
+    {
+        CEventLogReader Reader;
+        dStart = SecondsNow();
+        if (ERROR_SUCCESS != Reader.OpenDump(szDumpFile))
+            break;
+        if (1 == iPass)
+            Reader.SetCutoff(1700000000 - 30 * (cRecords / 2));
+        else if (2 == iPass)
+            Reader.SetCheckpoint(Checkpoint);
+        const EVENTLOGRECORD* pevlr;
+        while (NULL != (pevlr = Reader.Next()))
+        {
+            if (IsMsiInstallerRecord(pevlr))
+                rgcMsi[iPass]++;
+        }
+        rgdReader[iPass] = SecondsNow() - dStart;
+        rgcReads[iPass] = Reader.ReadCount();
+        rgcRecords[iPass] = Reader.RecordCount();
+    }
+
+    printf(TEXT("\t%-24s %12s %12s %12s\n"), TEXT(""), TEXT("seconds"), TEXT("reads"), TEXT("MSI events"));
+    printf(TEXT("\t%-24s %12.4f %12u %12u\n"), TEXT("seek + 4K read each"), dOld, cOldReads, cOldMsi);
+    printf(TEXT("\t%-24s %12.4f %12u %12u\n"), TEXT("64K sequential reads"), rgdReader[0], rgcReads[0], rgcMsi[0]);
+    printf(TEXT("\t%-24s %12.4f %12u %12u\n"), TEXT("  -since half way"), rgdReader[1], rgcReads[1], rgcMsi[1]);
+    printf(TEXT("\t%-24s %12.4f %12u %12u\n"), TEXT("  checkpoint"), rgdReader[2], rgcReads[2], rgcMsi[2]);
+    printf(TEXT("\t%-24s %11.0fx\n"), TEXT("speedup"), (rgdReader[0] > 0) ? dOld / rgdReader[0] : 0.0);
+    printf(TEXT("\t%u MsiInstaller records; the old reads missed %u too big for 4K, the reader %u.\n"),
+        cMsiRecords, cMsiRecords - cOldMsi, cMsiRecords - rgcMsi[0]);
+    printf(TEXT("\t-since stopped after %u of %u records, the checkpoint after %u.\n\n"), rgcRecords[1], cRecords, rgcRecords[2]);
+
+    free(pbRecord);
+    free(rglOffset);
+    remove(szDumpFile);
+}
+
+//____________________________________________________________________________
+//
+// eventjoin - each product's MsiInstaller events (-productevents), over
+//     records already in memory, one in two from MsiInstaller and one in
+//     nine of those about a product no longer installed.
+//     before: every record looked at again for each product, for its code
+//             or its name; timed over the first products and scaled.
+//     after:  one pass into the index, and a lookup per product.
+//____________________________________________________________________________
+
+const DWORD CRescanBudget = 5000000;           // record looks the before case is timed for
+
+static DWORD MakeJoinEventRecord(BYTE* pb, DWORD iRecord, DWORD cRecords, const TCHAR* szCode, const TCHAR* szName)
+{
+    static const DWORD rgdwEventId[4] = { 1033, 11707, 11708, 11728 };
+    bool fMsi = (0 == iRecord % 2);
+    DWORD dwEventId = rgdwEventId[(iRecord / 2) % 4];
+
+    EVENTLOGRECORD* pevlr = (EVENTLOGRECORD*) pb;
+    memset(pevlr, 0, sizeof(EVENTLOGRECORD));
+    pevlr->Reserved = 0x654c664c;
+    pevlr->RecordNumber = cRecords - iRecord;
+    pevlr->TimeGenerated = pevlr->TimeWritten = 1700000000 - 30 * iRecord;
+    pevlr->EventID = (fMsi) ? dwEventId : 1000 + iRecord % 50;
+    pevlr->EventType = (fMsi && (11708 == dwEventId)) ? EVENTLOG_ERROR_TYPE : EVENTLOG_INFORMATION_TYPE;
+
+    DWORD ib = sizeof(EVENTLOGRECORD);
+    ib += sprintf((TCHAR*) (pb + ib), (fMsi) ? TEXT("MsiInstaller") : TEXT("Application Error")) + 1;
+    ib += sprintf((TCHAR*) (pb + ib), TEXT("BENCH")) + 1;
+    ib = (ib + 3) & ~3;
+    pevlr->UserSidOffset = ib;
+    pevlr->StringOffset = ib;
+    if (fMsi && (1033 == dwEventId))
+    {
+        pevlr->NumStrings = 5;
+        ib += sprintf((TCHAR*) (pb + ib), TEXT("%s"), szName) + 1;
+        ib += sprintf((TCHAR*) (pb + ib), TEXT("1.0.0")) + 1;
+        ib += sprintf((TCHAR*) (pb + ib), TEXT("1033")) + 1;
+        ib += sprintf((TCHAR*) (pb + ib), TEXT("0")) + 1;
+        ib += sprintf((TCHAR*) (pb + ib), TEXT("Synthetic Publisher")) + 1;
+    }
+    else if (fMsi)
+    {
+        pevlr->NumStrings = 1;
+        ib += sprintf((TCHAR*) (pb + ib), (11708 == dwEventId) ? TEXT("Product: %s -- Installation failed.") :
+            TEXT("Product: %s -- Configuration completed successfully."), szName) + 1;
+    }
+    else
+    {
+        pevlr->NumStrings = 1;
+        ib += sprintf((TCHAR*) (pb + ib), TEXT("Faulting application bench.exe, version 1.0.0.%u"), iRecord) + 1;
+    }
+    // the failures name the product; the rest carry its code.
+    pevlr->DataOffset = ib;
+    if (fMsi && (11708 != dwEventId))
+        ib += sprintf((TCHAR*) (pb + ib), TEXT("%s"), szCode);
+    else
+        ib += sprintf((TCHAR*) (pb + ib), TEXT("(NULL)"));
+    pevlr->DataLength = ib - pevlr->DataOffset;
+    ib = (ib + 3) & ~3;
+    pevlr->Length = ib + sizeof(DWORD);
+    memcpy(pb + ib, &pevlr->Length, sizeof(DWORD));
+    return pevlr->Length;
+}
+
+static void BenchEventJoin(const SYNTHETICCONFIG& config)
+{
+    CSyntheticInstallerData InstallerData(config);
+    const DWORD cRecords = config.cComponents;
+
+    printf(TEXT("eventjoin: each product's MsiInstaller events (-productevents)\n"));
+    printf(TEXT("\t%u products, %u event records\n"), config.cProducts, cRecords);
+
+    DWORD cProducts = 0;
+    TCHAR (*rgszCode)[CCHGuid] = (TCHAR (*)[CCHGuid]) malloc((config.cProducts + 1) * sizeof(rgszCode[0]));
+    TCHAR (*rgszName)[64] = (TCHAR (*)[64]) malloc((config.cProducts + 1) * sizeof(rgszName[0]));
+    GUIDKEY* rgKey = (GUIDKEY*) malloc((config.cProducts + 1) * sizeof(GUIDKEY));
+    BYTE* pbRecords = (BYTE*) malloc((size_t) cRecords * 512 + 1);
+    DWORD* rgibRecord = (DWORD*) malloc((cRecords + 1) * sizeof(DWORD));
+    bool fBuilt = (rgszCode && rgszName && rgKey && pbRecords && rgibRecord);
+    while (fBuilt && (cProducts < config.cProducts) && (ERROR_SUCCESS == InstallerData.EnumProducts(cProducts, rgszCode[cProducts])))
+    {
+        DWORD cchName = 64;
+        if (ERROR_SUCCESS != InstallerData.GetProductInfo(rgszCode[cProducts], INSTALLPROPERTY_PRODUCTNAME, rgszName[cProducts], &cchName))
+            rgszName[cProducts][0] = 0;
+        MakeGuidKey(rgszCode[cProducts], &rgKey[cProducts]);
+        cProducts++;
+    }
+    DWORD ib = 0;
+    for (DWORD iRecord = 0; fBuilt && cProducts && (iRecord < cRecords); iRecord++)
+    {
+        // one in nine is about a product that is gone.
+        DWORD iProduct = (iRecord / 2) % (cProducts + cProducts / 8);
+        TCHAR szCode[CCHGuid];
+        TCHAR szName[64];
+        if (iProduct < cProducts)
+        {
+            lstrcpy(szCode, rgszCode[iProduct]);
+            lstrcpy(szName, rgszName[iProduct]);
+        }
+        else
+        {
+            sprintf(szCode, TEXT("{%08X-DEAD-4000-8000-000000000001}"), iProduct);
+            sprintf(szName, TEXT("Removed Product %u"), iProduct);
+        }
+        rgibRecord[iRecord] = ib;
+        ib += MakeJoinEventRecord(pbRecords + ib, iRecord, cRecords, szCode, szName);
+    }
+    if (!fBuilt || !cProducts)
+    {
+        printf(TEXT("\tout of memory building the records\n\n"));
+        free(rgszCode);
+        free(rgszName);
+        free(rgKey);
+        free(pbRecords);
+        free(rgibRecord);
+        return;
+    }
+
+    // before: a rescan per product, over as many products as the budget allows.
+    DWORD cRescanned = (CRescanBudget / (cRecords + 1)) + 1;
+    if (cRescanned > cProducts)
+        cRescanned = cProducts;
+    double dStart = SecondsNow();
+    DWORD cRescanEvents = 0, cRescanFailures = 0;
+    for (DWORD iProduct = 0; iProduct < cRescanned; iProduct++)
+    {
+        for (DWORD iRecord = 0; iRecord < cRecords; iRecord++)
+        {
+            bool fFailure;
+            if (IsEventForProduct((const EVENTLOGRECORD*) (pbRecords + rgibRecord[iRecord]), rgKey[iProduct], rgszName[iProduct], &fFailure))
+            {
+                cRescanEvents++;
+                if (fFailure)
+                    cRescanFailures++;
+            }
+        }
+    }
+    double dRescan = (SecondsNow() - dStart) * ((double) cProducts / (double) cRescanned);
+
+    // after: the index.
+    dStart = SecondsNow();
+    CProductEventIndex Index;
+    for (DWORD iRecord = 0; fBuilt && (iRecord < cRecords); iRecord++)
+        fBuilt = Index.Add((const EVENTLOGRECORD*) (pbRecords + rgibRecord[iRecord]));
+    DWORD cIndexEvents = 0, cIndexFailures = 0, cCheckEvents = 0, cCheckFailures = 0;
+    for (DWORD iProduct = 0; fBuilt && (iProduct < cProducts); iProduct++)
+    {
+        PRODUCTEVENTS Events;
+        if (Index.Find(rgKey[iProduct], rgszName[iProduct], &Events))
+        {
+            cIndexEvents += Events.cEvents;
+            cIndexFailures += Events.cFailures;
+            if (iProduct < cRescanned)
+            {
+                cCheckEvents += Events.cEvents;
+                cCheckFailures += Events.cFailures;
+            }
+        }
+    }
+    double dIndex = SecondsNow() - dStart;
+
+    TCHAR szRescan[64];
+    if (cRescanned < cProducts)
+        sprintf(szRescan, TEXT("rescan (%u, scaled)"), cRescanned);
+    else
+        sprintf(szRescan, TEXT("rescan per product"));
+    printf(TEXT("\t%-24s %12s\n"), TEXT(""), TEXT("seconds"));
+    printf(TEXT("\t%-24s %12.4f\n"), szRescan, dRescan);
+    printf(TEXT("\t%-24s %12.4f\n"), TEXT("index + lookup"), dIndex);
+    printf(TEXT("\t%-24s %11.0fx\n"), TEXT("speedup"), (dIndex > 0) ? dRescan / dIndex : 0.0);
+    printf(TEXT("\t%u MsiInstaller events, %u of them joined to a product, %u failures; the two %s.\n\n"), Index.EventCount(),
+        cIndexEvents, cIndexFailures, (fBuilt && (cCheckEvents == cRescanEvents) && (cCheckFailures == cRescanFailures)) ? TEXT("agree") : TEXT("DISAGREE"));
+
+    free(rgszCode);
+    free(rgszName);
+    free(rgKey);
+    free(pbRecords);
+    free(rgibRecord);
+}
+
+//____________________________________________________________________________
+//
+// logscan - counting the failures in verbose installer logs (-scanlogs),
+//     over generated logs already in the file cache.
+//     before: each log read a line at a time, strstr for each mark.
+//     after:  the logs mapped and scanned 16 bytes at a time, on one
+//             thread and then one per processor.
+//____________________________________________________________________________
+
+static const TCHAR* const BenchLogLines[] =
+    {
+        TEXT("MSI (s) (A4:B8) [10:41:07:123]: Doing action: InstallFiles\r\n"),
+        TEXT("Action start 10:41:07: InstallFiles.\r\n"),
+        TEXT("MSI (s) (A4:B8) [10:41:07:125]: Executing op: FileCopy(SourceName=app.dll,DestName=app.dll,Attributes=512,FileSize=1048576)\r\n"),
+        TEXT("Property(S): INSTALLDIR = C:\\Program Files\\Bench Product\\\r\n"),
+        TEXT("Action ended 10:41:08: InstallFiles. Return value 1.\r\n"),
+    };
+
+static const TCHAR* const BenchLogFailures[] =
+    {
+        TEXT("Action ended 10:41:09: InstallFinalize. Return value 3.\r\n"),
+        TEXT("MSI (s) (A4:B8) [10:41:09:001]: Product: Bench Product -- Error 1603. Fatal error during installation.\r\n"),
+        TEXT("Error 1722. There is a problem with this Windows Installer package.\r\n"),
+    };
+
+// the marks on one line, as the line-at-a-time scan finds them.
+static void CountLineMarks(const TCHAR* szLine, DWORD rgcMark[cLogMarks])
+{
+    for (const TCHAR* pch = szLine; NULL != (pch = strstr(pch, TEXT("Return value 3"))); pch++)
+    {
+        if (!(pch[14] >= '0' && pch[14] <= '9'))
+            rgcMark[lmReturnValue3]++;
+    }
+    for (const TCHAR* pch = szLine; NULL != (pch = strstr(pch, TEXT("Error 1603"))); pch++)
+    {
+        if (!(pch[10] >= '0' && pch[10] <= '9'))
+            rgcMark[lmError1603]++;
+    }
+    for (const TCHAR* pch = szLine; NULL != (pch = strstr(pch, TEXT("Error 17"))); pch++)
+    {
+        if ((pch[8] >= '0' && pch[8] <= '9') && (pch[9] >= '0' && pch[9] <= '9') && !(pch[10] >= '0' && pch[10] <= '9'))
+            rgcMark[lmError17xx]++;
+    }
+}
+
+static void BenchLogScan(const SYNTHETICCONFIG& config)
+{
+    const DWORD cFiles = config.cProducts;
+    const unsigned __int64 cbPerFile = (unsigned __int64) config.cComponents * 1024 * 1024;
+
+    printf(TEXT("logscan: failures in verbose installer logs (-l -scanlogs)\n"));
+    printf(TEXT("\t%u logs of %u MB\n"), cFiles, config.cComponents);
+
+    LOGFILEENTRY* rgEntry = (LOGFILEENTRY*) calloc(cFiles + 1, sizeof(LOGFILEENTRY));
+    LOGSCANRESULT* rgResult = (LOGSCANRESULT*) calloc(cFiles + 1, sizeof(LOGSCANRESULT));
+    bool fWritten = (rgEntry && rgResult);
+    unsigned __int64 cbTotal = 0;
+    DWORD rgcWritten[cLogMarks] = { 0, 0, 0 };
+    for (DWORD iFile = 0; fWritten && (iFile < cFiles); iFile++)
+    {
+        sprintf(rgEntry[iFile].szName, TEXT("msiinv-bench-%u.log"), iFile);
+        FILE* pFile = fopen(rgEntry[iFile].szName, TEXT("wb"));
+        fWritten = (NULL != pFile);
+        unsigned __int64 cbFile = 0;
+        for (DWORD iLine = 0; fWritten && (cbFile < cbPerFile); iLine++)
+        {
+            const TCHAR* szLine = (0 == iLine % 5000) ? BenchLogFailures[(iLine / 5000) % 3] : BenchLogLines[iLine % 5];
+            if (0 == iLine % 5000)
+                rgcWritten[(iLine / 5000) % 3]++;
+            fWritten = (EOF != fputs(szLine, pFile));
+            cbFile += lstrlen(szLine);
+        }
+        if (pFile && (0 != fclose(pFile)))
+            fWritten = false;
+        rgEntry[iFile].cbFile = cbFile;
+        cbTotal += cbFile;
+    }
+    if (!fWritten)
+    {
+        printf(TEXT("\tcannot write the logs\n\n"));
+        for (DWORD iFile = 0; rgEntry && (iFile < cFiles); iFile++)
+            remove(rgEntry[iFile].szName);
+        free(rgEntry);
+        free(rgResult);
+        return;
+    }
+
+    // before: fgets and strstr.
+    double dStart = SecondsNow();
+    DWORD rgcLine[cLogMarks] = { 0, 0, 0 };
+    TCHAR szLine[4096];
+    for (DWORD iFile = 0; iFile < cFiles; iFile++)
+    {
+        FILE* pFile = fopen(rgEntry[iFile].szName, TEXT("rb"));
+        if (!pFile)
+            continue;
+        while (fgets(szLine, sizeof(szLine) / sizeof(TCHAR), pFile))
+            CountLineMarks(szLine, rgcLine);
+        fclose(pFile);
+    }
+    double dLine = SecondsNow() - dStart;
+
+    // after: mapped, on one thread and on one per processor.
+    const DWORD rgcThreads[2] = { 1, ProcessorCount() };
+    double rgdScan[2] = { 0, 0 };
+    DWORD rgrgcScan[2][cLogMarks];
+    for (int iPass = 0; iPass < 2; iPass++)
+    {
+        dStart = SecondsNow();
+        ScanLogFiles(TEXT(""), rgEntry, cFiles, rgcThreads[iPass], rgResult);
+        rgdScan[iPass] = SecondsNow() - dStart;
+        memset(rgrgcScan[iPass], 0, sizeof(rgrgcScan[iPass]));
+        for (DWORD iFile = 0; iFile < cFiles; iFile++)
+        {
+            for (int lm = 0; lm < cLogMarks; lm++)
+                rgrgcScan[iPass][lm] += rgResult[iFile].rgcMark[lm];
+        }
+    }
+
+    double dMB = (double) cbTotal / (1024.0 * 1024.0);
+    TCHAR szThreads[32];
+    sprintf(szThreads, TEXT("mapped, %u thread%s"), rgcThreads[1], (1 == rgcThreads[1]) ? TEXT("") : TEXT("s"));
+    printf(TEXT("\t%-24s %12s %12s\n"), TEXT(""), TEXT("seconds"), TEXT("MB/s"));
+    printf(TEXT("\t%-24s %12.3f %12.0f\n"), TEXT("fgets + strstr"), dLine, (dLine > 0) ? dMB / dLine : 0.0);
+    printf(TEXT("\t%-24s %12.3f %12.0f\n"), TEXT("mapped, 1 thread"), rgdScan[0], (rgdScan[0] > 0) ? dMB / rgdScan[0] : 0.0);
+    printf(TEXT("\t%-24s %12.3f %12.0f\n"), szThreads, rgdScan[1], (rgdScan[1] > 0) ? dMB / rgdScan[1] : 0.0);
+
+    bool fAgree = (0 == memcmp(rgcWritten, rgcLine, sizeof(rgcLine))) && (0 == memcmp(rgcWritten, rgrgcScan[0], sizeof(rgcLine))) &&
+                  (0 == memcmp(rgcWritten, rgrgcScan[1], sizeof(rgcLine)));
+    printf(TEXT("\t%u, %u and %u marks written; the three scans %s.\n\n"), rgcWritten[0], rgcWritten[1], rgcWritten[2],
+        (fAgree) ? TEXT("agree") : TEXT("DISAGREE"));
+
+    for (DWORD iFile = 0; iFile < cFiles; iFile++)
+        remove(rgEntry[iFile].szName);
+    free(rgEntry);
+    free(rgResult);
+}
+
+//____________________________________________________________________________
+//
+// profile - timing the actions of one verbose log (-profile), a generated
+//     log of many megabytes already in the file cache.
+//     floor:  the log read a line at a time with fgets, and nothing done.
+//     -profile: read through its buffer, every action timed.
+//     The memory the profile holds is the same for any size of log.
+//____________________________________________________________________________
+
+static void BenchLogTime(FILE* pFile, unsigned __int64 msTime, bool fMilliseconds)
+{
+    DWORD msOfDay = (DWORD) (msTime % (24 * 60 * 60 * 1000));
+    fprintf(pFile, TEXT("%02u:%02u:%02u"), msOfDay / 3600000, (msOfDay / 60000) % 60, (msOfDay / 1000) % 60);
+    if (fMilliseconds)
+        fprintf(pFile, TEXT(":%03u"), msOfDay % 1000);
+}
+
+static void BenchLogStamp(FILE* pFile, unsigned __int64 msTime)
+{
+    fputs(TEXT("MSI (s) (A4:B8) ["), pFile);
+    BenchLogTime(pFile, msTime, true);
+    fputs(TEXT("]: "), pFile);
+}
+
+static void BenchProfile(const SYNTHETICCONFIG& config)
+{
+    const DWORD cActionNames = (config.cProducts) ? config.cProducts : 1;
+    const unsigned __int64 cbLog = (unsigned __int64) config.cComponents * 1024 * 1024;
+    const TCHAR* szLog = TEXT("msiinv-bench-profile.log");
+
+    printf(TEXT("profile: the actions of a verbose installer log (-profile)\n"));
+    printf(TEXT("\t%u MB log, %u action names\n"), config.cComponents, cActionNames);
+
+    // INSTALL around it all, and actions one after another inside it, each
+    // a few lines long; 7ms a line, so the log runs on past midnight.
+    FILE* pFile = fopen(szLog, TEXT("wb"));
+    unsigned __int64 msTime = 23 * 60 * 60 * 1000;
+    DWORD cRunsWritten = 0;
+    if (pFile)
+    {
+        BenchLogStamp(pFile, msTime);
+        fputs(TEXT("Doing action: INSTALL\r\nAction start "), pFile);
+        BenchLogTime(pFile, msTime, false);
+        fputs(TEXT(": INSTALL.\r\n"), pFile);
+        while ((unsigned __int64) ftell(pFile) < cbLog && !ferror(pFile))
+        {
+            DWORD iName = cRunsWritten % cActionNames;
+            msTime += 7;
+            BenchLogStamp(pFile, msTime);
+            fprintf(pFile, TEXT("Doing action: BenchAction%u\r\nAction start "), iName);
+            BenchLogTime(pFile, msTime, false);
+            fprintf(pFile, TEXT(": BenchAction%u.\r\n"), iName);
+            for (DWORD iLine = 0; iLine < 12; iLine++)
+            {
+                msTime += 7;
+                BenchLogStamp(pFile, msTime);
+                fputs(TEXT("Executing op: FileCopy(SourceName=app.dll,DestName=app.dll,Attributes=512,FileSize=1048576)\r\n"), pFile);
+                fputs(TEXT("Property(S): INSTALLDIR = C:\\Program Files\\Bench Product\\\r\n"), pFile);
+            }
+            msTime += 7;
+            BenchLogStamp(pFile, msTime);
+            fputs(TEXT("Note: 1: 2205 2:  3: Error\r\nAction ended "), pFile);
+            BenchLogTime(pFile, msTime, false);
+            fprintf(pFile, TEXT(": BenchAction%u. Return value 1.\r\n"), iName);
+            cRunsWritten++;
+        }
+        msTime += 7;
+        BenchLogStamp(pFile, msTime);
+        fputs(TEXT("Note\r\nAction ended "), pFile);
+        BenchLogTime(pFile, msTime, false);
+        fputs(TEXT(": INSTALL. Return value 1.\r\n"), pFile);
+        cRunsWritten++;
+    }
+    if (!pFile || (0 != fclose(pFile)))
+    {
+        printf(TEXT("\tcannot write the log\n\n"));
+        remove(szLog);
+        return;
+    }
+
+    // floor: fgets.
+    double dStart = SecondsNow();
+    unsigned __int64 cbLine = 0;
+    TCHAR szLine[4096];
+    pFile = fopen(szLog, TEXT("rb"));
+    while (pFile && fgets(szLine, sizeof(szLine) / sizeof(TCHAR), pFile))
+        cbLine += lstrlen(szLine);
+    if (pFile)
+        fclose(pFile);
+    double dLine = SecondsNow() - dStart;
+
+    dStart = SecondsNow();
+    CActionProfiler Profiler;
+    UINT uiProfile = Profiler.ProfileFile(szLog);
+    double dProfile = SecondsNow() - dStart;
+
+    double dMB = (double) Profiler.BytesRead() / (1024.0 * 1024.0);
+    printf(TEXT("\t%-24s %12s %12s\n"), TEXT(""), TEXT("seconds"), TEXT("MB/s"));
+    printf(TEXT("\t%-24s %12.3f %12.0f\n"), TEXT("fgets, nothing done"), dLine, (dLine > 0) ? dMB / dLine : 0.0);
+    printf(TEXT("\t%-24s %12.3f %12.0f\n"), TEXT("-profile"), dProfile, (dProfile > 0) ? dMB / dProfile : 0.0);
+    printf(TEXT("\t%u KB held for a %u MB log; %u action runs written, %u timed, %u left open.\n"),
+        (DWORD) (Profiler.BytesHeld() / 1024), (DWORD) dMB, cRunsWritten, Profiler.RunCount(), Profiler.UnendedCount());
+    printf(TEXT("\tprofile %s.\n\n"), ((ERROR_SUCCESS == uiProfile) && (cbLine == Profiler.BytesRead()) &&
+        (cRunsWritten == Profiler.RunCount()) && (0 == Profiler.UnendedCount())) ? TEXT("agrees") : TEXT("DISAGREES"));
+
+    remove(szLog);
+}
+
+//____________________________________________________________________________
+//
+// scaling - every report, run whole as main runs it, against the inventory
+//     and against it two, four and eight times over (products and
+//     components both), with the text thrown away.  Each run's installer
+//     calls are counted (callcount.h): a report that asks so many questions
+//     per product, component and client makes eight times the calls on
+//     eight times the inventory, and one that grows faster than that has a
+//     loop over the inventory inside another.  The calls that grew fastest
+//     are listed under it.  Times are flagged the same way once the first
+//     run takes long enough to time.
+//____________________________________________________________________________
+
+static const TCHAR* const ScalingModes[] =
+    {
+        TEXT("-s"), TEXT("-n"), TEXT("-p"), TEXT("-f"), TEXT("-q"), TEXT("-#"),
+        TEXT("-x"), TEXT("-m"), TEXT("-c"), TEXT("-v"),
+    };
+
+const DWORD CScalingSizes = 4;                  // x1, x2, x4, x8
+const double DScalingSlack = 1.5;               // growth past the inventory's that is flagged
+const double DScalingMinimumSeconds = 0.1;      // a first run shorter is not timed closely enough to flag
+
+struct SCALINGCALLS {
+    DWORD rgcCalls[cTimedCalls];
+    DWORD cTotal;
+};
+
+// the calls of the run just ended, over every phase.
+static void GetScalingCalls(SCALINGCALLS* pCalls)
+{
+    pCalls->cTotal = 0;
+    for (int tc = 0; tc < cTimedCalls; tc++)
+    {
+        CALLSTATS Stats;
+        GetCallStats(cCallPhases, (TIMEDCALL) tc, &Stats);
+        pCalls->rgcCalls[tc] = Stats.cCalls;
+        pCalls->cTotal += Stats.cCalls;
+    }
+}
+
+static void BenchScaling(const SYNTHETICCONFIG& config)
+{
+    PrintInventory(TEXT("scaling"), TEXT("every report against growing inventories, installer calls counted (-t)"), config);
+
+    printf(TEXT("\t%-6s"), TEXT("mode"));
+    for (DWORD iSize = 0; iSize < CScalingSizes; iSize++)
+    {
+        TCHAR szHeading[16];
+        sprintf(szHeading, TEXT("x%u s"), 1 << iSize);
+        printf(TEXT(" %9s"), szHeading);
+    }
+    printf(TEXT(" %12s %12s %8s %8s\n"), TEXT("calls x1"), TEXT("calls x8"), TEXT("calls"), TEXT("time"));
+
+    const DWORD cScale = 1 << (CScalingSizes - 1);
+    bool fFlagged = false;
+    for (int iMode = 0; iMode < (int) (sizeof(ScalingModes) / sizeof(ScalingModes[0])); iMode++)
+    {
+        double rgdSeconds[CScalingSizes];
+        SCALINGCALLS rgCalls[CScalingSizes];
+        int iExit = 0;
+        for (DWORD iSize = 0; iSize < CScalingSizes && 0 == iExit; iSize++)
+        {
+            TCHAR szInventory[256];
+            sprintf(szInventory, TEXT("products=%u,components=%u,clients=%u,features=%u,patches=%u,qualifiers=%u,latency=%u"),
+                config.cProducts << iSize, config.cComponents << iSize, config.cClientsPerComponent, config.cFeaturesPerProduct,
+                config.cPatchesPerProduct, config.cQualifiersPerComponent, config.dwKeyPathLatency);
+            // RunReport takes main's argv, which is writable.
+            TCHAR szProgram[] = TEXT("msiinv");
+            TCHAR szSynthetic[] = TEXT("-synthetic");
+            TCHAR szMode[32];
+            lstrcpyn(szMode, ScalingModes[iMode], sizeof(szMode) / sizeof(TCHAR));
+            TCHAR szTimed[] = TEXT("-t");
+            TCHAR* rgszArgs[] = { szProgram, szSynthetic, szInventory, szMode, szTimed, NULL };
+
+            g_Out.Flush();
+            g_Out.Discard(true);
+            double dStart = SecondsNow();
+            iExit = RunReport(5, rgszArgs);
+            rgdSeconds[iSize] = SecondsNow() - dStart;
+            g_Out.Discard(false);
+            GetScalingCalls(&rgCalls[iSize]);
+        }
+        if (0 != iExit)
+        {
+            printf(TEXT("\t%-6s failed: %d\n"), ScalingModes[iMode], iExit);
+            continue;
+        }
+
+        const SCALINGCALLS& First = rgCalls[0];
+        const SCALINGCALLS& Last = rgCalls[CScalingSizes - 1];
+        double dCallGrowth = (First.cTotal) ? (double) Last.cTotal / First.cTotal : 0.0;
+        double dTimeGrowth = (rgdSeconds[0] > 0) ? rgdSeconds[CScalingSizes - 1] / rgdSeconds[0] : 0.0;
+        bool fCallsFlagged = (dCallGrowth > cScale * DScalingSlack);
+        bool fTimeFlagged = (rgdSeconds[0] >= DScalingMinimumSeconds && dTimeGrowth > cScale * DScalingSlack);
+
+        printf(TEXT("\t%-6s"), ScalingModes[iMode]);
+        for (DWORD iSize = 0; iSize < CScalingSizes; iSize++)
+            printf(TEXT(" %9.3f"), rgdSeconds[iSize]);
+        printf(TEXT(" %12u %12u %7.1fx %7.1fx%s\n"), First.cTotal, Last.cTotal, dCallGrowth, dTimeGrowth,
+            (fCallsFlagged || fTimeFlagged) ? TEXT("  FASTER THAN THE INVENTORY") : TEXT(""));
+
+        for (int tc = 0; tc < cTimedCalls && fCallsFlagged; tc++)
+        {
+            if (Last.rgcCalls[tc] > (double) First.rgcCalls[tc] * cScale * DScalingSlack)
+                printf(TEXT("\t       %-28s %10u -> %u\n"), TimedCallNames[tc], First.rgcCalls[tc], Last.rgcCalls[tc]);
+        }
+        fFlagged |= (fCallsFlagged || fTimeFlagged);
+    }
+    printf(TEXT("\tinventory grew %ux; %s.\n\n"), cScale,
+        (fFlagged) ? TEXT("some reports grew faster") : TEXT("every report grew with it"));
+}
+
+//____________________________________________________________________________
+//
+// calltiming - what -t's call timing (callcount.h) costs.
+//     Every component's clients are asked for straight from the inventory,
+//     through CCountingInstallerData with -t off, and with it on; the
+//     difference is two clock reads and two interlocked adds a call.  Then
+//     the inventory is walked the way the verbose report walks it, every
+//     call taking 10us as msi.dll's quicker answers do, without and with
+//     the timing, to show what -t adds to a real run; the best of five
+//     runs of each.
+//____________________________________________________________________________
+
+const DWORD USCallTimingLatency = 10;
+
+static double TimeClientCalls(CInstallerData* pInstallerData, const SYNTHETICCONFIG& config, DWORD* pcCalls)
+{
+    TCHAR szComponent[CCHGuid];
+    TCHAR szProduct[CCHGuid];
+    DWORD cCalls = 0;
+    double dStart = SecondsNow();
+    for (DWORD iComponent = 0; iComponent < config.cComponents; iComponent++)
+    {
+        sprintf(szComponent, TEXT("{%08X-5959-4000-8000-000000000002}"), iComponent);
+        DWORD iClientIndex = 0;
+        while (cCalls++, ERROR_SUCCESS == pInstallerData->EnumClients(szComponent, iClientIndex++, szProduct))
+            ;
+    }
+    *pcCalls = cCalls;
+    return SecondsNow() - dStart;
+}
+
+static void BenchCallTiming(const SYNTHETICCONFIG& config)
+{
+    PrintInventory(TEXT("calltiming"), TEXT("the cost of timing every call (-t)"), config);
+
+    CSyntheticInstallerData* pSynthetic = new CSyntheticInstallerData(config);
+    CCountingInstallerData Counting(pSynthetic);
+
+    DWORD cCalls = 0;
+    double dDirect = TimeClientCalls(pSynthetic, config, &cCalls);
+    double dUntimed = TimeClientCalls(&Counting, config, &cCalls);
+    StartCallTiming();
+    double dTimed = TimeClientCalls(&Counting, config, &cCalls);
+    StopCallTiming();
+
+    double nsDirect = dDirect * 1e9 / cCalls;
+    double nsUntimed = dUntimed * 1e9 / cCalls;
+    double nsTimed = dTimed * 1e9 / cCalls;
+    printf(TEXT("\t%-24s %12s %12s\n"), TEXT("MsiEnumClients"), TEXT("seconds"), TEXT("ns a call"));
+    printf(TEXT("\t%-24s %12.3f %12.1f\n"), TEXT("from the inventory"), dDirect, nsDirect);
+    printf(TEXT("\t%-24s %12.3f %12.1f\n"), TEXT("counting, -t off"), dUntimed, nsUntimed);
+    printf(TEXT("\t%-24s %12.3f %12.1f\n"), TEXT("counting, -t on"), dTimed, nsTimed);
+    double nsOverhead = (nsTimed > nsDirect) ? nsTimed - nsDirect : 0.0;
+    printf(TEXT("\t%.0fns a call; under 2%% of any call of %.1fus or more.\n"), nsOverhead, nsOverhead * 50 / 1000);
+
+    // the walk, on an inventory small enough to take a few seconds at 10us a call.
+    SYNTHETICCONFIG WalkConfig = config;
+    WalkConfig.cComponents = config.cComponents / 100;
+    CSyntheticInstallerData WalkSynthetic(WalkConfig);
+    CLatencyInstallerData* pLatency = new CLatencyInstallerData(&WalkSynthetic, USCallTimingLatency, true);
+    CCountingInstallerData WalkCounting(pLatency);
+
+    // the best of several each, taken in turn, so a busy moment does not land on one side.
+    double dWalk = 0;
+    double dWalkTimed = 0;
+    DWORD cWalkCalls = 0;
+    for (int iRun = 0; iRun < 5; iRun++)
+    {
+        double dStart = SecondsNow();
+        cWalkCalls = WalkInventory(pLatency);
+        double dRun = SecondsNow() - dStart;
+        if (0 == iRun || dRun < dWalk)
+            dWalk = dRun;
+
+        StartCallTiming();
+        dStart = SecondsNow();
+        WalkInventory(&WalkCounting);
+        dRun = SecondsNow() - dStart;
+        StopCallTiming();
+        if (0 == iRun || dRun < dWalkTimed)
+            dWalkTimed = dRun;
+    }
+
+    printf(TEXT("\t%-24s %12s %12s\n"), TEXT("walk, 10us a call"), TEXT("seconds"), TEXT("calls"));
+    printf(TEXT("\t%-24s %12.3f %12u\n"), TEXT("-t off"), dWalk, cWalkCalls);
+    printf(TEXT("\t%-24s %12.3f %12u\n"), TEXT("-t on"), dWalkTimed, TotalCallCount());
+    printf(TEXT("\t-t adds %.2f%%.\n\n"), (dWalk > 0) ? (dWalkTimed - dWalk) * 100 / dWalk : 0.0);
+}
+
+//____________________________________________________________________________
+//
+// peimage - a file keypath's version and binary type (peimage.h), over
+//     generated images already in the file cache.
+//     before: the file opened and read for the version, then again for
+//             the binary type, as MsiGetFileVersion and GetBinaryType do.
+//     after:  opened once, the headers read and then the resource
+//             section, both answers from them; 4K reads the whole of
+//             these files.  With them cached that is 3.9-5.3us a file
+//             against 10.1-12.5us read twice (a mapping of each, tried
+//             first, took 12.5-20.6us).  The open saved is most of what a
+//             probe costs on a share or behind a scanner.
+//     Then the fixtures are mutated - bytes overwritten, header fields set
+//     to extremes, the image cut short - and each mutant is parsed from a
+//     buffer exactly its size; built with -fsanitize=address, any read
+//     outside one stops the run.  products is the number of files,
+//     components the number of mutants.
+//____________________________________________________________________________
+
+struct PEFIXTURE {
+    const TCHAR*    szName;
+    IMAGEKIND       ik;
+    WORD            wMachine;
+    bool            fDll;
+    WORD            wSubsystem;
+    DWORD           dwFileVersionMS;        // 0: no version resource
+    DWORD           dwFileVersionLS;
+    DWORD           cLanguages;
+    BYTE            bTargetOS;              // NE
+    const TCHAR*    szVersion;              // what the probe should report
+    const TCHAR*    szLanguage;
+    int             iBinaryType;            // -1: none
+};
+
+static const PEFIXTURE PeFixtures[] =
+    {
+        { TEXT("PE32 program"),         ikPE32, 0x014C, false, 2, 0x00010002, 0x00030004, 1, 0, TEXT("1.2.3.4"),        TEXT("1033"),      SCS_32BIT_BINARY },
+        { TEXT("PE32+ library"),        ikPE64, 0x8664, true,  2, 0x000A0000, 0x4A610001, 2, 0, TEXT("10.0.19041.1"),   TEXT("1033,1041"), -1 },
+        { TEXT("PE32+ program"),        ikPE64, 0x8664, false, 3, 0x00060001, 0x1DB10000, 0, 0, TEXT("6.1.7601.0"),     TEXT(""),          SCS_64BIT_BINARY },
+        { TEXT("PE32 without version"), ikPE32, 0x014C, false, 2, 0,          0,          0, 0, NULL,               NULL,              SCS_32BIT_BINARY },
+        { TEXT("PE32 POSIX"),           ikPE32, 0x014C, false, 7, 0x00050000, 0x00000000, 1, 0, TEXT("5.0.0.0"),        TEXT("1033"),      SCS_POSIX_BINARY },
+        { TEXT("NE Windows"),           ikNE,   0,      false, 0, 0,          0,          0, 2, NULL,               NULL,              SCS_WOW_BINARY },
+        { TEXT("NE OS/2"),              ikNE,   0,      false, 0, 0,          0,          0, 1, NULL,               NULL,              SCS_OS216_BINARY },
+        { TEXT("DOS"),                  ikDos,  0,      false, 0, 0,          0,          0, 0, NULL,               NULL,              SCS_DOS_BINARY },
+        { TEXT("not an image"),         ikNone, 0,      false, 0, 0,          0,          0, 0, NULL,               NULL,              -1 },
+    };
+
+const DWORD CBPeFixture = 0x400;
+const DWORD IBPeFixtureHeader = 0x80;
+const DWORD IBPeFixtureResources = 0x200;
+const DWORD DWPeFixtureResourceRva = 0x1000;
+const DWORD CBPeFixtureFixedInfo = 52;         // VS_FIXEDFILEINFO
+
+static void PutWord(BYTE* pb, DWORD w)      { pb[0] = (BYTE) w; pb[1] = (BYTE) (w >> 8); }
+static void PutDword(BYTE* pb, DWORD dw)    { PutWord(pb, dw & 0xFFFF); PutWord(pb + 2, dw >> 16); }
+
+// a version resource block's header and key, padded to 4 bytes; the length is filled in later.
+static DWORD PutVersionBlock(BYTE* pb, DWORD ib, DWORD cbValue, const char* szKey)
+{
+    PutWord(pb + ib + 2, cbValue);
+    PutWord(pb + ib + 4, 0);
+    ib += 6;
+    for (const char* pch = szKey; ; pch++)
+    {
+        PutWord(pb + ib, (BYTE) *pch);
+        ib += 2;
+        if (!*pch)
+            break;
+    }
+    return (ib + 3) & ~3;
+}
+
+// one fixture's image in pb, CBPeFixture bytes; returns its size.
+static DWORD BuildPeFixture(const PEFIXTURE& Fixture, BYTE* pb)
+{
+    memset(pb, 0, CBPeFixture);
+    if (ikNone == Fixture.ik)
+    {
+        static const char szText[] = "[Setup]\r\nThis is not an executable image.\r\n";
+        memcpy(pb, szText, sizeof(szText) - 1);
+        return sizeof(szText) - 1;
+    }
+
+    pb[0] = 'M';
+    pb[1] = 'Z';
+    PutDword(pb + 0x3C, IBPeFixtureHeader);
+    BYTE* pbNew = pb + IBPeFixtureHeader;
+    if (ikDos == Fixture.ik)
+        return IBPeFixtureHeader + 0x40;
+    if (ikNE == Fixture.ik)
+    {
+        pbNew[0] = 'N';
+        pbNew[1] = 'E';
+        pbNew[0x36] = Fixture.bTargetOS;
+        return IBPeFixtureHeader + 0x40;
+    }
+
+    bool f64 = (ikPE64 == Fixture.ik);
+    DWORD cbOptional = (f64) ? 240 : 224;
+    memcpy(pbNew, "PE\0\0", 4);
+    PutWord(pbNew + 4, Fixture.wMachine);
+    PutWord(pbNew + 6, 1);
+    PutWord(pbNew + 20, cbOptional);
+    PutWord(pbNew + 22, 0x0102 | ((Fixture.fDll) ? 0x2000 : 0));
+    BYTE* pbOptional = pbNew + 24;
+    PutWord(pbOptional, (f64) ? 0x20B : 0x10B);
+    PutWord(pbOptional + 68, Fixture.wSubsystem);
+    DWORD ibDirectories = (f64) ? 112 : 96;
+    PutDword(pbOptional + ibDirectories - 4, 16);
+
+    // one section, .rsrc, on disk at IBPeFixtureResources.
+    BYTE* pbSection = pbOptional + cbOptional;
+    memcpy(pbSection, ".rsrc", 5);
+    PutDword(pbSection + 12, DWPeFixtureResourceRva);
+    PutDword(pbSection + 16, CBPeFixture - IBPeFixtureResources);
+    PutDword(pbSection + 20, IBPeFixtureResources);
+    PutDword(pbOptional + ibDirectories + 16, DWPeFixtureResourceRva);
+    PutDword(pbOptional + ibDirectories + 20, CBPeFixture - IBPeFixtureResources);
+
+    // type -> name -> language -> data entry; a version resource, or an icon in its place.
+    BYTE* pbResources = pb + IBPeFixtureResources;
+    PutWord(pbResources + 14, 1);
+    PutDword(pbResources + 16, (Fixture.dwFileVersionMS) ? 16 : 3);
+    PutDword(pbResources + 20, 0x80000018);
+    PutWord(pbResources + 0x18 + 14, 1);
+    PutDword(pbResources + 0x18 + 16, 1);
+    PutDword(pbResources + 0x18 + 20, 0x80000030);
+    PutWord(pbResources + 0x30 + 14, 1);
+    PutDword(pbResources + 0x30 + 16, 1033);
+    PutDword(pbResources + 0x30 + 20, 0x48);
+
+    // VS_VERSION_INFO: the fixed file info, then VarFileInfo\Translation.
+    BYTE* pbVersion = pbResources + 0x58;
+    DWORD ib = PutVersionBlock(pbVersion, 0, CBPeFixtureFixedInfo, "VS_VERSION_INFO");
+    PutDword(pbVersion + ib, 0xFEEF04BD);
+    PutDword(pbVersion + ib + 4, 0x00010000);
+    PutDword(pbVersion + ib + 8, Fixture.dwFileVersionMS);
+    PutDword(pbVersion + ib + 12, Fixture.dwFileVersionLS);
+    ib += CBPeFixtureFixedInfo;
+    DWORD ibVarFileInfo = ib;
+    ib = PutVersionBlock(pbVersion, ib, 0, "VarFileInfo");
+    DWORD ibVar = ib;
+    ib = PutVersionBlock(pbVersion, ib, 4 * Fixture.cLanguages, "Translation");
+    static const WORD rgwLanguage[] = { 1033, 1041 };
+    for (DWORD iLanguage = 0; iLanguage < Fixture.cLanguages; iLanguage++, ib += 4)
+        PutDword(pbVersion + ib, rgwLanguage[iLanguage] | (1200 << 16));
+    PutWord(pbVersion + ibVar, ib - ibVar);
+    PutWord(pbVersion + ibVarFileInfo, ib - ibVarFileInfo);
+    PutWord(pbVersion, ib);
+
+    PutDword(pbResources + 0x48, DWPeFixtureResourceRva + 0x58);
+    PutDword(pbResources + 0x4C, ib);
+    return CBPeFixture;
+}
+
+// what the keypath probe would report of the image: as ProbeKeyPathImage puts it.
+static bool PeFixtureAgrees(const PEFIXTURE& Fixture, const TCHAR* szFile, const PEIMAGEINFO& Image)
+{
+    TCHAR szVersion[CCHKeyPathVersion] = TEXT("");
+    TCHAR szLanguage[CCHKeyPathVersion] = TEXT("");
+    if (ERROR_SUCCESS == Image.uiVersionResult)
+        FormatPeVersion(Image, szVersion, CCHKeyPathVersion, szLanguage, CCHKeyPathVersion);
+    DWORD dwBinaryType = 0;
+    int iBinaryType = (PeBinaryType(Image, szFile, &dwBinaryType)) ? (int) dwBinaryType : -1;
+
+    if ((Image.ik != Fixture.ik) || (iBinaryType != Fixture.iBinaryType))
+        return false;
+    if (!Fixture.szVersion)
+        return (ERROR_FILE_INVALID == Image.uiVersionResult);
+    return (ERROR_SUCCESS == Image.uiVersionResult) && (0 == lstrcmp(szVersion, Fixture.szVersion)) && (0 == lstrcmp(szLanguage, Fixture.szLanguage));
+}
+
+// before: read whole for each question asked of it.
+static void ReadPeFileTwice(const TCHAR* szFile, BYTE* pbBuffer, PEIMAGEINFO* pImage)
+{
+    for (int iQuestion = 0; iQuestion < 2; iQuestion++)
+    {
+        FILE* pFile = fopen(szFile, TEXT("rb"));
+        if (!pFile)
+            continue;
+        size_t cb = fread(pbBuffer, 1, CBPeFixture, pFile);
+        fclose(pFile);
+        ParsePeImage(pbBuffer, cb, pImage);
+    }
+}
+
+static DWORD NextMutation(DWORD* pdwSeed)
+{
+    *pdwSeed = *pdwSeed * 1103515245 + 12345;
+    return *pdwSeed >> 8;
+}
+
+static void BenchPeImage(const SYNTHETICCONFIG& config)
+{
+    const DWORD cFixtures = sizeof(PeFixtures) / sizeof(PEFIXTURE);
+    printf(TEXT("peimage: keypath versions and binary types from one open (peimage.h)\n"));
+    printf(TEXT("\t%u fixtures, %u files, %u mutants\n"), cFixtures, config.cProducts, config.cComponents);
+
+    BYTE rgrgbFixture[sizeof(PeFixtures) / sizeof(PEFIXTURE)][CBPeFixture];
+    DWORD rgcbFixture[sizeof(PeFixtures) / sizeof(PEFIXTURE)];
+    DWORD cAgree = 0;
+    PEIMAGEINFO Image;
+    for (DWORD iFixture = 0; iFixture < cFixtures; iFixture++)
+    {
+        rgcbFixture[iFixture] = BuildPeFixture(PeFixtures[iFixture], rgrgbFixture[iFixture]);
+        ParsePeImage(rgrgbFixture[iFixture], rgcbFixture[iFixture], &Image);
+        if (PeFixtureAgrees(PeFixtures[iFixture], NULL, Image))
+            cAgree++;
+        else
+            printf(TEXT("\tfixture \"%s\" DISAGREES\n"), PeFixtures[iFixture].szName);
+    }
+
+    // in memory: the parse alone.
+    const DWORD cParses = (config.cComponents > cFixtures) ? config.cComponents : cFixtures;
+    double dStart = SecondsNow();
+    for (DWORD iParse = 0; iParse < cParses; iParse++)
+        ParsePeImage(rgrgbFixture[iParse % cFixtures], rgcbFixture[iParse % cFixtures], &Image);
+    double dParse = SecondsNow() - dStart;
+
+    // files: read twice against opened once.
+    TCHAR szFile[64];
+    bool fWritten = true;
+    for (DWORD iFile = 0; fWritten && (iFile < config.cProducts); iFile++)
+    {
+        sprintf(szFile, TEXT("msiinv-bench-%u.dll"), iFile);
+        FILE* pFile = fopen(szFile, TEXT("wb"));
+        fWritten = pFile && (rgcbFixture[iFile % cFixtures] == fwrite(rgrgbFixture[iFile % cFixtures], 1, rgcbFixture[iFile % cFixtures], pFile));
+        if (pFile && (0 != fclose(pFile)))
+            fWritten = false;
+    }
+    double dTwice = 0;
+    double dOnce = 0;
+    DWORD cFilesAgree = 0;
+    if (fWritten)
+    {
+        BYTE rgbBuffer[CBPeFixture];
+        dStart = SecondsNow();
+        for (DWORD iFile = 0; iFile < config.cProducts; iFile++)
+        {
+            sprintf(szFile, TEXT("msiinv-bench-%u.dll"), iFile);
+            ReadPeFileTwice(szFile, rgbBuffer, &Image);
+        }
+        dTwice = SecondsNow() - dStart;
+
+        dStart = SecondsNow();
+        for (DWORD iFile = 0; iFile < config.cProducts; iFile++)
+        {
+            sprintf(szFile, TEXT("msiinv-bench-%u.dll"), iFile);
+            ReadPeFile(szFile, &Image);
+        }
+        dOnce = SecondsNow() - dStart;
+
+        for (DWORD iFile = 0; iFile < config.cProducts; iFile++)
+        {
+            sprintf(szFile, TEXT("msiinv-bench-%u.dll"), iFile);
+            if ((ERROR_SUCCESS == ReadPeFile(szFile, &Image)) && PeFixtureAgrees(PeFixtures[iFile % cFixtures], szFile, Image))
+                cFilesAgree++;
+        }
+    }
+    for (DWORD iFile = 0; iFile < config.cProducts; iFile++)
+    {
+        sprintf(szFile, TEXT("msiinv-bench-%u.dll"), iFile);
+        remove(szFile);
+    }
+
+    printf(TEXT("\t%-24s %12s %12s %12s\n"), TEXT(""), TEXT("seconds"), TEXT("us each"), TEXT("opens each"));
+    printf(TEXT("\t%-24s %12.3f %12.3f %12s\n"), TEXT("parse, in memory"), dParse, dParse * 1e6 / cParses, TEXT("-"));
+    if (fWritten && config.cProducts)
+    {
+        printf(TEXT("\t%-24s %12.3f %12.3f %12u\n"), TEXT("file read per question"), dTwice, dTwice * 1e6 / config.cProducts, 2);
+        printf(TEXT("\t%-24s %12.3f %12.3f %12u\n"), TEXT("file opened once"), dOnce, dOnce * 1e6 / config.cProducts, 1);
+    }
+    else if (!fWritten)
+        printf(TEXT("\tcannot write the files\n"));
+    printf(TEXT("\t%u of %u fixtures and %u of %u files read as built.\n"), cAgree, cFixtures, cFilesAgree, (fWritten) ? config.cProducts : 0);
+
+    // mutants: the offsets a parser follows, and anywhere at all.
+    static const DWORD rgibField[] =
+        {
+            0x3C, IBPeFixtureHeader + 6, IBPeFixtureHeader + 20, IBPeFixtureHeader + 24 + 92, IBPeFixtureHeader + 24 + 112, IBPeFixtureHeader + 24 + 112,
+            IBPeFixtureHeader + 24 + 128, IBPeFixtureHeader + 24 + 224 + 16, IBPeFixtureHeader + 24 + 224 + 20, IBPeFixtureHeader + 24 + 240 + 20,
+            IBPeFixtureResources + 12, IBPeFixtureResources + 14, IBPeFixtureResources + 20, IBPeFixtureResources + 0x18 + 20, IBPeFixtureResources + 0x30 + 20,
+            IBPeFixtureResources + 0x48, IBPeFixtureResources + 0x4C, IBPeFixtureResources + 0x58, IBPeFixtureResources + 0x5A,
+        };
+    static const DWORD rgdwExtreme[] = { 0, 1, 6, 0x7FFF, 0xFFFF, 0x7FFFFFFF, 0x80000000, 0xFFFFFFF0, 0xFFFFFFFF };
+    DWORD dwSeed = 1;
+    DWORD rgcResult[3] = { 0, 0, 0 };       // with a version, without, invalid
+    DWORD cImages = 0;
+    dStart = SecondsNow();
+    for (DWORD iMutant = 0; iMutant < config.cComponents; iMutant++)
+    {
+        DWORD iFixture = NextMutation(&dwSeed) % cFixtures;
+        BYTE rgbMutant[CBPeFixture];
+        memcpy(rgbMutant, rgrgbFixture[iFixture], CBPeFixture);
+        DWORD cMutations = 1 + NextMutation(&dwSeed) % 4;
+        for (DWORD iMutation = 0; iMutation < cMutations; iMutation++)
+        {
+            if (NextMutation(&dwSeed) & 1)
+            {
+                DWORD ibField = rgibField[NextMutation(&dwSeed) % (sizeof(rgibField) / sizeof(DWORD))];
+                PutDword(rgbMutant + ibField, rgdwExtreme[NextMutation(&dwSeed) % (sizeof(rgdwExtreme) / sizeof(DWORD))]);
+            }
+            else
+                rgbMutant[NextMutation(&dwSeed) % CBPeFixture] = (BYTE) NextMutation(&dwSeed);
+        }
+        DWORD cbMutant = rgcbFixture[iFixture];
+        if (0 == NextMutation(&dwSeed) % 4)
+            cbMutant = NextMutation(&dwSeed) % (cbMutant + 1);
+
+        // exactly its size, so a read past it is a read past the allocation.
+        BYTE* pbMutant = (BYTE*) malloc(cbMutant + 1);
+        if (!pbMutant)
+            break;
+        memcpy(pbMutant, rgbMutant, cbMutant);
+        ParsePeImage(pbMutant, cbMutant, &Image);
+        free(pbMutant);
+
+        if (ikNone != Image.ik)
+            cImages++;
+        rgcResult[(ERROR_SUCCESS == Image.uiVersionResult) ? 0 : (ERROR_FILE_INVALID == Image.uiVersionResult) ? 1 : 2]++;
+    }
+    double dMutants = SecondsNow() - dStart;
+    printf(TEXT("\t%u mutants in %.3f seconds: %u images; %u with a version, %u without, %u with invalid version information.\n\n"),
+        config.cComponents, dMutants, cImages, rgcResult[0], rgcResult[1], rgcResult[2]);
+}
+
+//____________________________________________________________________________
+//
+// regkeys - registry keypaths (regkeys.h) against a stand-in registry
+//     (standinreg.h) shaped like a machine's: COM classes under
+//     HKLM\SOFTWARE\Classes\CLSID, vendors' keys with two values kept in
+//     one key, per-user keys, the 64-bit view, one key in ten missing and
+//     a vendor that is gone altogether.
+//     before: each keypath's key opened whole from its root.  (The probe
+//             this replaces opened the root alone, and said every key
+//             existed.)
+//     after:  through CRegistryKeyCache, from the ancestors it keeps open.
+//     The registry's cost follows the opens and the segments each walks;
+//     the stand-in counts both.  Its open is a hash lookup a segment, as
+//     cheap as a step of the trie's own walk, so in memory the two take
+//     the same time (0.25-0.32s against 0.23-0.30s from the root, 200000
+//     keypaths): the walk spends what the 570000 segments it saves cost.
+//     Against the registry an open is a system call costing microseconds,
+//     and each segment a lookup under the hive's lock, and those are what
+//     the trie takes away.  products is the number of vendors, components
+//     the number of keypaths.
+//____________________________________________________________________________
+
+const DWORD CCHRegKeysKeyPath = 128;
+
+// keypath iKeyPath of the generated machine, and the key it names when the machine has it.
+static void FormatRegKeysKeyPath(DWORD iKeyPath, DWORD cVendors, TCHAR* szKeyPath, TCHAR* szKey)
+{
+    DWORD iVendor = (iKeyPath / 7) % ((cVendors) ? cVendors : 1);
+    DWORD iProduct = (iKeyPath / 3) % 20;
+    *szKey = 0;
+    switch (iKeyPath % 8)
+    {
+        case 0:
+        case 1:
+        case 2:
+            sprintf(szKeyPath, TEXT("02:\\SOFTWARE\\Classes\\CLSID\\{%08X-0000-4000-8000-%012X}\\InprocServer32\\"), iKeyPath, iVendor);
+            sprintf(szKey, TEXT("HKEY_LOCAL_MACHINE\\SOFTWARE\\Classes\\CLSID\\{%08X-0000-4000-8000-%012X}\\InprocServer32"), iKeyPath, iVendor);
+            break;
+        case 3:
+        case 4:
+            // two values of one key.
+            sprintf(szKeyPath, TEXT("02:\\SOFTWARE\\Vendor %u\\Product %u\\Settings %u\\%s"), iVendor, iProduct, iKeyPath / 2,
+                (3 == iKeyPath % 8) ? TEXT("Version") : TEXT("InstallDir"));
+            sprintf(szKey, TEXT("HKEY_LOCAL_MACHINE\\SOFTWARE\\Vendor %u\\Product %u\\Settings %u"), iVendor, iProduct, iKeyPath / 2);
+            break;
+        case 5:
+            sprintf(szKeyPath, TEXT("01:\\Software\\Vendor %u\\Product %u\\Component %u\\"), iVendor, iProduct, iKeyPath);
+            sprintf(szKey, TEXT("HKEY_CURRENT_USER\\Software\\Vendor %u\\Product %u\\Component %u"), iVendor, iProduct, iKeyPath);
+            break;
+        case 6:
+            sprintf(szKeyPath, TEXT("22:\\SOFTWARE\\Vendor %u\\Product %u\\Component %u\\Path"), iVendor, iProduct, iKeyPath);
+            sprintf(szKey, TEXT("HKEY_LOCAL_MACHINE\\SOFTWARE\\Vendor %u\\Product %u\\Component %u"), iVendor, iProduct, iKeyPath);
+            break;
+        default:
+            // a vendor uninstalled since, its components orphaned.
+            sprintf(szKeyPath, TEXT("02:\\SOFTWARE\\Gone Vendor\\Product %u\\Component %u\\"), iProduct, iKeyPath);
+            return;
+    }
+    if (9 == iKeyPath % 10)
+        *szKey = 0;
+}
+
+static CStandInRegistry* BuildRegKeysRegistry(const SYNTHETICCONFIG& config, TCHAR* rgszKeyPath)
+{
+    CStandInRegistry* pRegistry = new CStandInRegistry;
+    TCHAR szKey[CCHRegKeysKeyPath];
+    for (DWORD iKeyPath = 0; iKeyPath < config.cComponents; iKeyPath++)
+    {
+        FormatRegKeysKeyPath(iKeyPath, config.cProducts, rgszKeyPath + iKeyPath * CCHRegKeysKeyPath, szKey);
+        if (*szKey && !pRegistry->AddKey(szKey))
+        {
+            delete pRegistry;
+            return NULL;
+        }
+    }
+    return pRegistry;
+}
+
+// before: the key opened whole from its root.
+static void ProbeRegKeysFromRoot(CRegistry* pRegistry, const TCHAR* szKeyPath, KEYPATHPROBE* pProbe)
+{
+    InitKeyPathProbe(pProbe);
+    pProbe->fRegistry = pProbe->fRegistryRoot = true;
+    TCHAR szKey[CCHRegKeysKeyPath];
+    const TCHAR* pchKey = szKeyPath + 4;
+    DWORD cchKey = (DWORD) (strrchr(pchKey, '\\') - pchKey);
+    memcpy(szKey, pchKey, cchKey * sizeof(TCHAR));
+    szKey[cchKey] = 0;
+
+    HKEY hKey = NULL;
+    pProbe->dwRegistryError = pRegistry->OpenKey(pRegistry->RootKey(szKeyPath[1] - '0'), szKey, '2' == szKeyPath[0], &hKey);
+    if (ERROR_SUCCESS == pProbe->dwRegistryError)
+    {
+        pRegistry->ProbeKey(hKey, pProbe);
+        pRegistry->CloseKey(hKey);
+    }
+}
+
+static void BenchRegKeys(const SYNTHETICCONFIG& config)
+{
+    printf(TEXT("regkeys: registry keypaths from the ancestors kept open (regkeys.h)\n"));
+    printf(TEXT("\t%u keypaths, %u vendors\n"), config.cComponents, config.cProducts);
+
+    TCHAR* rgszKeyPath = (TCHAR*) malloc((size_t) config.cComponents * CCHRegKeysKeyPath * sizeof(TCHAR));
+    DWORD* rgdwError = (DWORD*) malloc((size_t) config.cComponents * sizeof(DWORD));
+    CStandInRegistry* pRoots = (rgszKeyPath && rgdwError) ? BuildRegKeysRegistry(config, rgszKeyPath) : NULL;
+    CStandInRegistry* pKept = (pRoots) ? BuildRegKeysRegistry(config, rgszKeyPath) : NULL;
+    if (!pKept)
+    {
+        printf(TEXT("\tout of memory building the registry\n\n"));
+        delete pRoots;
+        free(rgdwError);
+        free(rgszKeyPath);
+        return;
+    }
+
+    KEYPATHPROBE Probe;
+    DWORD cFound = 0;
+    double dStart = SecondsNow();
+    for (DWORD iKeyPath = 0; iKeyPath < config.cComponents; iKeyPath++)
+    {
+        ProbeRegKeysFromRoot(pRoots, rgszKeyPath + iKeyPath * CCHRegKeysKeyPath, &Probe);
+        rgdwError[iKeyPath] = Probe.dwRegistryError;
+        if (ERROR_SUCCESS == Probe.dwRegistryError)
+            cFound++;
+    }
+    double dRoots = SecondsNow() - dStart;
+
+    CRegistryKeyCache* pCache = new CRegistryKeyCache(pKept);
+    DWORD cAgree = 0;
+    dStart = SecondsNow();
+    for (DWORD iKeyPath = 0; iKeyPath < config.cComponents; iKeyPath++)
+    {
+        pCache->ProbeKeyPath(rgszKeyPath + iKeyPath * CCHRegKeysKeyPath, &Probe);
+        if (rgdwError[iKeyPath] == Probe.dwRegistryError)
+            cAgree++;
+    }
+    double dKept = SecondsNow() - dStart;
+
+    DWORD cKeyPaths = (config.cComponents) ? config.cComponents : 1;
+    printf(TEXT("\t%-24s %12s %12s %12s %12s\n"), TEXT(""), TEXT("seconds"), TEXT("opens"), TEXT("segments"), TEXT("segs each"));
+    printf(TEXT("\t%-24s %12.3f %12u %12u %12.2f\n"), TEXT("from the root"), dRoots, pRoots->OpenCount(), pRoots->SegmentCount(),
+        (double) pRoots->SegmentCount() / cKeyPaths);
+    printf(TEXT("\t%-24s %12.3f %12u %12u %12.2f\n"), TEXT("from ancestors kept"), dKept, pKept->OpenCount(), pKept->SegmentCount(),
+        (double) pKept->SegmentCount() / cKeyPaths);
+    printf(TEXT("\t%u of %u keys found, %u answers agree; %u keys kept open, %u handles left open besides.\n\n"),
+        cFound, config.cComponents, cAgree, pCache->OpenCount(), pKept->HandleCount() - pCache->OpenCount());
+
+    delete pCache;
+    delete pRoots;
+    free(rgdwError);
+    free(rgszKeyPath);
+}
+
+//____________________________________________________________________________
+//
+// dircache - file keypaths (dircache.h) in a tree shaped like a
+//     machine's: many keypaths to a directory, other files beside them,
+//     one keypath in eight to a file that is gone.  The keypaths come in
+//     the order a report probes them, every directory's interleaved.
+//     before: each keypath's file asked about on its own (stat, or
+//             GetFileAttributesEx on Windows).
+//     after:  through CDirectoryCache, each directory listed once.
+//     A listing costs a call for the directory and one for each entry
+//     FindNextFile returns, which on Windows comes from a page of entries
+//     the file system returned at once.  Off Windows readdir brings only
+//     names, and each keypath found is still an fstatat from its
+//     directory; the calls saved are the missing files'.  Against a tree
+//     the kernel has cached that loses on time: 20000 keypaths in 50
+//     directories take 0.045s from listings against 0.033s file by file,
+//     the map of every entry costing more than the stats it saves.  The
+//     file calls are the measure of what a listing saves against a slow
+//     or remote file system.  products is the number of directories,
+//     components the number of keypaths.
+//____________________________________________________________________________
+
+static const TCHAR SZDirCacheRoot[] = TEXT("msiinv-bench-dircache");
+
+// keypath iKeyPath of the tree, or with fOther the other file of that number.
+static void FormatDirCachePath(DWORD iKeyPath, DWORD cDirectories, bool fOther, TCHAR* szFile)
+{
+    sprintf(szFile, (fOther) ? TEXT("%s/Product %u/other%u.dat") : TEXT("%s/Product %u/file%u.dll"),
+        SZDirCacheRoot, iKeyPath % cDirectories, iKeyPath);
+}
+
+static bool MakeBenchDirectory(const TCHAR* szDirectory)
+{
+#ifdef _WIN32
+    return (FALSE != CreateDirectory(szDirectory, NULL));
+#else
+    return (0 == mkdir(szDirectory, 0755));
+#endif
+}
+
+static void RemoveBenchDirectory(const TCHAR* szDirectory)
+{
+#ifdef _WIN32
+    RemoveDirectory(szDirectory);
+#else
+    rmdir(szDirectory);
+#endif
+}
+
+// one file on its own, as the probe asked before.
+static bool ReadDirCacheFile(const TCHAR* szFile, DIRENTRYINFO* pEntry)
+{
+    memset(pEntry, 0, sizeof(DIRENTRYINFO));
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA FileInformation;
+    if (!GetFileAttributesEx(szFile, GetFileExInfoStandard, &FileInformation))
+        return false;
+    pEntry->dwAttributes = FileInformation.dwFileAttributes;
+    pEntry->nFileSizeHigh = FileInformation.nFileSizeHigh;
+    pEntry->nFileSizeLow = FileInformation.nFileSizeLow;
+    pEntry->ftCreationTime = FileInformation.ftCreationTime;
+    pEntry->ftLastWriteTime = FileInformation.ftLastWriteTime;
+#else
+    struct stat st;
+    if (0 != stat(szFile, &st))
+        return false;
+    DirectoryEntryFromStat(st, pEntry);
+#endif
+    return true;
+}
+
+static void RemoveDirCacheTree(DWORD cDirectories, DWORD cKeyPaths)
+{
+    TCHAR szFile[MAX_PATH];
+    for (DWORD iKeyPath = 0; iKeyPath < cKeyPaths; iKeyPath++)
+    {
+        FormatDirCachePath(iKeyPath, cDirectories, false, szFile);
+        remove(szFile);
+        FormatDirCachePath(iKeyPath, cDirectories, true, szFile);
+        remove(szFile);
+    }
+    for (DWORD iDirectory = 0; iDirectory < cDirectories; iDirectory++)
+    {
+        sprintf(szFile, TEXT("%s/Product %u"), SZDirCacheRoot, iDirectory);
+        RemoveBenchDirectory(szFile);
+    }
+    RemoveBenchDirectory(SZDirCacheRoot);
+}
+
+static void BenchDirCache(const SYNTHETICCONFIG& config)
+{
+    const DWORD cDirectories = (config.cProducts) ? config.cProducts : 1;
+    const DWORD cKeyPaths = config.cComponents;
+    printf(TEXT("dircache: file keypaths from listings of their directories (dircache.h)\n"));
+    printf(TEXT("\t%u keypaths in %u directories\n"), cKeyPaths, cDirectories);
+
+    // the tree: the keypaths that are there, and one other file for every four keypaths.
+    TCHAR szFile[MAX_PATH];
+    bool fWritten = MakeBenchDirectory(SZDirCacheRoot);
+    for (DWORD iDirectory = 0; fWritten && (iDirectory < cDirectories); iDirectory++)
+    {
+        sprintf(szFile, TEXT("%s/Product %u"), SZDirCacheRoot, iDirectory);
+        fWritten = MakeBenchDirectory(szFile);
+    }
+    for (DWORD iKeyPath = 0; fWritten && (iKeyPath < cKeyPaths); iKeyPath++)
+    {
+        for (int iFile = 0; fWritten && (iFile < 2); iFile++)
+        {
+            if ((0 == iFile) ? (7 == iKeyPath % 8) : (0 != iKeyPath % 4))
+                continue;
+            FormatDirCachePath(iKeyPath, cDirectories, 1 == iFile, szFile);
+            FILE* pFile = fopen(szFile, TEXT("wb"));
+            fWritten = (NULL != pFile);
+            for (DWORD cb = iKeyPath % 64; fWritten && cb; cb--)
+                fWritten = (EOF != fputc('x', pFile));
+            if (pFile && (0 != fclose(pFile)))
+                fWritten = false;
+        }
+    }
+    DIRENTRYINFO* rgEntry = (fWritten) ? (DIRENTRYINFO*) malloc(((size_t) cKeyPaths + 1) * sizeof(DIRENTRYINFO)) : NULL;
+    bool* rgfFound = (rgEntry) ? (bool*) malloc(((size_t) cKeyPaths + 1) * sizeof(bool)) : NULL;
+    if (!rgfFound)
+    {
+        printf(TEXT("\tcannot write the tree in %s\n\n"), SZDirCacheRoot);
+        free(rgEntry);
+        RemoveDirCacheTree(cDirectories, cKeyPaths);
+        return;
+    }
+
+    DWORD cFound = 0;
+    double dStart = SecondsNow();
+    for (DWORD iKeyPath = 0; iKeyPath < cKeyPaths; iKeyPath++)
+    {
+        FormatDirCachePath(iKeyPath, cDirectories, false, szFile);
+        rgfFound[iKeyPath] = ReadDirCacheFile(szFile, &rgEntry[iKeyPath]);
+        if (rgfFound[iKeyPath])
+            cFound++;
+    }
+    double dFiles = SecondsNow() - dStart;
+
+    CDirectoryCache* pDirectories = new CDirectoryCache;
+    DIRENTRYINFO Entry;
+    DWORD cAgree = 0;
+    dStart = SecondsNow();
+    for (DWORD iKeyPath = 0; iKeyPath < cKeyPaths; iKeyPath++)
+    {
+        FormatDirCachePath(iKeyPath, cDirectories, false, szFile);
+        DIRLOOKUP dl = pDirectories->FindFile(szFile, &Entry);
+        bool fFound = (dlFound == dl);
+        if (dlNotListed == dl)
+            fFound = ReadDirCacheFile(szFile, &Entry);
+        if ((fFound == rgfFound[iKeyPath]) &&
+            (!fFound || ((Entry.dwAttributes == rgEntry[iKeyPath].dwAttributes) && (Entry.nFileSizeLow == rgEntry[iKeyPath].nFileSizeLow) &&
+                         (Entry.nFileSizeHigh == rgEntry[iKeyPath].nFileSizeHigh) &&
+                         (0 == memcmp(&Entry.ftLastWriteTime, &rgEntry[iKeyPath].ftLastWriteTime, sizeof(FILETIME))))))
+            cAgree++;
+    }
+    double dListed = SecondsNow() - dStart;
+
+    DWORD cListedCalls = cKeyPaths - pDirectories->AnsweredCount();
+    printf(TEXT("\t%-24s %12s %12s %12s %12s\n"), TEXT(""), TEXT("seconds"), TEXT("file calls"), TEXT("listings"), TEXT("entries"));
+    printf(TEXT("\t%-24s %12.3f %12u %12u %12u\n"), TEXT("file by file"), dFiles, cKeyPaths, 0, 0);
+    printf(TEXT("\t%-24s %12.3f %12u %12u %12u\n"), TEXT("from listings"), dListed, cListedCalls,
+        pDirectories->ListingCount(), pDirectories->ListedEntryCount());
+    printf(TEXT("\t%u of %u keypaths found, %u answers agree; %u answered from listings.\n\n"),
+        cFound, cKeyPaths, cAgree, pDirectories->AnsweredCount());
+
+    delete pDirectories;
+    free(rgfFound);
+    free(rgEntry);
+    RemoveDirCacheTree(cDirectories, cKeyPaths);
+}
+
+//____________________________________________________________________________
+
+// a case that is not a report over an inventory reads products= and
+// components= as counts of its own; szProducts and szComponents name them.
+struct BENCHCASE {
+    const TCHAR* szName;
+    const TCHAR* szDefaultInventory;
+    const TCHAR* szProducts;
+    const TCHAR* szComponents;
+    void (*pfnRun)(const SYNTHETICCONFIG& config);
+};
+
+static const BENCHCASE BenchCases[] =
+    {
+        TEXT("parent"), TEXT("products=1000,components=100000"), TEXT("products"), TEXT("components"), BenchParentLookup,
+        TEXT("replay"), TEXT("products=150,components=6000"), TEXT("products"), TEXT("components"), BenchReplay,
+        TEXT("snapshot"), TEXT("products=1000,components=100000"), TEXT("products"), TEXT("components"), BenchBinarySnapshot,
+        TEXT("enrich"), TEXT("products=32,components=300,features=4"), TEXT("products"), TEXT("components"), BenchEnrich,
+        TEXT("probe"), TEXT("products=20,components=1000"), TEXT("products"), TEXT("components"), BenchProbe,
+        TEXT("output"), TEXT("products=1000,components=100000"), TEXT("products"), TEXT("components"), BenchOutput,
+        TEXT("guid"), TEXT("products=1000,components=100000"), TEXT("products"), TEXT("components"), BenchGuidKeys,
+        TEXT("filter"), TEXT("products=5000,components=5000"), TEXT("products"), TEXT("components"), BenchFilter,
+        TEXT("events"), TEXT("products=1,components=200000"), TEXT("(unused)"), TEXT("event records"), BenchEventLog,
+        TEXT("eventjoin"), TEXT("products=2000,components=100000"), TEXT("products"), TEXT("event records"), BenchEventJoin,
+        TEXT("logscan"), TEXT("products=8,components=64"), TEXT("logs"), TEXT("MB per log"), BenchLogScan,
+        TEXT("profile"), TEXT("products=400,components=256"), TEXT("action names"), TEXT("MB of log"), BenchProfile,
+        TEXT("calltiming"), TEXT("products=100,components=200000"), TEXT("products"), TEXT("components"), BenchCallTiming,
+        TEXT("scaling"), TEXT("products=100,components=10000,clients=3,patches=2,qualifiers=2"), TEXT("products"), TEXT("components"), BenchScaling,
+        TEXT("peimage"), TEXT("products=2000,components=1000000"), TEXT("files"), TEXT("mutants"), BenchPeImage,
+        TEXT("regkeys"), TEXT("products=100,components=200000"), TEXT("vendors"), TEXT("keypaths"), BenchRegKeys,
+        TEXT("dircache"), TEXT("products=50,components=20000"), TEXT("directories"), TEXT("keypaths"), BenchDirCache,
+    };
+
+int RunBenchmarks(const TCHAR* szCase, const SYNTHETICCONFIG* pConfig)
+{
+    bool fRan = false;
+    for (int iCase = 0; iCase < (int) (sizeof(BenchCases) / sizeof(BENCHCASE)); iCase++)
+    {
+        if (szCase && 0 != lstrcmpi(szCase, BenchCases[iCase].szName))
+            continue;
+
+        SYNTHETICCONFIG config;
+        if (pConfig)
+            config = *pConfig;
+        else
+            ParseSyntheticConfig(BenchCases[iCase].szDefaultInventory, &config);
+
+        BenchCases[iCase].pfnRun(config);
+        fRan = true;
+    }
+
+    if (!fRan)
+    {
+        fprintf(stderr, TEXT("Unknown benchmark '%s'.  Available, and what products= and components= count in each:\n"), szCase);
+        for (int iCase = 0; iCase < (int) (sizeof(BenchCases) / sizeof(BENCHCASE)); iCase++)
+            fprintf(stderr, TEXT("\t%-12s %s, %s\n"), BenchCases[iCase].szName, BenchCases[iCase].szProducts, BenchCases[iCase].szComponents);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,22 @@
+/*---------------------------------------------------------------------------
+Benchmarks (-bench).
+
+    Each case runs against a CSyntheticInstallerData so results can be
+    produced off-box and compared between machines.  A case that measures
+    an algorithm against the one it replaced times the old one over a
+    prefix of the inventory when running it to completion would take
+    hours, and scales the result up; the table says when it did.
+---------------------------------------------------------------------------*/
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "installerdata.h"
+
+// szCase NULL runs every case.  pConfig NULL uses each case's own inventory.
+int RunBenchmarks(const TCHAR* szCase, const SYNTHETICCONFIG* pConfig);
+
+// the report main runs, for -bench scaling (msiinv.cpp).
+int RunReport(int argc, char* argv[]);
+
+#endif // BENCH_H
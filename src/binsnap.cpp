@@ -0,0 +1,618 @@
+/*---------------------------------------------------------------------------
+Binary inventory snapshots - see binsnap.h.
+---------------------------------------------------------------------------*/
+
+#include "binsnap.h"
+#include "compindex.h"
+#include "infoquery.h"
+#include "strmap.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// the table a column belongs to is the first column of that table.
+static BINSNAPCOLUMN TableOfColumn(int bc)
+{
+    if (bc < bcFeatureProduct)
+        return bcProductCode;
+    if (bc < bcPatchProduct)
+        return bcFeatureProduct;
+    if (bc < bcComponentCode)
+        return bcPatchProduct;
+    if (bc < bcClientComponent)
+        return bcComponentCode;
+    if (bc < bcProbeKeyPath)
+        return bcClientComponent;
+    return bcProbeKeyPath;
+}
+
+static DWORD WidthOfColumn(int bc)
+{
+    if (bcFeatureDateUsed == bc)
+        return sizeof(WORD);
+    if (bcProbeCreationTime == bc || bcProbeLastWriteTime == bc)
+        return sizeof(unsigned __int64);
+    return sizeof(DWORD);
+}
+
+//____________________________________________________________________________
+//
+// Writer
+//
+//    Columns are built in memory, then written in one pass.  Strings are
+//    pooled through a case-sensitive STRINGMAP whose keys are private
+//    copies, since the pool itself moves as it grows.
+//____________________________________________________________________________
+
+struct COLUMNBUFFER {
+    BYTE*   pb;
+    DWORD   cb;
+    DWORD   cbAllocated;
+};
+
+struct SNAPSHOTWRITER {
+    COLUMNBUFFER    rgColumn[CBinSnapColumns];
+    COLUMNBUFFER    Pool;
+    STRINGMAP       PoolMap;        // string -> pool offset
+    STRINGMAP       ProbeMap;       // keypath -> probe row, case-insensitive
+    bool            fOutOfMemory;
+};
+
+static void AppendBytes(SNAPSHOTWRITER* pWriter, COLUMNBUFFER* pBuffer, const void* pv, DWORD cb)
+{
+    if (pWriter->fOutOfMemory)
+        return;
+
+    if (pBuffer->cb + cb > pBuffer->cbAllocated)
+    {
+        DWORD cbAllocated = (pBuffer->cbAllocated) ? pBuffer->cbAllocated : 4096;
+        while (cbAllocated < pBuffer->cb + cb)
+            cbAllocated *= 2;
+
+        BYTE* pb = (BYTE*) realloc(pBuffer->pb, cbAllocated);
+        if (!pb)
+        {
+            pWriter->fOutOfMemory = true;
+            return;
+        }
+        pBuffer->pb = pb;
+        pBuffer->cbAllocated = cbAllocated;
+    }
+
+    memcpy(pBuffer->pb + pBuffer->cb, pv, cb);
+    pBuffer->cb += cb;
+}
+
+static DWORD ColumnRows(const SNAPSHOTWRITER* pWriter, BINSNAPCOLUMN bc)
+{
+    return pWriter->rgColumn[bc].cb / WidthOfColumn(bc);
+}
+
+static void AppendDword(SNAPSHOTWRITER* pWriter, BINSNAPCOLUMN bc, DWORD dwValue)
+{
+    AppendBytes(pWriter, &pWriter->rgColumn[bc], &dwValue, sizeof(DWORD));
+}
+
+static void AppendFileTime(SNAPSHOTWRITER* pWriter, BINSNAPCOLUMN bc, const FILETIME& ft)
+{
+    unsigned __int64 ullValue = (unsigned __int64) FileTimeToInt64(&ft);
+    AppendBytes(pWriter, &pWriter->rgColumn[bc], &ullValue, sizeof(ullValue));
+}
+
+static DWORD PoolString(SNAPSHOTWRITER* pWriter, const TCHAR* szValue)
+{
+    DWORD ibString = 0;
+    if (FindStringMapValue(&pWriter->PoolMap, szValue, &ibString))
+        return ibString;
+
+    DWORD cbValue = (lstrlen(szValue) + 1) * sizeof(TCHAR);
+    TCHAR* szKey = (TCHAR*) malloc(cbValue);
+    if (!szKey)
+    {
+        pWriter->fOutOfMemory = true;
+        return 0;
+    }
+    memcpy(szKey, szValue, cbValue);
+
+    ibString = pWriter->Pool.cb;
+    AppendBytes(pWriter, &pWriter->Pool, szValue, cbValue);
+    if (pWriter->fOutOfMemory || !SetStringMapValue(&pWriter->PoolMap, szKey, ibString))
+    {
+        free(szKey);
+        pWriter->fOutOfMemory = true;
+        return 0;
+    }
+    return ibString;
+}
+
+static void AppendString(SNAPSHOTWRITER* pWriter, BINSNAPCOLUMN bc, const TCHAR* szValue)
+{
+    AppendDword(pWriter, bc, (szValue) ? PoolString(pWriter, szValue) : BINSNAPNone);
+}
+
+// the strings are read into pArena, which is reset after the product is pooled.
+static void WriteProduct(SNAPSHOTWRITER* pWriter, CInstallerData* pSource, const TCHAR* szProduct, CStringArena* pArena)
+{
+    const TCHAR* szValue;
+    DWORD iProduct = ColumnRows(pWriter, bcProductCode);
+
+    AppendString(pWriter, bcProductCode, szProduct);
+    AppendDword(pWriter, bcProductState, (DWORD) pSource->QueryProductState(szProduct));
+
+    for (int iProperty = 0; iProperty < CInventoryProperties; iProperty++)
+    {
+        UINT uiResult = QueryProductInfo(pSource, szProduct, SZInventoryProperty[iProperty], pArena, &szValue);
+        AppendString(pWriter, (BINSNAPCOLUMN) (bcProductProperty + iProperty), (ERROR_SUCCESS == uiResult) ? szValue : NULL);
+    }
+
+    AppendDword(pWriter, bcProductFirstFeature, ColumnRows(pWriter, bcFeatureProduct));
+    TCHAR szFeature[MAX_FEATURE_CHARS + 1];
+    TCHAR szParent[MAX_FEATURE_CHARS + 1];
+    DWORD iFeatureIndex = 0;
+    while (ERROR_SUCCESS == pSource->EnumFeatures(szProduct, iFeatureIndex, szFeature, szParent))
+    {
+        DWORD dwUseCount = 0;
+        WORD wDateUsed = 0;
+        if (ERROR_SUCCESS != pSource->GetFeatureUsage(szProduct, szFeature, &dwUseCount, &wDateUsed))
+        {
+            dwUseCount = BINSNAPNone;
+            wDateUsed = 0;
+        }
+
+        AppendDword(pWriter, bcFeatureProduct, iProduct);
+        AppendString(pWriter, bcFeatureName, szFeature);
+        AppendString(pWriter, bcFeatureParent, szParent);
+        AppendDword(pWriter, bcFeatureState, (DWORD) pSource->QueryFeatureState(szProduct, szFeature));
+        AppendDword(pWriter, bcFeatureUseCount, dwUseCount);
+        AppendBytes(pWriter, &pWriter->rgColumn[bcFeatureDateUsed], &wDateUsed, sizeof(WORD));
+        iFeatureIndex++;
+    }
+    AppendDword(pWriter, bcProductFeatureCount, iFeatureIndex);
+
+    AppendDword(pWriter, bcProductFirstPatch, ColumnRows(pWriter, bcPatchProduct));
+    TCHAR szPatch[CCHGuid];
+    DWORD iPatchIndex = 0;
+    while (ERROR_SUCCESS == QueryPatch(pSource, szProduct, iPatchIndex, szPatch, pArena, &szValue))
+    {
+        AppendDword(pWriter, bcPatchProduct, iProduct);
+        AppendString(pWriter, bcPatchCode, szPatch);
+        AppendString(pWriter, bcPatchTransforms, szValue);
+        iPatchIndex++;
+    }
+    AppendDword(pWriter, bcProductPatchCount, iPatchIndex);
+    pArena->Reset();
+}
+
+// keypaths are probed once each, however many clients share them.
+static DWORD WriteProbe(SNAPSHOTWRITER* pWriter, CInstallerData* pSource, const TCHAR* szKeyPath)
+{
+    DWORD iProbe = BINSNAPNone;
+    if (!*szKeyPath || FindStringMapValue(&pWriter->ProbeMap, szKeyPath, &iProbe))
+        return iProbe;
+
+    KEYPATHPROBE Probe;
+    pSource->ProbeKeyPath(szKeyPath, &Probe);
+
+    // the pool moves as it grows, so the probe map keeps its own copy of the key.
+    DWORD cbKeyPath = (lstrlen(szKeyPath) + 1) * sizeof(TCHAR);
+    TCHAR* szKey = (TCHAR*) malloc(cbKeyPath);
+    if (!szKey)
+    {
+        pWriter->fOutOfMemory = true;
+        return BINSNAPNone;
+    }
+    memcpy(szKey, szKeyPath, cbKeyPath);
+
+    iProbe = ColumnRows(pWriter, bcProbeKeyPath);
+    if (!SetStringMapValue(&pWriter->ProbeMap, szKey, iProbe))
+    {
+        free(szKey);
+        pWriter->fOutOfMemory = true;
+        return BINSNAPNone;
+    }
+
+    DWORD dwFlags = (Probe.fRegistry ? BINSNAPProbeRegistry : 0) |
+                    (Probe.fRegistryRoot ? BINSNAPProbeRegistryRoot : 0) |
+                    (Probe.fLastWriteTime ? BINSNAPProbeLastWriteTime : 0) |
+                    (Probe.fExtendedAttributes ? BINSNAPProbeExtendedAttributes : 0) |
+                    (Probe.fBinaryType ? BINSNAPProbeBinaryType : 0);
+
+    AppendString(pWriter, bcProbeKeyPath, szKeyPath);
+    AppendDword(pWriter, bcProbeFlags, dwFlags);
+    AppendDword(pWriter, bcProbeRegistryError, Probe.dwRegistryError);
+    AppendDword(pWriter, bcProbeAttributes, Probe.dwAttributes);
+    AppendDword(pWriter, bcProbeFileSizeHigh, Probe.nFileSizeHigh);
+    AppendDword(pWriter, bcProbeFileSizeLow, Probe.nFileSizeLow);
+    AppendFileTime(pWriter, bcProbeCreationTime, Probe.ftCreationTime);
+    AppendFileTime(pWriter, bcProbeLastWriteTime, Probe.ftLastWriteTime);
+    AppendDword(pWriter, bcProbeVersionResult, Probe.uiVersionResult);
+    AppendString(pWriter, bcProbeVersion, Probe.szVersion);
+    AppendString(pWriter, bcProbeLanguage, Probe.szLanguage);
+    AppendDword(pWriter, bcProbeBinaryType, Probe.dwBinaryType);
+    AppendDword(pWriter, bcProbeOwnerState, (DWORD) Probe.osOwner);
+    AppendDword(pWriter, bcProbeOwnerError, Probe.dwOwnerError);
+    AppendString(pWriter, bcProbeOwner, Probe.szOwner);
+
+    return iProbe;
+}
+
+struct CODEROW {
+    const TCHAR*    szCode;
+    DWORD           iRow;
+};
+
+static int __cdecl CompareCodeRows(const void* pv1, const void* pv2)
+{
+    const CODEROW* p1 = (const CODEROW*) pv1;
+    const CODEROW* p2 = (const CODEROW*) pv2;
+    int iCompare = _stricmp(p1->szCode, p2->szCode);
+    if (0 == iCompare)
+        iCompare = (p1->iRow < p2->iRow) ? -1 : (p1->iRow > p2->iRow) ? 1 : 0;
+    return iCompare;
+}
+
+static void AppendSortedRows(SNAPSHOTWRITER* pWriter, BINSNAPCOLUMN bcCode, BINSNAPCOLUMN bcByCode)
+{
+    DWORD cRows = ColumnRows(pWriter, bcCode);
+    if (pWriter->fOutOfMemory || !cRows)
+        return;
+
+    CODEROW* rgCodeRows = (CODEROW*) malloc(cRows * sizeof(CODEROW));
+    if (!rgCodeRows)
+    {
+        pWriter->fOutOfMemory = true;
+        return;
+    }
+
+    const DWORD* rgibCode = (const DWORD*) pWriter->rgColumn[bcCode].pb;
+    for (DWORD iRow = 0; iRow < cRows; iRow++)
+    {
+        rgCodeRows[iRow].szCode = (const TCHAR*) (pWriter->Pool.pb + rgibCode[iRow]);
+        rgCodeRows[iRow].iRow = iRow;
+    }
+    qsort(rgCodeRows, cRows, sizeof(CODEROW), CompareCodeRows);
+
+    for (DWORD iRow = 0; iRow < cRows; iRow++)
+        AppendDword(pWriter, bcByCode, rgCodeRows[iRow].iRow);
+    free(rgCodeRows);
+}
+
+static UINT WriteSnapshotFile(const SNAPSHOTWRITER* pWriter, const TCHAR* szFile)
+{
+    BINSNAPHEADER Header;
+    memset(&Header, 0, sizeof(Header));
+    Header.dwSignature = BINSNAPSignature;
+    Header.dwVersion = BINSNAPVersion;
+    Header.cColumns = CBinSnapColumns;
+
+    unsigned __int64 ibNext = sizeof(BINSNAPHEADER);
+    for (int bc = 0; bc < CBinSnapColumns; bc++)
+    {
+        ibNext = (ibNext + 7) & ~7ULL;
+        Header.rgColumn[bc].ibData = (DWORD) ibNext;
+        Header.rgColumn[bc].cbWidth = WidthOfColumn(bc);
+        Header.rgColumn[bc].cRows = pWriter->rgColumn[bc].cb / WidthOfColumn(bc);
+        ibNext += pWriter->rgColumn[bc].cb;
+    }
+    ibNext = (ibNext + 7) & ~7ULL;
+    Header.ibStringPool = (DWORD) ibNext;
+    Header.cbStringPool = pWriter->Pool.cb;
+    ibNext += pWriter->Pool.cb;
+
+    // offsets are 32 bits.
+    if (ibNext > 0xFFFFFFFFULL)
+        return ERROR_NOT_ENOUGH_MEMORY;
+    Header.cbFile = (DWORD) ibNext;
+
+    FILE* pFile = fopen(szFile, TEXT("wb"));
+    if (!pFile)
+        return ERROR_OPEN_FAILED;
+
+    static const BYTE rgbPadding[8] = { 0 };
+    unsigned __int64 ibWritten = 0;
+    fwrite(&Header, sizeof(Header), 1, pFile);
+    ibWritten += sizeof(Header);
+    for (int bc = 0; bc < CBinSnapColumns; bc++)
+    {
+        fwrite(rgbPadding, 1, (size_t) (Header.rgColumn[bc].ibData - ibWritten), pFile);
+        ibWritten = Header.rgColumn[bc].ibData;
+        if (pWriter->rgColumn[bc].cb)
+            fwrite(pWriter->rgColumn[bc].pb, 1, pWriter->rgColumn[bc].cb, pFile);
+        ibWritten += pWriter->rgColumn[bc].cb;
+    }
+    fwrite(rgbPadding, 1, (size_t) (Header.ibStringPool - ibWritten), pFile);
+    fwrite(pWriter->Pool.pb, 1, pWriter->Pool.cb, pFile);
+
+    UINT uiResult = (ferror(pFile)) ? ERROR_WRITE_FAULT : ERROR_SUCCESS;
+    if (0 != fclose(pFile))
+        uiResult = ERROR_WRITE_FAULT;
+    return uiResult;
+}
+
+UINT WriteBinarySnapshot(CInstallerData* pSource, const TCHAR* szFile)
+{
+    COMPONENTINDEX Index;
+    UINT uiResult = BuildComponentIndex(pSource, &Index);
+    if (ERROR_SUCCESS != uiResult)
+        return uiResult;
+
+    SNAPSHOTWRITER Writer;
+    memset(&Writer, 0, sizeof(Writer));
+    if (!InitStringMap(&Writer.PoolMap, 4096, true) || !InitStringMap(&Writer.ProbeMap, Index.cComponents, false))
+        Writer.fOutOfMemory = true;
+
+    // offset 0 is "".
+    PoolString(&Writer, TEXT(""));
+
+    CStringArena Arena;
+    DWORD iProductIndex = 0;
+    TCHAR szProduct[CCHGuid] = TEXT("");
+    while (!Writer.fOutOfMemory && (ERROR_SUCCESS == pSource->EnumProducts(iProductIndex++, szProduct)))
+        WriteProduct(&Writer, pSource, szProduct, &Arena);
+    AppendSortedRows(&Writer, bcProductCode, bcProductByCode);
+
+    // client edges point at product rows; look them up through a map of the codes just written.
+    STRINGMAP ProductRows;
+    memset(&ProductRows, 0, sizeof(ProductRows));
+    DWORD cProducts = ColumnRows(&Writer, bcProductCode);
+    if (!Writer.fOutOfMemory && InitStringMap(&ProductRows, cProducts, false))
+    {
+        const DWORD* rgibCode = (const DWORD*) Writer.rgColumn[bcProductCode].pb;
+        for (DWORD iProduct = 0; iProduct < cProducts; iProduct++)
+        {
+            if (!SetStringMapValue(&ProductRows, (const TCHAR*) (Writer.Pool.pb + rgibCode[iProduct]), iProduct))
+                Writer.fOutOfMemory = true;
+        }
+    }
+    else
+    {
+        Writer.fOutOfMemory = true;
+    }
+
+    // ProductRows points into the pool, which must not move while it is in use:
+    // everything below that pools a string is done after the lookups.
+    for (DWORD iComponent = 0; !Writer.fOutOfMemory && (iComponent < Index.cComponents); iComponent++)
+    {
+        AppendDword(&Writer, bcComponentFirstClient, ColumnRows(&Writer, bcClientComponent));
+        AppendDword(&Writer, bcComponentClientCount, ComponentClientCount(&Index, iComponent));
+        for (DWORD iClient = Index.rgiFirstClient[iComponent]; iClient < Index.rgiFirstClient[iComponent + 1]; iClient++)
+        {
+            DWORD iProduct = BINSNAPNone;
+            if (!FindStringMapValue(&ProductRows, Index.rgClients[iClient].szClient, &iProduct))
+                iProduct = BINSNAPNone;
+            AppendDword(&Writer, bcClientComponent, iComponent);
+            AppendDword(&Writer, bcClientProduct, iProduct);
+        }
+    }
+    FreeStringMap(&ProductRows);
+
+    for (DWORD iComponent = 0; !Writer.fOutOfMemory && (iComponent < Index.cComponents); iComponent++)
+    {
+        const TCHAR* szComponent = Index.rgszComponent[iComponent];
+        AppendString(&Writer, bcComponentCode, szComponent);
+
+        for (DWORD iClient = Index.rgiFirstClient[iComponent]; iClient < Index.rgiFirstClient[iComponent + 1]; iClient++)
+        {
+            const TCHAR* szClient = Index.rgClients[iClient].szClient;
+            const TCHAR* szPath;
+            INSTALLSTATE isPath = QueryComponentPath(pSource, szClient, szComponent, &Arena, &szPath);
+
+            AppendString(&Writer, bcClientCode, szClient);
+            AppendDword(&Writer, bcClientPathState, (DWORD) isPath);
+            AppendString(&Writer, bcClientPath, szPath);
+            AppendDword(&Writer, bcClientProbe, WriteProbe(&Writer, pSource, szPath));
+        }
+        Arena.Reset();
+    }
+    AppendSortedRows(&Writer, bcComponentCode, bcComponentByCode);
+
+    if (Writer.fOutOfMemory)
+        uiResult = ERROR_NOT_ENOUGH_MEMORY;
+    else
+        uiResult = WriteSnapshotFile(&Writer, szFile);
+
+    // both maps' keys are private copies.
+    for (DWORD iSlot = 0; iSlot < Writer.PoolMap.cSlots; iSlot++)
+        free((void*) Writer.PoolMap.rgszKey[iSlot]);
+    for (DWORD iSlot = 0; iSlot < Writer.ProbeMap.cSlots; iSlot++)
+        free((void*) Writer.ProbeMap.rgszKey[iSlot]);
+    FreeStringMap(&Writer.PoolMap);
+    FreeStringMap(&Writer.ProbeMap);
+    for (int bc = 0; bc < CBinSnapColumns; bc++)
+        free(Writer.rgColumn[bc].pb);
+    free(Writer.Pool.pb);
+    FreeComponentIndex(&Index);
+    return uiResult;
+}
+
+//____________________________________________________________________________
+//
+// Reader
+//____________________________________________________________________________
+
+CBinarySnapshot::CBinarySnapshot()
+    : m_pbView(NULL), m_cbView(0), m_pHeader(NULL)
+{
+}
+
+CBinarySnapshot::~CBinarySnapshot()
+{
+    Close();
+}
+
+void CBinarySnapshot::Close()
+{
+    if (m_pbView)
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(m_pbView);
+#else
+        munmap((void*) m_pbView, m_cbView);
+#endif
+    }
+    m_pbView = NULL;
+    m_cbView = 0;
+    m_pHeader = NULL;
+}
+
+UINT CBinarySnapshot::Open(const TCHAR* szFile)
+{
+    Close();
+
+#ifdef _WIN32
+    HANDLE hFile = CreateFile(szFile, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (INVALID_HANDLE_VALUE == hFile)
+        return ERROR_FILE_NOT_FOUND;
+
+    DWORD cbFileHigh = 0;
+    DWORD cbFile = GetFileSize(hFile, &cbFileHigh);
+    if (cbFileHigh || cbFile < sizeof(BINSNAPHEADER))
+    {
+        CloseHandle(hFile);
+        return ERROR_INVALID_DATA;
+    }
+
+    // the view keeps the file open once the handles are closed.
+    HANDLE hMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(hFile);
+    if (!hMapping)
+        return ERROR_INVALID_DATA;
+    m_pbView = (const BYTE*) MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(hMapping);
+#else
+    int fd = open(szFile, O_RDONLY);
+    if (fd < 0)
+        return ERROR_FILE_NOT_FOUND;
+
+    struct stat st;
+    if (0 != fstat(fd, &st) || st.st_size < (off_t) sizeof(BINSNAPHEADER) || st.st_size > (off_t) 0xFFFFFFFF)
+    {
+        close(fd);
+        return ERROR_INVALID_DATA;
+    }
+    DWORD cbFile = (DWORD) st.st_size;
+
+    void* pv = mmap(NULL, cbFile, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    m_pbView = (MAP_FAILED == pv) ? NULL : (const BYTE*) pv;
+#endif
+
+    if (!m_pbView)
+        return ERROR_INVALID_DATA;
+    m_cbView = cbFile;
+    m_pHeader = (const BINSNAPHEADER*) m_pbView;
+
+    bool fValid = (BINSNAPSignature == m_pHeader->dwSignature) && (BINSNAPVersion == m_pHeader->dwVersion) &&
+                  (CBinSnapColumns == m_pHeader->cColumns) && (m_cbView == m_pHeader->cbFile);
+
+    for (int bc = 0; fValid && bc < CBinSnapColumns; bc++)
+    {
+        const BINSNAPCOLUMNDESC& Column = m_pHeader->rgColumn[bc];
+        fValid = (WidthOfColumn(bc) == Column.cbWidth) &&
+                 (0 == Column.ibData % Column.cbWidth) &&
+                 ((unsigned __int64) Column.ibData + (unsigned __int64) Column.cRows * Column.cbWidth <= m_cbView) &&
+                 (Column.cRows == m_pHeader->rgColumn[TableOfColumn(bc)].cRows);
+    }
+
+    // a NUL at the end of the pool means every offset in it reads as a terminated string.
+    fValid = fValid && (m_pHeader->cbStringPool > 0) &&
+             ((unsigned __int64) m_pHeader->ibStringPool + m_pHeader->cbStringPool <= m_cbView) &&
+             (0 == m_pbView[m_pHeader->ibStringPool + m_pHeader->cbStringPool - 1]);
+
+    if (!fValid)
+    {
+        Close();
+        return ERROR_INVALID_DATA;
+    }
+    return ERROR_SUCCESS;
+}
+
+const TCHAR* CBinarySnapshot::String(DWORD ibString) const
+{
+    if (BINSNAPNone == ibString)
+        return NULL;
+    if (ibString >= m_pHeader->cbStringPool)
+        return TEXT("");
+    return (const TCHAR*) (m_pbView + m_pHeader->ibStringPool + ibString);
+}
+
+DWORD CBinarySnapshot::FindByCode(BINSNAPCOLUMN bcByCode, BINSNAPCOLUMN bcCode, const TCHAR* szCode) const
+{
+    const DWORD* rgiByCode = Column(bcByCode);
+    const DWORD* rgibCode = Column(bcCode);
+    DWORD cRows = Rows(bcCode);
+
+    // lower bound, so a code listed twice finds its first row.
+    DWORD iLow = 0;
+    DWORD iHigh = cRows;
+    while (iLow < iHigh)
+    {
+        DWORD iMid = iLow + (iHigh - iLow) / 2;
+        DWORD iRow = rgiByCode[iMid];
+        if (iRow >= cRows)
+            return BINSNAPNone;
+        if (_stricmp(String(rgibCode[iRow]), szCode) < 0)
+            iLow = iMid + 1;
+        else
+            iHigh = iMid;
+    }
+
+    if (iLow < cRows && rgiByCode[iLow] < cRows && 0 == _stricmp(String(rgibCode[rgiByCode[iLow]]), szCode))
+        return rgiByCode[iLow];
+    return BINSNAPNone;
+}
+
+DWORD CBinarySnapshot::FindProduct(const TCHAR* szProduct) const
+{
+    return FindByCode(bcProductByCode, bcProductCode, szProduct);
+}
+
+DWORD CBinarySnapshot::FindComponent(const TCHAR* szComponent) const
+{
+    return FindByCode(bcComponentByCode, bcComponentCode, szComponent);
+}
+
+static void CopyProbeString(TCHAR* szDest, int cchDest, const TCHAR* szSource)
+{
+    if (!szSource)
+        szSource = TEXT("");
+    int cch = lstrlen(szSource);
+    if (cch >= cchDest)
+        cch = cchDest - 1;
+    memcpy(szDest, szSource, cch * sizeof(TCHAR));
+    szDest[cch] = 0;
+}
+
+void CBinarySnapshot::GetProbe(DWORD iProbe, KEYPATHPROBE* pProbe) const
+{
+    InitKeyPathProbe(pProbe);
+    if (iProbe >= Rows(bcProbeKeyPath))
+        return;
+
+    DWORD dwFlags = Column(bcProbeFlags)[iProbe];
+    pProbe->fRegistry = (0 != (dwFlags & BINSNAPProbeRegistry));
+    pProbe->fRegistryRoot = (0 != (dwFlags & BINSNAPProbeRegistryRoot));
+    pProbe->fLastWriteTime = (0 != (dwFlags & BINSNAPProbeLastWriteTime));
+    pProbe->fExtendedAttributes = (0 != (dwFlags & BINSNAPProbeExtendedAttributes));
+    pProbe->fBinaryType = (0 != (dwFlags & BINSNAPProbeBinaryType));
+    pProbe->dwRegistryError = Column(bcProbeRegistryError)[iProbe];
+    pProbe->dwAttributes = Column(bcProbeAttributes)[iProbe];
+    pProbe->nFileSizeHigh = Column(bcProbeFileSizeHigh)[iProbe];
+    pProbe->nFileSizeLow = Column(bcProbeFileSizeLow)[iProbe];
+    Int64ToFileTime((__int64) Column64(bcProbeCreationTime)[iProbe], &pProbe->ftCreationTime);
+    Int64ToFileTime((__int64) Column64(bcProbeLastWriteTime)[iProbe], &pProbe->ftLastWriteTime);
+    pProbe->uiVersionResult = Column(bcProbeVersionResult)[iProbe];
+    CopyProbeString(pProbe->szVersion, CCHKeyPathVersion, String(Column(bcProbeVersion)[iProbe]));
+    CopyProbeString(pProbe->szLanguage, CCHKeyPathVersion, String(Column(bcProbeLanguage)[iProbe]));
+    pProbe->dwBinaryType = Column(bcProbeBinaryType)[iProbe];
+    pProbe->osOwner = (OWNERSTATE) Column(bcProbeOwnerState)[iProbe];
+    pProbe->dwOwnerError = Column(bcProbeOwnerError)[iProbe];
+    CopyProbeString(pProbe->szOwner, CCHKeyPathOwner, String(Column(bcProbeOwner)[iProbe]));
+}
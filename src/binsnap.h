@@ -0,0 +1,153 @@
+/*---------------------------------------------------------------------------
+Binary inventory snapshots (-o).
+
+    A snapshot for fleet analysis rather than for the report: products,
+    features, patches, components, client edges and keypath probes stored
+    as fixed-width columns, with every string in one deduplicated pool.
+    A reader maps the file and reads the columns where they lie - opening
+    one checks the header and column bounds and nothing else, so it costs
+    the same for 50 KB as for 50 MB.
+
+        BINSNAPHEADER
+        column 0 .. column CBinSnapColumns-1    each 8-byte aligned
+        string pool                             NUL-terminated strings
+
+    A string column holds the byte offset of its string in the pool, or
+    BINSNAPNone when the installer had no value.  Offset 0 is "".  A row
+    column holds a row number in another table, or BINSNAPNone.  Every
+    table's rows are in enumeration order; ...ByCode columns hold the same
+    rows sorted by code (case-insensitively) for lookups and merge joins.
+    Integers are little-endian.
+---------------------------------------------------------------------------*/
+
+#ifndef BINSNAP_H
+#define BINSNAP_H
+
+#include "installerdata.h"
+
+const DWORD BINSNAPSignature = 0x534E534D;     // "MSNS"
+const DWORD BINSNAPVersion   = 1;
+const DWORD BINSNAPNone      = 0xFFFFFFFF;
+
+enum BINSNAPCOLUMN {
+    // products, MsiEnumProducts order
+    bcProductCode,                  // string
+    bcProductState,                 // INSTALLSTATE
+    bcProductFirstFeature,          // row in features
+    bcProductFeatureCount,
+    bcProductFirstPatch,            // row in patches
+    bcProductPatchCount,
+    bcProductProperty,              // CInventoryProperties string columns, INVENTORYPROPERTY order
+    bcProductByCode = bcProductProperty + CInventoryProperties,
+
+    // features, grouped by product, MsiEnumFeatures order
+    bcFeatureProduct,               // row in products
+    bcFeatureName,                  // string
+    bcFeatureParent,                // string
+    bcFeatureState,                 // INSTALLSTATE
+    bcFeatureUseCount,              // BINSNAPNone when MsiGetFeatureUsage failed
+    bcFeatureDateUsed,              // WORD, DOS date
+
+    // patches, grouped by product
+    bcPatchProduct,                 // row in products
+    bcPatchCode,                    // string
+    bcPatchTransforms,              // string
+
+    // components, MsiEnumComponents order
+    bcComponentCode,                // string
+    bcComponentFirstClient,         // row in clients
+    bcComponentClientCount,
+    bcComponentByCode,
+
+    // client edges, grouped by component, MsiEnumClients order
+    bcClientComponent,              // row in components
+    bcClientCode,                   // string, product code as enumerated
+    bcClientProduct,                // row in products; BINSNAPNone when not an installed product
+    bcClientPathState,              // INSTALLSTATE from MsiGetComponentPath
+    bcClientPath,                   // string
+    bcClientProbe,                  // row in probes; BINSNAPNone without a path
+
+    // keypath probes, one per distinct path
+    bcProbeKeyPath,                 // string
+    bcProbeFlags,                   // BINSNAPProbe*
+    bcProbeRegistryError,
+    bcProbeAttributes,
+    bcProbeFileSizeHigh,
+    bcProbeFileSizeLow,
+    bcProbeCreationTime,            // 64-bit FILETIME
+    bcProbeLastWriteTime,           // 64-bit FILETIME
+    bcProbeVersionResult,
+    bcProbeVersion,                 // string
+    bcProbeLanguage,                // string
+    bcProbeBinaryType,
+    bcProbeOwnerState,              // OWNERSTATE
+    bcProbeOwnerError,
+    bcProbeOwner,                   // string
+
+    CBinSnapColumns
+};
+
+// bcProbeFlags
+const DWORD BINSNAPProbeRegistry           = 0x01;
+const DWORD BINSNAPProbeRegistryRoot       = 0x02;
+const DWORD BINSNAPProbeLastWriteTime      = 0x04;
+const DWORD BINSNAPProbeExtendedAttributes = 0x08;
+const DWORD BINSNAPProbeBinaryType         = 0x10;
+
+struct BINSNAPCOLUMNDESC {
+    DWORD   ibData;                 // from the start of the file
+    DWORD   cRows;
+    DWORD   cbWidth;                // 2, 4 or 8
+    DWORD   dwReserved;
+};
+
+struct BINSNAPHEADER {
+    DWORD               dwSignature;
+    DWORD               dwVersion;
+    DWORD               cColumns;
+    DWORD               cbFile;
+    DWORD               ibStringPool;
+    DWORD               cbStringPool;
+    BINSNAPCOLUMNDESC   rgColumn[CBinSnapColumns];
+};
+
+// walks the provider once.  ERROR_OPEN_FAILED, ERROR_WRITE_FAULT, ERROR_NOT_ENOUGH_MEMORY.
+UINT WriteBinarySnapshot(CInstallerData* pSource, const TCHAR* szFile);
+
+class CBinarySnapshot
+{
+public:
+    CBinarySnapshot();
+    ~CBinarySnapshot();
+
+    // maps the file read-only.  ERROR_FILE_NOT_FOUND, or ERROR_INVALID_DATA
+    // when the header or a column does not fit the file.
+    UINT  Open(const TCHAR* szFile);
+    void  Close();
+
+    DWORD Rows(BINSNAPCOLUMN bc) const          { return m_pHeader->rgColumn[bc].cRows; }
+    const DWORD* Column(BINSNAPCOLUMN bc) const { return (const DWORD*) (m_pbView + m_pHeader->rgColumn[bc].ibData); }
+    const WORD* Column16(BINSNAPCOLUMN bc) const { return (const WORD*) (m_pbView + m_pHeader->rgColumn[bc].ibData); }
+    const unsigned __int64* Column64(BINSNAPCOLUMN bc) const { return (const unsigned __int64*) (m_pbView + m_pHeader->rgColumn[bc].ibData); }
+
+    DWORD ProductCount() const                  { return Rows(bcProductCode); }
+    DWORD ComponentCount() const                { return Rows(bcComponentCode); }
+
+    // NULL for BINSNAPNone; "" for an offset outside the pool.
+    const TCHAR* String(DWORD ibString) const;
+
+    // row, or BINSNAPNone.  Binary search over the ...ByCode column.
+    DWORD FindProduct(const TCHAR* szProduct) const;
+    DWORD FindComponent(const TCHAR* szComponent) const;
+
+    void  GetProbe(DWORD iProbe, KEYPATHPROBE* pProbe) const;
+
+private:
+    DWORD FindByCode(BINSNAPCOLUMN bcByCode, BINSNAPCOLUMN bcCode, const TCHAR* szCode) const;
+
+    const BYTE*             m_pbView;
+    DWORD                   m_cbView;
+    const BINSNAPHEADER*    m_pHeader;
+};
+
+#endif // BINSNAP_H
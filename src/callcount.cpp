@@ -0,0 +1,251 @@
+/*---------------------------------------------------------------------------
+Call counts and latencies - see callcount.h.
+---------------------------------------------------------------------------*/
+
+#include "callcount.h"
+#include <string.h>
+
+const TCHAR* const TimedCallNames[cTimedCalls] =
+    {
+        TEXT("MsiEnumProducts"),
+        TEXT("MsiQueryProductState"),
+        TEXT("MsiGetProductInfo"),
+        TEXT("MsiGetUserInfo"),
+        TEXT("MsiEnumFeatures"),
+        TEXT("MsiQueryFeatureState"),
+        TEXT("MsiGetFeatureUsage"),
+        TEXT("MsiEnumComponents"),
+        TEXT("MsiEnumClients"),
+        TEXT("MsiGetComponentPath"),
+        TEXT("MsiEnumComponentQualifiers"),
+        TEXT("MsiEnumPatches"),
+        TEXT("keypath probe"),
+        TEXT("MsiSetInternalUI"),
+        TEXT("MsiGetFileVersion"),
+        TEXT("GetFileAttributesEx"),
+        TEXT("GetFileSecurity"),
+        TEXT("keypath image"),
+        TEXT("RegOpenKeyEx"),
+        TEXT("RegGetKeySecurity"),
+        TEXT("RegQueryInfoKey"),
+        TEXT("LookupAccountSid"),
+        TEXT("OpenEventLog"),
+        TEXT("ReadEventLog"),
+        TEXT("FindFirstFile"),
+        TEXT("FindNextFile"),
+        TEXT("CreateEnvironmentBlock"),
+        TEXT("ReadFile"),
+    };
+
+const TCHAR* const CallPhaseNames[cCallPhases] =
+    {
+        TEXT("setup"),
+        TEXT("events"),
+        TEXT("products"),
+        TEXT("components"),
+        TEXT("logs"),
+    };
+
+struct CALLSLOT {
+    volatile __int64    lgTicks;
+    volatile LONG       rgcBucket[CLatencyBuckets];
+};
+
+bool g_fTimeCalls = false;
+
+static CALLSLOT s_rgSlot[cCallPhases][cTimedCalls];
+static volatile LONG s_lPhase = cpSetup;
+static __int64 s_lgFrequency = 1;           // ticks a second
+static __int64 s_rglgBucketEnd[CLatencyBuckets - 1];    // ticks under which a call is in each bucket
+
+__int64 CallClock()
+{
+    LARGE_INTEGER liNow;
+    QueryPerformanceCounter(&liNow);
+    return liNow.QuadPart;
+}
+
+static CALLPHASE CurrentPhase()
+{
+#ifdef _WIN32
+    return (CALLPHASE) s_lPhase;        // an aligned LONG is read whole
+#else
+    return (CALLPHASE) __atomic_load_n(&s_lPhase, __ATOMIC_RELAXED);
+#endif
+}
+
+void StartCallTiming()
+{
+    LARGE_INTEGER liFrequency;
+    if (QueryPerformanceFrequency(&liFrequency) && liFrequency.QuadPart > 0)
+        s_lgFrequency = liFrequency.QuadPart;
+    for (DWORD iBucket = 0; iBucket < CLatencyBuckets - 1; iBucket++)
+        s_rglgBucketEnd[iBucket] = (s_lgFrequency << iBucket) / 1000000;
+    memset((void*) s_rgSlot, 0, sizeof(s_rgSlot));
+    s_lPhase = cpSetup;
+    g_fTimeCalls = true;
+}
+
+void StopCallTiming()
+{
+    g_fTimeCalls = false;
+}
+
+void SetCallPhase(CALLPHASE cp)
+{
+    InterlockedExchange(&s_lPhase, cp);
+}
+
+// bucket i is under 2^i us.  Most calls are in the first few, so they are
+// looked at from the shortest, and nothing is divided until the report.
+static DWORD LatencyBucket(__int64 lgTicks)
+{
+    DWORD iBucket = 0;
+    while (iBucket < CLatencyBuckets - 1 && lgTicks >= s_rglgBucketEnd[iBucket])
+        iBucket++;
+    return iBucket;
+}
+
+static unsigned __int64 Microseconds(__int64 lgTicks)
+{
+    if (lgTicks <= 0)
+        return 0;
+    // hours of calls would overflow the product.
+    if (lgTicks > (__int64) 0x7FFFFFFFFFFFFFFFLL / 1000000)
+        return (unsigned __int64) (lgTicks / s_lgFrequency) * 1000000;
+    return (unsigned __int64) (lgTicks * 1000000 / s_lgFrequency);
+}
+
+void RecordCall(TIMEDCALL tc, __int64 lgTicks)
+{
+    CALLSLOT* pSlot = &s_rgSlot[CurrentPhase()][tc];
+    InterlockedExchangeAdd64(&pSlot->lgTicks, lgTicks);
+    InterlockedIncrement(&pSlot->rgcBucket[LatencyBucket(lgTicks)]);
+}
+
+void GetCallStats(CALLPHASE cp, TIMEDCALL tc, CALLSTATS* pStats)
+{
+    memset(pStats, 0, sizeof(*pStats));
+    __int64 lgTicks = 0;
+    for (int iPhase = 0; iPhase < cCallPhases; iPhase++)
+    {
+        if (cCallPhases != cp && iPhase != cp)
+            continue;
+        const CALLSLOT& Slot = s_rgSlot[iPhase][tc];
+        lgTicks += Slot.lgTicks;
+        for (DWORD iBucket = 0; iBucket < CLatencyBuckets; iBucket++)
+        {
+            pStats->rgcBucket[iBucket] += (DWORD) Slot.rgcBucket[iBucket];
+            pStats->cCalls += (DWORD) Slot.rgcBucket[iBucket];
+        }
+    }
+    pStats->usTotal = Microseconds(lgTicks);
+}
+
+DWORD TotalCallCount()
+{
+    DWORD cCalls = 0;
+    for (int tc = 0; tc < cTimedCalls; tc++)
+    {
+        CALLSTATS Stats;
+        GetCallStats(cCallPhases, (TIMEDCALL) tc, &Stats);
+        cCalls += Stats.cCalls;
+    }
+    return cCalls;
+}
+
+const TCHAR* LatencyBucketName(DWORD iBucket)
+{
+    static const TCHAR* const rgszBucket[CLatencyBuckets] =
+        {
+            TEXT("1us"), TEXT("2us"), TEXT("4us"), TEXT("8us"), TEXT("16us"), TEXT("32us"), TEXT("64us"), TEXT("128us"),
+            TEXT("256us"), TEXT("512us"), TEXT("1ms"), TEXT("2ms"), TEXT("4ms"), TEXT("8ms"), TEXT("16ms"), TEXT("32ms"),
+            TEXT("64ms"), TEXT("128ms"), TEXT("256ms"), TEXT("512ms"), TEXT("1s"), TEXT("2s"), TEXT("4s"), TEXT(">4s"),
+        };
+    return (iBucket < CLatencyBuckets) ? rgszBucket[iBucket] : TEXT("");
+}
+
+CCountingInstallerData::~CCountingInstallerData()
+{
+    delete m_pSource;
+}
+
+UINT CCountingInstallerData::EnumProducts(DWORD iProductIndex, TCHAR* lpProductBuf)
+{
+    CCallTimer Timer(tcEnumProducts);
+    return m_pSource->EnumProducts(iProductIndex, lpProductBuf);
+}
+
+INSTALLSTATE CCountingInstallerData::QueryProductState(const TCHAR* szProduct)
+{
+    CCallTimer Timer(tcQueryProductState);
+    return m_pSource->QueryProductState(szProduct);
+}
+
+UINT CCountingInstallerData::GetProductInfo(const TCHAR* szProduct, const TCHAR* szAttribute, TCHAR* lpValueBuf, DWORD* pcchValueBuf)
+{
+    CCallTimer Timer(tcGetProductInfo);
+    return m_pSource->GetProductInfo(szProduct, szAttribute, lpValueBuf, pcchValueBuf);
+}
+
+USERINFOSTATE CCountingInstallerData::GetUserInfo(const TCHAR* szProduct, TCHAR* lpUserNameBuf, DWORD* pcchUserNameBuf,
+                                                  TCHAR* lpOrgNameBuf, DWORD* pcchOrgNameBuf, TCHAR* lpSerialBuf, DWORD* pcchSerialBuf)
+{
+    CCallTimer Timer(tcGetUserInfo);
+    return m_pSource->GetUserInfo(szProduct, lpUserNameBuf, pcchUserNameBuf, lpOrgNameBuf, pcchOrgNameBuf, lpSerialBuf, pcchSerialBuf);
+}
+
+UINT CCountingInstallerData::EnumFeatures(const TCHAR* szProduct, DWORD iFeatureIndex, TCHAR* lpFeatureBuf, TCHAR* lpParentBuf)
+{
+    CCallTimer Timer(tcEnumFeatures);
+    return m_pSource->EnumFeatures(szProduct, iFeatureIndex, lpFeatureBuf, lpParentBuf);
+}
+
+INSTALLSTATE CCountingInstallerData::QueryFeatureState(const TCHAR* szProduct, const TCHAR* szFeature)
+{
+    CCallTimer Timer(tcQueryFeatureState);
+    return m_pSource->QueryFeatureState(szProduct, szFeature);
+}
+
+UINT CCountingInstallerData::GetFeatureUsage(const TCHAR* szProduct, const TCHAR* szFeature, DWORD* pdwUseCount, WORD* pwDateUsed)
+{
+    CCallTimer Timer(tcGetFeatureUsage);
+    return m_pSource->GetFeatureUsage(szProduct, szFeature, pdwUseCount, pwDateUsed);
+}
+
+UINT CCountingInstallerData::EnumComponents(DWORD iComponentIndex, TCHAR* lpComponentBuf)
+{
+    CCallTimer Timer(tcEnumComponents);
+    return m_pSource->EnumComponents(iComponentIndex, lpComponentBuf);
+}
+
+UINT CCountingInstallerData::EnumClients(const TCHAR* szComponent, DWORD iProductIndex, TCHAR* lpProductBuf)
+{
+    CCallTimer Timer(tcEnumClients);
+    return m_pSource->EnumClients(szComponent, iProductIndex, lpProductBuf);
+}
+
+INSTALLSTATE CCountingInstallerData::GetComponentPath(const TCHAR* szProduct, const TCHAR* szComponent, TCHAR* lpPathBuf, DWORD* pcchBuf)
+{
+    CCallTimer Timer(tcGetComponentPath);
+    return m_pSource->GetComponentPath(szProduct, szComponent, lpPathBuf, pcchBuf);
+}
+
+UINT CCountingInstallerData::EnumComponentQualifiers(const TCHAR* szComponent, DWORD iIndex, TCHAR* lpQualifierBuf, DWORD* pcchQualifierBuf,
+                                                     TCHAR* lpApplicationDataBuf, DWORD* pcchApplicationDataBuf)
+{
+    CCallTimer Timer(tcEnumComponentQualifiers);
+    return m_pSource->EnumComponentQualifiers(szComponent, iIndex, lpQualifierBuf, pcchQualifierBuf, lpApplicationDataBuf, pcchApplicationDataBuf);
+}
+
+UINT CCountingInstallerData::EnumPatches(const TCHAR* szProduct, DWORD iPatchIndex, TCHAR* lpPatchBuf, TCHAR* lpTransformsBuf, DWORD* pcchTransformsBuf)
+{
+    CCallTimer Timer(tcEnumPatches);
+    return m_pSource->EnumPatches(szProduct, iPatchIndex, lpPatchBuf, lpTransformsBuf, pcchTransformsBuf);
+}
+
+void CCountingInstallerData::ProbeKeyPath(const TCHAR* szKeyPath, KEYPATHPROBE* pProbe)
+{
+    CCallTimer Timer(tcProbeKeyPath);
+    m_pSource->ProbeKeyPath(szKeyPath, pProbe);
+}
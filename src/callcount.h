@@ -0,0 +1,164 @@
+/*---------------------------------------------------------------------------
+Call counts and latencies (-t).
+
+    How long a report takes on a box says little about why; how many
+    times it asked the installer and the system each question, and how
+    long the answers took, says a great deal.  With -t every installer
+    call, and every Win32 call that goes to the disk, the registry, the
+    security database or the event log, is counted and timed, and the
+    report ends with a table of them for each phase of the run:
+
+        setup       the component index and the installed product set
+        events      the MsiInstaller events -productevents joins
+        products    the product report, -j's workers and -probe's threads
+        components  the component evaluation
+        logs        the log files and the event log (-l)
+
+    and, for the whole run, a histogram of each call's latencies in
+    powers of two of a microsecond - how many answered in under 1us, 2us,
+    4us, and so on - so a call that is slow once in a thousand shows up
+    even when its average does not.
+
+    The installer's calls are timed by wrapping the provider in a
+    CCountingInstallerData, under the keypath probe cache, so a probe the
+    cache answers is not counted; a "keypath probe" is the whole probe,
+    the Win32 calls it makes among them, and a "keypath image" the one
+    open and mapping of a file that reads its version and binary type
+    (peimage.h).  The Win32 calls are timed where
+    they are made, with a CCallTimer.  Off Windows the calls that stand
+    in for them - the passwd lookup for LookupAccountSid, readdir for
+    FindNextFile, reading an -events dump for ReadEventLog - are counted
+    under the Win32 name.
+
+    Times come from QueryPerformanceCounter (a monotonic clock, off
+    Windows), two reads a call.  Each call adds its time and its bucket
+    with interlocked operations, so -j's workers share the tables without
+    a lock; a worker's call goes in the phase the report is in when it
+    ends.  With -t off a CCallTimer reads no clock at all.
+
+    The counts are kept for the whole process, since the provider is
+    gone by the time -bench scaling reads them.
+---------------------------------------------------------------------------*/
+
+#ifndef CALLCOUNT_H
+#define CALLCOUNT_H
+
+#include "installerdata.h"
+
+enum TIMEDCALL {
+    // through the provider
+    tcEnumProducts,
+    tcQueryProductState,
+    tcGetProductInfo,
+    tcGetUserInfo,
+    tcEnumFeatures,
+    tcQueryFeatureState,
+    tcGetFeatureUsage,
+    tcEnumComponents,
+    tcEnumClients,
+    tcGetComponentPath,
+    tcEnumComponentQualifiers,
+    tcEnumPatches,
+    tcProbeKeyPath,
+    // where they are made
+    tcSetInternalUI,
+    tcGetFileVersion,
+    tcGetFileAttributesEx,
+    tcGetFileSecurity,
+    tcReadImage,
+    tcRegOpenKeyEx,
+    tcRegGetKeySecurity,
+    tcRegQueryInfoKey,
+    tcLookupAccountSid,
+    tcOpenEventLog,
+    tcReadEventLog,
+    tcFindFirstFile,
+    tcFindNextFile,
+    tcCreateEnvironmentBlock,
+    tcReadFile,
+    cTimedCalls
+};
+
+extern const TCHAR* const TimedCallNames[cTimedCalls];     // "MsiEnumProducts", ... "ReadFile"
+
+enum CALLPHASE {
+    cpSetup,
+    cpEvents,
+    cpProducts,
+    cpComponents,
+    cpLogs,
+    cCallPhases
+};
+
+extern const TCHAR* const CallPhaseNames[cCallPhases];     // "setup", ... "logs"
+
+const DWORD CLatencyBuckets = 24;       // under 1us, under 2us, ... under 4s, and longer
+
+struct CALLSTATS {
+    DWORD               cCalls;
+    unsigned __int64    usTotal;
+    DWORD               rgcBucket[CLatencyBuckets];
+};
+
+// -t: the tables emptied, the phase set to setup, and every CCallTimer timing.
+void  StartCallTiming();
+void  StopCallTiming();
+void  SetCallPhase(CALLPHASE cp);
+
+// one call in one phase, or in every phase with cp cCallPhases.
+void  GetCallStats(CALLPHASE cp, TIMEDCALL tc, CALLSTATS* pStats);
+// every call of every kind, since the last StartCallTiming.
+DWORD TotalCallCount();
+// "1us", "2us", ... "512ms", "1s", "2s", "4s", ">4s": the upper bound of
+// bucket iBucket, in powers of two, so "1ms" is 1024us.
+const TCHAR* LatencyBucketName(DWORD iBucket);
+
+// internal to CCallTimer.
+extern bool g_fTimeCalls;
+__int64 CallClock();
+void  RecordCall(TIMEDCALL tc, __int64 lgTicks);
+
+// times the call made between its construction and Stop(), or its end.
+class CCallTimer
+{
+public:
+    CCallTimer(TIMEDCALL tc) : m_tc(tc), m_fTiming(g_fTimeCalls)
+                      { if (m_fTiming) m_lgStart = CallClock(); }
+    ~CCallTimer()     { Stop(); }
+
+    void  Stop()      { if (m_fTiming) { RecordCall(m_tc, CallClock() - m_lgStart); m_fTiming = false; } }
+
+private:
+    TIMEDCALL   m_tc;
+    bool        m_fTiming;
+    __int64     m_lgStart;
+};
+
+class CCountingInstallerData : public CForwardingInstallerData
+{
+public:
+    CCountingInstallerData(CInstallerData* pSource) : CForwardingInstallerData(pSource) {}
+    ~CCountingInstallerData();      // deletes pSource
+
+    UINT          EnumProducts(DWORD iProductIndex, TCHAR* lpProductBuf);
+    INSTALLSTATE  QueryProductState(const TCHAR* szProduct);
+    UINT          GetProductInfo(const TCHAR* szProduct, const TCHAR* szAttribute, TCHAR* lpValueBuf, DWORD* pcchValueBuf);
+    USERINFOSTATE GetUserInfo(const TCHAR* szProduct, TCHAR* lpUserNameBuf, DWORD* pcchUserNameBuf,
+                              TCHAR* lpOrgNameBuf, DWORD* pcchOrgNameBuf, TCHAR* lpSerialBuf, DWORD* pcchSerialBuf);
+
+    UINT          EnumFeatures(const TCHAR* szProduct, DWORD iFeatureIndex, TCHAR* lpFeatureBuf, TCHAR* lpParentBuf);
+    INSTALLSTATE  QueryFeatureState(const TCHAR* szProduct, const TCHAR* szFeature);
+    UINT          GetFeatureUsage(const TCHAR* szProduct, const TCHAR* szFeature, DWORD* pdwUseCount, WORD* pwDateUsed);
+
+    UINT          EnumComponents(DWORD iComponentIndex, TCHAR* lpComponentBuf);
+    UINT          EnumClients(const TCHAR* szComponent, DWORD iProductIndex, TCHAR* lpProductBuf);
+    INSTALLSTATE  GetComponentPath(const TCHAR* szProduct, const TCHAR* szComponent, TCHAR* lpPathBuf, DWORD* pcchBuf);
+    UINT          EnumComponentQualifiers(const TCHAR* szComponent, DWORD iIndex, TCHAR* lpQualifierBuf, DWORD* pcchQualifierBuf,
+                                          TCHAR* lpApplicationDataBuf, DWORD* pcchApplicationDataBuf);
+
+    UINT          EnumPatches(const TCHAR* szProduct, DWORD iPatchIndex, TCHAR* lpPatchBuf, TCHAR* lpTransformsBuf, DWORD* pcchTransformsBuf);
+
+    void          ProbeKeyPath(const TCHAR* szKeyPath, KEYPATHPROBE* pProbe);
+};
+
+#endif // CALLCOUNT_H
@@ -0,0 +1,151 @@
+/*---------------------------------------------------------------------------
+Component index - see compindex.h.
+---------------------------------------------------------------------------*/
+
+#include "compindex.h"
+#include <stdlib.h>
+
+static int __cdecl CompareProductClients(const void* pv1, const void* pv2)
+{
+    const COMPONENTCLIENT* pClient1 = (const COMPONENTCLIENT*) pv1;
+    const COMPONENTCLIENT* pClient2 = (const COMPONENTCLIENT*) pv2;
+
+    int iCompare = CompareGuidKeys(pClient1->ClientKey, pClient2->ClientKey);
+    if (iCompare)
+        return iCompare;
+    if (pClient1->iComponent != pClient2->iComponent)
+        return (pClient1->iComponent < pClient2->iComponent) ? -1 : 1;
+    return 0;
+}
+
+// doubles *pcItems until it holds cNeeded; returns false when out of memory.
+static bool GrowArray(void** ppv, DWORD* pcItems, DWORD cNeeded, size_t cbItem)
+{
+    if (cNeeded <= *pcItems)
+        return true;
+
+    DWORD cItems = (*pcItems) ? *pcItems : 256;
+    while (cItems < cNeeded)
+        cItems *= 2;
+
+    void* pv = realloc(*ppv, cItems * cbItem);
+    if (!pv)
+        return false;
+
+    *ppv = pv;
+    *pcItems = cItems;
+    return true;
+}
+
+UINT BuildComponentIndex(CInstallerData* pInstallerData, COMPONENTINDEX* pIndex)
+{
+    memset(pIndex, 0, sizeof(COMPONENTINDEX));
+
+    DWORD cComponentsAllocated = 0;
+    DWORD cFirstClientAllocated = 0;
+    DWORD cPermanentAllocated = 0;
+    DWORD cClientsAllocated = 0;
+    TCHAR szComponentId[CCHGuid] = TEXT("");
+    TCHAR szClient[CCHGuid] = TEXT("");
+
+    while (ERROR_SUCCESS == pInstallerData->EnumComponents(pIndex->cComponents, szComponentId))
+    {
+        DWORD iComponent = pIndex->cComponents;
+        if (!GrowArray((void**) &pIndex->rgszComponent, &cComponentsAllocated, iComponent + 1, sizeof(pIndex->rgszComponent[0])) ||
+            !GrowArray((void**) &pIndex->rgiFirstClient, &cFirstClientAllocated, iComponent + 2, sizeof(DWORD)) ||
+            !GrowArray((void**) &pIndex->rgcPermanentClients, &cPermanentAllocated, iComponent + 1, sizeof(DWORD)))
+        {
+            FreeComponentIndex(pIndex);
+            return ERROR_NOT_ENOUGH_MEMORY;
+        }
+
+        lstrcpy(pIndex->rgszComponent[iComponent], szComponentId);
+        pIndex->rgiFirstClient[iComponent] = pIndex->cClients;
+        pIndex->rgcPermanentClients[iComponent] = 0;
+
+        DWORD iClient = 0;
+        while (ERROR_SUCCESS == pInstallerData->EnumClients(szComponentId, iClient++, szClient))
+        {
+            if (!GrowArray((void**) &pIndex->rgClients, &cClientsAllocated, pIndex->cClients + 1, sizeof(COMPONENTCLIENT)))
+            {
+                FreeComponentIndex(pIndex);
+                return ERROR_NOT_ENOUGH_MEMORY;
+            }
+
+            COMPONENTCLIENT* pClient = &pIndex->rgClients[pIndex->cClients++];
+            lstrcpy(pClient->szClient, szClient);
+            MakeGuidKey(szClient, &pClient->ClientKey);
+            pClient->iComponent = iComponent;
+
+            if (IsEqualGuidKey(pClient->ClientKey, KEYPermanentProduct))
+                pIndex->rgcPermanentClients[iComponent]++;
+        }
+
+        pIndex->cComponents++;
+    }
+
+    if (!GrowArray((void**) &pIndex->rgiFirstClient, &cFirstClientAllocated, pIndex->cComponents + 1, sizeof(DWORD)))
+    {
+        FreeComponentIndex(pIndex);
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+    pIndex->rgiFirstClient[pIndex->cComponents] = pIndex->cClients;
+
+    // product -> components: the same registrations sorted by client.  qsort is not stable,
+    // so the component ordinal is part of the key to keep components in enumeration order.
+    if (pIndex->cClients)
+    {
+        pIndex->rgProductClients = (COMPONENTCLIENT*) malloc(pIndex->cClients * sizeof(COMPONENTCLIENT));
+        if (!pIndex->rgProductClients)
+        {
+            FreeComponentIndex(pIndex);
+            return ERROR_NOT_ENOUGH_MEMORY;
+        }
+
+        for (DWORD iClient = 0; iClient < pIndex->cClients; iClient++)
+        {
+            CanonicalGuid(pIndex->rgProductClients[iClient].szClient, pIndex->rgClients[iClient].szClient);
+            pIndex->rgProductClients[iClient].ClientKey = pIndex->rgClients[iClient].ClientKey;
+            pIndex->rgProductClients[iClient].iComponent = pIndex->rgClients[iClient].iComponent;
+        }
+
+        qsort(pIndex->rgProductClients, pIndex->cClients, sizeof(COMPONENTCLIENT), CompareProductClients);
+    }
+
+    return ERROR_SUCCESS;
+}
+
+void FreeComponentIndex(COMPONENTINDEX* pIndex)
+{
+    free(pIndex->rgszComponent);
+    free(pIndex->rgiFirstClient);
+    free(pIndex->rgcPermanentClients);
+    free(pIndex->rgClients);
+    free(pIndex->rgProductClients);
+    memset(pIndex, 0, sizeof(COMPONENTINDEX));
+}
+
+DWORD FindProductComponents(const COMPONENTINDEX* pIndex, const TCHAR* szProduct, const COMPONENTCLIENT** ppFirst)
+{
+    GUIDKEY Key;
+    MakeGuidKey(szProduct, &Key);
+
+    // lower bound of szKey
+    DWORD iLow = 0;
+    DWORD iHigh = pIndex->cClients;
+    while (iLow < iHigh)
+    {
+        DWORD iMid = iLow + (iHigh - iLow) / 2;
+        if (CompareGuidKeys(pIndex->rgProductClients[iMid].ClientKey, Key) < 0)
+            iLow = iMid + 1;
+        else
+            iHigh = iMid;
+    }
+
+    DWORD iEnd = iLow;
+    while (iEnd < pIndex->cClients && IsEqualGuidKey(pIndex->rgProductClients[iEnd].ClientKey, Key))
+        iEnd++;
+
+    *ppFirst = (iEnd > iLow) ? &pIndex->rgProductClients[iLow] : NULL;
+    return iEnd - iLow;
+}
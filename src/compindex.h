@@ -0,0 +1,53 @@
+/*---------------------------------------------------------------------------
+Component index.
+
+    The installer can only tell you which products use a component by
+    enumerating that component's clients, so answering "what are this
+    product's components" used to mean walking every component and every
+    client once per product.  The index does that walk a single time and
+    keeps both directions:
+
+        component -> clients     in MsiEnumComponents / MsiEnumClients order
+        product   -> components  in MsiEnumComponents order
+
+    Client codes are matched on their GUIDKEYs (guidkey.h), made once as
+    the index is built - case-insensitively, as before.
+---------------------------------------------------------------------------*/
+
+#ifndef COMPINDEX_H
+#define COMPINDEX_H
+
+#include "installerdata.h"
+#include "guidkey.h"
+
+struct COMPONENTCLIENT {
+    TCHAR   szClient[CCHGuid];
+    GUIDKEY ClientKey;
+    DWORD   iComponent;
+};
+
+struct COMPONENTINDEX {
+    DWORD            cComponents;
+    TCHAR          (*rgszComponent)[CCHGuid];   // [cComponents]
+    DWORD*           rgiFirstClient;            // [cComponents + 1] into rgClients
+    DWORD*           rgcPermanentClients;       // [cComponents] clients that are SZPermanentProduct
+
+    DWORD            cClients;
+    COMPONENTCLIENT* rgClients;                 // grouped by component, client code as enumerated
+    COMPONENTCLIENT* rgProductClients;          // same registrations, upper-cased, sorted by client key then component
+};
+
+UINT  BuildComponentIndex(CInstallerData* pInstallerData, COMPONENTINDEX* pIndex);
+void  FreeComponentIndex(COMPONENTINDEX* pIndex);
+
+// returns the number of registrations of szProduct; *ppFirst points at the first.
+// Registrations are in component order; a product that is listed twice as a
+// client of the same component shows up twice.
+DWORD FindProductComponents(const COMPONENTINDEX* pIndex, const TCHAR* szProduct, const COMPONENTCLIENT** ppFirst);
+
+inline DWORD ComponentClientCount(const COMPONENTINDEX* pIndex, DWORD iComponent)
+{
+    return pIndex->rgiFirstClient[iComponent + 1] - pIndex->rgiFirstClient[iComponent];
+}
+
+#endif // COMPINDEX_H
@@ -0,0 +1,464 @@
+/*---------------------------------------------------------------------------
+Directory listings for file keypaths - see dircache.h.
+---------------------------------------------------------------------------*/
+
+#include "dircache.h"
+#include "callcount.h"
+#include "probecache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const int CCHDirectoryPath = MAX_PATH + 1024;
+const DWORD CCHDirectoryName = 255;     // the file system's own limit on one name
+
+#ifdef _WIN32
+const bool FDirectoryMatchCase = false;
+#else
+const bool FDirectoryMatchCase = true;
+#endif
+
+enum DIRSTATE {
+    dsUnlisted,
+    dsListing,          // a thread is listing it
+    dsListed,
+    dsMissing,          // listing it found no such directory
+    dsUnlistable,       // access denied, too big, out of memory; its keypaths are probed the old way
+};
+
+struct DIRLISTING {
+    DIRSTATE    ds;
+    DWORD       cAsked;         // keypaths in it probed so far
+    int         fdDirectory;    // off Windows, kept open to stat its entries from; -1 when it is not
+};
+
+// one entry of a listing before it is added; names are in the lister's arena.
+struct DIRLISTINGENTRY {
+    const TCHAR*    szName;
+    DIRENTRYINFO    Info;
+};
+
+void CopyDirectoryEntry(const DIRENTRYINFO& Entry, KEYPATHPROBE* pProbe)
+{
+    pProbe->dwAttributes = Entry.dwAttributes;
+    pProbe->fExtendedAttributes = true;
+    pProbe->nFileSizeHigh = Entry.nFileSizeHigh;
+    pProbe->nFileSizeLow = Entry.nFileSizeLow;
+    pProbe->ftCreationTime = Entry.ftCreationTime;
+    pProbe->ftLastWriteTime = Entry.ftLastWriteTime;
+}
+
+#ifndef _WIN32
+void DirectoryEntryFromStat(const struct stat& st, DIRENTRYINFO* pEntry)
+{
+    if (S_ISDIR(st.st_mode))
+        pEntry->dwAttributes = FILE_ATTRIBUTE_DIRECTORY;
+    else
+        pEntry->dwAttributes = FILE_ATTRIBUTE_ARCHIVE;
+    if (!(st.st_mode & S_IWUSR))
+        pEntry->dwAttributes |= FILE_ATTRIBUTE_READONLY;
+
+    pEntry->nFileSizeHigh = (DWORD) ((unsigned long long) st.st_size >> 32);
+    pEntry->nFileSizeLow = (DWORD) st.st_size;
+    // no creation time here; the inode change time is the nearest thing.
+    Int64ToFileTime((__int64) st.st_ctime * 10000000 + FILETIMEUnixEpoch, &pEntry->ftCreationTime);
+    Int64ToFileTime((__int64) st.st_mtime * 10000000 + FILETIMEUnixEpoch, &pEntry->ftLastWriteTime);
+    pEntry->dwOwnerId = (DWORD) st.st_uid;
+    pEntry->fRead = true;
+}
+#endif
+
+// a name the listing answers exactly as a call on the file would.  The
+// Win32 path rules trim trailing dots and spaces, and a colon names a stream.
+static bool IsListableName(const TCHAR* szName)
+{
+    DWORD cchName = lstrlen(szName);
+    if (!cchName || (cchName > CCHDirectoryName) || (0 == lstrcmp(szName, TEXT("."))) || (0 == lstrcmp(szName, TEXT(".."))))
+        return false;
+#ifdef _WIN32
+    if (strpbrk(szName, TEXT(":*?\"<>|")) || ('.' == szName[cchName - 1]) || (' ' == szName[cchName - 1]))
+        return false;
+#endif
+    return true;
+}
+
+// szName and its entry on the end of *prgEntry; false past CDirectoryEntries or out of memory.
+static bool AddListingEntry(CStringArena* pArena, const TCHAR* szName, const DIRENTRYINFO& Info,
+                            DIRLISTINGENTRY** prgEntry, DWORD* pcEntries, DWORD* pcAllocated)
+{
+    if (*pcEntries == CDirectoryEntries)
+        return false;
+    if (*pcEntries == *pcAllocated)
+    {
+        DWORD cAllocated = (*pcAllocated) ? 2 * *pcAllocated : 64;
+        DIRLISTINGENTRY* rgEntry = (DIRLISTINGENTRY*) realloc(*prgEntry, cAllocated * sizeof(DIRLISTINGENTRY));
+        if (!rgEntry)
+            return false;
+        *prgEntry = rgEntry;
+        *pcAllocated = cAllocated;
+    }
+    DIRLISTINGENTRY* pEntry = &(*prgEntry)[*pcEntries];
+    pEntry->szName = pArena->Copy(szName, lstrlen(szName));
+    pEntry->Info = Info;
+    (*pcEntries)++;
+    return true;
+}
+
+// every entry of szDirectory, which ends in its separator.  ERROR_PATH_NOT_FOUND:
+// there is no such directory.  Any other failure leaves it to be probed file by
+// file.  Off Windows *pfdDirectory is the directory, open, when it listed.
+static UINT ListDirectory(const TCHAR* szDirectory, CStringArena* pArena, DIRLISTINGENTRY** prgEntry, DWORD* pcEntries, int* pfdDirectory)
+{
+    *prgEntry = NULL;
+    *pcEntries = 0;
+    *pfdDirectory = -1;
+    DWORD cAllocated = 0;
+    DIRENTRYINFO Info;
+    memset(&Info, 0, sizeof(Info));
+
+#ifdef _WIN32
+    TCHAR szSearch[CCHDirectoryPath + 2];
+    if (lstrlen(szDirectory) + 2 > CCHDirectoryPath)
+        return ERROR_FILENAME_EXCED_RANGE;
+    lstrcpy(szSearch, szDirectory);
+    lstrcat(szSearch, TEXT("*"));
+
+    WIN32_FIND_DATA fd;
+    CCallTimer FirstTimer(tcFindFirstFile);
+    HANDLE hfff = FindFirstFile(szSearch, &fd);
+    FirstTimer.Stop();
+    if (INVALID_HANDLE_VALUE == hfff)
+        return GetLastError();
+
+    UINT uiResult = ERROR_SUCCESS;
+    for (;;)
+    {
+        if ((0 != lstrcmp(fd.cFileName, TEXT("."))) && (0 != lstrcmp(fd.cFileName, TEXT(".."))))
+        {
+            Info.dwAttributes = fd.dwFileAttributes;
+            Info.nFileSizeHigh = fd.nFileSizeHigh;
+            Info.nFileSizeLow = fd.nFileSizeLow;
+            Info.ftCreationTime = fd.ftCreationTime;
+            Info.ftLastWriteTime = fd.ftLastWriteTime;
+            Info.fRead = true;
+            // a keypath can name a file by its short name too.
+            if (!AddListingEntry(pArena, fd.cFileName, Info, prgEntry, pcEntries, &cAllocated) ||
+                (fd.cAlternateFileName[0] && (0 != lstrcmpi(fd.cAlternateFileName, fd.cFileName)) &&
+                 !AddListingEntry(pArena, fd.cAlternateFileName, Info, prgEntry, pcEntries, &cAllocated)))
+            {
+                uiResult = ERROR_MORE_DATA;
+                break;
+            }
+        }
+
+        CCallTimer NextTimer(tcFindNextFile);
+        BOOL fNext = FindNextFile(hfff, &fd);
+        NextTimer.Stop();
+        if (!fNext)
+        {
+            if (ERROR_NO_MORE_FILES != GetLastError())
+                uiResult = GetLastError();
+            break;
+        }
+    }
+    FindClose(hfff);
+    return uiResult;
+#else
+    CCallTimer FirstTimer(tcFindFirstFile);
+    DIR* pDir = opendir(szDirectory);
+    FirstTimer.Stop();
+    if (!pDir)
+    {
+        if ((ENOENT == errno) || (ENOTDIR == errno))
+            return ERROR_PATH_NOT_FOUND;
+        return (EACCES == errno) ? ERROR_ACCESS_DENIED : ERROR_OPEN_FAILED;
+    }
+
+    // a directory that lists but cannot be searched would answer "missing"
+    // where stat says "access denied".
+    UINT uiResult = ERROR_SUCCESS;
+    if (0 != faccessat(dirfd(pDir), TEXT("."), X_OK, AT_EACCESS))
+        uiResult = ERROR_ACCESS_DENIED;
+    while (ERROR_SUCCESS == uiResult)
+    {
+        CCallTimer NextTimer(tcFindNextFile);
+        struct dirent* pEntry = readdir(pDir);
+        NextTimer.Stop();
+        if (!pEntry)
+            break;
+        if ((0 == lstrcmp(pEntry->d_name, TEXT("."))) || (0 == lstrcmp(pEntry->d_name, TEXT(".."))))
+            continue;
+
+        // the name alone; FindFile stats the entries keypaths ask for.
+        if (!AddListingEntry(pArena, pEntry->d_name, Info, prgEntry, pcEntries, &cAllocated))
+            uiResult = ERROR_MORE_DATA;
+    }
+    if (ERROR_SUCCESS == uiResult)
+        *pfdDirectory = dup(dirfd(pDir));
+    closedir(pDir);
+    return uiResult;
+#endif
+}
+
+// "%x\" without sprintf, which costs more than the lookup it keys.
+static int FormatDirectoryIndex(DWORD iDirectory, TCHAR* szEdge)
+{
+    static const TCHAR rgchHex[] = TEXT("0123456789abcdef");
+    int cch = 0;
+    for (int iShift = 28; iShift >= 0; iShift -= 4)
+    {
+        if (cch || (iDirectory >> iShift) || !iShift)
+            szEdge[cch++] = rgchHex[(iDirectory >> iShift) & 0xF];
+    }
+    szEdge[cch++] = '\\';
+    return cch;
+}
+
+CDirectoryCache::CDirectoryCache()
+    : m_fMaps(false), m_rgDirectory(NULL), m_cDirectories(0), m_cDirectoriesAllocated(0),
+      m_rgEntry(NULL), m_cEntries(0), m_cEntriesAllocated(0), m_cListings(0), m_cAnswered(0), m_cOpenDirectories(0)
+{
+    InitializeCriticalSection(&m_cs);
+
+    // directory 0 is none.
+    m_cDirectoriesAllocated = 256;
+    m_rgDirectory = (DIRLISTING*) malloc(m_cDirectoriesAllocated * sizeof(DIRLISTING));
+    if (m_rgDirectory && InitStringMap(&m_Directories, 256, FDirectoryMatchCase))
+    {
+        if (InitStringMap(&m_Entries, 4096, FDirectoryMatchCase))
+        {
+            m_fMaps = true;
+            m_cDirectories = 1;
+        }
+        else
+        {
+            FreeStringMap(&m_Directories);
+        }
+    }
+}
+
+CDirectoryCache::~CDirectoryCache()
+{
+    if (m_fMaps)
+    {
+        FreeStringMap(&m_Directories);
+        FreeStringMap(&m_Entries);
+    }
+#ifndef _WIN32
+    for (DWORD iDirectory = 1; iDirectory < m_cDirectories; iDirectory++)
+    {
+        if (m_rgDirectory[iDirectory].fdDirectory >= 0)
+            close(m_rgDirectory[iDirectory].fdDirectory);
+    }
+#endif
+    free(m_rgDirectory);
+    free(m_rgEntry);
+    DeleteCriticalSection(&m_cs);
+}
+
+// the directory's index, added if it is new; 0 when out of memory.  Under the lock.
+DWORD CDirectoryCache::FindDirectory(const TCHAR* szDirectory)
+{
+    DWORD iDirectory = 0;
+    if (FindStringMapValue(&m_Directories, szDirectory, &iDirectory))
+        return iDirectory;
+
+    if (m_cDirectories == m_cDirectoriesAllocated)
+    {
+        DIRLISTING* rgDirectory = (DIRLISTING*) realloc(m_rgDirectory, 2 * m_cDirectoriesAllocated * sizeof(DIRLISTING));
+        if (!rgDirectory)
+            return 0;
+        m_rgDirectory = rgDirectory;
+        m_cDirectoriesAllocated *= 2;
+    }
+    TCHAR* szKey = m_Arena.Alloc(lstrlen(szDirectory) + 1);
+    if (!szKey)
+        return 0;
+    lstrcpy(szKey, szDirectory);
+    if (!SetStringMapValue(&m_Directories, szKey, m_cDirectories))
+        return 0;
+
+    m_rgDirectory[m_cDirectories].ds = dsUnlisted;
+    m_rgDirectory[m_cDirectories].cAsked = 0;
+    m_rgDirectory[m_cDirectories].fdDirectory = -1;
+    return m_cDirectories++;
+}
+
+// what ListDirectory found, into the maps.  Under the lock.
+void CDirectoryCache::AddListing(DWORD iDirectory, UINT uiResult, DIRLISTINGENTRY* rgEntry, DWORD cEntries, int fdDirectory)
+{
+    DIRSTATE ds = dsListed;
+    if (ERROR_PATH_NOT_FOUND == uiResult)
+        ds = dsMissing;
+    else if ((ERROR_SUCCESS != uiResult) || (m_cEntries + cEntries > CDirectoryCacheEntries))
+        ds = dsUnlistable;
+
+    if ((dsListed == ds) && (m_cEntries + cEntries > m_cEntriesAllocated))
+    {
+        DWORD cAllocated = (m_cEntriesAllocated) ? m_cEntriesAllocated : 1024;
+        while (cAllocated < m_cEntries + cEntries)
+            cAllocated *= 2;
+        DIRENTRYINFO* rgInfo = (DIRENTRYINFO*) realloc(m_rgEntry, cAllocated * sizeof(DIRENTRYINFO));
+        if (rgInfo)
+        {
+            m_rgEntry = rgInfo;
+            m_cEntriesAllocated = cAllocated;
+        }
+        else
+        {
+            ds = dsUnlistable;
+        }
+    }
+
+    // the map's key is the directory's index and the name: "1c\kernel32.dll".
+    TCHAR szEdge[16 + CCHDirectoryName + 1];
+    int cchDirectory = FormatDirectoryIndex(iDirectory, szEdge);
+    for (DWORD iEntry = 0; (dsListed == ds) && (iEntry < cEntries); iEntry++)
+    {
+        DWORD cchName = lstrlen(rgEntry[iEntry].szName);
+        if (cchName > CCHDirectoryName)
+            continue;
+        TCHAR* szKey = m_Arena.Alloc(cchDirectory + cchName + 1);
+        if (!szKey)
+        {
+            ds = dsUnlistable;
+            break;
+        }
+        memcpy(szKey, szEdge, cchDirectory * sizeof(TCHAR));
+        lstrcpy(szKey + cchDirectory, rgEntry[iEntry].szName);
+        if (!SetStringMapValue(&m_Entries, szKey, m_cEntries))
+        {
+            ds = dsUnlistable;
+            break;
+        }
+        m_rgEntry[m_cEntries++] = rgEntry[iEntry].Info;
+    }
+
+    m_rgDirectory[iDirectory].ds = ds;
+    if (dsListed == ds)
+        m_cListings++;
+#ifndef _WIN32
+    if ((dsListed == ds) && (fdDirectory >= 0) && (m_cOpenDirectories < CDirectoryHandles))
+    {
+        m_rgDirectory[iDirectory].fdDirectory = fdDirectory;
+        m_cOpenDirectories++;
+    }
+    else if (fdDirectory >= 0)
+    {
+        close(fdDirectory);
+    }
+#endif
+}
+
+// szName in the directory's listing, when it has one.  szEdge is room for
+// the entry map's key.  Under the lock.
+DIRLOOKUP CDirectoryCache::LookUpEntry(DWORD iDirectory, const TCHAR* szName, TCHAR* szEdge, DIRENTRYINFO* pEntry, DWORD* piEntry, int* pfdDirectory)
+{
+    DIRLISTING* pDirectory = &m_rgDirectory[iDirectory];
+    *pfdDirectory = pDirectory->fdDirectory;
+    if (dsMissing == pDirectory->ds)
+    {
+        m_cAnswered++;
+        return dlMissing;
+    }
+    if (dsListed != pDirectory->ds)
+        return dlNotListed;
+
+    int cchDirectory = FormatDirectoryIndex(iDirectory, szEdge);
+    lstrcpy(szEdge + cchDirectory, szName);
+    if (!FindStringMapValue(&m_Entries, szEdge, piEntry))
+    {
+        m_cAnswered++;
+        return dlMissing;
+    }
+    *pEntry = m_rgEntry[*piEntry];
+    if (pEntry->fRead)
+        m_cAnswered++;
+    return dlFound;
+}
+
+DIRLOOKUP CDirectoryCache::FindFile(const TCHAR* szFile, DIRENTRYINFO* pEntry)
+{
+    if (!m_fMaps)
+        return dlNotListed;
+
+    // the directory is everything up to the last separator, which it keeps:
+    // "C:\x.dll" lists "C:\", not the current directory of C:.
+    const TCHAR* pchName = NULL;
+    for (const TCHAR* pch = szFile; *pch; pch++)
+    {
+        if (('\\' == *pch) || ('/' == *pch))
+            pchName = pch + 1;
+    }
+    if (!pchName || !IsListableName(pchName) || (pchName - szFile >= CCHDirectoryPath))
+        return dlNotListed;
+
+    TCHAR szDirectory[CCHDirectoryPath];
+    memcpy(szDirectory, szFile, (pchName - szFile) * sizeof(TCHAR));
+    szDirectory[pchName - szFile] = 0;
+    TCHAR szNormal[CCHDirectoryPath];
+    if (!NormalizeKeyPath(szDirectory, szNormal, CCHDirectoryPath))
+        return dlNotListed;
+
+    // the entry map's key: "1c\kernel32.dll".  The directory's index is known under the lock.
+    TCHAR szEdge[16 + CCHDirectoryName + 1];
+    bool fList = false;
+    DIRLOOKUP dl = dlNotListed;
+    DWORD iEntry = 0;
+    int fdDirectory = -1;
+    EnterCriticalSection(&m_cs);
+    DWORD iDirectory = FindDirectory(szNormal);
+    if (iDirectory)
+    {
+        DIRLISTING* pDirectory = &m_rgDirectory[iDirectory];
+        pDirectory->cAsked++;
+        if ((dsUnlisted == pDirectory->ds) && (pDirectory->cAsked >= 2) && (m_cEntries < CDirectoryCacheEntries))
+        {
+            pDirectory->ds = dsListing;
+            fList = true;
+        }
+        else
+        {
+            dl = LookUpEntry(iDirectory, pchName, szEdge, pEntry, &iEntry, &fdDirectory);
+        }
+    }
+    LeaveCriticalSection(&m_cs);
+    if (!iDirectory)
+        return dlNotListed;
+
+    if (fList)
+    {
+        CStringArena Names;
+        DIRLISTINGENTRY* rgEntry = NULL;
+        DWORD cEntries = 0;
+        UINT uiResult = ListDirectory(szDirectory, &Names, &rgEntry, &cEntries, &fdDirectory);
+        EnterCriticalSection(&m_cs);
+        AddListing(iDirectory, uiResult, rgEntry, cEntries, fdDirectory);
+        dl = LookUpEntry(iDirectory, pchName, szEdge, pEntry, &iEntry, &fdDirectory);
+        LeaveCriticalSection(&m_cs);
+        free(rgEntry);
+    }
+
+#ifndef _WIN32
+    // the listing has the name; the rest is read now, for the keypath that
+    // asks, from the directory when it is kept open.  A stat that fails is
+    // left to the caller's, which reports it.  The probe cache (probecache.h)
+    // keeps what this finds; the listing need not.
+    if ((dlFound == dl) && !pEntry->fRead)
+    {
+        struct stat st;
+        if (0 != ((fdDirectory >= 0) ? fstatat(fdDirectory, pchName, &st, 0) : stat(szFile, &st)))
+            return dlNotListed;
+        DirectoryEntryFromStat(st, pEntry);
+    }
+#endif
+    return dl;
+}
@@ -0,0 +1,122 @@
+/*---------------------------------------------------------------------------
+Directory listings for file keypaths.
+
+    File keypaths cluster: hundreds of components keep their keypath in
+    System32, in Common Files, in a product's own directory.  Probing
+    each asks the file system about it on its own - a GetFileAttributesEx
+    that walks the whole path again to find one entry of a directory
+    already walked a hundred times.  CDirectoryCache lists a keypath's
+    directory once, FindFirstFile/FindNextFile on Windows and readdir
+    elsewhere, and answers the existence, attributes, size and times of
+    every other keypath in it from the listing:
+
+        C:\Windows\System32\a.dll   GetFileAttributesEx, as always
+        C:\Windows\System32\b.dll   System32 listed; b.dll from the listing
+        C:\Windows\System32\c.dll   from the listing
+        C:\Windows\System32\gone.dll
+                                    not in the listing - missing, without a call
+
+    A directory is listed when the second keypath in it is probed, so a
+    directory with one keypath costs what it always did.  The version and
+    the owner are still read from each file (keypath.h); a listing has
+    neither.  A keypath a listing cannot answer the way its own call
+    would - a directory, a stream, a name the file system would trim -
+    is probed the old way, and so is every keypath in a directory that
+    cannot be listed (access denied, or more than CDirectoryEntries
+    entries).  A directory found missing answers for every keypath in it.
+
+    A listing is kept for the run, as the probe cache (probecache.h)
+    keeps its answers.  NTFS updates a directory entry's size and times
+    lazily, so a file held open and written while msiinv runs can list
+    with the size it had when it was opened; GetFileAttributesEx reads
+    the file's own.
+
+    Off Windows the stand-in file system (standinfs.h) lists its tree
+    with readdir, and names and directories match case, as stat matches
+    them.  readdir returns names without the data FindNextFile returns
+    with them, so an entry is stat'ed when a keypath asks for it, and
+    only then - fstatat from the directory, which the first
+    CDirectoryHandles listed are kept open for, rather than a walk of
+    the whole path.  The listing saves the calls for missing files, and
+    the entries no keypath names cost nothing past their name.
+
+    Safe to call from several threads (-j, -probe).  A directory is
+    listed outside the lock; a keypath in it probed meanwhile is probed
+    the old way rather than wait.
+---------------------------------------------------------------------------*/
+
+#ifndef DIRCACHE_H
+#define DIRCACHE_H
+
+#include "keypath.h"
+#include "strarena.h"
+#include "strmap.h"
+
+const DWORD CDirectoryEntries = 16384;          // entries in one directory, past which it is not listed
+const DWORD CDirectoryCacheEntries = 1048576;   // entries kept for the run
+const DWORD CDirectoryHandles = 256;            // off Windows, directories kept open to stat entries from
+
+// what a listing says of one entry - what GetFileAttributesEx would.
+struct DIRENTRYINFO {
+    DWORD       dwAttributes;
+    DWORD       nFileSizeHigh;
+    DWORD       nFileSizeLow;
+    FILETIME    ftCreationTime;
+    FILETIME    ftLastWriteTime;
+    DWORD       dwOwnerId;      // off Windows, the owner's uid; the owner is read per file on Windows
+    bool        fRead;          // the rest is filled in; off Windows a listing has only the name
+};
+
+enum DIRLOOKUP {
+    dlNotListed,    // probe the file the old way
+    dlFound,        // the listing has it
+    dlMissing,      // neither the file nor its directory is there
+};
+
+// the entry's attributes, size and times into pProbe.
+void CopyDirectoryEntry(const DIRENTRYINFO& Entry, KEYPATHPROBE* pProbe);
+
+#ifndef _WIN32
+struct stat;
+// what stat found, as a listing has it.
+void DirectoryEntryFromStat(const struct stat& st, DIRENTRYINFO* pEntry);
+#endif
+
+struct DIRLISTING;
+struct DIRLISTINGENTRY;
+
+class CDirectoryCache
+{
+public:
+    CDirectoryCache();
+    ~CDirectoryCache();
+
+    // szFile is a file keypath, or a stand-in's path for one.
+    DIRLOOKUP     FindFile(const TCHAR* szFile, DIRENTRYINFO* pEntry);
+
+    DWORD         ListingCount() const      { return m_cListings; }
+    DWORD         ListedEntryCount() const  { return m_cEntries; }
+    DWORD         AnsweredCount() const     { return m_cAnswered; }     // without a call on the file
+
+private:
+    DWORD         FindDirectory(const TCHAR* szDirectory);
+    DIRLOOKUP     LookUpEntry(DWORD iDirectory, const TCHAR* szName, TCHAR* szEdge, DIRENTRYINFO* pEntry, DWORD* piEntry, int* pfdDirectory);
+    void          AddListing(DWORD iDirectory, UINT uiResult, DIRLISTINGENTRY* rgEntry, DWORD cEntries, int fdDirectory);
+
+    CRITICAL_SECTION    m_cs;
+    STRINGMAP           m_Directories;  // normalized directory -> m_rgDirectory index
+    STRINGMAP           m_Entries;      // "directory index\name" -> m_rgEntry index
+    bool                m_fMaps;        // false - the maps could not be had; nothing is listed
+    CStringArena        m_Arena;        // both maps' keys
+    DIRLISTING*         m_rgDirectory;
+    DWORD               m_cDirectories;
+    DWORD               m_cDirectoriesAllocated;
+    DIRENTRYINFO*       m_rgEntry;
+    DWORD               m_cEntries;
+    DWORD               m_cEntriesAllocated;
+    DWORD               m_cListings;
+    DWORD               m_cAnswered;
+    DWORD               m_cOpenDirectories;
+};
+
+#endif // DIRCACHE_H
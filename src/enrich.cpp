@@ -0,0 +1,636 @@
+/*---------------------------------------------------------------------------
+Parallel product enrichment - see enrich.h.
+---------------------------------------------------------------------------*/
+
+#include "enrich.h"
+#include "trace.h"
+#include <stdlib.h>
+#include <string.h>
+
+// records ask with buffers this large; a longer answer is left to the source.
+const int CCHRecordValue = 4096;
+
+// written to a property buffer before asking, to tell a failure that left
+// the caller's buffer alone from one that wrote to it.
+const TCHAR chUntouched = TEXT('\x7f');
+
+struct RECORDPROPERTY {
+    const TCHAR*    szProperty;
+    bool            fRecorded;
+    UINT            uiResult;
+    DWORD           ichValue;           // ERROR_SUCCESS only; a failure left the buffer untouched
+};
+
+struct RECORDFEATURE {
+    DWORD           ichFeature;
+    DWORD           ichParent;
+    INSTALLSTATE    isState;
+    UINT            uiUsageResult;
+    DWORD           dwUseCount;
+    WORD            wDateUsed;
+};
+
+struct RECORDCOMPONENT {
+    const TCHAR*    szComponent;        // in the component index
+    bool            fPathRecorded;
+    INSTALLSTATE    isPath;
+    DWORD           ichPath;
+    bool            fProbed;
+    KEYPATHPROBE    Probe;
+    DWORD           iFirstQualifier;
+    DWORD           cQualifiers;
+    UINT            uiQualifierEnd;
+};
+
+struct RECORDQUALIFIER {
+    DWORD           ichQualifier;
+    DWORD           ichApplicationData;
+};
+
+struct RECORDPATCH {
+    TCHAR           szPatch[CCHGuid];
+    DWORD           ichTransforms;
+};
+
+// grows *ppv to hold at least cNeeded items.
+static bool GrowArray(void** ppv, DWORD* pcAllocated, DWORD cNeeded, size_t cbItem)
+{
+    if (cNeeded <= *pcAllocated)
+        return true;
+
+    DWORD cAllocated = (*pcAllocated) ? *pcAllocated * 2 : 16;
+    while (cAllocated < cNeeded)
+        cAllocated *= 2;
+
+    void* pv = realloc(*ppv, cAllocated * cbItem);
+    if (!pv)
+        return false;
+    *ppv = pv;
+    *pcAllocated = cAllocated;
+    return true;
+}
+
+// copies szValue when the caller's buffer holds it; false sends the call to the source.
+static bool CopyIfFits(const TCHAR* szValue, TCHAR* lpBuf, DWORD* pcchBuf)
+{
+    if (!lpBuf || !pcchBuf)
+        return false;
+
+    DWORD cchValue = lstrlen(szValue);
+    if (cchValue >= *pcchBuf)
+        return false;
+
+    memcpy(lpBuf, szValue, (cchValue + 1) * sizeof(TCHAR));
+    *pcchBuf = cchValue;
+    return true;
+}
+
+//____________________________________________________________________________
+//
+// CProductRecord
+//____________________________________________________________________________
+
+CProductRecord::CProductRecord()
+{
+    memset(m_szProduct, 0, sizeof(m_szProduct));
+    memset(&m_ProductKey, 0, sizeof(m_ProductKey));
+    m_pSource = NULL;
+    m_pchText = NULL;
+    m_rgProperty = NULL;
+    m_rgFeature = NULL;
+    m_rgComponent = NULL;
+    m_rgQualifier = NULL;
+    m_rgPatch = NULL;
+    Free();
+}
+
+CProductRecord::~CProductRecord()
+{
+    Free();
+}
+
+void CProductRecord::Free()
+{
+    free(m_pchText);
+    free(m_rgProperty);
+    free(m_rgFeature);
+    free(m_rgComponent);
+    free(m_rgQualifier);
+    free(m_rgPatch);
+
+    m_fRecorded = false;
+    m_fOutOfMemory = false;
+    m_pchText = NULL;
+    m_cchText = m_cchTextAllocated = 0;
+    m_isState = INSTALLSTATE_UNKNOWN;
+    m_rgProperty = NULL;
+    m_cProperties = 0;
+    m_fUserInfo = false;
+    m_uisUser = USERINFOSTATE_UNKNOWN;
+    m_ichUser = m_ichOrganization = m_ichSerial = 0;
+    m_fFeatures = m_fFeatureUsage = false;
+    m_rgFeature = NULL;
+    m_cFeatures = m_cFeaturesAllocated = 0;
+    m_uiFeatureEnd = ERROR_NO_MORE_ITEMS;
+    m_rgComponent = NULL;
+    m_cComponents = 0;
+    m_rgQualifier = NULL;
+    m_cQualifiers = m_cQualifiersAllocated = 0;
+    m_iLastComponent = 0;
+    m_rgPatch = NULL;
+    m_cPatches = m_cPatchesAllocated = 0;
+    m_uiPatchEnd = ERROR_NO_MORE_ITEMS;
+    m_fPatchesRecorded = false;
+    m_iLastFeature = 0;
+}
+
+DWORD CProductRecord::AddText(const TCHAR* szText)
+{
+    DWORD cchText = lstrlen(szText) + 1;
+    if (!GrowArray((void**) &m_pchText, &m_cchTextAllocated, m_cchText + cchText, sizeof(TCHAR)))
+    {
+        m_fOutOfMemory = true;
+        return 0;
+    }
+
+    DWORD ichText = m_cchText;
+    memcpy(m_pchText + ichText, szText, cchText * sizeof(TCHAR));
+    m_cchText += cchText;
+    return ichText;
+}
+
+bool CProductRecord::IsRecorded(const TCHAR* szProduct) const
+{
+    if (!m_fRecorded || !szProduct)
+        return false;
+    GUIDKEY Key;
+    MakeGuidKey(szProduct, &Key);
+    return IsEqualGuidKey(Key, m_ProductKey);
+}
+
+void CProductRecord::Enrich(CInstallerData* pSource, const TCHAR* szProduct, const PRODUCTQUERY& Query)
+{
+    Free();
+    m_pSource = pSource;
+    lstrcpy(m_szProduct, szProduct);
+    MakeGuidKey(szProduct, &m_ProductKey);
+
+    // offset 0 is "".
+    AddText(TEXT(""));
+
+    TCHAR szValue[CCHRecordValue];
+    TCHAR szParent[CCHRecordValue];
+    TCHAR szSerial[CCHRecordValue];
+    DWORD cchValue, cchParent, cchSerial;
+
+    // the same questions in the same order the report asks them.
+    m_isState = pSource->QueryProductState(szProduct);
+
+    m_rgProperty = (RECORDPROPERTY*) calloc(Query.cProperties, sizeof(RECORDPROPERTY));
+    if (!m_rgProperty)
+        return;
+    m_cProperties = Query.cProperties;
+
+    for (DWORD iProperty = 0; iProperty < Query.cProperties; iProperty++)
+    {
+        RECORDPROPERTY* pProperty = &m_rgProperty[iProperty];
+        pProperty->szProperty = Query.rgProperty[iProperty].szProperty;
+        if (Query.rgProperty[iProperty].fInstalledOnly && (INSTALLSTATE_DEFAULT != m_isState))
+            continue;
+
+        szValue[0] = chUntouched;
+        szValue[1] = 0;
+        cchValue = CCHRecordValue;
+        pProperty->uiResult = pSource->GetProductInfo(szProduct, pProperty->szProperty, szValue, &cchValue);
+        if (ERROR_SUCCESS == pProperty->uiResult)
+        {
+            pProperty->ichValue = AddText(szValue);
+            pProperty->fRecorded = true;
+        }
+        else if (ERROR_MORE_DATA != pProperty->uiResult)
+        {
+            pProperty->fRecorded = (chUntouched == szValue[0] && 0 == szValue[1]);
+        }
+
+        // a product -p filters out is only asked its name.
+        if (0 == iProperty && Query.pFilter && (ERROR_SUCCESS == pProperty->uiResult) &&
+            !Query.pFilter->MatchesPrefix(szProduct) && !Query.pFilter->MatchesPrefix(szValue))
+        {
+            m_fRecorded = !m_fOutOfMemory;
+            return;
+        }
+    }
+
+    if (Query.fUserInfo)
+    {
+        *szValue = *szParent = *szSerial = 0;
+        cchValue = cchParent = cchSerial = CCHRecordValue;
+        m_uisUser = pSource->GetUserInfo(szProduct, szValue, &cchValue, szParent, &cchParent, szSerial, &cchSerial);
+        if (USERINFOSTATE_PRESENT == m_uisUser)
+        {
+            m_ichUser = AddText(szValue);
+            m_ichOrganization = AddText(szParent);
+            m_ichSerial = AddText(szSerial);
+            m_fUserInfo = true;
+        }
+    }
+
+    if (Query.fFeatures)
+    {
+        m_fFeatures = true;
+        m_fFeatureUsage = Query.fFeatureUsage;
+        DWORD iFeatureIndex = 0;
+        while (ERROR_SUCCESS == (m_uiFeatureEnd = pSource->EnumFeatures(szProduct, iFeatureIndex, szValue, szParent)))
+        {
+            if (!GrowArray((void**) &m_rgFeature, &m_cFeaturesAllocated, m_cFeatures + 1, sizeof(RECORDFEATURE)))
+            {
+                m_fOutOfMemory = true;
+                break;
+            }
+
+            RECORDFEATURE* pFeature = &m_rgFeature[m_cFeatures++];
+            pFeature->ichFeature = AddText(szValue);
+            pFeature->ichParent = AddText(szParent);
+            pFeature->isState = pSource->QueryFeatureState(szProduct, szValue);
+            pFeature->uiUsageResult = ERROR_UNKNOWN_FEATURE;
+            pFeature->dwUseCount = 0;
+            pFeature->wDateUsed = 0;
+            if (Query.fFeatureUsage)
+                pFeature->uiUsageResult = pSource->GetFeatureUsage(szProduct, szValue, &pFeature->dwUseCount, &pFeature->wDateUsed);
+            iFeatureIndex++;
+        }
+    }
+
+    if (Query.pComponentIndex)
+        EnrichComponents(Query);
+
+    m_fPatchesRecorded = true;
+    TCHAR szPatch[CCHGuid];
+    DWORD iPatchIndex = 0;
+    cchValue = CCHRecordValue;
+    while (ERROR_SUCCESS == (m_uiPatchEnd = pSource->EnumPatches(szProduct, iPatchIndex, szPatch, szValue, &cchValue)))
+    {
+        if (!GrowArray((void**) &m_rgPatch, &m_cPatchesAllocated, m_cPatches + 1, sizeof(RECORDPATCH)))
+        {
+            m_fOutOfMemory = true;
+            break;
+        }
+
+        RECORDPATCH* pPatch = &m_rgPatch[m_cPatches++];
+        lstrcpy(pPatch->szPatch, szPatch);
+        pPatch->ichTransforms = AddText(szValue);
+        cchValue = CCHRecordValue;
+        iPatchIndex++;
+    }
+
+    // a record that could not hold everything passes everything through.
+    m_fRecorded = !m_fOutOfMemory;
+}
+
+void CProductRecord::EnrichComponents(const PRODUCTQUERY& Query)
+{
+    const COMPONENTINDEX* pIndex = Query.pComponentIndex;
+    const COMPONENTCLIENT* pRegistrations = NULL;
+    DWORD cRegistrations = FindProductComponents(pIndex, m_szProduct, &pRegistrations);
+    if (!cRegistrations)
+        return;
+
+    m_rgComponent = (RECORDCOMPONENT*) calloc(cRegistrations, sizeof(RECORDCOMPONENT));
+    if (!m_rgComponent)
+    {
+        m_fOutOfMemory = true;
+        return;
+    }
+
+    TCHAR szPath[CCHRecordValue];
+    TCHAR szQualifier[CCHRecordValue];
+    TCHAR szApplicationData[CCHRecordValue];
+    DWORD cchPath, cchQualifier, cchApplicationData;
+
+    // a component the product is registered to twice is reported once.
+    for (DWORD iRegistration = 0; iRegistration < cRegistrations; )
+    {
+        DWORD iComponent = pRegistrations[iRegistration].iComponent;
+        while ((iRegistration < cRegistrations) && (pRegistrations[iRegistration].iComponent == iComponent))
+            iRegistration++;
+
+        RECORDCOMPONENT* pComponent = &m_rgComponent[m_cComponents++];
+        pComponent->szComponent = pIndex->rgszComponent[iComponent];
+
+        *szPath = 0;
+        cchPath = CCHRecordValue;
+        pComponent->isPath = m_pSource->GetComponentPath(m_szProduct, pComponent->szComponent, szPath, &cchPath);
+        pComponent->fPathRecorded = (INSTALLSTATE_MOREDATA != pComponent->isPath);
+        pComponent->ichPath = AddText(szPath);
+
+        if (pComponent->fPathRecorded && (INSTALLSTATE_ABSENT != pComponent->isPath) && *szPath)
+        {
+            m_pSource->ProbeKeyPath(szPath, &pComponent->Probe);
+            pComponent->fProbed = true;
+        }
+
+        pComponent->iFirstQualifier = m_cQualifiers;
+        DWORD iQualifierIndex = 0;
+        for (;;)
+        {
+            cchQualifier = cchApplicationData = CCHRecordValue;
+            pComponent->uiQualifierEnd = m_pSource->EnumComponentQualifiers(pComponent->szComponent, iQualifierIndex, szQualifier, &cchQualifier,
+                                                                            szApplicationData, &cchApplicationData);
+            if (ERROR_SUCCESS != pComponent->uiQualifierEnd)
+                break;
+
+            if (!GrowArray((void**) &m_rgQualifier, &m_cQualifiersAllocated, m_cQualifiers + 1, sizeof(RECORDQUALIFIER)))
+            {
+                m_fOutOfMemory = true;
+                return;
+            }
+            m_rgQualifier[m_cQualifiers].ichQualifier = AddText(szQualifier);
+            m_rgQualifier[m_cQualifiers].ichApplicationData = AddText(szApplicationData);
+            m_cQualifiers++;
+            iQualifierIndex++;
+        }
+        pComponent->cQualifiers = m_cQualifiers - pComponent->iFirstQualifier;
+    }
+}
+
+const RECORDFEATURE* CProductRecord::FindFeature(const TCHAR* szFeature)
+{
+    // the report asks about the feature it just enumerated.  Names are case-sensitive.
+    if ((m_iLastFeature < m_cFeatures) && (0 == strcmp(Text(m_rgFeature[m_iLastFeature].ichFeature), szFeature)))
+        return &m_rgFeature[m_iLastFeature];
+
+    for (DWORD iFeature = 0; iFeature < m_cFeatures; iFeature++)
+    {
+        if (0 == strcmp(Text(m_rgFeature[iFeature].ichFeature), szFeature))
+            return &m_rgFeature[iFeature];
+    }
+    return NULL;
+}
+
+const RECORDCOMPONENT* CProductRecord::FindComponent(const TCHAR* szComponent)
+{
+    if (!szComponent)
+        return NULL;
+
+    // components are asked about in the order they were recorded.
+    for (DWORD iProbe = 0; iProbe < m_cComponents; iProbe++)
+    {
+        DWORD iComponent = (m_iLastComponent + iProbe) % m_cComponents;
+        if (0 == _stricmp(m_rgComponent[iComponent].szComponent, szComponent))
+        {
+            m_iLastComponent = iComponent;
+            return &m_rgComponent[iComponent];
+        }
+    }
+    return NULL;
+}
+
+UINT CProductRecord::EnumProducts(DWORD iProductIndex, TCHAR* lpProductBuf)
+{
+    return m_pSource->EnumProducts(iProductIndex, lpProductBuf);
+}
+
+INSTALLSTATE CProductRecord::QueryProductState(const TCHAR* szProduct)
+{
+    if (!IsRecorded(szProduct))
+        return m_pSource->QueryProductState(szProduct);
+    return m_isState;
+}
+
+UINT CProductRecord::GetProductInfo(const TCHAR* szProduct, const TCHAR* szAttribute, TCHAR* lpValueBuf, DWORD* pcchValueBuf)
+{
+    if (IsRecorded(szProduct) && szAttribute)
+    {
+        for (DWORD iProperty = 0; iProperty < m_cProperties; iProperty++)
+        {
+            const RECORDPROPERTY* pProperty = &m_rgProperty[iProperty];
+            if (!pProperty->fRecorded || 0 != lstrcmpi(pProperty->szProperty, szAttribute))
+                continue;
+
+            if (ERROR_SUCCESS != pProperty->uiResult)
+                return pProperty->uiResult;
+            if (CopyIfFits(Text(pProperty->ichValue), lpValueBuf, pcchValueBuf))
+                return ERROR_SUCCESS;
+            break;
+        }
+    }
+    return m_pSource->GetProductInfo(szProduct, szAttribute, lpValueBuf, pcchValueBuf);
+}
+
+USERINFOSTATE CProductRecord::GetUserInfo(const TCHAR* szProduct, TCHAR* lpUserNameBuf, DWORD* pcchUserNameBuf,
+                                          TCHAR* lpOrgNameBuf, DWORD* pcchOrgNameBuf, TCHAR* lpSerialBuf, DWORD* pcchSerialBuf)
+{
+    if (IsRecorded(szProduct) && m_fUserInfo && pcchUserNameBuf && pcchOrgNameBuf && pcchSerialBuf &&
+        (DWORD) lstrlen(Text(m_ichUser)) < *pcchUserNameBuf &&
+        (DWORD) lstrlen(Text(m_ichOrganization)) < *pcchOrgNameBuf &&
+        (DWORD) lstrlen(Text(m_ichSerial)) < *pcchSerialBuf &&
+        CopyIfFits(Text(m_ichUser), lpUserNameBuf, pcchUserNameBuf) &&
+        CopyIfFits(Text(m_ichOrganization), lpOrgNameBuf, pcchOrgNameBuf) &&
+        CopyIfFits(Text(m_ichSerial), lpSerialBuf, pcchSerialBuf))
+    {
+        return m_uisUser;
+    }
+    return m_pSource->GetUserInfo(szProduct, lpUserNameBuf, pcchUserNameBuf, lpOrgNameBuf, pcchOrgNameBuf, lpSerialBuf, pcchSerialBuf);
+}
+
+UINT CProductRecord::EnumFeatures(const TCHAR* szProduct, DWORD iFeatureIndex, TCHAR* lpFeatureBuf, TCHAR* lpParentBuf)
+{
+    if (IsRecorded(szProduct) && m_fFeatures)
+    {
+        if (iFeatureIndex < m_cFeatures)
+        {
+            lstrcpy(lpFeatureBuf, Text(m_rgFeature[iFeatureIndex].ichFeature));
+            lstrcpy(lpParentBuf, Text(m_rgFeature[iFeatureIndex].ichParent));
+            m_iLastFeature = iFeatureIndex;
+            return ERROR_SUCCESS;
+        }
+        if (iFeatureIndex == m_cFeatures)
+            return m_uiFeatureEnd;
+    }
+    return m_pSource->EnumFeatures(szProduct, iFeatureIndex, lpFeatureBuf, lpParentBuf);
+}
+
+INSTALLSTATE CProductRecord::QueryFeatureState(const TCHAR* szProduct, const TCHAR* szFeature)
+{
+    const RECORDFEATURE* pFeature = (IsRecorded(szProduct) && m_fFeatures) ? FindFeature(szFeature) : NULL;
+    if (pFeature)
+        return pFeature->isState;
+    return m_pSource->QueryFeatureState(szProduct, szFeature);
+}
+
+UINT CProductRecord::GetFeatureUsage(const TCHAR* szProduct, const TCHAR* szFeature, DWORD* pdwUseCount, WORD* pwDateUsed)
+{
+    const RECORDFEATURE* pFeature = (IsRecorded(szProduct) && m_fFeatureUsage) ? FindFeature(szFeature) : NULL;
+    if (!pFeature)
+        return m_pSource->GetFeatureUsage(szProduct, szFeature, pdwUseCount, pwDateUsed);
+
+    if (ERROR_SUCCESS == pFeature->uiUsageResult)
+    {
+        *pdwUseCount = pFeature->dwUseCount;
+        *pwDateUsed = pFeature->wDateUsed;
+    }
+    return pFeature->uiUsageResult;
+}
+
+UINT CProductRecord::EnumComponents(DWORD iComponentIndex, TCHAR* lpComponentBuf)
+{
+    return m_pSource->EnumComponents(iComponentIndex, lpComponentBuf);
+}
+
+UINT CProductRecord::EnumClients(const TCHAR* szComponent, DWORD iProductIndex, TCHAR* lpProductBuf)
+{
+    return m_pSource->EnumClients(szComponent, iProductIndex, lpProductBuf);
+}
+
+INSTALLSTATE CProductRecord::GetComponentPath(const TCHAR* szProduct, const TCHAR* szComponent, TCHAR* lpPathBuf, DWORD* pcchBuf)
+{
+    const RECORDCOMPONENT* pComponent = (IsRecorded(szProduct)) ? FindComponent(szComponent) : NULL;
+    if (pComponent && pComponent->fPathRecorded && CopyIfFits(Text(pComponent->ichPath), lpPathBuf, pcchBuf))
+        return pComponent->isPath;
+    return m_pSource->GetComponentPath(szProduct, szComponent, lpPathBuf, pcchBuf);
+}
+
+UINT CProductRecord::EnumComponentQualifiers(const TCHAR* szComponent, DWORD iIndex, TCHAR* lpQualifierBuf, DWORD* pcchQualifierBuf,
+                                             TCHAR* lpApplicationDataBuf, DWORD* pcchApplicationDataBuf)
+{
+    const RECORDCOMPONENT* pComponent = (m_fRecorded) ? FindComponent(szComponent) : NULL;
+    if (pComponent)
+    {
+        if (iIndex < pComponent->cQualifiers)
+        {
+            const RECORDQUALIFIER* pQualifier = &m_rgQualifier[pComponent->iFirstQualifier + iIndex];
+            if (pcchQualifierBuf && pcchApplicationDataBuf &&
+                (DWORD) lstrlen(Text(pQualifier->ichQualifier)) < *pcchQualifierBuf &&
+                CopyIfFits(Text(pQualifier->ichApplicationData), lpApplicationDataBuf, pcchApplicationDataBuf) &&
+                CopyIfFits(Text(pQualifier->ichQualifier), lpQualifierBuf, pcchQualifierBuf))
+            {
+                return ERROR_SUCCESS;
+            }
+        }
+        else if (iIndex == pComponent->cQualifiers && ERROR_MORE_DATA != pComponent->uiQualifierEnd)
+        {
+            return pComponent->uiQualifierEnd;
+        }
+    }
+    return m_pSource->EnumComponentQualifiers(szComponent, iIndex, lpQualifierBuf, pcchQualifierBuf, lpApplicationDataBuf, pcchApplicationDataBuf);
+}
+
+UINT CProductRecord::EnumPatches(const TCHAR* szProduct, DWORD iPatchIndex, TCHAR* lpPatchBuf, TCHAR* lpTransformsBuf, DWORD* pcchTransformsBuf)
+{
+    if (IsRecorded(szProduct) && m_fPatchesRecorded)
+    {
+        if (iPatchIndex < m_cPatches)
+        {
+            if (CopyIfFits(Text(m_rgPatch[iPatchIndex].ichTransforms), lpTransformsBuf, pcchTransformsBuf))
+            {
+                lstrcpy(lpPatchBuf, m_rgPatch[iPatchIndex].szPatch);
+                return ERROR_SUCCESS;
+            }
+        }
+        else if (iPatchIndex == m_cPatches && ERROR_MORE_DATA != m_uiPatchEnd)
+        {
+            return m_uiPatchEnd;
+        }
+    }
+    return m_pSource->EnumPatches(szProduct, iPatchIndex, lpPatchBuf, lpTransformsBuf, pcchTransformsBuf);
+}
+
+void CProductRecord::ProbeKeyPath(const TCHAR* szKeyPath, KEYPATHPROBE* pProbe)
+{
+    // the report probes the path it was just given.
+    if (m_fRecorded && szKeyPath && m_iLastComponent < m_cComponents)
+    {
+        const RECORDCOMPONENT* pComponent = &m_rgComponent[m_iLastComponent];
+        if (pComponent->fProbed && 0 == strcmp(Text(pComponent->ichPath), szKeyPath))
+        {
+            *pProbe = pComponent->Probe;
+            return;
+        }
+    }
+    m_pSource->ProbeKeyPath(szKeyPath, pProbe);
+}
+
+//____________________________________________________________________________
+//
+// CProductEnricher
+//____________________________________________________________________________
+
+CProductEnricher::CProductEnricher()
+    : m_pSource(NULL), m_rgszProduct(NULL), m_cProducts(0), m_uiEnumerateEnd(ERROR_NO_MORE_ITEMS),
+      m_rgRecord(NULL), m_iCurrent(0)
+{
+    memset(&m_Query, 0, sizeof(m_Query));
+}
+
+CProductEnricher::~CProductEnricher()
+{
+    Finish();
+}
+
+UINT CProductEnricher::Start(CInstallerData* pSource, const PRODUCTQUERY& Query, DWORD cThreads)
+{
+    Finish();
+    m_pSource = pSource;
+    m_Query = Query;
+
+    // MsiEnumProducts has to be walked in order from one thread.
+    DWORD cAllocated = 0;
+    TCHAR szProduct[CCHGuid];
+    while (ERROR_SUCCESS == (m_uiEnumerateEnd = pSource->EnumProducts(m_cProducts, szProduct)))
+    {
+        if (!GrowArray((void**) &m_rgszProduct, &cAllocated, m_cProducts + 1, sizeof(m_rgszProduct[0])))
+        {
+            Finish();
+            return ERROR_NOT_ENOUGH_MEMORY;
+        }
+        lstrcpy(m_rgszProduct[m_cProducts++], szProduct);
+    }
+
+    m_rgRecord = new CProductRecord[m_cProducts + 1];
+    m_iCurrent = m_cProducts;
+
+    // a few products ahead per worker keeps them busy without holding the whole inventory.
+    if (!m_rgRecord || !m_Pool.Start(cThreads, m_cProducts, cThreads * 4, EnrichProduct, this))
+    {
+        Finish();
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+    return ERROR_SUCCESS;
+}
+
+void CProductEnricher::EnrichProduct(void* pvContext, DWORD iProduct)
+{
+    CProductEnricher* pEnricher = (CProductEnricher*) pvContext;
+    CTraceSpan Span(TEXT("enrich"), TEXT("product"), pEnricher->m_rgszProduct[iProduct]);
+    pEnricher->m_rgRecord[iProduct].Enrich(pEnricher->m_pSource, pEnricher->m_rgszProduct[iProduct], pEnricher->m_Query);
+}
+
+UINT CProductEnricher::NextProduct(DWORD iProductIndex, TCHAR* lpProductBuf, CInstallerData** ppProductData)
+{
+    if (m_iCurrent < m_cProducts)
+    {
+        m_rgRecord[m_iCurrent].Free();
+        m_Pool.ReleaseItem();
+        m_iCurrent = m_cProducts;
+    }
+
+    if (iProductIndex >= m_cProducts)
+        return m_uiEnumerateEnd;
+
+    m_Pool.WaitForItem(iProductIndex);
+    lstrcpy(lpProductBuf, m_rgszProduct[iProductIndex]);
+    *ppProductData = &m_rgRecord[iProductIndex];
+    m_iCurrent = iProductIndex;
+    return ERROR_SUCCESS;
+}
+
+void CProductEnricher::Finish()
+{
+    m_Pool.Finish();
+    delete [] m_rgRecord;
+    free(m_rgszProduct);
+    m_rgRecord = NULL;
+    m_rgszProduct = NULL;
+    m_cProducts = 0;
+    m_iCurrent = 0;
+}
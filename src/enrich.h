@@ -0,0 +1,156 @@
+/*---------------------------------------------------------------------------
+Parallel product enrichment (-j).
+
+    The product report asks the installer a few dozen questions per
+    product - properties, user info, features and their usage, component
+    paths and keypaths, qualifiers, patches - one after another.  With -j
+    those questions are asked ahead of the report by a pool of workers,
+    one product per work item, and the answers kept in a CProductRecord.
+    The report then walks the products in MsiEnumProducts order and asks
+    each record instead of the installer, so the output is byte-for-byte
+    what a serial run prints.
+
+    A record is itself a CInstallerData.  It answers only what it can
+    answer exactly as the installer did (the same value, fitting the
+    caller's buffer); anything else, including questions about other
+    products, is passed through to the provider it was filled from.
+---------------------------------------------------------------------------*/
+
+#ifndef ENRICH_H
+#define ENRICH_H
+
+#include "installerdata.h"
+#include "compindex.h"
+#include "workpool.h"
+#include "prodfilter.h"
+
+struct PRODUCTQUERYPROPERTY {
+    const TCHAR*    szProperty;
+    bool            fInstalledOnly;     // asked only when the product state is INSTALLSTATE_DEFAULT
+};
+
+// what the report will ask about each product.
+struct PRODUCTQUERY {
+    const PRODUCTQUERYPROPERTY* rgProperty;     // rgProperty[0] is the product name
+    DWORD                       cProperties;
+    const CProductFilter*       pFilter;        // -p: products whose code and name match no pattern stop after the name; NULL for none
+    bool                        fUserInfo;
+    bool                        fFeatures;
+    bool                        fFeatureUsage;
+    const COMPONENTINDEX*       pComponentIndex;    // component paths, keypaths and qualifiers; NULL for none
+};
+
+struct RECORDPROPERTY;
+struct RECORDFEATURE;
+struct RECORDCOMPONENT;
+struct RECORDQUALIFIER;
+struct RECORDPATCH;
+
+class CProductRecord : public CInstallerData
+{
+public:
+    CProductRecord();
+    ~CProductRecord();
+
+    // asks pSource everything Query says the report will.  Safe to call on
+    // a worker thread as long as pSource is.
+    void          Enrich(CInstallerData* pSource, const TCHAR* szProduct, const PRODUCTQUERY& Query);
+    void          Free();
+
+    UINT          EnumProducts(DWORD iProductIndex, TCHAR* lpProductBuf);
+    INSTALLSTATE  QueryProductState(const TCHAR* szProduct);
+    UINT          GetProductInfo(const TCHAR* szProduct, const TCHAR* szAttribute, TCHAR* lpValueBuf, DWORD* pcchValueBuf);
+    USERINFOSTATE GetUserInfo(const TCHAR* szProduct, TCHAR* lpUserNameBuf, DWORD* pcchUserNameBuf,
+                              TCHAR* lpOrgNameBuf, DWORD* pcchOrgNameBuf, TCHAR* lpSerialBuf, DWORD* pcchSerialBuf);
+
+    UINT          EnumFeatures(const TCHAR* szProduct, DWORD iFeatureIndex, TCHAR* lpFeatureBuf, TCHAR* lpParentBuf);
+    INSTALLSTATE  QueryFeatureState(const TCHAR* szProduct, const TCHAR* szFeature);
+    UINT          GetFeatureUsage(const TCHAR* szProduct, const TCHAR* szFeature, DWORD* pdwUseCount, WORD* pwDateUsed);
+
+    UINT          EnumComponents(DWORD iComponentIndex, TCHAR* lpComponentBuf);
+    UINT          EnumClients(const TCHAR* szComponent, DWORD iProductIndex, TCHAR* lpProductBuf);
+    INSTALLSTATE  GetComponentPath(const TCHAR* szProduct, const TCHAR* szComponent, TCHAR* lpPathBuf, DWORD* pcchBuf);
+    UINT          EnumComponentQualifiers(const TCHAR* szComponent, DWORD iIndex, TCHAR* lpQualifierBuf, DWORD* pcchQualifierBuf,
+                                          TCHAR* lpApplicationDataBuf, DWORD* pcchApplicationDataBuf);
+
+    UINT          EnumPatches(const TCHAR* szProduct, DWORD iPatchIndex, TCHAR* lpPatchBuf, TCHAR* lpTransformsBuf, DWORD* pcchTransformsBuf);
+
+    void          ProbeKeyPath(const TCHAR* szKeyPath, KEYPATHPROBE* pProbe);
+
+private:
+    bool          IsRecorded(const TCHAR* szProduct) const;
+    DWORD         AddText(const TCHAR* szText);
+    const TCHAR*  Text(DWORD ichText) const     { return m_pchText + ichText; }
+    const RECORDFEATURE*   FindFeature(const TCHAR* szFeature);
+    const RECORDCOMPONENT* FindComponent(const TCHAR* szComponent);
+    void          EnrichComponents(const PRODUCTQUERY& Query);
+
+    CInstallerData*     m_pSource;
+    TCHAR               m_szProduct[CCHGuid];
+    GUIDKEY             m_ProductKey;
+    bool                m_fRecorded;        // false - everything passes through
+    bool                m_fOutOfMemory;
+
+    TCHAR*              m_pchText;          // every recorded string, NUL-separated
+    DWORD               m_cchText;
+    DWORD               m_cchTextAllocated;
+
+    INSTALLSTATE        m_isState;
+    RECORDPROPERTY*     m_rgProperty;
+    DWORD               m_cProperties;
+
+    bool                m_fUserInfo;
+    USERINFOSTATE       m_uisUser;
+    DWORD               m_ichUser, m_ichOrganization, m_ichSerial;
+
+    bool                m_fFeatures;
+    bool                m_fFeatureUsage;
+    RECORDFEATURE*      m_rgFeature;
+    DWORD               m_cFeatures, m_cFeaturesAllocated;
+    UINT                m_uiFeatureEnd;     // what EnumFeatures returned after the last one
+
+    RECORDCOMPONENT*    m_rgComponent;
+    DWORD               m_cComponents;
+    RECORDQUALIFIER*    m_rgQualifier;
+    DWORD               m_cQualifiers, m_cQualifiersAllocated;
+    DWORD               m_iLastComponent;   // the report asks about the component it just asked the path of
+
+    RECORDPATCH*        m_rgPatch;
+    DWORD               m_cPatches, m_cPatchesAllocated;
+    UINT                m_uiPatchEnd;
+    bool                m_fPatchesRecorded;
+
+    DWORD               m_iLastFeature;
+};
+
+// enumerates the products up front, then enriches them on a work pool
+// while the report consumes them in order.
+class CProductEnricher
+{
+public:
+    CProductEnricher();
+    ~CProductEnricher();
+
+    // ERROR_NOT_ENOUGH_MEMORY when the records or threads cannot be had.
+    UINT  Start(CInstallerData* pSource, const PRODUCTQUERY& Query, DWORD cThreads);
+
+    // EnumProducts' contract, called with iProductIndex 0, 1, 2, ...;
+    // *ppProductData answers for that product until the next call.
+    UINT  NextProduct(DWORD iProductIndex, TCHAR* lpProductBuf, CInstallerData** ppProductData);
+
+    void  Finish();
+
+private:
+    static void EnrichProduct(void* pvContext, DWORD iProduct);
+
+    CInstallerData*     m_pSource;
+    PRODUCTQUERY        m_Query;
+    CWorkPool           m_Pool;
+    TCHAR             (*m_rgszProduct)[CCHGuid];
+    DWORD               m_cProducts;
+    UINT                m_uiEnumerateEnd;   // what EnumProducts returned after the last product
+    CProductRecord*     m_rgRecord;
+    DWORD               m_iCurrent;         // record the report holds; m_cProducts for none
+};
+
+#endif // ENRICH_H
@@ -0,0 +1,298 @@
+/*---------------------------------------------------------------------------
+Product events - see eventjoin.h.
+---------------------------------------------------------------------------*/
+
+#include "eventjoin.h"
+#include <stdlib.h>
+#include <string.h>
+
+const TCHAR* const EventActionNames[cEventActions] = { TEXT(""), TEXT("install"), TEXT("repair"), TEXT("uninstall") };
+
+const DWORD CCHEventProductName = 256;
+
+struct EVENTCODESLOT {
+    GUIDKEY     Key;
+    DWORD       iRow;
+    bool        fUsed;
+};
+
+// what one MsiInstaller record says.
+struct MSIEVENT {
+    bool        fCode;
+    GUIDKEY     ProductKey;
+    TCHAR       szName[CCHEventProductName];    // "" - none
+    EVENTACTION ea;
+    bool        fFailed;        // the install, repair or uninstall
+    bool        fError;         // an error event
+};
+
+//____________________________________________________________________________
+//
+// Reading a record
+//____________________________________________________________________________
+
+// the first braced GUID in pb; false for none.
+static bool FindProductCode(const BYTE* pb, size_t cb, GUIDKEY* pKey)
+{
+    for (size_t ib = 0; ib + 38 <= cb; ib++)
+    {
+        if (('{' != pb[ib]) || ('}' != pb[ib + 37]))
+            continue;
+        TCHAR szGuid[39];
+        for (int ich = 0; ich < 38; ich++)
+            szGuid[ich] = (TCHAR) pb[ib + ich];
+        szGuid[38] = 0;
+        if (MakeGuidKey(szGuid, pKey))
+            return true;
+    }
+    return false;
+}
+
+static void CopyProductName(TCHAR* szName, const TCHAR* pchName, size_t cchName)
+{
+    while (cchName && (' ' == pchName[cchName - 1]))
+        cchName--;
+    if (cchName > CCHEventProductName - 1)
+        cchName = CCHEventProductName - 1;
+    memcpy(szName, pchName, cchName * sizeof(TCHAR));
+    szName[cchName] = 0;
+}
+
+static void ParseMsiEvent(const EVENTLOGRECORD* pevlr, MSIEVENT* pEvent)
+{
+    memset(pEvent, 0, sizeof(MSIEVENT));
+    pEvent->fError = (0 != (EVENTLOG_ERROR_TYPE & pevlr->EventType));
+
+    // the strings, as far as they are there and end inside the record; the reader
+    // has seen to the first.
+    const BYTE* pbRecord = (const BYTE*) pevlr;
+    const DWORD cbStrings = pevlr->Length - sizeof(DWORD);
+    const TCHAR* rgszString[5] = { NULL, NULL, NULL, NULL, NULL };
+    DWORD ibString = pevlr->UserSidOffset + pevlr->UserSidLength;
+    for (DWORD iString = 0; (iString < 5) && (iString < pevlr->NumStrings) && (ibString < cbStrings); iString++)
+    {
+        const BYTE* pbEnd = (const BYTE*) memchr(pbRecord + ibString, 0, cbStrings - ibString);
+        if (!pbEnd)
+            break;
+        rgszString[iString] = (const TCHAR*) (pbRecord + ibString);
+        ibString = (DWORD) (pbEnd - pbRecord) + 1;
+    }
+
+    // the product code: MsiInstaller puts it in the data, and some messages quote it.
+    if ((pevlr->DataLength) && (pevlr->DataOffset >= sizeof(EVENTLOGRECORD)) &&
+        (pevlr->DataOffset <= cbStrings) && (pevlr->DataLength <= cbStrings - pevlr->DataOffset))
+        pEvent->fCode = FindProductCode(pbRecord + pevlr->DataOffset, pevlr->DataLength, &pEvent->ProductKey);
+    for (DWORD iString = 0; !pEvent->fCode && (iString < 5) && rgszString[iString]; iString++)
+        pEvent->fCode = FindProductCode((const BYTE*) rgszString[iString], lstrlen(rgszString[iString]), &pEvent->ProductKey);
+
+    DWORD dwEventId = pevlr->EventID & 0xffff;
+    switch (dwEventId)
+    {
+        case 1033:  pEvent->ea = eaInstall;     break;
+        case 1034:  pEvent->ea = eaUninstall;   break;
+        case 1035:  pEvent->ea = eaRepair;      break;
+        case 11707: pEvent->ea = eaInstall;     break;
+        case 11708: pEvent->ea = eaInstall;     pEvent->fFailed = true;     break;
+        case 11724: pEvent->ea = eaUninstall;   break;
+        case 11725: pEvent->ea = eaUninstall;   pEvent->fFailed = true;     break;
+        case 11728: pEvent->ea = eaRepair;      break;
+        case 11729: pEvent->ea = eaRepair;      pEvent->fFailed = true;     break;
+    }
+
+    if ((dwEventId == 1022) || ((dwEventId >= 1033) && (dwEventId <= 1038)))
+    {
+        // name, version, language, status, manufacturer.
+        if (rgszString[0])
+            CopyProductName(pEvent->szName, rgszString[0], lstrlen(rgszString[0]));
+        if ((dwEventId <= 1035) && rgszString[3] && (0 != lstrcmp(rgszString[3], TEXT("0"))))
+            pEvent->fFailed = true;
+    }
+    else if (rgszString[0] && (0 == strncmp(rgszString[0], TEXT("Product: "), 9)))
+    {
+        // Product: name -- message
+        const TCHAR* pchName = rgszString[0] + 9;
+        const TCHAR* pchEnd = strstr(pchName, TEXT(" -- "));
+        CopyProductName(pEvent->szName, pchName, (pchEnd) ? pchEnd - pchName : lstrlen(pchName));
+    }
+}
+
+bool IsEventForProduct(const EVENTLOGRECORD* pevlr, const GUIDKEY& ProductKey, const TCHAR* szName, bool* pfFailure)
+{
+    const TCHAR* szSource = (const TCHAR*) ((const BYTE*) pevlr + sizeof(EVENTLOGRECORD));
+    if (0 != _stricmp(szSource, TEXT("MsiInstaller")))
+        return false;
+
+    MSIEVENT Event;
+    ParseMsiEvent(pevlr, &Event);
+    *pfFailure = Event.fError;
+    if (Event.fCode)
+        return IsEqualGuidKey(Event.ProductKey, ProductKey);
+    return Event.szName[0] && (0 == lstrcmpi(Event.szName, szName));
+}
+
+//____________________________________________________________________________
+//
+// The index
+//____________________________________________________________________________
+
+CProductEventIndex::CProductEventIndex()
+    : m_rgRow(NULL), m_cRows(0), m_cRowsAllocated(0), m_rgCodeSlot(NULL), m_cCodeSlots(0), m_cCodes(0),
+      m_fNameMap(false), m_cEvents(0), m_cByCode(0), m_cByName(0)
+{
+    memset(&m_NameMap, 0, sizeof(m_NameMap));
+}
+
+CProductEventIndex::~CProductEventIndex()
+{
+    free(m_rgRow);
+    free(m_rgCodeSlot);
+    if (m_fNameMap)
+        FreeStringMap(&m_NameMap);
+}
+
+bool CProductEventIndex::AddRow(DWORD* piRow)
+{
+    if (m_cRows == m_cRowsAllocated)
+    {
+        DWORD cAllocate = (m_cRowsAllocated) ? m_cRowsAllocated * 2 : 256;
+        PRODUCTEVENTS* rgRow = (PRODUCTEVENTS*) realloc(m_rgRow, cAllocate * sizeof(PRODUCTEVENTS));
+        if (!rgRow)
+            return false;
+        m_rgRow = rgRow;
+        m_cRowsAllocated = cAllocate;
+    }
+    memset(&m_rgRow[m_cRows], 0, sizeof(PRODUCTEVENTS));
+    *piRow = m_cRows++;
+    return true;
+}
+
+// slot holding Key, or the empty slot where it would go.
+static DWORD FindCodeSlot(const EVENTCODESLOT* rgSlot, DWORD cSlots, const GUIDKEY& Key)
+{
+    DWORD dwMask = cSlots - 1;
+    DWORD iSlot = HashGuidKey(Key) & dwMask;
+    while (rgSlot[iSlot].fUsed && !IsEqualGuidKey(rgSlot[iSlot].Key, Key))
+        iSlot = (iSlot + 1) & dwMask;
+    return iSlot;
+}
+
+bool CProductEventIndex::Add(const EVENTLOGRECORD* pevlr)
+{
+    const TCHAR* szSource = (const TCHAR*) ((const BYTE*) pevlr + sizeof(EVENTLOGRECORD));
+    if (0 != _stricmp(szSource, TEXT("MsiInstaller")))
+        return true;
+    m_cEvents++;
+
+    MSIEVENT Event;
+    ParseMsiEvent(pevlr, &Event);
+
+    DWORD iRow;
+    if (Event.fCode)
+    {
+        if ((m_cCodes + 1) * 2 > m_cCodeSlots)
+        {
+            DWORD cSlots = (m_cCodeSlots) ? m_cCodeSlots * 2 : 256;
+            EVENTCODESLOT* rgSlot = (EVENTCODESLOT*) calloc(cSlots, sizeof(EVENTCODESLOT));
+            if (!rgSlot)
+                return false;
+            for (DWORD iSlot = 0; iSlot < m_cCodeSlots; iSlot++)
+            {
+                if (m_rgCodeSlot[iSlot].fUsed)
+                    rgSlot[FindCodeSlot(rgSlot, cSlots, m_rgCodeSlot[iSlot].Key)] = m_rgCodeSlot[iSlot];
+            }
+            free(m_rgCodeSlot);
+            m_rgCodeSlot = rgSlot;
+            m_cCodeSlots = cSlots;
+        }
+
+        EVENTCODESLOT& Slot = m_rgCodeSlot[FindCodeSlot(m_rgCodeSlot, m_cCodeSlots, Event.ProductKey)];
+        if (!Slot.fUsed)
+        {
+            if (!AddRow(&Slot.iRow))
+                return false;
+            Slot.Key = Event.ProductKey;
+            Slot.fUsed = true;
+            m_cCodes++;
+        }
+        iRow = Slot.iRow;
+        m_cByCode++;
+    }
+    else if (Event.szName[0])
+    {
+        if (!m_fNameMap)
+        {
+            if (!InitStringMap(&m_NameMap, 256, false))
+                return false;
+            m_fNameMap = true;
+        }
+        if (!FindStringMapValue(&m_NameMap, Event.szName, &iRow))
+        {
+            const TCHAR* szName = m_Arena.Copy(Event.szName, lstrlen(Event.szName));
+            if (!*szName || !AddRow(&iRow) || !SetStringMapValue(&m_NameMap, szName, iRow))
+                return false;
+        }
+        m_cByName++;
+    }
+    else
+    {
+        return true;
+    }
+
+    // newest first: the first install, repair or uninstall a row sees is its last.
+    PRODUCTEVENTS* pRow = Row(iRow);
+    pRow->cEvents++;
+    if (Event.fError)
+        pRow->cFailures++;
+    if ((eaNone != Event.ea) && (eaNone == pRow->eaLast))
+    {
+        pRow->eaLast = Event.ea;
+        pRow->fLastFailed = Event.fFailed;
+        pRow->dwLastTime = pevlr->TimeGenerated;
+        pRow->dwLastEventId = pevlr->EventID & 0xffff;
+    }
+    return true;
+}
+
+UINT CProductEventIndex::Build(CEventLogReader& Reader)
+{
+    const EVENTLOGRECORD* pevlr;
+    while (NULL != (pevlr = Reader.Next()))
+    {
+        if (!Add(pevlr))
+            return ERROR_NOT_ENOUGH_MEMORY;
+    }
+    return Reader.Error();
+}
+
+bool CProductEventIndex::Find(const GUIDKEY& ProductKey, const TCHAR* szName, PRODUCTEVENTS* pEvents) const
+{
+    memset(pEvents, 0, sizeof(PRODUCTEVENTS));
+
+    const PRODUCTEVENTS* rgpRow[2] = { NULL, NULL };
+    if (m_cCodes)
+    {
+        const EVENTCODESLOT& Slot = m_rgCodeSlot[FindCodeSlot(m_rgCodeSlot, m_cCodeSlots, ProductKey)];
+        if (Slot.fUsed)
+            rgpRow[0] = &m_rgRow[Slot.iRow];
+    }
+    DWORD iRow;
+    if (m_fNameMap && szName && *szName && FindStringMapValue(&m_NameMap, szName, &iRow))
+        rgpRow[1] = &m_rgRow[iRow];
+
+    for (int i = 0; i < 2; i++)
+    {
+        const PRODUCTEVENTS* pRow = rgpRow[i];
+        if (!pRow)
+            continue;
+        pEvents->cEvents += pRow->cEvents;
+        pEvents->cFailures += pRow->cFailures;
+        if ((eaNone != pRow->eaLast) && ((eaNone == pEvents->eaLast) || (pRow->dwLastTime > pEvents->dwLastTime)))
+        {
+            pEvents->eaLast = pRow->eaLast;
+            pEvents->fLastFailed = pRow->fLastFailed;
+            pEvents->dwLastTime = pRow->dwLastTime;
+            pEvents->dwLastEventId = pRow->dwLastEventId;
+        }
+    }
+    return (0 != pEvents->cEvents);
+}
@@ -0,0 +1,106 @@
+/*---------------------------------------------------------------------------
+Product events (-productevents).
+
+    -l lists the MsiInstaller events newest first, and matching them to
+    the products they are about was left to whoever read the list.  With
+    -productevents the report reads the MsiInstaller events once, before
+    the products, and puts under each product the last time it was
+    installed, repaired or uninstalled, and how many of its events were
+    failures.
+
+    Each event is tied to a product by the product code in its data or
+    its strings, or failing that by the product name in its message:
+
+        1033 1034 1035          installed / removed / reconfigured the
+                                product: the name is the first string,
+                                the status the fourth
+        11707 11724 11728       "Product: name -- ..." succeeded
+        11708 11725 11729       and failed
+
+    The events are gathered into a row per code, and a row per name for
+    events that carry no code, in hash tables; each product then finds
+    its rows by its code and its name.  Reading the log is one pass and
+    each product one lookup, however many of either there are, where
+    matching by hand meant the whole list for every product.  Products
+    that share a name share the events that only name them.
+
+    A failure is an event of the error type; the last install, repair or
+    uninstall failed when its event says so (11708, 11725, 11729) or its
+    status is not 0.
+---------------------------------------------------------------------------*/
+
+#ifndef EVENTJOIN_H
+#define EVENTJOIN_H
+
+#include "msiport.h"
+#include "eventlog.h"
+#include "guidkey.h"
+#include "strarena.h"
+#include "strmap.h"
+
+enum EVENTACTION {
+    eaNone,
+    eaInstall,
+    eaRepair,               // reconfigured: repaired or modified
+    eaUninstall,
+    cEventActions
+};
+
+extern const TCHAR* const EventActionNames[cEventActions];     // "", "install", "repair", "uninstall"
+
+struct PRODUCTEVENTS {
+    DWORD       cEvents;
+    DWORD       cFailures;
+    EVENTACTION eaLast;             // eaNone - no install, repair or uninstall event
+    bool        fLastFailed;
+    DWORD       dwLastTime;         // TimeGenerated, seconds since 1970
+    DWORD       dwLastEventId;
+};
+
+struct EVENTCODESLOT;
+
+class CProductEventIndex
+{
+public:
+    CProductEventIndex();
+    ~CProductEventIndex();
+
+    // every MsiInstaller record Reader gives.  ERROR_SUCCESS, the reader's
+    // error, or ERROR_NOT_ENOUGH_MEMORY.
+    UINT  Build(CEventLogReader& Reader);
+    // one record, newest first like the reader gives them; false when out of memory.
+    bool  Add(const EVENTLOGRECORD* pevlr);
+
+    // the events of the product with this code and name; false when there are none.
+    bool  Find(const GUIDKEY& ProductKey, const TCHAR* szName, PRODUCTEVENTS* pEvents) const;
+
+    DWORD EventCount() const            { return m_cEvents; }      // MsiInstaller events read
+    DWORD ByCodeCount() const           { return m_cByCode; }
+    DWORD ByNameCount() const           { return m_cByName; }      // the rest named no product
+
+private:
+    PRODUCTEVENTS* Row(DWORD iRow)      { return &m_rgRow[iRow]; }
+    bool  AddRow(DWORD* piRow);
+
+    PRODUCTEVENTS*  m_rgRow;
+    DWORD           m_cRows;
+    DWORD           m_cRowsAllocated;
+
+    EVENTCODESLOT*  m_rgCodeSlot;           // open addressing, at most half full
+    DWORD           m_cCodeSlots;
+    DWORD           m_cCodes;
+    STRINGMAP       m_NameMap;              // name to row, for events with no code
+    bool            m_fNameMap;
+    CStringArena    m_Arena;
+
+    DWORD           m_cEvents;
+    DWORD           m_cByCode;
+    DWORD           m_cByName;
+};
+
+// the record is about the product with this code, or names it and has no code:
+// what the index matches, asked of one record for one product.  For -bench
+// eventjoin, which times the rescan a product at a time the index replaces.
+bool  IsEventForProduct(const EVENTLOGRECORD* pevlr, const GUIDKEY& ProductKey, const TCHAR* szName, bool* pfFailure);
+
+#endif // EVENTJOIN_H
@@ -0,0 +1,397 @@
+/*---------------------------------------------------------------------------
+Event log reader - see eventlog.h.
+---------------------------------------------------------------------------*/
+
+#include "eventlog.h"
+#include "callcount.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const TCHAR s_szStateHeader[] = TEXT("MSIINV-EVENTSTATE\t1");
+static const char s_szDumpHeader[8] = { 'M', 'S', 'I', 'E', 'V', 'T', '0', '1' };
+
+// every EVENTLOGRECORD's Reserved field.
+const DWORD ELF_LOG_SIGNATURE_VALUE = 0x654c664c;
+
+// the report reads the source name after the fixed fields and a string after
+// the user SID; both have to end before the trailing length does.
+static bool HasTerminatedStrings(const EVENTLOGRECORD* pevlr)
+{
+    const BYTE* pbRecord = (const BYTE*) pevlr;
+    DWORD cbStrings = pevlr->Length - sizeof(DWORD);
+    if (!memchr(pbRecord + sizeof(EVENTLOGRECORD), 0, cbStrings - sizeof(EVENTLOGRECORD)))
+        return false;
+
+    DWORD ibMessage = pevlr->UserSidOffset + pevlr->UserSidLength;
+    if ((ibMessage < pevlr->UserSidOffset) || (ibMessage < sizeof(EVENTLOGRECORD)) || (ibMessage >= cbStrings))
+        return false;
+    return (NULL != memchr(pbRecord + ibMessage, 0, cbStrings - ibMessage));
+}
+
+void EventLogTimeToFileTime(DWORD dwTime, FILETIME* pFileTime)
+{
+    Int64ToFileTime((__int64) dwTime * 10000000 + FILETIMEUnixEpoch, pFileTime);
+}
+
+bool ParseSinceTime(const TCHAR* szSince, DWORD* pdwTime)
+{
+    if (!szSince || !*szSince)
+        return false;
+
+    // Nd, Nh: back from now.
+    TCHAR* pchEnd = NULL;
+    unsigned long ulCount = strtoul(szSince, &pchEnd, 10);
+    if ((pchEnd != szSince) && pchEnd[0] && !pchEnd[1] && ('-' != pchEnd[0]))
+    {
+        DWORD dwUnit = 0;
+        if ('d' == pchEnd[0] || 'D' == pchEnd[0])
+            dwUnit = 24 * 60 * 60;
+        else if ('h' == pchEnd[0] || 'H' == pchEnd[0])
+            dwUnit = 60 * 60;
+        if (!dwUnit)
+            return false;
+        DWORD dwNow = (DWORD) time(NULL);
+        *pdwTime = (ulCount * dwUnit < dwNow) ? dwNow - (DWORD) (ulCount * dwUnit) : 0;
+        return true;
+    }
+
+    SYSTEMTIME st;
+    memset(&st, 0, sizeof(st));
+    unsigned int uYear, uMonth, uDay, uHour = 0, uMinute = 0, uSecond = 0;
+    int cFields = sscanf(szSince, TEXT("%4u-%2u-%2uT%2u:%2u:%2u"), &uYear, &uMonth, &uDay, &uHour, &uMinute, &uSecond);
+    if ((3 != cFields) && (6 != cFields))
+        return false;
+    if (uYear < 1970 || uMonth < 1 || uMonth > 12 || uDay < 1 || uDay > 31 || uHour > 23 || uMinute > 59 || uSecond > 59)
+        return false;
+    st.wYear = (WORD) uYear;
+    st.wMonth = (WORD) uMonth;
+    st.wDay = (WORD) uDay;
+    st.wHour = (WORD) uHour;
+    st.wMinute = (WORD) uMinute;
+    st.wSecond = (WORD) uSecond;
+
+    FILETIME ft;
+    if (!SystemTimeToFileTime(&st, &ft))
+        return false;
+    *pdwTime = (DWORD) ((FileTimeToInt64(&ft) - FILETIMEUnixEpoch) / 10000000);
+    return true;
+}
+
+CEventLogReader::CEventLogReader()
+    : m_pDump(NULL), m_pbBuffer(NULL), m_cbBuffer(0), m_ibNext(0), m_ibEnd(0), m_dwCutoff(0),
+      m_fDone(true), m_uiError(ERROR_SUCCESS), m_eCheckpoint(ecNone), m_cRecords(0), m_cReads(0), m_cbRead(0)
+{
+    memset(&m_Checkpoint, 0, sizeof(m_Checkpoint));
+    memset(&m_Newest, 0, sizeof(m_Newest));
+#ifdef _WIN32
+    m_hEventLog = NULL;
+#endif
+}
+
+CEventLogReader::~CEventLogReader()
+{
+    Close();
+    free(m_pbBuffer);
+}
+
+bool CEventLogReader::Grow(DWORD cbNeeded)
+{
+    if (cbNeeded <= m_cbBuffer)
+        return true;
+    if (cbNeeded > CBLargestEventRecord)
+    {
+        m_uiError = ERROR_INVALID_DATA;
+        return false;
+    }
+
+    DWORD cbBuffer = (m_cbBuffer) ? m_cbBuffer : CBEventBuffer;
+    while (cbBuffer < cbNeeded)
+        cbBuffer *= 2;
+    BYTE* pbBuffer = (BYTE*) realloc(m_pbBuffer, cbBuffer);
+    if (!pbBuffer)
+    {
+        m_uiError = ERROR_NOT_ENOUGH_MEMORY;
+        return false;
+    }
+    m_pbBuffer = pbBuffer;
+    m_cbBuffer = cbBuffer;
+    return true;
+}
+
+#ifdef _WIN32
+UINT CEventLogReader::OpenLive(const TCHAR* szLog)
+{
+    Close();
+    CCallTimer Timer(tcOpenEventLog);
+    m_hEventLog = OpenEventLog(NULL, szLog);
+    Timer.Stop();
+    if (NULL == m_hEventLog)
+        return GetLastError();
+    if (!Grow(CBEventBuffer))
+    {
+        Close();
+        return m_uiError;
+    }
+    m_fDone = false;
+    return ERROR_SUCCESS;
+}
+#endif
+
+UINT CEventLogReader::OpenDump(const TCHAR* szFile)
+{
+    Close();
+    m_pDump = fopen(szFile, TEXT("rb"));
+    if (!m_pDump)
+        return ERROR_FILE_NOT_FOUND;
+
+    char rgchHeader[sizeof(s_szDumpHeader)];
+    if ((1 != fread(rgchHeader, sizeof(rgchHeader), 1, m_pDump)) || (0 != memcmp(rgchHeader, s_szDumpHeader, sizeof(rgchHeader))))
+    {
+        Close();
+        return ERROR_INVALID_DATA;
+    }
+    if (!Grow(CBEventBuffer))
+    {
+        Close();
+        return m_uiError;
+    }
+    m_fDone = false;
+    return ERROR_SUCCESS;
+}
+
+void CEventLogReader::Close()
+{
+#ifdef _WIN32
+    if (m_hEventLog)
+        CloseEventLog(m_hEventLog);
+    m_hEventLog = NULL;
+#endif
+    if (m_pDump)
+        fclose(m_pDump);
+    m_pDump = NULL;
+    m_ibNext = m_ibEnd = 0;
+    m_fDone = true;
+    m_uiError = ERROR_SUCCESS;
+    m_eCheckpoint = ecNone;
+    memset(&m_Newest, 0, sizeof(m_Newest));
+    m_cRecords = m_cReads = 0;
+    m_cbRead = 0;
+}
+
+bool CEventLogReader::Fill()
+{
+#ifdef _WIN32
+    if (m_hEventLog)
+    {
+        // whole records only; what is in the buffer has all been walked.
+        m_ibNext = m_ibEnd = 0;
+        for (;;)
+        {
+            DWORD cbRead = 0;
+            DWORD cbNeeded = 0;
+            m_cReads++;
+            CCallTimer Timer(tcReadEventLog);
+            BOOL fRead = ReadEventLog(m_hEventLog, EVENTLOG_SEQUENTIAL_READ | EVENTLOG_BACKWARDS_READ, 0,
+                                      m_pbBuffer, m_cbBuffer, &cbRead, &cbNeeded);
+            Timer.Stop();
+            if (fRead)
+            {
+                m_ibEnd = cbRead;
+                m_cbRead += cbRead;
+                return (0 != cbRead);
+            }
+
+            DWORD dwError = GetLastError();
+            if ((ERROR_INSUFFICIENT_BUFFER == dwError) && Grow(cbNeeded))
+                continue;
+            if ((ERROR_HANDLE_EOF != dwError) && (ERROR_INSUFFICIENT_BUFFER != dwError))
+                m_uiError = dwError;
+            return false;
+        }
+    }
+#endif
+
+    if (!m_pDump)
+        return false;
+
+    // keep the part of a record the last read cut off, then read as much again as there is room.
+    DWORD cbKept = m_ibEnd - m_ibNext;
+    memmove(m_pbBuffer, m_pbBuffer + m_ibNext, cbKept);
+    m_ibNext = 0;
+    m_ibEnd = cbKept;
+
+    if (cbKept >= sizeof(DWORD))
+    {
+        DWORD cbRecord;
+        memcpy(&cbRecord, m_pbBuffer, sizeof(DWORD));
+        if (!Grow(cbRecord))
+            return false;
+    }
+
+    m_cReads++;
+    CCallTimer Timer(tcReadEventLog);
+    size_t cbRead = fread(m_pbBuffer + m_ibEnd, 1, m_cbBuffer - m_ibEnd, m_pDump);
+    Timer.Stop();
+    m_ibEnd += (DWORD) cbRead;
+    m_cbRead += cbRead;
+    if (!cbRead && cbKept)
+        m_uiError = ERROR_INVALID_DATA;     // a record cut short at the end of the file
+    return (0 != cbRead);
+}
+
+const EVENTLOGRECORD* CEventLogReader::Next()
+{
+    while (!m_fDone)
+    {
+        DWORD cbLeft = m_ibEnd - m_ibNext;
+        const EVENTLOGRECORD* pevlr = (const EVENTLOGRECORD*) (m_pbBuffer + m_ibNext);
+        if ((cbLeft < sizeof(EVENTLOGRECORD)) || (cbLeft < pevlr->Length))
+        {
+            if (!Fill())
+            {
+                m_fDone = true;
+                // down to the oldest record without meeting the checkpoint.
+                if (m_Checkpoint.dwRecordNumber && (ecNone == m_eCheckpoint) && (ERROR_SUCCESS == m_uiError))
+                    m_eCheckpoint = (m_Newest.dwRecordNumber) ? ecWrapped : ecCleared;
+            }
+            continue;
+        }
+
+        // the length is written at both ends of a record.
+        DWORD cbTrailing = 0;
+        if (pevlr->Length >= sizeof(EVENTLOGRECORD) + sizeof(DWORD))
+            memcpy(&cbTrailing, m_pbBuffer + m_ibNext + pevlr->Length - sizeof(DWORD), sizeof(DWORD));
+        if ((pevlr->Length < sizeof(EVENTLOGRECORD) + sizeof(DWORD)) || (cbTrailing != pevlr->Length) ||
+            (ELF_LOG_SIGNATURE_VALUE != pevlr->Reserved) || (pevlr->Length & 3))
+        {
+            m_uiError = ERROR_INVALID_DATA;
+            m_fDone = true;
+            break;
+        }
+
+        if (!m_Newest.dwRecordNumber)
+        {
+            m_Newest.dwRecordNumber = pevlr->RecordNumber;
+            m_Newest.dwTimeGenerated = pevlr->TimeGenerated;
+            m_Newest.dwTimeWritten = pevlr->TimeWritten;
+        }
+
+        if ((ecNone == m_eCheckpoint) && (pevlr->RecordNumber <= m_Checkpoint.dwRecordNumber))
+        {
+            if ((pevlr->RecordNumber == m_Checkpoint.dwRecordNumber) &&
+                (pevlr->TimeGenerated == m_Checkpoint.dwTimeGenerated) && (pevlr->TimeWritten == m_Checkpoint.dwTimeWritten))
+            {
+                m_eCheckpoint = ecReached;
+                m_fDone = true;
+                break;
+            }
+            m_eCheckpoint = ecCleared;
+        }
+
+        if (m_dwCutoff && (pevlr->TimeGenerated < m_dwCutoff))
+        {
+            m_fDone = true;
+            break;
+        }
+
+        m_ibNext += pevlr->Length;
+        m_cRecords++;
+        if (!HasTerminatedStrings(pevlr))
+            continue;           // nothing the report could print
+        return pevlr;
+    }
+    return NULL;
+}
+
+UINT LoadEventCheckpoint(const TCHAR* szFile, EVENTCHECKPOINT* pCheckpoint)
+{
+    memset(pCheckpoint, 0, sizeof(EVENTCHECKPOINT));
+    FILE* pFile = fopen(szFile, TEXT("rb"));
+    if (!pFile)
+        return ERROR_FILE_NOT_FOUND;
+
+    TCHAR szLine[128];
+    UINT uiResult = ERROR_INVALID_DATA;
+    unsigned int uRecordNumber, uTimeGenerated, uTimeWritten;
+    if (fgets(szLine, sizeof(szLine) / sizeof(TCHAR), pFile) &&
+        (0 == strncmp(szLine, s_szStateHeader, lstrlen(s_szStateHeader))) &&
+        (3 == sscanf(szLine + lstrlen(s_szStateHeader), TEXT("\t%u\t%u\t%u"), &uRecordNumber, &uTimeGenerated, &uTimeWritten)))
+    {
+        pCheckpoint->dwRecordNumber = uRecordNumber;
+        pCheckpoint->dwTimeGenerated = uTimeGenerated;
+        pCheckpoint->dwTimeWritten = uTimeWritten;
+        uiResult = ERROR_SUCCESS;
+    }
+    fclose(pFile);
+    return uiResult;
+}
+
+UINT SaveEventCheckpoint(const TCHAR* szFile, const EVENTCHECKPOINT& Checkpoint)
+{
+    FILE* pFile = fopen(szFile, TEXT("wb"));
+    if (!pFile)
+        return ERROR_OPEN_FAILED;
+    fprintf(pFile, TEXT("%s\t%u\t%u\t%u\n"), s_szStateHeader, Checkpoint.dwRecordNumber, Checkpoint.dwTimeGenerated, Checkpoint.dwTimeWritten);
+    return (0 == fclose(pFile)) ? ERROR_SUCCESS : ERROR_WRITE_FAULT;
+}
+
+FILE* CreateEventDump(const TCHAR* szFile)
+{
+    FILE* pFile = fopen(szFile, TEXT("wb"));
+    if (pFile && (1 != fwrite(s_szDumpHeader, sizeof(s_szDumpHeader), 1, pFile)))
+    {
+        fclose(pFile);
+        pFile = NULL;
+    }
+    return pFile;
+}
+
+bool WriteEventRecord(FILE* pFile, const EVENTLOGRECORD* pevlr)
+{
+    return (1 == fwrite(pevlr, pevlr->Length, 1, pFile));
+}
+
+int RecordEventLog(const TCHAR* szFile, DWORD dwSince)
+{
+#ifdef _WIN32
+    CEventLogReader Reader;
+    UINT uiResult = Reader.OpenLive(TEXT("Application"));
+    if (ERROR_SUCCESS != uiResult)
+    {
+        fprintf(stderr, TEXT("Cannot read event log Application: %d\n"), uiResult);
+        return 1;
+    }
+    Reader.SetCutoff(dwSince);
+
+    FILE* pFile = CreateEventDump(szFile);
+    if (!pFile)
+    {
+        fprintf(stderr, TEXT("Cannot write events %s: %d\n"), szFile, ERROR_OPEN_FAILED);
+        return 1;
+    }
+
+    // every source, not just MsiInstaller: a dump stands in for the whole log.
+    bool fWritten = true;
+    const EVENTLOGRECORD* pevlr;
+    while (fWritten && (NULL != (pevlr = Reader.Next())))
+        fWritten = WriteEventRecord(pFile, pevlr);
+    if (0 != fclose(pFile))
+        fWritten = false;
+
+    if (!fWritten)
+    {
+        fprintf(stderr, TEXT("Cannot write events %s: %d\n"), szFile, ERROR_WRITE_FAULT);
+        return 1;
+    }
+    if (ERROR_SUCCESS != Reader.Error())
+    {
+        fprintf(stderr, TEXT("Cannot read event log Application: %d\n"), Reader.Error());
+        return 1;
+    }
+    return 0;
+#else
+    fprintf(stderr, TEXT("The event log is not available on this platform.\n"));
+    return 1;
+#endif
+}
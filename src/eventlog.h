@@ -0,0 +1,131 @@
+/*---------------------------------------------------------------------------
+Event log reader (-l).
+
+    The report lists the Application log's MsiInstaller events, newest
+    first.  It used to ask for them one record at a time - a seek and a
+    read per record into a 4K buffer, skipping any record that did not fit
+    - so a large log meant as many calls as it had records.  The reader
+    reads sequentially, backwards, into a 64K buffer that holds as many
+    records as fit, and walks them out of it; a record bigger than the
+    buffer makes it grow rather than go missing.
+
+    A cutoff (-since) ends the read at the first record generated before
+    it: the log is read newest first, so everything after is older.
+
+    The same records can come from a dump file instead of this machine's
+    log (-events), which is how the reader is exercised and benchmarked off
+    Windows.  A dump is a header and then EVENTLOGRECORDs back to back,
+    newest first, exactly as ReadEventLog returns them; -recordevents
+    writes one.
+
+    A checkpoint (-eventstate) remembers the newest record a run listed,
+    so the next run lists only what was logged since.  Record numbers only
+    grow until the log is cleared, when they start again from 1; so the
+    read ends at the checkpoint's record number when that record is still
+    the one remembered - same times generated and written - and otherwise
+    goes on to the oldest record, as a run without a checkpoint does.  A
+    log that has wrapped past the checkpoint is read to its oldest record
+    the same way.
+---------------------------------------------------------------------------*/
+
+#ifndef EVENTLOG_H
+#define EVENTLOG_H
+
+#include "msiport.h"
+#include <stdio.h>
+
+const DWORD CBEventBuffer = 64 * 1024;
+const DWORD CBLargestEventRecord = 16 * 1024 * 1024;    // past this a record is not believed
+
+// "-since": YYYY-MM-DD[Thh:mm:ss] (UTC), or N days / N hours back as Nd / Nh.
+// *pdwTime is seconds since 1970, as EVENTLOGRECORD.TimeGenerated.
+bool ParseSinceTime(const TCHAR* szSince, DWORD* pdwTime);
+
+void EventLogTimeToFileTime(DWORD dwTime, FILETIME* pFileTime);
+
+// the newest record a run listed.
+struct EVENTCHECKPOINT {
+    DWORD dwRecordNumber;           // 0 - none
+    DWORD dwTimeGenerated;
+    DWORD dwTimeWritten;
+};
+
+// what became of the checkpoint the read was given.
+enum ECheckpoint {
+    ecNone,                         // none given, or the read has not got to it yet
+    ecReached,                      // read down to it; everything older was listed before
+    ecCleared,                      // a different record has its number: the log was cleared since
+    ecWrapped,                      // the log's oldest record is newer: overwritten since
+};
+
+class CEventLogReader
+{
+public:
+    CEventLogReader();
+    ~CEventLogReader();     // Close()
+
+#ifdef _WIN32
+    // szLog on this machine ("Application").
+    UINT  OpenLive(const TCHAR* szLog);
+#endif
+    UINT  OpenDump(const TCHAR* szFile);
+    void  Close();
+
+    // records generated before dwTime end the read; 0 for none.
+    void  SetCutoff(DWORD dwTime)       { m_dwCutoff = dwTime; }
+    // records as old as Checkpoint end the read, if it is still in the log.
+    void  SetCheckpoint(const EVENTCHECKPOINT& Checkpoint)  { m_Checkpoint = Checkpoint; }
+
+    // the next record, newest first; NULL at the end, at the cutoff, or on an
+    // error (Error() says which).  Valid until the next call.
+    const EVENTLOGRECORD* Next();
+    UINT  Error() const                 { return m_uiError; }
+
+    ECheckpoint CheckpointState() const { return m_eCheckpoint; }
+    // the newest record read; dwRecordNumber 0 when there were none.
+    const EVENTCHECKPOINT& Newest() const { return m_Newest; }
+
+    DWORD RecordCount() const           { return m_cRecords; }
+    DWORD ReadCount() const             { return m_cReads; }
+    unsigned __int64 BytesRead() const  { return m_cbRead; }
+
+private:
+    // refills the buffer from the log or the dump; false at the end.
+    bool  Fill();
+    bool  Grow(DWORD cbNeeded);
+
+#ifdef _WIN32
+    HANDLE  m_hEventLog;
+#endif
+    FILE*   m_pDump;
+    BYTE*   m_pbBuffer;
+    DWORD   m_cbBuffer;
+    DWORD   m_ibNext;           // next record in the buffer
+    DWORD   m_ibEnd;            // end of what was read
+    DWORD   m_dwCutoff;
+    bool    m_fDone;
+    UINT    m_uiError;
+    EVENTCHECKPOINT m_Checkpoint;
+    ECheckpoint m_eCheckpoint;
+    EVENTCHECKPOINT m_Newest;
+
+    DWORD   m_cRecords;
+    DWORD   m_cReads;
+    unsigned __int64 m_cbRead;
+};
+
+// -eventstate.  Load gives ERROR_FILE_NOT_FOUND before the first run and
+// ERROR_INVALID_DATA for a file it cannot make sense of; either way the log
+// is read whole.
+UINT  LoadEventCheckpoint(const TCHAR* szFile, EVENTCHECKPOINT* pCheckpoint);
+UINT  SaveEventCheckpoint(const TCHAR* szFile, const EVENTCHECKPOINT& Checkpoint);
+
+// dump files.  CreateEventDump writes the header; NULL when the file cannot be created.
+FILE* CreateEventDump(const TCHAR* szFile);
+bool  WriteEventRecord(FILE* pFile, const EVENTLOGRECORD* pevlr);
+
+// -recordevents: this machine's Application log, back to dwSince, to szFile.
+// The exit code; messages go to stderr.
+int   RecordEventLog(const TCHAR* szFile, DWORD dwSince);
+
+#endif // EVENTLOG_H
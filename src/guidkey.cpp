@@ -0,0 +1,125 @@
+/*---------------------------------------------------------------------------
+GUID keys - see guidkey.h.
+---------------------------------------------------------------------------*/
+
+#include "guidkey.h"
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define GUIDKEY_SSE2
+#include <emmintrin.h>
+#endif
+
+const GUIDKEY KEYPermanentProduct = { { 0, 0 } };
+
+const int CCHGuidText = CCHGuid - 1;
+
+// the 32 digits of {XXXXXXXX-XXXX-XXXX-XXXX-XXXXXXXXXXXX} side by side; false
+// when the braces and dashes are not where they go.
+static bool GatherDigits(const TCHAR* szGuid, char rgchDigits[32])
+{
+    if (!szGuid || (CCHGuidText != lstrlen(szGuid)))
+        return false;
+    if (('{' != szGuid[0]) || ('-' != szGuid[9]) || ('-' != szGuid[14]) || ('-' != szGuid[19]) ||
+        ('-' != szGuid[24]) || ('}' != szGuid[37]))
+        return false;
+
+    memcpy(rgchDigits, szGuid + 1, 8);
+    memcpy(rgchDigits + 8, szGuid + 10, 4);
+    memcpy(rgchDigits + 12, szGuid + 15, 4);
+    memcpy(rgchDigits + 16, szGuid + 20, 4);
+    memcpy(rgchDigits + 20, szGuid + 25, 12);
+    return true;
+}
+
+// not a GUID: two FNV-1a hashes of the upper-cased text.
+static void HashGuidText(const TCHAR* szText, GUIDKEY* pKey)
+{
+    unsigned __int64 qw1 = 14695981039346656037ULL;
+    unsigned __int64 qw2 = 0x6C62272E07BB0142ULL;
+    for (const TCHAR* pch = (szText) ? szText : TEXT(""); *pch; pch++)
+    {
+        BYTE b = (BYTE) *pch;
+        if (b >= 'a' && b <= 'z')
+            b = (BYTE) (b - 'a' + 'A');
+        qw1 = (qw1 ^ b) * 1099511628211ULL;
+        qw2 = (qw2 ^ b) * 0x100000001B3ULL + 0x9E3779B97F4A7C15ULL;
+    }
+    pKey->rgqw[0] = qw1;
+    pKey->rgqw[1] = qw2;
+}
+
+// 0-15, or 0xFF when ch is not a hex digit.
+static BYTE HexValue(BYTE ch)
+{
+    if (ch >= '0' && ch <= '9')
+        return (BYTE) (ch - '0');
+    ch |= 0x20;
+    if (ch >= 'a' && ch <= 'f')
+        return (BYTE) (ch - 'a' + 10);
+    return 0xFF;
+}
+
+static bool DecodeDigitsScalar(const char rgchDigits[32], BYTE rgb[16])
+{
+    BYTE bBad = 0;
+    for (int ib = 0; ib < 16; ib++)
+    {
+        BYTE bHigh = HexValue((BYTE) rgchDigits[2 * ib]);
+        BYTE bLow = HexValue((BYTE) rgchDigits[2 * ib + 1]);
+        bBad |= (bHigh | bLow) & 0xF0;
+        rgb[ib] = (BYTE) ((bHigh << 4) | bLow);
+    }
+    return (0 == bBad);
+}
+
+#ifdef GUIDKEY_SSE2
+// 16 digits to their values, 0-15 one per byte; *piValid gets a bit per digit that was one.
+static __m128i DecodeHex16(__m128i v, int* piValid)
+{
+    // characters past 0x7F compare as negative and fail both ranges.
+    __m128i fDigit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+    __m128i vLower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    __m128i fLetter = _mm_and_si128(_mm_cmpgt_epi8(vLower, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(vLower, _mm_set1_epi8('f' + 1)));
+
+    __m128i vDigit = _mm_and_si128(fDigit, _mm_sub_epi8(v, _mm_set1_epi8('0')));
+    __m128i vLetter = _mm_and_si128(fLetter, _mm_sub_epi8(vLower, _mm_set1_epi8('a' - 10)));
+    *piValid = _mm_movemask_epi8(_mm_or_si128(fDigit, fLetter));
+    return _mm_or_si128(vDigit, vLetter);
+}
+
+// nibble pairs (high first) to bytes, each in the low half of a 16-bit lane.
+static __m128i JoinNibbles(__m128i v)
+{
+    __m128i vHigh = _mm_slli_epi16(_mm_and_si128(v, _mm_set1_epi16(0x00FF)), 4);
+    return _mm_or_si128(vHigh, _mm_srli_epi16(v, 8));
+}
+
+static bool DecodeDigits(const char rgchDigits[32], BYTE rgb[16])
+{
+    int iValid1, iValid2;
+    __m128i v1 = DecodeHex16(_mm_loadu_si128((const __m128i*) rgchDigits), &iValid1);
+    __m128i v2 = DecodeHex16(_mm_loadu_si128((const __m128i*) (rgchDigits + 16)), &iValid2);
+    _mm_storeu_si128((__m128i*) rgb, _mm_packus_epi16(JoinNibbles(v1), JoinNibbles(v2)));
+    return (0xFFFF == iValid1) && (0xFFFF == iValid2);
+}
+#else
+#define DecodeDigits DecodeDigitsScalar
+#endif
+
+bool MakeGuidKey(const TCHAR* szGuid, GUIDKEY* pKey)
+{
+    char rgchDigits[32];
+    if (GatherDigits(szGuid, rgchDigits) && DecodeDigits(rgchDigits, (BYTE*) pKey->rgqw))
+        return true;
+    HashGuidText(szGuid, pKey);
+    return false;
+}
+
+bool MakeGuidKeyScalar(const TCHAR* szGuid, GUIDKEY* pKey)
+{
+    char rgchDigits[32];
+    if (GatherDigits(szGuid, rgchDigits) && DecodeDigitsScalar(rgchDigits, (BYTE*) pKey->rgqw))
+        return true;
+    HashGuidText(szGuid, pKey);
+    return false;
+}
@@ -0,0 +1,58 @@
+/*---------------------------------------------------------------------------
+GUID keys.
+
+    Product, component and client codes come from the installer as
+    39-character braced strings, and the report matched them with
+    _stricmp: 38 characters case-folded per comparison, in loops that run
+    for every client of every component.  A GUIDKEY is the same code as
+    16 bytes - made once when the code is read, then compared with two
+    64-bit compares and hashed without looking at the text again.
+
+    The bytes are the 32 hex digits in the order they are written, so
+    keys sort (CompareGuidKeys) the way their upper-cased text does.
+    MakeGuidKey decodes all 32 digits at once with SSE2 where the compiler
+    has it, and a digit at a time otherwise; either case is accepted.
+
+    Text that is not a braced GUID still gets a key: a 128-bit hash of it
+    upper-cased, so it matches itself case-insensitively as it did when it
+    was compared with _stricmp.
+---------------------------------------------------------------------------*/
+
+#ifndef GUIDKEY_H
+#define GUIDKEY_H
+
+#include "installerdata.h"
+#include <string.h>
+
+struct GUIDKEY {
+    unsigned __int64 rgqw[2];       // digits 1-16, 17-32 as bytes in text order
+};
+
+// SZPermanentProduct's key.
+extern const GUIDKEY KEYPermanentProduct;
+
+// false - szGuid is not a braced GUID and *pKey is its hash.
+bool MakeGuidKey(const TCHAR* szGuid, GUIDKEY* pKey);
+
+// the digit-at-a-time decoder, for -bench guid.
+bool MakeGuidKeyScalar(const TCHAR* szGuid, GUIDKEY* pKey);
+
+inline bool IsEqualGuidKey(const GUIDKEY& Key1, const GUIDKEY& Key2)
+{
+    return (Key1.rgqw[0] == Key2.rgqw[0]) && (Key1.rgqw[1] == Key2.rgqw[1]);
+}
+
+inline int CompareGuidKeys(const GUIDKEY& Key1, const GUIDKEY& Key2)
+{
+    return memcmp(&Key1, &Key2, sizeof(GUIDKEY));
+}
+
+inline DWORD HashGuidKey(const GUIDKEY& Key)
+{
+    unsigned __int64 qw = (Key.rgqw[0] * 0x9E3779B97F4A7C15ULL) ^ Key.rgqw[1];
+    qw ^= qw >> 29;
+    qw *= 0xBF58476D1CE4E5B9ULL;
+    return (DWORD) (qw >> 32);
+}
+
+#endif // GUIDKEY_H
@@ -0,0 +1,123 @@
+/*---------------------------------------------------------------------------
+GUID set - see guidset.h.
+---------------------------------------------------------------------------*/
+
+#include "guidset.h"
+#include <stdlib.h>
+
+// slot holding Key, or the empty slot where it would go.
+static DWORD FindSlot(const GUIDSET* pSet, const GUIDKEY& Key)
+{
+    DWORD dwMask = pSet->cSlots - 1;
+    DWORD iSlot = HashGuidKey(Key) & dwMask;
+    while (pSet->rgfUsed[iSlot] && !IsEqualGuidKey(pSet->rgKey[iSlot], Key))
+        iSlot = (iSlot + 1) & dwMask;
+    return iSlot;
+}
+
+bool InitGuidSet(GUIDSET* pSet, DWORD cExpected)
+{
+    DWORD cSlots = 16;
+    while (cSlots < cExpected * 2)
+        cSlots *= 2;
+
+    pSet->rgKey = (GUIDKEY*) malloc(cSlots * sizeof(GUIDKEY));
+    pSet->rgfUsed = (BYTE*) calloc(cSlots, sizeof(BYTE));
+    pSet->cEntries = 0;
+    if (!pSet->rgKey || !pSet->rgfUsed)
+    {
+        FreeGuidSet(pSet);
+        return false;
+    }
+    pSet->cSlots = cSlots;
+    return true;
+}
+
+void FreeGuidSet(GUIDSET* pSet)
+{
+    free(pSet->rgKey);
+    free(pSet->rgfUsed);
+    pSet->rgKey = NULL;
+    pSet->rgfUsed = NULL;
+    pSet->cSlots = 0;
+    pSet->cEntries = 0;
+}
+
+static bool RehashGuidSet(GUIDSET* pSet)
+{
+    GUIDSET NewSet;
+    if (!InitGuidSet(&NewSet, pSet->cSlots))
+        return false;
+
+    for (DWORD iSlot = 0; iSlot < pSet->cSlots; iSlot++)
+    {
+        if (pSet->rgfUsed[iSlot])
+        {
+            DWORD iNewSlot = FindSlot(&NewSet, pSet->rgKey[iSlot]);
+            NewSet.rgKey[iNewSlot] = pSet->rgKey[iSlot];
+            NewSet.rgfUsed[iNewSlot] = 1;
+            NewSet.cEntries++;
+        }
+    }
+
+    FreeGuidSet(pSet);
+    *pSet = NewSet;
+    return true;
+}
+
+bool AddToGuidSet(GUIDSET* pSet, const TCHAR* szGuid)
+{
+    GUIDKEY Key;
+    MakeGuidKey(szGuid, &Key);
+    return AddGuidKeyToSet(pSet, Key);
+}
+
+bool AddGuidKeyToSet(GUIDSET* pSet, const GUIDKEY& Key)
+{
+    if (((pSet->cEntries + 1) * 2 > pSet->cSlots) && !RehashGuidSet(pSet))
+        return false;
+
+    DWORD iSlot = FindSlot(pSet, Key);
+    if (!pSet->rgfUsed[iSlot])
+    {
+        pSet->rgKey[iSlot] = Key;
+        pSet->rgfUsed[iSlot] = 1;
+        pSet->cEntries++;
+    }
+    return true;
+}
+
+bool IsInGuidSet(const GUIDSET* pSet, const TCHAR* szGuid)
+{
+    if (!pSet->cSlots || !szGuid[0])
+        return false;
+
+    GUIDKEY Key;
+    MakeGuidKey(szGuid, &Key);
+    return IsGuidKeyInSet(pSet, Key);
+}
+
+bool IsGuidKeyInSet(const GUIDSET* pSet, const GUIDKEY& Key)
+{
+    if (!pSet->cSlots)
+        return false;
+    return (0 != pSet->rgfUsed[FindSlot(pSet, Key)]);
+}
+
+UINT LoadProductSet(CInstallerData* pInstallerData, GUIDSET* pSet)
+{
+    if (!InitGuidSet(pSet, 256))
+        return ERROR_NOT_ENOUGH_MEMORY;
+
+    DWORD iProductIndex = 0;
+    TCHAR szProduct[CCHGuid] = TEXT("");
+    while (ERROR_SUCCESS == pInstallerData->EnumProducts(iProductIndex++, szProduct))
+    {
+        if (!AddToGuidSet(pSet, szProduct))
+        {
+            FreeGuidSet(pSet);
+            return ERROR_NOT_ENOUGH_MEMORY;
+        }
+    }
+    return ERROR_SUCCESS;
+}
@@ -0,0 +1,34 @@
+/*---------------------------------------------------------------------------
+GUID set.
+
+    Open-addressing (linear probe) hash set of product/component codes.
+    Codes are stored as GUIDKEYs (guidkey.h), so lookups are
+    case-insensitive like the _stricmp comparisons they replace, and a
+    caller that already has the key skips making it again.  The table is
+    kept at most half full; it never shrinks or deletes.
+---------------------------------------------------------------------------*/
+
+#ifndef GUIDSET_H
+#define GUIDSET_H
+
+#include "installerdata.h"
+#include "guidkey.h"
+
+struct GUIDSET {
+    DWORD   cSlots;                 // power of two
+    DWORD   cEntries;
+    GUIDKEY* rgKey;
+    BYTE*    rgfUsed;               // 0 marks an empty slot
+};
+
+bool InitGuidSet(GUIDSET* pSet, DWORD cExpected);
+void FreeGuidSet(GUIDSET* pSet);
+bool AddToGuidSet(GUIDSET* pSet, const TCHAR* szGuid);
+bool AddGuidKeyToSet(GUIDSET* pSet, const GUIDKEY& Key);
+bool IsInGuidSet(const GUIDSET* pSet, const TCHAR* szGuid);
+bool IsGuidKeyInSet(const GUIDSET* pSet, const GUIDKEY& Key);
+
+// every product MsiEnumProducts returns, loaded once.
+UINT LoadProductSet(CInstallerData* pInstallerData, GUIDSET* pSet);
+
+#endif // GUIDSET_H
@@ -0,0 +1,181 @@
+/*---------------------------------------------------------------------------
+Installer string queries - see infoquery.h.
+---------------------------------------------------------------------------*/
+
+#include "infoquery.h"
+
+const DWORD CCHFirstTry = 512;
+const DWORD CCHLargestValue = 16 * 1024 * 1024;  // past this a length is not believed
+const int CMaxRetries = 4;                      // a value can grow between the calls
+
+// starts on the stack; re-made in the arena at the length the installer asks for.
+struct QUERYBUFFER {
+    TCHAR   rgchStack[CCHFirstTry];
+    TCHAR*  pch;
+    DWORD   cchBuffer;
+    DWORD   cch;        // in/out, as the call takes it
+};
+
+static void InitQueryBuffer(QUERYBUFFER* pBuffer)
+{
+    pBuffer->pch = pBuffer->rgchStack;
+    pBuffer->cchBuffer = CCHFirstTry;
+}
+
+// before each call.
+static void ClearQueryBuffer(QUERYBUFFER* pBuffer)
+{
+    *pBuffer->pch = 0;
+    pBuffer->cch = pBuffer->cchBuffer;
+}
+
+// after the call said more data: room for the length it reported, or twice the
+// room when it reported nothing useful.  false - it has all the room it needs,
+// or there is no more to be had.
+static bool GrowQueryBuffer(QUERYBUFFER* pBuffer, CStringArena* pArena, bool fDouble)
+{
+    DWORD cchNeeded = pBuffer->cch + 1;
+    if (cchNeeded <= pBuffer->cchBuffer)
+    {
+        if (!fDouble)
+            return false;
+        cchNeeded = 2 * pBuffer->cchBuffer;
+    }
+    if (cchNeeded > CCHLargestValue)
+        return false;
+
+    TCHAR* pch = pArena->Alloc(cchNeeded);
+    if (!pch)
+        return false;
+    pBuffer->pch = pch;
+    pBuffer->cchBuffer = cchNeeded;
+    return true;
+}
+
+// the answer, in the arena.
+static const TCHAR* QueryResult(QUERYBUFFER* pBuffer, CStringArena* pArena, bool fAnswered)
+{
+    if (!fAnswered)
+        return TEXT("");
+    if (pBuffer->pch != pBuffer->rgchStack)
+        return pBuffer->pch;
+    return pArena->Copy(pBuffer->pch, lstrlen(pBuffer->pch));
+}
+
+UINT QueryProductInfo(CInstallerData* pInstallerData, const TCHAR* szProduct, const TCHAR* szAttribute,
+                      CStringArena* pArena, const TCHAR** pszValue)
+{
+    QUERYBUFFER Value;
+    InitQueryBuffer(&Value);
+
+    UINT uiResult;
+    for (int iTry = 0; ; iTry++)
+    {
+        ClearQueryBuffer(&Value);
+        uiResult = pInstallerData->GetProductInfo(szProduct, szAttribute, Value.pch, &Value.cch);
+        if ((ERROR_MORE_DATA != uiResult) || (iTry == CMaxRetries) || !GrowQueryBuffer(&Value, pArena, true))
+            break;
+    }
+
+    *pszValue = QueryResult(&Value, pArena, ERROR_SUCCESS == uiResult);
+    return uiResult;
+}
+
+USERINFOSTATE QueryUserInfo(CInstallerData* pInstallerData, const TCHAR* szProduct, CStringArena* pArena,
+                            const TCHAR** pszUserName, const TCHAR** pszOrgName, const TCHAR** pszSerial)
+{
+    QUERYBUFFER UserName, OrgName, Serial;
+    InitQueryBuffer(&UserName);
+    InitQueryBuffer(&OrgName);
+    InitQueryBuffer(&Serial);
+
+    USERINFOSTATE uisResult;
+    for (int iTry = 0; ; iTry++)
+    {
+        ClearQueryBuffer(&UserName);
+        ClearQueryBuffer(&OrgName);
+        ClearQueryBuffer(&Serial);
+        uisResult = pInstallerData->GetUserInfo(szProduct, UserName.pch, &UserName.cch, OrgName.pch, &OrgName.cch, Serial.pch, &Serial.cch);
+        if ((USERINFOSTATE_MOREDATA != uisResult) || (iTry == CMaxRetries))
+            break;
+
+        // whichever did not fit; all of them when none says so.
+        bool fGrown = GrowQueryBuffer(&UserName, pArena, false);
+        fGrown = GrowQueryBuffer(&OrgName, pArena, false) || fGrown;
+        fGrown = GrowQueryBuffer(&Serial, pArena, false) || fGrown;
+        if (!fGrown && !(GrowQueryBuffer(&UserName, pArena, true) && GrowQueryBuffer(&OrgName, pArena, true) && GrowQueryBuffer(&Serial, pArena, true)))
+            break;
+    }
+
+    bool fAnswered = (USERINFOSTATE_MOREDATA != uisResult);
+    *pszUserName = QueryResult(&UserName, pArena, fAnswered);
+    *pszOrgName = QueryResult(&OrgName, pArena, fAnswered);
+    *pszSerial = QueryResult(&Serial, pArena, fAnswered);
+    return uisResult;
+}
+
+INSTALLSTATE QueryComponentPath(CInstallerData* pInstallerData, const TCHAR* szProduct, const TCHAR* szComponent,
+                                CStringArena* pArena, const TCHAR** pszPath)
+{
+    QUERYBUFFER Path;
+    InitQueryBuffer(&Path);
+
+    INSTALLSTATE isResult;
+    for (int iTry = 0; ; iTry++)
+    {
+        ClearQueryBuffer(&Path);
+        isResult = pInstallerData->GetComponentPath(szProduct, szComponent, Path.pch, &Path.cch);
+        if ((INSTALLSTATE_MOREDATA != isResult) || (iTry == CMaxRetries) || !GrowQueryBuffer(&Path, pArena, true))
+            break;
+    }
+
+    // every other state leaves whatever path there is.
+    *pszPath = QueryResult(&Path, pArena, INSTALLSTATE_MOREDATA != isResult);
+    return isResult;
+}
+
+UINT QueryComponentQualifier(CInstallerData* pInstallerData, const TCHAR* szComponent, DWORD iIndex,
+                             CStringArena* pArena, const TCHAR** pszQualifier, const TCHAR** pszApplicationData)
+{
+    QUERYBUFFER Qualifier, ApplicationData;
+    InitQueryBuffer(&Qualifier);
+    InitQueryBuffer(&ApplicationData);
+
+    UINT uiResult;
+    for (int iTry = 0; ; iTry++)
+    {
+        ClearQueryBuffer(&Qualifier);
+        ClearQueryBuffer(&ApplicationData);
+        uiResult = pInstallerData->EnumComponentQualifiers(szComponent, iIndex, Qualifier.pch, &Qualifier.cch, ApplicationData.pch, &ApplicationData.cch);
+        if ((ERROR_MORE_DATA != uiResult) || (iTry == CMaxRetries))
+            break;
+
+        bool fGrown = GrowQueryBuffer(&Qualifier, pArena, false);
+        fGrown = GrowQueryBuffer(&ApplicationData, pArena, false) || fGrown;
+        if (!fGrown && !(GrowQueryBuffer(&Qualifier, pArena, true) && GrowQueryBuffer(&ApplicationData, pArena, true)))
+            break;
+    }
+
+    *pszQualifier = QueryResult(&Qualifier, pArena, ERROR_SUCCESS == uiResult);
+    *pszApplicationData = QueryResult(&ApplicationData, pArena, ERROR_SUCCESS == uiResult);
+    return uiResult;
+}
+
+UINT QueryPatch(CInstallerData* pInstallerData, const TCHAR* szProduct, DWORD iPatchIndex, TCHAR* lpPatchBuf,
+                CStringArena* pArena, const TCHAR** pszTransforms)
+{
+    QUERYBUFFER Transforms;
+    InitQueryBuffer(&Transforms);
+
+    UINT uiResult;
+    for (int iTry = 0; ; iTry++)
+    {
+        ClearQueryBuffer(&Transforms);
+        uiResult = pInstallerData->EnumPatches(szProduct, iPatchIndex, lpPatchBuf, Transforms.pch, &Transforms.cch);
+        if ((ERROR_MORE_DATA != uiResult) || (iTry == CMaxRetries) || !GrowQueryBuffer(&Transforms, pArena, true))
+            break;
+    }
+
+    *pszTransforms = QueryResult(&Transforms, pArena, ERROR_SUCCESS == uiResult);
+    return uiResult;
+}
@@ -0,0 +1,43 @@
+/*---------------------------------------------------------------------------
+Installer string queries.
+
+    The Msi* calls that return strings fail with ERROR_MORE_DATA (or
+    INSTALLSTATE_MOREDATA, USERINFOSTATE_MOREDATA) when the caller's buffer
+    is too small and say how long the value is.  The report used to ask
+    with fixed 1024-character buffers, so a longer value came back cut
+    short with an error.  These ask with a stack buffer that holds nearly
+    every value, and when it does not, ask again with one of exactly the
+    length reported.  Results are copied into a CStringArena (strarena.h)
+    at their own length and stay valid until it is reset.
+
+    Each returns what the call it wraps returned; on failure the strings
+    are "".
+---------------------------------------------------------------------------*/
+
+#ifndef INFOQUERY_H
+#define INFOQUERY_H
+
+#include "installerdata.h"
+#include "strarena.h"
+
+// MsiGetProductInfo
+UINT          QueryProductInfo(CInstallerData* pInstallerData, const TCHAR* szProduct, const TCHAR* szAttribute,
+                               CStringArena* pArena, const TCHAR** pszValue);
+
+// MsiGetUserInfo
+USERINFOSTATE QueryUserInfo(CInstallerData* pInstallerData, const TCHAR* szProduct, CStringArena* pArena,
+                            const TCHAR** pszUserName, const TCHAR** pszOrgName, const TCHAR** pszSerial);
+
+// MsiGetComponentPath
+INSTALLSTATE  QueryComponentPath(CInstallerData* pInstallerData, const TCHAR* szProduct, const TCHAR* szComponent,
+                                 CStringArena* pArena, const TCHAR** pszPath);
+
+// MsiEnumComponentQualifiers
+UINT          QueryComponentQualifier(CInstallerData* pInstallerData, const TCHAR* szComponent, DWORD iIndex,
+                                      CStringArena* pArena, const TCHAR** pszQualifier, const TCHAR** pszApplicationData);
+
+// MsiEnumPatches; lpPatchBuf is CCHGuid long, as it always is.
+UINT          QueryPatch(CInstallerData* pInstallerData, const TCHAR* szProduct, DWORD iPatchIndex, TCHAR* lpPatchBuf,
+                         CStringArena* pArena, const TCHAR** pszTransforms);
+
+#endif // INFOQUERY_H
@@ -0,0 +1,608 @@
+/*---------------------------------------------------------------------------
+Installer data providers - see installerdata.h.
+---------------------------------------------------------------------------*/
+
+#include "installerdata.h"
+#include "dircache.h"
+#include "regkeys.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+const TCHAR SZPermanentProduct[CCHGuid] = TEXT("{00000000-0000-0000-0000-000000000000}");
+
+const TCHAR* const SZInventoryProperty[CInventoryProperties] =
+    {
+        INSTALLPROPERTY_PRODUCTNAME,
+        INSTALLPROPERTY_INSTALLEDPRODUCTNAME,
+        INSTALLPROPERTY_VERSIONSTRING,
+        INSTALLPROPERTY_VERSION,
+        INSTALLPROPERTY_ASSIGNMENTTYPE,
+        INSTALLPROPERTY_PACKAGECODE,
+        INSTALLPROPERTY_PUBLISHER,
+        INSTALLPROPERTY_LANGUAGE,
+        INSTALLPROPERTY_PRODUCTID,
+        INSTALLPROPERTY_INSTALLLOCATION,
+        INSTALLPROPERTY_INSTALLSOURCE,
+        INSTALLPROPERTY_PACKAGENAME,
+        INSTALLPROPERTY_PRODUCTICON,
+        INSTALLPROPERTY_INSTALLDATE,
+        INSTALLPROPERTY_URLINFOABOUT,
+        INSTALLPROPERTY_HELPLINK,
+        INSTALLPROPERTY_HELPTELEPHONE,
+        INSTALLPROPERTY_URLUPDATEINFO,
+        INSTALLPROPERTY_TRANSFORMS,
+        INSTALLPROPERTY_LOCALPACKAGE,
+        TEXT("InstanceType"),
+    };
+
+void CanonicalGuid(TCHAR* szDest, const TCHAR* szSource)
+{
+    int ich = 0;
+    for (; ich < CCHGuid - 1 && szSource[ich]; ich++)
+    {
+        TCHAR ch = szSource[ich];
+        szDest[ich] = (ch >= 'a' && ch <= 'z') ? (TCHAR) (ch - 'a' + 'A') : ch;
+    }
+    szDest[ich] = 0;
+}
+
+UINT CopyInstallerString(const TCHAR* szValue, TCHAR* lpBuf, DWORD* pcchBuf)
+{
+    DWORD cchValue = lstrlen(szValue);
+
+    if (NULL == lpBuf)
+    {
+        if (pcchBuf)
+            *pcchBuf = cchValue;
+        return ERROR_SUCCESS;
+    }
+
+    if (NULL == pcchBuf)
+        return ERROR_INVALID_PARAMETER;
+
+    if (cchValue >= *pcchBuf)
+    {
+        if (*pcchBuf)
+        {
+            memcpy(lpBuf, szValue, (*pcchBuf - 1) * sizeof(TCHAR));
+            lpBuf[*pcchBuf - 1] = 0;
+        }
+        *pcchBuf = cchValue;
+        return ERROR_MORE_DATA;
+    }
+
+    memcpy(lpBuf, szValue, (cchValue + 1) * sizeof(TCHAR));
+    *pcchBuf = cchValue;
+    return ERROR_SUCCESS;
+}
+
+//____________________________________________________________________________
+//
+// CLiveInstallerData - straight through to msi.dll
+//____________________________________________________________________________
+
+#ifdef _WIN32
+
+CLiveInstallerData::CLiveInstallerData()
+{
+    m_pRegistryKeys = new CRegistryKeyCache(new CLiveRegistry);
+    m_pDirectories = new CDirectoryCache;
+}
+
+CLiveInstallerData::~CLiveInstallerData()
+{
+    delete m_pRegistryKeys;
+    delete m_pDirectories;
+}
+
+UINT CLiveInstallerData::EnumProducts(DWORD iProductIndex, TCHAR* lpProductBuf)
+{
+    return MsiEnumProducts(iProductIndex, lpProductBuf);
+}
+
+INSTALLSTATE CLiveInstallerData::QueryProductState(const TCHAR* szProduct)
+{
+    return MsiQueryProductState(szProduct);
+}
+
+UINT CLiveInstallerData::GetProductInfo(const TCHAR* szProduct, const TCHAR* szAttribute, TCHAR* lpValueBuf, DWORD* pcchValueBuf)
+{
+    return MsiGetProductInfo(szProduct, szAttribute, lpValueBuf, pcchValueBuf);
+}
+
+USERINFOSTATE CLiveInstallerData::GetUserInfo(const TCHAR* szProduct, TCHAR* lpUserNameBuf, DWORD* pcchUserNameBuf,
+                                              TCHAR* lpOrgNameBuf, DWORD* pcchOrgNameBuf, TCHAR* lpSerialBuf, DWORD* pcchSerialBuf)
+{
+    return MsiGetUserInfo(szProduct, lpUserNameBuf, pcchUserNameBuf, lpOrgNameBuf, pcchOrgNameBuf, lpSerialBuf, pcchSerialBuf);
+}
+
+UINT CLiveInstallerData::EnumFeatures(const TCHAR* szProduct, DWORD iFeatureIndex, TCHAR* lpFeatureBuf, TCHAR* lpParentBuf)
+{
+    return MsiEnumFeatures(szProduct, iFeatureIndex, lpFeatureBuf, lpParentBuf);
+}
+
+INSTALLSTATE CLiveInstallerData::QueryFeatureState(const TCHAR* szProduct, const TCHAR* szFeature)
+{
+    return MsiQueryFeatureState(szProduct, szFeature);
+}
+
+UINT CLiveInstallerData::GetFeatureUsage(const TCHAR* szProduct, const TCHAR* szFeature, DWORD* pdwUseCount, WORD* pwDateUsed)
+{
+    return MsiGetFeatureUsage(szProduct, szFeature, pdwUseCount, pwDateUsed);
+}
+
+UINT CLiveInstallerData::EnumComponents(DWORD iComponentIndex, TCHAR* lpComponentBuf)
+{
+    return MsiEnumComponents(iComponentIndex, lpComponentBuf);
+}
+
+UINT CLiveInstallerData::EnumClients(const TCHAR* szComponent, DWORD iProductIndex, TCHAR* lpProductBuf)
+{
+    return MsiEnumClients(szComponent, iProductIndex, lpProductBuf);
+}
+
+INSTALLSTATE CLiveInstallerData::GetComponentPath(const TCHAR* szProduct, const TCHAR* szComponent, TCHAR* lpPathBuf, DWORD* pcchBuf)
+{
+    return MsiGetComponentPath(szProduct, szComponent, lpPathBuf, pcchBuf);
+}
+
+UINT CLiveInstallerData::EnumComponentQualifiers(const TCHAR* szComponent, DWORD iIndex, TCHAR* lpQualifierBuf, DWORD* pcchQualifierBuf,
+                                                 TCHAR* lpApplicationDataBuf, DWORD* pcchApplicationDataBuf)
+{
+    return MsiEnumComponentQualifiers(szComponent, iIndex, lpQualifierBuf, pcchQualifierBuf, lpApplicationDataBuf, pcchApplicationDataBuf);
+}
+
+UINT CLiveInstallerData::EnumPatches(const TCHAR* szProduct, DWORD iPatchIndex, TCHAR* lpPatchBuf, TCHAR* lpTransformsBuf, DWORD* pcchTransformsBuf)
+{
+    return MsiEnumPatches(szProduct, iPatchIndex, lpPatchBuf, lpTransformsBuf, pcchTransformsBuf);
+}
+
+void CLiveInstallerData::ProbeKeyPath(const TCHAR* szKeyPath, KEYPATHPROBE* pProbe)
+{
+    if (szKeyPath && IsRegistryKeyPath(szKeyPath) && m_pRegistryKeys)
+        m_pRegistryKeys->ProbeKeyPath(szKeyPath, pProbe);
+    else
+        ProbeKeyPathLive(szKeyPath, pProbe, m_pDirectories);
+}
+
+#endif // _WIN32
+
+//____________________________________________________________________________
+//
+// CSyntheticInstallerData
+//
+//    Every answer is computed from the product/component ordinal encoded in
+//    the GUID, so there is nothing to store and any call is O(1).  The mix
+//    is chosen so each report section has something to say:
+//        every 10th component (from 3) is shared by several products,
+//        every 25th component (from 11) is also owned by the permanent product,
+//        every 50th component (from 7) belongs to a product that is not installed,
+//        every 40th component (from 5) has a registry keypath,
+//        every 17th product (from 9) is only advertised,
+//        every 4th component (from 2) is qualified.
+//    Patches and qualifiers are only generated when asked for, and a
+//    keypath probe only takes time when given a latency.
+//____________________________________________________________________________
+
+const DWORD iSyntheticNotAClient = 0xFFFFFFFF;
+const DWORD iSyntheticPermanent  = 0xFFFFFFFE;
+
+static const TCHAR szSyntheticProductTail[]   = TEXT("-5959-4000-8000-000000000001}");
+static const TCHAR szSyntheticComponentTail[] = TEXT("-5959-4000-8000-000000000002}");
+static const TCHAR szSyntheticPackageTail[]   = TEXT("-5959-4000-8000-000000000003}");
+static const TCHAR szSyntheticPatchTail[]     = TEXT("-5959-4000-8000-000000000004}");
+
+static void FormatSyntheticGuid(TCHAR* szGuid, DWORD iOrdinal, const TCHAR* szTail)
+{
+    sprintf(szGuid, TEXT("{%08X%s"), iOrdinal, szTail);
+}
+
+static bool ParseSyntheticGuid(const TCHAR* szGuid, const TCHAR* szTail, DWORD* piOrdinal)
+{
+    if (!szGuid || '{' != szGuid[0])
+        return false;
+
+    DWORD iOrdinal = 0;
+    for (int ich = 1; ich <= 8; ich++)
+    {
+        TCHAR ch = szGuid[ich];
+        if (ch >= '0' && ch <= '9')
+            iOrdinal = (iOrdinal << 4) | (ch - '0');
+        else if (ch >= 'A' && ch <= 'F')
+            iOrdinal = (iOrdinal << 4) | (ch - 'A' + 10);
+        else if (ch >= 'a' && ch <= 'f')
+            iOrdinal = (iOrdinal << 4) | (ch - 'a' + 10);
+        else
+            return false;
+    }
+
+    if (0 != _stricmp(szGuid + 9, szTail))
+        return false;
+
+    *piOrdinal = iOrdinal;
+    return true;
+}
+
+bool ParseSyntheticConfig(const TCHAR* szSpec, SYNTHETICCONFIG* pConfig)
+{
+    pConfig->cProducts = 100;
+    pConfig->cComponents = 10000;
+    pConfig->cClientsPerComponent = 2;
+    pConfig->cFeaturesPerProduct = 8;
+    pConfig->cPatchesPerProduct = 0;
+    pConfig->cQualifiersPerComponent = 0;
+    pConfig->dwKeyPathLatency = 0;
+
+    const TCHAR* pch = szSpec;
+    while (pch && *pch)
+    {
+        const TCHAR* pchEquals = strchr(pch, '=');
+        if (!pchEquals)
+            return false;
+
+        char* pchEnd = NULL;
+        unsigned long ulValue = strtoul(pchEquals + 1, &pchEnd, 10);
+        if (pchEnd == pchEquals + 1 || (*pchEnd && ',' != *pchEnd))
+            return false;
+
+        int cchKey = (int) (pchEquals - pch);
+        if (8 == cchKey && 0 == _strnicmp(pch, TEXT("products"), cchKey))
+            pConfig->cProducts = ulValue;
+        else if (10 == cchKey && 0 == _strnicmp(pch, TEXT("components"), cchKey))
+            pConfig->cComponents = ulValue;
+        else if (7 == cchKey && 0 == _strnicmp(pch, TEXT("clients"), cchKey))
+            pConfig->cClientsPerComponent = ulValue;
+        else if (8 == cchKey && 0 == _strnicmp(pch, TEXT("features"), cchKey))
+            pConfig->cFeaturesPerProduct = ulValue;
+        else if (7 == cchKey && 0 == _strnicmp(pch, TEXT("patches"), cchKey))
+            pConfig->cPatchesPerProduct = ulValue;
+        else if (10 == cchKey && 0 == _strnicmp(pch, TEXT("qualifiers"), cchKey))
+            pConfig->cQualifiersPerComponent = ulValue;
+        else if (7 == cchKey && 0 == _strnicmp(pch, TEXT("latency"), cchKey))
+            pConfig->dwKeyPathLatency = ulValue;
+        else
+            return false;
+
+        pch = (*pchEnd) ? pchEnd + 1 : pchEnd;
+    }
+
+    if (pConfig->cClientsPerComponent < 1)
+        pConfig->cClientsPerComponent = 1;
+
+    return true;
+}
+
+CSyntheticInstallerData::CSyntheticInstallerData(const SYNTHETICCONFIG& config)
+    : m_config(config)
+{
+}
+
+DWORD CSyntheticInstallerData::ClientCount(DWORD iComponent)
+{
+    DWORD cClients = 1;
+    if (3 == iComponent % 10 && m_config.cProducts > 1)
+        cClients += m_config.cClientsPerComponent - 1;
+    if (11 == iComponent % 25)
+        cClients++;
+    return cClients;
+}
+
+DWORD CSyntheticInstallerData::ClientOfComponent(DWORD iComponent, DWORD iClient)
+{
+    DWORD cClients = ClientCount(iComponent);
+    if (iClient >= cClients)
+        return iSyntheticNotAClient;
+
+    if (11 == iComponent % 25 && iClient == cClients - 1)
+        return iSyntheticPermanent;
+
+    // products beyond cProducts are never enumerated, so they show up as orphans.
+    if (0 == m_config.cProducts || 7 == iComponent % 50)
+        return m_config.cProducts + (iComponent % 13);
+
+    DWORD iOwner = iComponent % m_config.cProducts;
+    if (0 == iClient)
+        return iOwner;
+
+    return (iOwner + iClient * 37) % m_config.cProducts;
+}
+
+UINT CSyntheticInstallerData::EnumProducts(DWORD iProductIndex, TCHAR* lpProductBuf)
+{
+    if (iProductIndex >= m_config.cProducts)
+        return ERROR_NO_MORE_ITEMS;
+
+    FormatSyntheticGuid(lpProductBuf, iProductIndex, szSyntheticProductTail);
+    return ERROR_SUCCESS;
+}
+
+INSTALLSTATE CSyntheticInstallerData::QueryProductState(const TCHAR* szProduct)
+{
+    DWORD iProduct = 0;
+    if (!ParseSyntheticGuid(szProduct, szSyntheticProductTail, &iProduct) || iProduct >= m_config.cProducts)
+        return INSTALLSTATE_UNKNOWN;
+
+    return (9 == iProduct % 17) ? INSTALLSTATE_ADVERTISED : INSTALLSTATE_DEFAULT;
+}
+
+UINT CSyntheticInstallerData::GetProductInfo(const TCHAR* szProduct, const TCHAR* szAttribute, TCHAR* lpValueBuf, DWORD* pcchValueBuf)
+{
+    DWORD iProduct = 0;
+    if (!ParseSyntheticGuid(szProduct, szSyntheticProductTail, &iProduct) || iProduct >= m_config.cProducts)
+        return ERROR_UNKNOWN_PRODUCT;
+
+    TCHAR szValue[MAX_PATH] = TEXT("");
+
+    if (0 == lstrcmpi(szAttribute, INSTALLPROPERTY_PRODUCTNAME))
+        sprintf(szValue, TEXT("Synthetic Product %u"), iProduct);
+    else if (0 == lstrcmpi(szAttribute, INSTALLPROPERTY_VERSIONSTRING))
+        sprintf(szValue, TEXT("1.%u.%u"), iProduct % 10, iProduct);
+    else if (0 == lstrcmpi(szAttribute, INSTALLPROPERTY_PUBLISHER))
+        sprintf(szValue, TEXT("Synthetic Publisher %u"), iProduct % 7);
+    else if (0 == lstrcmpi(szAttribute, INSTALLPROPERTY_LANGUAGE))
+        sprintf(szValue, TEXT("1033"));
+    else if (0 == lstrcmpi(szAttribute, INSTALLPROPERTY_PACKAGECODE))
+        FormatSyntheticGuid(szValue, iProduct, szSyntheticPackageTail);
+    else if (0 == lstrcmpi(szAttribute, INSTALLPROPERTY_INSTALLLOCATION))
+        sprintf(szValue, TEXT("C:\\Program Files\\Synthetic\\Product %u\\"), iProduct);
+    else if (0 == lstrcmpi(szAttribute, INSTALLPROPERTY_INSTALLSOURCE))
+        sprintf(szValue, TEXT("\\\\build\\drops\\product%u\\"), iProduct);
+    else if (0 == lstrcmpi(szAttribute, INSTALLPROPERTY_PACKAGENAME))
+        sprintf(szValue, TEXT("product%u.msi"), iProduct);
+    else if (0 == lstrcmpi(szAttribute, INSTALLPROPERTY_ASSIGNMENTTYPE))
+        sprintf(szValue, TEXT("%u"), (0 == iProduct % 3) ? 0 : 1);
+    else if (0 == lstrcmpi(szAttribute, INSTALLPROPERTY_LOCALPACKAGE))
+        sprintf(szValue, TEXT("C:\\WINDOWS\\Installer\\%x.msi"), 0x1000 + iProduct);
+    else if (0 == lstrcmpi(szAttribute, INSTALLPROPERTY_INSTALLDATE))
+        sprintf(szValue, TEXT("2005%02u%02u"), 1 + iProduct % 12, 1 + iProduct % 28);
+    else if (0 == lstrcmpi(szAttribute, TEXT("InstanceType")))
+        sprintf(szValue, TEXT("0"));
+    else if (0 == lstrcmpi(szAttribute, INSTALLPROPERTY_URLINFOABOUT))
+    {
+        if (0 == iProduct % 2)
+            sprintf(szValue, TEXT("http://synthetic.example/product%u"), iProduct);
+    }
+    else if ((0 != lstrcmpi(szAttribute, INSTALLPROPERTY_PRODUCTICON)) &&
+             (0 != lstrcmpi(szAttribute, INSTALLPROPERTY_HELPLINK)) &&
+             (0 != lstrcmpi(szAttribute, INSTALLPROPERTY_HELPTELEPHONE)) &&
+             (0 != lstrcmpi(szAttribute, INSTALLPROPERTY_URLUPDATEINFO)) &&
+             (0 != lstrcmpi(szAttribute, INSTALLPROPERTY_TRANSFORMS)))
+    {
+        return ERROR_UNKNOWN_PROPERTY;
+    }
+
+    return CopyInstallerString(szValue, lpValueBuf, pcchValueBuf);
+}
+
+USERINFOSTATE CSyntheticInstallerData::GetUserInfo(const TCHAR* szProduct, TCHAR* lpUserNameBuf, DWORD* pcchUserNameBuf,
+                                                   TCHAR* lpOrgNameBuf, DWORD* pcchOrgNameBuf, TCHAR* lpSerialBuf, DWORD* pcchSerialBuf)
+{
+    DWORD iProduct = 0;
+    if (!ParseSyntheticGuid(szProduct, szSyntheticProductTail, &iProduct) || iProduct >= m_config.cProducts)
+        return USERINFOSTATE_UNKNOWN;
+
+    TCHAR szValue[64];
+    bool fMoreData = false;
+
+    sprintf(szValue, TEXT("User %u"), iProduct % 5);
+    fMoreData |= (ERROR_MORE_DATA == CopyInstallerString(szValue, lpUserNameBuf, pcchUserNameBuf));
+    fMoreData |= (ERROR_MORE_DATA == CopyInstallerString(TEXT("Synthetic Org"), lpOrgNameBuf, pcchOrgNameBuf));
+    sprintf(szValue, TEXT("SN-%05u"), iProduct);
+    fMoreData |= (ERROR_MORE_DATA == CopyInstallerString(szValue, lpSerialBuf, pcchSerialBuf));
+
+    return fMoreData ? USERINFOSTATE_MOREDATA : USERINFOSTATE_PRESENT;
+}
+
+UINT CSyntheticInstallerData::EnumFeatures(const TCHAR* szProduct, DWORD iFeatureIndex, TCHAR* lpFeatureBuf, TCHAR* lpParentBuf)
+{
+    DWORD iProduct = 0;
+    if (!ParseSyntheticGuid(szProduct, szSyntheticProductTail, &iProduct) || iProduct >= m_config.cProducts)
+        return ERROR_UNKNOWN_PRODUCT;
+
+    if (iFeatureIndex >= m_config.cFeaturesPerProduct)
+        return ERROR_NO_MORE_ITEMS;
+
+    sprintf(lpFeatureBuf, TEXT("Feature%u"), iFeatureIndex);
+    if (0 == iFeatureIndex)
+        *lpParentBuf = 0;
+    else
+        sprintf(lpParentBuf, TEXT("Feature%u"), (iFeatureIndex - 1) / 2);
+
+    return ERROR_SUCCESS;
+}
+
+INSTALLSTATE CSyntheticInstallerData::QueryFeatureState(const TCHAR* szProduct, const TCHAR* szFeature)
+{
+    DWORD iProduct = 0;
+    DWORD iFeature = 0;
+    if (!ParseSyntheticGuid(szProduct, szSyntheticProductTail, &iProduct) || iProduct >= m_config.cProducts)
+        return INSTALLSTATE_UNKNOWN;
+    if (1 != sscanf(szFeature, TEXT("Feature%u"), &iFeature) || iFeature >= m_config.cFeaturesPerProduct)
+        return INSTALLSTATE_UNKNOWN;
+
+    static const INSTALLSTATE rgisFeature[] =
+        { INSTALLSTATE_LOCAL, INSTALLSTATE_LOCAL, INSTALLSTATE_ABSENT, INSTALLSTATE_ADVERTISED, INSTALLSTATE_SOURCE };
+    return rgisFeature[(iProduct + iFeature) % (sizeof(rgisFeature) / sizeof(rgisFeature[0]))];
+}
+
+UINT CSyntheticInstallerData::GetFeatureUsage(const TCHAR* szProduct, const TCHAR* szFeature, DWORD* pdwUseCount, WORD* pwDateUsed)
+{
+    DWORD iProduct = 0;
+    DWORD iFeature = 0;
+    if (!ParseSyntheticGuid(szProduct, szSyntheticProductTail, &iProduct) || iProduct >= m_config.cProducts)
+        return ERROR_UNKNOWN_PRODUCT;
+    if (1 != sscanf(szFeature, TEXT("Feature%u"), &iFeature) || iFeature >= m_config.cFeaturesPerProduct)
+        return ERROR_UNKNOWN_FEATURE;
+
+    *pdwUseCount = (iProduct * 7 + iFeature) % 20;
+    // DOS date, as the installer stores it.
+    *pwDateUsed = (*pdwUseCount) ? (WORD) (((2005 - 1980) << 9) | ((1 + iFeature % 12) << 5) | (1 + iProduct % 28)) : 0;
+    return ERROR_SUCCESS;
+}
+
+UINT CSyntheticInstallerData::EnumComponents(DWORD iComponentIndex, TCHAR* lpComponentBuf)
+{
+    if (iComponentIndex >= m_config.cComponents)
+        return ERROR_NO_MORE_ITEMS;
+
+    FormatSyntheticGuid(lpComponentBuf, iComponentIndex, szSyntheticComponentTail);
+    return ERROR_SUCCESS;
+}
+
+UINT CSyntheticInstallerData::EnumClients(const TCHAR* szComponent, DWORD iProductIndex, TCHAR* lpProductBuf)
+{
+    DWORD iComponent = 0;
+    if (!ParseSyntheticGuid(szComponent, szSyntheticComponentTail, &iComponent) || iComponent >= m_config.cComponents)
+        return ERROR_UNKNOWN_COMPONENT;
+
+    DWORD iClient = ClientOfComponent(iComponent, iProductIndex);
+    if (iSyntheticNotAClient == iClient)
+        return ERROR_NO_MORE_ITEMS;
+
+    if (iSyntheticPermanent == iClient)
+        lstrcpy(lpProductBuf, SZPermanentProduct);
+    else
+        FormatSyntheticGuid(lpProductBuf, iClient, szSyntheticProductTail);
+    return ERROR_SUCCESS;
+}
+
+INSTALLSTATE CSyntheticInstallerData::GetComponentPath(const TCHAR* szProduct, const TCHAR* szComponent, TCHAR* lpPathBuf, DWORD* pcchBuf)
+{
+    DWORD iProduct = 0;
+    DWORD iComponent = 0;
+    if (!ParseSyntheticGuid(szProduct, szSyntheticProductTail, &iProduct))
+        return INSTALLSTATE_UNKNOWN;
+    if (!ParseSyntheticGuid(szComponent, szSyntheticComponentTail, &iComponent) || iComponent >= m_config.cComponents)
+        return INSTALLSTATE_UNKNOWN;
+
+    bool fClient = false;
+    for (DWORD iClient = 0; iClient < ClientCount(iComponent); iClient++)
+    {
+        if (ClientOfComponent(iComponent, iClient) == iProduct)
+            fClient = true;
+    }
+    if (!fClient)
+        return INSTALLSTATE_UNKNOWN;
+
+    if (17 == iComponent % 30)
+    {
+        CopyInstallerString(TEXT(""), lpPathBuf, pcchBuf);
+        return INSTALLSTATE_ABSENT;
+    }
+
+    TCHAR szPath[MAX_PATH];
+    if (5 == iComponent % 40)
+        sprintf(szPath, TEXT("02:\\SOFTWARE\\Synthetic\\Product %u\\Component %u\\"), iProduct, iComponent);
+    else
+        sprintf(szPath, TEXT("C:\\Program Files\\Synthetic\\Product %u\\file%u.dll"), iComponent % ((m_config.cProducts) ? m_config.cProducts : 1), iComponent);
+
+    if (ERROR_MORE_DATA == CopyInstallerString(szPath, lpPathBuf, pcchBuf))
+        return INSTALLSTATE_MOREDATA;
+
+    return INSTALLSTATE_LOCAL;
+}
+
+UINT CSyntheticInstallerData::EnumComponentQualifiers(const TCHAR* szComponent, DWORD iIndex, TCHAR* lpQualifierBuf, DWORD* pcchQualifierBuf,
+                                                      TCHAR* lpApplicationDataBuf, DWORD* pcchApplicationDataBuf)
+{
+    DWORD iComponent = 0;
+    if (!ParseSyntheticGuid(szComponent, szSyntheticComponentTail, &iComponent) || iComponent >= m_config.cComponents)
+        return ERROR_UNKNOWN_COMPONENT;
+
+    if (2 != iComponent % 4 || iIndex >= m_config.cQualifiersPerComponent)
+        return ERROR_NO_MORE_ITEMS;
+
+    TCHAR szValue[64];
+    sprintf(szValue, TEXT("%u"), 1033 + iIndex);
+    if (ERROR_MORE_DATA == CopyInstallerString(szValue, lpQualifierBuf, pcchQualifierBuf))
+        return ERROR_MORE_DATA;
+    sprintf(szValue, TEXT("Synthetic Component %u, language %u"), iComponent, iIndex);
+    return CopyInstallerString(szValue, lpApplicationDataBuf, pcchApplicationDataBuf);
+}
+
+UINT CSyntheticInstallerData::EnumPatches(const TCHAR* szProduct, DWORD iPatchIndex, TCHAR* lpPatchBuf, TCHAR* lpTransformsBuf, DWORD* pcchTransformsBuf)
+{
+    DWORD iProduct = 0;
+    if (!ParseSyntheticGuid(szProduct, szSyntheticProductTail, &iProduct) || iProduct >= m_config.cProducts)
+        return ERROR_UNKNOWN_PRODUCT;
+
+    if (iPatchIndex >= m_config.cPatchesPerProduct)
+        return ERROR_NO_MORE_ITEMS;
+
+    DWORD iPatch = iProduct * m_config.cPatchesPerProduct + iPatchIndex;
+    TCHAR szTransforms[64];
+    sprintf(szTransforms, TEXT(":Patch%u.mst"), iPatch);
+    if (ERROR_MORE_DATA == CopyInstallerString(szTransforms, lpTransformsBuf, pcchTransformsBuf))
+        return ERROR_MORE_DATA;
+
+    FormatSyntheticGuid(lpPatchBuf, iPatch, szSyntheticPatchTail);
+    return ERROR_SUCCESS;
+}
+
+// keypaths are hashed rather than parsed so any path - including ones the
+// report makes up - gets a stable answer.
+void CSyntheticInstallerData::ProbeKeyPath(const TCHAR* szKeyPath, KEYPATHPROBE* pProbe)
+{
+    InitKeyPathProbe(pProbe);
+    if (!szKeyPath || !*szKeyPath)
+        return;
+
+    if (m_config.dwKeyPathLatency)
+        Sleep(m_config.dwKeyPathLatency);
+
+    DWORD dwHash = 2166136261U;
+    for (const TCHAR* pch = szKeyPath; *pch; pch++)
+        dwHash = (dwHash ^ (BYTE) *pch) * 16777619U;
+
+    static const TCHAR* rgszOwner[] =
+        { TEXT("NT AUTHORITY\\SYSTEM"), TEXT("BUILTIN\\Administrators"), TEXT("NT SERVICE\\TrustedInstaller") };
+    pProbe->osOwner = osResolved;
+    lstrcpy(pProbe->szOwner, rgszOwner[dwHash % 3]);
+
+    // 2005-01-01 plus up to a year, whole minutes.
+    const __int64 lgBase = 1104537600LL * 10000000 + FILETIMEUnixEpoch;
+    const __int64 lgMinute = 60LL * 10000000;
+    __int64 lgCreated = lgBase + (__int64) ((dwHash >> 4) % (365 * 24 * 60)) * lgMinute;
+    Int64ToFileTime(lgCreated + (__int64) ((dwHash >> 12) % 1000) * lgMinute, &pProbe->ftLastWriteTime);
+
+    if (IsRegistryKeyPath(szKeyPath))
+    {
+        pProbe->fRegistry = true;
+        pProbe->fRegistryRoot = (szKeyPath[1] >= '0' && szKeyPath[1] <= '3');
+        pProbe->dwRegistryError = ERROR_SUCCESS;
+        pProbe->fLastWriteTime = true;
+        return;
+    }
+
+    // the same shape the NT live probe reports for a missing file.
+    pProbe->dwAttributes = 0;
+    if (0 == dwHash % 11)
+    {
+        pProbe->osOwner = osNotRead;
+        pProbe->szOwner[0] = 0;
+        return;
+    }
+
+    pProbe->dwAttributes = FILE_ATTRIBUTE_ARCHIVE;
+    pProbe->fExtendedAttributes = true;
+    pProbe->nFileSizeLow = 4096 + (dwHash % 4000000);
+    Int64ToFileTime(lgCreated, &pProbe->ftCreationTime);
+
+    if (0 == dwHash % 7)
+    {
+        pProbe->uiVersionResult = ERROR_FILE_INVALID;
+    }
+    else
+    {
+        pProbe->uiVersionResult = ERROR_SUCCESS;
+        sprintf(pProbe->szVersion, TEXT("5.%u.%u.0"), (dwHash >> 8) % 3, (dwHash >> 16) % 4000);
+        lstrcpy(pProbe->szLanguage, TEXT("1033"));
+    }
+
+    int cchKeyPath = lstrlen(szKeyPath);
+    if (cchKeyPath > 4 && 0 == lstrcmpi(szKeyPath + cchKeyPath - 4, TEXT(".exe")))
+    {
+        pProbe->fBinaryType = true;
+        pProbe->dwBinaryType = SCS_32BIT_BINARY;
+    }
+}
@@ -0,0 +1,215 @@
+/*---------------------------------------------------------------------------
+Installer data providers.
+
+    Everything the report needs from Windows Installer goes through a
+    CInstallerData.  The methods mirror the Msi* API they replace - same
+    arguments, same buffer conventions (ERROR_MORE_DATA, *pcch in/out),
+    same return codes - so report code reads exactly as it did when it
+    called the installer directly.  Keypaths are probed through the
+    provider too (keypath.h), so a report never needs the machine it
+    describes.  A provider must answer several threads at once once it is
+    loaded (-j, enrich.h), so the answers carry no per-call state.
+
+        CLiveInstallerData       forwards to msi.dll (Windows only.)
+        CSyntheticInstallerData  generates a deterministic inventory of any
+                                 size, for scaling runs off-box.
+        CReplayInstallerData     answers from a snapshot recorded on another
+                                 machine (replay.h.)
+
+---------------------------------------------------------------------------*/
+
+#ifndef INSTALLERDATA_H
+#define INSTALLERDATA_H
+
+#include "msiport.h"
+#include "keypath.h"
+
+const int CCHGuid = 39;  // GUID + NULL
+extern const TCHAR SZPermanentProduct[CCHGuid];
+
+// braced, upper-case form used wherever GUIDs are keys.
+void CanonicalGuid(TCHAR* szDest, const TCHAR* szSource);
+
+// every product property a snapshot records, whether or not the report prints it.
+enum INVENTORYPROPERTY {
+    ipProductName,
+    ipInstalledProductName,
+    ipVersionString,
+    ipVersion,
+    ipAssignmentType,
+    ipPackageCode,
+    ipPublisher,
+    ipLanguage,
+    ipProductID,
+    ipInstallLocation,
+    ipInstallSource,
+    ipPackageName,
+    ipProductIcon,
+    ipInstallDate,
+    ipURLInfoAbout,
+    ipHelpLink,
+    ipHelpTelephone,
+    ipURLUpdateInfo,
+    ipTransforms,
+    ipLocalPackage,
+    ipInstanceType,
+    CInventoryProperties
+};
+extern const TCHAR* const SZInventoryProperty[CInventoryProperties];
+
+// copies a result string following the installer's buffer contract: NULL
+// buffer asks for the length, too small a buffer gets ERROR_MORE_DATA.
+UINT CopyInstallerString(const TCHAR* szValue, TCHAR* lpBuf, DWORD* pcchBuf);
+
+class CInstallerData
+{
+public:
+    virtual ~CInstallerData() {}
+
+    virtual UINT          EnumProducts(DWORD iProductIndex, TCHAR* lpProductBuf) = 0;
+    virtual INSTALLSTATE  QueryProductState(const TCHAR* szProduct) = 0;
+    virtual UINT          GetProductInfo(const TCHAR* szProduct, const TCHAR* szAttribute, TCHAR* lpValueBuf, DWORD* pcchValueBuf) = 0;
+    virtual USERINFOSTATE GetUserInfo(const TCHAR* szProduct, TCHAR* lpUserNameBuf, DWORD* pcchUserNameBuf,
+                                      TCHAR* lpOrgNameBuf, DWORD* pcchOrgNameBuf, TCHAR* lpSerialBuf, DWORD* pcchSerialBuf) = 0;
+
+    virtual UINT          EnumFeatures(const TCHAR* szProduct, DWORD iFeatureIndex, TCHAR* lpFeatureBuf, TCHAR* lpParentBuf) = 0;
+    virtual INSTALLSTATE  QueryFeatureState(const TCHAR* szProduct, const TCHAR* szFeature) = 0;
+    virtual UINT          GetFeatureUsage(const TCHAR* szProduct, const TCHAR* szFeature, DWORD* pdwUseCount, WORD* pwDateUsed) = 0;
+
+    virtual UINT          EnumComponents(DWORD iComponentIndex, TCHAR* lpComponentBuf) = 0;
+    virtual UINT          EnumClients(const TCHAR* szComponent, DWORD iProductIndex, TCHAR* lpProductBuf) = 0;
+    virtual INSTALLSTATE  GetComponentPath(const TCHAR* szProduct, const TCHAR* szComponent, TCHAR* lpPathBuf, DWORD* pcchBuf) = 0;
+    virtual UINT          EnumComponentQualifiers(const TCHAR* szComponent, DWORD iIndex, TCHAR* lpQualifierBuf, DWORD* pcchQualifierBuf,
+                                                  TCHAR* lpApplicationDataBuf, DWORD* pcchApplicationDataBuf) = 0;
+
+    virtual UINT          EnumPatches(const TCHAR* szProduct, DWORD iPatchIndex, TCHAR* lpPatchBuf, TCHAR* lpTransformsBuf, DWORD* pcchTransformsBuf) = 0;
+
+    virtual void          ProbeKeyPath(const TCHAR* szKeyPath, KEYPATHPROBE* pProbe) = 0;
+};
+
+// passes every question to another provider; a decorator overrides the few it
+// changes.  It does not own the provider it wraps.
+class CForwardingInstallerData : public CInstallerData
+{
+public:
+    CForwardingInstallerData(CInstallerData* pSource) : m_pSource(pSource) {}
+
+    UINT          EnumProducts(DWORD iProductIndex, TCHAR* lpProductBuf)
+                      { return m_pSource->EnumProducts(iProductIndex, lpProductBuf); }
+    INSTALLSTATE  QueryProductState(const TCHAR* szProduct)
+                      { return m_pSource->QueryProductState(szProduct); }
+    UINT          GetProductInfo(const TCHAR* szProduct, const TCHAR* szAttribute, TCHAR* lpValueBuf, DWORD* pcchValueBuf)
+                      { return m_pSource->GetProductInfo(szProduct, szAttribute, lpValueBuf, pcchValueBuf); }
+    USERINFOSTATE GetUserInfo(const TCHAR* szProduct, TCHAR* lpUserNameBuf, DWORD* pcchUserNameBuf,
+                              TCHAR* lpOrgNameBuf, DWORD* pcchOrgNameBuf, TCHAR* lpSerialBuf, DWORD* pcchSerialBuf)
+                      { return m_pSource->GetUserInfo(szProduct, lpUserNameBuf, pcchUserNameBuf, lpOrgNameBuf, pcchOrgNameBuf, lpSerialBuf, pcchSerialBuf); }
+
+    UINT          EnumFeatures(const TCHAR* szProduct, DWORD iFeatureIndex, TCHAR* lpFeatureBuf, TCHAR* lpParentBuf)
+                      { return m_pSource->EnumFeatures(szProduct, iFeatureIndex, lpFeatureBuf, lpParentBuf); }
+    INSTALLSTATE  QueryFeatureState(const TCHAR* szProduct, const TCHAR* szFeature)
+                      { return m_pSource->QueryFeatureState(szProduct, szFeature); }
+    UINT          GetFeatureUsage(const TCHAR* szProduct, const TCHAR* szFeature, DWORD* pdwUseCount, WORD* pwDateUsed)
+                      { return m_pSource->GetFeatureUsage(szProduct, szFeature, pdwUseCount, pwDateUsed); }
+
+    UINT          EnumComponents(DWORD iComponentIndex, TCHAR* lpComponentBuf)
+                      { return m_pSource->EnumComponents(iComponentIndex, lpComponentBuf); }
+    UINT          EnumClients(const TCHAR* szComponent, DWORD iProductIndex, TCHAR* lpProductBuf)
+                      { return m_pSource->EnumClients(szComponent, iProductIndex, lpProductBuf); }
+    INSTALLSTATE  GetComponentPath(const TCHAR* szProduct, const TCHAR* szComponent, TCHAR* lpPathBuf, DWORD* pcchBuf)
+                      { return m_pSource->GetComponentPath(szProduct, szComponent, lpPathBuf, pcchBuf); }
+    UINT          EnumComponentQualifiers(const TCHAR* szComponent, DWORD iIndex, TCHAR* lpQualifierBuf, DWORD* pcchQualifierBuf,
+                                          TCHAR* lpApplicationDataBuf, DWORD* pcchApplicationDataBuf)
+                      { return m_pSource->EnumComponentQualifiers(szComponent, iIndex, lpQualifierBuf, pcchQualifierBuf, lpApplicationDataBuf, pcchApplicationDataBuf); }
+
+    UINT          EnumPatches(const TCHAR* szProduct, DWORD iPatchIndex, TCHAR* lpPatchBuf, TCHAR* lpTransformsBuf, DWORD* pcchTransformsBuf)
+                      { return m_pSource->EnumPatches(szProduct, iPatchIndex, lpPatchBuf, lpTransformsBuf, pcchTransformsBuf); }
+
+    void          ProbeKeyPath(const TCHAR* szKeyPath, KEYPATHPROBE* pProbe)
+                      { m_pSource->ProbeKeyPath(szKeyPath, pProbe); }
+
+protected:
+    CInstallerData* m_pSource;
+};
+
+#ifdef _WIN32
+class CRegistryKeyCache;
+class CDirectoryCache;
+
+class CLiveInstallerData : public CInstallerData
+{
+public:
+    CLiveInstallerData();
+    ~CLiveInstallerData();
+
+    UINT          EnumProducts(DWORD iProductIndex, TCHAR* lpProductBuf);
+    INSTALLSTATE  QueryProductState(const TCHAR* szProduct);
+    UINT          GetProductInfo(const TCHAR* szProduct, const TCHAR* szAttribute, TCHAR* lpValueBuf, DWORD* pcchValueBuf);
+    USERINFOSTATE GetUserInfo(const TCHAR* szProduct, TCHAR* lpUserNameBuf, DWORD* pcchUserNameBuf,
+                              TCHAR* lpOrgNameBuf, DWORD* pcchOrgNameBuf, TCHAR* lpSerialBuf, DWORD* pcchSerialBuf);
+
+    UINT          EnumFeatures(const TCHAR* szProduct, DWORD iFeatureIndex, TCHAR* lpFeatureBuf, TCHAR* lpParentBuf);
+    INSTALLSTATE  QueryFeatureState(const TCHAR* szProduct, const TCHAR* szFeature);
+    UINT          GetFeatureUsage(const TCHAR* szProduct, const TCHAR* szFeature, DWORD* pdwUseCount, WORD* pwDateUsed);
+
+    UINT          EnumComponents(DWORD iComponentIndex, TCHAR* lpComponentBuf);
+    UINT          EnumClients(const TCHAR* szComponent, DWORD iProductIndex, TCHAR* lpProductBuf);
+    INSTALLSTATE  GetComponentPath(const TCHAR* szProduct, const TCHAR* szComponent, TCHAR* lpPathBuf, DWORD* pcchBuf);
+    UINT          EnumComponentQualifiers(const TCHAR* szComponent, DWORD iIndex, TCHAR* lpQualifierBuf, DWORD* pcchQualifierBuf,
+                                          TCHAR* lpApplicationDataBuf, DWORD* pcchApplicationDataBuf);
+
+    UINT          EnumPatches(const TCHAR* szProduct, DWORD iPatchIndex, TCHAR* lpPatchBuf, TCHAR* lpTransformsBuf, DWORD* pcchTransformsBuf);
+
+    void          ProbeKeyPath(const TCHAR* szKeyPath, KEYPATHPROBE* pProbe);
+
+private:
+    CRegistryKeyCache*  m_pRegistryKeys;    // registry keypaths' parent keys, kept open (regkeys.h)
+    CDirectoryCache*    m_pDirectories;     // file keypaths' directories, listed (dircache.h)
+};
+#endif // _WIN32
+
+// Shape of a generated inventory.  Parsed from "-synthetic key=value,..."
+struct SYNTHETICCONFIG {
+    DWORD cProducts;
+    DWORD cComponents;
+    DWORD cClientsPerComponent;     // clients on a shared component
+    DWORD cFeaturesPerProduct;
+    DWORD cPatchesPerProduct;
+    DWORD cQualifiersPerComponent;  // on a qualified component
+    DWORD dwKeyPathLatency;         // milliseconds a keypath probe takes
+};
+
+bool ParseSyntheticConfig(const TCHAR* szSpec, SYNTHETICCONFIG* pConfig);
+
+class CSyntheticInstallerData : public CInstallerData
+{
+public:
+    CSyntheticInstallerData(const SYNTHETICCONFIG& config);
+
+    UINT          EnumProducts(DWORD iProductIndex, TCHAR* lpProductBuf);
+    INSTALLSTATE  QueryProductState(const TCHAR* szProduct);
+    UINT          GetProductInfo(const TCHAR* szProduct, const TCHAR* szAttribute, TCHAR* lpValueBuf, DWORD* pcchValueBuf);
+    USERINFOSTATE GetUserInfo(const TCHAR* szProduct, TCHAR* lpUserNameBuf, DWORD* pcchUserNameBuf,
+                              TCHAR* lpOrgNameBuf, DWORD* pcchOrgNameBuf, TCHAR* lpSerialBuf, DWORD* pcchSerialBuf);
+
+    UINT          EnumFeatures(const TCHAR* szProduct, DWORD iFeatureIndex, TCHAR* lpFeatureBuf, TCHAR* lpParentBuf);
+    INSTALLSTATE  QueryFeatureState(const TCHAR* szProduct, const TCHAR* szFeature);
+    UINT          GetFeatureUsage(const TCHAR* szProduct, const TCHAR* szFeature, DWORD* pdwUseCount, WORD* pwDateUsed);
+
+    UINT          EnumComponents(DWORD iComponentIndex, TCHAR* lpComponentBuf);
+    UINT          EnumClients(const TCHAR* szComponent, DWORD iProductIndex, TCHAR* lpProductBuf);
+    INSTALLSTATE  GetComponentPath(const TCHAR* szProduct, const TCHAR* szComponent, TCHAR* lpPathBuf, DWORD* pcchBuf);
+    UINT          EnumComponentQualifiers(const TCHAR* szComponent, DWORD iIndex, TCHAR* lpQualifierBuf, DWORD* pcchQualifierBuf,
+                                          TCHAR* lpApplicationDataBuf, DWORD* pcchApplicationDataBuf);
+
+    UINT          EnumPatches(const TCHAR* szProduct, DWORD iPatchIndex, TCHAR* lpPatchBuf, TCHAR* lpTransformsBuf, DWORD* pcchTransformsBuf);
+
+    void          ProbeKeyPath(const TCHAR* szKeyPath, KEYPATHPROBE* pProbe);
+
+private:
+    DWORD ClientOfComponent(DWORD iComponent, DWORD iClient);
+    DWORD ClientCount(DWORD iComponent);
+
+    SYNTHETICCONFIG m_config;
+};
+
+#endif // INSTALLERDATA_H
@@ -0,0 +1,220 @@
+/*---------------------------------------------------------------------------
+NDJSON records - see jsonout.h.
+---------------------------------------------------------------------------*/
+
+#include "jsonout.h"
+
+COutputSink* g_pJsonOut = NULL;
+
+static const TCHAR s_szHex[] = TEXT("0123456789abcdef");
+
+static void WriteEscapedUnicode(COutputSink* pOut, unsigned int uChar)
+{
+    TCHAR rgch[6] = { '\\', 'u', s_szHex[(uChar >> 12) & 0xF], s_szHex[(uChar >> 8) & 0xF], s_szHex[(uChar >> 4) & 0xF], s_szHex[uChar & 0xF] };
+    pOut->Write(rgch, 6);
+}
+
+void WriteJsonString(COutputSink* pOut, const TCHAR* sz)
+{
+    pOut->Char('"');
+    if (!sz)
+        sz = TEXT("");
+
+    const TCHAR* pchRun = sz;
+    for (const TCHAR* pch = sz; ; pch++)
+    {
+        unsigned char ch = (unsigned char) *pch;
+        bool fPlain = (ch >= 0x20 && '"' != ch && '\\' != ch);
+#ifdef _WIN32
+        fPlain = fPlain && (ch < 0x80);
+#endif
+        if (fPlain)
+            continue;
+
+        // the run of characters that need nothing done to them.
+        if (pch != pchRun)
+            pOut->Write(pchRun, (DWORD) (pch - pchRun));
+        if (!ch)
+            break;
+
+        switch (ch)
+        {
+            case '"':   pOut->Str(TEXT("\\\""));    break;
+            case '\\':  pOut->Str(TEXT("\\\\"));    break;
+            case '\n':  pOut->Str(TEXT("\\n"));     break;
+            case '\r':  pOut->Str(TEXT("\\r"));     break;
+            case '\t':  pOut->Str(TEXT("\\t"));     break;
+            default:
+#ifdef _WIN32
+                if (ch >= 0x80)
+                {
+                    // one ANSI character - two bytes with a lead byte - as UTF-16.
+                    int cb = (IsDBCSLeadByte(ch) && pch[1]) ? 2 : 1;
+                    WCHAR rgwch[2];
+                    int cwch = MultiByteToWideChar(CP_ACP, 0, pch, cb, rgwch, 2);
+                    for (int iwch = 0; iwch < cwch; iwch++)
+                        WriteEscapedUnicode(pOut, rgwch[iwch]);
+                    if (!cwch)
+                        WriteEscapedUnicode(pOut, 0xFFFD);
+                    pch += cb - 1;
+                    break;
+                }
+#endif
+                WriteEscapedUnicode(pOut, ch);
+                break;
+        }
+        pchRun = pch + 1;
+    }
+    pOut->Char('"');
+}
+
+CJsonRecord::CJsonRecord(COutputSink* pOut, const TCHAR* szType)
+    : m_pOut(pOut), m_fFirst(false)
+{
+    if (!m_pOut)
+        return;
+    m_pOut->Str(TEXT("{\"type\":"));
+    WriteJsonString(m_pOut, szType);
+}
+
+void CJsonRecord::Separate()
+{
+    if (!m_fFirst)
+        m_pOut->Char(',');
+    m_fFirst = false;
+}
+
+void CJsonRecord::Name(const TCHAR* szName)
+{
+    Separate();
+    WriteJsonString(m_pOut, szName);
+    m_pOut->Char(':');
+}
+
+void CJsonRecord::String(const TCHAR* szName, const TCHAR* szValue)
+{
+    if (!m_pOut)
+        return;
+    Name(szName);
+    WriteJsonString(m_pOut, szValue);
+}
+
+void CJsonRecord::Int(const TCHAR* szName, int iValue)
+{
+    if (!m_pOut)
+        return;
+    Name(szName);
+    m_pOut->Int(iValue);
+}
+
+void CJsonRecord::UInt(const TCHAR* szName, unsigned int uValue)
+{
+    if (!m_pOut)
+        return;
+    Name(szName);
+    m_pOut->UInt(uValue);
+}
+
+void CJsonRecord::UInt64(const TCHAR* szName, unsigned __int64 uValue)
+{
+    if (!m_pOut)
+        return;
+    Name(szName);
+
+    TCHAR rgch[24];
+    TCHAR* pch = rgch + 24;
+    do
+    {
+        *--pch = (TCHAR) ('0' + uValue % 10);
+        uValue /= 10;
+    } while (uValue);
+    m_pOut->Write(pch, (DWORD) (rgch + 24 - pch));
+}
+
+void CJsonRecord::Bool(const TCHAR* szName, bool fValue)
+{
+    if (!m_pOut)
+        return;
+    Name(szName);
+    m_pOut->Str((fValue) ? TEXT("true") : TEXT("false"));
+}
+
+void CJsonRecord::Time(const TCHAR* szName, const FILETIME& ft)
+{
+    if (!m_pOut)
+        return;
+
+    SYSTEMTIME st;
+    if (!FileTimeToSystemTime(&ft, &st))
+        return;
+    Name(szName);
+    m_pOut->Char('"');
+    m_pOut->UInt(st.wYear, 4, '0');
+    m_pOut->Char('-');
+    m_pOut->UInt(st.wMonth, 2, '0');
+    m_pOut->Char('-');
+    m_pOut->UInt(st.wDay, 2, '0');
+    m_pOut->Char('T');
+    m_pOut->UInt(st.wHour, 2, '0');
+    m_pOut->Char(':');
+    m_pOut->UInt(st.wMinute, 2, '0');
+    m_pOut->Char(':');
+    m_pOut->UInt(st.wSecond, 2, '0');
+    m_pOut->Str(TEXT("Z\""));
+}
+
+void CJsonRecord::Date(const TCHAR* szName, unsigned int uYear, unsigned int uMonth, unsigned int uDay)
+{
+    if (!m_pOut)
+        return;
+    Name(szName);
+    m_pOut->Char('"');
+    m_pOut->UInt(uYear, 4, '0');
+    m_pOut->Char('-');
+    m_pOut->UInt(uMonth, 2, '0');
+    m_pOut->Char('-');
+    m_pOut->UInt(uDay, 2, '0');
+    m_pOut->Char('"');
+}
+
+void CJsonRecord::BeginArray(const TCHAR* szName)
+{
+    if (!m_pOut)
+        return;
+    Name(szName);
+    m_pOut->Char('[');
+    m_fFirst = true;
+}
+
+void CJsonRecord::EndArray()
+{
+    if (!m_pOut)
+        return;
+    m_pOut->Char(']');
+    m_fFirst = false;
+}
+
+void CJsonRecord::BeginObject()
+{
+    if (!m_pOut)
+        return;
+    Separate();
+    m_pOut->Char('{');
+    m_fFirst = true;
+}
+
+void CJsonRecord::EndObject()
+{
+    if (!m_pOut)
+        return;
+    m_pOut->Char('}');
+    m_fFirst = false;
+}
+
+void CJsonRecord::End()
+{
+    if (!m_pOut)
+        return;
+    m_pOut->Str(TEXT("}\n"));
+    m_pOut = NULL;
+}
@@ -0,0 +1,66 @@
+/*---------------------------------------------------------------------------
+NDJSON records (-json).
+
+    With -json the report is written as one JSON object per line, one per
+    thing it finds - a product, feature, component, client of a component,
+    patch, keypath probe, log file or event - each written out as soon as
+    it is found, so a pipeline reads the same facts the text report prints
+    without parsing its layout.  Every record has a "type"; see the README
+    for the fields of each.
+
+    A CJsonRecord writes its fields to the sink as they are added, and
+    End() closes the line; nothing is held back beyond the sink's buffer,
+    so memory does not grow with the machine.  A record on a NULL sink
+    does nothing, which lets the report describe each thing once for both
+    outputs: without -json g_pJsonOut is NULL, with it the text sink is
+    discarded.
+
+    Strings are written as UTF-8.  On Windows they are converted from the
+    ANSI code page; elsewhere they already are UTF-8.
+---------------------------------------------------------------------------*/
+
+#ifndef JSONOUT_H
+#define JSONOUT_H
+
+#include "outsink.h"
+
+class CJsonRecord
+{
+public:
+    // {"type":szType
+    CJsonRecord(COutputSink* pOut, const TCHAR* szType);
+
+    void  String(const TCHAR* szName, const TCHAR* szValue);
+    void  Int(const TCHAR* szName, int iValue);
+    void  UInt(const TCHAR* szName, unsigned int uValue);
+    void  UInt64(const TCHAR* szName, unsigned __int64 uValue);
+    void  Bool(const TCHAR* szName, bool fValue);
+    // ISO 8601, UTC: "2001-02-03T04:05:06Z"
+    void  Time(const TCHAR* szName, const FILETIME& ft);
+    // "2001-02-03"
+    void  Date(const TCHAR* szName, unsigned int uYear, unsigned int uMonth, unsigned int uDay);
+
+    // an array of objects: BeginArray, then BeginObject / fields / EndObject for each.
+    void  BeginArray(const TCHAR* szName);
+    void  EndArray();
+    void  BeginObject();
+    void  EndObject();
+
+    // }\n
+    void  End();
+
+private:
+    void  Name(const TCHAR* szName);
+    void  Separate();
+
+    COutputSink*    m_pOut;
+    bool            m_fFirst;       // nothing yet in the innermost object or array
+};
+
+// sz as a JSON string, quotes included, for writers of other JSON (trace.h).
+void  WriteJsonString(COutputSink* pOut, const TCHAR* sz);
+
+// -json: where records go.  NULL without -json.
+extern COutputSink* g_pJsonOut;
+
+#endif // JSONOUT_H
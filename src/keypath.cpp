@@ -0,0 +1,178 @@
+/*---------------------------------------------------------------------------
+Keypath probes - see keypath.h.
+---------------------------------------------------------------------------*/
+
+#include "keypath.h"
+#include "acctcache.h"
+#include "callcount.h"
+#include "dircache.h"
+#include "peimage.h"
+#include <stdio.h>
+#include <string.h>
+
+void InitKeyPathProbe(KEYPATHPROBE* pProbe)
+{
+    memset(pProbe, 0, sizeof(KEYPATHPROBE));
+    pProbe->dwAttributes = 0xFFFFFFFF;
+    pProbe->uiVersionResult = ERROR_FILE_NOT_FOUND;
+    pProbe->osOwner = osNotRead;
+}
+
+void ProbeKeyPathImage(const TCHAR* szFile, bool fBinaryType, KEYPATHPROBE* pProbe)
+{
+    if ((0xFFFFFFFF != pProbe->dwAttributes) && (pProbe->dwAttributes & FILE_ATTRIBUTE_DIRECTORY))
+    {
+        pProbe->uiVersionResult = ERROR_FILE_NOT_FOUND;
+        return;
+    }
+
+    PEIMAGEINFO Image;
+    CCallTimer Timer(tcReadImage);
+    pProbe->uiVersionResult = ReadPeFile(szFile, &Image);
+    Timer.Stop();
+    if (ERROR_SUCCESS != pProbe->uiVersionResult)
+        return;
+
+    pProbe->uiVersionResult = Image.uiVersionResult;
+    if (ERROR_SUCCESS == pProbe->uiVersionResult)
+        FormatPeVersion(Image, pProbe->szVersion, CCHKeyPathVersion, pProbe->szLanguage, CCHKeyPathVersion);
+#ifdef _WIN32
+    // 16-bit and VxD version resources are another format; the installer still reads those.
+    if ((ikNE == Image.ik) || (ikLE == Image.ik))
+    {
+        DWORD cchVersion = CCHKeyPathVersion;
+        DWORD cchLanguage = CCHKeyPathVersion;
+        CCallTimer VersionTimer(tcGetFileVersion);
+        pProbe->uiVersionResult = MsiGetFileVersion(szFile, pProbe->szVersion, &cchVersion, pProbe->szLanguage, &cchLanguage);
+    }
+#endif
+
+    if (fBinaryType)
+        pProbe->fBinaryType = PeBinaryType(Image, szFile, &pProbe->dwBinaryType);
+}
+
+#ifdef _WIN32
+
+const int SD_SIZE = 1024;
+const int NAME_SIZE = 256;
+
+static DWORD LookupSidAccount(const BYTE* pbId, DWORD cbId, TCHAR* szAccount, DWORD cchAccount)
+{
+    char szName[NAME_SIZE] = "";
+    DWORD cbName = NAME_SIZE;
+    char szDomain[NAME_SIZE] = "";
+    DWORD cbDomain = NAME_SIZE;
+    SID_NAME_USE snu;
+    CCallTimer Timer(tcLookupAccountSid);
+    BOOL fLookup = LookupAccountSid(NULL, (PSID) pbId, szName, &cbName, szDomain, &cbDomain, &snu);
+    Timer.Stop();
+    if (!fLookup)
+        return GetLastError();
+
+    sprintf(szAccount, "%s\\%s", szDomain, szName);
+    return ERROR_SUCCESS;
+}
+
+void ProbeKeyPathOwner(PSECURITY_DESCRIPTOR pSD, KEYPATHPROBE* pProbe)
+{
+    // the owner of the security descriptor - can be from any secured object,
+    // file, registry key, directory, et cetera.
+
+    byte pbSID[SD_SIZE];
+    PSID psid = pbSID;
+    BOOL fOwnerDefaulted = FALSE;
+
+    if ((!GetSecurityDescriptorOwner(pSD, ((PSID*) &psid), &fOwnerDefaulted)) || (!IsValidSid(psid)))
+    {
+        if (NULL == psid)
+        {
+            pProbe->osOwner = osNoOwner;
+        }
+        else
+        {
+            pProbe->osOwner = osUnreadable;
+            pProbe->dwOwnerError = GetLastError();
+        }
+        return;
+    }
+
+    if (fOwnerDefaulted)
+    {
+        pProbe->osOwner = osDefaulted;
+    }
+    else
+    {
+        // the same few accounts own nearly everything; acctcache.h keeps their names.
+        DWORD dwError = LookupAccountCached((const BYTE*) psid, GetLengthSid(psid), LookupSidAccount, pProbe->szOwner, CCHKeyPathOwner);
+        if (ERROR_SUCCESS != dwError)
+        {
+            pProbe->osOwner = osLookupFailed;
+            pProbe->dwOwnerError = dwError;
+            return;
+        }
+        pProbe->osOwner = osResolved;
+    }
+}
+
+void ProbeKeyPathLive(const TCHAR* szFilePath, KEYPATHPROBE* pProbe, CDirectoryCache* pDirectories)
+{
+    byte pbSD[SD_SIZE];
+    DWORD cbSD = SD_SIZE;
+
+    InitKeyPathProbe(pProbe);
+
+    if ((NULL == szFilePath) || !*szFilePath)
+        return;
+
+    WIN32_FILE_ATTRIBUTE_DATA FileInformation;
+
+    if (!g_fWin9X || MinimumPlatformWindows98())
+    {
+        // a failed GetFileAttributesEx has always reported as "no attributes", not "not found".
+        pProbe->dwAttributes = 0;
+
+        // a file its directory's listing does not have has no version or owner to read either.
+        DIRENTRYINFO Entry;
+        DIRLOOKUP dl = (pDirectories) ? pDirectories->FindFile(szFilePath, &Entry) : dlNotListed;
+        if (dlMissing == dl)
+            return;
+
+        if (dlFound == dl)
+        {
+            CopyDirectoryEntry(Entry, pProbe);
+        }
+        else
+        {
+            CCallTimer AttributesTimer(tcGetFileAttributesEx);
+            BOOL fAttributes = GetFileAttributesEx(szFilePath, GetFileExInfoStandard, &FileInformation);
+            AttributesTimer.Stop();
+            if (fAttributes)
+            {
+                pProbe->dwAttributes = FileInformation.dwFileAttributes;
+                pProbe->fExtendedAttributes = true;
+                pProbe->nFileSizeHigh = FileInformation.nFileSizeHigh;
+                pProbe->nFileSizeLow = FileInformation.nFileSizeLow;
+                pProbe->ftCreationTime = FileInformation.ftCreationTime;
+                pProbe->ftLastWriteTime = FileInformation.ftLastWriteTime;
+            }
+        }
+    }
+    else
+    {
+        pProbe->dwAttributes = GetFileAttributes(szFilePath);
+    }
+
+    // MsiGetFileVersion and GetBinaryType opened the file once each; one read of the headers and resources answers both.
+    ProbeKeyPathImage(szFilePath, (0xFFFFFFFF != pProbe->dwAttributes) && !g_fWin9X, pProbe);
+
+    if (!g_fWin9X)
+    {
+        CCallTimer SecurityTimer(tcGetFileSecurity);
+        BOOL fSecurity = GetFileSecurity(szFilePath, OWNER_SECURITY_INFORMATION, pbSD, SD_SIZE, &cbSD);
+        SecurityTimer.Stop();
+        if (fSecurity)
+            ProbeKeyPathOwner(pbSD, pProbe);
+    }
+}
+
+#endif // _WIN32
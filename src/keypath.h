@@ -0,0 +1,82 @@
+/*---------------------------------------------------------------------------
+Keypath probes.
+
+    A component's keypath is either a file path or a registry key in the
+    form "NN:key\key\..." where the second digit picks the root.  Probing
+    one gathers everything the report prints about it into a KEYPATHPROBE;
+    the report renders the struct and never touches the file system or
+    registry itself.  The probe records API results rather than judgements
+    so the renderer can reproduce every message the tool has always printed.
+---------------------------------------------------------------------------*/
+
+#ifndef KEYPATH_H
+#define KEYPATH_H
+
+#include "msiport.h"
+
+const int CCHKeyPathVersion = MAX_PATH;
+const int CCHKeyPathOwner = 2 * 256 + 2;    // domain\name
+
+enum OWNERSTATE {
+    osNotRead,          // no security descriptor - 9x, or reading it failed.  Nothing printed.
+    osNoOwner,          // descriptor has no owner
+    osUnreadable,       // GetSecurityDescriptorOwner / IsValidSid failed, dwOwnerError
+    osDefaulted,        // owner defaulted
+    osLookupFailed,     // LookupAccountSid failed, dwOwnerError
+    osResolved,         // szOwner holds domain\name
+};
+
+struct KEYPATHPROBE {
+    bool        fRegistry;              // keypath starts with a digit
+
+    // registry keypaths
+    bool        fRegistryRoot;          // second digit named a root we know; nothing is reported otherwise
+    DWORD       dwRegistryError;        // opening the key
+    bool        fLastWriteTime;         // ftLastWriteTime holds the key's last write
+
+    // file keypaths
+    DWORD       dwAttributes;           // 0xFFFFFFFF when the file can't be found
+    bool        fExtendedAttributes;    // size and both times are valid
+    DWORD       nFileSizeHigh;
+    DWORD       nFileSizeLow;
+    FILETIME    ftCreationTime;
+    UINT        uiVersionResult;        // as MsiGetFileVersion returns it
+    TCHAR       szVersion[CCHKeyPathVersion];
+    TCHAR       szLanguage[CCHKeyPathVersion];
+    bool        fBinaryType;
+    DWORD       dwBinaryType;           // SCS_*
+
+    // both
+    FILETIME    ftLastWriteTime;
+    OWNERSTATE  osOwner;
+    DWORD       dwOwnerError;
+    TCHAR       szOwner[CCHKeyPathOwner];
+};
+
+void InitKeyPathProbe(KEYPATHPROBE* pProbe);
+
+inline bool IsRegistryKeyPath(const TCHAR* szKeyPath)
+{
+    return (*szKeyPath >= '0' && *szKeyPath <= '9');
+}
+
+// the version, language and binary type of the file szFile from one open
+// of it, reading its headers and resource section (peimage.h).
+// pProbe->dwAttributes is already read; a
+// directory has no version.  fBinaryType: the binary type is wanted too.
+void ProbeKeyPathImage(const TCHAR* szFile, bool fBinaryType, KEYPATHPROBE* pProbe);
+
+#ifdef _WIN32
+class CDirectoryCache;
+
+// the real thing - file system and security APIs.  File keypaths only;
+// registry keypaths go through a CRegistryKeyCache (regkeys.h).  With
+// pDirectories the attributes, size and times come from a listing of the
+// keypath's directory when it has one (dircache.h).
+void ProbeKeyPathLive(const TCHAR* szKeyPath, KEYPATHPROBE* pProbe, CDirectoryCache* pDirectories);
+
+// the owner in pSD, from a file or a registry key, into pProbe.
+void ProbeKeyPathOwner(PSECURITY_DESCRIPTOR pSD, KEYPATHPROBE* pProbe);
+#endif
+
+#endif // KEYPATH_H
@@ -0,0 +1,561 @@
+/*---------------------------------------------------------------------------
+Installer log scan - see logscan.h.
+---------------------------------------------------------------------------*/
+
+#include "logscan.h"
+#include "workpool.h"
+#include "callcount.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define LOGSCAN_SSE2
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#ifndef _WIN32
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+const TCHAR* const LogMarkNames[cLogMarks] = { TEXT("Return value 3"), TEXT("Error 1603"), TEXT("Error 17xx") };
+
+const size_t CBLogScanPiece = 16 * 1024 * 1024;
+const size_t CBContextBack = 4096;         // how far back the context's lines may start
+const size_t CBContextForward = 1024;      // and how far on the failure's line may run
+
+//____________________________________________________________________________
+//
+// The search
+//____________________________________________________________________________
+
+// the marks are found as "Return value 3" and "Error 1", the digits after
+// the second telling 1603 from the 1700s.
+struct LOGNEEDLE {
+    BYTE    rgb[32];
+    DWORD   cb;
+};
+
+struct LOGNEEDLES {
+    LOGNEEDLE   Return;
+    LOGNEEDLE   Error;
+    DWORD       cbChar;         // 1, or 2 for UTF-16
+};
+
+static void MakeNeedle(const char* sz, DWORD cbChar, LOGNEEDLE* pNeedle)
+{
+    pNeedle->cb = 0;
+    for (const char* pch = sz; *pch; pch++)
+    {
+        pNeedle->rgb[pNeedle->cb++] = (BYTE) *pch;
+        if (2 == cbChar)
+            pNeedle->rgb[pNeedle->cb++] = 0;
+    }
+}
+
+static void MakeNeedles(bool fUnicode, LOGNEEDLES* pNeedles)
+{
+    pNeedles->cbChar = (fUnicode) ? 2 : 1;
+    MakeNeedle("Return value 3", pNeedles->cbChar, &pNeedles->Return);
+    MakeNeedle("Error 1", pNeedles->cbChar, &pNeedles->Error);
+}
+
+// the ich'th character from ib; -1 past the end, or for UTF-16 past 0x7F.
+static int CharAt(const BYTE* pb, size_t ib, size_t cb, DWORD cbChar, DWORD ich)
+{
+    size_t ibChar = ib + ich * cbChar;
+    if (ibChar + cbChar > cb)
+        return -1;
+    if ((2 == cbChar) && pb[ibChar + 1])
+        return -1;
+    return pb[ibChar];
+}
+
+static bool IsDigitChar(int ch)
+{
+    return (ch >= '0') && (ch <= '9');
+}
+
+// the mark at ib, or -1.
+static int MatchMark(const BYTE* pb, size_t ib, size_t cb, const LOGNEEDLES& Needles)
+{
+    if ((2 == Needles.cbChar) && (ib & 1))
+        return -1;
+
+    const LOGNEEDLE& Return = Needles.Return;
+    if ((ib + Return.cb <= cb) && (0 == memcmp(pb + ib, Return.rgb, Return.cb)))
+        return IsDigitChar(CharAt(pb, ib + Return.cb, cb, Needles.cbChar, 0)) ? -1 : lmReturnValue3;
+
+    const LOGNEEDLE& Error = Needles.Error;
+    if ((ib + Error.cb <= cb) && (0 == memcmp(pb + ib, Error.rgb, Error.cb)))
+    {
+        int rgch[4];
+        for (DWORD ich = 0; ich < 4; ich++)
+            rgch[ich] = CharAt(pb, ib + Error.cb, cb, Needles.cbChar, ich);
+        if (IsDigitChar(rgch[3]))
+            return -1;
+        if (('6' == rgch[0]) && ('0' == rgch[1]) && ('3' == rgch[2]))
+            return lmError1603;
+        if (('7' == rgch[0]) && IsDigitChar(rgch[1]) && IsDigitChar(rgch[2]))
+            return lmError17xx;
+    }
+    return -1;
+}
+
+// what a piece of a file holds.
+struct LOGPIECERESULT {
+    DWORD   rgcMark[cLogMarks];
+    int     lmFirst;            // -1 - none
+    size_t  ibFirst;
+};
+
+static void CountMark(const BYTE* pb, size_t ib, size_t cb, const LOGNEEDLES& Needles, LOGPIECERESULT* pResult)
+{
+    int lm = MatchMark(pb, ib, cb, Needles);
+    if (lm < 0)
+        return;
+    pResult->rgcMark[lm]++;
+    if (pResult->lmFirst < 0)
+    {
+        pResult->lmFirst = lm;
+        pResult->ibFirst = ib;
+    }
+}
+
+#ifdef LOGSCAN_SSE2
+static inline int LowestBit(unsigned int uMask)
+{
+#ifdef _MSC_VER
+    unsigned long iBit;
+    _BitScanForward(&iBit, uMask);
+    return (int) iBit;
+#else
+    return __builtin_ctz(uMask);
+#endif
+}
+#endif
+
+// marks starting in [ibStart, ibEnd) of a file of cb bytes; a mark may run past ibEnd.
+static void ScanRange(const BYTE* pb, size_t cb, size_t ibStart, size_t ibEnd, const LOGNEEDLES& Needles, LOGPIECERESULT* pResult)
+{
+    memset(pResult, 0, sizeof(LOGPIECERESULT));
+    pResult->lmFirst = -1;
+
+    const BYTE bReturnFirst = Needles.Return.rgb[0];
+    const BYTE bErrorFirst = Needles.Error.rgb[0];
+    size_t ib = ibStart;
+
+#ifdef LOGSCAN_SSE2
+    // the first and last character of each needle, 16 starting places at a time.
+    const size_t ibReturnLast = Needles.Return.cb - Needles.cbChar;
+    const size_t ibErrorLast = Needles.Error.cb - Needles.cbChar;
+    const size_t cbReach = 16 + ((ibReturnLast > ibErrorLast) ? ibReturnLast : ibErrorLast);
+    const __m128i vReturnFirst = _mm_set1_epi8((char) bReturnFirst);
+    const __m128i vReturnLast = _mm_set1_epi8((char) Needles.Return.rgb[ibReturnLast]);
+    const __m128i vErrorFirst = _mm_set1_epi8((char) bErrorFirst);
+    const __m128i vErrorLast = _mm_set1_epi8((char) Needles.Error.rgb[ibErrorLast]);
+
+    while ((ib + 16 <= ibEnd) && (ib + cbReach <= cb))
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*) (pb + ib));
+        __m128i fReturn = _mm_and_si128(_mm_cmpeq_epi8(v, vReturnFirst),
+                                        _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) (pb + ib + ibReturnLast)), vReturnLast));
+        __m128i fError = _mm_and_si128(_mm_cmpeq_epi8(v, vErrorFirst),
+                                       _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) (pb + ib + ibErrorLast)), vErrorLast));
+        unsigned int uMask = (unsigned int) _mm_movemask_epi8(_mm_or_si128(fReturn, fError));
+        while (uMask)
+        {
+            CountMark(pb, ib + LowestBit(uMask), cb, Needles, pResult);
+            uMask &= uMask - 1;
+        }
+        ib += 16;
+    }
+#endif
+
+    for (; ib < ibEnd; ib++)
+    {
+        if ((bReturnFirst == pb[ib]) || (bErrorFirst == pb[ib]))
+            CountMark(pb, ib, cb, Needles, pResult);
+    }
+}
+
+void ScanLogBuffer(const BYTE* pbBuffer, size_t cbBuffer, bool fUnicode, DWORD rgcMark[cLogMarks])
+{
+    LOGNEEDLES Needles;
+    MakeNeedles(fUnicode, &Needles);
+    LOGPIECERESULT Result;
+    ScanRange(pbBuffer, cbBuffer, 0, cbBuffer, Needles, &Result);
+    memcpy(rgcMark, Result.rgcMark, sizeof(Result.rgcMark));
+}
+
+// the failure's line and the lines before it, as text.
+static void CopyFailureContext(const BYTE* pb, size_t cb, size_t ibFailure, bool fUnicode, TCHAR* szContext, DWORD cchContext)
+{
+    const DWORD cbChar = (fUnicode) ? 2 : 1;
+    const size_t ibFirstChar = (fUnicode) ? 2 : 0;     // after the byte order mark
+    size_t ibLimit = (ibFailure > ibFirstChar + CBContextBack) ? ibFailure - CBContextBack : ibFirstChar;
+
+    size_t ibStart = ibFailure;
+    DWORD cNewlines = 0;
+    while (ibStart > ibLimit)
+    {
+        ibStart -= cbChar;
+        if (('\n' == CharAt(pb, ibStart, cb, cbChar, 0)) && (++cNewlines == CLogFailureContextLines))
+        {
+            ibStart += cbChar;
+            break;
+        }
+    }
+
+    size_t ibEnd = ibFailure;
+    size_t ibEndLimit = (cb - ibFailure > CBContextForward) ? ibFailure + CBContextForward : cb;
+    while ((ibEnd + cbChar <= ibEndLimit) && ('\n' != CharAt(pb, ibEnd, cb, cbChar, 0)))
+        ibEnd += cbChar;
+
+    DWORD ich = 0;
+    for (size_t ib = ibStart; (ib < ibEnd) && (ich + 1 < cchContext); ib += cbChar)
+    {
+        int ch = CharAt(pb, ib, cb, cbChar, 0);
+        if ('\r' == ch)
+            continue;
+        szContext[ich++] = (ch < 0) ? '?' : (TCHAR) ch;
+    }
+    szContext[ich] = 0;
+}
+
+//____________________________________________________________________________
+//
+// Files
+//____________________________________________________________________________
+
+struct MAPPEDLOG {
+    const BYTE* pb;
+    size_t      cb;
+};
+
+static UINT MapLogFile(const TCHAR* szPath, MAPPEDLOG* pMap)
+{
+    pMap->pb = NULL;
+    pMap->cb = 0;
+
+#ifdef _WIN32
+    // msiexec may still be writing it.
+    HANDLE hFile = CreateFile(szPath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (INVALID_HANDLE_VALUE == hFile)
+        return GetLastError();
+
+    DWORD cbFileHigh = 0;
+    DWORD cbFile = GetFileSize(hFile, &cbFileHigh);
+    unsigned __int64 cbFile64 = ((unsigned __int64) cbFileHigh << 32) | cbFile;
+    if ((INVALID_FILE_SIZE == cbFile) && (NO_ERROR != GetLastError()))
+    {
+        UINT uiError = GetLastError();
+        CloseHandle(hFile);
+        return uiError;
+    }
+    if ((size_t) cbFile64 != cbFile64)
+    {
+        CloseHandle(hFile);
+        return ERROR_NOT_ENOUGH_MEMORY;         // bigger than this process can map
+    }
+    if (0 == cbFile64)
+    {
+        CloseHandle(hFile);
+        return ERROR_SUCCESS;
+    }
+
+    HANDLE hMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    UINT uiError = (hMapping) ? ERROR_SUCCESS : GetLastError();
+    CloseHandle(hFile);
+    if (!hMapping)
+        return uiError;
+    pMap->pb = (const BYTE*) MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+    if (!pMap->pb)
+        uiError = GetLastError();
+    CloseHandle(hMapping);
+    if (!pMap->pb)
+        return uiError;
+    pMap->cb = (size_t) cbFile64;
+#else
+    int fd = open(szPath, O_RDONLY);
+    if (fd < 0)
+        return ERROR_FILE_NOT_FOUND;
+
+    struct stat st;
+    if ((0 != fstat(fd, &st)) || ((size_t) st.st_size != (unsigned long long) st.st_size))
+    {
+        close(fd);
+        return ERROR_INVALID_DATA;
+    }
+    if (0 == st.st_size)
+    {
+        close(fd);
+        return ERROR_SUCCESS;
+    }
+
+    void* pv = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (MAP_FAILED == pv)
+        return ERROR_NOT_ENOUGH_MEMORY;
+    madvise(pv, (size_t) st.st_size, MADV_SEQUENTIAL);
+    pMap->pb = (const BYTE*) pv;
+    pMap->cb = (size_t) st.st_size;
+#endif
+    return ERROR_SUCCESS;
+}
+
+static void UnmapLogFile(MAPPEDLOG* pMap)
+{
+    if (pMap->pb)
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(pMap->pb);
+#else
+        munmap((void*) pMap->pb, pMap->cb);
+#endif
+    }
+    pMap->pb = NULL;
+    pMap->cb = 0;
+}
+
+void JoinLogPath(const TCHAR* szDirectory, const TCHAR* szName, TCHAR* szPath, DWORD cchPath)
+{
+    size_t cchDirectory = lstrlen(szDirectory);
+    bool fSeparator = cchDirectory && ('\\' != szDirectory[cchDirectory - 1]) && ('/' != szDirectory[cchDirectory - 1]);
+#ifdef _WIN32
+    const TCHAR* szSeparator = (fSeparator) ? TEXT("\\") : TEXT("");
+#else
+    const TCHAR* szSeparator = (fSeparator) ? TEXT("/") : TEXT("");
+#endif
+    snprintf(szPath, cchPath, TEXT("%s%s%s"), szDirectory, szSeparator, szName);
+    szPath[cchPath - 1] = 0;
+}
+
+static bool AddLogEntry(LOGFILEENTRY** prgEntry, DWORD* pcEntries, DWORD* pcAllocated, const LOGFILEENTRY& Entry)
+{
+    if (*pcEntries == *pcAllocated)
+    {
+        DWORD cAllocated = (*pcAllocated) ? 2 * *pcAllocated : 32;
+        LOGFILEENTRY* rgEntry = (LOGFILEENTRY*) realloc(*prgEntry, cAllocated * sizeof(LOGFILEENTRY));
+        if (!rgEntry)
+            return false;
+        *prgEntry = rgEntry;
+        *pcAllocated = cAllocated;
+    }
+    (*prgEntry)[(*pcEntries)++] = Entry;
+    return true;
+}
+
+#ifndef _WIN32
+static int CompareLogEntries(const void* pv1, const void* pv2)
+{
+    return lstrcmpi(((const LOGFILEENTRY*) pv1)->szName, ((const LOGFILEENTRY*) pv2)->szName);
+}
+#endif
+
+UINT FindLogFiles(const TCHAR* szDirectory, LOGFILEENTRY** prgEntry, DWORD* pcEntries)
+{
+    *prgEntry = NULL;
+    *pcEntries = 0;
+    DWORD cAllocated = 0;
+    LOGFILEENTRY Entry;
+
+#ifdef _WIN32
+    TCHAR szSearch[MAX_PATH];
+    JoinLogPath(szDirectory, TEXT("msi*.log"), szSearch, MAX_PATH);
+
+    WIN32_FIND_DATA fd;
+    CCallTimer FirstTimer(tcFindFirstFile);
+    HANDLE hfff = FindFirstFile(szSearch, &fd);
+    FirstTimer.Stop();
+    BOOL fFoundFile = (INVALID_HANDLE_VALUE != hfff);
+    while (fFoundFile)
+    {
+        lstrcpyn(Entry.szName, fd.cFileName, MAX_PATH);
+        Entry.ftLastWrite = fd.ftLastWriteTime;
+        Entry.cbFile = ((unsigned __int64) fd.nFileSizeHigh << 32) | fd.nFileSizeLow;
+        if (!AddLogEntry(prgEntry, pcEntries, &cAllocated, Entry))
+        {
+            FindClose(hfff);
+            return ERROR_NOT_ENOUGH_MEMORY;
+        }
+        CCallTimer NextTimer(tcFindNextFile);
+        fFoundFile = FindNextFile(hfff, &fd);
+    }
+    if (INVALID_HANDLE_VALUE != hfff)
+        FindClose(hfff);
+#else
+    CCallTimer FirstTimer(tcFindFirstFile);
+    DIR* pDir = opendir(szDirectory);
+    FirstTimer.Stop();
+    if (!pDir)
+        return ERROR_FILE_NOT_FOUND;
+
+    for (;;)
+    {
+        CCallTimer NextTimer(tcFindNextFile);
+        struct dirent* pEntry = readdir(pDir);
+        NextTimer.Stop();
+        if (!pEntry)
+            break;
+
+        size_t cchName = lstrlen(pEntry->d_name);
+        if ((cchName < 7) || (cchName >= MAX_PATH) || (0 != _strnicmp(pEntry->d_name, TEXT("msi"), 3)) ||
+            (0 != lstrcmpi(pEntry->d_name + cchName - 4, TEXT(".log"))))
+            continue;
+
+        TCHAR szPath[MAX_PATH];
+        JoinLogPath(szDirectory, pEntry->d_name, szPath, MAX_PATH);
+        struct stat st;
+        if ((0 != stat(szPath, &st)) || !S_ISREG(st.st_mode))
+            continue;
+
+        lstrcpy(Entry.szName, pEntry->d_name);
+        Int64ToFileTime((__int64) st.st_mtime * 10000000 + FILETIMEUnixEpoch, &Entry.ftLastWrite);
+        Entry.cbFile = (unsigned __int64) st.st_size;
+        if (!AddLogEntry(prgEntry, pcEntries, &cAllocated, Entry))
+        {
+            closedir(pDir);
+            return ERROR_NOT_ENOUGH_MEMORY;
+        }
+    }
+    closedir(pDir);
+    if (*pcEntries)
+        qsort(*prgEntry, *pcEntries, sizeof(LOGFILEENTRY), CompareLogEntries);
+#endif
+    return ERROR_SUCCESS;
+}
+
+DWORD ProcessorCount()
+{
+#ifdef _WIN32
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    DWORD cProcessors = si.dwNumberOfProcessors;
+#else
+    long cOnline = sysconf(_SC_NPROCESSORS_ONLN);
+    DWORD cProcessors = (cOnline > 0) ? (DWORD) cOnline : 1;
+#endif
+    return (cProcessors < 1) ? 1 : (cProcessors > 64) ? 64 : cProcessors;
+}
+
+//____________________________________________________________________________
+//
+// The pool: every file cut into pieces, the pieces scanned in any order
+// and put back together by file.
+//____________________________________________________________________________
+
+struct LOGSCANPIECE {
+    DWORD           iFile;
+    size_t          ibStart;
+    size_t          ibEnd;
+    LOGPIECERESULT  Result;
+};
+
+struct LOGSCANSTATE {
+    MAPPEDLOG*      rgMap;
+    LOGNEEDLES      rgNeedles[2];       // ANSI, UTF-16
+    const LOGSCANRESULT* rgResult;
+    LOGSCANPIECE*   rgPiece;
+};
+
+static void ScanPiece(void* pvContext, DWORD iPiece)
+{
+    LOGSCANSTATE* pState = (LOGSCANSTATE*) pvContext;
+    LOGSCANPIECE& Piece = pState->rgPiece[iPiece];
+    const MAPPEDLOG& Map = pState->rgMap[Piece.iFile];
+    const LOGNEEDLES& Needles = pState->rgNeedles[(pState->rgResult[Piece.iFile].fUnicode) ? 1 : 0];
+    ScanRange(Map.pb, Map.cb, Piece.ibStart, Piece.ibEnd, Needles, &Piece.Result);
+}
+
+UINT ScanLogFiles(const TCHAR* szDirectory, const LOGFILEENTRY* rgEntry, DWORD cEntries, DWORD cThreads, LOGSCANRESULT* rgResult)
+{
+    LOGSCANSTATE State;
+    MakeNeedles(false, &State.rgNeedles[0]);
+    MakeNeedles(true, &State.rgNeedles[1]);
+    State.rgResult = rgResult;
+    State.rgPiece = NULL;
+    State.rgMap = (MAPPEDLOG*) calloc(cEntries + 1, sizeof(MAPPEDLOG));
+    if (!State.rgMap)
+        return ERROR_NOT_ENOUGH_MEMORY;
+
+    DWORD cPieces = 0;
+    for (DWORD iFile = 0; iFile < cEntries; iFile++)
+    {
+        LOGSCANRESULT& Result = rgResult[iFile];
+        memset(&Result, 0, sizeof(LOGSCANRESULT));
+        TCHAR szPath[MAX_PATH];
+        JoinLogPath(szDirectory, rgEntry[iFile].szName, szPath, MAX_PATH);
+        Result.uiError = MapLogFile(szPath, &State.rgMap[iFile]);
+
+        const MAPPEDLOG& Map = State.rgMap[iFile];
+        Result.fUnicode = (Map.cb >= 2) && (0xFF == Map.pb[0]) && (0xFE == Map.pb[1]);
+        cPieces += (DWORD) ((Map.cb + CBLogScanPiece - 1) / CBLogScanPiece);
+    }
+
+    UINT uiResult = ERROR_SUCCESS;
+    State.rgPiece = (LOGSCANPIECE*) calloc(cPieces + 1, sizeof(LOGSCANPIECE));
+    if (!State.rgPiece)
+        uiResult = ERROR_NOT_ENOUGH_MEMORY;
+
+    if (ERROR_SUCCESS == uiResult)
+    {
+        DWORD iPiece = 0;
+        for (DWORD iFile = 0; iFile < cEntries; iFile++)
+        {
+            for (size_t ib = 0; ib < State.rgMap[iFile].cb; ib += CBLogScanPiece)
+            {
+                LOGSCANPIECE& Piece = State.rgPiece[iPiece++];
+                Piece.iFile = iFile;
+                Piece.ibStart = ib;
+                Piece.ibEnd = (State.rgMap[iFile].cb - ib > CBLogScanPiece) ? ib + CBLogScanPiece : State.rgMap[iFile].cb;
+            }
+        }
+
+        if (!cThreads)
+            cThreads = ProcessorCount();
+        if (cThreads > cPieces)
+            cThreads = cPieces;
+
+        // no threads to be had, or no point: the pieces in turn on this one.
+        CWorkPool Pool;
+        if ((cThreads > 1) && Pool.Start(cThreads, cPieces, 0, ScanPiece, &State))
+            Pool.Finish();
+        else
+        {
+            for (iPiece = 0; iPiece < cPieces; iPiece++)
+                ScanPiece(&State, iPiece);
+        }
+
+        // pieces are in file order, and in order within a file, so a file's first mark is in its first piece with one.
+        for (iPiece = 0; iPiece < cPieces; iPiece++)
+        {
+            const LOGSCANPIECE& Piece = State.rgPiece[iPiece];
+            LOGSCANRESULT& Result = rgResult[Piece.iFile];
+            for (int lm = 0; lm < cLogMarks; lm++)
+                Result.rgcMark[lm] += Piece.Result.rgcMark[lm];
+            if (!Result.fFailure && (Piece.Result.lmFirst >= 0))
+            {
+                Result.fFailure = true;
+                Result.lmFirstFailure = (LOGMARK) Piece.Result.lmFirst;
+                Result.ibFirstFailure = Piece.Result.ibFirst;
+                const MAPPEDLOG& Map = State.rgMap[Piece.iFile];
+                CopyFailureContext(Map.pb, Map.cb, Piece.Result.ibFirst, Result.fUnicode, Result.szFirstFailure, CCHLogFailureContext);
+            }
+        }
+    }
+
+    for (DWORD iFile = 0; iFile < cEntries; iFile++)
+        UnmapLogFile(&State.rgMap[iFile]);
+    free(State.rgMap);
+    free(State.rgPiece);
+    return uiResult;
+}
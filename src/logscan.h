@@ -0,0 +1,78 @@
+/*---------------------------------------------------------------------------
+Installer log scan (-l -scanlogs).
+
+    -l lists the msi*.log files in the temp directories; -scanlogs also
+    reads every one of them for the marks an install leaves when it fails:
+
+        Return value 3      an action failed
+        Error 1603          fatal error during installation
+        Error 17xx          the 1700s: product, patch and source errors
+
+    and reports how many of each a log holds, and the lines around the
+    first.  Temp directories collect gigabytes of verbose logs, so the
+    files are mapped rather than read, cut into 16MB pieces, and the
+    pieces scanned on a pool of threads (workpool.h).  The scan looks for
+    the first and last character of each mark 16 bytes at a time with SSE2
+    where the compiler has it, and compares the whole mark only where both
+    are in place.
+
+    Logs written as UTF-16 (a byte order mark at the start) are scanned
+    for the marks in UTF-16.
+
+    FindLogFiles is the listing's directory walk, on FindFirstFile on
+    Windows and readdir elsewhere, so a directory of sample logs can be
+    scanned anywhere (-logdir).
+---------------------------------------------------------------------------*/
+
+#ifndef LOGSCAN_H
+#define LOGSCAN_H
+
+#include "msiport.h"
+
+enum LOGMARK {
+    lmReturnValue3,
+    lmError1603,
+    lmError17xx,
+    cLogMarks
+};
+
+extern const TCHAR* const LogMarkNames[cLogMarks];     // "Return value 3", ...
+
+const DWORD CCHLogFailureContext = 768;
+const DWORD CLogFailureContextLines = 3;               // the first failure's line and two before it
+
+struct LOGFILEENTRY {
+    TCHAR               szName[MAX_PATH];
+    FILETIME            ftLastWrite;
+    unsigned __int64    cbFile;
+};
+
+struct LOGSCANRESULT {
+    UINT                uiError;                        // mapping the file
+    bool                fUnicode;
+    DWORD               rgcMark[cLogMarks];
+    bool                fFailure;                       // any mark at all
+    LOGMARK             lmFirstFailure;
+    unsigned __int64    ibFirstFailure;
+    TCHAR               szFirstFailure[CCHLogFailureContext];   // lines separated by '\n'
+};
+
+// msi*.log in szDirectory, in the order the directory gives them (sorted by
+// name off Windows.)  *prgEntry is malloc'd; free() it.
+UINT  FindLogFiles(const TCHAR* szDirectory, LOGFILEENTRY** prgEntry, DWORD* pcEntries);
+
+// szDirectory and szName joined by the platform's separator.
+void  JoinLogPath(const TCHAR* szDirectory, const TCHAR* szName, TCHAR* szPath, DWORD cchPath);
+
+// scans every file on cThreads threads (0 - one per processor); rgResult has
+// cEntries.  Fails only when out of memory; a file that cannot be read has
+// its own uiError.
+UINT  ScanLogFiles(const TCHAR* szDirectory, const LOGFILEENTRY* rgEntry, DWORD cEntries, DWORD cThreads, LOGSCANRESULT* rgResult);
+
+// the same scan over one buffer, for -bench logscan; cbBuffer bytes, with
+// the marks counted into rgcMark.
+void  ScanLogBuffer(const BYTE* pbBuffer, size_t cbBuffer, bool fUnicode, DWORD rgcMark[cLogMarks]);
+
+DWORD ProcessorCount();
+
+#endif // LOGSCAN_H
@@ -13,9 +13,17 @@ Feature list:
             all keypaths for each product
                 registry key path:
                     checks for key existence, and last write date (NT)
+                    each key opened from an ancestor kept open, through a
+                    trie of the keys probed (regkeys.h), or from a .reg
+                    export (-registry, standinreg.h)
                 file key path:
                     checks for file existence, owner (NT), attributes,
                     application marking, file size, create and modify dates
+                    version and binary type from one open of the file,
+                    reading its headers and resource section (peimage.h)
+                    existence, attributes, size and dates from one listing
+                    of each keypath's directory (dircache.h)
+                keypaths are probed through the provider (keypath.h)
             summary for component states of this product
     Component evaluation
         Shows all shared components (any product.)  Shows all products
@@ -26,51 +34,100 @@ Feature list:
     Shows location and file names of all logs.
         NT:  machine temp, user temp
         9x:  only one temp.
+        or any one directory (-logdir)
+        Failures in each log counted, files mapped and scanned on a
+        pool of threads (-scanlogs, logscan.h)
+        Time taken by each action in a verbose log, by phase, read in one
+        pass through one buffer (-profile, actprofile.h)
     Dumps event log
-        NT:  All events with source = MsiInstaller
+        NT:  All events with source = MsiInstaller, read in 64K batches
+             (eventlog.h), optionally only those since a time (-since)
         9x:  from temp\msievent.log
+        Recorded to a dump file (-recordevents) and listed from one
+        anywhere (-events)
+        Only the events logged since the last run, through a state file
+        (-eventstate)
+        Joined to the products by code and name in one pass, each product
+        showing its last install, repair or uninstall (-productevents,
+        eventjoin.h)
+    Installer data comes through a provider (installerdata.h)
+        live:       this machine's Windows Installer
+        synthetic:  generated inventory of any size, for scaling runs (-synthetic)
+        replay:     snapshot recorded with -record, reported on anywhere (-replay)
+    Binary columnar snapshot for fleet analysis, read in place through a
+    file mapping (-o, binsnap.h)
+    Changes between two binary snapshots, for nightly runs (-diff)
+    Products enriched by a pool of workers, reported in enumeration order (-j)
+    Keypaths probed ahead of the report on a pool of threads, optionally
+    against a stand-in file system for load tests (-probe)
+    Each keypath probed once per run, however many products list it (-t
+    shows the cache's hits and misses)
+    Each owner's account looked up once per run, with an optional timeout
+    (-sidtimeout)
+    Report written through one large buffer rather than printf per line
+    (outsink.h)
+    NDJSON records instead of the text report, for log pipelines (-json,
+    jsonout.h)
+    Installer strings asked for at whatever length they are, kept in a
+    per-run arena (infoquery.h, strarena.h)
+    Client and product codes matched as 16-byte keys (guidkey.h)
+    -p takes a watch-list of codes and names, many times or from a file
+    (prodfilter.h)
+    Benchmarks of the inventory algorithms against generated inventories (-bench)
+    Installer and Win32 calls counted and timed by phase, with latency
+    histograms (-t, callcount.h), and every report run against growing
+    generated inventories to catch calls growing faster than the
+    inventory (-bench scaling)
+    Timeline of the run's stages and of each worker's products and probes,
+    as Chrome trace events recorded into per-thread rings (-trace, trace.h)
 
 
 TODO:
-    Re-do fixed size buffers
     Make the date formatting support locale
     Consider breaking it into more function
 
 ---------------------------------------------------------------------------*/
 
 
-#include <windows.h>
-#define _WIN32_MSI 110
-#include "msi.h"
+#include "msiport.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <assert.h>
 #include <time.h>
-#include <userenv.h>
+#include "installerdata.h"
+#include "keypath.h"
+#include "compindex.h"
+#include "guidset.h"
+#include "prodfilter.h"
+#include "replay.h"
+#include "binsnap.h"
+#include "snapdiff.h"
+#include "enrich.h"
+#include "probepool.h"
+#include "standinfs.h"
+#include "standinreg.h"
+#include "probecache.h"
+#include "acctcache.h"
+#include "outsink.h"
+#include "jsonout.h"
+#include "infoquery.h"
+#include "eventlog.h"
+#include "eventjoin.h"
+#include "logscan.h"
+#include "actprofile.h"
+#include "callcount.h"
+#include "trace.h"
+#include "bench.h"
 
 #define Pluralize(X) ((1 == X) ? TEXT("") : TEXT("s"))
 
-#define MinimumPlatform(fWin9X, minMajor, minMinor) ((g_fWin9X == fWin9X) && ((minMajor < g_osviVersion.dwMajorVersion) || ((minMajor == g_osviVersion.dwMajorVersion) && (minMinor <= g_osviVersion.dwMinorVersion))))
-
-// make sure that the help file gets update as new platform values are added.
-#define MinimumPlatformWindowsNT51() MinimumPlatform(false, 5, 1)
-#define MinimumPlatformWindows2000() MinimumPlatform(false, 5, 0)
-#define MinimumPlatformWindowsNT4()  MinimumPlatform(false, 4, 0)
-
-#define MinimumPlatformMillennium()  MinimumPlatform(true,  4, 90)
-#define MinimumPlatformWindows98()   MinimumPlatform(true,  4, 10)
-#define MinimumPlatformWindows95()   MinimumPlatform(true,  4, 0)
-
-const int CCHProductInfo = 1024;
 const int CCHFeatureName = 256;
-const int SD_SIZE = 1024;
-const int NAME_SIZE = 256;
 const int COUNTAllowedInstallStates = (int) INSTALLSTATE_DEFAULT - (int) INSTALLSTATE_NOTUSED; // the feature states are an enum with no size entry.
 const int AllowedInstallStatesOffset = - (int) INSTALLSTATE_NOTUSED;
-const int CCHGuid = 39;  // GUID + NULL
-const TCHAR SZPermanentProduct[CCHGuid] = TEXT("{00000000-0000-0000-0000-000000000000}");
 
 OSVERSIONINFO   g_osviVersion;
 bool            g_fWin9X = false;
+CInstallerData* g_pInstallerData = NULL;
 
 struct INSTALLSTATENAMES {
     INSTALLSTATE IS;
@@ -136,8 +193,11 @@ enum EOutputLevel {
     
 };
 
-void ErrorUINT(UINT uiValue, TCHAR* szMessage)
+void ErrorUINT(UINT uiValue, const TCHAR* szMessage)
 {
+    g_Out.Flush();
+    if (g_pJsonOut)
+        g_pJsonOut->Flush();
     fprintf(stderr, TEXT("Unexpected error: %d (%s)\n"), uiValue, (szMessage) ? szMessage : TEXT(""));
 }
 
@@ -147,33 +207,110 @@ inline void CheckError(UINT uiValue)
         ErrorUINT(uiValue, 0);
 }
 
-void PrintEventLogTimeGenerated(EVENTLOGRECORD *pevlr)
+void PrintEventLogTime(DWORD dwTime)
 {
-    // from MSDN
     FILETIME FileTime, LocalFileTime;
     SYSTEMTIME SysTime;
-    __int64 lgTemp;
-    __int64 SecsTo1970 = 116444736000000000;
 
-    lgTemp = Int32x32To64(pevlr->TimeGenerated,10000000) + SecsTo1970;
+    EventLogTimeToFileTime(dwTime, &FileTime);
+
+    if (!FileTimeToLocalFileTime(&FileTime, &LocalFileTime) || !FileTimeToSystemTime(&LocalFileTime, &SysTime))
+        memset(&SysTime, 0, sizeof(SysTime));
+
+    g_Out.UInt(SysTime.wYear, 2, '0');
+    g_Out.Char('/');
+    g_Out.UInt(SysTime.wMonth, 2, '0');
+    g_Out.Char('/');
+    g_Out.UInt(SysTime.wDay, 2, '0');
+    g_Out.Char(' ');
+    g_Out.UInt(SysTime.wHour, 2, '0');
+    g_Out.Char(':');
+    g_Out.UInt(SysTime.wMinute, 2, '0');
+    g_Out.Char(':');
+    g_Out.UInt(SysTime.wSecond, 2, '0');
+}
 
-    FileTime.dwLowDateTime = (DWORD) lgTemp;
-    FileTime.dwHighDateTime = (DWORD)(lgTemp >> 32);
+void PrintEventLogTimeGenerated(const EVENTLOGRECORD *pevlr)
+{
+    PrintEventLogTime(pevlr->TimeGenerated);
+}
 
-    FileTimeToLocalFileTime(&FileTime, &LocalFileTime);
-    FileTimeToSystemTime(&LocalFileTime, &SysTime);
+// the MsiInstaller records, newest first, down to the reader's cutoff.
+void PrintMsiEvents(CEventLogReader& Reader)
+{
+    const EVENTLOGRECORD *pevlr;
+    while (NULL != (pevlr = Reader.Next()))
+    {
+        const TCHAR* szSource = (const TCHAR*) ((const BYTE*) pevlr + sizeof(EVENTLOGRECORD));
+        if (0 != _stricmp(szSource, TEXT("MsiInstaller")))
+            continue;
+
+        PrintEventLogTimeGenerated(pevlr);
+
+        g_Out.Printf(TEXT(" Type: "));
+        if (0 == pevlr->EventType)
+            g_Out.Printf(TEXT("SUCCESS     "));
+        if (EVENTLOG_ERROR_TYPE & (pevlr->EventType))
+            g_Out.Printf(TEXT("ERROR       "));
+        if (EVENTLOG_INFORMATION_TYPE & (pevlr->EventType))
+            g_Out.Printf(TEXT("INFORMATION "));
+        if (EVENTLOG_WARNING_TYPE & (pevlr->EventType))
+            g_Out.Printf(TEXT("WARNING     "));
+        if (EVENTLOG_AUDIT_SUCCESS & (pevlr->EventType))
+            g_Out.Printf(TEXT("AUDIT_SUCCESS "));
+        if (EVENTLOG_AUDIT_FAILURE & (pevlr->EventType))
+            g_Out.Printf(TEXT("AUDIT_FAILURE "));
+
+        g_Out.Printf(TEXT("Event ID: 0x%08X "),  pevlr->EventID);
+        g_Out.Printf(TEXT("Source: %s\n"), szSource); 
+
+        const TCHAR* szMessage = ((const TCHAR*) pevlr) + (unsigned int)pevlr->UserSidOffset + (unsigned int)pevlr->UserSidLength;
+        g_Out.Printf(TEXT("\t%s\n"), szMessage);
+
+        FILETIME ftGenerated;
+        EventLogTimeToFileTime(pevlr->TimeGenerated, &ftGenerated);
+        CJsonRecord Event(g_pJsonOut, TEXT("event"));
+        Event.Time(TEXT("time"), ftGenerated);
+        Event.UInt(TEXT("eventType"), pevlr->EventType);
+        Event.UInt(TEXT("eventId"), pevlr->EventID);
+        Event.String(TEXT("source"), szSource);
+        Event.String(TEXT("message"), szMessage);
+        Event.End();
+    }
+}
 
-    printf("%02d/%02d/%02d %02d:%02d:%02d",
-        SysTime.wYear,
-        SysTime.wMonth,
-        SysTime.wDay,
-      
-        SysTime.wHour,
-        SysTime.wMinute,
-        SysTime.wSecond);
+// -productevents: the last install, repair or uninstall of one product, and its failures.
+void PrintProductEvents(const CProductEventIndex& Index, const TCHAR* szProductCode, const TCHAR* szProductName, CJsonRecord& Product)
+{
+    GUIDKEY ProductKey;
+    MakeGuidKey(szProductCode, &ProductKey);
+    PRODUCTEVENTS Events;
+    if (!Index.Find(ProductKey, szProductName, &Events))
+    {
+        g_Out.Printf(TEXT("\tEvents:\t\tnone\n"));
+        Product.UInt(TEXT("events"), 0);
+        return;
+    }
+
+    if (eaNone != Events.eaLast)
+    {
+        g_Out.Printf(TEXT("\tLast event:\t"));
+        PrintEventLogTime(Events.dwLastTime);
+        g_Out.Printf(TEXT("  %s%s (%u)\n"), EventActionNames[Events.eaLast], (Events.fLastFailed) ? TEXT(" failed") : TEXT(""), Events.dwLastEventId);
+
+        FILETIME ftLast;
+        EventLogTimeToFileTime(Events.dwLastTime, &ftLast);
+        Product.String(TEXT("lastEvent"), EventActionNames[Events.eaLast]);
+        Product.Bool(TEXT("lastEventFailed"), Events.fLastFailed);
+        Product.Time(TEXT("lastEventTime"), ftLast);
+        Product.UInt(TEXT("lastEventId"), Events.dwLastEventId);
+    }
+    g_Out.Printf(TEXT("\tEvents:\t\t%u, %u failure%s\n"), Events.cEvents, Events.cFailures, Pluralize(Events.cFailures));
+    Product.UInt(TEXT("events"), Events.cEvents);
+    Product.UInt(TEXT("failedEvents"), Events.cFailures);
 }
 
-void PrintLocalFileTime(FILETIME& ft, bool fTime)
+void PrintLocalFileTime(const FILETIME& ft, bool fTime)
 {
     FILETIME LocalTime;
     SYSTEMTIME SystemTime;
@@ -183,25 +320,171 @@ void PrintLocalFileTime(FILETIME& ft, bool fTime)
         if (FileTimeToSystemTime(&LocalTime, &SystemTime))
         {
 
-            printf(TEXT("%02d\\%02d\\%02d"),
-                SystemTime.wYear, SystemTime.wMonth, SystemTime.wDay); 
-                
+            g_Out.UInt(SystemTime.wYear, 2, '0');
+            g_Out.Char('\\');
+            g_Out.UInt(SystemTime.wMonth, 2, '0');
+            g_Out.Char('\\');
+            g_Out.UInt(SystemTime.wDay, 2, '0');
+
             if (fTime)
             {
-                printf(TEXT("  %02d:%02d:%02d"), 
-                    SystemTime.wHour, SystemTime.wMinute, SystemTime.wSecond);
+                g_Out.Str(TEXT("  "));
+                g_Out.UInt(SystemTime.wHour, 2, '0');
+                g_Out.Char(':');
+                g_Out.UInt(SystemTime.wMinute, 2, '0');
+                g_Out.Char(':');
+                g_Out.UInt(SystemTime.wSecond, 2, '0');
+            }
+        }
+    }
+}
+
+// the msi*.log files in szDirectory; with -scanlogs, the failures in each.
+void PrintLogDirectory(const TCHAR* szDirectory, bool fScanLogs, DWORD cScanThreads)
+{
+    LOGFILEENTRY* rgEntry = NULL;
+    DWORD cEntries = 0;
+    CTraceSpan Span(TEXT("log directory"), TEXT("directory"), szDirectory);
+    if (ERROR_SUCCESS != FindLogFiles(szDirectory, &rgEntry, &cEntries))
+        return;
+
+    LOGSCANRESULT* rgResult = NULL;
+    if (fScanLogs && cEntries)
+    {
+        CTraceSpan ScanSpan(TEXT("scan logs"), TEXT("directory"), szDirectory);
+        rgResult = (LOGSCANRESULT*) calloc(cEntries, sizeof(LOGSCANRESULT));
+        if (rgResult && (ERROR_SUCCESS != ScanLogFiles(szDirectory, rgEntry, cEntries, cScanThreads, rgResult)))
+        {
+            free(rgResult);
+            rgResult = NULL;
+        }
+        if (!rgResult)
+            ErrorUINT(ERROR_NOT_ENOUGH_MEMORY, TEXT("scanning log files"));
+    }
+
+    for (DWORD iEntry = 0; iEntry < cEntries; iEntry++)
+    {
+        const LOGFILEENTRY& Entry = rgEntry[iEntry];
+        g_Out.Printf(TEXT("\t%-20s "), Entry.szName);
+        PrintLocalFileTime(Entry.ftLastWrite, true);
+        g_Out.Printf(TEXT("\n"));
+
+        CJsonRecord LogFile(g_pJsonOut, TEXT("logfile"));
+        LogFile.String(TEXT("directory"), szDirectory);
+        LogFile.String(TEXT("file"), Entry.szName);
+        LogFile.Time(TEXT("changed"), Entry.ftLastWrite);
+
+        if (rgResult)
+        {
+            const LOGSCANRESULT& Result = rgResult[iEntry];
+            LogFile.UInt64(TEXT("size"), Entry.cbFile);
+            if (ERROR_SUCCESS != Result.uiError)
+            {
+                g_Out.Printf(TEXT("\t\tcannot read: %d\n"), Result.uiError);
+                LogFile.UInt(TEXT("error"), Result.uiError);
+            }
+            else
+            {
+                g_Out.Printf(TEXT("\t\t%llu bytes%s: "), (unsigned long long) Entry.cbFile, (Result.fUnicode) ? TEXT(" (UTF-16)") : TEXT(""));
+                if (!Result.fFailure)
+                    g_Out.Printf(TEXT("no failures\n"));
+                else
+                {
+                    for (int lm = 0; lm < cLogMarks; lm++)
+                        g_Out.Printf(TEXT("%s%u %s"), (lm) ? TEXT(", ") : TEXT(""), Result.rgcMark[lm], LogMarkNames[lm]);
+                    g_Out.Printf(TEXT("; first at byte %llu:\n"), (unsigned long long) Result.ibFirstFailure);
+
+                    const TCHAR* pchLine = Result.szFirstFailure;
+                    while (*pchLine)
+                    {
+                        const TCHAR* pchEnd = strchr(pchLine, '\n');
+                        int cchLine = (pchEnd) ? (int) (pchEnd - pchLine) : lstrlen(pchLine);
+                        g_Out.Str(TEXT("\t\t\t"));
+                        g_Out.Write(pchLine, cchLine);
+                        g_Out.Char('\n');
+                        pchLine += cchLine + ((pchEnd) ? 1 : 0);
+                    }
+                }
+
+                LogFile.Bool(TEXT("unicode"), Result.fUnicode);
+                LogFile.UInt(TEXT("returnValue3"), Result.rgcMark[lmReturnValue3]);
+                LogFile.UInt(TEXT("error1603"), Result.rgcMark[lmError1603]);
+                LogFile.UInt(TEXT("error17xx"), Result.rgcMark[lmError17xx]);
+                if (Result.fFailure)
+                {
+                    LogFile.String(TEXT("firstFailureMark"), LogMarkNames[Result.lmFirstFailure]);
+                    LogFile.UInt64(TEXT("firstFailureOffset"), Result.ibFirstFailure);
+                    LogFile.String(TEXT("firstFailure"), Result.szFirstFailure);
+                }
             }
         }
+        LogFile.End();
     }
+
+    free(rgResult);
+    free(rgEntry);
+}
+
+// -t: every timed call, by phase, and its latencies over the whole run.  The number of calls.
+DWORD PrintCallTimes()
+{
+    g_Out.Printf(TEXT("Calls by phase:\n"));
+    DWORD cCalls = 0;
+    unsigned __int64 usCalls = 0;
+    for (int cp = 0; cp < cCallPhases; cp++)
+    {
+        bool fPhase = false;
+        for (int tc = 0; tc < cTimedCalls; tc++)
+        {
+            CALLSTATS Stats;
+            GetCallStats((CALLPHASE) cp, (TIMEDCALL) tc, &Stats);
+            if (!Stats.cCalls)
+                continue;
+            if (!fPhase)
+                g_Out.Printf(TEXT("\t%-28s %10s %12s %12s\n"), CallPhaseNames[cp], TEXT("calls"), TEXT("total ms"), TEXT("mean us"));
+            fPhase = true;
+            g_Out.Printf(TEXT("\t  %-26s %10u %12.3f %12.3f\n"), TimedCallNames[tc], Stats.cCalls,
+                Stats.usTotal / 1000.0, (double) Stats.usTotal / Stats.cCalls);
+            cCalls += Stats.cCalls;
+            usCalls += Stats.usTotal;
+
+            CJsonRecord Calls(g_pJsonOut, TEXT("calls"));
+            Calls.String(TEXT("phase"), CallPhaseNames[cp]);
+            Calls.String(TEXT("call"), TimedCallNames[tc]);
+            Calls.UInt(TEXT("count"), Stats.cCalls);
+            Calls.UInt64(TEXT("microseconds"), Stats.usTotal);
+            Calls.End();
+        }
+    }
+    g_Out.Printf(TEXT("\t%-28s %10u %12.3f\n"), TEXT("all"), cCalls, usCalls / 1000.0);
+
+    g_Out.Printf(TEXT("Call latencies (calls under each time, in powers of two):\n"));
+    for (int tc = 0; tc < cTimedCalls; tc++)
+    {
+        CALLSTATS Stats;
+        GetCallStats(cCallPhases, (TIMEDCALL) tc, &Stats);
+        if (!Stats.cCalls)
+            continue;
+        g_Out.Printf(TEXT("\t%-28s"), TimedCallNames[tc]);
+        for (DWORD iBucket = 0; iBucket < CLatencyBuckets; iBucket++)
+        {
+            if (Stats.rgcBucket[iBucket])
+                g_Out.Printf(TEXT(" %s:%u"), LatencyBucketName(iBucket), Stats.rgcBucket[iBucket]);
+        }
+        g_Out.Printf(TEXT("\n"));
+    }
+    return cCalls;
 }
 
 void SetPlatformInfo(void)
 {
+#ifdef _WIN32
     g_osviVersion.dwOSVersionInfoSize = sizeof(OSVERSIONINFO);
     GetVersionEx(&g_osviVersion);
     
     if(g_osviVersion.dwPlatformId == VER_PLATFORM_WIN32_WINDOWS)
         g_fWin9X = true;
+#endif
 }
 
 int GetInstallStateStringIndex(INSTALLSTATE IS)
@@ -217,276 +500,573 @@ int GetInstallStateStringIndex(INSTALLSTATE IS)
         return 0;
 }
 
-void OwnerPrint(PSECURITY_DESCRIPTOR pSD)
+void OwnerPrint(const KEYPATHPROBE& Probe)
 {
-    // prints the owner of the security descriptor - can be from any secured object,
+    // prints the owner recorded by the probe - can be from any secured object,
     // file, registry key, directory, et cetera.
 
-    byte pbSID[SD_SIZE];
-    PSID psid = pbSID;
-    BOOL fOwnerDefaulted = FALSE;
+    switch (Probe.osOwner)
+    {
+        case osNoOwner:
+            g_Out.Printf("No owner");
+            break;
+        case osUnreadable:
+            g_Out.Printf("Cannot retrieve Owner (%d)", Probe.dwOwnerError);
+            break;
+        case osDefaulted:
+            g_Out.Printf("Owner Defaulted");
+            break;
+        case osLookupFailed:
+            g_Out.Printf("Cannot lookup owner (%d)", Probe.dwOwnerError);
+            break;
+        case osResolved:
+            g_Out.Printf("%s", Probe.szOwner);
+            break;
+        default:
+            break;
+    }
+}
+
+// everything the report prints about a keypath, from its probe.
+void PrintKeyPathProbe(const KEYPATHPROBE& Probe)
+{
+    if (Probe.fRegistry)
+    {
+        if (Probe.fRegistryRoot)
+        {
+            if (ERROR_SUCCESS == Probe.dwRegistryError)
+            {
+                g_Out.Printf(TEXT("\t\tKey exists  "));
+                // security
+                if (osNotRead != Probe.osOwner)
+                {
+                    g_Out.Printf("Owner: ");
+                    OwnerPrint(Probe);
+                }
+            
+                if (Probe.fLastWriteTime)
+                {
+                
+                    g_Out.Printf(TEXT("\n\t\tLast write time: ")); 
+                    PrintLocalFileTime(Probe.ftLastWriteTime, true);
+                }
+                g_Out.Printf("\n");
+
+            }
+            else
+            {
+                g_Out.Printf(TEXT("\t\tError checking for key: "));
+                switch(Probe.dwRegistryError)
+                {
+                    case ERROR_ACCESS_DENIED:
+                        g_Out.Printf(TEXT("access denied"));
+                        break;
+                    case ERROR_FILE_NOT_FOUND:
+                        g_Out.Printf(TEXT("key not found"));
+                        break;
+                    default:
+                        g_Out.Printf(TEXT("unknown error: %d"), Probe.dwRegistryError);
 
-    if ((!GetSecurityDescriptorOwner(pSD, ((PSID*) &psid), &fOwnerDefaulted)) || (!IsValidSid(psid)))
+                }
+                g_Out.Printf(TEXT("\n"));
+            }
+        }        
+    }
+    else
     {
-        if (NULL == psid)
+        DWORD dwAttrib = Probe.dwAttributes;
+
+        if (ERROR_SUCCESS == Probe.uiVersionResult)
         {
-            printf("No owner");
+            g_Out.Printf(TEXT("\t\tVersion: %s"), Probe.szVersion);
+            if (*Probe.szLanguage)
+                g_Out.Printf(TEXT(",\tLanguage: %s  "), Probe.szLanguage); 
+        
+            g_Out.Printf(TEXT("\n"));
         }
         else
         {
-            printf("Cannot retrieve Owner (%d)", GetLastError());
+            switch (Probe.uiVersionResult)
+            {    
+                case ERROR_FILE_NOT_FOUND:
+                    if ((0xFFFFFFFF != dwAttrib) && (dwAttrib & FILE_ATTRIBUTE_DIRECTORY))
+                        g_Out.Printf(TEXT("\t\tDirectory exists.\n"));
+                    else
+                         g_Out.Printf(TEXT("\t\tFile or directory not found.\n"));
+                    break;
+                case ERROR_ACCESS_DENIED:
+                    g_Out.Printf(TEXT("\t\tAccess denied for version information.\n"));
+                    break;
+                case ERROR_FILE_INVALID:
+                    g_Out.Printf(TEXT("\t\tNo version information.\n"));
+                    break;
+                case ERROR_INVALID_DATA:
+                    g_Out.Printf(TEXT("\t\tVersion information invalid.\n"));
+                    break;
+                default:
+                    g_Out.Printf(TEXT("\t\tUnexpected error reading version information.\n"));
+            }
+        }
+
+        if (osNotRead != Probe.osOwner)
+        {
+            g_Out.Printf(TEXT("\t\tOwner: "));
+            OwnerPrint(Probe);
+            g_Out.Printf("\n");
+        }
+
+        if (0xFFFFFFFF != dwAttrib)
+        {
+            g_Out.Printf(TEXT("\t\tAttributes: "));
+
+            if (Probe.fBinaryType)
+            {
+                switch(Probe.dwBinaryType)
+                {
+                    case SCS_32BIT_BINARY:
+                        g_Out.Printf(TEXT("WIN32-APP "));
+                        break;
+                    case SCS_64BIT_BINARY:
+                        g_Out.Printf(TEXT("WIN64-APP "));
+                        break;    
+                    case SCS_DOS_BINARY:
+                        g_Out.Printf(TEXT("DOS-APP "));
+                        break;
+                    case SCS_OS216_BINARY:
+                        g_Out.Printf(TEXT("OS2-16BIT-APP "));
+                        break;
+                    case SCS_PIF_BINARY:
+                        g_Out.Printf(TEXT("PIF "));
+                        break;
+                    case SCS_POSIX_BINARY:
+                        g_Out.Printf(TEXT("POSIX-APP "));
+                        break;
+                    case SCS_WOW_BINARY:
+                        g_Out.Printf(TEXT("WIN16-APP "));
+                        break;
+                    default:
+                        g_Out.Printf(TEXT("Binary type(%d) "), Probe.dwBinaryType);
+                        break;
+                }
+            }
+
+            if (dwAttrib & FILE_ATTRIBUTE_ARCHIVE) g_Out.Printf(TEXT("ARCHIVE "));
+            if (dwAttrib & FILE_ATTRIBUTE_SYSTEM) g_Out.Printf(TEXT("SYSTEM "));
+            if (dwAttrib & FILE_ATTRIBUTE_HIDDEN) g_Out.Printf(TEXT("HIDDEN "));
+            if (dwAttrib & FILE_ATTRIBUTE_NORMAL) g_Out.Printf(TEXT("NORMAL "));
+            if (dwAttrib & FILE_ATTRIBUTE_READONLY) g_Out.Printf(TEXT("READONLY "));
+            if (dwAttrib & FILE_ATTRIBUTE_COMPRESSED) g_Out.Printf(TEXT("COMPRESSED "));
+            if (dwAttrib & FILE_ATTRIBUTE_DIRECTORY) g_Out.Printf(TEXT("DIRECTORY "));
+            if (dwAttrib & FILE_ATTRIBUTE_TEMPORARY) g_Out.Printf(TEXT("TEMPORARY "));
+            if (dwAttrib & FILE_ATTRIBUTE_ENCRYPTED) g_Out.Printf(TEXT("ENCRYPTED "));
+            if (dwAttrib & FILE_ATTRIBUTE_NOT_CONTENT_INDEXED) g_Out.Printf(TEXT("NOT_CONTENT_INDEXED "));
+            if (dwAttrib & FILE_ATTRIBUTE_OFFLINE) g_Out.Printf(TEXT("OFFLINE "));
+            if (dwAttrib & FILE_ATTRIBUTE_REPARSE_POINT) g_Out.Printf(TEXT("REPARSE_POINT "));
+            if (dwAttrib & FILE_ATTRIBUTE_SPARSE_FILE) g_Out.Printf(TEXT("SPARSE_FILE "));
+            g_Out.Printf(TEXT("\n"));
+            if (Probe.fExtendedAttributes)
+            {
+                g_Out.Printf(TEXT("\t\t"));
+                if (!(dwAttrib & FILE_ATTRIBUTE_DIRECTORY))
+                {
+                    if (Probe.nFileSizeHigh)
+                    {
+                        g_Out.Printf(TEXT("Size: %u%010u"), Probe.nFileSizeHigh, Probe.nFileSizeLow);
+                    }
+                    else
+                    {
+                        g_Out.Printf(TEXT("Size: %u"), Probe.nFileSizeLow);
+                    }
+                }
+                g_Out.Printf(TEXT("  Created: ")); PrintLocalFileTime(Probe.ftCreationTime, true);
+                g_Out.Printf(TEXT("\n\t\tChanged: "));  PrintLocalFileTime(Probe.ftLastWriteTime, true);
+                // accessed is useless - it already has been modified by the tool - always shows today.
+                g_Out.Printf("\n");
+            }
         }
-        return;
     }
+}
+
+bool PrintVersionInfo(CInstallerData* pInstallerData, const TCHAR* szFilePath, KEYPATHPROBE* pProbe)
+{
+    // accepts either Registry key (form:  01:path\path\path  (number is root.))
+    // or file path.  *pProbe is left with what was printed; false - there was no path.
+
+    if ((NULL != szFilePath) && *szFilePath)
+    {
+        pInstallerData->ProbeKeyPath(szFilePath, pProbe);
+        PrintKeyPathProbe(*pProbe);
+        return true;
+    }
+    return false;
+}
 
-    if (fOwnerDefaulted)
+// -json: the same probe as a "keypath" record.
+void WriteKeyPathRecord(const TCHAR* szComponent, const TCHAR* szProduct, const TCHAR* szKeyPath, const KEYPATHPROBE& Probe)
+{
+    CJsonRecord Record(g_pJsonOut, TEXT("keypath"));
+    Record.String(TEXT("component"), szComponent);
+    Record.String(TEXT("product"), szProduct);
+    Record.String(TEXT("path"), szKeyPath);
+    Record.Bool(TEXT("registry"), Probe.fRegistry);
+
+    if (Probe.fRegistry)
     {
-        printf("Owner Defaulted");
+        if (Probe.fRegistryRoot)
+        {
+            Record.UInt(TEXT("error"), Probe.dwRegistryError);
+            if ((ERROR_SUCCESS == Probe.dwRegistryError) && Probe.fLastWriteTime)
+                Record.Time(TEXT("changed"), Probe.ftLastWriteTime);
+        }
     }
     else
     {
-        char szName[NAME_SIZE] = "";
-        DWORD cbName = NAME_SIZE;
-        char szDomain[NAME_SIZE] = "";
-        DWORD cbDomain = NAME_SIZE;
-        SID_NAME_USE snu;
-        if (!LookupAccountSid(NULL, psid, szName, &cbName, szDomain, &cbDomain, &snu))
+        Record.UInt(TEXT("versionError"), Probe.uiVersionResult);
+        if (ERROR_SUCCESS == Probe.uiVersionResult)
         {
-            
-            printf("Cannot lookup owner (%d)", GetLastError());
-            return;
+            Record.String(TEXT("version"), Probe.szVersion);
+            if (*Probe.szLanguage)
+                Record.String(TEXT("language"), Probe.szLanguage);
         }
 
-        printf("%s\\%s", szDomain, szName);
+        Record.Bool(TEXT("exists"), 0xFFFFFFFF != Probe.dwAttributes);
+        if (0xFFFFFFFF != Probe.dwAttributes)
+        {
+            Record.UInt(TEXT("attributes"), Probe.dwAttributes);
+            if (Probe.fBinaryType)
+                Record.UInt(TEXT("binaryType"), Probe.dwBinaryType);
+            if (Probe.fExtendedAttributes)
+            {
+                if (!(Probe.dwAttributes & FILE_ATTRIBUTE_DIRECTORY))
+                    Record.UInt64(TEXT("size"), ((unsigned __int64) Probe.nFileSizeHigh << 32) | Probe.nFileSizeLow);
+                Record.Time(TEXT("created"), Probe.ftCreationTime);
+                Record.Time(TEXT("changed"), Probe.ftLastWriteTime);
+            }
+        }
     }
+
+    switch (Probe.osOwner)
+    {
+        case osNoOwner:
+            Record.String(TEXT("ownerState"), TEXT("none"));
+            break;
+        case osUnreadable:
+            Record.String(TEXT("ownerState"), TEXT("unreadable"));
+            Record.UInt(TEXT("ownerError"), Probe.dwOwnerError);
+            break;
+        case osDefaulted:
+            Record.String(TEXT("ownerState"), TEXT("defaulted"));
+            break;
+        case osLookupFailed:
+            Record.String(TEXT("ownerState"), TEXT("lookupFailed"));
+            Record.UInt(TEXT("ownerError"), Probe.dwOwnerError);
+            break;
+        case osResolved:
+            Record.String(TEXT("owner"), Probe.szOwner);
+            break;
+        default:
+            break;
+    }
+    Record.End();
 }
 
-void PrintVersionInfo(TCHAR* szFilePath)
+// -probe: asks for the paths of a product's components ahead of the component
+// list and queues their keypaths, as far as the queue allows.  *piAhead is the
+// first registration not yet asked about.
+void SubmitProductProbes(CProbePool* pPool, CInstallerData* pInstallerData, const TCHAR* szProductCode,
+                         const COMPONENTINDEX* pIndex, const COMPONENTCLIENT* pRegistrations, DWORD cRegistrations,
+                         CStringArena* pArena, DWORD* piAhead)
 {
-    // accepts either Registry key (form:  01:path\path\path  (number is root.))
-    // or file path.
+    const TCHAR* szPath;
+    while ((*piAhead < cRegistrations) && pPool->CanSubmit())
+    {
+        DWORD iComponent = pRegistrations[*piAhead].iComponent;
+        INSTALLSTATE isState = QueryComponentPath(pInstallerData, szProductCode, pIndex->rgszComponent[iComponent], pArena, &szPath);
+        pPool->Submit(iComponent, isState, szPath, INSTALLSTATE_ABSENT != isState);
 
-    byte pbSD[SD_SIZE];
-    DWORD cbSD = SD_SIZE;
+        // the list prints a product listed twice on one component once.
+        while ((*piAhead < cRegistrations) && (pRegistrations[*piAhead].iComponent == iComponent))
+            (*piAhead)++;
+    }
+}
 
-    if ((NULL != szFilePath) && *szFilePath)
+// -probe: finds the components the evaluation will list with a path, from
+// *piAhead on, and queues their keypaths as far as the queue allows.  The path
+// listed is the one the component's last client gets.
+void SubmitEvaluationProbes(CProbePool* pPool, const COMPONENTINDEX* pIndex, const GUIDSET* pProductSet,
+                            EOutputLevel eOutput, CStringArena* pArena, DWORD* piAhead)
+{
+    const TCHAR* szPath;
+    while ((*piAhead < pIndex->cComponents) && pPool->CanSubmit())
     {
-        if (*szFilePath >= '0' && *szFilePath <= '9')
+        DWORD iComponent = (*piAhead)++;
+        const COMPONENTCLIENT* pClients = &pIndex->rgClients[pIndex->rgiFirstClient[iComponent]];
+        UINT cClients = ComponentClientCount(pIndex, iComponent);
+        if (!cClients)
+            continue;
+
+        bool fParentFound = false;
+        for (UINT iClient = 0; (iClient < cClients) && !fParentFound; iClient++)
+            fParentFound = IsGuidKeyInSet(pProductSet, pClients[iClient].ClientKey);
+        bool fSharedComponent = (cClients > ((pIndex->rgcPermanentClients[iComponent]) ? (UINT) 2 : (UINT) 1));
+
+        if (!((!fParentFound && (olOrphanedComponents & eOutput)) || (fParentFound && fSharedComponent && (olSharedComponents & eOutput))))
+            continue;
+
+        INSTALLSTATE isState = QueryComponentPath(g_pInstallerData, pClients[cClients-1].szClient, pIndex->rgszComponent[iComponent], pArena, &szPath);
+        pPool->Submit(iComponent, isState, szPath, true);
+    }
+}
+
+// main, and each report -bench scaling runs.
+int RunReport(int argc, char* argv[])
+{
+    EOutputLevel eOutput = olNone;
+
+    DWORD iProductIndex = 0;
+    TCHAR szProductCode[CCHGuid];
+    const TCHAR* szProductInfo = TEXT("");
+    INSTALLSTATE isProductState = INSTALLSTATE_UNKNOWN;
+
+    UINT cTotalComponents = 0;
+    UINT cAccountedForComponents = 0;
+    UINT cTotalQualifiedComponents = 0;
+
+    UINT uiEnumerateReturn  = ERROR_SUCCESS;
+    UINT uiReturn           = ERROR_SUCCESS;
+    
+    CProductFilter ProductFilter;
+
+    bool fSynthetic = false;
+    SYNTHETICCONFIG SyntheticConfig;
+    bool fBenchmark = false;
+    TCHAR *pszBenchmark = NULL;
+    TCHAR *pszRecordFile = NULL;
+    TCHAR *pszReplayFile = NULL;
+    TCHAR *pszBinarySnapshotFile = NULL;
+    TCHAR *pszDiffOldFile = NULL;
+    TCHAR *pszDiffNewFile = NULL;
+    DWORD cEnrichThreads = 1;
+    bool fProbeConfig = false;
+    PROBECONFIG ProbeConfig;
+    DWORD dwAccountTimeout = 0;
+    bool fJson = false;
+    TCHAR *pszEventsFile = NULL;
+    TCHAR *pszRegistryFile = NULL;
+    TCHAR *pszRecordEventsFile = NULL;
+    DWORD dwEventsSince = 0;
+    TCHAR *pszEventStateFile = NULL;
+    TCHAR *pszTraceFile = NULL;
+    bool fProductEvents = false;
+    bool fScanLogs = false;
+    DWORD cScanThreads = 0;
+    TCHAR *pszLogDirectory = NULL;
+    TCHAR *pszProfileFile = NULL;
+    DWORD cProfileTop = CProfileTopDefault;
+
+    clock_t clockStart, clockFinish;
+    clockStart = clock();
+
+    for (int carg=1; carg < argc; carg++)
+    {
+        if (('-' == argv[carg][0]) || ('/' == argv[carg][0]))
         {
-            HKEY hRoot = 0;
-            HKEY hKey = 0;
-            if (szFilePath[1] >= '0' && szFilePath[1] <= '3')
+            TCHAR chChar = argv[carg][1];
+            if (0 == lstrcmpi(argv[carg]+1, TEXT("synthetic")))
             {
-                HKEY hMsiRoots[] = { HKEY_CLASSES_ROOT, HKEY_CURRENT_USER, HKEY_LOCAL_MACHINE, HKEY_USERS };
-                hRoot = hMsiRoots[szFilePath[1]-'0'];
-
-                if (ERROR_SUCCESS == RegOpenKeyEx(hRoot, NULL, 0, KEY_READ, &hKey))
+                // report on a generated inventory instead of this machine.
+                if (((carg+1) < argc) && ParseSyntheticConfig(argv[carg+1], &SyntheticConfig))
                 {
-                    printf(TEXT("\t\tKey exists  "));
-                    // security
-                    if (ERROR_SUCCESS == RegGetKeySecurity(hKey, OWNER_SECURITY_INFORMATION, pbSD, &cbSD))
-                    {
-                        printf("Owner: ");
-                        OwnerPrint(pbSD);
-                    }
-                    
-                    FILETIME ftLastWriteTime;
-                    if (!g_fWin9X && (ERROR_SUCCESS == RegQueryInfoKey(hKey, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, &ftLastWriteTime)))
-                    {
-                        
-                        printf(TEXT("\n\t\tLast write time: ")); 
-                        PrintLocalFileTime(ftLastWriteTime, true);
-                    }
-                    printf("\n");
-
+                    carg++;
+                    fSynthetic = true;
+                    continue;
                 }
-                else
+                chChar = '?';
+            }
+            else if (0 == lstrcmpi(argv[carg]+1, TEXT("record")))
+            {
+                // write a snapshot of the inventory instead of a report.
+                if ((carg+1) < argc)
                 {
-                    DWORD dwLastErr = GetLastError();
-
-                    printf(TEXT("\t\tError checking for key: "));
-                    switch(dwLastErr)
-                    {
-                        case ERROR_ACCESS_DENIED:
-                            printf(TEXT("access denied"));
-                            break;
-                        case ERROR_FILE_NOT_FOUND:
-                            printf(TEXT("key not found"));
-                            break;
-                        default:
-                            printf(TEXT("unknown error: %d"), dwLastErr);
-
-                    }
-                    printf(TEXT("\n"));
+                    pszRecordFile = argv[++carg];
+                    continue;
                 }
-            }        
-        }
-        else
-        {
-            DWORD dwLastErr = 0;
-            TCHAR szVersion[CCHProductInfo] = TEXT("");
-            DWORD cchVersion = CCHProductInfo;
-            TCHAR szLanguage[CCHProductInfo] = TEXT("");
-            DWORD cchLanguage = CCHProductInfo;
-            DWORD dwAttrib = 0;
-            bool  fExtendedAttribs = false;
-            WIN32_FILE_ATTRIBUTE_DATA FileInformation;
-    
-            if (!g_fWin9X || MinimumPlatformWindows98())
+                chChar = '?';
+            }
+            else if (0 == lstrcmpi(argv[carg]+1, TEXT("o")))
             {
-                if (GetFileAttributesEx(szFilePath, GetFileExInfoStandard, &FileInformation))
+                // write a binary snapshot instead of a report.
+                if ((carg+1) < argc)
                 {
-                    dwAttrib = FileInformation.dwFileAttributes;
-                    fExtendedAttribs = true;
+                    pszBinarySnapshotFile = argv[++carg];
+                    continue;
                 }
+                chChar = '?';
             }
-            else
+            else if (0 == lstrcmpi(argv[carg]+1, TEXT("diff")))
             {
-                dwAttrib = GetFileAttributes(szFilePath);
+                // compare two binary snapshots instead of reporting.
+                if ((carg+2) < argc)
+                {
+                    pszDiffOldFile = argv[++carg];
+                    pszDiffNewFile = argv[++carg];
+                    continue;
+                }
+                chChar = '?';
             }
-    
-            if (ERROR_SUCCESS == (dwLastErr = MsiGetFileVersion(szFilePath, szVersion, &cchVersion, szLanguage, &cchLanguage)))
+            else if (0 == lstrcmpi(argv[carg]+1, TEXT("replay")))
             {
-                printf(TEXT("\t\tVersion: %s"), szVersion);
-                if (*szLanguage)
-                    printf(TEXT(",\tLanguage: %s  "), szLanguage); 
-            
-                printf(TEXT("\n"));
+                // report on a snapshot recorded elsewhere.
+                if ((carg+1) < argc)
+                {
+                    pszReplayFile = argv[++carg];
+                    continue;
+                }
+                chChar = '?';
             }
-            else
+            else if (0 == lstrcmpi(argv[carg]+1, TEXT("j")))
             {
-                switch (dwLastErr)
-                {    
-                    case ERROR_FILE_NOT_FOUND:
-                        if ((0xFFFFFFFF != dwAttrib) && (dwAttrib & FILE_ATTRIBUTE_DIRECTORY))
-                            printf(TEXT("\t\tDirectory exists.\n"));
-                        else
-                             printf(TEXT("\t\tFile or directory not found.\n"));
-                        break;
-                    case ERROR_ACCESS_DENIED:
-                        printf(TEXT("\t\tAccess denied for version information.\n"));
-                        break;
-                    case ERROR_FILE_INVALID:
-                        printf(TEXT("\t\tNo version information.\n"));
-                        break;
-                    case ERROR_INVALID_DATA:
-                        printf(TEXT("\t\tVersion information invalid.\n"));
-                        break;
-                    default:
-                        printf(TEXT("\t\tUnexpected error reading version information.\n"));
+                // enrich products on this many threads.
+                if (((carg+1) < argc) && (atoi(argv[carg+1]) >= 1) && (atoi(argv[carg+1]) <= 64))
+                {
+                    cEnrichThreads = atoi(argv[++carg]);
+                    continue;
                 }
+                chChar = '?';
             }
-
-            if (!g_fWin9X && GetFileSecurity(szFilePath, OWNER_SECURITY_INFORMATION, pbSD, SD_SIZE, &cbSD))
+            else if (0 == lstrcmpi(argv[carg]+1, TEXT("probe")))
             {
-                printf(TEXT("\t\tOwner: "));
-                OwnerPrint(pbSD);
-                printf("\n");
+                // probe keypaths on a pool of threads.
+                if (((carg+1) < argc) && ParseProbeConfig(argv[carg+1], &ProbeConfig))
+                {
+                    carg++;
+                    fProbeConfig = true;
+                    continue;
+                }
+                chChar = '?';
             }
-
-            if (0xFFFFFFFF != dwAttrib)
+            else if (0 == lstrcmpi(argv[carg]+1, TEXT("sidtimeout")))
             {
-                DWORD dwBinaryType = 0;
-                printf(TEXT("\t\tAttributes: "));
-
-                if (!g_fWin9X && GetBinaryType(szFilePath, &dwBinaryType))
+                // give up on a slow owner lookup.
+                if (((carg+1) < argc) && (atoi(argv[carg+1]) >= 1))
                 {
-                    switch(dwBinaryType)
-                    {
-                        case SCS_32BIT_BINARY:
-                            printf(TEXT("WIN32-APP "));
-                            break;
-                        case SCS_64BIT_BINARY:
-                            printf(TEXT("WIN64-APP "));
-                            break;    
-                        case SCS_DOS_BINARY:
-                            printf(TEXT("DOS-APP "));
-                            break;
-                        case SCS_OS216_BINARY:
-                            printf(TEXT("OS2-16BIT-APP "));
-                            break;
-                        case SCS_PIF_BINARY:
-                            printf(TEXT("PIF "));
-                            break;
-                        case SCS_POSIX_BINARY:
-                            printf(TEXT("POSIX-APP "));
-                            break;
-                        case SCS_WOW_BINARY:
-                            printf(TEXT("WIN16-APP "));
-                            break;
-                        default:
-                            printf(TEXT("Binary type(%d) "), dwBinaryType);
-                            break;
-                    }
+                    dwAccountTimeout = atoi(argv[++carg]);
+                    continue;
                 }
-
-                if (dwAttrib & FILE_ATTRIBUTE_ARCHIVE) printf(TEXT("ARCHIVE "));
-                if (dwAttrib & FILE_ATTRIBUTE_SYSTEM) printf(TEXT("SYSTEM "));
-                if (dwAttrib & FILE_ATTRIBUTE_HIDDEN) printf(TEXT("HIDDEN "));
-                if (dwAttrib & FILE_ATTRIBUTE_NORMAL) printf(TEXT("NORMAL "));
-                if (dwAttrib & FILE_ATTRIBUTE_READONLY) printf(TEXT("READONLY "));
-                if (dwAttrib & FILE_ATTRIBUTE_COMPRESSED) printf(TEXT("COMPRESSED "));
-                if (dwAttrib & FILE_ATTRIBUTE_DIRECTORY) printf(TEXT("DIRECTORY "));
-                if (dwAttrib & FILE_ATTRIBUTE_TEMPORARY) printf(TEXT("TEMPORARY "));
-                if (dwAttrib & FILE_ATTRIBUTE_ENCRYPTED) printf(TEXT("ENCRYPTED "));
-                if (dwAttrib & FILE_ATTRIBUTE_NOT_CONTENT_INDEXED) printf(TEXT("NOT_CONTENT_INDEXED "));
-                if (dwAttrib & FILE_ATTRIBUTE_OFFLINE) printf(TEXT("OFFLINE "));
-                if (dwAttrib & FILE_ATTRIBUTE_REPARSE_POINT) printf(TEXT("REPARSE_POINT "));
-                if (dwAttrib & FILE_ATTRIBUTE_SPARSE_FILE) printf(TEXT("SPARSE_FILE "));
-                printf(TEXT("\n"));
-                if (fExtendedAttribs)
+                chChar = '?';
+            }
+            else if (0 == lstrcmpi(argv[carg]+1, TEXT("json")))
+            {
+                // NDJSON records instead of the text report.
+                fJson = true;
+                continue;
+            }
+            else if (0 == lstrcmpi(argv[carg]+1, TEXT("scanlogs")))
+            {
+                // read the listed logs for failures, on N threads or one per processor.
+                fScanLogs = true;
+                if (((carg+1) < argc) && (atoi(argv[carg+1]) >= 1) && (atoi(argv[carg+1]) <= 64))
+                    cScanThreads = atoi(argv[++carg]);
+                continue;
+            }
+            else if (0 == lstrcmpi(argv[carg]+1, TEXT("profile")))
+            {
+                // time the actions in a verbose log instead of reporting; the N longest listed.
+                if ((carg+1) < argc)
+                {
+                    pszProfileFile = argv[++carg];
+                    if (((carg+1) < argc) && (atoi(argv[carg+1]) >= 1))
+                        cProfileTop = atoi(argv[++carg]);
+                    continue;
+                }
+                chChar = '?';
+            }
+            else if (0 == lstrcmpi(argv[carg]+1, TEXT("logdir")))
+            {
+                // list the logs in this directory instead of the temp directories.
+                if ((carg+1) < argc)
+                {
+                    pszLogDirectory = argv[++carg];
+                    continue;
+                }
+                chChar = '?';
+            }
+            else if (0 == lstrcmpi(argv[carg]+1, TEXT("since")))
+            {
+                // leave out events older than this.
+                if (((carg+1) < argc) && ParseSinceTime(argv[carg+1], &dwEventsSince))
+                {
+                    carg++;
+                    continue;
+                }
+                chChar = '?';
+            }
+            else if (0 == lstrcmpi(argv[carg]+1, TEXT("events")))
+            {
+                // list the events in a dump instead of this machine's log.
+                if ((carg+1) < argc)
+                {
+                    pszEventsFile = argv[++carg];
+                    continue;
+                }
+                chChar = '?';
+            }
+            else if (0 == lstrcmpi(argv[carg]+1, TEXT("registry")))
+            {
+                // probe registry keypaths against a .reg export instead of this machine's registry.
+                if ((carg+1) < argc)
+                {
+                    pszRegistryFile = argv[++carg];
+                    continue;
+                }
+                chChar = '?';
+            }
+            else if (0 == lstrcmpi(argv[carg]+1, TEXT("productevents")))
+            {
+                // each product's last install, repair or uninstall from the event log.
+                fProductEvents = true;
+                continue;
+            }
+            else if (0 == lstrcmpi(argv[carg]+1, TEXT("eventstate")))
+            {
+                // list only the events logged since the last run with this file.
+                if ((carg+1) < argc)
+                {
+                    pszEventStateFile = argv[++carg];
+                    continue;
+                }
+                chChar = '?';
+            }
+            else if (0 == lstrcmpi(argv[carg]+1, TEXT("trace")))
+            {
+                // a timeline of the run's stages, for chrome://tracing or Perfetto.
+                if ((carg+1) < argc)
+                {
+                    pszTraceFile = argv[++carg];
+                    continue;
+                }
+                chChar = '?';
+            }
+            else if (0 == lstrcmpi(argv[carg]+1, TEXT("recordevents")))
+            {
+                // write this machine's event log to a dump instead of a report.
+                if ((carg+1) < argc)
+                {
+                    pszRecordEventsFile = argv[++carg];
+                    continue;
+                }
+                chChar = '?';
+            }
+            else if (0 == lstrcmpi(argv[carg]+1, TEXT("bench")))
+            {
+                fBenchmark = true;
+                if (((carg+1) < argc) && (*argv[carg+1] != '-') && (*argv[carg+1] != '/'))
                 {
-                    printf(TEXT("\t\t"));
-                    if (!(dwAttrib & FILE_ATTRIBUTE_DIRECTORY))
-                    {
-                        if (FileInformation.nFileSizeHigh)
-                        {
-                            printf(TEXT("Size: %u%010u"), FileInformation.nFileSizeHigh, FileInformation.nFileSizeLow);
-                        }
-                        else
-                        {
-                            printf(TEXT("Size: %u"), FileInformation.nFileSizeLow);
-                        }
-                    }
-                    printf(TEXT("  Created: ")); PrintLocalFileTime(FileInformation.ftCreationTime, true);
-                    printf(TEXT("\n\t\tChanged: "));  PrintLocalFileTime(FileInformation.ftLastWriteTime, true);
-                    // accessed is useless - it already has been modified by the tool - always shows today.
-                    printf("\n");
+                    carg++;
+                    pszBenchmark = argv[carg];
                 }
+                continue;
             }
-        }
-    }
-}
-
-void __cdecl main(int argc, char* argv[])
-{
-    EOutputLevel eOutput = olNone;
-
-    DWORD iProductIndex = 0;
-    TCHAR szProductCode[CCHGuid];
-    TCHAR szProductInfo[CCHProductInfo] = TEXT("");
-    DWORD cchProductInfo = CCHProductInfo;
-    TCHAR szLocalCache[CCHProductInfo] = TEXT("");
-    INSTALLSTATE isProductState = INSTALLSTATE_UNKNOWN;
-
-    UINT cTotalComponents = 0;
-    UINT cAccountedForComponents = 0;
-    UINT cTotalQualifiedComponents = 0;
-
-    UINT uiEnumerateReturn  = ERROR_SUCCESS;
-    UINT uiReturn           = ERROR_SUCCESS;
-    
-    TCHAR *pszLimitProduct = NULL;
-    unsigned int cchLimitProduct = 0;
-
-    clock_t clockStart, clockFinish;
-    clockStart = clock();
-
-    for (int carg=1; carg < argc; carg++)
-    {
-        if (('-' == argv[carg][0]) || ('/' == argv[carg][0]))
-        {
-            TCHAR chChar = argv[carg][1];
             if (chChar >= 'A' && chChar <= 'Z')
                 chChar = chChar - 'A' + 'a';
             switch(chChar)
@@ -497,9 +1077,18 @@ void __cdecl main(int argc, char* argv[])
                     {
                         if ((*argv[carg+1] != '-') && (*argv[carg+1] != '/'))
                         {
+                            // each -p adds to the watch-list; @file adds a pattern per line.
                             carg++;
-                            pszLimitProduct=argv[carg];
-                            cchLimitProduct = lstrlen(pszLimitProduct);
+                            UINT uiFilter = ERROR_SUCCESS;
+                            if ('@' == *argv[carg])
+                                uiFilter = ProductFilter.AddPatternFile(argv[carg] + 1);
+                            else if (!ProductFilter.AddPattern(argv[carg]))
+                                uiFilter = ERROR_NOT_ENOUGH_MEMORY;
+                            if (ERROR_SUCCESS != uiFilter)
+                            {
+                                fprintf(stderr, TEXT("Cannot read -p %s: %d\n"), argv[carg], uiFilter);
+                                return 1;
+                            }
                         }
                     }
                     break;
@@ -538,70 +1127,317 @@ void __cdecl main(int argc, char* argv[])
                     break;
                 case '?' :
                 default:
-                    printf(TEXT("Usage: %s [option [option]]\n"),argv[0]);
-                    printf(TEXT("\t-p [product]\tProduct list\n"));
-                    printf(TEXT("\t-f\tFeature state by product. (includes -p)\n"));
-                    printf(TEXT("\t-q\tComponent count by product (includes -p)\n"));
-                    printf(TEXT("\t-#\tComponent count and features states by product (-p -f -q)\n"));
-                    printf(TEXT("\n"));
-                    printf(TEXT("\t-x\tOrphaned components.\n"));
-                    printf(TEXT("\t-m\tShared components.\n"));
-                    printf(TEXT("\t-c\tEvaluate components (-x -m).\n"));
-                    printf(TEXT("\n"));
-                    printf(TEXT("\t-l\tList of log files.\n"));
-                    printf(TEXT("\n"));
-                    printf(TEXT("\t-t\tElapsed time for run. (Benchmarking)\n"));
-                    printf(TEXT("\n"));
-                    printf(TEXT("\t-s\tReduced output.(-p -#)\n"));
-                    printf(TEXT("\t-n\tNormal output. (default)\n"));
-                    printf(TEXT("\t-v\tVerbose output. (default + feature and component lists)\n"));
+                    g_Out.Printf(TEXT("Usage: %s [option [option]]\n"),argv[0]);
+                    g_Out.Printf(TEXT("\t-p [product]\tProduct list\n"));
+                    g_Out.Printf(TEXT("\t\tproduct limits it to codes and names starting with product;\n"));
+                    g_Out.Printf(TEXT("\t\t-p may be given many times, and -p @file reads one per line.\n"));
+                    g_Out.Printf(TEXT("\t-f\tFeature state by product. (includes -p)\n"));
+                    g_Out.Printf(TEXT("\t-q\tComponent count by product (includes -p)\n"));
+                    g_Out.Printf(TEXT("\t-#\tComponent count and features states by product (-p -f -q)\n"));
+                    g_Out.Printf(TEXT("\n"));
+                    g_Out.Printf(TEXT("\t-x\tOrphaned components.\n"));
+                    g_Out.Printf(TEXT("\t-m\tShared components.\n"));
+                    g_Out.Printf(TEXT("\t-c\tEvaluate components (-x -m).\n"));
+                    g_Out.Printf(TEXT("\n"));
+                    g_Out.Printf(TEXT("\t-l\tList of log files.\n"));
+                    g_Out.Printf(TEXT("\t-scanlogs [N]\tCount the failures in each log file, on N threads (default: one per processor).\n"));
+                    g_Out.Printf(TEXT("\t-logdir dir\tList the log files in dir instead of the temp directories.\n"));
+                    g_Out.Printf(TEXT("\t-profile log [N]\tTime the actions in a verbose log; list the N longest (default: 20) and exit.\n"));
+                    g_Out.Printf(TEXT("\t-since when\tOnly events since when: YYYY-MM-DD[Thh:mm:ss] (UTC), Nd or Nh ago.\n"));
+                    g_Out.Printf(TEXT("\n"));
+                    g_Out.Printf(TEXT("\t-t\tElapsed time for run, and the installer and Win32 calls by phase. (Benchmarking)\n"));
+                    g_Out.Printf(TEXT("\t-trace file\tWrite a timeline of the run's stages to file as Chrome trace events.\n"));
+                    g_Out.Printf(TEXT("\n"));
+                    g_Out.Printf(TEXT("\t-s\tReduced output.(-p -#)\n"));
+                    g_Out.Printf(TEXT("\t-n\tNormal output. (default)\n"));
+                    g_Out.Printf(TEXT("\t-v\tVerbose output. (default + feature and component lists)\n"));
+                    g_Out.Printf(TEXT("\n"));
+                    g_Out.Printf(TEXT("\t-synthetic products=N,components=N,clients=N,features=N,\n"));
+                    g_Out.Printf(TEXT("\t           patches=N,qualifiers=N,latency=MS\n"));
+                    g_Out.Printf(TEXT("\t\tReport on a generated inventory instead of this machine.\n"));
+                    g_Out.Printf(TEXT("\t-record file\tWrite a snapshot of the inventory to file and exit.\n"));
+                    g_Out.Printf(TEXT("\t-replay file\tReport on a snapshot written by -record.\n"));
+                    g_Out.Printf(TEXT("\t-o file\t\tWrite a binary columnar snapshot to file and exit.\n"));
+                    g_Out.Printf(TEXT("\t-diff old new\tList what changed between two snapshots written by -o.\n"));
+                    g_Out.Printf(TEXT("\t-j N\t\tQuery products on N threads (1-64); the report is unchanged.\n"));
+                    g_Out.Printf(TEXT("\t-probe threads=N,queue=N,latency=MS,root=DIR\n"));
+                    g_Out.Printf(TEXT("\t\tProbe keypaths on N threads, up to queue ahead of the report;\n"));
+                    g_Out.Printf(TEXT("\t\troot answers from a stand-in file system under DIR.\n"));
+                    g_Out.Printf(TEXT("\t-registry file\tProbe registry keypaths against the keys in file, a .reg export.\n"));
+                    g_Out.Printf(TEXT("\t-sidtimeout MS\tGive up on looking up an owner's account after MS milliseconds.\n"));
+                    g_Out.Printf(TEXT("\t-events file\tList the events in file, written by -recordevents, for -l.\n"));
+                    g_Out.Printf(TEXT("\t-productevents\tShow each product's last install, repair or uninstall event and its failures.\n"));
+                    g_Out.Printf(TEXT("\t-eventstate file\tList only the events logged since the last run with file, for -l.\n"));
+                    g_Out.Printf(TEXT("\t-recordevents file\tWrite the Application event log to file and exit.\n"));
+                    g_Out.Printf(TEXT("\t-json\t\tWrite one JSON record per line for each thing the report finds.\n"));
+                    g_Out.Printf(TEXT("\t-bench [case]\tRun benchmarks against generated inventories.\n"));
+                    g_Out.Printf(TEXT("\t\t(-synthetic overrides each case's inventory; an unknown case lists\n"));
+                    g_Out.Printf(TEXT("\t\twhat products= and components= count in each.)\n"));
     
-                    return;
+                    return 0;
             }
         }
     }
 
     SetPlatformInfo();
+    InitAccountCache(dwAccountTimeout);
+
+    if (fBenchmark)
+        return RunBenchmarks(pszBenchmark, (fSynthetic) ? &SyntheticConfig : NULL);
+
+    if (pszDiffOldFile)
+        return DiffSnapshots(pszDiffOldFile, pszDiffNewFile);
+
+    if (pszProfileFile)
+        return ProfileInstallLog(pszProfileFile, cProfileTop);
+
+    if (pszRecordEventsFile)
+        return RecordEventLog(pszRecordEventsFile, dwEventsSince);
+
+    if (pszReplayFile)
+    {
+        CReplayInstallerData* pReplay = new CReplayInstallerData;
+        UINT uiLoad = pReplay->Load(pszReplayFile);
+        if (ERROR_SUCCESS != uiLoad)
+        {
+            fprintf(stderr, TEXT("Cannot read snapshot %s: %d\n"), pszReplayFile, uiLoad);
+            delete pReplay;
+            return 1;
+        }
+        g_pInstallerData = pReplay;
+    }
+    else if (fSynthetic)
+    {
+        g_pInstallerData = new CSyntheticInstallerData(SyntheticConfig);
+    }
+    else
+    {
+#ifdef _WIN32
+        g_pInstallerData = new CLiveInstallerData;
+#else
+        fprintf(stderr, TEXT("Windows Installer is not available on this platform; use -synthetic.\n"));
+        return 1;
+#endif
+    }
+
+    CStandInRegistry* pStandInRegistry = NULL;
+    if (pszRegistryFile)
+    {
+        pStandInRegistry = new CStandInRegistry;
+        UINT uiLoad = pStandInRegistry->Load(pszRegistryFile);
+        if (ERROR_SUCCESS != uiLoad)
+        {
+            fprintf(stderr, TEXT("Cannot read registry export %s: %d\n"), pszRegistryFile, uiLoad);
+            delete pStandInRegistry;
+            delete g_pInstallerData;
+            return 1;
+        }
+    }
+
+    if ((fProbeConfig && (ProbeConfig.szRoot || ProbeConfig.dwLatency)) || pStandInRegistry)
+        g_pInstallerData = new CStandInFileSystem(g_pInstallerData, (fProbeConfig) ? ProbeConfig.szRoot : NULL, (fProbeConfig) ? ProbeConfig.dwLatency : 0,
+                                                  pStandInRegistry);
+
+    if (olTimeElapsed & eOutput)
+    {
+        StartCallTiming();
+        g_pInstallerData = new CCountingInstallerData(g_pInstallerData);
+    }
+
+    if (pszRecordFile)
+    {
+        UINT uiCapture = CaptureInventory(g_pInstallerData, pszRecordFile);
+        if (ERROR_SUCCESS != uiCapture)
+            fprintf(stderr, TEXT("Cannot write snapshot %s: %d\n"), pszRecordFile, uiCapture);
+        delete g_pInstallerData;
+        return (ERROR_SUCCESS == uiCapture) ? 0 : 1;
+    }
+
+    if (pszBinarySnapshotFile)
+    {
+        UINT uiWrite = WriteBinarySnapshot(g_pInstallerData, pszBinarySnapshotFile);
+        if (ERROR_SUCCESS != uiWrite)
+            fprintf(stderr, TEXT("Cannot write snapshot %s: %d\n"), pszBinarySnapshotFile, uiWrite);
+        delete g_pInstallerData;
+        return (ERROR_SUCCESS == uiWrite) ? 0 : 1;
+    }
+
+    if (pszTraceFile)
+        StartTrace();
+
+    // the listings and the evaluation probe a shared keypath many times; once is enough.
+    CProbeCache* pProbeCache = new CProbeCache(g_pInstallerData);
+    g_pInstallerData = pProbeCache;
+
+    // -json: records go to their own sink; the text report is still walked, and thrown away.
+    COutputSink JsonOut(stdout);
+    if (fJson)
+    {
+        g_Out.Discard(true);
+        g_pJsonOut = &JsonOut;
+    }
 
     SYSTEMTIME SystemTime;
     FILETIME FileTime;
     
     GetSystemTime(&SystemTime);
     SystemTimeToFileTime(&SystemTime, &FileTime);
-    printf(TEXT("%s  "), argv[0]);
+    g_Out.Printf(TEXT("%s  "), argv[0]);
     PrintLocalFileTime(FileTime, true);
-    printf(TEXT("\n\n"));
+    g_Out.Printf(TEXT("\n\n"));
+
+    CJsonRecord Run(g_pJsonOut, TEXT("run"));
+    Run.String(TEXT("program"), argv[0]);
+    Run.Time(TEXT("time"), FileTime);
+    Run.End();
 
 
     if (olNone == (eOutput & ~olModifiers))
         eOutput = EOutputLevel(eOutput | olNormal);
     
 
+#ifdef _WIN32
+    CCallTimer UITimer(tcSetInternalUI);
     INSTALLUILEVEL iuiLevel = MsiSetInternalUI(INSTALLUILEVEL_NONE, NULL);
+    UITimer.Stop();
+#endif
+
+    COMPONENTINDEX ComponentIndex;
+    memset(&ComponentIndex, 0, sizeof(ComponentIndex));
+
+    GUIDSET ProductSet;
+    memset(&ProductSet, 0, sizeof(ProductSet));
+
+    if (((olProducts & eOutput) && (olComponentCount & eOutput)) || (olComponentEvaluation & eOutput))
+    {
+        // one pass over every component and client, shared by all of the product reports
+        // and the component evaluation.
+        CTraceSpan Span(TEXT("component index"));
+        CheckError(BuildComponentIndex(g_pInstallerData, &ComponentIndex));
+    }
+
+    if (olComponentEvaluation & eOutput)
+    {
+        // the evaluation asks "is this client an installed product" for every client of every component.
+        CTraceSpan Span(TEXT("product set"));
+        CheckError(LoadProductSet(g_pInstallerData, &ProductSet));
+    }
+
+    // -probe: the component list and the evaluation queue keypaths ahead of what they print.
+    CProbePool ProbePool;
+    if (fProbeConfig && (((olProducts & eOutput) && (olComponentCount & eOutput) && (olComponentList & eOutput)) || (olComponentEvaluation & eOutput)))
+    {
+        if (!ProbePool.Start(g_pInstallerData, ProbeConfig.cThreads, ProbeConfig.cQueueDepth))
+            ErrorUINT(ERROR_NOT_ENOUGH_MEMORY, TEXT("starting -probe threads; probing keypaths serially"));
+    }
+
+    // -productevents: the MsiInstaller events, read once and joined to the products by code and name.
+    CProductEventIndex ProductEvents;
+    bool fProductEventsRead = false;
+    if (fProductEvents && (olProducts & eOutput))
+    {
+        SetCallPhase(cpEvents);
+        CEventLogReader EventReader;
+        EventReader.SetCutoff(dwEventsSince);
+        const TCHAR* szEventSource = (pszEventsFile) ? pszEventsFile : TEXT("Application");
+        CTraceSpan Span(TEXT("read events"), TEXT("source"), szEventSource);
+        UINT uiEvents = ERROR_FILE_NOT_FOUND;
+        if (pszEventsFile)
+            uiEvents = EventReader.OpenDump(pszEventsFile);
+#ifdef _WIN32
+        else if (!g_fWin9X)
+            uiEvents = EventReader.OpenLive(TEXT("Application"));
+#endif
+        if (ERROR_SUCCESS == uiEvents)
+        {
+            fProductEventsRead = true;
+            uiEvents = ProductEvents.Build(EventReader);
+        }
+        if (ERROR_SUCCESS != uiEvents)
+            fprintf(stderr, TEXT("Cannot read events %s: %d\n"), szEventSource, uiEvents);
+    }
+
+    // the strings the installer answers with; taken back a product, or an evaluated component, at a time.
+    CStringArena Arena;
+
+    // a product state the report has no words for ends the report; the cleanup below still runs.
+    bool fReportStopped = false;
 
     if (olProducts & eOutput)
     {
-        while(ERROR_SUCCESS == (uiEnumerateReturn = MsiEnumProducts(iProductIndex++, szProductCode)))
+        SetCallPhase(cpProducts);
+
+        // with -j the questions below are asked ahead by workers; pProductData answers
+        // for the current product from what they recorded.
+        CInstallerData* pProductData = g_pInstallerData;
+        CProductEnricher Enricher;
+        PRODUCTQUERYPROPERTY rgQueryProperty[2 + (sizeof(InstallProperties) / sizeof(INSTALLPROPERTIES)) + 2];
+        bool fEnrich = (cEnrichThreads > 1);
+        if (fEnrich)
+        {
+            DWORD cQueryProperties = 0;
+            rgQueryProperty[cQueryProperties].szProperty = INSTALLPROPERTY_PRODUCTNAME;
+            rgQueryProperty[cQueryProperties++].fInstalledOnly = false;
+            rgQueryProperty[cQueryProperties].szProperty = INSTALLPROPERTY_ASSIGNMENTTYPE;
+            rgQueryProperty[cQueryProperties++].fInstalledOnly = false;
+            for (int cPropertyCount = 0; cPropertyCount < (sizeof(InstallProperties) / sizeof(INSTALLPROPERTIES)); cPropertyCount++)
+            {
+                rgQueryProperty[cQueryProperties].szProperty = InstallProperties[cPropertyCount].szProperty;
+                rgQueryProperty[cQueryProperties++].fInstalledOnly = !InstallProperties[cPropertyCount].fAdvertised;
+            }
+            rgQueryProperty[cQueryProperties].szProperty = INSTALLPROPERTY_LOCALPACKAGE;
+            rgQueryProperty[cQueryProperties++].fInstalledOnly = true;
+            rgQueryProperty[cQueryProperties].szProperty = INSTALLPROPERTY_INSTALLDATE;
+            rgQueryProperty[cQueryProperties++].fInstalledOnly = true;
+
+            PRODUCTQUERY Query;
+            Query.rgProperty = rgQueryProperty;
+            Query.cProperties = cQueryProperties;
+            Query.pFilter = (ProductFilter.IsEmpty()) ? NULL : &ProductFilter;
+            Query.fUserInfo = (0 != (olUserInfo & eOutput));
+            Query.fFeatures = (0 != (olFeatureStates & eOutput));
+            Query.fFeatureUsage = (0 != (olFeatureList & eOutput));
+            Query.pComponentIndex = ((olComponentCount & eOutput) && (olComponentList & eOutput)) ? &ComponentIndex : NULL;
+
+            UINT uiStart = Enricher.Start(g_pInstallerData, Query, cEnrichThreads);
+            if (ERROR_SUCCESS != uiStart)
+            {
+                ErrorUINT(uiStart, TEXT("starting -j workers; querying products serially"));
+                fEnrich = false;
+            }
+        }
+
+        CTraceSpan LoopSpan(TEXT("product loop"));
+        while(ERROR_SUCCESS == (uiEnumerateReturn = (fEnrich) ? Enricher.NextProduct(iProductIndex++, szProductCode, &pProductData)
+                                                              : g_pInstallerData->EnumProducts(iProductIndex++, szProductCode)))
         {
-            isProductState = MsiQueryProductState(szProductCode);
+            // whatever the last product was told is no longer needed.
+            Arena.Reset();
+
+            CTraceSpan ProductSpan(TEXT("product"), TEXT("product"), szProductCode);
+            CTraceSpan PropertiesSpan(TEXT("properties"), TEXT("product"), szProductCode);
+            isProductState = pProductData->QueryProductState(szProductCode);
         
             // Product Name
-            CheckError(MsiGetProductInfo(szProductCode, INSTALLPROPERTY_PRODUCTNAME, szProductInfo, &cchProductInfo));
-            cchProductInfo = CCHProductInfo;
+            CheckError(QueryProductInfo(pProductData, szProductCode, INSTALLPROPERTY_PRODUCTNAME, &Arena, &szProductInfo));
+            const TCHAR* szProductName = szProductInfo;
 
-            if (pszLimitProduct)
+            if (!ProductFilter.IsEmpty())
             {
-                if ((0 != _strnicmp(szProductCode, pszLimitProduct, cchLimitProduct)) &&
-                    (0 != _strnicmp(szProductInfo, pszLimitProduct, cchLimitProduct)))
+                if (!ProductFilter.MatchesPrefix(szProductCode) && !ProductFilter.MatchesPrefix(szProductInfo))
                 {
                     continue;
                 }
             }
 
-            printf(TEXT("%s\n"), szProductInfo);
+            g_Out.Printf(TEXT("%s\n"), szProductInfo);
+
+            CJsonRecord Product(g_pJsonOut, TEXT("product"));
+            Product.String(TEXT("code"), szProductCode);
+            Product.String(TEXT("name"), szProductInfo);
         
             // Product Code -- not all products seem to have names, so put the info prominently here if the name failed.
-            printf(TEXT("%sProduct code:\t%s\n"), (*szProductInfo) ? TEXT("\t") : TEXT(""), szProductCode);
+            g_Out.Printf(TEXT("%sProduct code:\t%s\n"), (*szProductInfo) ? TEXT("\t") : TEXT(""), szProductCode);
 
             // Install State
             TCHAR* pszState = NULL;
@@ -627,14 +1463,18 @@ void __cdecl main(int argc, char* argv[])
                     pszState = TEXT("The product is neither advertised or installed.");
                     break;
                 default:
-                    printf(TEXT("Internal error querying product state (%d)\n"), isProductState);
-                    return;
+                    g_Out.Printf(TEXT("Internal error querying product state (%d)\n"), isProductState);
+                    Product.End();
+                    fReportStopped = true;
+                    break;
             }
+            if (fReportStopped)
+                break;
 
-            printf(TEXT("\tProduct state:\t(%d) %s\n"), isProductState, pszState);
+            g_Out.Printf(TEXT("\tProduct state:\t(%d) %s\n"), isProductState, pszState);
+            Product.Int(TEXT("state"), isProductState);
 
-            CheckError(MsiGetProductInfo(szProductCode, INSTALLPROPERTY_ASSIGNMENTTYPE, szProductInfo, &cchProductInfo));
-            cchProductInfo = CCHProductInfo;
+            CheckError(QueryProductInfo(pProductData, szProductCode, INSTALLPROPERTY_ASSIGNMENTTYPE, &Arena, &szProductInfo));
             if (*szProductInfo)
             {
 
@@ -649,65 +1489,81 @@ void __cdecl main(int argc, char* argv[])
                     default:
                         pszState = TEXT("unknown - internal error");
                 }
-                printf(TEXT("\tAssignment:\t%s\n"),pszState);                
+                g_Out.Printf(TEXT("\tAssignment:\t%s\n"),pszState);                
+                Product.String(TEXT("assignment"), pszState);
             }
 
+            if (fProductEventsRead)
+                PrintProductEvents(ProductEvents, szProductCode, szProductName, Product);
+
             {  // install properties
 
                 for (int cPropertyCount = 0; cPropertyCount < (sizeof(InstallProperties) / sizeof(INSTALLPROPERTIES)); cPropertyCount++)
                 {
                     if ((INSTALLSTATE_DEFAULT == isProductState) || (InstallProperties[cPropertyCount].fAdvertised)) 
                     {
-                        CheckError(MsiGetProductInfo(szProductCode, InstallProperties[cPropertyCount].szProperty, szProductInfo, &cchProductInfo));
-                        cchProductInfo = CCHProductInfo;
+                        CheckError(QueryProductInfo(pProductData, szProductCode, InstallProperties[cPropertyCount].szProperty, &Arena, &szProductInfo));
                         if (*szProductInfo)
-                            printf(TEXT("%s%s\n"), InstallProperties[cPropertyCount].szTitle, szProductInfo);
+                        {
+                            g_Out.Printf(TEXT("%s%s\n"), InstallProperties[cPropertyCount].szTitle, szProductInfo);
+                            Product.String(InstallProperties[cPropertyCount].szProperty, szProductInfo);
+                        }
                     }
                 }
 
                 if (INSTALLSTATE_DEFAULT == isProductState)
                 {
                     // Locally cached package -- useful for pulling out authored information, like friendly names for components.
-                    CheckError(MsiGetProductInfo(szProductCode, INSTALLPROPERTY_LOCALPACKAGE, szLocalCache, &cchProductInfo));
-                    cchProductInfo = CCHProductInfo;
-                    printf(TEXT("\tLocal package:\t%s\n"), (0 == lstrlen(szLocalCache)) ? TEXT("<missing>") : szLocalCache);
+                    const TCHAR* szLocalCache;
+                    CheckError(QueryProductInfo(pProductData, szProductCode, INSTALLPROPERTY_LOCALPACKAGE, &Arena, &szLocalCache));
+                    g_Out.Printf(TEXT("\tLocal package:\t%s\n"), (0 == lstrlen(szLocalCache)) ? TEXT("<missing>") : szLocalCache);
+                    Product.String(INSTALLPROPERTY_LOCALPACKAGE, szLocalCache);
 
                     // format the date into familiar form.
-                    CheckError(MsiGetProductInfo(szProductCode, INSTALLPROPERTY_INSTALLDATE, szProductInfo, &cchProductInfo));
-                    cchProductInfo = CCHProductInfo;
+                    CheckError(QueryProductInfo(pProductData, szProductCode, INSTALLPROPERTY_INSTALLDATE, &Arena, &szProductInfo));
 
+                    // YYYYMMDD; anything else as it is.
                     TCHAR szDate[20] = TEXT("");
-                    sprintf(szDate,TEXT("%s"), szProductInfo);
-                    sprintf(szDate+4,TEXT("\\%s"), szProductInfo+4);
-                    sprintf(szDate+7,TEXT("\\%s"), szProductInfo+6);
-                    printf(TEXT("\tInstall date:\t%s\n"), szDate);
+                    if (8 == lstrlen(szProductInfo))
+                        sprintf(szDate, TEXT("%.4s\\%.2s\\%.2s"), szProductInfo, szProductInfo+4, szProductInfo+6);
+                    else
+                        lstrcpyn(szDate, szProductInfo, sizeof(szDate) / sizeof(TCHAR));
+                    g_Out.Printf(TEXT("\tInstall date:\t%s\n"), szDate);
+                    Product.String(INSTALLPROPERTY_INSTALLDATE, szProductInfo);
                 }
 
                 if (olUserInfo & eOutput)
                 {
-                    TCHAR szUserInfo[CCHProductInfo] = "";
-                    TCHAR szOrgName[CCHProductInfo] = "";
-                    TCHAR szSerialBuf[CCHProductInfo] = "";
-                    DWORD cchUserInfo, cchOrgName, cchSerialBuf;
-                    cchUserInfo = cchOrgName = cchSerialBuf = CCHProductInfo;
-                    
-                    MsiGetUserInfo(szProductCode, szUserInfo, &cchUserInfo, szOrgName, &cchOrgName, szSerialBuf, &cchSerialBuf);
+                    const TCHAR* szUserInfo;
+                    const TCHAR* szOrgName;
+                    const TCHAR* szSerialBuf;
+                    QueryUserInfo(pProductData, szProductCode, &Arena, &szUserInfo, &szOrgName, &szSerialBuf);
+                    if (*szUserInfo)
+                        g_Out.Printf(TEXT("\tRegistered to:  %s"), szUserInfo);
+                    if (*szOrgName)
+                        g_Out.Printf(TEXT(", %s"), szOrgName);
+                    g_Out.Printf(TEXT("\n"));
+                    if (*szSerialBuf)
+                        g_Out.Printf(TEXT("\t\tSerial Code: %s\n"), szSerialBuf);
+
                     if (*szUserInfo)
-                        printf(TEXT("\tRegistered to:  %s"), szUserInfo);
+                        Product.String(TEXT("registeredTo"), szUserInfo);
                     if (*szOrgName)
-                        printf(TEXT(", %s"), szOrgName);
-                    printf(TEXT("\n"));
+                        Product.String(TEXT("organization"), szOrgName);
                     if (*szSerialBuf)
-                        printf(TEXT("\t\tSerial Code: %s\n"), szSerialBuf);
+                        Product.String(TEXT("serial"), szSerialBuf);
                 }
             }            
+            Product.End();
+            PropertiesSpan.End();
         
             UINT InstallStatesIndex = 0;
-            UINT isInstallStatesCount[COUNTAllowedInstallStates];
+            UINT isInstallStatesCount[COUNTAllowedInstallStates + 1];
 
             if (olFeatureStates & eOutput)
             {
                 // features
+                CTraceSpan FeaturesSpan(TEXT("features"), TEXT("product"), szProductCode);
                 UINT iFeatureIndex = 0;
                 TCHAR szFeatureName[MAX_FEATURE_CHARS] = TEXT("");
                 TCHAR szFeatureParent[MAX_FEATURE_CHARS] = TEXT("");
@@ -719,15 +1575,22 @@ void __cdecl main(int argc, char* argv[])
                 }
 
                 if (olFeatureList & eOutput)
-                    printf(TEXT("\tFeatures for this product:\n"));
-                while(ERROR_SUCCESS == MsiEnumFeatures(szProductCode, iFeatureIndex, szFeatureName, szFeatureParent))
+                    g_Out.Printf(TEXT("\tFeatures for this product:\n"));
+                while(ERROR_SUCCESS == pProductData->EnumFeatures(szProductCode, iFeatureIndex, szFeatureName, szFeatureParent))
                 {
                     
-                    isFeatureState = MsiQueryFeatureState(szProductCode, szFeatureName);
+                    isFeatureState = pProductData->QueryFeatureState(szProductCode, szFeatureName);
                     InstallStatesIndex = isFeatureState + AllowedInstallStatesOffset;
+
+                    CJsonRecord Feature(g_pJsonOut, TEXT("feature"));
+                    Feature.String(TEXT("product"), szProductCode);
+                    Feature.String(TEXT("feature"), szFeatureName);
+                    if (*szFeatureParent)
+                        Feature.String(TEXT("parent"), szFeatureParent);
+                    Feature.Int(TEXT("state"), isFeatureState);
         
                     if (olFeatureList & eOutput)
-                        printf(TEXT("\t\t%-40s"), szFeatureName);
+                        g_Out.Printf(TEXT("\t\t%-40s"), szFeatureName);
 
                     isInstallStatesCount[InstallStatesIndex]++;
 
@@ -735,52 +1598,53 @@ void __cdecl main(int argc, char* argv[])
                     {
                         int iIndex = GetInstallStateStringIndex(isFeatureState);
                         if (iIndex)
-                            printf(TEXT("(%s)"), InstallStateNames[iIndex].szStateShort);
+                            g_Out.Printf(TEXT("(%s)"), InstallStateNames[iIndex].szStateShort);
                     
                         // Feature usage
                         DWORD dwUseCount = 0;
                         WORD wDateUsed = 0;
 
-                        printf(TEXT("\n"));
+                        g_Out.Printf(TEXT("\n"));
 
-                        if (ERROR_SUCCESS == MsiGetFeatureUsage(szProductCode, szFeatureName, &dwUseCount, &wDateUsed))
+                        if (ERROR_SUCCESS == pProductData->GetFeatureUsage(szProductCode, szFeatureName, &dwUseCount, &wDateUsed))
                         {
-                            printf(TEXT("\t\t\tUses: %4u"), dwUseCount);
+                            g_Out.Printf(TEXT("\t\t\tUses: %4u"), dwUseCount);
+                            Feature.UInt(TEXT("uses"), dwUseCount);
                             if (wDateUsed)
                             {
-                                printf(TEXT(",\tLast Used: %04d\\%02d\\%02d"), 
+                                g_Out.Printf(TEXT(",\tLast Used: %04d\\%02d\\%02d"), 
                                     /*year*/ ((wDateUsed & 0xFE00) >> 9) + 1980, /*month*/ ((wDateUsed & 0x1E0) >> 5),/*day*/ (wDateUsed & 0x1F));                        
+                                Feature.Date(TEXT("lastUsed"), ((wDateUsed & 0xFE00) >> 9) + 1980, (wDateUsed & 0x1E0) >> 5, wDateUsed & 0x1F);
                             }
-                            printf(TEXT("\n"));
+                            g_Out.Printf(TEXT("\n"));
                         }
                 
                     }    
+                    Feature.End();
                     iFeatureIndex++;
                 }
-                printf(TEXT("\t%d feature%s.\n"), iFeatureIndex, Pluralize(iFeatureIndex));
+                g_Out.Printf(TEXT("\t%d feature%s.\n"), iFeatureIndex, Pluralize(iFeatureIndex));
 
                 UINT uiFeaturesAccountedFor = 0;
                 for(int cStates = 1; cStates < (sizeof(InstallStateNames) / sizeof(INSTALLSTATENAMES)); cStates++)
                 {
                     InstallStatesIndex = InstallStateNames[cStates].IS + AllowedInstallStatesOffset;
-                    printf(TEXT("\t\t%d feature%s %s.\n"), isInstallStatesCount[InstallStatesIndex], Pluralize(isInstallStatesCount[InstallStatesIndex]), InstallStateNames[cStates].szState);
+                    g_Out.Printf(TEXT("\t\t%d feature%s %s.\n"), isInstallStatesCount[InstallStatesIndex], Pluralize(isInstallStatesCount[InstallStatesIndex]), InstallStateNames[cStates].szState);
                     uiFeaturesAccountedFor += isInstallStatesCount[InstallStatesIndex];
                 }
 
                 UINT uiFeaturesUnaccountedFor = iFeatureIndex - uiFeaturesAccountedFor;
-                printf(TEXT("\t\t%d feature%s in some other state.\n"),uiFeaturesUnaccountedFor, Pluralize(uiFeaturesUnaccountedFor));
+                g_Out.Printf(TEXT("\t\t%d feature%s in some other state.\n"),uiFeaturesUnaccountedFor, Pluralize(uiFeaturesUnaccountedFor));
             }
 
             if (olComponentCount & eOutput)
             {
                 // components
-                UINT uiComponentIndex = 0;
+                CTraceSpan ComponentsSpan(TEXT("components"), TEXT("product"), szProductCode);
                 UINT cComponentsForThisProduct = 0;
                 UINT cQualifiedComponentsForThisProduct = 0;
                 UINT cSharedComponentsForThisProduct = 0;
                 UINT cPermanentComponentsForThisProduct = 0;
-                TCHAR szComponentId[CCHGuid] = TEXT("");
-                TCHAR szClientProductCode[CCHGuid] = TEXT("");
     
                 for (int cInstallStates = 0; cInstallStates <= COUNTAllowedInstallStates; cInstallStates++)
                 {
@@ -788,105 +1652,148 @@ void __cdecl main(int argc, char* argv[])
                 }
 
                 if (olComponentList & eOutput)
-                    printf(TEXT("\tComponents for this product: \n"));
-                while(ERROR_SUCCESS == MsiEnumComponents(uiComponentIndex++, szComponentId))
+                    g_Out.Printf(TEXT("\tComponents for this product: \n"));
+
+                // all components on the entire system are listed, but you have to enumerate
+                // the clients to know if this product uses this component - the index did that once.
+                const COMPONENTCLIENT* pRegistrations = NULL;
+                DWORD cRegistrations = FindProductComponents(&ComponentIndex, szProductCode, &pRegistrations);
+
+                // a -j record already holds its keypath probes.
+                bool fProbeAhead = ProbePool.IsStarted() && !fEnrich;
+                DWORD iAheadRegistration = 0;
+
+                for (DWORD iRegistration = 0; iRegistration < cRegistrations; )
                 {
-                    // all components on the entire system are listed, but you have to enumerate
-                    // the clients to know if this product uses this component.
-                    UINT uiEnumerateClients = 0;
-                    bool fProductForThisComponent = false;
-                    bool fPermanentComponent = false;
-                    bool fSharedComponent = false;
-
-                    while(ERROR_SUCCESS == MsiEnumClients(szComponentId, uiEnumerateClients++, szClientProductCode))
+                    DWORD iComponent = pRegistrations[iRegistration].iComponent;
+                    const TCHAR* szComponentId = ComponentIndex.rgszComponent[iComponent];
+
+                    UINT cProductClients = 0;
+                    for (; (iRegistration < cRegistrations) && (pRegistrations[iRegistration].iComponent == iComponent); iRegistration++)
+                    {
+                        cProductClients++;
+                        if (olComponentList & eOutput)
+                            g_Out.Printf(TEXT("\t%s"), szComponentId);
+                    }
+
+                    // any other client that isn't the permanent placeholder makes it shared.
+                    UINT cPermanentClients = ComponentIndex.rgcPermanentClients[iComponent];
+                    bool fPermanentComponent = (0 != cPermanentClients);
+                    bool fSharedComponent = (ComponentClientCount(&ComponentIndex, iComponent) > cProductClients + cPermanentClients);
+
+                    CJsonRecord Component(g_pJsonOut, TEXT("component"));
+                    Component.String(TEXT("product"), szProductCode);
+                    Component.String(TEXT("component"), szComponentId);
+                    Component.Bool(TEXT("permanent"), fPermanentComponent);
+                    Component.Bool(TEXT("shared"), fSharedComponent);
+
+                    if (olComponentList & eOutput)
                     {
-                        if (0 == _stricmp(szClientProductCode, szProductCode))
+                        if (fPermanentComponent)
+                            g_Out.Printf(TEXT(" (permanent)"));
+                        if (fSharedComponent)
+                            g_Out.Printf(TEXT(" (shared)"));
+                        
+                        INSTALLSTATE isState;
+                        const PROBEITEM* pProbeItem = NULL;
+                        if (fProbeAhead)
                         {
-                            fProductForThisComponent = true;
-                            if (olComponentList & eOutput)
-                                printf(TEXT("\t%s"), szComponentId);
+                            // asked ahead, in this order.
+                            SubmitProductProbes(&ProbePool, pProductData, szProductCode, &ComponentIndex, pRegistrations, cRegistrations, &Arena, &iAheadRegistration);
+                            pProbeItem = ProbePool.Peek();
+                            assert(pProbeItem && pProbeItem->dwTag == iComponent);
                         }
-                        else if (0 == _stricmp(szClientProductCode, SZPermanentProduct))
+                        if (pProbeItem && !pProbeItem->fTooLong)
                         {
-                            fPermanentComponent = true;
+                            isState = pProbeItem->isState;
+                            szProductInfo = pProbeItem->szKeyPath;
                         }
                         else
                         {
-                            fSharedComponent = true;
+                            isState = QueryComponentPath(pProductData, szProductCode, szComponentId, &Arena, &szProductInfo);
                         }
-                    }
+                        InstallStatesIndex = isState + AllowedInstallStatesOffset;
+                        isInstallStatesCount[InstallStatesIndex]++;
 
-                    if (fProductForThisComponent)
-                    {
-                        // at this point, you actually know we're on a component for this product.
+                        int iIndex = GetInstallStateStringIndex(isState);
+
+                        if (iIndex)
+                            g_Out.Printf(TEXT(" (%s)"), InstallStateNames[iIndex].szStateShort);
                         
-                        if (olComponentList & eOutput)
+                        g_Out.Printf(TEXT("\n"));
+                        Component.Int(TEXT("state"), isState);
+                    
+                        if ((INSTALLSTATE_ABSENT != isState) && *szProductInfo)
                         {
-                            if (fPermanentComponent)
-                                printf(TEXT(" (permanent)"));
-                            if (fSharedComponent)
-                                printf(TEXT(" (shared)"));
-                            
-                            *szProductInfo = NULL;
-
-                            INSTALLSTATE isState = MsiGetComponentPath(szProductCode, szComponentId, szProductInfo, &cchProductInfo);
-                            InstallStatesIndex = isState + AllowedInstallStatesOffset;
-                            isInstallStatesCount[InstallStatesIndex]++;
-
-                            int iIndex = GetInstallStateStringIndex(isState);
-                            
-                            cchProductInfo = CCHProductInfo;
-
-                            if (iIndex)
-                                printf(TEXT(" (%s)"), InstallStateNames[iIndex].szStateShort);
-                            
-                            printf(TEXT("\n"));
+                            g_Out.Printf(TEXT("\t\tPath: %s\n"), szProductInfo);
+                            Component.String(TEXT("path"), szProductInfo);
+                        }
                         
+                        UINT uiEnumerateQualifiers = 0;
+                        const TCHAR* szQualifierBuf;
+                        const TCHAR* szApplicationDataBuf;
+
+                        // File version    
+                        KEYPATHPROBE Probe;
+                        const KEYPATHPROBE* pProbe = NULL;
+                        if (pProbeItem && !pProbeItem->fTooLong)
+                        {
                             if ((INSTALLSTATE_ABSENT != isState) && *szProductInfo)
-                                printf(TEXT("\t\tPath: %s\n"), szProductInfo);
-                            
-                            UINT uiEnumerateQualifiers = 0;
-    
-                            TCHAR szQualifierBuf[CCHProductInfo] = TEXT("");
-                            DWORD cchQualifierBuf = CCHProductInfo;
-
-                            TCHAR szApplicationDataBuf[CCHProductInfo] = TEXT("");
-                            DWORD cchApplicationDataBuf = CCHProductInfo;
-
-                            // File version    
-                            if (INSTALLSTATE_ABSENT != isState)                        
-                                PrintVersionInfo(szProductInfo);
-
-                            bool fQualified = false;
-                            while(ERROR_SUCCESS == MsiEnumComponentQualifiers(szComponentId, uiEnumerateQualifiers++, szQualifierBuf, &cchQualifierBuf, szApplicationDataBuf, &cchApplicationDataBuf))
                             {
-                                cchQualifierBuf = CCHProductInfo;
-                                cchApplicationDataBuf = CCHProductInfo;
-                                
-                                printf(TEXT("\t\tQualifier: %s"), szQualifierBuf);
-                                if (*szApplicationDataBuf)
-                                    printf(TEXT(", Application Data: %s"), szApplicationDataBuf);
-                                printf(TEXT("\n"));
-                                fQualified = true;
+                                PrintKeyPathProbe(pProbeItem->Probe);
+                                pProbe = &pProbeItem->Probe;
                             }
+                        }
+                        else if (INSTALLSTATE_ABSENT != isState)                        
+                        {
+                            if (PrintVersionInfo(pProductData, szProductInfo, &Probe))
+                                pProbe = &Probe;
+                        }
 
-                            if (fQualified) 
-                            {
-                                cTotalQualifiedComponents++;
-                                cQualifiedComponentsForThisProduct++;
-                            }
+                        bool fQualified = false;
+                        while(ERROR_SUCCESS == QueryComponentQualifier(pProductData, szComponentId, uiEnumerateQualifiers++, &Arena, &szQualifierBuf, &szApplicationDataBuf))
+                        {
+                            g_Out.Printf(TEXT("\t\tQualifier: %s"), szQualifierBuf);
+                            if (*szApplicationDataBuf)
+                                g_Out.Printf(TEXT(", Application Data: %s"), szApplicationDataBuf);
+                            g_Out.Printf(TEXT("\n"));
+
+                            if (!fQualified)
+                                Component.BeginArray(TEXT("qualifiers"));
+                            Component.BeginObject();
+                            Component.String(TEXT("qualifier"), szQualifierBuf);
+                            if (*szApplicationDataBuf)
+                                Component.String(TEXT("applicationData"), szApplicationDataBuf);
+                            Component.EndObject();
+                            fQualified = true;
+                        }
+                        if (fQualified)
+                            Component.EndArray();
+
+                        // the component's record is closed before its keypath's starts.
+                        Component.End();
+                        if (pProbe)
+                            WriteKeyPathRecord(szComponentId, szProductCode, szProductInfo, *pProbe);
+                        if (pProbeItem)
+                            ProbePool.Pop();
 
+                        if (fQualified) 
+                        {
+                            cTotalQualifiedComponents++;
+                            cQualifiedComponentsForThisProduct++;
                         }
 
-                        cComponentsForThisProduct++;
-                        if (fPermanentComponent)
-                            cPermanentComponentsForThisProduct++;
-                        if (fSharedComponent)
-                            cSharedComponentsForThisProduct++;
                     }
+
+                    Component.End();
+                    cComponentsForThisProduct++;
+                    if (fPermanentComponent)
+                        cPermanentComponentsForThisProduct++;
+                    if (fSharedComponent)
+                        cSharedComponentsForThisProduct++;
                 }
                 
-                cTotalComponents = uiComponentIndex-1;
+                cTotalComponents = ComponentIndex.cComponents;
                 cAccountedForComponents += cComponentsForThisProduct;
 
                 if (olComponentList & eOutput)
@@ -894,46 +1801,67 @@ void __cdecl main(int argc, char* argv[])
                     for(int cStates = 1; cStates < (sizeof(InstallStateNames) / sizeof(INSTALLSTATENAMES)); cStates++)
                     {
                         InstallStatesIndex = InstallStateNames[cStates].IS + AllowedInstallStatesOffset;
-                        printf(TEXT("\t\t%d component%s %s.\n"), isInstallStatesCount[InstallStatesIndex], Pluralize(isInstallStatesCount[InstallStatesIndex]), InstallStateNames[cStates].szState);
+                        g_Out.Printf(TEXT("\t\t%d component%s %s.\n"), isInstallStatesCount[InstallStatesIndex], Pluralize(isInstallStatesCount[InstallStatesIndex]), InstallStateNames[cStates].szState);
                     }
                 }
 
-                printf(TEXT("\t%d component%s.\n"), cComponentsForThisProduct, Pluralize(cComponentsForThisProduct));
-                printf(TEXT("\t\t%d qualified.\n"), cQualifiedComponentsForThisProduct);
-                printf(TEXT("\t\t%d permanent.\n"), cPermanentComponentsForThisProduct);
-                printf(TEXT("\t\t%d shared.\n"), cSharedComponentsForThisProduct);
+                g_Out.Printf(TEXT("\t%d component%s.\n"), cComponentsForThisProduct, Pluralize(cComponentsForThisProduct));
+                g_Out.Printf(TEXT("\t\t%d qualified.\n"), cQualifiedComponentsForThisProduct);
+                g_Out.Printf(TEXT("\t\t%d permanent.\n"), cPermanentComponentsForThisProduct);
+                g_Out.Printf(TEXT("\t\t%d shared.\n"), cSharedComponentsForThisProduct);
             } // olComponentCount
 
             // patches
+            CTraceSpan PatchesSpan(TEXT("patches"), TEXT("product"), szProductCode);
             UINT uiPatchIndex = 0;
             TCHAR szPatchId[CCHGuid] = TEXT("");
-            TCHAR szTransformList[CCHProductInfo] = TEXT("");
-            while(ERROR_SUCCESS == MsiEnumPatches(szProductCode, uiPatchIndex, szPatchId, szTransformList, &cchProductInfo))
+            const TCHAR* szTransformList;
+            while(ERROR_SUCCESS == QueryPatch(pProductData, szProductCode, uiPatchIndex, szPatchId, &Arena, &szTransformList))
             {
-                printf(TEXT("\tPatch GUID: %s\n"), szPatchId);
+                g_Out.Printf(TEXT("\tPatch GUID: %s\n"), szPatchId);
                 uiPatchIndex++;
-                cchProductInfo = CCHProductInfo;
             
                 if(*szTransformList)
-                    printf(TEXT("\t\tTransforms: %s\n"), szTransformList);
-                
+                    g_Out.Printf(TEXT("\t\tTransforms: %s\n"), szTransformList);
+
+                CJsonRecord Patch(g_pJsonOut, TEXT("patch"));
+                Patch.String(TEXT("product"), szProductCode);
+                Patch.String(TEXT("patch"), szPatchId);
+                if (*szTransformList)
+                    Patch.String(TEXT("transforms"), szTransformList);
+                Patch.End();
             }
 
-            printf(TEXT("\t%d patch package%s.\n"), uiPatchIndex, Pluralize(uiPatchIndex));
+            g_Out.Printf(TEXT("\t%d patch package%s.\n"), uiPatchIndex, Pluralize(uiPatchIndex));
+            PatchesSpan.End();
 
-            printf(TEXT("\n"));
+            g_Out.Printf(TEXT("\n"));
         }
-        assert(ERROR_NO_MORE_ITEMS == uiEnumerateReturn);
+        assert(fReportStopped || (ERROR_NO_MORE_ITEMS == uiEnumerateReturn));
+        LoopSpan.End();
+
+        if (!fReportStopped)
+        {
+            g_Out.Printf(TEXT("%d product%s installed.\n"), iProductIndex-1, Pluralize(iProductIndex-1));
 
-        printf(TEXT("%d product%s installed.\n"), iProductIndex-1, Pluralize(iProductIndex-1));
+            if (olComponentCount & eOutput)
+                g_Out.Printf(TEXT("%d total component%s. \n\n"), cTotalComponents, Pluralize(cTotalComponents));
 
-        if (olComponentCount & eOutput)
-            printf(TEXT("%d total component%s. \n\n"), cTotalComponents, Pluralize(cTotalComponents));
+            CJsonRecord Summary(g_pJsonOut, TEXT("summary"));
+            Summary.String(TEXT("section"), TEXT("products"));
+            Summary.UInt(TEXT("products"), iProductIndex-1);
+            if (olComponentCount & eOutput)
+                Summary.UInt(TEXT("components"), cTotalComponents);
+            Summary.End();
+        }
     }
     
 
-    if (eOutput & olComponentEvaluation)
+    if (!fReportStopped && (eOutput & olComponentEvaluation))
     {
+        SetCallPhase(cpComponents);
+        CTraceSpan EvaluationSpan(TEXT("component evaluation"));
+
         // If there are no shared or permanent components, this should be zero.
         // If there are permanent components, this count will go positive.
         // If there are shared components, this count will go negative.
@@ -942,58 +1870,53 @@ void __cdecl main(int argc, char* argv[])
         // find orphaned components
         // an orphaned component may have a product listed, but the product wasn't listed
         // in MsiEnumProduct.
-        UINT uiComponentIndex = 0;
-        TCHAR szOrphanedId[CCHGuid] = TEXT("");
-        TCHAR szProductClient[CCHGuid] = TEXT("");
         UINT cSharedComponents = 0;
         UINT cPermanentComponents = 0;
         UINT cPermanentAndParentedComponents = 0;
 
         cUnaccountedComponents = 0;
+
+        // -p filters the list on product names the look-ahead does not ask for.
+        bool fProbeAhead = ProbePool.IsStarted() && ProductFilter.IsEmpty();
+        DWORD iAheadComponent = 0;
+
         // enumerate every component,
         // then the clients of that component,
         // and check to see if that client is a product of the system.
-        while(ERROR_SUCCESS == MsiEnumComponents(uiComponentIndex++, szOrphanedId))
+        for (DWORD iComponent = 0; iComponent < ComponentIndex.cComponents; iComponent++)
         {
+            const TCHAR* szOrphanedId = ComponentIndex.rgszComponent[iComponent];
+            const COMPONENTCLIENT* pClients = &ComponentIndex.rgClients[ComponentIndex.rgiFirstClient[iComponent]];
+            UINT cClients = ComponentClientCount(&ComponentIndex, iComponent);
+
+            Arena.Reset();
+            szProductInfo = TEXT("");
+
             bool fParentFound = false;
             bool fPermanent = false;
             bool fSharedComponent = false;
             bool fPermanentAndParented = false;
             bool fSpecificProductFound = false;
-            UINT uiClientIndex = 0;
-            while(ERROR_SUCCESS == MsiEnumClients(szOrphanedId, uiClientIndex++, szProductClient))
+            for (UINT iClient = 0; iClient < cClients; iClient++)
             {
-                UINT uiProductIndex = 0;
-                TCHAR szProduct[CCHGuid] = TEXT("");
-                if (0 == _stricmp(szProductClient, SZPermanentProduct))
+                const TCHAR* szProductClient = pClients[iClient].szClient;
+                const GUIDKEY& ClientKey = pClients[iClient].ClientKey;
+                if (IsEqualGuidKey(ClientKey, KEYPermanentProduct))
                 {
                     fPermanent = true;
                 }
             
-                if (pszLimitProduct)
+                // one client on the watch-list is enough; its name is asked for once a run.
+                if (!ProductFilter.IsEmpty() && !fSpecificProductFound)
                 {
-                    if (0 == _stricmp(szProductClient, pszLimitProduct))
-                    {
+                    if (ProductFilter.MatchesClient(g_pInstallerData, szProductClient, ClientKey))
                         fSpecificProductFound = true;
-                    }
-                    else
-                    {
-                        if (ERROR_SUCCESS == MsiGetProductInfo(szProductClient, INSTALLPROPERTY_PRODUCTNAME, szProductInfo, &cchProductInfo))
-                        {
-                            if (0 == _stricmp(szProductInfo, pszLimitProduct))
-                                fSpecificProductFound = true;
-                        }
-                        cchProductInfo = CCHProductInfo;
-                    }
                 }
 
-                while (ERROR_SUCCESS == MsiEnumProducts(uiProductIndex++, szProduct))
+                if (IsGuidKeyInSet(&ProductSet, ClientKey))
                 {
-                    if (0 == _stricmp(szProduct, szProductClient))
-                    {
-                        fParentFound = true;
-                    }
-                } // products on system
+                    fParentFound = true;
+                }
             } // clients of this component
 
             if (!fParentFound)
@@ -1008,19 +1931,19 @@ void __cdecl main(int argc, char* argv[])
                 cPermanentComponents++;
 
             // A permanent component will have 2 clients, where a normal only has 1.
-            if (uiClientIndex > ((fPermanent) ? (UINT) 3 : (UINT) 2))
+            if (cClients > ((fPermanent) ? (UINT) 2 : (UINT) 1))
             {
                 fSharedComponent = true;
                 cSharedComponents++;
             }
 
-            if ((!fParentFound || fSharedComponent) && ((NULL == pszLimitProduct) || fSpecificProductFound))
+            if ((!fParentFound || fSharedComponent) && (ProductFilter.IsEmpty() || fSpecificProductFound))
             {
                 if (!fParentFound)
                 {
                     if (olOrphanedComponents & eOutput)
                     {
-                        printf(TEXT("Component %s has no parent product"), szOrphanedId);
+                        g_Out.Printf(TEXT("Component %s has no parent product"), szOrphanedId);
                     }
                     else 
                         continue;
@@ -1029,206 +1952,237 @@ void __cdecl main(int argc, char* argv[])
                 {
                     if (olSharedComponents & eOutput)
                     {
-                        printf(TEXT("Component %s (shared)"), szOrphanedId);
+                        g_Out.Printf(TEXT("Component %s (shared)"), szOrphanedId);
                     }
                     else 
                         continue;
                 }
                 if (fPermanent)
                 {
-                    printf(TEXT(" (permanent)"));
+                    g_Out.Printf(TEXT(" (permanent)"));
                 }
-                printf(TEXT("\n"));
+                g_Out.Printf(TEXT("\n"));
             }
             else
             {
                 continue;
             }
 
-            uiClientIndex = 0;
-            while(ERROR_SUCCESS == MsiEnumClients(szOrphanedId, uiClientIndex++, szProductClient))
+            // a listed component: its clients' names and paths, and its keypath.
+            CTraceSpan ComponentSpan(TEXT("component"), TEXT("component"), szOrphanedId);
+            CJsonRecord Component(g_pJsonOut, TEXT("component"));
+            Component.String(TEXT("component"), szOrphanedId);
+            Component.Bool(TEXT("orphaned"), !fParentFound);
+            Component.Bool(TEXT("permanent"), fPermanent);
+            Component.Bool(TEXT("shared"), fSharedComponent);
+            Component.UInt(TEXT("clients"), cClients);
+            Component.End();
+
+            for (UINT iClient = 0; iClient < cClients; iClient++)
             {
-                printf(TEXT("\tProduct Code: %s\n"), szProductClient);
-                if (0==_stricmp(SZPermanentProduct, szProductClient))
+                const TCHAR* szProductClient = pClients[iClient].szClient;
+                g_Out.Printf(TEXT("\tProduct Code: %s\n"), szProductClient);
+
+                CJsonRecord Client(g_pJsonOut, TEXT("client"));
+                Client.String(TEXT("component"), szOrphanedId);
+                Client.String(TEXT("product"), szProductClient);
+                if (IsEqualGuidKey(pClients[iClient].ClientKey, KEYPermanentProduct))
                 {    
-                    printf(TEXT("\t\tPermanent Product placeholder.\n"));
+                    g_Out.Printf(TEXT("\t\tPermanent Product placeholder.\n"));
+                    Client.Bool(TEXT("permanentPlaceholder"), true);
                 }
-                else if (ERROR_SUCCESS == MsiGetProductInfo(szProductClient, INSTALLPROPERTY_PRODUCTNAME, szProductInfo, &cchProductInfo))
+                else if (ERROR_SUCCESS == QueryProductInfo(g_pInstallerData, szProductClient, INSTALLPROPERTY_PRODUCTNAME, &Arena, &szProductInfo))
                 {
-                    printf(TEXT("\t\tName: %s\n"), szProductInfo);
+                    g_Out.Printf(TEXT("\t\tName: %s\n"), szProductInfo);
+                    Client.String(TEXT("name"), szProductInfo);
                 }
-                cchProductInfo = CCHProductInfo;
 
-                *szProductInfo = NULL;
-                if (!szProductInfo[0])
-                {
-                    MsiGetComponentPath(szProductClient, szOrphanedId, szProductInfo, &cchProductInfo);
-                    cchProductInfo = CCHProductInfo;
-                }
+                QueryComponentPath(g_pInstallerData, szProductClient, szOrphanedId, &Arena, &szProductInfo);
+                if (*szProductInfo)
+                    Client.String(TEXT("path"), szProductInfo);
+                Client.End();
             } 
 
             // components on the system                
             if (*szProductInfo)
             {
-                printf(TEXT("\tComponent path: %s\n"), szProductInfo);
-                PrintVersionInfo(szProductInfo);
+                g_Out.Printf(TEXT("\tComponent path: %s\n"), szProductInfo);
+
+                const PROBEITEM* pProbeItem = NULL;
+                if (fProbeAhead)
+                {
+                    // queued in component order; anything before this one was not listed after all.
+                    for (;;)
+                    {
+                        SubmitEvaluationProbes(&ProbePool, &ComponentIndex, &ProductSet, eOutput, &Arena, &iAheadComponent);
+                        pProbeItem = ProbePool.Peek();
+                        if (!pProbeItem || pProbeItem->dwTag >= iComponent)
+                            break;
+                        ProbePool.Pop();
+                    }
+                }
+
+                KEYPATHPROBE Probe;
+                const KEYPATHPROBE* pProbe = &Probe;
+                if (pProbeItem && (pProbeItem->dwTag == iComponent) && (0 == lstrcmp(pProbeItem->szKeyPath, szProductInfo)))
+                {
+                    PrintKeyPathProbe(pProbeItem->Probe);
+                    pProbe = &pProbeItem->Probe;
+                }
+                else
+                    PrintVersionInfo(g_pInstallerData, szProductInfo, &Probe);
+
+                WriteKeyPathRecord(szOrphanedId, pClients[cClients-1].szClient, szProductInfo, *pProbe);
+                if (pProbe != &Probe)
+                    ProbePool.Pop();
             }
         }
 
-        printf(TEXT("\n"));
-        printf(TEXT("%d component%s without an installed product.\n"), cUnaccountedComponents, Pluralize(cUnaccountedComponents));
-        printf(TEXT("%d permanent component%s with a product currently installed.\n"), cPermanentAndParentedComponents, Pluralize(cPermanentAndParentedComponents));
-        printf(TEXT("%d permanent component%s.\n"), cPermanentComponents, Pluralize(cPermanentComponents));
+        g_Out.Printf(TEXT("\n"));
+        g_Out.Printf(TEXT("%d component%s without an installed product.\n"), cUnaccountedComponents, Pluralize(cUnaccountedComponents));
+        g_Out.Printf(TEXT("%d permanent component%s with a product currently installed.\n"), cPermanentAndParentedComponents, Pluralize(cPermanentAndParentedComponents));
+        g_Out.Printf(TEXT("%d permanent component%s.\n"), cPermanentComponents, Pluralize(cPermanentComponents));
         if (olComponentList & eOutput)
         {
-            printf(TEXT("%d qualified component%s.\n"), cTotalQualifiedComponents, Pluralize(cTotalQualifiedComponents));
+            g_Out.Printf(TEXT("%d qualified component%s.\n"), cTotalQualifiedComponents, Pluralize(cTotalQualifiedComponents));
         }
-        printf(TEXT("%d shared component%s between currently installed applications.\n"), cSharedComponents, Pluralize(cSharedComponents));
+        g_Out.Printf(TEXT("%d shared component%s between currently installed applications.\n"), cSharedComponents, Pluralize(cSharedComponents));
+
+        CJsonRecord Summary(g_pJsonOut, TEXT("summary"));
+        Summary.String(TEXT("section"), TEXT("components"));
+        Summary.UInt(TEXT("orphaned"), cUnaccountedComponents);
+        Summary.UInt(TEXT("permanentParented"), cPermanentAndParentedComponents);
+        Summary.UInt(TEXT("permanent"), cPermanentComponents);
+        if (olComponentList & eOutput)
+            Summary.UInt(TEXT("qualified"), cTotalQualifiedComponents);
+        Summary.UInt(TEXT("shared"), cSharedComponents);
+        Summary.End();
 
     }
 
-    if (eOutput & olLoggingInfo)
+    DWORD cEventRecords = 0;
+    DWORD cEventReads = 0;
+    ECheckpoint eEventCheckpoint = ecNone;
+    if (!fReportStopped && (eOutput & olLoggingInfo))
     {
-        // need to pull both system and user temp.
-        WIN32_FIND_DATA fd;
-        TCHAR szSearchFile[MAX_PATH]=TEXT("");
-        GetTempPath(MAX_PATH, szSearchFile);
-        bool fMachineTempFound = false;
+        SetCallPhase(cpLogs);
 
-        printf(TEXT("\nUser log files in "), szSearchFile);
-        
-        for (int iRepeat=0; iRepeat < ((g_fWin9X) ? 1 : 2); iRepeat++)
+        if (pszLogDirectory)
         {
-            strcat(szSearchFile,TEXT("msi*.log"));
-            printf(TEXT("%s:\n"), szSearchFile);
+            g_Out.Printf(TEXT("\nLog files in %s:\n"), pszLogDirectory);
+            PrintLogDirectory(pszLogDirectory, fScanLogs, cScanThreads);
+        }
+#ifdef _WIN32
+        else
+        {
+            // need to pull both system and user temp.
+            TCHAR szSearchFile[MAX_PATH]=TEXT("");
+            GetTempPath(MAX_PATH, szSearchFile);
+            bool fMachineTempFound = false;
 
-            HANDLE hfff = FindFirstFile(szSearchFile, &fd);
-            BOOL fFoundFile = (INVALID_HANDLE_VALUE != hfff);
-            while (fFoundFile)
+            g_Out.Printf(TEXT("\nUser log files in "), szSearchFile);
+        
+            for (int iRepeat=0; iRepeat < ((g_fWin9X) ? 1 : 2); iRepeat++)
             {
-                printf(TEXT("\t%-20s "), fd.cFileName);
-                PrintLocalFileTime(fd.ftLastWriteTime, true);
-                printf(TEXT("\n"));
-                fFoundFile = FindNextFile(hfff, &fd);
-            }
-            FindClose(hfff);
+                TCHAR szLogDirectory[MAX_PATH];
+                lstrcpy(szLogDirectory, szSearchFile);
+                strcat(szSearchFile,TEXT("msi*.log"));
+                g_Out.Printf(TEXT("%s:\n"), szSearchFile);
 
-            if (!g_fWin9X)
-            {
-                LPVOID pvoid=NULL;
-                
-                if (!fMachineTempFound && CreateEnvironmentBlock(&pvoid, NULL, FALSE))
+                PrintLogDirectory(szLogDirectory, fScanLogs, cScanThreads);
+
+                if (!g_fWin9X)
                 {
-                    WCHAR* pchEnv = (WCHAR*) pvoid;
-                    const WCHAR* const szSearch = L"tmp=";
-                    const int cbSearch = lstrlenW(szSearch);
+                    LPVOID pvoid=NULL;
                 
-                    while(NULL !=pchEnv)
+                    CCallTimer EnvironmentTimer(tcCreateEnvironmentBlock);
+                    BOOL fEnvironment = !fMachineTempFound && CreateEnvironmentBlock(&pvoid, NULL, FALSE);
+                    EnvironmentTimer.Stop();
+                    if (fEnvironment)
                     {
-                        if (0==_wcsnicmp(szSearch, pchEnv, cbSearch))
+                        WCHAR* pchEnv = (WCHAR*) pvoid;
+                        const WCHAR* const szSearch = L"tmp=";
+                        const int cbSearch = lstrlenW(szSearch);
+                
+                        while(NULL !=pchEnv)
                         {
-                            TCHAR* pchSearchFile = szSearchFile;
-                            pchEnv+=cbSearch;
-                            while(NULL != *pchEnv)
+                            if (0==_wcsnicmp(szSearch, pchEnv, cbSearch))
                             {
-                                // purposefully strip out the second half of the unicode character.
-                                *pchSearchFile++ = *(TCHAR*) pchEnv++;
+                                TCHAR* pchSearchFile = szSearchFile;
+                                pchEnv+=cbSearch;
+                                while(NULL != *pchEnv)
+                                {
+                                    // purposefully strip out the second half of the unicode character.
+                                    *pchSearchFile++ = *(TCHAR*) pchEnv++;
+                                }
+                                *pchSearchFile='\\';
+                                pchSearchFile[1]=NULL;
+                                fMachineTempFound = true;
+                                break;
                             }
-                            *pchSearchFile='\\';
-                            pchSearchFile[1]=NULL;
-                            fMachineTempFound = true;
-                            break;
-                        }
-                        else
-                        {
-                            while(NULL !=*pchEnv)
+                            else
                             {
-                                pchEnv = CharNextW(pchEnv);
+                                while(NULL !=*pchEnv)
+                                {
+                                    pchEnv = CharNextW(pchEnv);
+                                }
+                                pchEnv++;
                             }
-                            pchEnv++;
                         }
-                    }
 
-                    DestroyEnvironmentBlock(pvoid);
-                    if (fMachineTempFound)
-                        printf(TEXT("\nMachine logs in "), szSearchFile);
-                }
+                        DestroyEnvironmentBlock(pvoid);
+                        if (fMachineTempFound)
+                            g_Out.Printf(TEXT("\nMachine logs in "), szSearchFile);
+                    }
                 
+                }
             }
+
         }
+#endif // _WIN32
 
-        if (eOutput & olLoggingInfo)
+        // Event log stuff
+        CEventLogReader EventReader;
+        EventReader.SetCutoff(dwEventsSince);
+        if (pszEventStateFile)
+        {
+            EVENTCHECKPOINT Checkpoint;
+            UINT uiState = LoadEventCheckpoint(pszEventStateFile, &Checkpoint);
+            if (ERROR_SUCCESS == uiState)
+                EventReader.SetCheckpoint(Checkpoint);
+            else if (ERROR_FILE_NOT_FOUND != uiState)
+                fprintf(stderr, TEXT("Cannot read event state %s: %d; listing every event.\n"), pszEventStateFile, uiState);
+        }
+        if (pszEventsFile)
+        {
+            g_Out.Printf(TEXT("\nEvent log entries:\n"));
+            CTraceSpan Span(TEXT("read events"), TEXT("source"), pszEventsFile);
+            UINT uiEvents = EventReader.OpenDump(pszEventsFile);
+            if (ERROR_SUCCESS == uiEvents)
+            {
+                PrintMsiEvents(EventReader);
+                uiEvents = EventReader.Error();
+            }
+            if (ERROR_SUCCESS != uiEvents)
+            {
+                g_Out.Flush();
+                fprintf(stderr, TEXT("Cannot read events %s: %d\n"), pszEventsFile, uiEvents);
+            }
+        }
+#ifdef _WIN32
+        else
         {
-            // Event log stuff
-            printf(TEXT("\nEvent log entries:\n"));
+            g_Out.Printf(TEXT("\nEvent log entries:\n"));
+            CTraceSpan Span(TEXT("read events"), TEXT("source"), (g_fWin9X) ? TEXT("msievent.log") : TEXT("Application"));
             if (!g_fWin9X)
             {
                 //  read recent entries from the event log for MSI
-                HANDLE hEvent = OpenEventLog(NULL, TEXT("Application"));
-        
-                if (NULL != hEvent)
-                {
-                    byte bEvents[4096];
-                    EVENTLOGRECORD *pevlr = (EVENTLOGRECORD *) &bEvents;
-                    DWORD dwRecordOffset = 0; // 1 based
-                    DWORD dwBytesRead = 0;
-                    DWORD dwMinNumberOfBytesNeeded = 0;
-                    BOOL fReadMore = true;
-                    LPTSTR lpBuffer = NULL;
-            
-                    GetNumberOfEventLogRecords(hEvent, &dwRecordOffset);
-
-                    while(dwRecordOffset && fReadMore)
-                    {
-                        fReadMore = ReadEventLog(hEvent, EVENTLOG_SEEK_READ | EVENTLOG_BACKWARDS_READ, 
-                                    dwRecordOffset--, bEvents, 4096, &dwBytesRead, &dwMinNumberOfBytesNeeded);
-
-                        if (!fReadMore)
-                        {
-                            if (ERROR_INSUFFICIENT_BUFFER == GetLastError())
-                            {
-                                // item too big - not MSI.
-                                fReadMore=true;
-                                continue;
-                            }
-                            else
-                                break;
-                        }
-                        else
-                        {
-                            TCHAR* szSource = (LPSTR) ((LPBYTE) pevlr + 
-                                sizeof(EVENTLOGRECORD));
-
-                            if (0==_stricmp(szSource, TEXT("MsiInstaller")))
-                            {
-                                PrintEventLogTimeGenerated(pevlr);
-
-                                printf(TEXT(" Type: "));
-                                if (0 == pevlr->EventType)
-                                    printf(TEXT("SUCCESS     "));
-                                if (EVENTLOG_ERROR_TYPE & (pevlr->EventType))
-                                    printf(TEXT("ERROR       "));
-                                if (EVENTLOG_INFORMATION_TYPE & (pevlr->EventType))
-                                    printf(TEXT("INFORMATION "));
-                                if (EVENTLOG_WARNING_TYPE & (pevlr->EventType))
-                                    printf(TEXT("WARNING     "));
-                                if (EVENTLOG_AUDIT_SUCCESS & (pevlr->EventType))
-                                    printf(TEXT("AUDIT_SUCCESS "));
-                                if (EVENTLOG_AUDIT_FAILURE & (pevlr->EventType))
-                                    printf(TEXT("AUDIT_FAILURE "));
-
-                                printf(TEXT("Event ID: 0x%08X "),  pevlr->EventID);
-                                printf(TEXT("Source: %s\n"), szSource); 
-                                
-                                printf(TEXT("\t%s\n"), ((TCHAR*) pevlr)+ (unsigned int)pevlr->UserSidOffset+(unsigned int)pevlr->UserSidLength);
-                            }
-                        }    
-                    }
-                    CloseEventLog(hEvent);
-                }        
+                if (ERROR_SUCCESS == EventReader.OpenLive(TEXT("Application")))
+                    PrintMsiEvents(EventReader);
             }    
             else
             {
+                // 9x keeps its events as text; -json and -since leave them out.
                 TCHAR szSearchFile[MAX_PATH]=TEXT("");
                 GetTempPath(MAX_PATH, szSearchFile);
                 strcat(szSearchFile, TEXT("msievent.log"));
@@ -1237,14 +2191,34 @@ void __cdecl main(int argc, char* argv[])
                 {
                     TCHAR szBuf[4096];
                     DWORD dwRead = 0;
-                    while(ReadFile(hFile, szBuf, 4096, &dwRead, NULL) && dwRead)
+                    for (;;)
                     {
-                        printf(TEXT("%s"), szBuf);
+                        CCallTimer ReadTimer(tcReadFile);
+                        BOOL fRead = ReadFile(hFile, szBuf, 4096, &dwRead, NULL);
+                        ReadTimer.Stop();
+                        if (!fRead || !dwRead)
+                            break;
+                        g_Out.Printf(TEXT("%s"), szBuf);
                     }
                     CloseHandle(hFile);
                 }
 
 
+            }
+        }
+#endif // _WIN32
+        cEventRecords = EventReader.RecordCount();
+        cEventReads = EventReader.ReadCount();
+        eEventCheckpoint = EventReader.CheckpointState();
+
+        // the next run picks up from the newest record, once this one has listed everything after the last.
+        if (pszEventStateFile && cEventReads && (ERROR_SUCCESS == EventReader.Error()) && EventReader.Newest().dwRecordNumber)
+        {
+            UINT uiState = SaveEventCheckpoint(pszEventStateFile, EventReader.Newest());
+            if (ERROR_SUCCESS != uiState)
+            {
+                g_Out.Flush();
+                fprintf(stderr, TEXT("Cannot write event state %s: %d\n"), pszEventStateFile, uiState);
             }
         }
     }
@@ -1252,9 +2226,73 @@ void __cdecl main(int argc, char* argv[])
     clockFinish = clock();
     float fSeconds = float(clockFinish - clockStart) / float(CLOCKS_PER_SEC);
 
-    if (olTimeElapsed & eOutput)
-        printf(TEXT("Time: %2.2f seconds\n"), fSeconds);
+    if (!fReportStopped && (olTimeElapsed & eOutput))
+    {
+        DWORD cHits = pProbeCache->Hits();
+        DWORD cMisses = pProbeCache->Misses();
+        g_Out.Printf(TEXT("Keypath probe cache: %u hit%s, %u miss%s\n"), cHits, Pluralize(cHits), cMisses, (1 == cMisses) ? TEXT("") : TEXT("es"));
+        DWORD cLookups, cAccountHits;
+        GetAccountCacheCounts(&cLookups, &cAccountHits);
+        g_Out.Printf(TEXT("Account lookups: %u, %u answered from cache\n"), cLookups, cAccountHits);
+        static const TCHAR* rgszCheckpoint[] = { TEXT(""), TEXT(", down to the last run's newest"), TEXT(", all: cleared since the last run"), TEXT(", all: wrapped since the last run") };
+        if (cEventReads)
+            g_Out.Printf(TEXT("Event log: %u record%s in %u read%s%s\n"), cEventRecords, Pluralize(cEventRecords), cEventReads, Pluralize(cEventReads), rgszCheckpoint[eEventCheckpoint]);
+        if (fProductEventsRead)
+            g_Out.Printf(TEXT("Product events: %u MsiInstaller event%s, %u by product code, %u by name only\n"), ProductEvents.EventCount(),
+                Pluralize(ProductEvents.EventCount()), ProductEvents.ByCodeCount(), ProductEvents.ByNameCount());
+        DWORD cCalls = PrintCallTimes();
+        g_Out.Printf(TEXT("Time: %2.2f seconds\n"), fSeconds);
+
+        CJsonRecord Summary(g_pJsonOut, TEXT("summary"));
+        Summary.String(TEXT("section"), TEXT("run"));
+        Summary.UInt(TEXT("probeCacheHits"), cHits);
+        Summary.UInt(TEXT("probeCacheMisses"), cMisses);
+        Summary.UInt(TEXT("accountLookups"), cLookups);
+        Summary.UInt(TEXT("accountCacheHits"), cAccountHits);
+        if (cEventReads)
+        {
+            Summary.UInt(TEXT("eventRecords"), cEventRecords);
+            Summary.UInt(TEXT("eventReads"), cEventReads);
+            if (ecNone != eEventCheckpoint)
+                Summary.String(TEXT("eventCheckpoint"), (ecReached == eEventCheckpoint) ? TEXT("reached") : (ecCleared == eEventCheckpoint) ? TEXT("cleared") : TEXT("wrapped"));
+        }
+        if (fProductEventsRead)
+        {
+            Summary.UInt(TEXT("productEvents"), ProductEvents.EventCount());
+            Summary.UInt(TEXT("productEventsByCode"), ProductEvents.ByCodeCount());
+            Summary.UInt(TEXT("productEventsByName"), ProductEvents.ByNameCount());
+        }
+        Summary.UInt(TEXT("calls"), cCalls);
+        Summary.UInt(TEXT("milliseconds"), (unsigned int) (fSeconds * 1000));
+        Summary.End();
+    }
 
+#ifdef _WIN32
     MsiSetInternalUI(iuiLevel, NULL);
-    return;
+#endif
+    ProbePool.Finish();
+    if (pszTraceFile)
+    {
+        // every thread that traced has been joined.
+        UINT uiTrace = WriteTrace(pszTraceFile);
+        if (ERROR_SUCCESS != uiTrace)
+        {
+            g_Out.Flush();
+            fprintf(stderr, TEXT("Cannot write trace %s: %d\n"), pszTraceFile, uiTrace);
+        }
+    }
+    FreeComponentIndex(&ComponentIndex);
+    FreeGuidSet(&ProductSet);
+    delete g_pInstallerData;
+    g_pInstallerData = NULL;
+    StopCallTiming();
+    FreeAccountCache();
+    g_Out.Flush();
+    g_pJsonOut = NULL;
+    return 0;
+}
+
+int __cdecl main(int argc, char* argv[])
+{
+    return RunReport(argc, argv);
 }
\ No newline at end of file
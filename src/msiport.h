@@ -0,0 +1,378 @@
+/*---------------------------------------------------------------------------
+Platform layer.
+
+    On Windows this just pulls in the SDK and Windows Installer headers.
+
+    Everywhere else it supplies the handful of Win32 and Windows Installer
+    types, constants and time helpers the report code uses, so that the
+    inventory pipeline can be built and run against a synthetic or recorded
+    installer-data provider (see installerdata.h) for profiling off-box.
+    Only what the tool actually touches is declared here - this is not an
+    attempt at a general Win32 emulation.
+
+---------------------------------------------------------------------------*/
+
+#ifndef MSIPORT_H
+#define MSIPORT_H
+
+#ifdef _WIN32
+
+#include <windows.h>
+#define _WIN32_MSI 110
+#include "msi.h"
+#include <userenv.h>
+
+#else // !_WIN32
+
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <sys/time.h>
+#include <pthread.h>
+
+typedef int             BOOL;
+typedef unsigned char   BYTE;
+typedef unsigned char   byte;
+typedef unsigned short  WORD;
+typedef unsigned int    DWORD;
+typedef unsigned int    UINT;
+typedef int             LONG;
+typedef char            TCHAR;
+typedef char*           LPSTR;
+typedef char*           LPTSTR;
+typedef const char*     LPCSTR;
+typedef const char*     LPCTSTR;
+typedef void*           LPVOID;
+typedef void*           HANDLE;
+typedef void*           HKEY;
+
+#ifndef TRUE
+#define TRUE    1
+#define FALSE   0
+#endif
+
+#define __int64     long long
+#define TEXT(x)     x
+#define __cdecl
+#define MAX_PATH    260
+
+#define lstrlen     strlen
+#define lstrcmpi    strcasecmp
+#define _stricmp    strcasecmp
+#define _strnicmp   strncasecmp
+#define lstrcpy     strcpy
+#define lstrcmp     strcmp
+
+// Win32 error codes returned by the installer-data providers.
+#define ERROR_SUCCESS               0
+#define ERROR_FILE_NOT_FOUND        2
+#define ERROR_PATH_NOT_FOUND        3
+#define ERROR_ACCESS_DENIED         5
+#define ERROR_NOT_ENOUGH_MEMORY     8
+#define ERROR_INVALID_DATA          13
+#define ERROR_WRITE_FAULT           29
+#define ERROR_READ_FAULT            30
+#define ERROR_HANDLE_EOF            38
+#define ERROR_INVALID_PARAMETER     87
+#define ERROR_OPEN_FAILED           110
+#define ERROR_INSUFFICIENT_BUFFER   122
+#define ERROR_MORE_DATA             234
+#define ERROR_NO_MORE_ITEMS         259
+#define ERROR_FILE_INVALID          1006
+#define ERROR_TIMEOUT               1460
+#define ERROR_UNKNOWN_PRODUCT       1605
+#define ERROR_UNKNOWN_FEATURE       1606
+#define ERROR_UNKNOWN_COMPONENT     1607
+#define ERROR_UNKNOWN_PROPERTY      1608
+#define ERROR_BAD_CONFIGURATION     1610
+
+#define FILE_ATTRIBUTE_READONLY             0x00000001
+#define FILE_ATTRIBUTE_HIDDEN               0x00000002
+#define FILE_ATTRIBUTE_SYSTEM               0x00000004
+#define FILE_ATTRIBUTE_DIRECTORY            0x00000010
+#define FILE_ATTRIBUTE_ARCHIVE              0x00000020
+#define FILE_ATTRIBUTE_NORMAL               0x00000080
+#define FILE_ATTRIBUTE_TEMPORARY            0x00000100
+#define FILE_ATTRIBUTE_SPARSE_FILE          0x00000200
+#define FILE_ATTRIBUTE_REPARSE_POINT        0x00000400
+#define FILE_ATTRIBUTE_COMPRESSED           0x00000800
+#define FILE_ATTRIBUTE_OFFLINE              0x00001000
+#define FILE_ATTRIBUTE_NOT_CONTENT_INDEXED  0x00002000
+#define FILE_ATTRIBUTE_ENCRYPTED            0x00004000
+
+#define SCS_32BIT_BINARY    0
+#define SCS_DOS_BINARY      1
+#define SCS_WOW_BINARY      2
+#define SCS_PIF_BINARY      3
+#define SCS_POSIX_BINARY    4
+#define SCS_OS216_BINARY    5
+#define SCS_64BIT_BINARY    6
+
+#define VER_PLATFORM_WIN32_WINDOWS  1
+#define VER_PLATFORM_WIN32_NT       2
+
+inline char* lstrcpyn(char* szDest, const char* szSource, int cchDest)
+{
+    int ich = 0;
+    for (; ich < cchDest - 1 && szSource[ich]; ich++)
+        szDest[ich] = szSource[ich];
+    if (cchDest > 0)
+        szDest[ich] = 0;
+    return szDest;
+}
+
+typedef struct _OSVERSIONINFO {
+    DWORD dwOSVersionInfoSize;
+    DWORD dwMajorVersion;
+    DWORD dwMinorVersion;
+    DWORD dwBuildNumber;
+    DWORD dwPlatformId;
+    TCHAR szCSDVersion[128];
+} OSVERSIONINFO;
+
+// msi.h
+
+#define MAX_FEATURE_CHARS  38
+
+typedef enum tagINSTALLSTATE
+{
+    INSTALLSTATE_NOTUSED      = -7,
+    INSTALLSTATE_BADCONFIG    = -6,
+    INSTALLSTATE_INCOMPLETE   = -5,
+    INSTALLSTATE_SOURCEABSENT = -4,
+    INSTALLSTATE_MOREDATA     = -3,
+    INSTALLSTATE_INVALIDARG   = -2,
+    INSTALLSTATE_UNKNOWN      = -1,
+    INSTALLSTATE_BROKEN       =  0,
+    INSTALLSTATE_ADVERTISED   =  1,
+    INSTALLSTATE_REMOVED      =  1,
+    INSTALLSTATE_ABSENT       =  2,
+    INSTALLSTATE_LOCAL        =  3,
+    INSTALLSTATE_SOURCE       =  4,
+    INSTALLSTATE_DEFAULT      =  5,
+} INSTALLSTATE;
+
+typedef enum tagUSERINFOSTATE
+{
+    USERINFOSTATE_MOREDATA   = -3,
+    USERINFOSTATE_INVALIDARG = -2,
+    USERINFOSTATE_UNKNOWN    = -1,
+    USERINFOSTATE_ABSENT     =  0,
+    USERINFOSTATE_PRESENT    =  1,
+} USERINFOSTATE;
+
+#define INSTALLPROPERTY_PACKAGENAME          "PackageName"
+#define INSTALLPROPERTY_TRANSFORMS           "Transforms"
+#define INSTALLPROPERTY_LANGUAGE             "Language"
+#define INSTALLPROPERTY_PRODUCTNAME          "ProductName"
+#define INSTALLPROPERTY_ASSIGNMENTTYPE       "AssignmentType"
+#define INSTALLPROPERTY_PACKAGECODE          "PackageCode"
+#define INSTALLPROPERTY_VERSION              "Version"
+#define INSTALLPROPERTY_PRODUCTICON          "ProductIcon"
+#define INSTALLPROPERTY_INSTALLEDPRODUCTNAME "InstalledProductName"
+#define INSTALLPROPERTY_VERSIONSTRING        "VersionString"
+#define INSTALLPROPERTY_HELPLINK             "HelpLink"
+#define INSTALLPROPERTY_HELPTELEPHONE        "HelpTelephone"
+#define INSTALLPROPERTY_INSTALLLOCATION      "InstallLocation"
+#define INSTALLPROPERTY_INSTALLSOURCE        "InstallSource"
+#define INSTALLPROPERTY_INSTALLDATE          "InstallDate"
+#define INSTALLPROPERTY_PUBLISHER            "Publisher"
+#define INSTALLPROPERTY_LOCALPACKAGE         "LocalPackage"
+#define INSTALLPROPERTY_URLINFOABOUT         "URLInfoAbout"
+#define INSTALLPROPERTY_URLUPDATEINFO        "URLUpdateInfo"
+#define INSTALLPROPERTY_PRODUCTID            "ProductID"
+
+// event log records, as ReadEventLog returns them (event log dumps, eventlog.h).
+
+#define EVENTLOG_SUCCESS                0x0000
+#define EVENTLOG_ERROR_TYPE             0x0001
+#define EVENTLOG_WARNING_TYPE           0x0002
+#define EVENTLOG_INFORMATION_TYPE       0x0004
+#define EVENTLOG_AUDIT_SUCCESS          0x0008
+#define EVENTLOG_AUDIT_FAILURE          0x0010
+
+typedef struct _EVENTLOGRECORD {
+    DWORD Length;
+    DWORD Reserved;
+    DWORD RecordNumber;
+    DWORD TimeGenerated;
+    DWORD TimeWritten;
+    DWORD EventID;
+    WORD  EventType;
+    WORD  NumStrings;
+    WORD  EventCategory;
+    WORD  ReservedFlags;
+    DWORD ClosingRecordNumber;
+    DWORD StringOffset;
+    DWORD UserSidLength;
+    DWORD UserSidOffset;
+    DWORD DataLength;
+    DWORD DataOffset;
+} EVENTLOGRECORD;
+
+// time
+
+typedef struct _FILETIME {
+    DWORD dwLowDateTime;
+    DWORD dwHighDateTime;
+} FILETIME;
+
+typedef struct _SYSTEMTIME {
+    WORD wYear;
+    WORD wMonth;
+    WORD wDayOfWeek;
+    WORD wDay;
+    WORD wHour;
+    WORD wMinute;
+    WORD wSecond;
+    WORD wMilliseconds;
+} SYSTEMTIME;
+
+#endif // _WIN32
+
+// FILETIME is 100ns ticks since 1601; this is the 1601 -> 1970 distance.
+const __int64 FILETIMEUnixEpoch = 116444736000000000LL;
+
+inline __int64 FileTimeToInt64(const FILETIME* pft)
+{
+    return (__int64) (((unsigned long long) pft->dwHighDateTime << 32) | pft->dwLowDateTime);
+}
+
+inline void Int64ToFileTime(__int64 lgTime, FILETIME* pft)
+{
+    pft->dwLowDateTime = (DWORD) lgTime;
+    pft->dwHighDateTime = (DWORD) (lgTime >> 32);
+}
+
+#ifndef _WIN32
+
+// the time functions the report calls, on top of libc.
+
+inline void GetSystemTime(SYSTEMTIME* pst)
+{
+    struct timeval tv;
+    struct tm tmUTC;
+    gettimeofday(&tv, NULL);
+    time_t t = tv.tv_sec;
+    gmtime_r(&t, &tmUTC);
+
+    pst->wYear = (WORD) (tmUTC.tm_year + 1900);
+    pst->wMonth = (WORD) (tmUTC.tm_mon + 1);
+    pst->wDayOfWeek = (WORD) tmUTC.tm_wday;
+    pst->wDay = (WORD) tmUTC.tm_mday;
+    pst->wHour = (WORD) tmUTC.tm_hour;
+    pst->wMinute = (WORD) tmUTC.tm_min;
+    pst->wSecond = (WORD) tmUTC.tm_sec;
+    pst->wMilliseconds = (WORD) (tv.tv_usec / 1000);
+}
+
+inline BOOL SystemTimeToFileTime(const SYSTEMTIME* pst, FILETIME* pft)
+{
+    struct tm tmUTC;
+    memset(&tmUTC, 0, sizeof(tmUTC));
+    tmUTC.tm_year = pst->wYear - 1900;
+    tmUTC.tm_mon = pst->wMonth - 1;
+    tmUTC.tm_mday = pst->wDay;
+    tmUTC.tm_hour = pst->wHour;
+    tmUTC.tm_min = pst->wMinute;
+    tmUTC.tm_sec = pst->wSecond;
+
+    __int64 lgSeconds = (__int64) timegm(&tmUTC);
+    Int64ToFileTime(lgSeconds * 10000000 + pst->wMilliseconds * 10000 + FILETIMEUnixEpoch, pft);
+    return TRUE;
+}
+
+inline BOOL FileTimeToSystemTime(const FILETIME* pft, SYSTEMTIME* pst)
+{
+    __int64 lgTicks = FileTimeToInt64(pft) - FILETIMEUnixEpoch;
+    __int64 lgSeconds = lgTicks / 10000000;
+    if (lgTicks < 0 && (lgTicks % 10000000))
+        lgSeconds--;
+
+    time_t t = (time_t) lgSeconds;
+    struct tm tmUTC;
+    if (!gmtime_r(&t, &tmUTC))
+        return FALSE;
+
+    pst->wYear = (WORD) (tmUTC.tm_year + 1900);
+    pst->wMonth = (WORD) (tmUTC.tm_mon + 1);
+    pst->wDayOfWeek = (WORD) tmUTC.tm_wday;
+    pst->wDay = (WORD) tmUTC.tm_mday;
+    pst->wHour = (WORD) tmUTC.tm_hour;
+    pst->wMinute = (WORD) tmUTC.tm_min;
+    pst->wSecond = (WORD) tmUTC.tm_sec;
+    pst->wMilliseconds = (WORD) ((lgTicks - lgSeconds * 10000000) / 10000);
+    return TRUE;
+}
+
+inline BOOL FileTimeToLocalFileTime(const FILETIME* pft, FILETIME* pftLocal)
+{
+    __int64 lgTicks = FileTimeToInt64(pft);
+    time_t t = (time_t) ((lgTicks - FILETIMEUnixEpoch) / 10000000);
+    struct tm tmLocal;
+    if (!localtime_r(&t, &tmLocal))
+        return FALSE;
+
+    Int64ToFileTime(lgTicks + (__int64) tmLocal.tm_gmtoff * 10000000, pftLocal);
+    return TRUE;
+}
+
+inline void Sleep(DWORD dwMilliseconds)
+{
+    struct timespec ts;
+    ts.tv_sec = dwMilliseconds / 1000;
+    ts.tv_nsec = (long) (dwMilliseconds % 1000) * 1000000;
+    nanosleep(&ts, NULL);
+}
+
+// critical sections, on top of pthreads.
+typedef pthread_mutex_t CRITICAL_SECTION;
+
+inline void InitializeCriticalSection(CRITICAL_SECTION* pcs)   { pthread_mutex_init(pcs, NULL); }
+inline void DeleteCriticalSection(CRITICAL_SECTION* pcs)       { pthread_mutex_destroy(pcs); }
+inline void EnterCriticalSection(CRITICAL_SECTION* pcs)        { pthread_mutex_lock(pcs); }
+inline void LeaveCriticalSection(CRITICAL_SECTION* pcs)        { pthread_mutex_unlock(pcs); }
+
+inline LONG InterlockedIncrement(volatile LONG* plAddend)      { return __sync_add_and_fetch(plAddend, 1); }
+inline LONG InterlockedDecrement(volatile LONG* plAddend)      { return __sync_sub_and_fetch(plAddend, 1); }
+inline LONG InterlockedExchange(volatile LONG* plTarget, LONG lValue)     { return __sync_lock_test_and_set(plTarget, lValue); }
+inline __int64 InterlockedExchangeAdd64(volatile __int64* plgAddend, __int64 lgValue)  { return __sync_fetch_and_add(plgAddend, lgValue); }
+
+// the performance counter is CLOCK_MONOTONIC, in nanoseconds.
+typedef union _LARGE_INTEGER {
+    __int64 QuadPart;
+} LARGE_INTEGER;
+
+inline BOOL QueryPerformanceCounter(LARGE_INTEGER* pliCount)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    pliCount->QuadPart = (__int64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+    return TRUE;
+}
+
+inline BOOL QueryPerformanceFrequency(LARGE_INTEGER* pliFrequency)
+{
+    pliFrequency->QuadPart = 1000000000;
+    return TRUE;
+}
+
+#endif // _WIN32
+
+// platform the tool is running on - set once by SetPlatformInfo().
+extern OSVERSIONINFO   g_osviVersion;
+extern bool            g_fWin9X;
+
+#define MinimumPlatform(fWin9X, minMajor, minMinor) ((g_fWin9X == fWin9X) && ((minMajor < g_osviVersion.dwMajorVersion) || ((minMajor == g_osviVersion.dwMajorVersion) && (minMinor <= g_osviVersion.dwMinorVersion))))
+
+// make sure that the help file gets update as new platform values are added.
+#define MinimumPlatformWindowsNT51() MinimumPlatform(false, 5, 1)
+#define MinimumPlatformWindows2000() MinimumPlatform(false, 5, 0)
+#define MinimumPlatformWindowsNT4()  MinimumPlatform(false, 4, 0)
+
+#define MinimumPlatformMillennium()  MinimumPlatform(true,  4, 90)
+#define MinimumPlatformWindows98()   MinimumPlatform(true,  4, 10)
+#define MinimumPlatformWindows95()   MinimumPlatform(true,  4, 0)
+
+#endif // MSIPORT_H
+
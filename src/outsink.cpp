@@ -0,0 +1,289 @@
+/*---------------------------------------------------------------------------
+Report output - see outsink.h.
+---------------------------------------------------------------------------*/
+
+#include "outsink.h"
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+COutputSink g_Out(stdout);
+
+COutputSink::COutputSink(FILE* pFile)
+    : m_pFile(pFile), m_pchBuffer(NULL), m_cch(0), m_fAllocated(false), m_cbWritten(0), m_fDiscard(false)
+{
+}
+
+COutputSink::~COutputSink()
+{
+    Flush();
+    free(m_pchBuffer);
+}
+
+void COutputSink::Flush()
+{
+    if (m_cch)
+    {
+        fwrite(m_pchBuffer, sizeof(TCHAR), m_cch, m_pFile);
+        m_cbWritten += m_cch * sizeof(TCHAR);
+        m_cch = 0;
+    }
+    fflush(m_pFile);
+}
+
+void COutputSink::Write(const TCHAR* pch, DWORD cch)
+{
+    if (m_fDiscard)
+        return;
+    if (!m_fAllocated)
+    {
+        m_fAllocated = true;
+        m_pchBuffer = (TCHAR*) malloc(CCHOutputBuffer * sizeof(TCHAR));
+    }
+
+    if (!m_pchBuffer || cch >= CCHOutputBuffer)
+    {
+        // no buffer, or more than it holds - the stream may as well have it now.
+        Flush();
+        fwrite(pch, sizeof(TCHAR), cch, m_pFile);
+        m_cbWritten += cch * sizeof(TCHAR);
+        return;
+    }
+
+    if (m_cch + cch > CCHOutputBuffer)
+    {
+        fwrite(m_pchBuffer, sizeof(TCHAR), m_cch, m_pFile);
+        m_cbWritten += m_cch * sizeof(TCHAR);
+        m_cch = 0;
+    }
+    memcpy(m_pchBuffer + m_cch, pch, cch * sizeof(TCHAR));
+    m_cch += cch;
+}
+
+void COutputSink::Str(const TCHAR* sz)
+{
+    Write(sz, lstrlen(sz));
+}
+
+void COutputSink::Char(TCHAR ch)
+{
+    if (m_fDiscard)
+        return;
+    if (m_pchBuffer && m_cch < CCHOutputBuffer)
+        m_pchBuffer[m_cch++] = ch;
+    else
+        Write(&ch, 1);
+}
+
+void COutputSink::Pad(TCHAR ch, int cch)
+{
+    TCHAR rgch[32];
+    for (int ich = 0; ich < 32; ich++)
+        rgch[ich] = ch;
+    for (; cch > 0; cch -= 32)
+        Write(rgch, (cch < 32) ? cch : 32);
+}
+
+// the digits of uValue, written backwards from pchEnd; returns the first.
+static TCHAR* FormatDigits(unsigned __int64 uValue, unsigned int uBase, bool fUpper, TCHAR* pchEnd)
+{
+    const TCHAR* szDigits = (fUpper) ? TEXT("0123456789ABCDEF") : TEXT("0123456789abcdef");
+    TCHAR* pch = pchEnd;
+    do
+    {
+        *--pch = szDigits[uValue % uBase];
+        uValue /= uBase;
+    } while (uValue);
+    return pch;
+}
+
+void COutputSink::UInt(unsigned int uValue, int cchMin, TCHAR chPad)
+{
+    TCHAR rgch[24];
+    TCHAR* pch = FormatDigits(uValue, 10, false, rgch + 24);
+    Pad(chPad, cchMin - (int) (rgch + 24 - pch));
+    Write(pch, (DWORD) (rgch + 24 - pch));
+}
+
+void COutputSink::Int(int iValue, int cchMin, TCHAR chPad)
+{
+    TCHAR rgch[24];
+    bool fNegative = (iValue < 0);
+    unsigned int uValue = (fNegative) ? 0u - (unsigned int) iValue : (unsigned int) iValue;
+    TCHAR* pch = FormatDigits(uValue, 10, false, rgch + 24);
+    int cch = (int) (rgch + 24 - pch) + ((fNegative) ? 1 : 0);
+
+    // "%05d" of -12 is "-0012"; "%5d" is "  -12".
+    if (fNegative && '0' == chPad)
+        Char('-');
+    Pad(chPad, cchMin - cch);
+    if (fNegative && '0' != chPad)
+        Char('-');
+    Write(pch, (DWORD) (rgch + 24 - pch));
+}
+
+void COutputSink::Printf(const TCHAR* szFormat, ...)
+{
+    if (m_fDiscard)
+        return;
+
+    va_list args;
+    va_start(args, szFormat);
+
+    const TCHAR* pch = szFormat;
+    while (*pch)
+    {
+        // the literal run up to the next conversion.
+        const TCHAR* pchPercent = pch;
+        while (*pchPercent && '%' != *pchPercent)
+            pchPercent++;
+        if (pchPercent != pch)
+            Write(pch, (DWORD) (pchPercent - pch));
+        if (!*pchPercent)
+            break;
+
+        const TCHAR* pchSpec = pchPercent;
+        pch = pchPercent + 1;
+        if ('%' == *pch)
+        {
+            Char('%');
+            pch++;
+            continue;
+        }
+
+        bool fLeft = false;
+        bool fZero = false;
+        bool fOther = false;        // a flag, precision or size this does not do itself
+        bool fStar = false;
+        for (;; pch++)
+        {
+            if ('-' == *pch)
+                fLeft = true;
+            else if ('0' == *pch)
+                fZero = true;
+            else if ('+' == *pch || ' ' == *pch || '#' == *pch)
+                fOther = true;
+            else
+                break;
+        }
+        int cchWidth = 0;
+        while (*pch >= '0' && *pch <= '9')
+            cchWidth = cchWidth * 10 + (*pch++ - '0');
+        while ('*' == *pch || '.' == *pch || (*pch >= '0' && *pch <= '9'))
+        {
+            fOther = true;
+            fStar = fStar || ('*' == *pch);
+            pch++;
+        }
+        int cLong = 0;
+        while ('l' == *pch || 'h' == *pch)
+        {
+            if ('l' == *pch)
+                cLong++;
+            fOther = fOther || ('h' == *pch);
+            pch++;
+        }
+        if (cLong)
+            fOther = true;
+
+        TCHAR chConversion = *pch;
+        if (!chConversion)
+            break;
+        pch++;
+        TCHAR chPad = (fZero && !fLeft) ? '0' : ' ';
+
+        if (!fOther && ('s' == chConversion || 'c' == chConversion))
+        {
+            TCHAR ch = 0;
+            const TCHAR* sz = NULL;
+            int cch = 1;
+            if ('s' == chConversion)
+            {
+                sz = va_arg(args, const TCHAR*);
+                if (!sz)
+                    sz = TEXT("(null)");
+                cch = lstrlen(sz);
+            }
+            else
+            {
+                ch = (TCHAR) va_arg(args, int);
+            }
+
+            if (!fLeft)
+                Pad(' ', cchWidth - cch);
+            if (sz)
+                Write(sz, cch);
+            else
+                Char(ch);
+            if (fLeft)
+                Pad(' ', cchWidth - cch);
+        }
+        else if (!fOther && ('d' == chConversion || 'i' == chConversion))
+        {
+            int iValue = va_arg(args, int);
+            if (fLeft)
+            {
+                TCHAR rgch[24];
+                unsigned int uValue = (iValue < 0) ? 0u - (unsigned int) iValue : (unsigned int) iValue;
+                int cch = (int) (rgch + 24 - FormatDigits(uValue, 10, false, rgch + 24)) + ((iValue < 0) ? 1 : 0);
+                Int(iValue);
+                Pad(' ', cchWidth - cch);
+            }
+            else
+                Int(iValue, cchWidth, chPad);
+        }
+        else if (!fOther && ('u' == chConversion || 'x' == chConversion || 'X' == chConversion))
+        {
+            unsigned int uValue = va_arg(args, unsigned int);
+            TCHAR rgch[24];
+            TCHAR* pchDigits = FormatDigits(uValue, ('u' == chConversion) ? 10 : 16, 'X' == chConversion, rgch + 24);
+            int cch = (int) (rgch + 24 - pchDigits);
+            if (!fLeft)
+                Pad(chPad, cchWidth - cch);
+            Write(pchDigits, cch);
+            if (fLeft)
+                Pad(' ', cchWidth - cch);
+        }
+        else
+        {
+            // the C library, for this one conversion.
+            TCHAR szSpec[32];
+            int cchSpec = (int) (pch - pchSpec);
+            if (cchSpec >= 32 || fStar)
+            {
+                // not something the report says; give up on the rest rather than guess at the arguments.
+                Str(pchSpec);
+                break;
+            }
+            memcpy(szSpec, pchSpec, cchSpec * sizeof(TCHAR));
+            szSpec[cchSpec] = 0;
+
+            TCHAR szValue[512];
+            int cchValue = 0;
+            switch (chConversion)
+            {
+                case 'e': case 'E': case 'f': case 'F': case 'g': case 'G':
+                    cchValue = snprintf(szValue, 512, szSpec, va_arg(args, double));
+                    break;
+                case 's':
+                    cchValue = snprintf(szValue, 512, szSpec, va_arg(args, const TCHAR*));
+                    break;
+                case 'p':
+                    cchValue = snprintf(szValue, 512, szSpec, va_arg(args, void*));
+                    break;
+                default:
+                    if (cLong >= 2)
+                        cchValue = snprintf(szValue, 512, szSpec, va_arg(args, long long));
+                    else if (cLong)
+                        cchValue = snprintf(szValue, 512, szSpec, va_arg(args, long));
+                    else
+                        cchValue = snprintf(szValue, 512, szSpec, va_arg(args, int));
+                    break;
+            }
+            if (cchValue > 0)
+                Write(szValue, (cchValue < 512) ? cchValue : 511);
+        }
+    }
+
+    va_end(args);
+}
@@ -0,0 +1,67 @@
+/*---------------------------------------------------------------------------
+Report output.
+
+    A -v report is hundreds of thousands of small printf calls, and piped
+    to a file or a remote console the stdio work per call - locking, format
+    parsing, a write whenever its small buffer fills - is a measurable part
+    of the run.  The report writes through one COutputSink instead: text
+    is appended to a large buffer and handed to the stream in a few large
+    writes.
+
+    Printf takes the formats the report uses (%s %c %d %i %u %x %X with
+    flags '-' and '0' and a width) and formats them itself; anything else
+    (%f) goes through the C library for that one conversion.  The text is
+    the same, byte for byte, that printf would have produced, and it still
+    goes through the same stream, so text-mode newline translation is
+    unchanged.
+
+    Anything else that writes to the same stream, or to stderr when the two
+    are joined, must Flush first.
+---------------------------------------------------------------------------*/
+
+#ifndef OUTSINK_H
+#define OUTSINK_H
+
+#include "msiport.h"
+#include <stdio.h>
+
+const DWORD CCHOutputBuffer = 256 * 1024;
+
+class COutputSink
+{
+public:
+    COutputSink(FILE* pFile);
+    ~COutputSink();     // Flush()
+
+    void  Write(const TCHAR* pch, DWORD cch);
+    void  Str(const TCHAR* sz);
+    void  Char(TCHAR ch);
+    // cchMin pads on the left with chPad, as "%0Nu" / "%Nu" would.
+    void  UInt(unsigned int uValue, int cchMin = 0, TCHAR chPad = ' ');
+    void  Int(int iValue, int cchMin = 0, TCHAR chPad = ' ');
+
+    void  Printf(const TCHAR* szFormat, ...);
+
+    void  Flush();
+
+    // drop everything written from here on - the text report under -json.
+    void  Discard(bool fDiscard)      { m_fDiscard = fDiscard; }
+
+    // everything written so far, flushed or not.
+    unsigned __int64 BytesWritten() const    { return m_cbWritten + m_cch * sizeof(TCHAR); }
+
+private:
+    void  Pad(TCHAR ch, int cch);
+
+    FILE*           m_pFile;
+    TCHAR*          m_pchBuffer;        // allocated on first write; NULL - write straight through
+    DWORD           m_cch;
+    bool            m_fAllocated;
+    unsigned __int64 m_cbWritten;
+    bool            m_fDiscard;
+};
+
+// the report's stdout.
+extern COutputSink g_Out;
+
+#endif // OUTSINK_H
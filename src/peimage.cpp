@@ -0,0 +1,597 @@
+/*---------------------------------------------------------------------------
+Executable images - see peimage.h.
+---------------------------------------------------------------------------*/
+
+#include "peimage.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+// the few header values read here, by their winnt.h meaning.
+const WORD  WPeMagic32 = 0x10B;             // IMAGE_NT_OPTIONAL_HDR32_MAGIC
+const WORD  WPeMagic64 = 0x20B;             // IMAGE_NT_OPTIONAL_HDR64_MAGIC
+const WORD  WPeFileDll = 0x2000;            // IMAGE_FILE_DLL
+const WORD  WPeSubsystemPosix = 7;          // IMAGE_SUBSYSTEM_POSIX_CUI
+const WORD  WNELibrary = 0x8000;            // NE module flags: a library
+const BYTE  BNETargetOS2 = 1;
+const DWORD CBPeSection = 40;               // IMAGE_SECTION_HEADER
+const DWORD IPeResourceDirectory = 2;       // IMAGE_DIRECTORY_ENTRY_RESOURCE
+const WORD  WResourceVersion = 16;          // RT_VERSION
+const WORD  WVersionResourceId = 1;         // VS_VERSION_INFO
+const DWORD DWFixedFileInfoSignature = 0xFEEF04BD;
+const DWORD CBFixedFileInfo = 52;           // VS_FIXEDFILEINFO
+const DWORD CBPeHeaders = 4096;             // read first: the headers of nearly any image, and all of a small one
+
+static WORD ReadWord(const BYTE* pb)
+{
+    return (WORD) (pb[0] | (pb[1] << 8));
+}
+
+static DWORD ReadDword(const BYTE* pb)
+{
+    return (DWORD) pb[0] | ((DWORD) pb[1] << 8) | ((DWORD) pb[2] << 16) | ((DWORD) pb[3] << 24);
+}
+
+// [ib, ib + cbData) lies within cb.
+static bool InImage(size_t cb, size_t ib, size_t cbData)
+{
+    return (ib <= cb) && (cbData <= cb - ib);
+}
+
+// the image as far as it is held: all of it when parsed from memory, the
+// resource section when read from a file.
+struct PEVIEW {
+    const BYTE* pb;             // the bytes held, from offset ibHeld of the image
+    size_t      ibHeld;
+    size_t      cbHeld;
+    size_t      cbImage;        // what offsets are checked against
+    const BYTE* pbSections;     // the section table, all of it within the image
+    DWORD       cSections;
+    DWORD       dwResourceRva;  // 0: none
+    bool        fNotHeld;       // an offset within the image, but outside the bytes held, was asked for
+};
+
+// the offset in View.pb of cbData bytes at dwRva, when one section holds all of them on disk.
+static bool RvaToOffset(PEVIEW& View, DWORD dwRva, DWORD cbData, size_t* pib)
+{
+    for (DWORD iSection = 0; iSection < View.cSections; iSection++)
+    {
+        const BYTE* pbSection = View.pbSections + iSection * CBPeSection;
+        DWORD dwVirtualAddress = ReadDword(pbSection + 12);
+        DWORD cbRaw = ReadDword(pbSection + 16);
+        DWORD ibRaw = ReadDword(pbSection + 20);
+        if (dwRva < dwVirtualAddress)
+            continue;
+        DWORD dwDelta = dwRva - dwVirtualAddress;
+        if ((dwDelta >= cbRaw) || (cbData > cbRaw - dwDelta))
+            continue;
+
+        unsigned __int64 ib = (unsigned __int64) ibRaw + dwDelta;
+        if ((ib > (unsigned __int64) View.cbImage) || !InImage(View.cbImage, (size_t) ib, cbData))
+            return false;
+        if ((ib < View.ibHeld) || !InImage(View.cbHeld, (size_t) ib - View.ibHeld, cbData))
+        {
+            View.fNotHeld = true;
+            return false;
+        }
+        *pib = (size_t) ib - View.ibHeld;
+        return true;
+    }
+    return false;
+}
+
+// the entry of the resource directory at dwDirectory (from the start of the
+// resources) with the ID wId, or its first entry with fAny.
+static bool FindResourceEntry(PEVIEW& View, DWORD dwResourceRva, DWORD dwDirectory, bool fAny, WORD wId, DWORD* pdwEntry)
+{
+    if ((dwResourceRva > 0xFFFFFFFF - 16) || (dwDirectory > 0xFFFFFFFF - 16 - dwResourceRva))
+        return false;
+    size_t ibDirectory;
+    if (!RvaToOffset(View, dwResourceRva + dwDirectory, 16, &ibDirectory))
+        return false;
+    DWORD cNamed = ReadWord(View.pb + ibDirectory + 12);
+    DWORD cEntries = cNamed + ReadWord(View.pb + ibDirectory + 14);
+
+    size_t ibEntries;
+    if (!RvaToOffset(View, dwResourceRva + dwDirectory + 16, cEntries * 8, &ibEntries))
+        return false;
+    for (DWORD iEntry = (fAny) ? 0 : cNamed; iEntry < cEntries; iEntry++)
+    {
+        const BYTE* pbEntry = View.pb + ibEntries + iEntry * 8;
+        DWORD dwName = ReadDword(pbEntry);
+        if (fAny || (!(dwName & 0x80000000) && (wId == dwName)))
+        {
+            *pdwEntry = ReadDword(pbEntry + 4);
+            return true;
+        }
+    }
+    return false;
+}
+
+// a UTF-16 key at pb, within cb, is the ASCII szKey; *pcb is its size, terminator included.
+static bool VersionKeyIs(const BYTE* pb, size_t cb, const char* szKey, size_t* pcb)
+{
+    bool fSame = true;
+    for (size_t ich = 0; 2 * ich + 2 <= cb; ich++)
+    {
+        WORD wch = ReadWord(pb + 2 * ich);
+        if (fSame && (wch != (BYTE) szKey[ich]))
+            fSame = false;
+        if (!wch)
+        {
+            *pcb = 2 * ich + 2;
+            return fSame;
+        }
+    }
+    *pcb = cb;
+    return false;           // no terminator
+}
+
+static size_t Align4(size_t ib)
+{
+    return (ib + 3) & ~(size_t) 3;
+}
+
+// one block of a version resource: wLength, wValueLength, wType, the key,
+// the value and the children, each aligned to 4 bytes from the resource's start.
+struct VERSIONBLOCK {
+    size_t      cbBlock;
+    bool        fKey;           // the key is the one asked about
+    size_t      ibValue;        // from the block's start
+    size_t      cbValue;
+    size_t      ibChildren;
+};
+
+static bool ReadVersionBlock(const BYTE* pb, size_t cb, const char* szKey, VERSIONBLOCK* pBlock)
+{
+    if (cb < 6)
+        return false;
+    pBlock->cbBlock = ReadWord(pb);
+    if ((pBlock->cbBlock < 6) || (pBlock->cbBlock > cb))
+        return false;
+    size_t cbKey;
+    pBlock->fKey = VersionKeyIs(pb + 6, pBlock->cbBlock - 6, szKey, &cbKey);
+    // a text value's length is in characters.
+    pBlock->cbValue = (size_t) ReadWord(pb + 2) * ((1 == ReadWord(pb + 4)) ? 2 : 1);
+    pBlock->ibValue = Align4(6 + cbKey);
+    if (pBlock->ibValue > pBlock->cbBlock)
+        pBlock->ibValue = pBlock->cbBlock;
+    if (pBlock->cbValue > pBlock->cbBlock - pBlock->ibValue)
+        return false;
+    pBlock->ibChildren = Align4(pBlock->ibValue + pBlock->cbValue);
+    return true;
+}
+
+static void ReadTranslation(const BYTE* pb, size_t cb, PEIMAGEINFO* pInfo)
+{
+    // VarFileInfo's children; each is a Var, the Translation one a list of LANGID, codepage.
+    for (size_t ib = 0; ib + 6 <= cb; )
+    {
+        VERSIONBLOCK Var;
+        if (!ReadVersionBlock(pb + ib, cb - ib, "Translation", &Var))
+            return;
+        if (Var.fKey)
+        {
+            for (size_t ibPair = 0; ibPair + 4 <= Var.cbValue; ibPair += 4)
+            {
+                if (pInfo->cLanguages < CPeLanguages)
+                    pInfo->rgwLanguage[pInfo->cLanguages] = ReadWord(pb + ib + Var.ibValue + ibPair);
+                pInfo->cLanguages++;
+            }
+            return;
+        }
+        ib = Align4(ib + Var.cbBlock);
+    }
+}
+
+static UINT ReadVersionInfo(const BYTE* pb, size_t cb, PEIMAGEINFO* pInfo)
+{
+    VERSIONBLOCK Root;
+    if (!ReadVersionBlock(pb, cb, "VS_VERSION_INFO", &Root) || !Root.fKey)
+        return ERROR_INVALID_DATA;
+    if (0 == Root.cbValue)
+        return ERROR_FILE_INVALID;          // no fixed file info: no version to report
+    if ((Root.cbValue < CBFixedFileInfo) || (DWFixedFileInfoSignature != ReadDword(pb + Root.ibValue)))
+        return ERROR_INVALID_DATA;
+    pInfo->dwFileVersionMS = ReadDword(pb + Root.ibValue + 8);
+    pInfo->dwFileVersionLS = ReadDword(pb + Root.ibValue + 12);
+
+    // StringFileInfo and VarFileInfo; the languages are in the second.
+    for (size_t ib = Root.ibChildren; ib + 6 <= Root.cbBlock; )
+    {
+        VERSIONBLOCK Child;
+        if (!ReadVersionBlock(pb + ib, Root.cbBlock - ib, "VarFileInfo", &Child))
+            break;
+        if (Child.fKey)
+        {
+            if (Child.ibChildren < Child.cbBlock)
+                ReadTranslation(pb + ib + Child.ibChildren, Child.cbBlock - Child.ibChildren, pInfo);
+            break;
+        }
+        ib = Align4(ib + Child.cbBlock);
+    }
+    return ERROR_SUCCESS;
+}
+
+// RT_VERSION, VS_VERSION_INFO, the first language - the resource GetFileVersionInfo reads.
+static UINT ReadVersionResource(PEVIEW& View, PEIMAGEINFO* pInfo)
+{
+    DWORD dwResourceRva = View.dwResourceRva;
+    DWORD dwEntry;
+    if (!FindResourceEntry(View, dwResourceRva, 0, false, WResourceVersion, &dwEntry) || !(dwEntry & 0x80000000))
+        return ERROR_FILE_INVALID;
+    if (!FindResourceEntry(View, dwResourceRva, dwEntry & 0x7FFFFFFF, false, WVersionResourceId, &dwEntry) || !(dwEntry & 0x80000000))
+        return ERROR_FILE_INVALID;
+    if (!FindResourceEntry(View, dwResourceRva, dwEntry & 0x7FFFFFFF, true, 0, &dwEntry) || (dwEntry & 0x80000000))
+        return ERROR_FILE_INVALID;
+
+    // IMAGE_RESOURCE_DATA_ENTRY: the data's RVA and size.
+    size_t ibDataEntry;
+    if ((dwEntry > 0xFFFFFFFF - dwResourceRva) || !RvaToOffset(View, dwResourceRva + dwEntry, 16, &ibDataEntry))
+        return ERROR_FILE_INVALID;
+    DWORD dwDataRva = ReadDword(View.pb + ibDataEntry);
+    DWORD cbData = ReadDword(View.pb + ibDataEntry + 4);
+    size_t ibData;
+    if (!RvaToOffset(View, dwDataRva, cbData, &ibData))
+        return ERROR_INVALID_DATA;
+    return ReadVersionInfo(View.pb + ibData, cbData, pInfo);
+}
+
+// the headers' fields into pInfo, and the section table and the resources' RVA into pView.
+static void ParsePeHeaders(const BYTE* pb, size_t cb, size_t ibNew, PEIMAGEINFO* pInfo, PEVIEW* pView)
+{
+    // PE\0\0, then IMAGE_FILE_HEADER.
+    size_t ibFile = ibNew + 4;
+    if (!InImage(cb, ibFile, 20))
+        return;
+    pInfo->wMachine = ReadWord(pb + ibFile);
+    DWORD cSections = ReadWord(pb + ibFile + 2);
+    size_t cbOptional = ReadWord(pb + ibFile + 16);
+    pInfo->wCharacteristics = ReadWord(pb + ibFile + 18);
+
+    size_t ibOptional = ibFile + 20;
+    if ((cbOptional < 70) || !InImage(cb, ibOptional, cbOptional))
+        return;
+    WORD wMagic = ReadWord(pb + ibOptional);
+    size_t ibDirectoryCount;
+    if (WPeMagic32 == wMagic)
+        ibDirectoryCount = 92;
+    else if (WPeMagic64 == wMagic)
+        ibDirectoryCount = 108;
+    else
+        return;
+    pInfo->ik = (WPeMagic32 == wMagic) ? ikPE32 : ikPE64;
+    pInfo->wSubsystem = ReadWord(pb + ibOptional + 68);
+
+    pView->pbSections = pb + ibOptional + cbOptional;
+    pView->cSections = (InImage(cb, ibOptional + cbOptional, (size_t) cSections * CBPeSection)) ? cSections : 0;
+
+    // the resource directory, when the optional header goes that far.
+    size_t ibResource = ibDirectoryCount + 4 + IPeResourceDirectory * 8;
+    if ((ibResource + 8 > cbOptional) || (ReadDword(pb + ibOptional + ibDirectoryCount) <= IPeResourceDirectory))
+        return;
+    pView->dwResourceRva = ReadDword(pb + ibOptional + ibResource);
+}
+
+// everything but the version resource, from the headers in pb[0, cb).
+static void ParseImageHeaders(const BYTE* pb, size_t cb, PEIMAGEINFO* pInfo, PEVIEW* pView)
+{
+    memset(pView, 0, sizeof(PEVIEW));
+    memset(pInfo, 0, sizeof(PEIMAGEINFO));
+    pInfo->ik = ikNone;
+    pInfo->uiVersionResult = ERROR_FILE_INVALID;
+
+    if (!pb || (cb < 0x40) || ('M' != pb[0]) || ('Z' != pb[1]))
+        return;
+    pInfo->ik = ikDos;
+
+    size_t ibNew = ReadDword(pb + 0x3C);
+    if (!InImage(cb, ibNew, 4))
+        return;
+    const BYTE* pbNew = pb + ibNew;
+    if (('P' == pbNew[0]) && ('E' == pbNew[1]) && (0 == pbNew[2]) && (0 == pbNew[3]))
+    {
+        // a PE header the loader would refuse is no image at all.
+        pInfo->ik = ikNone;
+        ParsePeHeaders(pb, cb, ibNew, pInfo, pView);
+    }
+    else if (('N' == pbNew[0]) && ('E' == pbNew[1]) && InImage(cb, ibNew, 0x40))
+    {
+        pInfo->ik = ikNE;
+        pInfo->wCharacteristics = ReadWord(pbNew + 0x0C);
+        pInfo->bTargetOS = pbNew[0x36];
+    }
+    else if (('L' == pbNew[0]) && (('E' == pbNew[1]) || ('X' == pbNew[1])))
+    {
+        pInfo->ik = ikLE;
+    }
+}
+
+void ParsePeImage(const BYTE* pb, size_t cb, PEIMAGEINFO* pInfo)
+{
+    PEVIEW View;
+    ParseImageHeaders(pb, cb, pInfo, &View);
+    if (View.dwResourceRva)
+    {
+        View.pb = pb;
+        View.cbHeld = View.cbImage = cb;
+        pInfo->uiVersionResult = ReadVersionResource(View, pInfo);
+    }
+}
+
+// how far the headers ParseImageHeaders reads go, as far as pb[0, cb) says:
+// no more than cb when it holds them all.
+static unsigned __int64 PeHeadersSize(const BYTE* pb, size_t cb)
+{
+    if ((cb < 0x40) || ('M' != pb[0]) || ('Z' != pb[1]))
+        return cb;
+    size_t ibNew = ReadDword(pb + 0x3C);
+    if (InImage(cb, ibNew, 24) && ('P' == pb[ibNew]) && ('E' == pb[ibNew + 1]) && (0 == pb[ibNew + 2]) && (0 == pb[ibNew + 3]))
+    {
+        // the file header, the optional header and the section table.
+        return (unsigned __int64) ibNew + 24 + ReadWord(pb + ibNew + 20) + (unsigned __int64) ReadWord(pb + ibNew + 6) * CBPeSection;
+    }
+    return (unsigned __int64) ibNew + 0x40;   // an NE header, or enough to tell a PE one
+}
+
+// the on-disk bytes of the section holding dwRva, within the image.
+static bool FindPeSection(const PEVIEW& View, DWORD dwRva, size_t* pib, size_t* pcb)
+{
+    for (DWORD iSection = 0; iSection < View.cSections; iSection++)
+    {
+        const BYTE* pbSection = View.pbSections + iSection * CBPeSection;
+        DWORD dwVirtualAddress = ReadDword(pbSection + 12);
+        DWORD cbRaw = ReadDword(pbSection + 16);
+        DWORD ibRaw = ReadDword(pbSection + 20);
+        if ((dwRva < dwVirtualAddress) || (dwRva - dwVirtualAddress >= cbRaw))
+            continue;
+        if (ibRaw >= View.cbImage)
+            return false;
+        *pib = ibRaw;
+        *pcb = (cbRaw < View.cbImage - ibRaw) ? cbRaw : View.cbImage - ibRaw;
+        return true;
+    }
+    return false;
+}
+
+#ifdef _WIN32
+typedef HANDLE  PEFILEHANDLE;
+
+// cb bytes of the file from ib; false when it has fewer there, or cannot be read.
+static bool ReadPeRange(HANDLE hFile, size_t ib, BYTE* pb, size_t cb)
+{
+    OVERLAPPED ov;
+    memset(&ov, 0, sizeof(ov));
+    ov.Offset = (DWORD) ib;
+    ov.OffsetHigh = (DWORD) ((unsigned __int64) ib >> 32);
+    DWORD cbRead = 0;
+    return (cb <= 0xFFFFFFFF) && ReadFile(hFile, pb, (DWORD) cb, &cbRead, &ov) && (cbRead == cb);
+}
+#else
+typedef int     PEFILEHANDLE;
+
+static bool ReadPeRange(int fd, size_t ib, BYTE* pb, size_t cb)
+{
+    while (cb)
+    {
+        ssize_t cbRead = pread(fd, pb, cb, (off_t) ib);
+        if ((cbRead < 0) && (EINTR == errno))
+            continue;
+        if (cbRead <= 0)
+            return false;
+        pb += cbRead;
+        ib += cbRead;
+        cb -= cbRead;
+    }
+    return true;
+}
+#endif
+
+// the file's bytes [ib, ib + cb) into a buffer of their own, to free; NULL
+// with *puiError when they cannot be had.
+static BYTE* ReadPeBytes(PEFILEHANDLE hFile, size_t ib, size_t cb, UINT* puiError)
+{
+    BYTE* pb = (BYTE*) malloc((cb) ? cb : 1);
+    if (!pb)
+        *puiError = ERROR_NOT_ENOUGH_MEMORY;
+    else if (!ReadPeRange(hFile, ib, pb, cb))
+    {
+        // it changed under the read.
+        free(pb);
+        pb = NULL;
+        *puiError = ERROR_READ_FAULT;
+    }
+    return pb;
+}
+
+// the headers, then the resource section, each read once; the whole file
+// only when the version resource reaches outside its section.
+static void ReadPeImage(PEFILEHANDLE hFile, size_t cbFile, PEIMAGEINFO* pInfo)
+{
+    BYTE rgbHeaders[CBPeHeaders];
+    BYTE* pbHeaders = rgbHeaders;
+    size_t cbHeaders = (cbFile < CBPeHeaders) ? cbFile : CBPeHeaders;
+    UINT uiError = (ReadPeRange(hFile, 0, pbHeaders, cbHeaders)) ? ERROR_SUCCESS : ERROR_READ_FAULT;
+
+    // headers past the first read: again, as far as they go.
+    unsigned __int64 cbNeeded;
+    while ((ERROR_SUCCESS == uiError) && (cbHeaders < cbFile) && ((cbNeeded = PeHeadersSize(pbHeaders, cbHeaders)) > cbHeaders))
+    {
+        size_t cbMore = (cbNeeded < cbFile) ? (size_t) cbNeeded : cbFile;
+        BYTE* pbMore = ReadPeBytes(hFile, 0, cbMore, &uiError);
+        if (pbHeaders != rgbHeaders)
+            free(pbHeaders);
+        pbHeaders = (pbMore) ? pbMore : rgbHeaders;
+        cbHeaders = (pbMore) ? cbMore : 0;
+    }
+
+    if (ERROR_SUCCESS != uiError)
+    {
+        ParsePeImage(NULL, 0, pInfo);
+        pInfo->uiVersionResult = uiError;
+    }
+    else if (cbHeaders == cbFile)
+    {
+        ParsePeImage(pbHeaders, cbHeaders, pInfo);
+    }
+    else
+    {
+        PEVIEW View;
+        ParseImageHeaders(pbHeaders, cbHeaders, pInfo, &View);
+        if (View.dwResourceRva)
+        {
+            View.cbImage = cbFile;
+            BYTE* pbResources = NULL;
+            size_t ibSection;
+            size_t cbSection;
+            if (FindPeSection(View, View.dwResourceRva, &ibSection, &cbSection))
+            {
+                pbResources = ReadPeBytes(hFile, ibSection, cbSection, &uiError);
+                View.pb = pbResources;
+                View.ibHeld = ibSection;
+                View.cbHeld = (pbResources) ? cbSection : 0;
+            }
+            pInfo->uiVersionResult = (ERROR_SUCCESS == uiError) ? ReadVersionResource(View, pInfo) : uiError;
+            free(pbResources);
+
+            if (View.fNotHeld)
+            {
+                BYTE* pbFile = ReadPeBytes(hFile, 0, cbFile, &uiError);
+                if (pbFile)
+                    ParsePeImage(pbFile, cbFile, pInfo);
+                else
+                {
+                    ParsePeImage(NULL, 0, pInfo);
+                    pInfo->uiVersionResult = uiError;
+                }
+                free(pbFile);
+            }
+        }
+    }
+    if (pbHeaders != rgbHeaders)
+        free(pbHeaders);
+}
+
+UINT ReadPeFile(const TCHAR* szFile, PEIMAGEINFO* pInfo)
+{
+    ParsePeImage(NULL, 0, pInfo);
+
+#ifdef _WIN32
+    HANDLE hFile = CreateFile(szFile, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (INVALID_HANDLE_VALUE == hFile)
+    {
+        UINT uiError = GetLastError();
+        switch (uiError)
+        {
+            case ERROR_PATH_NOT_FOUND:
+            case ERROR_INVALID_NAME:
+            case ERROR_BAD_NETPATH:
+                return ERROR_FILE_NOT_FOUND;
+            case ERROR_SHARING_VIOLATION:
+                return ERROR_ACCESS_DENIED;
+            default:
+                return uiError;
+        }
+    }
+
+    // the headers and the resources are all that is read, wherever they are in the file.
+    DWORD cbFileHigh = 0;
+    DWORD cbFile = GetFileSize(hFile, &cbFileHigh);
+    unsigned __int64 cbFile64 = ((unsigned __int64) cbFileHigh << 32) | cbFile;
+    if (((INVALID_FILE_SIZE == cbFile) && (NO_ERROR != GetLastError())) || (0 == cbFile64) || ((size_t) cbFile64 != cbFile64))
+    {
+        CloseHandle(hFile);
+        return ERROR_SUCCESS;               // nothing that can be read is an image
+    }
+    ReadPeImage(hFile, (size_t) cbFile64, pInfo);
+    CloseHandle(hFile);
+#else
+    int fd = open(szFile, O_RDONLY);
+    if (fd < 0)
+        return ((EACCES == errno) || (EPERM == errno)) ? ERROR_ACCESS_DENIED : ERROR_FILE_NOT_FOUND;
+
+    struct stat st;
+    if (0 != fstat(fd, &st))
+    {
+        close(fd);
+        return ERROR_FILE_NOT_FOUND;
+    }
+    if (S_ISDIR(st.st_mode))
+    {
+        close(fd);
+        return ERROR_FILE_NOT_FOUND;
+    }
+    if (!S_ISREG(st.st_mode) || (0 == st.st_size) || ((size_t) st.st_size != (unsigned long long) st.st_size))
+    {
+        close(fd);
+        return ERROR_SUCCESS;               // a device, a pipe, an empty file; not an image
+    }
+    ReadPeImage(fd, (size_t) st.st_size, pInfo);
+    close(fd);
+#endif
+    return ERROR_SUCCESS;
+}
+
+bool PeBinaryType(const PEIMAGEINFO& Info, const TCHAR* szFile, DWORD* pdwBinaryType)
+{
+    switch (Info.ik)
+    {
+        case ikPE32:
+        case ikPE64:
+            if (Info.wCharacteristics & WPeFileDll)
+                return false;
+            if (WPeSubsystemPosix == Info.wSubsystem)
+                *pdwBinaryType = SCS_POSIX_BINARY;
+            else
+                *pdwBinaryType = (ikPE64 == Info.ik) ? SCS_64BIT_BINARY : SCS_32BIT_BINARY;
+            return true;
+        case ikNE:
+            if (Info.wCharacteristics & WNELibrary)
+                return false;
+            *pdwBinaryType = (BNETargetOS2 == Info.bTargetOS) ? SCS_OS216_BINARY : SCS_WOW_BINARY;
+            return true;
+        case ikDos:
+        case ikLE:
+            *pdwBinaryType = SCS_DOS_BINARY;
+            return true;
+        default:
+            break;
+    }
+
+    // no header to go by; a .com is a DOS program and a .pif is a PIF.
+    const TCHAR* szExtension = (szFile) ? strrchr(szFile, '.') : NULL;
+    if (szExtension && (0 == lstrcmpi(szExtension, TEXT(".com"))))
+        *pdwBinaryType = SCS_DOS_BINARY;
+    else if (szExtension && (0 == lstrcmpi(szExtension, TEXT(".pif"))))
+        *pdwBinaryType = SCS_PIF_BINARY;
+    else
+        return false;
+    return true;
+}
+
+void FormatPeVersion(const PEIMAGEINFO& Info, TCHAR* szVersion, DWORD cchVersion, TCHAR* szLanguage, DWORD cchLanguage)
+{
+    TCHAR szNumber[64];
+    sprintf(szNumber, TEXT("%u.%u.%u.%u"), Info.dwFileVersionMS >> 16, Info.dwFileVersionMS & 0xFFFF,
+        Info.dwFileVersionLS >> 16, Info.dwFileVersionLS & 0xFFFF);
+    lstrcpyn(szVersion, szNumber, cchVersion);
+
+    DWORD ich = 0;
+    szLanguage[0] = 0;
+    DWORD cLanguages = (Info.cLanguages < CPeLanguages) ? Info.cLanguages : CPeLanguages;
+    for (DWORD iLanguage = 0; iLanguage < cLanguages; iLanguage++)
+    {
+        int cch = sprintf(szNumber, TEXT("%s%u"), (iLanguage) ? TEXT(",") : TEXT(""), Info.rgwLanguage[iLanguage]);
+        if (ich + cch >= cchLanguage)
+            break;
+        lstrcpy(szLanguage + ich, szNumber);
+        ich += cch;
+    }
+}
@@ -0,0 +1,91 @@
+/*---------------------------------------------------------------------------
+Executable images (keypath versions and binary types).
+
+    A file keypath's version and language come from the VS_FIXEDFILEINFO
+    and Translation of its version resource, and its binary type from its
+    headers.  MsiGetFileVersion and GetBinaryType each open the file for
+    that; ReadPeFile opens it once, reads its headers and then its
+    resource section, and ParsePeImage reads both from what was read:
+
+        MZ          the DOS header; e_lfanew names the new header, if any
+        PE\0\0      the COFF header (machine, characteristics), the optional
+                    header (PE32 or PE32+, subsystem, resource directory)
+                    and the section table, to turn RVAs into file offsets
+        resources   RT_VERSION, resource 1, its first language
+        VS_VERSION_INFO
+                    the fixed file info, and the Translation under
+                    VarFileInfo
+        NE, LE, LX  recognized for the binary type; their version
+                    resources are another format, left to the installer
+
+    ParsePeImage takes nothing but a pointer and a length and reads nothing
+    outside them, whatever the bytes say: every offset and count in the
+    image is checked against the length before it is followed, and a walk
+    of the version resource's blocks always moves forward.  A malformed
+    image is reported as one without a version, or with invalid version
+    information, never read past.  So it can be fed arbitrary bytes by a
+    fuzzer, and is by -bench peimage.
+
+    ReadPeFile reads the first 4K, which holds the headers of nearly any
+    image and all of a small one, more only when the section table runs
+    past it, and then the one section holding the resource directory.  A
+    version resource that reaches outside that section has the whole file
+    read for it.  A mapping of the whole file costs more to set up and
+    tear down than these reads, on a file the cache already holds.
+
+    It is the same code on Windows and off it; off Windows the stand-in
+    file system (standinfs.h) reads real versions and binary types from a
+    tree of Windows files.
+---------------------------------------------------------------------------*/
+
+#ifndef PEIMAGE_H
+#define PEIMAGE_H
+
+#include "msiport.h"
+#include <stddef.h>
+
+enum IMAGEKIND {
+    ikNone,         // not an MZ image, or a PE header the loader would refuse
+    ikDos,          // MZ and nothing after it
+    ikNE,           // 16-bit Windows or OS/2
+    ikLE,           // LE or LX: VxDs and OS/2 2.x
+    ikPE32,
+    ikPE64,         // PE32+
+};
+
+const DWORD CPeLanguages = 16;          // languages in a Translation kept; more are counted
+
+struct PEIMAGEINFO {
+    IMAGEKIND   ik;
+    WORD        wMachine;               // PE: IMAGE_FILE_MACHINE_*
+    WORD        wCharacteristics;       // PE: IMAGE_FILE_*; NE: the module flags
+    WORD        wSubsystem;             // PE: IMAGE_SUBSYSTEM_*
+    BYTE        bTargetOS;              // NE: 1 OS/2, 2 Windows
+
+    // ERROR_SUCCESS; ERROR_FILE_INVALID with no version resource (or one
+    // the loader would not find); ERROR_INVALID_DATA when it cannot be read.
+    UINT        uiVersionResult;
+    DWORD       dwFileVersionMS;
+    DWORD       dwFileVersionLS;
+    DWORD       cLanguages;
+    WORD        rgwLanguage[CPeLanguages];
+};
+
+// the image in pb[0, cb).  Reads nothing outside it.
+void  ParsePeImage(const BYTE* pb, size_t cb, PEIMAGEINFO* pInfo);
+
+// szFile opened and read once, and parsed.  ERROR_FILE_NOT_FOUND (a
+// directory included) or ERROR_ACCESS_DENIED when it cannot be opened, as
+// MsiGetFileVersion reports them.  An empty file is not an image.
+UINT  ReadPeFile(const TCHAR* szFile, PEIMAGEINFO* pInfo);
+
+// what GetBinaryType says of the image: SCS_32BIT_BINARY for a PE32
+// program, SCS_64BIT_BINARY for PE32+, and so on.  False for a DLL, as it
+// is there.  Files that are not MZ images are typed by their extension
+// (.com, .pif), so szFile may be NULL.
+bool  PeBinaryType(const PEIMAGEINFO& Info, const TCHAR* szFile, DWORD* pdwBinaryType);
+
+// "1.2.3.4" and "1033,1041", as MsiGetFileVersion writes them.
+void  FormatPeVersion(const PEIMAGEINFO& Info, TCHAR* szVersion, DWORD cchVersion, TCHAR* szLanguage, DWORD cchLanguage);
+
+#endif // PEIMAGE_H
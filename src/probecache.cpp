@@ -0,0 +1,202 @@
+/*---------------------------------------------------------------------------
+Keypath probe cache - see probecache.h.
+---------------------------------------------------------------------------*/
+
+#include "probecache.h"
+#include <stdlib.h>
+#include <string.h>
+
+const int CCHNormalKeyPath = 1024;
+
+// a probe, with the key and strings packed behind it.
+struct PROBECACHEENTRY {
+    bool        fRegistry;
+    bool        fRegistryRoot;
+    DWORD       dwRegistryError;
+    bool        fLastWriteTime;
+    DWORD       dwAttributes;
+    bool        fExtendedAttributes;
+    DWORD       nFileSizeHigh;
+    DWORD       nFileSizeLow;
+    FILETIME    ftCreationTime;
+    UINT        uiVersionResult;
+    bool        fBinaryType;
+    DWORD       dwBinaryType;
+    FILETIME    ftLastWriteTime;
+    OWNERSTATE  osOwner;
+    DWORD       dwOwnerError;
+
+    DWORD       ichVersion;         // into rgchText, which starts with the key
+    DWORD       ichLanguage;
+    DWORD       ichOwner;
+    TCHAR       rgchText[1];
+};
+
+bool NormalizeKeyPath(const TCHAR* szKeyPath, TCHAR* szNormal, int cchNormal)
+{
+    int ich = 0;
+    const TCHAR* pch = szKeyPath;
+
+    // a UNC path keeps its leading pair.
+    if (('\\' == pch[0] || '/' == pch[0]) && ('\\' == pch[1] || '/' == pch[1]))
+    {
+        if (cchNormal < 3)
+            return false;
+        szNormal[ich++] = '\\';
+        szNormal[ich++] = '\\';
+        pch += 2;
+    }
+    int ichFirst = ich;
+
+    for (; *pch; pch++)
+    {
+        TCHAR ch = ('/' == *pch) ? '\\' : *pch;
+        if ('\\' == ch && ich > ichFirst && '\\' == szNormal[ich-1])
+            continue;
+        if (ich + 1 >= cchNormal)
+            return false;
+        szNormal[ich++] = ch;
+    }
+
+    if (ich > ichFirst + 1 && '\\' == szNormal[ich-1] && ':' != szNormal[ich-2])
+        ich--;
+    szNormal[ich] = 0;
+    return true;
+}
+
+static PROBECACHEENTRY* PackProbe(const TCHAR* szKey, const KEYPATHPROBE& Probe)
+{
+    DWORD cchKey = lstrlen(szKey) + 1;
+    DWORD cchVersion = lstrlen(Probe.szVersion) + 1;
+    DWORD cchLanguage = lstrlen(Probe.szLanguage) + 1;
+    DWORD cchOwner = lstrlen(Probe.szOwner) + 1;
+
+    PROBECACHEENTRY* pEntry = (PROBECACHEENTRY*) malloc(sizeof(PROBECACHEENTRY) + (cchKey + cchVersion + cchLanguage + cchOwner) * sizeof(TCHAR));
+    if (!pEntry)
+        return NULL;
+
+    pEntry->fRegistry = Probe.fRegistry;
+    pEntry->fRegistryRoot = Probe.fRegistryRoot;
+    pEntry->dwRegistryError = Probe.dwRegistryError;
+    pEntry->fLastWriteTime = Probe.fLastWriteTime;
+    pEntry->dwAttributes = Probe.dwAttributes;
+    pEntry->fExtendedAttributes = Probe.fExtendedAttributes;
+    pEntry->nFileSizeHigh = Probe.nFileSizeHigh;
+    pEntry->nFileSizeLow = Probe.nFileSizeLow;
+    pEntry->ftCreationTime = Probe.ftCreationTime;
+    pEntry->uiVersionResult = Probe.uiVersionResult;
+    pEntry->fBinaryType = Probe.fBinaryType;
+    pEntry->dwBinaryType = Probe.dwBinaryType;
+    pEntry->ftLastWriteTime = Probe.ftLastWriteTime;
+    pEntry->osOwner = Probe.osOwner;
+    pEntry->dwOwnerError = Probe.dwOwnerError;
+
+    pEntry->ichVersion = cchKey;
+    pEntry->ichLanguage = pEntry->ichVersion + cchVersion;
+    pEntry->ichOwner = pEntry->ichLanguage + cchLanguage;
+    lstrcpy(pEntry->rgchText, szKey);
+    lstrcpy(pEntry->rgchText + pEntry->ichVersion, Probe.szVersion);
+    lstrcpy(pEntry->rgchText + pEntry->ichLanguage, Probe.szLanguage);
+    lstrcpy(pEntry->rgchText + pEntry->ichOwner, Probe.szOwner);
+    return pEntry;
+}
+
+static void UnpackProbe(const PROBECACHEENTRY* pEntry, KEYPATHPROBE* pProbe)
+{
+    InitKeyPathProbe(pProbe);
+    pProbe->fRegistry = pEntry->fRegistry;
+    pProbe->fRegistryRoot = pEntry->fRegistryRoot;
+    pProbe->dwRegistryError = pEntry->dwRegistryError;
+    pProbe->fLastWriteTime = pEntry->fLastWriteTime;
+    pProbe->dwAttributes = pEntry->dwAttributes;
+    pProbe->fExtendedAttributes = pEntry->fExtendedAttributes;
+    pProbe->nFileSizeHigh = pEntry->nFileSizeHigh;
+    pProbe->nFileSizeLow = pEntry->nFileSizeLow;
+    pProbe->ftCreationTime = pEntry->ftCreationTime;
+    pProbe->uiVersionResult = pEntry->uiVersionResult;
+    pProbe->fBinaryType = pEntry->fBinaryType;
+    pProbe->dwBinaryType = pEntry->dwBinaryType;
+    pProbe->ftLastWriteTime = pEntry->ftLastWriteTime;
+    pProbe->osOwner = pEntry->osOwner;
+    pProbe->dwOwnerError = pEntry->dwOwnerError;
+    lstrcpyn(pProbe->szVersion, pEntry->rgchText + pEntry->ichVersion, CCHKeyPathVersion);
+    lstrcpyn(pProbe->szLanguage, pEntry->rgchText + pEntry->ichLanguage, CCHKeyPathVersion);
+    lstrcpyn(pProbe->szOwner, pEntry->rgchText + pEntry->ichOwner, CCHKeyPathOwner);
+}
+
+CProbeCache::CProbeCache(CInstallerData* pSource)
+    : CForwardingInstallerData(pSource), m_rgpEntry(NULL), m_cEntries(0), m_cEntriesAllocated(0), m_cHits(0), m_cMisses(0)
+{
+    InitializeCriticalSection(&m_cs);
+    m_fMap = InitStringMap(&m_Map, 1024, false);
+}
+
+CProbeCache::~CProbeCache()
+{
+    if (m_fMap)
+        FreeStringMap(&m_Map);
+    for (DWORD iEntry = 0; iEntry < m_cEntries; iEntry++)
+        free(m_rgpEntry[iEntry]);
+    free(m_rgpEntry);
+    DeleteCriticalSection(&m_cs);
+    delete m_pSource;
+}
+
+void CProbeCache::ProbeKeyPath(const TCHAR* szKeyPath, KEYPATHPROBE* pProbe)
+{
+    TCHAR szKey[CCHNormalKeyPath];
+    if (!m_fMap || !szKeyPath || !*szKeyPath || !NormalizeKeyPath(szKeyPath, szKey, CCHNormalKeyPath))
+    {
+        m_pSource->ProbeKeyPath(szKeyPath, pProbe);
+        return;
+    }
+
+    DWORD iEntry = 0;
+    EnterCriticalSection(&m_cs);
+    if (FindStringMapValue(&m_Map, szKey, &iEntry))
+    {
+        m_cHits++;
+        UnpackProbe(m_rgpEntry[iEntry], pProbe);
+        LeaveCriticalSection(&m_cs);
+        return;
+    }
+    m_cMisses++;
+    LeaveCriticalSection(&m_cs);
+
+    // the probe itself is the slow part; nothing is held across it.
+    m_pSource->ProbeKeyPath(szKeyPath, pProbe);
+
+    PROBECACHEENTRY* pEntry = PackProbe(szKey, *pProbe);
+    if (!pEntry)
+        return;
+
+    EnterCriticalSection(&m_cs);
+    if (FindStringMapValue(&m_Map, szKey, &iEntry))
+    {
+        // another thread got there first.
+        LeaveCriticalSection(&m_cs);
+        free(pEntry);
+        return;
+    }
+
+    if (m_cEntries == m_cEntriesAllocated)
+    {
+        DWORD cAllocate = (m_cEntriesAllocated) ? 2 * m_cEntriesAllocated : 1024;
+        PROBECACHEENTRY** rgpEntry = (PROBECACHEENTRY**) realloc(m_rgpEntry, cAllocate * sizeof(PROBECACHEENTRY*));
+        if (!rgpEntry)
+        {
+            LeaveCriticalSection(&m_cs);
+            free(pEntry);
+            return;
+        }
+        m_rgpEntry = rgpEntry;
+        m_cEntriesAllocated = cAllocate;
+    }
+
+    // the map keys on the entry's own copy of the path.
+    if (SetStringMapValue(&m_Map, pEntry->rgchText, m_cEntries))
+        m_rgpEntry[m_cEntries++] = pEntry;
+    else
+        free(pEntry);
+    LeaveCriticalSection(&m_cs);
+}
@@ -0,0 +1,53 @@
+/*---------------------------------------------------------------------------
+Keypath probe cache.
+
+    A shared component's keypath is probed once for every product that
+    lists it, and again by the component evaluation (-c).  The cache sits
+    in front of the provider and answers every probe of a path after the
+    first from what the first one found, for the rest of the run.
+
+    Paths are keyed the way the file system compares them: case does not
+    matter, '/' is '\', runs of separators are one, and a trailing
+    separator is dropped (but not the one after a drive or registry
+    root.)  Entries keep the probe's strings at their own length rather
+    than the KEYPATHPROBE's fixed buffers, so an inventory of 100,000
+    components costs a few tens of megabytes, not a hundred.
+
+    Safe to call from several threads (-j, -probe); two threads missing
+    the same path at once both probe it and the first answer is kept.
+---------------------------------------------------------------------------*/
+
+#ifndef PROBECACHE_H
+#define PROBECACHE_H
+
+#include "installerdata.h"
+#include "strmap.h"
+
+struct PROBECACHEENTRY;
+
+class CProbeCache : public CForwardingInstallerData
+{
+public:
+    CProbeCache(CInstallerData* pSource);
+    ~CProbeCache();     // deletes pSource
+
+    void          ProbeKeyPath(const TCHAR* szKeyPath, KEYPATHPROBE* pProbe);
+
+    DWORD         Hits() const      { return m_cHits; }
+    DWORD         Misses() const    { return m_cMisses; }
+
+private:
+    CRITICAL_SECTION    m_cs;
+    STRINGMAP           m_Map;          // normalized path -> m_rgpEntry index
+    bool                m_fMap;         // false - the map could not be had; nothing is cached
+    PROBECACHEENTRY**   m_rgpEntry;
+    DWORD               m_cEntries;
+    DWORD               m_cEntriesAllocated;
+    DWORD               m_cHits;
+    DWORD               m_cMisses;
+};
+
+// the cache's key for szKeyPath; false when it does not fit cchNormal.
+bool NormalizeKeyPath(const TCHAR* szKeyPath, TCHAR* szNormal, int cchNormal);
+
+#endif // PROBECACHE_H
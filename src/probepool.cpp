@@ -0,0 +1,349 @@
+/*---------------------------------------------------------------------------
+Keypath probe pool - see probepool.h.
+---------------------------------------------------------------------------*/
+
+#include "probepool.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <pthread.h>
+#endif
+
+bool ParseProbeConfig(const TCHAR* szSpec, PROBECONFIG* pConfig)
+{
+    pConfig->cThreads = 8;
+    pConfig->cQueueDepth = 0;
+    pConfig->szRoot = NULL;
+    pConfig->dwLatency = 0;
+
+    const TCHAR* pch = szSpec;
+    while (pch && *pch)
+    {
+        const TCHAR* pchEquals = strchr(pch, '=');
+        if (!pchEquals)
+            return false;
+        int cchKey = (int) (pchEquals - pch);
+
+        if (4 == cchKey && 0 == _strnicmp(pch, TEXT("root"), cchKey))
+        {
+            // the rest of the spec - a directory may well have a comma in it.
+            pConfig->szRoot = pchEquals + 1;
+            if (!*pConfig->szRoot)
+                return false;
+            break;
+        }
+
+        char* pchEnd = NULL;
+        unsigned long ulValue = strtoul(pchEquals + 1, &pchEnd, 10);
+        if (pchEnd == pchEquals + 1 || (*pchEnd && ',' != *pchEnd))
+            return false;
+
+        if (7 == cchKey && 0 == _strnicmp(pch, TEXT("threads"), cchKey))
+            pConfig->cThreads = ulValue;
+        else if (5 == cchKey && 0 == _strnicmp(pch, TEXT("queue"), cchKey))
+            pConfig->cQueueDepth = ulValue;
+        else if (7 == cchKey && 0 == _strnicmp(pch, TEXT("latency"), cchKey))
+            pConfig->dwLatency = ulValue;
+        else
+            return false;
+
+        pch = (*pchEnd) ? pchEnd + 1 : pchEnd;
+    }
+
+    if (pConfig->cThreads < 1 || pConfig->cThreads > 64)
+        return false;
+    // enough queued that no thread waits on the report between items.
+    if (!pConfig->cQueueDepth)
+        pConfig->cQueueDepth = 4 * pConfig->cThreads;
+    return pConfig->cQueueDepth <= 4096;
+}
+
+struct PROBEPOOLSTATE {
+    CInstallerData* pSource;
+    PROBEITEM*      rgItem;         // ring of cQueueDepth; item n is rgItem[n % cQueueDepth]
+    bool*           rgfDone;
+    DWORD           cQueueDepth;
+    DWORD           cThreads;
+
+    // written by the report only, under the lock
+    DWORD           cSubmitted;
+    DWORD           cCollected;
+
+    // under the lock
+    DWORD           cStarted;
+    bool            fStop;
+
+#ifdef _WIN32
+    CRITICAL_SECTION    cs;
+    HANDLE              hWork;      // semaphore; one count per item submitted and not yet started
+    HANDLE              hItemDone;  // auto-reset; the report is the only waiter
+    HANDLE*             rghThread;
+#else
+    pthread_mutex_t     mutex;
+    pthread_cond_t      condWork;
+    pthread_cond_t      condItemDone;
+    pthread_t*          rgThread;
+#endif
+};
+
+static void ProbeItem(PROBEPOOLSTATE* pState, DWORD iItem)
+{
+    PROBEITEM* pItem = &pState->rgItem[iItem % pState->cQueueDepth];
+    if (pItem->fProbed)
+    {
+        CTraceSpan Span(TEXT("probe"), TEXT("keypath"), pItem->szKeyPath);
+        pState->pSource->ProbeKeyPath(pItem->szKeyPath, &pItem->Probe);
+    }
+}
+
+#ifdef _WIN32
+
+static unsigned __stdcall ProbeThread(void* pv)
+{
+    PROBEPOOLSTATE* pState = (PROBEPOOLSTATE*) pv;
+    for (;;)
+    {
+        WaitForSingleObject(pState->hWork, INFINITE);
+
+        EnterCriticalSection(&pState->cs);
+        bool fStop = pState->fStop;
+        DWORD iItem = pState->cStarted;
+        if (!fStop)
+            pState->cStarted++;
+        LeaveCriticalSection(&pState->cs);
+
+        if (fStop)
+            return 0;
+
+        ProbeItem(pState, iItem);
+
+        EnterCriticalSection(&pState->cs);
+        pState->rgfDone[iItem % pState->cQueueDepth] = true;
+        LeaveCriticalSection(&pState->cs);
+        SetEvent(pState->hItemDone);
+    }
+}
+
+#else
+
+static void* ProbeThread(void* pv)
+{
+    PROBEPOOLSTATE* pState = (PROBEPOOLSTATE*) pv;
+    pthread_mutex_lock(&pState->mutex);
+    for (;;)
+    {
+        while (!pState->fStop && (pState->cStarted == pState->cSubmitted))
+            pthread_cond_wait(&pState->condWork, &pState->mutex);
+
+        if (pState->fStop)
+            break;
+
+        DWORD iItem = pState->cStarted++;
+        pthread_mutex_unlock(&pState->mutex);
+
+        ProbeItem(pState, iItem);
+
+        pthread_mutex_lock(&pState->mutex);
+        pState->rgfDone[iItem % pState->cQueueDepth] = true;
+        pthread_cond_signal(&pState->condItemDone);
+    }
+    pthread_mutex_unlock(&pState->mutex);
+    return NULL;
+}
+
+#endif // _WIN32
+
+CProbePool::CProbePool()
+    : m_pState(NULL)
+{
+}
+
+CProbePool::~CProbePool()
+{
+    Finish();
+}
+
+bool CProbePool::Start(CInstallerData* pSource, DWORD cThreads, DWORD cQueueDepth)
+{
+    Finish();
+    if (!cThreads)
+        cThreads = 1;
+    if (!cQueueDepth)
+        cQueueDepth = 1;
+
+    PROBEPOOLSTATE* pState = (PROBEPOOLSTATE*) calloc(1, sizeof(PROBEPOOLSTATE));
+    if (!pState)
+        return false;
+    pState->pSource = pSource;
+    pState->cQueueDepth = cQueueDepth;
+    pState->rgItem = (PROBEITEM*) calloc(cQueueDepth, sizeof(PROBEITEM));
+    pState->rgfDone = (bool*) calloc(cQueueDepth, sizeof(bool));
+
+#ifdef _WIN32
+    pState->rghThread = (HANDLE*) calloc(cThreads, sizeof(HANDLE));
+    InitializeCriticalSection(&pState->cs);
+    pState->hWork = CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL);
+    pState->hItemDone = CreateEvent(NULL, FALSE, FALSE, NULL);
+    bool fReady = pState->rgItem && pState->rgfDone && pState->rghThread && pState->hWork && pState->hItemDone;
+    m_pState = pState;
+    while (fReady && pState->cThreads < cThreads)
+    {
+        pState->rghThread[pState->cThreads] = (HANDLE) _beginthreadex(NULL, 0, ProbeThread, pState, 0, NULL);
+        if (pState->rghThread[pState->cThreads])
+            pState->cThreads++;
+        else
+            fReady = false;
+    }
+#else
+    pState->rgThread = (pthread_t*) calloc(cThreads, sizeof(pthread_t));
+    pthread_mutex_init(&pState->mutex, NULL);
+    pthread_cond_init(&pState->condWork, NULL);
+    pthread_cond_init(&pState->condItemDone, NULL);
+    bool fReady = pState->rgItem && pState->rgfDone && pState->rgThread;
+    m_pState = pState;
+    while (fReady && pState->cThreads < cThreads)
+    {
+        if (0 == pthread_create(&pState->rgThread[pState->cThreads], NULL, ProbeThread, pState))
+            pState->cThreads++;
+        else
+            fReady = false;
+    }
+#endif
+
+    if (!fReady)
+    {
+        Finish();
+        return false;
+    }
+    return true;
+}
+
+bool CProbePool::CanSubmit() const
+{
+    return m_pState && (m_pState->cSubmitted - m_pState->cCollected < m_pState->cQueueDepth);
+}
+
+bool CProbePool::Submit(DWORD dwTag, INSTALLSTATE isState, const TCHAR* szKeyPath, bool fProbe)
+{
+    if (!CanSubmit())
+        return false;
+    PROBEPOOLSTATE* pState = m_pState;
+
+    // no thread touches the slot until cSubmitted says so.
+    PROBEITEM* pItem = &pState->rgItem[pState->cSubmitted % pState->cQueueDepth];
+    pItem->dwTag = dwTag;
+    pItem->isState = isState;
+    if (!szKeyPath)
+        szKeyPath = TEXT("");
+    pItem->fTooLong = (lstrlen(szKeyPath) >= CCHProbeKeyPath);
+    lstrcpyn(pItem->szKeyPath, (pItem->fTooLong) ? TEXT("") : szKeyPath, CCHProbeKeyPath);
+    pItem->fProbed = fProbe && *pItem->szKeyPath;
+    InitKeyPathProbe(&pItem->Probe);
+
+#ifdef _WIN32
+    EnterCriticalSection(&pState->cs);
+    pState->cSubmitted++;
+    LeaveCriticalSection(&pState->cs);
+    ReleaseSemaphore(pState->hWork, 1, NULL);
+#else
+    pthread_mutex_lock(&pState->mutex);
+    pState->cSubmitted++;
+    pthread_cond_signal(&pState->condWork);
+    pthread_mutex_unlock(&pState->mutex);
+#endif
+    return true;
+}
+
+const PROBEITEM* CProbePool::Peek()
+{
+    PROBEPOOLSTATE* pState = m_pState;
+    if (!pState || pState->cCollected == pState->cSubmitted)
+        return NULL;
+
+    DWORD iSlot = pState->cCollected % pState->cQueueDepth;
+#ifdef _WIN32
+    for (;;)
+    {
+        EnterCriticalSection(&pState->cs);
+        bool fDone = pState->rgfDone[iSlot];
+        LeaveCriticalSection(&pState->cs);
+        if (fDone)
+            break;
+        WaitForSingleObject(pState->hItemDone, INFINITE);
+    }
+#else
+    pthread_mutex_lock(&pState->mutex);
+    while (!pState->rgfDone[iSlot])
+        pthread_cond_wait(&pState->condItemDone, &pState->mutex);
+    pthread_mutex_unlock(&pState->mutex);
+#endif
+    return &pState->rgItem[iSlot];
+}
+
+void CProbePool::Pop()
+{
+    PROBEPOOLSTATE* pState = m_pState;
+    if (!pState || pState->cCollected == pState->cSubmitted)
+        return;
+
+    // Peek has waited for it, so no thread still holds the slot.
+#ifdef _WIN32
+    EnterCriticalSection(&pState->cs);
+    pState->rgfDone[pState->cCollected % pState->cQueueDepth] = false;
+    pState->cCollected++;
+    LeaveCriticalSection(&pState->cs);
+#else
+    pthread_mutex_lock(&pState->mutex);
+    pState->rgfDone[pState->cCollected % pState->cQueueDepth] = false;
+    pState->cCollected++;
+    pthread_mutex_unlock(&pState->mutex);
+#endif
+}
+
+void CProbePool::Finish()
+{
+    PROBEPOOLSTATE* pState = m_pState;
+    if (!pState)
+        return;
+
+    // items a thread has started are finished; the rest are dropped.
+#ifdef _WIN32
+    EnterCriticalSection(&pState->cs);
+    pState->fStop = true;
+    LeaveCriticalSection(&pState->cs);
+    if (pState->hWork)
+        ReleaseSemaphore(pState->hWork, pState->cThreads, NULL);
+    for (DWORD iThread = 0; iThread < pState->cThreads; iThread++)
+    {
+        WaitForSingleObject(pState->rghThread[iThread], INFINITE);
+        CloseHandle(pState->rghThread[iThread]);
+    }
+    if (pState->hWork)
+        CloseHandle(pState->hWork);
+    if (pState->hItemDone)
+        CloseHandle(pState->hItemDone);
+    DeleteCriticalSection(&pState->cs);
+    free(pState->rghThread);
+#else
+    pthread_mutex_lock(&pState->mutex);
+    pState->fStop = true;
+    pthread_cond_broadcast(&pState->condWork);
+    pthread_mutex_unlock(&pState->mutex);
+    for (DWORD iThread = 0; iThread < pState->cThreads; iThread++)
+        pthread_join(pState->rgThread[iThread], NULL);
+    pthread_cond_destroy(&pState->condItemDone);
+    pthread_cond_destroy(&pState->condWork);
+    pthread_mutex_destroy(&pState->mutex);
+    free(pState->rgThread);
+#endif
+
+    free(pState->rgfDone);
+    free(pState->rgItem);
+    free(pState);
+    m_pState = NULL;
+}
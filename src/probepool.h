@@ -0,0 +1,77 @@
+/*---------------------------------------------------------------------------
+Keypath probe pool (-probe).
+
+    Probing a keypath is a handful of file system calls back to back, and
+    on a redirected profile or a slow disk they dominate the component
+    listings.  The report submits keypaths ahead of where it is printing,
+    a few threads probe them, and the report collects the results in the
+    order it submitted them - so what it prints is exactly what a serial
+    run prints.
+
+    The queue is bounded: Submit fails rather than waits when cQueueDepth
+    items are outstanding, because the only thread that could make room
+    is the one submitting.  Each item carries the caller's tag and the
+    install state GetComponentPath returned with the path, so the report
+    need not keep its own copy of what it asked ahead.  A path longer
+    than CCHProbeKeyPath is not queued cut short; the item says so and the
+    report asks and probes that one itself.
+
+    Probes run on pSource from several threads at once; every provider
+    allows that (installerdata.h).
+---------------------------------------------------------------------------*/
+
+#ifndef PROBEPOOL_H
+#define PROBEPOOL_H
+
+#include "installerdata.h"
+
+const int CCHProbeKeyPath = 1024;
+
+// parsed from "-probe key=value,..."
+struct PROBECONFIG {
+    DWORD           cThreads;
+    DWORD           cQueueDepth;
+    const TCHAR*    szRoot;         // stand-in file system root (standinfs.h); NULL for the provider's own
+    DWORD           dwLatency;      // stand-in milliseconds per probe
+};
+
+bool ParseProbeConfig(const TCHAR* szSpec, PROBECONFIG* pConfig);
+
+struct PROBEITEM {
+    DWORD           dwTag;
+    INSTALLSTATE    isState;
+    TCHAR           szKeyPath[CCHProbeKeyPath];
+    bool            fProbed;        // false - submitted without a probe; Probe is empty
+    bool            fTooLong;       // the path did not fit szKeyPath; it is "" and not probed
+    KEYPATHPROBE    Probe;
+};
+
+struct PROBEPOOLSTATE;
+
+class CProbePool
+{
+public:
+    CProbePool();
+    ~CProbePool();      // Finish()
+
+    // false when the threads cannot be started; use the provider directly then.
+    bool  Start(CInstallerData* pSource, DWORD cThreads, DWORD cQueueDepth);
+    bool  IsStarted() const         { return NULL != m_pState; }
+
+    bool  CanSubmit() const;
+    // false when the queue is full; collect first.
+    bool  Submit(DWORD dwTag, INSTALLSTATE isState, const TCHAR* szKeyPath, bool fProbe);
+
+    // the oldest item, once it has been probed; NULL when nothing is queued.
+    // Valid until Pop.
+    const PROBEITEM* Peek();
+    void  Pop();
+
+    // drops whatever is queued and joins the threads.
+    void  Finish();
+
+private:
+    PROBEPOOLSTATE* m_pState;
+};
+
+#endif // PROBEPOOL_H
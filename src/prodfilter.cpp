@@ -0,0 +1,187 @@
+/*---------------------------------------------------------------------------
+Product filter - see prodfilter.h.
+---------------------------------------------------------------------------*/
+
+#include "prodfilter.h"
+#include "infoquery.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// node 0 is the root; no node's child or sibling is the root, so 0 means none.
+struct FILTERNODE {
+    DWORD   iFirstChild;
+    DWORD   iNextSibling;
+    TCHAR   ch;             // folded
+    bool    fPattern;       // a pattern ends here
+};
+
+// the installer compares codes (and -p compared names) without regard to ASCII case.
+static inline TCHAR FoldChar(TCHAR ch)
+{
+    return (ch >= 'a' && ch <= 'z') ? (TCHAR) (ch - 'a' + 'A') : ch;
+}
+
+static DWORD FindChild(const FILTERNODE* rgNode, DWORD iNode, TCHAR chFolded)
+{
+    DWORD iChild = rgNode[iNode].iFirstChild;
+    while (iChild && rgNode[iChild].ch != chFolded)
+        iChild = rgNode[iChild].iNextSibling;
+    return iChild;
+}
+
+CProductFilter::CProductFilter()
+    : m_rgNode(NULL), m_cNodes(0), m_cNodesAllocated(0), m_cPatterns(0)
+{
+    memset(&m_CheckedClients, 0, sizeof(m_CheckedClients));
+    memset(&m_MatchedClients, 0, sizeof(m_MatchedClients));
+}
+
+CProductFilter::~CProductFilter()
+{
+    free(m_rgNode);
+    FreeGuidSet(&m_CheckedClients);
+    FreeGuidSet(&m_MatchedClients);
+}
+
+bool CProductFilter::AddPattern(const TCHAR* szPattern)
+{
+    // worst case every character is a new node, and the root.
+    DWORD cNeeded = m_cNodes + lstrlen(szPattern) + 1;
+    if (cNeeded > m_cNodesAllocated)
+    {
+        DWORD cNodes = (m_cNodesAllocated) ? m_cNodesAllocated : 256;
+        while (cNodes < cNeeded)
+            cNodes *= 2;
+        FILTERNODE* rgNode = (FILTERNODE*) realloc(m_rgNode, cNodes * sizeof(FILTERNODE));
+        if (!rgNode)
+            return false;
+        m_rgNode = rgNode;
+        m_cNodesAllocated = cNodes;
+    }
+    if (!m_cNodes)
+    {
+        memset(&m_rgNode[0], 0, sizeof(FILTERNODE));
+        m_cNodes = 1;
+    }
+
+    DWORD iNode = 0;
+    for (const TCHAR* pch = szPattern; *pch; pch++)
+    {
+        TCHAR chFolded = FoldChar(*pch);
+        DWORD iChild = FindChild(m_rgNode, iNode, chFolded);
+        if (!iChild)
+        {
+            iChild = m_cNodes++;
+            m_rgNode[iChild].iFirstChild = 0;
+            m_rgNode[iChild].iNextSibling = m_rgNode[iNode].iFirstChild;
+            m_rgNode[iChild].ch = chFolded;
+            m_rgNode[iChild].fPattern = false;
+            m_rgNode[iNode].iFirstChild = iChild;
+        }
+        iNode = iChild;
+    }
+
+    if (!m_rgNode[iNode].fPattern)
+    {
+        m_rgNode[iNode].fPattern = true;
+        m_cPatterns++;
+    }
+    return true;
+}
+
+UINT CProductFilter::AddPatternFile(const TCHAR* szFile)
+{
+    FILE* pFile = fopen(szFile, TEXT("rb"));
+    if (!pFile)
+        return ERROR_FILE_NOT_FOUND;
+
+    // the whole list at once; lines are cut in place.
+    fseek(pFile, 0, SEEK_END);
+    long cb = ftell(pFile);
+    fseek(pFile, 0, SEEK_SET);
+    TCHAR* pchFile = (cb >= 0) ? (TCHAR*) malloc(cb + 1) : NULL;
+    if (!pchFile)
+    {
+        fclose(pFile);
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+    size_t cch = fread(pchFile, 1, cb, pFile);
+    fclose(pFile);
+    pchFile[cch] = 0;
+
+    UINT uiResult = ERROR_SUCCESS;
+    TCHAR* pchLine = pchFile;
+    while (*pchLine && (ERROR_SUCCESS == uiResult))
+    {
+        TCHAR* pchEnd = pchLine;
+        while (*pchEnd && ('\n' != *pchEnd) && ('\r' != *pchEnd))
+            pchEnd++;
+        TCHAR* pchNext = pchEnd;
+        while (('\n' == *pchNext) || ('\r' == *pchNext))
+            pchNext++;
+
+        *pchEnd = 0;
+        if (*pchLine && !AddPattern(pchLine))
+            uiResult = ERROR_NOT_ENOUGH_MEMORY;
+        pchLine = pchNext;
+    }
+
+    free(pchFile);
+    return uiResult;
+}
+
+bool CProductFilter::MatchesPrefix(const TCHAR* szText) const
+{
+    if (!m_cNodes || !szText)
+        return false;
+
+    DWORD iNode = 0;
+    for (const TCHAR* pch = szText; ; pch++)
+    {
+        if (m_rgNode[iNode].fPattern)
+            return true;
+        if (!*pch)
+            return false;
+        iNode = FindChild(m_rgNode, iNode, FoldChar(*pch));
+        if (!iNode)
+            return false;
+    }
+}
+
+bool CProductFilter::MatchesExactly(const TCHAR* szText) const
+{
+    if (!m_cNodes || !szText)
+        return false;
+
+    DWORD iNode = 0;
+    for (const TCHAR* pch = szText; *pch; pch++)
+    {
+        iNode = FindChild(m_rgNode, iNode, FoldChar(*pch));
+        if (!iNode)
+            return false;
+    }
+    return m_rgNode[iNode].fPattern;
+}
+
+bool CProductFilter::MatchesClient(CInstallerData* pInstallerData, const TCHAR* szClient, const GUIDKEY& ClientKey)
+{
+    if (MatchesExactly(szClient))
+        return true;
+
+    if (!m_CheckedClients.cSlots && !(InitGuidSet(&m_CheckedClients, 256) && InitGuidSet(&m_MatchedClients, 256)))
+    {
+        FreeGuidSet(&m_CheckedClients);
+        FreeGuidSet(&m_MatchedClients);
+    }
+    else if (IsGuidKeyInSet(&m_CheckedClients, ClientKey))
+        return IsGuidKeyInSet(&m_MatchedClients, ClientKey);
+
+    // without room to remember the answer it is simply asked again next time.
+    m_Arena.Reset();
+    const TCHAR* szName;
+    bool fMatched = (ERROR_SUCCESS == QueryProductInfo(pInstallerData, szClient, INSTALLPROPERTY_PRODUCTNAME, &m_Arena, &szName)) &&
+                    MatchesExactly(szName);
+    if (m_CheckedClients.cSlots && (!fMatched || AddGuidKeyToSet(&m_MatchedClients, ClientKey)))
+        AddGuidKeyToSet(&m_CheckedClients, ClientKey);
+    return fMatched;
+}
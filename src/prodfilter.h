@@ -0,0 +1,65 @@
+/*---------------------------------------------------------------------------
+Product filter (-p).
+
+    -p limits the report to the products a watch-list names.  Each -p adds
+    a pattern, and "-p @file" adds every line of file.  The patterns are
+    built once into a trie over their case-folded characters, so checking
+    a code or a name is one walk along it however many patterns there
+    are, where the report used to compare each with _strnicmp.
+
+        product list        a product is listed when some pattern is a
+                            prefix of its code or of its name
+        component evaluation a component is listed when some pattern is
+                            exactly one of its clients' codes or names
+
+    Patterns only ever match at the start of the text, so a trie is all
+    the matching needs.  The evaluation asks for a client's name once per
+    run and keeps the answer by client key (guidkey.h).
+
+    Matching is safe from several threads once the patterns are added
+    (enrich.h); MatchesClient is for the report's thread only.
+---------------------------------------------------------------------------*/
+
+#ifndef PRODFILTER_H
+#define PRODFILTER_H
+
+#include "installerdata.h"
+#include "guidset.h"
+#include "strarena.h"
+
+struct FILTERNODE;
+
+class CProductFilter
+{
+public:
+    CProductFilter();
+    ~CProductFilter();
+
+    // false when out of memory.
+    bool  AddPattern(const TCHAR* szPattern);
+    // one pattern per line; blank lines are skipped.
+    UINT  AddPatternFile(const TCHAR* szFile);
+
+    bool  IsEmpty() const               { return 0 == m_cPatterns; }
+    DWORD PatternCount() const          { return m_cPatterns; }
+
+    // some pattern is a prefix of szText.
+    bool  MatchesPrefix(const TCHAR* szText) const;
+    // szText is one of the patterns.
+    bool  MatchesExactly(const TCHAR* szText) const;
+
+    // the client's code or its product name is one of the patterns.
+    bool  MatchesClient(CInstallerData* pInstallerData, const TCHAR* szClient, const GUIDKEY& ClientKey);
+
+private:
+    FILTERNODE*   m_rgNode;
+    DWORD         m_cNodes;
+    DWORD         m_cNodesAllocated;
+    DWORD         m_cPatterns;
+
+    GUIDSET       m_CheckedClients;
+    GUIDSET       m_MatchedClients;
+    CStringArena  m_Arena;
+};
+
+#endif // PRODFILTER_H
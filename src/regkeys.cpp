@@ -0,0 +1,386 @@
+/*---------------------------------------------------------------------------
+Registry keypaths - see regkeys.h.
+---------------------------------------------------------------------------*/
+
+#include "regkeys.h"
+#include "callcount.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+const DWORD CRegistryRoots = 4;
+const DWORD CCHRegistryKeyName = 255;   // the registry's own limit on one segment
+
+struct REGKEYNODE {
+    HKEY    hKey;           // kept open for the run; NULL when it is not
+    LONG    lError;         // opening it to keep failed.  ERROR_FILE_NOT_FOUND answers for everything under it
+    DWORD   cPassed;        // keypaths probed at or under it
+    DWORD   iParent;        // the edge to it: the parent's node,
+    const TCHAR* szSegment; // the segment under the parent, in m_Arena,
+    DWORD   cchSegment;
+    DWORD   dwHash;         // and the segment's HashKeySegment
+};
+
+const DWORD CRegistryChildSlots = 2048;
+
+// FNV-1a, upper-cased as the registry matches names, a character at a time.
+static inline DWORD HashKeySegment(DWORD dwHash, TCHAR ch)
+{
+    if (ch >= 'a' && ch <= 'z')
+        ch = (TCHAR) (ch - 'a' + 'A');
+    return (dwHash ^ (BYTE) ch) * 16777619u;
+}
+
+// where the child with the segment hash dwHash under iParent starts looking.
+static inline DWORD ChildSlot(DWORD iParent, DWORD dwHash, DWORD cSlots)
+{
+    return (dwHash ^ (iParent * 2654435761u)) & (cSlots - 1);
+}
+
+#ifdef _WIN32
+
+#ifndef KEY_WOW64_64KEY
+#define KEY_WOW64_64KEY     0x0100
+#define KEY_WOW64_32KEY     0x0200
+#endif
+
+HKEY CLiveRegistry::RootKey(DWORD iRoot)
+{
+    static const HKEY hMsiRoots[] = { HKEY_CLASSES_ROOT, HKEY_CURRENT_USER, HKEY_LOCAL_MACHINE, HKEY_USERS };
+    return hMsiRoots[iRoot];
+}
+
+LONG CLiveRegistry::OpenKey(HKEY hKey, const TCHAR* szSubKey, bool f64, HKEY* phKey)
+{
+    // 0x keypaths are the 32-bit view, whichever way msiinv is built.  Before XP there is only the one.
+    REGSAM samView = 0;
+    if (MinimumPlatformWindowsNT51())
+        samView = (f64) ? KEY_WOW64_64KEY : KEY_WOW64_32KEY;
+
+    CCallTimer Timer(tcRegOpenKeyEx);
+    return RegOpenKeyEx(hKey, (*szSubKey) ? szSubKey : NULL, 0, KEY_READ | samView, phKey);
+}
+
+void CLiveRegistry::CloseKey(HKEY hKey)
+{
+    RegCloseKey(hKey);
+}
+
+void CLiveRegistry::ProbeKey(HKEY hKey, KEYPATHPROBE* pProbe)
+{
+    byte pbSD[1024];
+    DWORD cbSD = sizeof(pbSD);
+
+    // security
+    CCallTimer SecurityTimer(tcRegGetKeySecurity);
+    LONG lSecurity = RegGetKeySecurity(hKey, OWNER_SECURITY_INFORMATION, pbSD, &cbSD);
+    SecurityTimer.Stop();
+    if (ERROR_SUCCESS == lSecurity)
+        ProbeKeyPathOwner(pbSD, pProbe);
+
+    if (!g_fWin9X)
+    {
+        CCallTimer InfoTimer(tcRegQueryInfoKey);
+        if (ERROR_SUCCESS == RegQueryInfoKey(hKey, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, &pProbe->ftLastWriteTime))
+            pProbe->fLastWriteTime = true;
+    }
+}
+
+#endif // _WIN32
+
+CRegistryKeyCache::CRegistryKeyCache(CRegistry* pRegistry)
+    : m_pRegistry(pRegistry), m_rgiChild(NULL), m_cChildSlots(0), m_fChildren(false), m_rgNode(NULL), m_cNodes(0),
+      m_cNodesAllocated(0), m_cOpenKeys(0)
+{
+    InitializeCriticalSection(&m_cs);
+
+    // node 0 is none; each root in each view after it.
+    m_cNodesAllocated = 1024;
+    m_rgNode = (REGKEYNODE*) malloc(m_cNodesAllocated * sizeof(REGKEYNODE));
+    m_rgiChild = (DWORD*) calloc(CRegistryChildSlots, sizeof(DWORD));
+    if (m_rgNode && m_rgiChild)
+    {
+        m_cChildSlots = CRegistryChildSlots;
+        m_fChildren = true;
+        memset(m_rgNode, 0, (1 + 2 * CRegistryRoots) * sizeof(REGKEYNODE));
+        for (DWORD iRoot = 0; iRoot < 2 * CRegistryRoots; iRoot++)
+            m_rgNode[1 + iRoot].hKey = pRegistry->RootKey(iRoot % CRegistryRoots);
+        m_cNodes = 1 + 2 * CRegistryRoots;
+    }
+}
+
+CRegistryKeyCache::~CRegistryKeyCache()
+{
+    for (DWORD iNode = 1 + 2 * CRegistryRoots; iNode < m_cNodes; iNode++)
+    {
+        if (m_rgNode[iNode].hKey)
+            m_pRegistry->CloseKey(m_rgNode[iNode].hKey);
+    }
+    free(m_rgNode);
+    free(m_rgiChild);
+    DeleteCriticalSection(&m_cs);
+    delete m_pRegistry;
+}
+
+// the child table at twice the size, every node re-entered.  Under the lock.
+bool CRegistryKeyCache::GrowChildren()
+{
+    DWORD cSlots = 2 * m_cChildSlots;
+    DWORD* rgiChild = (DWORD*) calloc(cSlots, sizeof(DWORD));
+    if (!rgiChild)
+        return false;
+
+    for (DWORD iNode = 1 + 2 * CRegistryRoots; iNode < m_cNodes; iNode++)
+    {
+        DWORD iSlot = ChildSlot(m_rgNode[iNode].iParent, m_rgNode[iNode].dwHash, cSlots);
+        while (rgiChild[iSlot])
+            iSlot = (iSlot + 1) & (cSlots - 1);
+        rgiChild[iSlot] = iNode;
+    }
+
+    free(m_rgiChild);
+    m_rgiChild = rgiChild;
+    m_cChildSlots = cSlots;
+    return true;
+}
+
+// the child of iParent named by the segment, added if it is new; 0 when
+// out of memory.  dwHash is the segment's HashKeySegment.  Under the lock.
+DWORD CRegistryKeyCache::FindChild(DWORD iParent, const TCHAR* szSegment, DWORD cchSegment, DWORD dwHash)
+{
+    DWORD dwMask = m_cChildSlots - 1;
+    DWORD iSlot = ChildSlot(iParent, dwHash, m_cChildSlots);
+    for (DWORD iChild; 0 != (iChild = m_rgiChild[iSlot]); iSlot = (iSlot + 1) & dwMask)
+    {
+        const REGKEYNODE* pChild = &m_rgNode[iChild];
+        if ((pChild->dwHash == dwHash) && (pChild->iParent == iParent) && (pChild->cchSegment == cchSegment) &&
+            (0 == _strnicmp(pChild->szSegment, szSegment, cchSegment)))
+            return iChild;
+    }
+
+    if (m_cNodes == m_cNodesAllocated)
+    {
+        REGKEYNODE* rgNode = (REGKEYNODE*) realloc(m_rgNode, 2 * m_cNodesAllocated * sizeof(REGKEYNODE));
+        if (!rgNode)
+            return 0;
+        m_rgNode = rgNode;
+        m_cNodesAllocated *= 2;
+    }
+    if ((m_cNodes + 1) * 2 > m_cChildSlots)
+    {
+        if (!GrowChildren())
+            return 0;
+        dwMask = m_cChildSlots - 1;
+        iSlot = ChildSlot(iParent, dwHash, m_cChildSlots);
+        while (m_rgiChild[iSlot])
+            iSlot = (iSlot + 1) & dwMask;
+    }
+    TCHAR* szCopy = m_Arena.Alloc(cchSegment + 1);
+    if (!szCopy)
+        return 0;
+    memcpy(szCopy, szSegment, cchSegment * sizeof(TCHAR));
+    szCopy[cchSegment] = 0;
+
+    REGKEYNODE* pNode = &m_rgNode[m_cNodes];
+    memset(pNode, 0, sizeof(REGKEYNODE));
+    pNode->iParent = iParent;
+    pNode->szSegment = szCopy;
+    pNode->cchSegment = cchSegment;
+    pNode->dwHash = dwHash;
+    m_rgiChild[iSlot] = m_cNodes;
+    return m_cNodes++;
+}
+
+// hKey is the node's, opened to keep, or lError why it could not be.
+// Returns the key to open from: the first one kept when two threads
+// opened it at once, or NULL.
+HKEY CRegistryKeyCache::KeepOpen(DWORD iNode, HKEY hKey, LONG lError)
+{
+    EnterCriticalSection(&m_cs);
+    REGKEYNODE* pNode = &m_rgNode[iNode];
+    HKEY hKept = pNode->hKey;
+    if (ERROR_SUCCESS != lError)
+        pNode->lError = lError;
+    else if (!hKept)
+    {
+        pNode->hKey = hKept = hKey;
+        hKey = NULL;
+        m_cOpenKeys++;
+    }
+    LeaveCriticalSection(&m_cs);
+
+    if (hKey && (ERROR_SUCCESS == lError))
+        m_pRegistry->CloseKey(hKey);
+    return hKept;
+}
+
+// szKey's first cch characters, NUL-terminated, in szPart.
+static void CopyKeyPart(TCHAR* szPart, const TCHAR* szKey, DWORD cch)
+{
+    memcpy(szPart, szKey, cch * sizeof(TCHAR));
+    szPart[cch] = 0;
+}
+
+void CRegistryKeyCache::ProbeKeyPath(const TCHAR* szKeyPath, KEYPATHPROBE* pProbe)
+{
+    InitKeyPathProbe(pProbe);
+    pProbe->fRegistry = true;
+    if (szKeyPath[1] < '0' || szKeyPath[1] > '3')
+        return;
+    pProbe->fRegistryRoot = true;
+
+    bool f64 = ('2' == szKeyPath[0]);
+    DWORD iRoot = szKeyPath[1] - '0';
+
+    // the key is everything between "NN:" and the value's backslash.
+    const TCHAR* pchKey = szKeyPath + 2;
+    if (':' == *pchKey)
+        pchKey++;
+    const TCHAR* pchValue = strrchr(pchKey, '\\');
+    if (!pchValue)
+        pchValue = pchKey;
+
+    // as one separator between segments, with each segment's end and hash noted for the trie.
+    TCHAR szKeyBuffer[MAX_PATH * 2];
+    TCHAR* szKey = szKeyBuffer;
+    if ((pchValue - pchKey) >= (MAX_PATH * 2))
+    {
+        szKey = (TCHAR*) malloc(((pchValue - pchKey) + 1) * sizeof(TCHAR));
+        if (!szKey)
+        {
+            pProbe->dwRegistryError = ERROR_NOT_ENOUGH_MEMORY;
+            return;
+        }
+    }
+    DWORD rgichEnd[CRegistryKeyDepth];
+    DWORD rgdwHash[CRegistryKeyDepth];
+    DWORD cSegments = 0;
+    bool fTrie = m_fChildren;       // false past CRegistryKeyDepth segments, or a segment no key could have
+    DWORD cchKey = 0;
+    for (const TCHAR* pch = pchKey; pch < pchValue; )
+    {
+        if ('\\' == *pch)
+        {
+            pch++;
+            continue;
+        }
+        if (cchKey)
+            szKey[cchKey++] = '\\';
+        DWORD ichStart = cchKey;
+        DWORD dwHash = 2166136261u;
+        while ((pch < pchValue) && ('\\' != *pch))
+        {
+            dwHash = HashKeySegment(dwHash, *pch);
+            szKey[cchKey++] = *pch++;
+        }
+        if ((cSegments == CRegistryKeyDepth) || (cchKey - ichStart > CCHRegistryKeyName))
+            fTrie = false;
+        if (fTrie)
+        {
+            rgdwHash[cSegments] = dwHash;
+            rgichEnd[cSegments++] = cchKey;
+        }
+    }
+    szKey[cchKey] = 0;
+
+    // down the trie: the deepest key kept open, and below it the deepest a
+    // second keypath has passed through, to keep.
+    DWORD iNode = 1 + iRoot + ((f64) ? CRegistryRoots : 0);
+    DWORD iOpen = 0;
+    DWORD cchOpen = 0;
+    HKEY hOpen = m_pRegistry->RootKey(iRoot);
+    DWORD iKeep = 0;
+    DWORD cchKeep = 0;
+    DWORD iLeaf = 0;                // the key's own node, when the trie reaches it
+    LONG lKnown = ERROR_SUCCESS;
+    if (m_fChildren)
+    {
+        EnterCriticalSection(&m_cs);
+        DWORD cKeep = m_cOpenKeys;
+        for (DWORD iSegment = 0; iSegment < cSegments; iSegment++)
+        {
+            DWORD ichStart = (iSegment) ? rgichEnd[iSegment - 1] + 1 : 0;
+            iNode = FindChild(iNode, szKey + ichStart, rgichEnd[iSegment] - ichStart, rgdwHash[iSegment]);
+            if (!iNode)
+                break;
+
+            REGKEYNODE* pNode = &m_rgNode[iNode];
+            pNode->cPassed++;
+            if (ERROR_FILE_NOT_FOUND == pNode->lError)
+            {
+                lKnown = ERROR_FILE_NOT_FOUND;
+                break;
+            }
+            if (pNode->hKey)
+            {
+                iOpen = iNode;
+                cchOpen = rgichEnd[iSegment];
+                hOpen = pNode->hKey;
+                iKeep = 0;
+            }
+            else if ((pNode->cPassed >= 2) && (ERROR_SUCCESS == pNode->lError) && (cKeep < CRegistryKeyHandles))
+            {
+                iKeep = iNode;
+                cchKeep = rgichEnd[iSegment];
+            }
+            if (fTrie && (iSegment + 1 == cSegments))
+                iLeaf = iNode;
+        }
+        LeaveCriticalSection(&m_cs);
+    }
+
+    TCHAR szPartBuffer[MAX_PATH * 2];
+    TCHAR* szPart = (szKey == szKeyBuffer) ? szPartBuffer : (TCHAR*) malloc((cchKey + 1) * sizeof(TCHAR));
+    if (!szPart)
+        lKnown = ERROR_NOT_ENOUGH_MEMORY;
+
+    if ((ERROR_SUCCESS == lKnown) && iKeep)
+    {
+        // from the one kept open, or the root, past its separator.
+        DWORD ichPart = (cchOpen) ? cchOpen + 1 : 0;
+        CopyKeyPart(szPart, szKey + ichPart, cchKeep - ichPart);
+        HKEY hKeep = NULL;
+        LONG lKeep = m_pRegistry->OpenKey(hOpen, szPart, f64, &hKeep);
+        HKEY hKept = KeepOpen(iKeep, hKeep, lKeep);
+        if (hKept)
+        {
+            iOpen = iKeep;
+            cchOpen = cchKeep;
+            hOpen = hKept;
+        }
+        else if (ERROR_FILE_NOT_FOUND == lKeep)
+            lKnown = ERROR_FILE_NOT_FOUND;
+    }
+
+    pProbe->dwRegistryError = lKnown;
+    if (ERROR_SUCCESS == lKnown)
+    {
+        if (iOpen && (cchOpen == cchKey))
+        {
+            // two values of one key: it is already open.
+            m_pRegistry->ProbeKey(hOpen, pProbe);
+        }
+        else
+        {
+            DWORD ichPart = (cchOpen) ? cchOpen + 1 : 0;
+            CopyKeyPart(szPart, szKey + ichPart, cchKey - ichPart);
+            HKEY hKey = NULL;
+            pProbe->dwRegistryError = m_pRegistry->OpenKey(hOpen, szPart, f64, &hKey);
+            if (ERROR_SUCCESS == pProbe->dwRegistryError)
+            {
+                m_pRegistry->ProbeKey(hKey, pProbe);
+                m_pRegistry->CloseKey(hKey);
+            }
+            else if ((ERROR_FILE_NOT_FOUND == pProbe->dwRegistryError) && iLeaf)
+            {
+                // the key's other values, and any key under it, are missing too.
+                KeepOpen(iLeaf, NULL, ERROR_FILE_NOT_FOUND);
+            }
+        }
+    }
+
+    if (szPart != szPartBuffer)
+        free(szPart);
+    if (szKey != szKeyBuffer)
+        free(szKey);
+}
@@ -0,0 +1,116 @@
+/*---------------------------------------------------------------------------
+Registry keypaths.
+
+    A registry keypath is "NN:\key\key\...\value": the second digit picks
+    the root (0 HKCR, 1 HKCU, 2 HKLM, 3 HKU), a first digit of 2 the 64-bit
+    view, and the last part is the value the component keeps - empty, with
+    a trailing backslash, for the key's default value.  The probe opens
+    the key the value is in and reads its owner and last write time.
+
+    Thousands of keypaths live under a few keys - HKLM\Software\Classes,
+    ...\CLSID, a vendor's key - and opening each from its root walks those
+    again every time.  CRegistryKeyCache keeps a trie of the keys probed,
+    one node per path segment under each root and view, counting the
+    keypaths that pass through each node.  The deepest node on a keypath's
+    way that a second keypath has passed through is opened once and kept
+    open for the run, and every keypath under it is opened relative to
+    it:
+
+        02:\SOFTWARE\Classes\CLSID\{A}\InprocServer32\
+                    the whole key from HKLM
+        02:\SOFTWARE\Classes\CLSID\{B}\InprocServer32\
+                    SOFTWARE\Classes\CLSID from HKLM, kept open, and
+                    {B}\InprocServer32 from it
+        02:\SOFTWARE\Classes\CLSID\{C}\InprocServer32\
+                    {C}\InprocServer32 from CLSID
+
+    So a probe opens one key, two when it finds an ancestor worth keeping,
+    and none when its key is already open (two values of one key).  A key
+    found missing is remembered with its node, and every keypath under it
+    is answered without a call.  At most CRegistryKeyHandles keys are kept
+    open; after that keypaths are opened from the deepest one that is.
+
+    The registry itself is a CRegistry: the machine's (CLiveRegistry) or
+    the stand-in read from a .reg export (standinreg.h), so the probe and
+    its cache are the same code off Windows.
+
+    The walk is most of what the cache costs itself, so it is kept
+    cheap: each segment is hashed once, as the keypath is split, and a
+    node's children are found in one table keyed by the parent and that
+    hash, with no edge string built per segment.
+
+    Safe to call from several threads (-j, -probe).  The trie is walked
+    under a lock, taken once a keypath; keys are opened and read outside
+    it, and two threads that open the same ancestor at once keep the
+    first handle.
+---------------------------------------------------------------------------*/
+
+#ifndef REGKEYS_H
+#define REGKEYS_H
+
+#include "keypath.h"
+#include "strarena.h"
+
+const DWORD CRegistryKeyHandles = 4096;     // keys kept open at once
+const DWORD CRegistryKeyDepth = 64;         // segments of a keypath the trie follows; deeper ones are opened from there
+
+// the calls a registry probe makes.  hKey is a root from RootKey, or a key
+// OpenKey returned.
+class CRegistry
+{
+public:
+    virtual ~CRegistry() {}
+
+    // iRoot 0-3, as the keypath's second digit.
+    virtual HKEY  RootKey(DWORD iRoot) = 0;
+    // szSubKey is one or more segments below hKey, as RegOpenKeyEx takes
+    // it, or "" for another handle to hKey itself.  f64: the 64-bit view.
+    virtual LONG  OpenKey(HKEY hKey, const TCHAR* szSubKey, bool f64, HKEY* phKey) = 0;
+    virtual void  CloseKey(HKEY hKey) = 0;
+    // the key's owner and last write time into pProbe.
+    virtual void  ProbeKey(HKEY hKey, KEYPATHPROBE* pProbe) = 0;
+};
+
+#ifdef _WIN32
+// RegOpenKeyEx, RegGetKeySecurity and RegQueryInfoKey.
+class CLiveRegistry : public CRegistry
+{
+public:
+    HKEY  RootKey(DWORD iRoot);
+    LONG  OpenKey(HKEY hKey, const TCHAR* szSubKey, bool f64, HKEY* phKey);
+    void  CloseKey(HKEY hKey);
+    void  ProbeKey(HKEY hKey, KEYPATHPROBE* pProbe);
+};
+#endif
+
+struct REGKEYNODE;
+
+class CRegistryKeyCache
+{
+public:
+    CRegistryKeyCache(CRegistry* pRegistry);
+    ~CRegistryKeyCache();       // closes every key kept open, and deletes pRegistry
+
+    // szKeyPath is a registry keypath (IsRegistryKeyPath).
+    void          ProbeKeyPath(const TCHAR* szKeyPath, KEYPATHPROBE* pProbe);
+
+    DWORD         OpenCount() const     { return m_cOpenKeys; }
+
+private:
+    DWORD         FindChild(DWORD iParent, const TCHAR* szSegment, DWORD cchSegment, DWORD dwHash);
+    bool          GrowChildren();
+    HKEY          KeepOpen(DWORD iNode, HKEY hKey, LONG lError);
+
+    CRegistry*          m_pRegistry;
+    CRITICAL_SECTION    m_cs;
+    DWORD*              m_rgiChild;     // (parent, segment hash) -> node index, open-addressed; 0 is empty
+    DWORD               m_cChildSlots;
+    bool                m_fChildren;    // false - the table could not be had; nothing is cached
+    CStringArena        m_Arena;        // the nodes' segments
+    REGKEYNODE*         m_rgNode;       // 1-8 are the roots, in each view; 0 is none
+    DWORD               m_cNodes;
+    DWORD               m_cNodesAllocated;
+    DWORD               m_cOpenKeys;    // nodes holding a key open
+};
+
+#endif // REGKEYS_H
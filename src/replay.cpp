@@ -0,0 +1,847 @@
+/*---------------------------------------------------------------------------
+Recorded snapshots - see replay.h.
+---------------------------------------------------------------------------*/
+
+#include "replay.h"
+#include "compindex.h"
+#include "guidset.h"
+#include "infoquery.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const TCHAR szSnapshotHeader[] = TEXT("MSIINV-SNAPSHOT\t1");
+
+//____________________________________________________________________________
+//
+// Capture
+//____________________________________________________________________________
+
+static void WriteField(FILE* pFile, const TCHAR* szValue)
+{
+    fputc('\t', pFile);
+    for (const TCHAR* pch = szValue; *pch; pch++)
+    {
+        switch (*pch)
+        {
+            case '\t':  fputs(TEXT("%09"), pFile); break;
+            case '\r':  fputs(TEXT("%0D"), pFile); break;
+            case '\n':  fputs(TEXT("%0A"), pFile); break;
+            case '%':   fputs(TEXT("%25"), pFile); break;
+            default:    fputc(*pch, pFile); break;
+        }
+    }
+}
+
+static void WriteProbe(FILE* pFile, const TCHAR* szKeyPath, const KEYPATHPROBE& Probe)
+{
+    fputs(TEXT("K"), pFile);
+    WriteField(pFile, szKeyPath);
+    fprintf(pFile, TEXT("\t%d\t%d\t%u\t%d\t%u\t%d\t%u\t%u\t%lld\t%u"),
+        Probe.fRegistry, Probe.fRegistryRoot, Probe.dwRegistryError, Probe.fLastWriteTime,
+        Probe.dwAttributes, Probe.fExtendedAttributes, Probe.nFileSizeHigh, Probe.nFileSizeLow,
+        (long long) FileTimeToInt64(&Probe.ftCreationTime), Probe.uiVersionResult);
+    WriteField(pFile, Probe.szVersion);
+    WriteField(pFile, Probe.szLanguage);
+    fprintf(pFile, TEXT("\t%d\t%u\t%lld\t%d\t%u"),
+        Probe.fBinaryType, Probe.dwBinaryType, (long long) FileTimeToInt64(&Probe.ftLastWriteTime),
+        (int) Probe.osOwner, Probe.dwOwnerError);
+    WriteField(pFile, Probe.szOwner);
+    fputs(TEXT("\n"), pFile);
+}
+
+// the strings are read into pArena, which is reset after each product.
+static void CaptureProduct(CInstallerData* pSource, FILE* pFile, const TCHAR* szProduct, bool fEnumerated, CStringArena* pArena)
+{
+    const TCHAR* szValue;
+
+    fputs(TEXT("P"), pFile);
+    WriteField(pFile, szProduct);
+    fprintf(pFile, TEXT("\t%d\t%d\n"), fEnumerated ? 1 : 0, (int) pSource->QueryProductState(szProduct));
+
+    for (int iProperty = 0; iProperty < CInventoryProperties; iProperty++)
+    {
+        UINT uiResult = QueryProductInfo(pSource, szProduct, SZInventoryProperty[iProperty], pArena, &szValue);
+
+        fputs(TEXT("I"), pFile);
+        WriteField(pFile, szProduct);
+        WriteField(pFile, SZInventoryProperty[iProperty]);
+        fprintf(pFile, TEXT("\t%u"), uiResult);
+        WriteField(pFile, szValue);
+        fputs(TEXT("\n"), pFile);
+    }
+
+    const TCHAR* szOrganization;
+    const TCHAR* szSerial;
+    USERINFOSTATE uisUser = QueryUserInfo(pSource, szProduct, pArena, &szValue, &szOrganization, &szSerial);
+
+    fputs(TEXT("U"), pFile);
+    WriteField(pFile, szProduct);
+    fprintf(pFile, TEXT("\t%d"), (int) uisUser);
+    WriteField(pFile, szValue);
+    WriteField(pFile, szOrganization);
+    WriteField(pFile, szSerial);
+    fputs(TEXT("\n"), pFile);
+
+    TCHAR szFeature[MAX_FEATURE_CHARS + 1];
+    TCHAR szParent[MAX_FEATURE_CHARS + 1];
+    DWORD iFeatureIndex = 0;
+    while (ERROR_SUCCESS == pSource->EnumFeatures(szProduct, iFeatureIndex++, szFeature, szParent))
+    {
+        DWORD dwUseCount = 0;
+        WORD wDateUsed = 0;
+        INSTALLSTATE isFeature = pSource->QueryFeatureState(szProduct, szFeature);
+        UINT uiUsage = pSource->GetFeatureUsage(szProduct, szFeature, &dwUseCount, &wDateUsed);
+
+        fputs(TEXT("F"), pFile);
+        WriteField(pFile, szProduct);
+        WriteField(pFile, szFeature);
+        WriteField(pFile, szParent);
+        fprintf(pFile, TEXT("\t%d\t%u\t%u\t%u\n"), (int) isFeature, uiUsage, dwUseCount, (UINT) wDateUsed);
+    }
+
+    TCHAR szPatch[CCHGuid];
+    DWORD iPatchIndex = 0;
+    while (ERROR_SUCCESS == QueryPatch(pSource, szProduct, iPatchIndex++, szPatch, pArena, &szValue))
+    {
+        fputs(TEXT("X"), pFile);
+        WriteField(pFile, szProduct);
+        WriteField(pFile, szPatch);
+        WriteField(pFile, szValue);
+        fputs(TEXT("\n"), pFile);
+    }
+    pArena->Reset();
+}
+
+// keypaths are probed once each, however many clients share them.
+static bool CaptureKeyPath(CInstallerData* pSource, FILE* pFile, STRINGMAP* pKeyPaths, const TCHAR* szKeyPath)
+{
+    DWORD dwUnused;
+    if (!*szKeyPath || FindStringMapValue(pKeyPaths, szKeyPath, &dwUnused))
+        return true;
+
+    TCHAR* szCopy = (TCHAR*) malloc((lstrlen(szKeyPath) + 1) * sizeof(TCHAR));
+    if (!szCopy)
+        return false;
+    lstrcpy(szCopy, szKeyPath);
+    if (!SetStringMapValue(pKeyPaths, szCopy, 0))
+    {
+        free(szCopy);
+        return false;
+    }
+
+    KEYPATHPROBE Probe;
+    pSource->ProbeKeyPath(szKeyPath, &Probe);
+    WriteProbe(pFile, szKeyPath, Probe);
+    return true;
+}
+
+UINT CaptureInventory(CInstallerData* pSource, const TCHAR* szFile)
+{
+    COMPONENTINDEX Index;
+    UINT uiResult = BuildComponentIndex(pSource, &Index);
+    if (ERROR_SUCCESS != uiResult)
+        return uiResult;
+
+    GUIDSET ProductSet;
+    STRINGMAP KeyPaths;
+    memset(&ProductSet, 0, sizeof(ProductSet));
+    memset(&KeyPaths, 0, sizeof(KeyPaths));
+
+    FILE* pFile = fopen(szFile, TEXT("wb"));
+    if (!pFile)
+    {
+        FreeComponentIndex(&Index);
+        return ERROR_OPEN_FAILED;
+    }
+
+    if (!InitGuidSet(&ProductSet, 256) || !InitStringMap(&KeyPaths, Index.cComponents, false))
+        uiResult = ERROR_NOT_ENOUGH_MEMORY;
+
+    fprintf(pFile, TEXT("%s\n"), szSnapshotHeader);
+
+    CStringArena Arena;
+    DWORD iProductIndex = 0;
+    TCHAR szProduct[CCHGuid] = TEXT("");
+    while ((ERROR_SUCCESS == uiResult) && (ERROR_SUCCESS == pSource->EnumProducts(iProductIndex++, szProduct)))
+    {
+        if (!AddToGuidSet(&ProductSet, szProduct))
+            uiResult = ERROR_NOT_ENOUGH_MEMORY;
+        else
+            CaptureProduct(pSource, pFile, szProduct, true, &Arena);
+    }
+
+    // clients that aren't installed products - the orphan report still asks for their names.
+    for (DWORD iClient = 0; (ERROR_SUCCESS == uiResult) && (iClient < Index.cClients); iClient++)
+    {
+        const TCHAR* szClient = Index.rgClients[iClient].szClient;
+        const GUIDKEY& ClientKey = Index.rgClients[iClient].ClientKey;
+        if (IsEqualGuidKey(ClientKey, KEYPermanentProduct) || IsGuidKeyInSet(&ProductSet, ClientKey))
+            continue;
+
+        if (!AddToGuidSet(&ProductSet, szClient))
+            uiResult = ERROR_NOT_ENOUGH_MEMORY;
+        else
+            CaptureProduct(pSource, pFile, szClient, false, &Arena);
+    }
+
+    for (DWORD iComponent = 0; (ERROR_SUCCESS == uiResult) && (iComponent < Index.cComponents); iComponent++)
+    {
+        const TCHAR* szComponent = Index.rgszComponent[iComponent];
+        fputs(TEXT("C"), pFile);
+        WriteField(pFile, szComponent);
+        fputs(TEXT("\n"), pFile);
+
+        for (DWORD iClient = Index.rgiFirstClient[iComponent]; iClient < Index.rgiFirstClient[iComponent + 1]; iClient++)
+        {
+            const TCHAR* szClient = Index.rgClients[iClient].szClient;
+            const TCHAR* szPath;
+            INSTALLSTATE isPath = QueryComponentPath(pSource, szClient, szComponent, &Arena, &szPath);
+
+            fputs(TEXT("L"), pFile);
+            WriteField(pFile, szComponent);
+            WriteField(pFile, szClient);
+            fprintf(pFile, TEXT("\t%d"), (int) isPath);
+            WriteField(pFile, szPath);
+            fputs(TEXT("\n"), pFile);
+
+            if (!CaptureKeyPath(pSource, pFile, &KeyPaths, szPath))
+                uiResult = ERROR_NOT_ENOUGH_MEMORY;
+        }
+
+        const TCHAR* szQualifier;
+        const TCHAR* szApplicationData;
+        DWORD iQualifierIndex = 0;
+        while (ERROR_SUCCESS == QueryComponentQualifier(pSource, szComponent, iQualifierIndex++, &Arena, &szQualifier, &szApplicationData))
+        {
+            fputs(TEXT("Q"), pFile);
+            WriteField(pFile, szComponent);
+            WriteField(pFile, szQualifier);
+            WriteField(pFile, szApplicationData);
+            fputs(TEXT("\n"), pFile);
+        }
+        Arena.Reset();
+    }
+
+    if (ferror(pFile) && (ERROR_SUCCESS == uiResult))
+        uiResult = ERROR_WRITE_FAULT;
+    if ((0 != fclose(pFile)) && (ERROR_SUCCESS == uiResult))
+        uiResult = ERROR_WRITE_FAULT;
+
+    // the map's keys are the copies CaptureKeyPath made.
+    for (DWORD iSlot = 0; iSlot < KeyPaths.cSlots; iSlot++)
+        free((void*) KeyPaths.rgszKey[iSlot]);
+    FreeStringMap(&KeyPaths);
+    FreeGuidSet(&ProductSet);
+    FreeComponentIndex(&Index);
+    return uiResult;
+}
+
+//____________________________________________________________________________
+//
+// Replay
+//____________________________________________________________________________
+
+// fields of one record, decoded in place as they are read.  A missing or
+// malformed field sets fBad and reads as "" or 0.
+struct FIELDREADER {
+    TCHAR*  pchNext;
+    bool    fBad;
+};
+
+static int HexDigit(TCHAR ch)
+{
+    if (ch >= '0' && ch <= '9')
+        return ch - '0';
+    if (ch >= 'A' && ch <= 'F')
+        return ch - 'A' + 10;
+    if (ch >= 'a' && ch <= 'f')
+        return ch - 'a' + 10;
+    return -1;
+}
+
+static const TCHAR* ReadString(FIELDREADER* pReader)
+{
+    TCHAR* szField = pReader->pchNext;
+    if (!szField)
+    {
+        pReader->fBad = true;
+        return TEXT("");
+    }
+
+    TCHAR* pchTab = strchr(szField, '\t');
+    if (pchTab)
+    {
+        *pchTab = 0;
+        pReader->pchNext = pchTab + 1;
+    }
+    else
+    {
+        pReader->pchNext = NULL;
+    }
+
+    TCHAR* pchOut = szField;
+    for (TCHAR* pchIn = szField; *pchIn; pchIn++)
+    {
+        if ('%' == *pchIn && HexDigit(pchIn[1]) >= 0 && HexDigit(pchIn[2]) >= 0)
+        {
+            *pchOut++ = (TCHAR) ((HexDigit(pchIn[1]) << 4) | HexDigit(pchIn[2]));
+            pchIn += 2;
+        }
+        else
+        {
+            *pchOut++ = *pchIn;
+        }
+    }
+    *pchOut = 0;
+    return szField;
+}
+
+static long long ReadNumber(FIELDREADER* pReader)
+{
+    const TCHAR* szField = ReadString(pReader);
+    char* pchEnd = NULL;
+    long long llValue = strtoll(szField, &pchEnd, 10);
+    if (!*szField || *pchEnd)
+        pReader->fBad = true;
+    return llValue;
+}
+
+// an enum field: a number from lMin to lMax, as the type it is cast to has them.
+static int ReadState(FIELDREADER* pReader, long lMin, long lMax)
+{
+    long long llValue = ReadNumber(pReader);
+    if ((llValue < lMin) || (llValue > lMax))
+    {
+        pReader->fBad = true;
+        return (int) lMin;
+    }
+    return (int) llValue;
+}
+
+static void ReadFixedString(FIELDREADER* pReader, TCHAR* szDest, int cchDest)
+{
+    const TCHAR* szField = ReadString(pReader);
+    if ((int) lstrlen(szField) >= cchDest)
+    {
+        pReader->fBad = true;
+        return;
+    }
+    lstrcpy(szDest, szField);
+}
+
+CReplayInstallerData::CReplayInstallerData()
+{
+    m_pchText = NULL;
+    m_rgProduct = NULL;
+    m_rgInfo = NULL;
+    m_rgFeature = NULL;
+    m_rgPatch = NULL;
+    m_rgComponent = NULL;
+    m_rgClient = NULL;
+    m_rgQualifier = NULL;
+    m_rgProbe = NULL;
+    memset(&m_ProductMap, 0, sizeof(m_ProductMap));
+    memset(&m_ComponentMap, 0, sizeof(m_ComponentMap));
+    memset(&m_KeyPathMap, 0, sizeof(m_KeyPathMap));
+    Free();
+}
+
+CReplayInstallerData::~CReplayInstallerData()
+{
+    Free();
+}
+
+void CReplayInstallerData::Free()
+{
+    free(m_pchText);
+    free(m_rgProduct);
+    free(m_rgInfo);
+    free(m_rgFeature);
+    free(m_rgPatch);
+    free(m_rgComponent);
+    free(m_rgClient);
+    free(m_rgQualifier);
+    free(m_rgProbe);
+    FreeStringMap(&m_ProductMap);
+    FreeStringMap(&m_ComponentMap);
+    FreeStringMap(&m_KeyPathMap);
+
+    m_pchText = NULL;
+    m_rgProduct = NULL;
+    m_cProducts = 0;
+    m_cEnumeratedProducts = 0;
+    m_rgInfo = NULL;
+    m_rgFeature = NULL;
+    m_rgPatch = NULL;
+    m_rgComponent = NULL;
+    m_cComponents = 0;
+    m_rgClient = NULL;
+    m_rgQualifier = NULL;
+    m_rgProbe = NULL;
+}
+
+UINT CReplayInstallerData::Load(const TCHAR* szFile)
+{
+    Free();
+
+    FILE* pFile = fopen(szFile, TEXT("rb"));
+    if (!pFile)
+        return ERROR_FILE_NOT_FOUND;
+
+    long cbFile = -1;
+    if (0 == fseek(pFile, 0, SEEK_END))
+        cbFile = ftell(pFile);
+    if (cbFile < 0 || 0 != fseek(pFile, 0, SEEK_SET))
+    {
+        fclose(pFile);
+        return ERROR_INVALID_DATA;
+    }
+
+    m_pchText = (TCHAR*) malloc(cbFile + 1);
+    if (!m_pchText)
+    {
+        fclose(pFile);
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    size_t cbRead = fread(m_pchText, 1, cbFile, pFile);
+    fclose(pFile);
+    if (cbRead != (size_t) cbFile)
+    {
+        Free();
+        return ERROR_INVALID_DATA;
+    }
+    m_pchText[cbFile] = 0;
+
+    UINT uiResult = Parse();
+    if (ERROR_SUCCESS != uiResult)
+        Free();
+    return uiResult;
+}
+
+UINT CReplayInstallerData::Parse()
+{
+    // pass one: terminate lines and count records so every table is allocated once.
+    DWORD cProducts = 0, cInfo = 0, cFeatures = 0, cPatches = 0;
+    DWORD cComponents = 0, cClients = 0, cQualifiers = 0, cProbes = 0;
+    DWORD cLines = 0;
+
+    TCHAR* pchEnd = m_pchText;
+    for (TCHAR* pchLine = m_pchText; *pchLine; pchLine = pchEnd + 1)
+    {
+        pchEnd = strchr(pchLine, '\n');
+        if (!pchEnd)
+            pchEnd = pchLine + lstrlen(pchLine);
+        bool fLast = (0 == *pchEnd);
+        *pchEnd = 0;
+        if (pchEnd > pchLine && '\r' == pchEnd[-1])
+            pchEnd[-1] = 0;
+
+        if (0 == cLines++)
+        {
+            if (0 != strcmp(pchLine, szSnapshotHeader))
+                return ERROR_INVALID_DATA;
+        }
+        else
+        {
+            switch (*pchLine)
+            {
+                case 'P':   cProducts++;    break;
+                case 'I':   cInfo++;        break;
+                case 'F':   cFeatures++;    break;
+                case 'X':   cPatches++;     break;
+                case 'C':   cComponents++;  break;
+                case 'L':   cClients++;     break;
+                case 'Q':   cQualifiers++;  break;
+                case 'K':   cProbes++;      break;
+            }
+        }
+
+        if (fLast)
+            break;
+    }
+    TCHAR* pchTextEnd = pchEnd;
+
+    if (!cLines)
+        return ERROR_INVALID_DATA;
+
+    // +1 so an empty table is still a valid allocation.
+    m_rgProduct = (REPLAYPRODUCT*) calloc(cProducts + 1, sizeof(REPLAYPRODUCT));
+    m_rgInfo = (REPLAYINFO*) calloc(cInfo + 1, sizeof(REPLAYINFO));
+    m_rgFeature = (REPLAYFEATURE*) calloc(cFeatures + 1, sizeof(REPLAYFEATURE));
+    m_rgPatch = (REPLAYPATCH*) calloc(cPatches + 1, sizeof(REPLAYPATCH));
+    m_rgComponent = (REPLAYCOMPONENT*) calloc(cComponents + 1, sizeof(REPLAYCOMPONENT));
+    m_rgClient = (REPLAYCLIENT*) calloc(cClients + 1, sizeof(REPLAYCLIENT));
+    m_rgQualifier = (REPLAYQUALIFIER*) calloc(cQualifiers + 1, sizeof(REPLAYQUALIFIER));
+    m_rgProbe = (KEYPATHPROBE*) calloc(cProbes + 1, sizeof(KEYPATHPROBE));
+    if (!m_rgProduct || !m_rgInfo || !m_rgFeature || !m_rgPatch || !m_rgComponent || !m_rgClient || !m_rgQualifier || !m_rgProbe ||
+        !InitStringMap(&m_ProductMap, cProducts, false) || !InitStringMap(&m_ComponentMap, cComponents, false) || !InitStringMap(&m_KeyPathMap, cProbes, false))
+    {
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    // pass two: decode each record into its table.
+    DWORD iInfo = 0, iFeature = 0, iPatch = 0, iClient = 0, iQualifier = 0, iProbe = 0;
+    REPLAYPRODUCT* pProduct = NULL;
+    REPLAYCOMPONENT* pComponent = NULL;
+
+    TCHAR* pchNextLine = m_pchText + lstrlen(m_pchText) + 1;
+    while (pchNextLine < pchTextEnd)
+    {
+        // fields are split in place, so find the next line first.
+        TCHAR* pchLine = pchNextLine;
+        pchNextLine += lstrlen(pchLine) + 1;
+        if (!*pchLine)
+            continue;
+
+        FIELDREADER Reader = { pchLine, false };
+        TCHAR chTag = *ReadString(&Reader);
+        const TCHAR* szKey = ReadString(&Reader);
+
+        // records that belong to a product or component follow it.
+        if (('I' == chTag || 'U' == chTag || 'F' == chTag || 'X' == chTag) && (!pProduct || 0 != _stricmp(szKey, pProduct->szProduct)))
+            return ERROR_INVALID_DATA;
+        if (('L' == chTag || 'Q' == chTag) && (!pComponent || 0 != _stricmp(szKey, pComponent->szComponent)))
+            return ERROR_INVALID_DATA;
+
+        switch (chTag)
+        {
+            case 'P':
+            {
+                if (lstrlen(szKey) >= CCHGuid)
+                    return ERROR_INVALID_DATA;
+                pProduct = &m_rgProduct[m_cProducts];
+                pProduct->szProduct = szKey;
+                bool fEnumerated = (0 != ReadNumber(&Reader));
+                pProduct->isState = (INSTALLSTATE) ReadState(&Reader, INSTALLSTATE_NOTUSED, INSTALLSTATE_DEFAULT);
+                pProduct->uisUser = USERINFOSTATE_UNKNOWN;
+                pProduct->szUser = pProduct->szOrganization = pProduct->szSerial = TEXT("");
+                pProduct->iFirstInfo = iInfo;
+                pProduct->iFirstFeature = iFeature;
+                pProduct->iFirstPatch = iPatch;
+
+                // MsiEnumProducts order is the order of the enumerated records, which come first.
+                if (fEnumerated && (m_cEnumeratedProducts++ != m_cProducts))
+                    return ERROR_INVALID_DATA;
+                if (!SetStringMapValue(&m_ProductMap, szKey, m_cProducts))
+                    return ERROR_NOT_ENOUGH_MEMORY;
+                m_cProducts++;
+                break;
+            }
+            case 'I':
+            {
+                REPLAYINFO* pInfo = &m_rgInfo[iInfo++];
+                pInfo->szProperty = ReadString(&Reader);
+                pInfo->uiResult = (UINT) ReadNumber(&Reader);
+                pInfo->szValue = ReadString(&Reader);
+                pProduct->cInfo++;
+                break;
+            }
+            case 'U':
+                pProduct->uisUser = (USERINFOSTATE) ReadState(&Reader, USERINFOSTATE_MOREDATA, USERINFOSTATE_PRESENT);
+                pProduct->szUser = ReadString(&Reader);
+                pProduct->szOrganization = ReadString(&Reader);
+                pProduct->szSerial = ReadString(&Reader);
+                break;
+            case 'F':
+            {
+                REPLAYFEATURE* pFeature = &m_rgFeature[iFeature++];
+                pFeature->szFeature = ReadString(&Reader);
+                pFeature->szParent = ReadString(&Reader);
+                pFeature->isState = (INSTALLSTATE) ReadState(&Reader, INSTALLSTATE_NOTUSED, INSTALLSTATE_DEFAULT);
+                pFeature->uiUsageResult = (UINT) ReadNumber(&Reader);
+                pFeature->dwUseCount = (DWORD) ReadNumber(&Reader);
+                pFeature->wDateUsed = (WORD) ReadNumber(&Reader);
+                if ((lstrlen(pFeature->szFeature) > MAX_FEATURE_CHARS) || (lstrlen(pFeature->szParent) > MAX_FEATURE_CHARS))
+                    return ERROR_INVALID_DATA;
+                pProduct->cFeatures++;
+                break;
+            }
+            case 'X':
+            {
+                REPLAYPATCH* pPatch = &m_rgPatch[iPatch++];
+                pPatch->szPatch = ReadString(&Reader);
+                pPatch->szTransforms = ReadString(&Reader);
+                if (lstrlen(pPatch->szPatch) >= CCHGuid)
+                    return ERROR_INVALID_DATA;
+                pProduct->cPatches++;
+                break;
+            }
+            case 'C':
+                if (lstrlen(szKey) >= CCHGuid)
+                    return ERROR_INVALID_DATA;
+                pComponent = &m_rgComponent[m_cComponents];
+                pComponent->szComponent = szKey;
+                pComponent->iFirstClient = iClient;
+                pComponent->iFirstQualifier = iQualifier;
+                if (!SetStringMapValue(&m_ComponentMap, szKey, m_cComponents))
+                    return ERROR_NOT_ENOUGH_MEMORY;
+                m_cComponents++;
+                break;
+            case 'L':
+            {
+                REPLAYCLIENT* pClient = &m_rgClient[iClient++];
+                pClient->szClient = ReadString(&Reader);
+                pClient->isPath = (INSTALLSTATE) ReadState(&Reader, INSTALLSTATE_NOTUSED, INSTALLSTATE_DEFAULT);
+                pClient->szPath = ReadString(&Reader);
+                if (lstrlen(pClient->szClient) >= CCHGuid)
+                    return ERROR_INVALID_DATA;
+                MakeGuidKey(pClient->szClient, &pClient->ClientKey);
+                pComponent->cClients++;
+                break;
+            }
+            case 'Q':
+            {
+                REPLAYQUALIFIER* pQualifier = &m_rgQualifier[iQualifier++];
+                pQualifier->szQualifier = ReadString(&Reader);
+                pQualifier->szApplicationData = ReadString(&Reader);
+                pComponent->cQualifiers++;
+                break;
+            }
+            case 'K':
+            {
+                KEYPATHPROBE* pProbe = &m_rgProbe[iProbe];
+                pProbe->fRegistry = (0 != ReadNumber(&Reader));
+                pProbe->fRegistryRoot = (0 != ReadNumber(&Reader));
+                pProbe->dwRegistryError = (DWORD) ReadNumber(&Reader);
+                pProbe->fLastWriteTime = (0 != ReadNumber(&Reader));
+                pProbe->dwAttributes = (DWORD) ReadNumber(&Reader);
+                pProbe->fExtendedAttributes = (0 != ReadNumber(&Reader));
+                pProbe->nFileSizeHigh = (DWORD) ReadNumber(&Reader);
+                pProbe->nFileSizeLow = (DWORD) ReadNumber(&Reader);
+                Int64ToFileTime(ReadNumber(&Reader), &pProbe->ftCreationTime);
+                pProbe->uiVersionResult = (UINT) ReadNumber(&Reader);
+                ReadFixedString(&Reader, pProbe->szVersion, CCHKeyPathVersion);
+                ReadFixedString(&Reader, pProbe->szLanguage, CCHKeyPathVersion);
+                pProbe->fBinaryType = (0 != ReadNumber(&Reader));
+                pProbe->dwBinaryType = (DWORD) ReadNumber(&Reader);
+                Int64ToFileTime(ReadNumber(&Reader), &pProbe->ftLastWriteTime);
+                pProbe->osOwner = (OWNERSTATE) ReadState(&Reader, osNotRead, osResolved);
+                pProbe->dwOwnerError = (DWORD) ReadNumber(&Reader);
+                ReadFixedString(&Reader, pProbe->szOwner, CCHKeyPathOwner);
+                if (!SetStringMapValue(&m_KeyPathMap, szKey, iProbe))
+                    return ERROR_NOT_ENOUGH_MEMORY;
+                iProbe++;
+                break;
+            }
+            default:
+                return ERROR_INVALID_DATA;
+        }
+
+        if (Reader.fBad)
+            return ERROR_INVALID_DATA;
+    }
+
+    return ERROR_SUCCESS;
+}
+
+const REPLAYPRODUCT* CReplayInstallerData::FindProduct(const TCHAR* szProduct)
+{
+    DWORD iProduct = 0;
+    if (!szProduct || !FindStringMapValue(&m_ProductMap, szProduct, &iProduct))
+        return NULL;
+    return &m_rgProduct[iProduct];
+}
+
+const REPLAYCOMPONENT* CReplayInstallerData::FindComponent(const TCHAR* szComponent)
+{
+    DWORD iComponent = 0;
+    if (!szComponent || !FindStringMapValue(&m_ComponentMap, szComponent, &iComponent))
+        return NULL;
+    return &m_rgComponent[iComponent];
+}
+
+const REPLAYFEATURE* CReplayInstallerData::FindFeature(const TCHAR* szProduct, const TCHAR* szFeature)
+{
+    const REPLAYPRODUCT* pProduct = FindProduct(szProduct);
+    if (!pProduct)
+        return NULL;
+
+    // feature names are case-sensitive.  No last-feature hint: -j asks from
+    // several threads at once, and a product has few features.
+    const REPLAYFEATURE* pFeatures = &m_rgFeature[pProduct->iFirstFeature];
+    for (DWORD iFeature = 0; iFeature < pProduct->cFeatures; iFeature++)
+    {
+        if (0 == strcmp(pFeatures[iFeature].szFeature, szFeature))
+            return &pFeatures[iFeature];
+    }
+    return NULL;
+}
+
+UINT CReplayInstallerData::EnumProducts(DWORD iProductIndex, TCHAR* lpProductBuf)
+{
+    if (iProductIndex >= m_cEnumeratedProducts)
+        return ERROR_NO_MORE_ITEMS;
+
+    lstrcpy(lpProductBuf, m_rgProduct[iProductIndex].szProduct);
+    return ERROR_SUCCESS;
+}
+
+INSTALLSTATE CReplayInstallerData::QueryProductState(const TCHAR* szProduct)
+{
+    const REPLAYPRODUCT* pProduct = FindProduct(szProduct);
+    return (pProduct) ? pProduct->isState : INSTALLSTATE_UNKNOWN;
+}
+
+UINT CReplayInstallerData::GetProductInfo(const TCHAR* szProduct, const TCHAR* szAttribute, TCHAR* lpValueBuf, DWORD* pcchValueBuf)
+{
+    const REPLAYPRODUCT* pProduct = FindProduct(szProduct);
+    if (!pProduct)
+        return ERROR_UNKNOWN_PRODUCT;
+
+    const REPLAYINFO* pInfo = &m_rgInfo[pProduct->iFirstInfo];
+    for (DWORD iInfo = 0; iInfo < pProduct->cInfo; iInfo++, pInfo++)
+    {
+        if (0 != lstrcmpi(pInfo->szProperty, szAttribute))
+            continue;
+
+        if (ERROR_SUCCESS != pInfo->uiResult && ERROR_MORE_DATA != pInfo->uiResult)
+            return pInfo->uiResult;
+
+        UINT uiResult = CopyInstallerString(pInfo->szValue, lpValueBuf, pcchValueBuf);
+        return (ERROR_SUCCESS == uiResult) ? pInfo->uiResult : uiResult;
+    }
+    return ERROR_UNKNOWN_PROPERTY;
+}
+
+USERINFOSTATE CReplayInstallerData::GetUserInfo(const TCHAR* szProduct, TCHAR* lpUserNameBuf, DWORD* pcchUserNameBuf,
+                                                TCHAR* lpOrgNameBuf, DWORD* pcchOrgNameBuf, TCHAR* lpSerialBuf, DWORD* pcchSerialBuf)
+{
+    const REPLAYPRODUCT* pProduct = FindProduct(szProduct);
+    if (!pProduct)
+        return USERINFOSTATE_UNKNOWN;
+
+    if (USERINFOSTATE_PRESENT != pProduct->uisUser && USERINFOSTATE_MOREDATA != pProduct->uisUser)
+        return pProduct->uisUser;
+
+    bool fMoreData = (USERINFOSTATE_MOREDATA == pProduct->uisUser);
+    fMoreData |= (ERROR_MORE_DATA == CopyInstallerString(pProduct->szUser, lpUserNameBuf, pcchUserNameBuf));
+    fMoreData |= (ERROR_MORE_DATA == CopyInstallerString(pProduct->szOrganization, lpOrgNameBuf, pcchOrgNameBuf));
+    fMoreData |= (ERROR_MORE_DATA == CopyInstallerString(pProduct->szSerial, lpSerialBuf, pcchSerialBuf));
+
+    return fMoreData ? USERINFOSTATE_MOREDATA : USERINFOSTATE_PRESENT;
+}
+
+UINT CReplayInstallerData::EnumFeatures(const TCHAR* szProduct, DWORD iFeatureIndex, TCHAR* lpFeatureBuf, TCHAR* lpParentBuf)
+{
+    const REPLAYPRODUCT* pProduct = FindProduct(szProduct);
+    if (!pProduct)
+        return ERROR_UNKNOWN_PRODUCT;
+    if (iFeatureIndex >= pProduct->cFeatures)
+        return ERROR_NO_MORE_ITEMS;
+
+    const REPLAYFEATURE* pFeature = &m_rgFeature[pProduct->iFirstFeature + iFeatureIndex];
+    lstrcpy(lpFeatureBuf, pFeature->szFeature);
+    lstrcpy(lpParentBuf, pFeature->szParent);
+    return ERROR_SUCCESS;
+}
+
+INSTALLSTATE CReplayInstallerData::QueryFeatureState(const TCHAR* szProduct, const TCHAR* szFeature)
+{
+    const REPLAYFEATURE* pFeature = FindFeature(szProduct, szFeature);
+    return (pFeature) ? pFeature->isState : INSTALLSTATE_UNKNOWN;
+}
+
+UINT CReplayInstallerData::GetFeatureUsage(const TCHAR* szProduct, const TCHAR* szFeature, DWORD* pdwUseCount, WORD* pwDateUsed)
+{
+    if (!FindProduct(szProduct))
+        return ERROR_UNKNOWN_PRODUCT;
+
+    const REPLAYFEATURE* pFeature = FindFeature(szProduct, szFeature);
+    if (!pFeature)
+        return ERROR_UNKNOWN_FEATURE;
+
+    if (ERROR_SUCCESS == pFeature->uiUsageResult)
+    {
+        *pdwUseCount = pFeature->dwUseCount;
+        *pwDateUsed = pFeature->wDateUsed;
+    }
+    return pFeature->uiUsageResult;
+}
+
+UINT CReplayInstallerData::EnumComponents(DWORD iComponentIndex, TCHAR* lpComponentBuf)
+{
+    if (iComponentIndex >= m_cComponents)
+        return ERROR_NO_MORE_ITEMS;
+
+    lstrcpy(lpComponentBuf, m_rgComponent[iComponentIndex].szComponent);
+    return ERROR_SUCCESS;
+}
+
+UINT CReplayInstallerData::EnumClients(const TCHAR* szComponent, DWORD iProductIndex, TCHAR* lpProductBuf)
+{
+    const REPLAYCOMPONENT* pComponent = FindComponent(szComponent);
+    if (!pComponent)
+        return ERROR_UNKNOWN_COMPONENT;
+    if (iProductIndex >= pComponent->cClients)
+        return ERROR_NO_MORE_ITEMS;
+
+    lstrcpy(lpProductBuf, m_rgClient[pComponent->iFirstClient + iProductIndex].szClient);
+    return ERROR_SUCCESS;
+}
+
+INSTALLSTATE CReplayInstallerData::GetComponentPath(const TCHAR* szProduct, const TCHAR* szComponent, TCHAR* lpPathBuf, DWORD* pcchBuf)
+{
+    const REPLAYCOMPONENT* pComponent = FindComponent(szComponent);
+    if (!pComponent || !szProduct)
+        return INSTALLSTATE_UNKNOWN;
+
+    GUIDKEY ProductKey;
+    MakeGuidKey(szProduct, &ProductKey);
+
+    const REPLAYCLIENT* pClient = &m_rgClient[pComponent->iFirstClient];
+    for (DWORD iClient = 0; iClient < pComponent->cClients; iClient++, pClient++)
+    {
+        if (!IsEqualGuidKey(pClient->ClientKey, ProductKey))
+            continue;
+
+        if (ERROR_MORE_DATA == CopyInstallerString(pClient->szPath, lpPathBuf, pcchBuf))
+            return INSTALLSTATE_MOREDATA;
+        return pClient->isPath;
+    }
+    return INSTALLSTATE_UNKNOWN;
+}
+
+UINT CReplayInstallerData::EnumComponentQualifiers(const TCHAR* szComponent, DWORD iIndex, TCHAR* lpQualifierBuf, DWORD* pcchQualifierBuf,
+                                                   TCHAR* lpApplicationDataBuf, DWORD* pcchApplicationDataBuf)
+{
+    const REPLAYCOMPONENT* pComponent = FindComponent(szComponent);
+    if (!pComponent)
+        return ERROR_UNKNOWN_COMPONENT;
+    if (iIndex >= pComponent->cQualifiers)
+        return ERROR_NO_MORE_ITEMS;
+
+    const REPLAYQUALIFIER* pQualifier = &m_rgQualifier[pComponent->iFirstQualifier + iIndex];
+    bool fMoreData = false;
+    fMoreData |= (ERROR_MORE_DATA == CopyInstallerString(pQualifier->szQualifier, lpQualifierBuf, pcchQualifierBuf));
+    fMoreData |= (ERROR_MORE_DATA == CopyInstallerString(pQualifier->szApplicationData, lpApplicationDataBuf, pcchApplicationDataBuf));
+    return fMoreData ? ERROR_MORE_DATA : ERROR_SUCCESS;
+}
+
+UINT CReplayInstallerData::EnumPatches(const TCHAR* szProduct, DWORD iPatchIndex, TCHAR* lpPatchBuf, TCHAR* lpTransformsBuf, DWORD* pcchTransformsBuf)
+{
+    const REPLAYPRODUCT* pProduct = FindProduct(szProduct);
+    if (!pProduct)
+        return ERROR_UNKNOWN_PRODUCT;
+    if (iPatchIndex >= pProduct->cPatches)
+        return ERROR_NO_MORE_ITEMS;
+
+    const REPLAYPATCH* pPatch = &m_rgPatch[pProduct->iFirstPatch + iPatchIndex];
+    lstrcpy(lpPatchBuf, pPatch->szPatch);
+    return CopyInstallerString(pPatch->szTransforms, lpTransformsBuf, pcchTransformsBuf);
+}
+
+// a path nobody recorded was never a keypath on that machine; it reads as missing.
+void CReplayInstallerData::ProbeKeyPath(const TCHAR* szKeyPath, KEYPATHPROBE* pProbe)
+{
+    DWORD iProbe = 0;
+    if (szKeyPath && FindStringMapValue(&m_KeyPathMap, szKeyPath, &iProbe))
+    {
+        *pProbe = m_rgProbe[iProbe];
+        return;
+    }
+
+    InitKeyPathProbe(pProbe);
+    pProbe->fRegistry = (szKeyPath && IsRegistryKeyPath(szKeyPath));
+}
@@ -0,0 +1,147 @@
+/*---------------------------------------------------------------------------
+Recorded snapshots.
+
+    -record walks a provider once and writes every answer the report can
+    ask for to a text file; -replay reports from that file on any machine.
+    Replaying a snapshot produces the same report the recorded machine
+    did, so field captures can be profiled and compared off-box.
+
+    Format: one record per line, tab-separated fields.  Tab, CR, LF and
+    '%' inside a field are written as %09, %0D, %0A and %25.  Numbers are
+    decimal; FILETIMEs are one 64-bit tick count.
+
+        MSIINV-SNAPSHOT 1
+        P  product  enumerated  state                  product (MsiEnumProducts order first)
+        I  product  property  result  value            MsiGetProductInfo
+        U  product  state  user  organization  serial  MsiGetUserInfo
+        F  product  feature  parent  state  usage-result  use-count  date-used
+        X  product  patch  transforms
+        C  component                                   MsiEnumComponents order
+        L  component  client  state  path              client, MsiGetComponentPath
+        Q  component  qualifier  application-data
+        K  keypath  <KEYPATHPROBE fields in declaration order>
+
+    I, U, F and X follow their P; L and Q follow their C.  Products that
+    only show up as component clients are recorded with enumerated = 0 so
+    the orphan report can still look up their names.  Strings are asked
+    for at whatever length the installer reports (infoquery.h) and
+    recorded whole; replay hands them back with ERROR_MORE_DATA to a
+    caller whose buffer is too short, as the installer would.
+---------------------------------------------------------------------------*/
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "installerdata.h"
+#include "strmap.h"
+#include "guidkey.h"
+
+UINT CaptureInventory(CInstallerData* pSource, const TCHAR* szFile);
+
+struct REPLAYINFO {
+    const TCHAR*    szProperty;
+    UINT            uiResult;
+    const TCHAR*    szValue;
+};
+
+struct REPLAYFEATURE {
+    const TCHAR*    szFeature;
+    const TCHAR*    szParent;
+    INSTALLSTATE    isState;
+    UINT            uiUsageResult;
+    DWORD           dwUseCount;
+    WORD            wDateUsed;
+};
+
+struct REPLAYPATCH {
+    const TCHAR*    szPatch;
+    const TCHAR*    szTransforms;
+};
+
+struct REPLAYPRODUCT {
+    const TCHAR*    szProduct;
+    INSTALLSTATE    isState;
+    USERINFOSTATE   uisUser;
+    const TCHAR*    szUser;
+    const TCHAR*    szOrganization;
+    const TCHAR*    szSerial;
+    DWORD           iFirstInfo,     cInfo;
+    DWORD           iFirstFeature,  cFeatures;
+    DWORD           iFirstPatch,    cPatches;
+};
+
+struct REPLAYCLIENT {
+    const TCHAR*    szClient;
+    GUIDKEY         ClientKey;
+    INSTALLSTATE    isPath;
+    const TCHAR*    szPath;
+};
+
+struct REPLAYQUALIFIER {
+    const TCHAR*    szQualifier;
+    const TCHAR*    szApplicationData;
+};
+
+struct REPLAYCOMPONENT {
+    const TCHAR*    szComponent;
+    DWORD           iFirstClient,   cClients;
+    DWORD           iFirstQualifier, cQualifiers;
+};
+
+class CReplayInstallerData : public CInstallerData
+{
+public:
+    CReplayInstallerData();
+    ~CReplayInstallerData();
+
+    // reads the whole file and indexes it in place.  ERROR_FILE_NOT_FOUND,
+    // ERROR_NOT_ENOUGH_MEMORY, or ERROR_INVALID_DATA for a malformed snapshot.
+    UINT          Load(const TCHAR* szFile);
+
+    UINT          EnumProducts(DWORD iProductIndex, TCHAR* lpProductBuf);
+    INSTALLSTATE  QueryProductState(const TCHAR* szProduct);
+    UINT          GetProductInfo(const TCHAR* szProduct, const TCHAR* szAttribute, TCHAR* lpValueBuf, DWORD* pcchValueBuf);
+    USERINFOSTATE GetUserInfo(const TCHAR* szProduct, TCHAR* lpUserNameBuf, DWORD* pcchUserNameBuf,
+                              TCHAR* lpOrgNameBuf, DWORD* pcchOrgNameBuf, TCHAR* lpSerialBuf, DWORD* pcchSerialBuf);
+
+    UINT          EnumFeatures(const TCHAR* szProduct, DWORD iFeatureIndex, TCHAR* lpFeatureBuf, TCHAR* lpParentBuf);
+    INSTALLSTATE  QueryFeatureState(const TCHAR* szProduct, const TCHAR* szFeature);
+    UINT          GetFeatureUsage(const TCHAR* szProduct, const TCHAR* szFeature, DWORD* pdwUseCount, WORD* pwDateUsed);
+
+    UINT          EnumComponents(DWORD iComponentIndex, TCHAR* lpComponentBuf);
+    UINT          EnumClients(const TCHAR* szComponent, DWORD iProductIndex, TCHAR* lpProductBuf);
+    INSTALLSTATE  GetComponentPath(const TCHAR* szProduct, const TCHAR* szComponent, TCHAR* lpPathBuf, DWORD* pcchBuf);
+    UINT          EnumComponentQualifiers(const TCHAR* szComponent, DWORD iIndex, TCHAR* lpQualifierBuf, DWORD* pcchQualifierBuf,
+                                          TCHAR* lpApplicationDataBuf, DWORD* pcchApplicationDataBuf);
+
+    UINT          EnumPatches(const TCHAR* szProduct, DWORD iPatchIndex, TCHAR* lpPatchBuf, TCHAR* lpTransformsBuf, DWORD* pcchTransformsBuf);
+
+    void          ProbeKeyPath(const TCHAR* szKeyPath, KEYPATHPROBE* pProbe);
+
+private:
+    void Free();
+    UINT Parse();
+    const REPLAYPRODUCT*   FindProduct(const TCHAR* szProduct);
+    const REPLAYCOMPONENT* FindComponent(const TCHAR* szComponent);
+    const REPLAYFEATURE*   FindFeature(const TCHAR* szProduct, const TCHAR* szFeature);
+
+    TCHAR*              m_pchText;          // the file; every string points into it
+
+    REPLAYPRODUCT*      m_rgProduct;
+    DWORD               m_cProducts;
+    DWORD               m_cEnumeratedProducts;
+    REPLAYINFO*         m_rgInfo;
+    REPLAYFEATURE*      m_rgFeature;
+    REPLAYPATCH*        m_rgPatch;
+    REPLAYCOMPONENT*    m_rgComponent;
+    DWORD               m_cComponents;
+    REPLAYCLIENT*       m_rgClient;
+    REPLAYQUALIFIER*    m_rgQualifier;
+    KEYPATHPROBE*       m_rgProbe;
+
+    STRINGMAP           m_ProductMap;       // -> m_rgProduct
+    STRINGMAP           m_ComponentMap;     // -> m_rgComponent
+    STRINGMAP           m_KeyPathMap;       // -> m_rgProbe
+};
+
+#endif // REPLAY_H
@@ -0,0 +1,347 @@
+/*---------------------------------------------------------------------------
+Snapshot diff - see snapdiff.h.
+---------------------------------------------------------------------------*/
+
+#include "snapdiff.h"
+#include "binsnap.h"
+#include "strmap.h"
+#include "outsink.h"
+#include <stdio.h>
+#include <string.h>
+
+#define Pluralize(X) ((1 == X) ? TEXT("") : TEXT("s"))
+
+struct SNAPSHOTDIFF {
+    const CBinarySnapshot*  pOld;
+    const CBinarySnapshot*  pNew;
+    DWORD                   cProductsAdded;
+    DWORD                   cProductsRemoved;
+    DWORD                   cFeatureChanges;
+    DWORD                   cNewOrphans;
+    DWORD                   cKeyPathChanges;
+    bool                    fOutOfMemory;
+};
+
+// for (iOld, iNew) row pairs; BINSNAPNone on the side that lacks the code.
+typedef void (*PFNJOINROW)(SNAPSHOTDIFF* pDiff, DWORD iOld, DWORD iNew);
+
+// one pass over both sorted columns.
+static void MergeJoinByCode(SNAPSHOTDIFF* pDiff, BINSNAPCOLUMN bcByCode, BINSNAPCOLUMN bcCode, PFNJOINROW pfnJoinRow)
+{
+    const CBinarySnapshot& Old = *pDiff->pOld;
+    const CBinarySnapshot& New = *pDiff->pNew;
+    const DWORD* rgiOldByCode = Old.Column(bcByCode);
+    const DWORD* rgiNewByCode = New.Column(bcByCode);
+    const DWORD* rgibOldCode = Old.Column(bcCode);
+    const DWORD* rgibNewCode = New.Column(bcCode);
+    DWORD cOld = Old.Rows(bcByCode);
+    DWORD cNew = New.Rows(bcByCode);
+
+    DWORD iOldSorted = 0;
+    DWORD iNewSorted = 0;
+    while (iOldSorted < cOld || iNewSorted < cNew)
+    {
+        DWORD iOld = (iOldSorted < cOld) ? rgiOldByCode[iOldSorted] : BINSNAPNone;
+        DWORD iNew = (iNewSorted < cNew) ? rgiNewByCode[iNewSorted] : BINSNAPNone;
+        if (iOld >= Old.Rows(bcCode))
+            iOld = BINSNAPNone;
+        if (iNew >= New.Rows(bcCode))
+            iNew = BINSNAPNone;
+
+        int iCompare;
+        if (BINSNAPNone == iOld && BINSNAPNone == iNew)
+        {
+            // a corrupt row number on both sides; skip the pair.
+            iOldSorted++;
+            iNewSorted++;
+            continue;
+        }
+        else if (BINSNAPNone == iOld)
+            iCompare = 1;
+        else if (BINSNAPNone == iNew)
+            iCompare = -1;
+        else
+            iCompare = _stricmp(Old.String(rgibOldCode[iOld]), New.String(rgibNewCode[iNew]));
+
+        if (iCompare < 0)
+        {
+            pfnJoinRow(pDiff, iOld, BINSNAPNone);
+            iOldSorted++;
+        }
+        else if (iCompare > 0)
+        {
+            pfnJoinRow(pDiff, BINSNAPNone, iNew);
+            iNewSorted++;
+        }
+        else
+        {
+            pfnJoinRow(pDiff, iOld, iNew);
+            iOldSorted++;
+            iNewSorted++;
+        }
+    }
+}
+
+static const TCHAR* SZStateShort(DWORD dwState)
+{
+    switch ((INSTALLSTATE) (int) dwState)
+    {
+        case INSTALLSTATE_NOTUSED:      return TEXT("not used");
+        case INSTALLSTATE_BADCONFIG:    return TEXT("bad config");
+        case INSTALLSTATE_INCOMPLETE:   return TEXT("incomplete");
+        case INSTALLSTATE_SOURCEABSENT: return TEXT("source absent");
+        case INSTALLSTATE_MOREDATA:     return TEXT("more data");
+        case INSTALLSTATE_INVALIDARG:   return TEXT("invalid arg");
+        case INSTALLSTATE_UNKNOWN:      return TEXT("unknown");
+        case INSTALLSTATE_BROKEN:       return TEXT("broken");
+        case INSTALLSTATE_ADVERTISED:   return TEXT("advertised");
+        case INSTALLSTATE_ABSENT:       return TEXT("absent");
+        case INSTALLSTATE_LOCAL:        return TEXT("local");
+        case INSTALLSTATE_SOURCE:       return TEXT("source");
+        case INSTALLSTATE_DEFAULT:      return TEXT("default");
+        default:                        return TEXT("error");
+    }
+}
+
+static const TCHAR* ProductName(const CBinarySnapshot& Snapshot, DWORD iProduct)
+{
+    const TCHAR* szName = Snapshot.String(Snapshot.Column((BINSNAPCOLUMN) (bcProductProperty + ipProductName))[iProduct]);
+    return (szName) ? szName : TEXT("");
+}
+
+//____________________________________________________________________________
+//
+// Products
+//____________________________________________________________________________
+
+static void DiffFeatures(SNAPSHOTDIFF* pDiff, DWORD iOld, DWORD iNew)
+{
+    const CBinarySnapshot& Old = *pDiff->pOld;
+    const CBinarySnapshot& New = *pDiff->pNew;
+    const TCHAR* szProduct = New.String(New.Column(bcProductCode)[iNew]);
+
+    DWORD iOldFirst = Old.Column(bcProductFirstFeature)[iOld];
+    DWORD cOldFeatures = Old.Column(bcProductFeatureCount)[iOld];
+    DWORD iNewFirst = New.Column(bcProductFirstFeature)[iNew];
+    DWORD cNewFeatures = New.Column(bcProductFeatureCount)[iNew];
+    if ((unsigned __int64) iOldFirst + cOldFeatures > Old.Rows(bcFeatureName))
+        cOldFeatures = 0;
+    if ((unsigned __int64) iNewFirst + cNewFeatures > New.Rows(bcFeatureName))
+        cNewFeatures = 0;
+
+    const DWORD* rgibOldName = Old.Column(bcFeatureName);
+    const DWORD* rgibNewName = New.Column(bcFeatureName);
+    const DWORD* rgdwOldState = Old.Column(bcFeatureState);
+    const DWORD* rgdwNewState = New.Column(bcFeatureState);
+
+    // feature names are case-sensitive; the keys live in the mapped view.
+    STRINGMAP OldFeatures;
+    if (!InitStringMap(&OldFeatures, cOldFeatures, true))
+    {
+        pDiff->fOutOfMemory = true;
+        return;
+    }
+    for (DWORD iFeature = iOldFirst; iFeature < iOldFirst + cOldFeatures; iFeature++)
+    {
+        if (!SetStringMapValue(&OldFeatures, Old.String(rgibOldName[iFeature]), iFeature))
+            pDiff->fOutOfMemory = true;
+    }
+
+    // old features are marked off as they are matched; what is left was removed.
+    DWORD cMatched = 0;
+    for (DWORD iFeature = iNewFirst; iFeature < iNewFirst + cNewFeatures; iFeature++)
+    {
+        const TCHAR* szFeature = New.String(rgibNewName[iFeature]);
+        DWORD iOldFeature;
+        if (!FindStringMapValue(&OldFeatures, szFeature, &iOldFeature))
+        {
+            g_Out.Printf(TEXT("Product %s feature %s added (%s)\n"), szProduct, szFeature, SZStateShort(rgdwNewState[iFeature]));
+            pDiff->cFeatureChanges++;
+            continue;
+        }
+
+        cMatched++;
+        SetStringMapValue(&OldFeatures, szFeature, BINSNAPNone);
+        if (BINSNAPNone != iOldFeature && rgdwOldState[iOldFeature] != rgdwNewState[iFeature])
+        {
+            g_Out.Printf(TEXT("Product %s feature %s: %s -> %s\n"), szProduct, szFeature,
+                SZStateShort(rgdwOldState[iOldFeature]), SZStateShort(rgdwNewState[iFeature]));
+            pDiff->cFeatureChanges++;
+        }
+    }
+
+    if (cMatched < OldFeatures.cEntries)
+    {
+        for (DWORD iFeature = iOldFirst; iFeature < iOldFirst + cOldFeatures; iFeature++)
+        {
+            DWORD iOldFeature;
+            const TCHAR* szFeature = Old.String(rgibOldName[iFeature]);
+            if (FindStringMapValue(&OldFeatures, szFeature, &iOldFeature) && iOldFeature == iFeature)
+            {
+                g_Out.Printf(TEXT("Product %s feature %s removed\n"), szProduct, szFeature);
+                pDiff->cFeatureChanges++;
+            }
+        }
+    }
+    FreeStringMap(&OldFeatures);
+}
+
+static void DiffProduct(SNAPSHOTDIFF* pDiff, DWORD iOld, DWORD iNew)
+{
+    if (BINSNAPNone == iOld)
+    {
+        g_Out.Printf(TEXT("Product %s added: %s\n"), pDiff->pNew->String(pDiff->pNew->Column(bcProductCode)[iNew]), ProductName(*pDiff->pNew, iNew));
+        pDiff->cProductsAdded++;
+    }
+    else if (BINSNAPNone == iNew)
+    {
+        g_Out.Printf(TEXT("Product %s removed: %s\n"), pDiff->pOld->String(pDiff->pOld->Column(bcProductCode)[iOld]), ProductName(*pDiff->pOld, iOld));
+        pDiff->cProductsRemoved++;
+    }
+    else
+    {
+        DiffFeatures(pDiff, iOld, iNew);
+    }
+}
+
+//____________________________________________________________________________
+//
+// Components
+//____________________________________________________________________________
+
+// first client row, with the count clipped to the table.
+static DWORD ComponentClients(const CBinarySnapshot& Snapshot, DWORD iComponent, DWORD* pcClients)
+{
+    DWORD iFirst = Snapshot.Column(bcComponentFirstClient)[iComponent];
+    DWORD cClients = Snapshot.Column(bcComponentClientCount)[iComponent];
+    if ((unsigned __int64) iFirst + cClients > Snapshot.Rows(bcClientCode))
+        cClients = 0;
+    *pcClients = cClients;
+    return iFirst;
+}
+
+// like the -x report: no client is an enumerated product.
+static bool IsOrphaned(const CBinarySnapshot& Snapshot, DWORD iComponent)
+{
+    DWORD cClients;
+    DWORD iFirst = ComponentClients(Snapshot, iComponent, &cClients);
+    const DWORD* rgiProduct = Snapshot.Column(bcClientProduct);
+    for (DWORD iClient = iFirst; iClient < iFirst + cClients; iClient++)
+    {
+        if (BINSNAPNone != rgiProduct[iClient])
+            return false;
+    }
+    return true;
+}
+
+static const TCHAR* KeyPathVersion(const CBinarySnapshot& Snapshot, DWORD iClient)
+{
+    DWORD iProbe = Snapshot.Column(bcClientProbe)[iClient];
+    if (iProbe >= Snapshot.Rows(bcProbeKeyPath) || ERROR_SUCCESS != Snapshot.Column(bcProbeVersionResult)[iProbe])
+        return TEXT("");
+    const TCHAR* szVersion = Snapshot.String(Snapshot.Column(bcProbeVersion)[iProbe]);
+    return (szVersion) ? szVersion : TEXT("");
+}
+
+static void DiffKeyPathVersions(SNAPSHOTDIFF* pDiff, DWORD iOld, DWORD iNew)
+{
+    const CBinarySnapshot& Old = *pDiff->pOld;
+    const CBinarySnapshot& New = *pDiff->pNew;
+    const TCHAR* szComponent = New.String(New.Column(bcComponentCode)[iNew]);
+
+    DWORD cOldClients;
+    DWORD cNewClients;
+    DWORD iOldFirst = ComponentClients(Old, iOld, &cOldClients);
+    DWORD iNewFirst = ComponentClients(New, iNew, &cNewClients);
+    const DWORD* rgibOldClient = Old.Column(bcClientCode);
+    const DWORD* rgibNewClient = New.Column(bcClientCode);
+
+    // client codes are matched without case; the first old client with a code wins.
+    STRINGMAP OldClients;
+    if (!InitStringMap(&OldClients, cOldClients, false))
+    {
+        pDiff->fOutOfMemory = true;
+        return;
+    }
+    for (DWORD iOldClient = iOldFirst; iOldClient < iOldFirst + cOldClients; iOldClient++)
+    {
+        DWORD iFirst;
+        const TCHAR* szClient = Old.String(rgibOldClient[iOldClient]);
+        if (!FindStringMapValue(&OldClients, szClient, &iFirst) && !SetStringMapValue(&OldClients, szClient, iOldClient))
+            pDiff->fOutOfMemory = true;
+    }
+
+    for (DWORD iNewClient = iNewFirst; iNewClient < iNewFirst + cNewClients; iNewClient++)
+    {
+        const TCHAR* szClient = New.String(rgibNewClient[iNewClient]);
+        DWORD iOldClient;
+        if (!FindStringMapValue(&OldClients, szClient, &iOldClient))
+            continue;
+
+        const TCHAR* szOldVersion = KeyPathVersion(Old, iOldClient);
+        const TCHAR* szNewVersion = KeyPathVersion(New, iNewClient);
+        if (0 != strcmp(szOldVersion, szNewVersion))
+        {
+            g_Out.Printf(TEXT("Component %s keypath version for %s: %s -> %s\n"), szComponent, szClient,
+                (*szOldVersion) ? szOldVersion : TEXT("(none)"), (*szNewVersion) ? szNewVersion : TEXT("(none)"));
+            pDiff->cKeyPathChanges++;
+        }
+    }
+    FreeStringMap(&OldClients);
+}
+
+static void DiffComponent(SNAPSHOTDIFF* pDiff, DWORD iOld, DWORD iNew)
+{
+    if (BINSNAPNone == iNew)
+        return;
+
+    if (IsOrphaned(*pDiff->pNew, iNew) && (BINSNAPNone == iOld || !IsOrphaned(*pDiff->pOld, iOld)))
+    {
+        g_Out.Printf(TEXT("Component %s is newly orphaned\n"), pDiff->pNew->String(pDiff->pNew->Column(bcComponentCode)[iNew]));
+        pDiff->cNewOrphans++;
+    }
+
+    if (BINSNAPNone != iOld)
+        DiffKeyPathVersions(pDiff, iOld, iNew);
+}
+
+//____________________________________________________________________________
+
+int DiffSnapshots(const TCHAR* szOldFile, const TCHAR* szNewFile)
+{
+    CBinarySnapshot Old;
+    CBinarySnapshot New;
+    UINT uiResult = Old.Open(szOldFile);
+    if (ERROR_SUCCESS != uiResult)
+    {
+        fprintf(stderr, TEXT("Cannot read snapshot %s: %d\n"), szOldFile, uiResult);
+        return 1;
+    }
+    uiResult = New.Open(szNewFile);
+    if (ERROR_SUCCESS != uiResult)
+    {
+        fprintf(stderr, TEXT("Cannot read snapshot %s: %d\n"), szNewFile, uiResult);
+        return 1;
+    }
+
+    SNAPSHOTDIFF Diff;
+    memset(&Diff, 0, sizeof(Diff));
+    Diff.pOld = &Old;
+    Diff.pNew = &New;
+
+    MergeJoinByCode(&Diff, bcProductByCode, bcProductCode, DiffProduct);
+    MergeJoinByCode(&Diff, bcComponentByCode, bcComponentCode, DiffComponent);
+
+    if (Diff.fOutOfMemory)
+    {
+        fprintf(stderr, TEXT("Out of memory comparing %s and %s.\n"), szOldFile, szNewFile);
+        return 1;
+    }
+
+    g_Out.Printf(TEXT("\n%u product%s added, %u removed, %u feature change%s, %u newly orphaned component%s, %u keypath version change%s.\n"),
+        Diff.cProductsAdded, Pluralize(Diff.cProductsAdded), Diff.cProductsRemoved,
+        Diff.cFeatureChanges, Pluralize(Diff.cFeatureChanges),
+        Diff.cNewOrphans, Pluralize(Diff.cNewOrphans),
+        Diff.cKeyPathChanges, Pluralize(Diff.cKeyPathChanges));
+    return 0;
+}
@@ -0,0 +1,26 @@
+/*---------------------------------------------------------------------------
+Snapshot diff (-diff).
+
+    Compares two binary snapshots (-o) and prints only what changed:
+    products added or removed, feature states that changed (or features
+    that came or went) in products present in both, components that are
+    orphaned now but were not before, and keypath versions that changed
+    for a component client present in both.
+
+    Products and components are merge-joined over the snapshots' sorted
+    ...ByCode columns, so the diff is one pass over each table.  Features
+    are matched by name inside each product with a hash map, and client
+    edges by client code inside each component - both groups are small.
+    Nothing is asked of the installer, so it runs on any machine.
+---------------------------------------------------------------------------*/
+
+#ifndef SNAPDIFF_H
+#define SNAPDIFF_H
+
+#include "msiport.h"
+
+// prints the deltas to stdout.  Returns the process exit code: 0, or 1 when
+// a snapshot cannot be read.
+int DiffSnapshots(const TCHAR* szOldFile, const TCHAR* szNewFile);
+
+#endif // SNAPDIFF_H
@@ -0,0 +1,160 @@
+/*---------------------------------------------------------------------------
+Stand-in file system - see standinfs.h.
+---------------------------------------------------------------------------*/
+
+#include "standinfs.h"
+#include "acctcache.h"
+#include "callcount.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <pwd.h>
+#include <sys/stat.h>
+#endif
+
+CStandInFileSystem::CStandInFileSystem(CInstallerData* pSource, const TCHAR* szRoot, DWORD dwLatency, CRegistry* pRegistry)
+    : CForwardingInstallerData(pSource), m_szRoot(NULL), m_dwLatency(dwLatency), m_pRegistryKeys(NULL)
+{
+    if (pRegistry)
+        m_pRegistryKeys = new CRegistryKeyCache(pRegistry);
+
+    if (szRoot)
+    {
+        m_szRoot = (TCHAR*) malloc((lstrlen(szRoot) + 1) * sizeof(TCHAR));
+        if (m_szRoot)
+            lstrcpy(m_szRoot, szRoot);
+    }
+}
+
+CStandInFileSystem::~CStandInFileSystem()
+{
+    free(m_szRoot);
+    delete m_pRegistryKeys;
+    delete m_pSource;
+}
+
+// "C:\dir\file" -> root/C/dir/file, "\\server\share\file" -> root/server/share/file.
+static bool MapKeyPath(const TCHAR* szRoot, const TCHAR* szKeyPath, TCHAR* szMapped, int cchMapped)
+{
+#ifdef _WIN32
+    const TCHAR chSeparator = '\\';
+#else
+    const TCHAR chSeparator = '/';
+#endif
+    int ich = lstrlen(szRoot);
+    if (ich >= cchMapped)
+        return false;
+    lstrcpy(szMapped, szRoot);
+
+    // drive colons go; runs of either slash become one separator.
+    bool fSeparator = true;
+    for (const TCHAR* pch = szKeyPath; *pch; pch++)
+    {
+        if (':' == *pch)
+            continue;
+        if ('\\' == *pch || '/' == *pch)
+        {
+            fSeparator = true;
+            continue;
+        }
+        if (ich + 2 >= cchMapped)
+            return false;
+        if (fSeparator)
+            szMapped[ich++] = chSeparator;
+        szMapped[ich++] = *pch;
+        fSeparator = false;
+    }
+    szMapped[ich] = 0;
+    return true;
+}
+
+#ifndef _WIN32
+
+// the passwd entry stands in for LookupAccountSid.
+static DWORD LookupUidAccount(const BYTE* pbId, DWORD cbId, TCHAR* szAccount, DWORD cchAccount)
+{
+    uid_t uid;
+    if (cbId != sizeof(uid))
+        return ERROR_INVALID_PARAMETER;
+    memcpy(&uid, pbId, sizeof(uid));
+
+    struct passwd pwd;
+    struct passwd* ppwd = NULL;
+    char rgchBuffer[1024];
+    CCallTimer Timer(tcLookupAccountSid);
+    int iError = getpwuid_r(uid, &pwd, rgchBuffer, sizeof(rgchBuffer), &ppwd);
+    Timer.Stop();
+    if (!ppwd)
+        return (iError) ? iError : ERROR_FILE_NOT_FOUND;
+
+    lstrcpyn(szAccount, ppwd->pw_name, cchAccount);
+    return ERROR_SUCCESS;
+}
+
+static void ProbeFile(const TCHAR* szFile, KEYPATHPROBE* pProbe, CDirectoryCache* pDirectories)
+{
+    // the same shape the NT live probe reports for a missing file.
+    pProbe->dwAttributes = 0;
+
+    DIRENTRYINFO Entry;
+    DIRLOOKUP dl = pDirectories->FindFile(szFile, &Entry);
+    if (dlMissing == dl)
+        return;
+    if (dlNotListed == dl)
+    {
+        struct stat st;
+        if (0 != stat(szFile, &st))
+        {
+            pProbe->uiVersionResult = (EACCES == errno) ? ERROR_ACCESS_DENIED : ERROR_FILE_NOT_FOUND;
+            return;
+        }
+        DirectoryEntryFromStat(st, &Entry);
+    }
+    CopyDirectoryEntry(Entry, pProbe);
+
+    ProbeKeyPathImage(szFile, true, pProbe);
+
+    uid_t uid = (uid_t) Entry.dwOwnerId;
+    pProbe->dwOwnerError = LookupAccountCached((const BYTE*) &uid, sizeof(uid), LookupUidAccount, pProbe->szOwner, CCHKeyPathOwner);
+    pProbe->osOwner = (ERROR_SUCCESS == pProbe->dwOwnerError) ? osResolved : osLookupFailed;
+}
+
+#endif // !_WIN32
+
+void CStandInFileSystem::ProbeKeyPath(const TCHAR* szKeyPath, KEYPATHPROBE* pProbe)
+{
+    if (m_dwLatency)
+        Sleep(m_dwLatency);
+
+    if (szKeyPath && IsRegistryKeyPath(szKeyPath) && m_pRegistryKeys)
+    {
+        m_pRegistryKeys->ProbeKeyPath(szKeyPath, pProbe);
+        return;
+    }
+
+    if (!m_szRoot || !szKeyPath || IsRegistryKeyPath(szKeyPath))
+    {
+        m_pSource->ProbeKeyPath(szKeyPath, pProbe);
+        return;
+    }
+
+    InitKeyPathProbe(pProbe);
+    if (!*szKeyPath)
+        return;
+
+    TCHAR szMapped[MAX_PATH + 1024];
+    if (!MapKeyPath(m_szRoot, szKeyPath, szMapped, sizeof(szMapped) / sizeof(TCHAR)))
+    {
+        pProbe->dwAttributes = 0;
+        return;
+    }
+
+#ifdef _WIN32
+    ProbeKeyPathLive(szMapped, pProbe, &m_Directories);
+#else
+    ProbeFile(szMapped, pProbe, &m_Directories);
+#endif
+}
@@ -0,0 +1,49 @@
+/*---------------------------------------------------------------------------
+Stand-in file system (-probe root=DIR,latency=MS).
+
+    Answers keypath probes from a directory tree instead of the machine's
+    own drives, so the probe pool (probepool.h) can be load-tested against
+    real files anywhere - a tree on a network mount, a ramdisk, a slow
+    USB stick.  "C:\Program Files\App\app.dll" is looked up as
+    DIR/C/Program Files/App/app.dll; a UNC path \\server\share\x as
+    DIR/server/share/x.  latency adds a fixed delay to every probe, to
+    stand in for a redirected profile without one.
+
+    Off Windows the probe is stat() and the owner's account name, and the
+    version and binary type of a Windows image read from the file itself
+    (peimage.h); anything else reports "No version information."  On
+    Windows the mapped path is probed by the live probe.  Either way the
+    tree's directories are listed as the live probe lists the machine's
+    (dircache.h), with readdir off Windows.
+
+    With a stand-in registry (-registry, standinreg.h) registry keypaths
+    are answered from it, through a key cache of their own (regkeys.h).
+    Without one they, and every other question, go to the wrapped
+    provider.
+---------------------------------------------------------------------------*/
+
+#ifndef STANDINFS_H
+#define STANDINFS_H
+
+#include "installerdata.h"
+#include "regkeys.h"
+#include "dircache.h"
+
+class CStandInFileSystem : public CForwardingInstallerData
+{
+public:
+    // szRoot NULL probes files through pSource, after the latency;
+    // pRegistry NULL, registry keypaths.
+    CStandInFileSystem(CInstallerData* pSource, const TCHAR* szRoot, DWORD dwLatency, CRegistry* pRegistry);
+    ~CStandInFileSystem();      // deletes pSource and pRegistry
+
+    void          ProbeKeyPath(const TCHAR* szKeyPath, KEYPATHPROBE* pProbe);
+
+private:
+    TCHAR*              m_szRoot;
+    DWORD               m_dwLatency;        // milliseconds per probe
+    CRegistryKeyCache*  m_pRegistryKeys;    // NULL without a stand-in registry
+    CDirectoryCache     m_Directories;
+};
+
+#endif // STANDINFS_H
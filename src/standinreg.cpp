@@ -0,0 +1,197 @@
+/*---------------------------------------------------------------------------
+Stand-in registry - see standinreg.h.
+---------------------------------------------------------------------------*/
+
+#include "standinreg.h"
+#include "callcount.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const TCHAR* const rgszRoot[][2] =
+    {
+        { TEXT("HKEY_CLASSES_ROOT"),    TEXT("HKCR") },
+        { TEXT("HKEY_CURRENT_USER"),    TEXT("HKCU") },
+        { TEXT("HKEY_LOCAL_MACHINE"),   TEXT("HKLM") },
+        { TEXT("HKEY_USERS"),           TEXT("HKU") },
+    };
+const DWORD CStandInRoots = sizeof(rgszRoot) / sizeof(rgszRoot[0]);
+
+// a key is its index; the roots are 1-4.
+static inline HKEY KeyOfIndex(DWORD iKey)     { return (HKEY) (size_t) iKey; }
+static inline DWORD IndexOfKey(HKEY hKey)     { return (DWORD) (size_t) hKey; }
+
+CStandInRegistry::CStandInRegistry()
+    : m_fChildren(false), m_cKeys(1 + CStandInRoots), m_cOpens(0), m_cSegments(0), m_cHandles(0)
+{
+    m_fChildren = InitStringMap(&m_Children, 1024, false);
+}
+
+CStandInRegistry::~CStandInRegistry()
+{
+    if (m_fChildren)
+        FreeStringMap(&m_Children);
+}
+
+// the child of iParent named by the segment; 0 when there is none, or
+// (fAdd) when out of memory.
+DWORD CStandInRegistry::FindChild(DWORD iParent, const TCHAR* szSegment, DWORD cchSegment, bool fAdd)
+{
+    // the map's key is the parent's index and the segment, as the key cache's is.
+    TCHAR szEdge[16 + 256];
+    if (!m_fChildren || cchSegment > 255)
+        return 0;
+    int cchParent = sprintf(szEdge, TEXT("%x\\"), iParent);
+    memcpy(szEdge + cchParent, szSegment, cchSegment * sizeof(TCHAR));
+    szEdge[cchParent + cchSegment] = 0;
+
+    DWORD iChild = 0;
+    if (FindStringMapValue(&m_Children, szEdge, &iChild) || !fAdd)
+        return iChild;
+
+    TCHAR* szKey = m_Arena.Alloc(cchParent + cchSegment + 1);
+    if (!szKey)
+        return 0;
+    lstrcpy(szKey, szEdge);
+    if (!SetStringMapValue(&m_Children, szKey, m_cKeys))
+        return 0;
+    return m_cKeys++;
+}
+
+bool CStandInRegistry::AddKey(const TCHAR* szKey)
+{
+    const TCHAR* pchPath = strchr(szKey, '\\');
+    DWORD cchRoot = (pchPath) ? (DWORD) (pchPath - szKey) : lstrlen(szKey);
+    DWORD iKey = 0;
+    for (DWORD iRoot = 0; iRoot < CStandInRoots; iRoot++)
+    {
+        for (int iName = 0; iName < 2; iName++)
+        {
+            if ((cchRoot == (DWORD) lstrlen(rgszRoot[iRoot][iName])) && (0 == _strnicmp(szKey, rgszRoot[iRoot][iName], cchRoot)))
+                iKey = 1 + iRoot;
+        }
+    }
+    if (!iKey || !pchPath)
+        return true;
+
+    for (const TCHAR* pch = pchPath; *pch; )
+    {
+        if ('\\' == *pch)
+        {
+            pch++;
+            continue;
+        }
+        const TCHAR* pchStart = pch;
+        while (*pch && ('\\' != *pch))
+            pch++;
+        iKey = FindChild(iKey, pchStart, (DWORD) (pch - pchStart), true);
+        if (!iKey)
+            return false;
+    }
+    return true;
+}
+
+// a Unicode export as narrow text in place: Latin-1 as itself, past it '?'.
+static DWORD NarrowUnicodeExport(BYTE* pb, DWORD cb)
+{
+    DWORD cch = 0;
+    for (DWORD ib = 2; ib + 1 < cb; ib += 2)
+    {
+        WORD wch = (WORD) (pb[ib] | (pb[ib + 1] << 8));
+        pb[cch++] = (wch < 0x100) ? (BYTE) wch : (BYTE) '?';
+    }
+    return cch;
+}
+
+UINT CStandInRegistry::Load(const TCHAR* szRegFile)
+{
+    FILE* pFile = fopen(szRegFile, TEXT("rb"));
+    if (!pFile)
+        return ERROR_FILE_NOT_FOUND;
+
+    // the whole export at once; lines are read in place.
+    fseek(pFile, 0, SEEK_END);
+    long cb = ftell(pFile);
+    fseek(pFile, 0, SEEK_SET);
+    BYTE* pbFile = (cb >= 0) ? (BYTE*) malloc(cb + 1) : NULL;
+    if (!pbFile)
+    {
+        fclose(pFile);
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+    DWORD cch = (DWORD) fread(pbFile, 1, cb, pFile);
+    fclose(pFile);
+    if ((cch >= 2) && (0xFF == pbFile[0]) && (0xFE == pbFile[1]))
+        cch = NarrowUnicodeExport(pbFile, cch);
+    pbFile[cch] = 0;
+    TCHAR* pchFile = (TCHAR*) pbFile;
+
+    UINT uiResult = ERROR_SUCCESS;
+    if ((0 != _strnicmp(pchFile, TEXT("Windows Registry Editor Version 5.00"), 36)) && (0 != _strnicmp(pchFile, TEXT("REGEDIT4"), 8)))
+        uiResult = ERROR_INVALID_DATA;
+
+    TCHAR* pchLine = pchFile;
+    while (*pchLine && (ERROR_SUCCESS == uiResult))
+    {
+        TCHAR* pchEnd = pchLine;
+        while (*pchEnd && ('\n' != *pchEnd) && ('\r' != *pchEnd))
+            pchEnd++;
+        TCHAR* pchNext = pchEnd;
+        while (('\n' == *pchNext) || ('\r' == *pchNext))
+            pchNext++;
+
+        // "[key]"; "[-key]" deletes one, and values and their continuations are not keys.
+        if (('[' == *pchLine) && ('-' != pchLine[1]) && (pchEnd > pchLine + 1) && (']' == pchEnd[-1]))
+        {
+            pchEnd[-1] = 0;
+            if (!AddKey(pchLine + 1))
+                uiResult = ERROR_NOT_ENOUGH_MEMORY;
+        }
+        pchLine = pchNext;
+    }
+
+    free(pbFile);
+    return uiResult;
+}
+
+HKEY CStandInRegistry::RootKey(DWORD iRoot)
+{
+    return KeyOfIndex(1 + iRoot);
+}
+
+LONG CStandInRegistry::OpenKey(HKEY hKey, const TCHAR* szSubKey, bool /* f64 */, HKEY* phKey)
+{
+    // -t counts the stand-in's opens as the registry's.
+    CCallTimer Timer(tcRegOpenKeyEx);
+    InterlockedIncrement(&m_cOpens);
+    DWORD iKey = IndexOfKey(hKey);
+    for (const TCHAR* pch = szSubKey; *pch; )
+    {
+        if ('\\' == *pch)
+        {
+            pch++;
+            continue;
+        }
+        const TCHAR* pchStart = pch;
+        while (*pch && ('\\' != *pch))
+            pch++;
+        InterlockedIncrement(&m_cSegments);
+        iKey = FindChild(iKey, pchStart, (DWORD) (pch - pchStart), false);
+        if (!iKey)
+            return ERROR_FILE_NOT_FOUND;
+    }
+
+    InterlockedIncrement(&m_cHandles);
+    *phKey = KeyOfIndex(iKey);
+    return ERROR_SUCCESS;
+}
+
+void CStandInRegistry::CloseKey(HKEY /* hKey */)
+{
+    InterlockedDecrement(&m_cHandles);
+}
+
+void CStandInRegistry::ProbeKey(HKEY /* hKey */, KEYPATHPROBE* /* pProbe */)
+{
+    // an export has no owner or write time to give.
+}
@@ -0,0 +1,67 @@
+/*---------------------------------------------------------------------------
+Stand-in registry (-registry).
+
+    Answers registry keypaths from a .reg export instead of the machine's
+    registry, so the registry probe and its key cache (regkeys.h) run
+    anywhere - against a machine's real keys, exported with
+
+        reg export HKLM\SOFTWARE machine.reg
+
+    or against keys generated by -bench regkeys.  Only the key lines of
+    the export are read ("[HKEY_LOCAL_MACHINE\SOFTWARE\...]"), in either
+    regedit's Unicode format or REGEDIT4; a key brings every key above it.
+    Keys are matched without regard to case, as the registry matches them.
+    Characters past Latin-1 in a Unicode export are read as '?'.
+
+    An export carries no owners or write times, so a key that exists is
+    reported as just that.  Both views see the same keys: an export of a
+    64-bit machine names Wow6432Node where it means it.
+
+    Every key is added before the first probe; after that the stand-in is
+    only read, and is safe from several threads.  It counts the keys
+    opened, the segments it walked to find them and the handles still
+    open, which the registry's own cost follows (-bench regkeys).
+---------------------------------------------------------------------------*/
+
+#ifndef STANDINREG_H
+#define STANDINREG_H
+
+#include "regkeys.h"
+#include "strarena.h"
+#include "strmap.h"
+
+class CStandInRegistry : public CRegistry
+{
+public:
+    CStandInRegistry();
+    ~CStandInRegistry();
+
+    // the keys in a .reg export.
+    UINT          Load(const TCHAR* szRegFile);
+    // "HKEY_LOCAL_MACHINE\SOFTWARE\..." (or HKLM\...) and every key above
+    // it.  Other roots are skipped; false when out of memory.
+    bool          AddKey(const TCHAR* szKey);
+
+    HKEY          RootKey(DWORD iRoot);
+    LONG          OpenKey(HKEY hKey, const TCHAR* szSubKey, bool f64, HKEY* phKey);
+    void          CloseKey(HKEY hKey);
+    void          ProbeKey(HKEY hKey, KEYPATHPROBE* pProbe);
+
+    DWORD         KeyCount() const      { return m_cKeys; }
+    DWORD         OpenCount() const     { return (DWORD) m_cOpens; }
+    DWORD         SegmentCount() const  { return (DWORD) m_cSegments; }
+    DWORD         HandleCount() const   { return (DWORD) m_cHandles; }
+
+private:
+    DWORD         FindChild(DWORD iParent, const TCHAR* szSegment, DWORD cchSegment, bool fAdd);
+
+    STRINGMAP     m_Children;       // "parent index\segment" -> key index
+    bool          m_fChildren;
+    CStringArena  m_Arena;          // the map's keys
+    DWORD         m_cKeys;          // 1-4 are the roots; 0 is none
+    volatile LONG m_cOpens;
+    volatile LONG m_cSegments;
+    volatile LONG m_cHandles;
+};
+
+#endif // STANDINREG_H
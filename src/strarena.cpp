@@ -0,0 +1,90 @@
+/*---------------------------------------------------------------------------
+String arena - see strarena.h.
+---------------------------------------------------------------------------*/
+
+#include "strarena.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct ARENABLOCK {
+    ARENABLOCK* pNext;
+    DWORD       cch;
+    DWORD       cchUsed;
+    TCHAR       rgch[1];
+};
+
+CStringArena::CStringArena()
+    : m_pFirst(NULL), m_pCurrent(NULL), m_cBlocks(0)
+{
+}
+
+CStringArena::~CStringArena()
+{
+    ARENABLOCK* pBlock = m_pFirst;
+    while (pBlock)
+    {
+        ARENABLOCK* pNext = pBlock->pNext;
+        free(pBlock);
+        pBlock = pNext;
+    }
+}
+
+TCHAR* CStringArena::Alloc(DWORD cch)
+{
+    // a string bigger than the rest of the current block looks further on, and
+    // gets a block of its own at the end when none has room.  The current
+    // block is passed over for good once it has little room left, or every
+    // string longer than that room would walk the list from it.
+    ARENABLOCK* pPrevious = NULL;
+    ARENABLOCK* pBlock = (m_pCurrent) ? m_pCurrent : m_pFirst;
+    while (pBlock && (pBlock->cch - pBlock->cchUsed < cch))
+    {
+        if ((m_pCurrent == pBlock) && (pBlock->cch - pBlock->cchUsed < CCHArenaBlock / 16) && pBlock->pNext)
+            m_pCurrent = pBlock->pNext;
+        pPrevious = pBlock;
+        pBlock = pBlock->pNext;
+    }
+
+    if (!pBlock)
+    {
+        DWORD cchBlock = (cch > CCHArenaBlock) ? cch : CCHArenaBlock;
+        pBlock = (ARENABLOCK*) malloc(sizeof(ARENABLOCK) + cchBlock * sizeof(TCHAR));
+        if (!pBlock)
+            return NULL;
+        pBlock->pNext = NULL;
+        pBlock->cch = cchBlock;
+        pBlock->cchUsed = 0;
+        if (pPrevious)
+            pPrevious->pNext = pBlock;
+        else
+            m_pFirst = pBlock;
+        m_cBlocks++;
+    }
+
+    TCHAR* pch = pBlock->rgch + pBlock->cchUsed;
+    pBlock->cchUsed += cch;
+
+    // only move on when this block is all but full; a skipped block keeps its room for small strings.
+    if (!m_pCurrent)
+        m_pCurrent = m_pFirst;
+    if ((m_pCurrent == pBlock) && (pBlock->cch - pBlock->cchUsed < 64) && pBlock->pNext)
+        m_pCurrent = pBlock->pNext;
+    return pch;
+}
+
+const TCHAR* CStringArena::Copy(const TCHAR* sz, DWORD cch)
+{
+    TCHAR* pch = Alloc(cch + 1);
+    if (!pch)
+        return TEXT("");
+    memcpy(pch, sz, cch * sizeof(TCHAR));
+    pch[cch] = 0;
+    return pch;
+}
+
+void CStringArena::Reset()
+{
+    for (ARENABLOCK* pBlock = m_pFirst; pBlock; pBlock = pBlock->pNext)
+        pBlock->cchUsed = 0;
+    m_pCurrent = m_pFirst;
+}
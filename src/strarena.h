@@ -0,0 +1,45 @@
+/*---------------------------------------------------------------------------
+String arena.
+
+    The report asks the installer for thousands of short strings - names,
+    properties, paths - each needed only until the next product or
+    component is printed.  A CStringArena hands them out from large blocks
+    by bumping a pointer; nothing is freed one string at a time.  Reset
+    takes everything back at once and keeps the blocks for the next round,
+    and the blocks themselves are freed with the arena, once per run.
+
+    Not safe for several threads; each thread that wants one has its own.
+---------------------------------------------------------------------------*/
+
+#ifndef STRARENA_H
+#define STRARENA_H
+
+#include "msiport.h"
+
+const DWORD CCHArenaBlock = 16 * 1024;
+
+struct ARENABLOCK;
+
+class CStringArena
+{
+public:
+    CStringArena();
+    ~CStringArena();
+
+    // room for cch characters; NULL when out of memory.
+    TCHAR*        Alloc(DWORD cch);
+    // the first cch characters of sz, NUL-terminated; "" when out of memory.
+    const TCHAR*  Copy(const TCHAR* sz, DWORD cch);
+
+    // everything handed out is gone; the blocks are kept.
+    void          Reset();
+
+    DWORD         BlockCount() const    { return m_cBlocks; }
+
+private:
+    ARENABLOCK*   m_pFirst;
+    ARENABLOCK*   m_pCurrent;       // where the search for room starts; the blocks before it are full
+    DWORD         m_cBlocks;
+};
+
+#endif // STRARENA_H
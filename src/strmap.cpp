@@ -0,0 +1,120 @@
+/*---------------------------------------------------------------------------
+String map - see strmap.h.
+---------------------------------------------------------------------------*/
+
+#include "strmap.h"
+#include <stdlib.h>
+#include <string.h>
+
+// FNV-1a over the text, upper-cased unless case matters.
+static DWORD HashString(const TCHAR* szKey, bool fMatchCase)
+{
+    DWORD dwHash = 2166136261u;
+    for (const TCHAR* pch = szKey; *pch; pch++)
+    {
+        TCHAR ch = *pch;
+        if (!fMatchCase && ch >= 'a' && ch <= 'z')
+            ch = (TCHAR) (ch - 'a' + 'A');
+        dwHash ^= (BYTE) ch;
+        dwHash *= 16777619u;
+    }
+    return dwHash;
+}
+
+// slot holding szKey, or the empty slot where it would go.
+static DWORD FindSlot(const STRINGMAP* pMap, const TCHAR* szKey)
+{
+    DWORD dwMask = pMap->cSlots - 1;
+    DWORD iSlot = HashString(szKey, pMap->fMatchCase) & dwMask;
+    if (pMap->fMatchCase)
+    {
+        while (pMap->rgszKey[iSlot] && 0 != strcmp(pMap->rgszKey[iSlot], szKey))
+            iSlot = (iSlot + 1) & dwMask;
+    }
+    else
+    {
+        while (pMap->rgszKey[iSlot] && 0 != lstrcmpi(pMap->rgszKey[iSlot], szKey))
+            iSlot = (iSlot + 1) & dwMask;
+    }
+    return iSlot;
+}
+
+bool InitStringMap(STRINGMAP* pMap, DWORD cExpected, bool fMatchCase)
+{
+    DWORD cSlots = 16;
+    while (cSlots < cExpected * 2)
+        cSlots *= 2;
+
+    pMap->rgszKey = (const TCHAR**) calloc(cSlots, sizeof(pMap->rgszKey[0]));
+    pMap->rgdwValue = (DWORD*) malloc(cSlots * sizeof(DWORD));
+    if (!pMap->rgszKey || !pMap->rgdwValue)
+    {
+        FreeStringMap(pMap);
+        return false;
+    }
+
+    pMap->cSlots = cSlots;
+    pMap->cEntries = 0;
+    pMap->fMatchCase = fMatchCase;
+    return true;
+}
+
+void FreeStringMap(STRINGMAP* pMap)
+{
+    free(pMap->rgszKey);
+    free(pMap->rgdwValue);
+    pMap->rgszKey = NULL;
+    pMap->rgdwValue = NULL;
+    pMap->cSlots = 0;
+    pMap->cEntries = 0;
+}
+
+static bool RehashStringMap(STRINGMAP* pMap)
+{
+    STRINGMAP NewMap;
+    if (!InitStringMap(&NewMap, pMap->cSlots, pMap->fMatchCase))
+        return false;
+
+    for (DWORD iSlot = 0; iSlot < pMap->cSlots; iSlot++)
+    {
+        if (pMap->rgszKey[iSlot])
+        {
+            DWORD iNewSlot = FindSlot(&NewMap, pMap->rgszKey[iSlot]);
+            NewMap.rgszKey[iNewSlot] = pMap->rgszKey[iSlot];
+            NewMap.rgdwValue[iNewSlot] = pMap->rgdwValue[iSlot];
+            NewMap.cEntries++;
+        }
+    }
+
+    FreeStringMap(pMap);
+    *pMap = NewMap;
+    return true;
+}
+
+bool SetStringMapValue(STRINGMAP* pMap, const TCHAR* szKey, DWORD dwValue)
+{
+    if (((pMap->cEntries + 1) * 2 > pMap->cSlots) && !RehashStringMap(pMap))
+        return false;
+
+    DWORD iSlot = FindSlot(pMap, szKey);
+    if (!pMap->rgszKey[iSlot])
+    {
+        pMap->rgszKey[iSlot] = szKey;
+        pMap->cEntries++;
+    }
+    pMap->rgdwValue[iSlot] = dwValue;
+    return true;
+}
+
+bool FindStringMapValue(const STRINGMAP* pMap, const TCHAR* szKey, DWORD* pdwValue)
+{
+    if (!pMap->cSlots)
+        return false;
+
+    DWORD iSlot = FindSlot(pMap, szKey);
+    if (!pMap->rgszKey[iSlot])
+        return false;
+
+    *pdwValue = pMap->rgdwValue[iSlot];
+    return true;
+}
@@ -0,0 +1,33 @@
+/*---------------------------------------------------------------------------
+String map.
+
+    Open-addressing (linear probe) hash map from a string to a DWORD.
+    Keys compare case-insensitively, like the installer compares GUIDs and
+    the file system compares paths, unless the map is made to match case
+    (string pools, where "Foo" and "foo" are different text.)  Keys are
+    NOT copied - the caller keeps them alive for as long as the map is
+    used (snapshot text, an arena.)
+    The table is kept at most half full; it never shrinks or deletes.
+---------------------------------------------------------------------------*/
+
+#ifndef STRMAP_H
+#define STRMAP_H
+
+#include "msiport.h"
+
+struct STRINGMAP {
+    DWORD           cSlots;         // power of two
+    DWORD           cEntries;
+    const TCHAR**   rgszKey;        // NULL marks an empty slot
+    DWORD*          rgdwValue;
+    bool            fMatchCase;
+};
+
+bool InitStringMap(STRINGMAP* pMap, DWORD cExpected, bool fMatchCase);
+void FreeStringMap(STRINGMAP* pMap);
+
+// adds szKey or replaces its value.
+bool SetStringMapValue(STRINGMAP* pMap, const TCHAR* szKey, DWORD dwValue);
+bool FindStringMapValue(const STRINGMAP* pMap, const TCHAR* szKey, DWORD* pdwValue);
+
+#endif // STRMAP_H
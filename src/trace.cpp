@@ -0,0 +1,200 @@
+/*---------------------------------------------------------------------------
+Trace events - see trace.h.
+---------------------------------------------------------------------------*/
+
+#include "trace.h"
+#include "outsink.h"
+#include "jsonout.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#define TRACE_THREAD_LOCAL  __declspec(thread)
+#else
+#define TRACE_THREAD_LOCAL  __thread
+#endif
+
+struct TRACEEVENT {
+    const TCHAR*    szName;
+    const TCHAR*    szArgName;      // NULL: no argument
+    __int64         lgStart;
+    __int64         lgEnd;
+    TCHAR           szArg[CCHTraceArg];
+};
+
+// one thread's ring.  Only that thread writes it, until WriteTrace reads it.
+struct TRACEBUFFER {
+    DWORD               dwThread;   // the trace's tid
+    unsigned __int64    cEvents;    // ever recorded; the newest CTraceEvents are in the ring
+    TRACEEVENT          rgEvent[CTraceEvents];
+};
+
+bool g_fTrace = false;
+
+static TRACEBUFFER* s_rgpBuffer[CTraceThreads];
+static volatile LONG s_cBuffers = 0;    // slots taken, including any past CTraceThreads
+static LONG s_lGeneration = 0;          // which StartTrace a thread's ring belongs to
+static __int64 s_lgOrigin = 0;          // the counter at StartTrace; ts 0
+static __int64 s_lgFrequency = 1;       // ticks a second
+
+static TRACE_THREAD_LOCAL TRACEBUFFER* t_pBuffer = NULL;
+static TRACE_THREAD_LOCAL LONG t_lGeneration = 0;
+
+__int64 TraceClock()
+{
+    LARGE_INTEGER liNow;
+    QueryPerformanceCounter(&liNow);
+    return liNow.QuadPart;
+}
+
+// the calling thread's ring, taken on its first span of the run.  NULL once
+// CTraceThreads threads have one, or when there is no memory for it.
+static TRACEBUFFER* ThreadBuffer()
+{
+    if (t_lGeneration == s_lGeneration)
+        return t_pBuffer;
+
+    t_lGeneration = s_lGeneration;
+    t_pBuffer = NULL;
+    LONG iSlot = InterlockedIncrement(&s_cBuffers) - 1;
+    if (iSlot >= (LONG) CTraceThreads)
+        return NULL;
+
+    // untouched pages of the ring cost nothing until a span reaches them.
+    TRACEBUFFER* pBuffer = (TRACEBUFFER*) malloc(sizeof(TRACEBUFFER));
+    if (pBuffer)
+    {
+        pBuffer->dwThread = iSlot + 1;
+        pBuffer->cEvents = 0;
+    }
+    s_rgpBuffer[iSlot] = pBuffer;
+    t_pBuffer = pBuffer;
+    return pBuffer;
+}
+
+void StartTrace()
+{
+    LARGE_INTEGER liFrequency;
+    if (QueryPerformanceFrequency(&liFrequency) && liFrequency.QuadPart > 0)
+        s_lgFrequency = liFrequency.QuadPart;
+    s_lGeneration++;
+    s_cBuffers = 0;
+    memset(s_rgpBuffer, 0, sizeof(s_rgpBuffer));
+    s_lgOrigin = TraceClock();
+    g_fTrace = true;
+
+    // the report's thread is tid 1, whatever the workers do.
+    ThreadBuffer();
+}
+
+void RecordSpan(const TCHAR* szName, const TCHAR* szArgName, const TCHAR* szArg, __int64 lgStart, __int64 lgEnd)
+{
+    TRACEBUFFER* pBuffer = ThreadBuffer();
+    if (!pBuffer)
+        return;
+
+    TRACEEVENT* pEvent = &pBuffer->rgEvent[pBuffer->cEvents % CTraceEvents];
+    pEvent->szName = szName;
+    pEvent->szArgName = (szArg) ? szArgName : NULL;
+    pEvent->lgStart = lgStart;
+    pEvent->lgEnd = lgEnd;
+    if (szArg)
+        lstrcpyn(pEvent->szArg, szArg, CCHTraceArg);
+    pBuffer->cEvents++;
+}
+
+// ticks since StartTrace as microseconds with three places: "1520.250".
+static void WriteMicroseconds(COutputSink* pOut, __int64 lgTicks)
+{
+    if (lgTicks < 0)
+        lgTicks = 0;
+    unsigned __int64 ns;
+    // hours of run would overflow the product.
+    if (lgTicks > (__int64) 0x7FFFFFFFFFFFFFFFLL / 1000000000)
+        ns = (unsigned __int64) (lgTicks / s_lgFrequency) * 1000000000;
+    else
+        ns = (unsigned __int64) (lgTicks * 1000000000 / s_lgFrequency);
+    pOut->Printf(TEXT("%llu.%03u"), ns / 1000, (unsigned int) (ns % 1000));
+}
+
+// every ring, oldest span first in each; returns how many spans the rings overwrote.
+static unsigned __int64 WriteTraceEvents(FILE* pFile, DWORD cBuffers)
+{
+    COutputSink Out(pFile);
+    unsigned __int64 cOverwritten = 0;
+    Out.Str(TEXT("{\"traceEvents\":[\n"));
+    bool fFirst = true;
+    for (DWORD iBuffer = 0; iBuffer < cBuffers; iBuffer++)
+    {
+        TRACEBUFFER* pBuffer = s_rgpBuffer[iBuffer];
+        if (!pBuffer)
+            continue;
+
+        TCHAR szThread[32];
+        if (1 == pBuffer->dwThread)
+            lstrcpy(szThread, TEXT("report"));
+        else
+            sprintf(szThread, TEXT("thread %u"), pBuffer->dwThread);
+        Out.Printf(TEXT("%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}"),
+            (fFirst) ? TEXT("") : TEXT(",\n"), pBuffer->dwThread, szThread);
+        fFirst = false;
+
+        // a full ring's oldest is the next one it would have written.
+        unsigned __int64 iFirst = (pBuffer->cEvents > CTraceEvents) ? pBuffer->cEvents - CTraceEvents : 0;
+        cOverwritten += iFirst;
+        for (unsigned __int64 iEvent = iFirst; iEvent < pBuffer->cEvents; iEvent++)
+        {
+            const TRACEEVENT& Event = pBuffer->rgEvent[iEvent % CTraceEvents];
+            Out.Str(TEXT(",\n{\"name\":"));
+            WriteJsonString(&Out, Event.szName);
+            Out.Str(TEXT(",\"cat\":\"msiinv\",\"ph\":\"X\",\"ts\":"));
+            WriteMicroseconds(&Out, Event.lgStart - s_lgOrigin);
+            Out.Str(TEXT(",\"dur\":"));
+            WriteMicroseconds(&Out, Event.lgEnd - Event.lgStart);
+            Out.Printf(TEXT(",\"pid\":1,\"tid\":%u"), pBuffer->dwThread);
+            if (Event.szArgName)
+            {
+                Out.Str(TEXT(",\"args\":{"));
+                WriteJsonString(&Out, Event.szArgName);
+                Out.Char(':');
+                WriteJsonString(&Out, Event.szArg);
+                Out.Char('}');
+            }
+            Out.Char('}');
+        }
+    }
+    Out.Str(TEXT("\n],\"displayTimeUnit\":\"ms\"}\n"));
+    return cOverwritten;
+}
+
+UINT WriteTrace(const TCHAR* szFile)
+{
+    g_fTrace = false;
+    DWORD cBuffers = ((DWORD) s_cBuffers < CTraceThreads) ? (DWORD) s_cBuffers : CTraceThreads;
+
+    UINT uiWrite = ERROR_SUCCESS;
+    FILE* pFile = fopen(szFile, TEXT("wb"));
+    if (!pFile)
+        uiWrite = ERROR_OPEN_FAILED;
+    else
+    {
+        unsigned __int64 cOverwritten = WriteTraceEvents(pFile, cBuffers);
+        if (ferror(pFile))
+            uiWrite = ERROR_WRITE_FAULT;
+        if (0 != fclose(pFile) && ERROR_SUCCESS == uiWrite)
+            uiWrite = ERROR_WRITE_FAULT;
+
+        if (cOverwritten)
+            fprintf(stderr, TEXT("Trace %s: the oldest %llu spans were overwritten; each thread keeps its newest %u.\n"),
+                szFile, cOverwritten, CTraceEvents);
+    }
+    if ((DWORD) s_cBuffers > CTraceThreads)
+        fprintf(stderr, TEXT("Trace %s: %u threads were not traced; at most %u are.\n"), szFile, (DWORD) s_cBuffers - CTraceThreads, CTraceThreads);
+
+    for (DWORD iBuffer = 0; iBuffer < cBuffers; iBuffer++)
+    {
+        free(s_rgpBuffer[iBuffer]);
+        s_rgpBuffer[iBuffer] = NULL;
+    }
+    return uiWrite;
+}
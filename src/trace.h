@@ -0,0 +1,79 @@
+/*---------------------------------------------------------------------------
+Trace events (-trace).
+
+    -t says how many calls a run made and how long they took; a trace says
+    when.  With -trace FILE the run records a span for each stage of the
+    report - the component index, the product loop and each product's
+    properties, features, components and patches, the component
+    evaluation and each component it lists, each log directory listed and
+    each read of the event log - and, on -j's workers and -probe's
+    threads, each product enriched and each keypath probed.  At the end of
+    the run they are written to FILE as Chrome trace events, which
+    chrome://tracing and ui.perfetto.dev open as a timeline with a row per
+    thread:
+
+        {"traceEvents":[
+        {"name":"thread_name","ph":"M","pid":1,"tid":1,"args":{"name":"report"}},
+        {"name":"product","cat":"msiinv","ph":"X","ts":1520.250,"dur":84.125,"pid":1,"tid":1,"args":{"product":"{...}"}},
+        ...
+        ],"displayTimeUnit":"ms"}
+
+    A span carries the product code, component ID, keypath or directory
+    it is about as its one argument, cut to CCHTraceArg characters.
+
+    Recording must not change the timings it records, so a span costs two
+    reads of the performance counter and a copy of its argument into a
+    buffer of the thread's own: each thread that ends a span takes a ring
+    of CTraceEvents events on first use, writes to it without a lock or an
+    interlocked operation, and nothing is formatted or written until the
+    run is over and every thread that traced has been joined.  A thread
+    that ends more spans than its ring holds keeps the newest; the run
+    says on stderr how many were overwritten.  With -trace off a span
+    tests one flag and reads no clock.
+
+    Spans are recorded when they end, as complete ("X") events, so an
+    overwritten ring never leaves a begin without its end.
+---------------------------------------------------------------------------*/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "msiport.h"
+
+const DWORD CTraceEvents = 64 * 1024;   // events per thread; the newest are kept
+const DWORD CTraceThreads = 256;        // threads that can trace in one run; more go untraced
+const DWORD CCHTraceArg = 64;           // a GUID with room to spare; longer arguments are cut
+
+// -trace: every ring dropped and every CTraceSpan recording.  The calling
+// thread is named "report" in the trace.
+void  StartTrace();
+// writes what was recorded to szFile and stops recording.  Every thread
+// that traced must have finished.
+UINT  WriteTrace(const TCHAR* szFile);
+
+// internal to CTraceSpan.
+extern bool g_fTrace;
+__int64 TraceClock();
+void  RecordSpan(const TCHAR* szName, const TCHAR* szArgName, const TCHAR* szArg, __int64 lgStart, __int64 lgEnd);
+
+// a span from its construction to End(), or its end.  szName and szArgName
+// are literals; szArg is copied when the span ends, so it must last as long.
+class CTraceSpan
+{
+public:
+    CTraceSpan(const TCHAR* szName, const TCHAR* szArgName = NULL, const TCHAR* szArg = NULL)
+        : m_szName(szName), m_szArgName(szArgName), m_szArg(szArg), m_fTracing(g_fTrace)
+                      { if (m_fTracing) m_lgStart = TraceClock(); }
+    ~CTraceSpan()     { End(); }
+
+    void  End()       { if (m_fTracing) { RecordSpan(m_szName, m_szArgName, m_szArg, m_lgStart, TraceClock()); m_fTracing = false; } }
+
+private:
+    const TCHAR*    m_szName;
+    const TCHAR*    m_szArgName;
+    const TCHAR*    m_szArg;
+    bool            m_fTracing;
+    __int64         m_lgStart;
+};
+
+#endif // TRACE_H
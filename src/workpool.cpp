@@ -0,0 +1,258 @@
+/*---------------------------------------------------------------------------
+Work pool - see workpool.h.
+---------------------------------------------------------------------------*/
+
+#include "workpool.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <pthread.h>
+#endif
+
+struct WORKPOOLSTATE {
+    PFNWORKITEM     pfnWork;
+    void*           pvContext;
+    DWORD           cItems;
+    DWORD           cMaxAhead;      // 0 - no bound
+    DWORD           cThreads;
+
+    // under the lock
+    DWORD           iNextItem;
+    DWORD           cReleased;
+    bool*           rgfDone;
+
+#ifdef _WIN32
+    CRITICAL_SECTION    cs;
+    HANDLE              hSlots;     // semaphore; one count per item a worker may start
+    HANDLE              hItemDone;  // auto-reset; the consumer is the only waiter
+    HANDLE*             rghThread;
+#else
+    pthread_mutex_t     mutex;
+    pthread_cond_t      condSlot;
+    pthread_cond_t      condItemDone;
+    pthread_t*          rgThread;
+#endif
+};
+
+#ifdef _WIN32
+
+static unsigned __stdcall WorkerThread(void* pv)
+{
+    WORKPOOLSTATE* pState = (WORKPOOLSTATE*) pv;
+    for (;;)
+    {
+        WaitForSingleObject(pState->hSlots, INFINITE);
+
+        EnterCriticalSection(&pState->cs);
+        DWORD iItem = pState->iNextItem;
+        bool fEnd = (iItem >= pState->cItems);
+        if (!fEnd)
+            pState->iNextItem++;
+        LeaveCriticalSection(&pState->cs);
+
+        if (fEnd)
+        {
+            // pass the count on so the other workers see the end too.
+            ReleaseSemaphore(pState->hSlots, 1, NULL);
+            return 0;
+        }
+
+        pState->pfnWork(pState->pvContext, iItem);
+
+        EnterCriticalSection(&pState->cs);
+        pState->rgfDone[iItem] = true;
+        LeaveCriticalSection(&pState->cs);
+        SetEvent(pState->hItemDone);
+    }
+}
+
+#else
+
+static void* WorkerThread(void* pv)
+{
+    WORKPOOLSTATE* pState = (WORKPOOLSTATE*) pv;
+    pthread_mutex_lock(&pState->mutex);
+    for (;;)
+    {
+        while ((pState->iNextItem < pState->cItems) && pState->cMaxAhead &&
+               (pState->iNextItem >= pState->cReleased + pState->cMaxAhead))
+        {
+            pthread_cond_wait(&pState->condSlot, &pState->mutex);
+        }
+
+        if (pState->iNextItem >= pState->cItems)
+            break;
+
+        DWORD iItem = pState->iNextItem++;
+        pthread_mutex_unlock(&pState->mutex);
+
+        pState->pfnWork(pState->pvContext, iItem);
+
+        pthread_mutex_lock(&pState->mutex);
+        pState->rgfDone[iItem] = true;
+        pthread_cond_broadcast(&pState->condItemDone);
+    }
+    pthread_mutex_unlock(&pState->mutex);
+    return NULL;
+}
+
+#endif // _WIN32
+
+CWorkPool::CWorkPool()
+    : m_pState(NULL)
+{
+}
+
+CWorkPool::~CWorkPool()
+{
+    Finish();
+}
+
+bool CWorkPool::Start(DWORD cThreads, DWORD cItems, DWORD cMaxAhead, PFNWORKITEM pfnWork, void* pvContext)
+{
+    Finish();
+    if (!cThreads)
+        cThreads = 1;
+
+    WORKPOOLSTATE* pState = (WORKPOOLSTATE*) calloc(1, sizeof(WORKPOOLSTATE));
+    if (!pState)
+        return false;
+    pState->pfnWork = pfnWork;
+    pState->pvContext = pvContext;
+    pState->cItems = cItems;
+    pState->cMaxAhead = cMaxAhead;
+    pState->rgfDone = (bool*) calloc(cItems + 1, sizeof(bool));
+
+#ifdef _WIN32
+    pState->rghThread = (HANDLE*) calloc(cThreads, sizeof(HANDLE));
+    InitializeCriticalSection(&pState->cs);
+    pState->hSlots = CreateSemaphore(NULL, (cMaxAhead) ? cMaxAhead : cItems + 1, 0x7FFFFFFF, NULL);
+    pState->hItemDone = CreateEvent(NULL, FALSE, FALSE, NULL);
+    bool fReady = pState->rgfDone && pState->rghThread && pState->hSlots && pState->hItemDone;
+    m_pState = pState;
+    while (fReady && pState->cThreads < cThreads)
+    {
+        pState->rghThread[pState->cThreads] = (HANDLE) _beginthreadex(NULL, 0, WorkerThread, pState, 0, NULL);
+        if (pState->rghThread[pState->cThreads])
+            pState->cThreads++;
+        else
+            fReady = false;
+    }
+#else
+    pState->rgThread = (pthread_t*) calloc(cThreads, sizeof(pthread_t));
+    pthread_mutex_init(&pState->mutex, NULL);
+    pthread_cond_init(&pState->condSlot, NULL);
+    pthread_cond_init(&pState->condItemDone, NULL);
+    bool fReady = pState->rgfDone && pState->rgThread;
+    m_pState = pState;
+    while (fReady && pState->cThreads < cThreads)
+    {
+        if (0 == pthread_create(&pState->rgThread[pState->cThreads], NULL, WorkerThread, pState))
+            pState->cThreads++;
+        else
+            fReady = false;
+    }
+#endif
+
+    if (!fReady)
+    {
+        // the threads that did start must not run anything.
+        if (pState->rgfDone)
+        {
+#ifdef _WIN32
+            EnterCriticalSection(&pState->cs);
+            pState->cItems = 0;
+            LeaveCriticalSection(&pState->cs);
+#else
+            pthread_mutex_lock(&pState->mutex);
+            pState->cItems = 0;
+            pthread_mutex_unlock(&pState->mutex);
+#endif
+        }
+        Finish();
+        return false;
+    }
+    return true;
+}
+
+void CWorkPool::WaitForItem(DWORD iItem)
+{
+    WORKPOOLSTATE* pState = m_pState;
+    if (!pState || iItem >= pState->cItems)
+        return;
+
+#ifdef _WIN32
+    for (;;)
+    {
+        EnterCriticalSection(&pState->cs);
+        bool fDone = pState->rgfDone[iItem];
+        LeaveCriticalSection(&pState->cs);
+        if (fDone)
+            break;
+        WaitForSingleObject(pState->hItemDone, INFINITE);
+    }
+#else
+    pthread_mutex_lock(&pState->mutex);
+    while (!pState->rgfDone[iItem])
+        pthread_cond_wait(&pState->condItemDone, &pState->mutex);
+    pthread_mutex_unlock(&pState->mutex);
+#endif
+}
+
+void CWorkPool::ReleaseItem()
+{
+    WORKPOOLSTATE* pState = m_pState;
+    if (!pState || !pState->cMaxAhead)
+        return;
+
+#ifdef _WIN32
+    ReleaseSemaphore(pState->hSlots, 1, NULL);
+#else
+    pthread_mutex_lock(&pState->mutex);
+    pState->cReleased++;
+    pthread_cond_broadcast(&pState->condSlot);
+    pthread_mutex_unlock(&pState->mutex);
+#endif
+}
+
+void CWorkPool::Finish()
+{
+    WORKPOOLSTATE* pState = m_pState;
+    if (!pState)
+        return;
+
+#ifdef _WIN32
+    // lift the bound so nobody waits on a consumer that has stopped.
+    if (pState->hSlots)
+        ReleaseSemaphore(pState->hSlots, pState->cItems + 1, NULL);
+    for (DWORD iThread = 0; iThread < pState->cThreads; iThread++)
+    {
+        WaitForSingleObject(pState->rghThread[iThread], INFINITE);
+        CloseHandle(pState->rghThread[iThread]);
+    }
+    if (pState->hSlots)
+        CloseHandle(pState->hSlots);
+    if (pState->hItemDone)
+        CloseHandle(pState->hItemDone);
+    DeleteCriticalSection(&pState->cs);
+    free(pState->rghThread);
+#else
+    pthread_mutex_lock(&pState->mutex);
+    pState->cMaxAhead = 0;
+    pthread_cond_broadcast(&pState->condSlot);
+    pthread_mutex_unlock(&pState->mutex);
+    for (DWORD iThread = 0; iThread < pState->cThreads; iThread++)
+        pthread_join(pState->rgThread[iThread], NULL);
+    pthread_cond_destroy(&pState->condItemDone);
+    pthread_cond_destroy(&pState->condSlot);
+    pthread_mutex_destroy(&pState->mutex);
+    free(pState->rgThread);
+#endif
+
+    free(pState->rgfDone);
+    free(pState);
+    m_pState = NULL;
+}
@@ -0,0 +1,49 @@
+/*---------------------------------------------------------------------------
+Work pool.
+
+    A fixed set of worker threads running one function over the items
+    0 .. cItems-1.  Items are handed out in order, so a consumer that
+    walks them in order (WaitForItem 0, 1, 2, ...) gets each one as soon
+    as it and everything before it is done - the report stays in
+    enumeration order however the workers finish.
+
+    cMaxAhead bounds how far the workers may run past the consumer: an
+    item is not started until the consumer has released all but
+    cMaxAhead-1 of the items before it.  0 means no bound (the consumer
+    need not call ReleaseItem at all.)
+
+    Win32 threads on Windows, pthreads elsewhere.
+---------------------------------------------------------------------------*/
+
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+
+#include "msiport.h"
+
+typedef void (*PFNWORKITEM)(void* pvContext, DWORD iItem);
+
+struct WORKPOOLSTATE;
+
+class CWorkPool
+{
+public:
+    CWorkPool();
+    ~CWorkPool();       // Finish()
+
+    // false when the threads cannot be started; nothing has run then.
+    bool  Start(DWORD cThreads, DWORD cItems, DWORD cMaxAhead, PFNWORKITEM pfnWork, void* pvContext);
+
+    // blocks until iItem has run.
+    void  WaitForItem(DWORD iItem);
+
+    // the consumer is done with one more item; lets a worker start another.
+    void  ReleaseItem();
+
+    // runs whatever is left and joins the workers.
+    void  Finish();
+
+private:
+    WORKPOOLSTATE*  m_pState;
+};
+
+#endif // WORKPOOL_H